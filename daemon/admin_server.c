@@ -86,6 +86,10 @@ adminServerGetThreadPoolParameters(virNetServerPtr srv,
     size_t freeWorkers;
     size_t nPrioWorkers;
     size_t jobQueueDepth;
+    size_t jobQueueDepthMax;
+    unsigned long long jobsCompleted;
+    unsigned long long busyTime;
+    unsigned long long queueWaitTime;
     virTypedParameterPtr tmpparams = NULL;
 
     virCheckFlags(0, -1);
@@ -93,7 +97,11 @@ adminServerGetThreadPoolParameters(virNetServerPtr srv,
     if (virNetServerGetThreadPoolParameters(srv, &minWorkers, &maxWorkers,
                                             &nWorkers, &freeWorkers,
                                             &nPrioWorkers,
-                                            &jobQueueDepth) < 0) {
+                                            &jobQueueDepth,
+                                            &jobQueueDepthMax,
+                                            &jobsCompleted,
+                                            &busyTime,
+                                            &queueWaitTime) < 0) {
         virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
                        _("Unable to retrieve threadpool parameters"));
         goto cleanup;
@@ -129,6 +137,26 @@ adminServerGetThreadPoolParameters(virNetServerPtr srv,
                               jobQueueDepth) < 0)
         goto cleanup;
 
+    if (virTypedParamsAddUInt(&tmpparams, nparams,
+                              &maxparams, VIR_THREADPOOL_JOB_QUEUE_DEPTH_MAX,
+                              jobQueueDepthMax) < 0)
+        goto cleanup;
+
+    if (virTypedParamsAddULLong(&tmpparams, nparams,
+                                &maxparams, VIR_THREADPOOL_JOBS_COMPLETED,
+                                jobsCompleted) < 0)
+        goto cleanup;
+
+    if (virTypedParamsAddULLong(&tmpparams, nparams,
+                                &maxparams, VIR_THREADPOOL_BUSY_TIME,
+                                busyTime) < 0)
+        goto cleanup;
+
+    if (virTypedParamsAddULLong(&tmpparams, nparams,
+                                &maxparams, VIR_THREADPOOL_JOB_QUEUE_WAIT_TIME,
+                                queueWaitTime) < 0)
+        goto cleanup;
+
     *params = tmpparams;
     tmpparams = NULL;
     ret = 0;
@@ -345,6 +373,11 @@ adminServerGetClientLimits(virNetServerPtr srv,
                               virNetServerGetCurrentUnauthClients(srv)) < 0)
         goto cleanup;
 
+    if (virTypedParamsAddUInt(&tmpparams, nparams, &maxparams,
+                              VIR_SERVER_CLIENT_REQUESTS_PER_SEC,
+                              virNetServerGetClientRateLimit(srv)) < 0)
+        goto cleanup;
+
     *params = tmpparams;
     tmpparams = NULL;
     ret = 0;
@@ -362,6 +395,7 @@ adminServerSetClientLimits(virNetServerPtr srv,
 {
     long long int maxClients = -1;
     long long int maxClientsUnauth = -1;
+    long long int clientRateLimit = -1;
     virTypedParameterPtr param = NULL;
 
     virCheckFlags(0, -1);
@@ -371,6 +405,8 @@ adminServerSetClientLimits(virNetServerPtr srv,
                                VIR_TYPED_PARAM_UINT,
                                VIR_SERVER_CLIENTS_UNAUTH_MAX,
                                VIR_TYPED_PARAM_UINT,
+                               VIR_SERVER_CLIENT_REQUESTS_PER_SEC,
+                               VIR_TYPED_PARAM_UINT,
                                NULL) < 0)
         return -1;
 
@@ -382,8 +418,13 @@ adminServerSetClientLimits(virNetServerPtr srv,
                                    VIR_SERVER_CLIENTS_UNAUTH_MAX)))
         maxClientsUnauth = param->value.ui;
 
+    if ((param = virTypedParamsGet(params, nparams,
+                                   VIR_SERVER_CLIENT_REQUESTS_PER_SEC)))
+        clientRateLimit = param->value.ui;
+
     if (virNetServerSetClientLimits(srv, maxClients,
-                                    maxClientsUnauth) < 0)
+                                    maxClientsUnauth,
+                                    clientRateLimit) < 0)
         return -1;
 
     return 0;
@@ -151,6 +151,7 @@ daemonConfigNew(bool privileged ATTRIBUTE_UNUSED)
     data->max_anonymous_clients = 20;
 
     data->prio_workers = 5;
+    data->prio_promote_delay = 0;
 
     data->max_requests = 20;
     data->max_client_requests = 5;
@@ -344,6 +345,8 @@ daemonConfigLoadOptions(struct daemonConfig *data,
 
     if (virConfGetValueUInt(conf, "prio_workers", &data->prio_workers) < 0)
         goto error;
+    if (virConfGetValueUInt(conf, "prio_promote_delay", &data->prio_promote_delay) < 0)
+        goto error;
 
     if (virConfGetValueUInt(conf, "max_requests", &data->max_requests) < 0)
         goto error;
@@ -70,6 +70,7 @@ struct daemonConfig {
     unsigned int max_anonymous_clients;
 
     unsigned int prio_workers;
+    unsigned int prio_promote_delay;
 
     unsigned int max_requests;
     unsigned int max_client_requests;
@@ -50,10 +50,12 @@
 #include "virconf.h"
 #include "virnetlink.h"
 #include "virnetdaemon.h"
+#include "vireventpoll.h"
 #include "remote.h"
 #include "virhook.h"
 #include "viraudit.h"
 #include "virstring.h"
+#include "virsysinfo.h"
 #include "locking/lock_manager.h"
 #include "viraccessmanager.h"
 #include "virutil.h"
@@ -850,6 +852,104 @@ static void daemonReloadHandler(virNetDaemonPtr dmn ATTRIBUTE_UNUSED,
         VIR_WARN("Error while reloading drivers");
 }
 
+static void daemonAllocStatsIterator(int domcode,
+                                     unsigned long long allocs,
+                                     unsigned long long bytes,
+                                     void *opaque ATTRIBUTE_UNUSED)
+{
+    VIR_INFO("Allocations from '%s': count %llu bytes %llu",
+             NULLSTR(virErrorDomainTypeToString(domcode)),
+             allocs, bytes);
+}
+
+static void daemonAllocStatsHandler(virNetDaemonPtr dmn ATTRIBUTE_UNUSED,
+                                    siginfo_t *sig ATTRIBUTE_UNUSED,
+                                    void *opaque ATTRIBUTE_UNUSED)
+{
+    static bool active;
+
+    if (!active) {
+        if (virAllocStatsEnable() < 0) {
+            VIR_WARN("Unable to enable allocation accounting");
+            return;
+        }
+        active = true;
+        VIR_INFO("Allocation accounting enabled on SIGUSR2; "
+                 "send SIGUSR2 again to report and stop");
+    } else {
+        virAllocStatsDisable();
+        active = false;
+        VIR_INFO("Allocation accounting disabled on SIGUSR2");
+        virAllocStatsWalk(daemonAllocStatsIterator, NULL);
+    }
+}
+
+static void daemonRPCStatsIterator(unsigned program,
+                                   int procedure,
+                                   unsigned long long calls,
+                                   unsigned long long totalMs,
+                                   unsigned long long maxMs,
+                                   void *opaque)
+{
+    const char *name = opaque;
+
+    VIR_INFO("RPC stats for %s proc %d: calls %llu avg %llums max %llums "
+             "(program %u)",
+             name, procedure, calls, calls ? totalMs / calls : 0, maxMs,
+             program);
+}
+
+static void daemonRPCStatsHandler(virNetDaemonPtr dmn,
+                                  siginfo_t *sig ATTRIBUTE_UNUSED,
+                                  void *opaque ATTRIBUTE_UNUSED)
+{
+    virNetServerPtr srv;
+    size_t i;
+    struct {
+        virNetServerProgramPtr prog;
+        const char *name;
+    } progs[] = {
+        { remoteProgram, "remote" },
+        { qemuProgram, "qemu" },
+        { lxcProgram, "lxc" },
+        { adminProgram, "admin" },
+    };
+
+    VIR_INFO("Dumping RPC statistics on SIGUSR1");
+
+    for (i = 0; i < ARRAY_CARDINALITY(progs); i++) {
+        if (progs[i].prog)
+            virNetServerProgramCallStatsWalk(progs[i].prog,
+                                             daemonRPCStatsIterator,
+                                             (void *)progs[i].name);
+    }
+
+    if ((srv = virNetDaemonGetServer(dmn, "libvirtd"))) {
+        size_t minWorkers = 0, maxWorkers = 0, nWorkers = 0;
+        size_t freeWorkers = 0, nPrioWorkers = 0;
+        size_t jobQueueDepth = 0, jobQueueDepthMax = 0;
+        unsigned long long jobsCompleted = 0, busyTime = 0, queueWaitTime = 0;
+
+        if (virNetServerGetThreadPoolParameters(srv, &minWorkers, &maxWorkers,
+                                                &nWorkers, &freeWorkers,
+                                                &nPrioWorkers,
+                                                &jobQueueDepth,
+                                                &jobQueueDepthMax,
+                                                &jobsCompleted,
+                                                &busyTime,
+                                                &queueWaitTime) == 0)
+            VIR_INFO("Worker pool: workers %zu (min %zu max %zu prio %zu "
+                     "free %zu) queue depth %zu (max %zu) jobs %llu "
+                     "busy %llums queued %llums",
+                     nWorkers, minWorkers, maxWorkers, nPrioWorkers,
+                     freeWorkers, jobQueueDepth, jobQueueDepthMax,
+                     jobsCompleted, busyTime, queueWaitTime);
+        virObjectUnref(srv);
+    }
+
+    virEventPollDispatchStatsLog();
+}
+
 static int daemonSetupSignals(virNetDaemonPtr dmn)
 {
     if (virNetDaemonAddSignalHandler(dmn, SIGINT, daemonShutdownHandler, NULL) < 0)
@@ -860,6 +960,10 @@ static int daemonSetupSignals(virNetDaemonPtr dmn)
         return -1;
     if (virNetDaemonAddSignalHandler(dmn, SIGHUP, daemonReloadHandler, NULL) < 0)
         return -1;
+    if (virNetDaemonAddSignalHandler(dmn, SIGUSR2, daemonAllocStatsHandler, NULL) < 0)
+        return -1;
+    if (virNetDaemonAddSignalHandler(dmn, SIGUSR1, daemonRPCStatsHandler, NULL) < 0)
+        return -1;
     return 0;
 }
 
@@ -952,6 +1056,11 @@ static void daemonRunStateInit(void *opaque)
        we're done so clients get a chance to connect */
     daemonInhibitCallback(true, dmn);
 
+    /* Start collecting the host sysinfo in the background; the drivers
+     * initialized below will pick up the parsed result from the cache
+     * instead of each execing dmidecode themselves */
+    ignore_value(virSysinfoStartBackgroundRead());
+
     /* Start the stateful HV drivers
      * This is deliberately done after telling the parent process
      * we're ready, since it can take a long time and this will
@@ -1437,6 +1546,8 @@ int main(int argc, char **argv) {
         goto cleanup;
     }
 
+    virNetServerSetJobPromoteDelay(srv, config->prio_promote_delay);
+
     if (!(dmn = virNetDaemonNew()) ||
         virNetDaemonAddServer(dmn, srv) < 0) {
         ret = VIR_DAEMON_ERR_INIT;
@@ -1598,8 +1709,13 @@ int main(int argc, char **argv) {
     }
 
 #if defined(__linux__) && defined(NETLINK_ROUTE)
-    /* Register the netlink event service for NETLINK_ROUTE */
-    if (virNetlinkEventServiceStart(NETLINK_ROUTE, 0) < 0) {
+# ifndef RTNLGRP_LINK
+#  define RTNLGRP_LINK 1
+# endif
+    /* Register the netlink event service for NETLINK_ROUTE, joining
+     * the link multicast group so that interface state changes are
+     * delivered to subscribed callbacks */
+    if (virNetlinkEventServiceStart(NETLINK_ROUTE, RTNLGRP_LINK) < 0) {
         ret = VIR_DAEMON_ERR_NETWORK;
         goto cleanup;
     }
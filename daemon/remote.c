@@ -121,6 +121,13 @@ remoteDispatchObjectEventSend(virNetServerClientPtr client,
                               xdrproc_t proc,
                               void *data);
 
+static void
+remoteDispatchObjectEventSendShared(virNetServerClientPtr client,
+                                    virNetServerProgramPtr program,
+                                    int procnr,
+                                    int callbackID,
+                                    virNetMessagePayloadPtr payload);
+
 static void
 remoteEventCallbackFree(void *opaque)
 {
@@ -262,6 +269,26 @@ remoteRelayDomainQemuMonitorEventCheckACL(virNetServerClientPtr client,
 }
 
 
+/* One lifecycle event fans out to every subscribed client via
+ * consecutive relay calls from the event dispatch timer, all in the
+ * same thread. Cache the encoded payload of the most recent event so
+ * it is serialized once however many clients are listening; in the
+ * callback variant of the protocol only the leading callbackID
+ * differs per client and that is encoded into each message buffer
+ * separately, ahead of the shared body. Everything that
+ * make_nonnull_domain encodes - id and name as well as uuid - must be
+ * part of the validity check, since the same domain re-emits an
+ * identical (uuid, event, detail) triple with a new id on every boot
+ * and a new name after a rename. */
+static struct {
+    unsigned char uuid[VIR_UUID_BUFLEN];
+    char *name;
+    int id;
+    int event;
+    int detail;
+    virNetMessagePayloadPtr payload;
+} eventLifecycleCache;
+
 static int
 remoteRelayDomainEventLifecycle(virConnectPtr conn,
                                 virDomainPtr dom,
@@ -270,7 +297,6 @@ remoteRelayDomainEventLifecycle(virConnectPtr conn,
                                 void *opaque)
 {
     daemonClientEventCallbackPtr callback = opaque;
-    remote_domain_event_lifecycle_msg data;
 
     if (callback->callbackID < 0 ||
         !remoteRelayDomainEventCheckACL(callback->client, conn, dom))
@@ -279,25 +305,54 @@ remoteRelayDomainEventLifecycle(virConnectPtr conn,
     VIR_DEBUG("Relaying domain lifecycle event %d %d, callback %d legacy %d",
               event, detail, callback->callbackID, callback->legacy);
 
-    /* build return data */
-    memset(&data, 0, sizeof(data));
-    make_nonnull_domain(&data.dom, dom);
-    data.event = event;
-    data.detail = detail;
+    if (!eventLifecycleCache.payload ||
+        memcmp(eventLifecycleCache.uuid, dom->uuid, VIR_UUID_BUFLEN) ||
+        STRNEQ_NULLABLE(eventLifecycleCache.name, dom->name) ||
+        eventLifecycleCache.id != dom->id ||
+        eventLifecycleCache.event != event ||
+        eventLifecycleCache.detail != detail) {
+        remote_domain_event_lifecycle_msg data;
+        virNetMessagePayloadPtr payload;
+        char *name;
+
+        /* build return data */
+        memset(&data, 0, sizeof(data));
+        make_nonnull_domain(&data.dom, dom);
+        data.event = event;
+        data.detail = detail;
+
+        payload = virNetMessagePayloadNewEncoded(
+            (xdrproc_t)xdr_remote_domain_event_lifecycle_msg, &data);
+        xdr_free((xdrproc_t)xdr_remote_domain_event_lifecycle_msg,
+                 (char *)&data);
+        if (!payload)
+            return -1;
+
+        if (VIR_STRDUP(name, dom->name) < 0) {
+            virNetMessagePayloadUnref(payload);
+            return -1;
+        }
+
+        virNetMessagePayloadUnref(eventLifecycleCache.payload);
+        eventLifecycleCache.payload = payload;
+        memcpy(eventLifecycleCache.uuid, dom->uuid, VIR_UUID_BUFLEN);
+        VIR_FREE(eventLifecycleCache.name);
+        eventLifecycleCache.name = name;
+        eventLifecycleCache.id = dom->id;
+        eventLifecycleCache.event = event;
+        eventLifecycleCache.detail = detail;
+    }
 
     if (callback->legacy) {
-        remoteDispatchObjectEventSend(callback->client, remoteProgram,
-                                      REMOTE_PROC_DOMAIN_EVENT_LIFECYCLE,
-                                      (xdrproc_t)xdr_remote_domain_event_lifecycle_msg,
-                                      &data);
+        remoteDispatchObjectEventSendShared(callback->client, remoteProgram,
+                                            REMOTE_PROC_DOMAIN_EVENT_LIFECYCLE,
+                                            -1,
+                                            eventLifecycleCache.payload);
     } else {
-        remote_domain_event_callback_lifecycle_msg msg = { callback->callbackID,
-                                                           data };
-
-        remoteDispatchObjectEventSend(callback->client, remoteProgram,
-                                      REMOTE_PROC_DOMAIN_EVENT_CALLBACK_LIFECYCLE,
-                                      (xdrproc_t)xdr_remote_domain_event_callback_lifecycle_msg,
-                                      &msg);
+        remoteDispatchObjectEventSendShared(callback->client, remoteProgram,
+                                            REMOTE_PROC_DOMAIN_EVENT_CALLBACK_LIFECYCLE,
+                                            callback->callbackID,
+                                            eventLifecycleCache.payload);
     }
 
     return 0;
@@ -3867,6 +3922,49 @@ remoteDispatchObjectEventSend(virNetServerClientPtr client,
     xdr_free(proc, data);
 }
 
+/* Queue an event whose body was encoded once into @payload for
+ * delivery to @client, optionally prefixing the per-client
+ * @callbackID (pass -1 for legacy procedures which lack one). The
+ * shared body is referenced, not copied. */
+static void
+remoteDispatchObjectEventSendShared(virNetServerClientPtr client,
+                                    virNetServerProgramPtr program,
+                                    int procnr,
+                                    int callbackID,
+                                    virNetMessagePayloadPtr payload)
+{
+    virNetMessagePtr msg;
+
+    if (!(msg = virNetMessageNew(false)))
+        goto cleanup;
+
+    msg->header.prog = virNetServerProgramGetID(program);
+    msg->header.vers = virNetServerProgramGetVersion(program);
+    msg->header.proc = procnr;
+    msg->header.type = VIR_NET_MESSAGE;
+    msg->header.serial = 1;
+    msg->header.status = VIR_NET_OK;
+
+    if (virNetMessageEncodeHeader(msg) < 0)
+        goto cleanup;
+
+    if (callbackID >= 0 &&
+        virNetMessageEncodePayload(msg, (xdrproc_t)xdr_int, &callbackID) < 0)
+        goto cleanup;
+
+    if (virNetMessageEncodePayloadShared(msg, payload) < 0)
+        goto cleanup;
+
+    VIR_DEBUG("Queue event %d %zu+%zu", procnr,
+              msg->bufferLength, msg->externalLength);
+    virNetServerClientSendMessage(client, msg);
+
+    return;
+
+ cleanup:
+    virNetMessageFree(msg);
+}
+
 static int
 remoteDispatchSecretGetValue(virNetServerPtr server ATTRIBUTE_UNUSED,
                              virNetServerClientPtr client ATTRIBUTE_UNUSED,
@@ -52,9 +52,24 @@ struct daemonClientStream {
     virNetMessagePtr rx;
     bool tx;
 
+    /* Buffer for reads from the stream, kept across events so that
+     * chatty low-bandwidth streams (e.g. consoles) don't allocate
+     * the maximum payload size to relay a few bytes. Grows while
+     * reads keep filling it; NULL after the buffer was handed over
+     * to an outgoing message */
+    char *buffer;
+    size_t bufferLen;
+
     daemonClientStreamPtr next;
 };
 
+/* Initial size of the per-stream read buffer */
+#define DAEMON_STREAM_BUFFER_MIN 4096
+
+/* Reads at least this large hand the buffer over to the outgoing
+ * message rather than copying the data into it */
+#define DAEMON_STREAM_STEAL_MIN (64 * 1024)
+
 static int
 daemonStreamHandleWrite(virNetServerClientPtr client,
                         daemonClientStream *stream);
@@ -339,6 +354,7 @@ daemonCreateClientStream(virNetServerClientPtr client,
     stream->serial = header->serial;
     stream->filterID = -1;
     stream->st = st;
+    stream->bufferLen = DAEMON_STREAM_BUFFER_MIN;
 
     return stream;
 }
@@ -386,6 +402,7 @@ int daemonFreeClientStream(virNetServerClientPtr client,
     }
 
     virObjectUnref(stream->st);
+    VIR_FREE(stream->buffer);
     VIR_FREE(stream);
 
     return ret;
@@ -729,8 +746,6 @@ daemonStreamHandleRead(virNetServerClientPtr client,
 {
     virNetMessagePtr msg = NULL;
     virNetMessageError rerr;
-    char *buffer;
-    size_t bufferLen = VIR_NET_MESSAGE_LEGACY_PAYLOAD_MAX;
     int ret = -1;
     int rv;
 
@@ -751,13 +766,14 @@ daemonStreamHandleRead(virNetServerClientPtr client,
 
     memset(&rerr, 0, sizeof(rerr));
 
-    if (VIR_ALLOC_N(buffer, bufferLen) < 0)
+    if (!stream->buffer &&
+        VIR_ALLOC_N(stream->buffer, stream->bufferLen) < 0)
         return -1;
 
     if (!(msg = virNetMessageNew(false)))
-        goto cleanup;
+        return -1;
 
-    rv = virStreamRecv(stream->st, buffer, bufferLen);
+    rv = virStreamRecv(stream->st, stream->buffer, stream->bufferLen);
     if (rv == -2) {
         /* Should never get this, since we're only called when we know
          * we're readable, but hey things change... */
@@ -778,19 +794,45 @@ daemonStreamHandleRead(virNetServerClientPtr client,
         msg->cb = daemonStreamMessageFinished;
         msg->opaque = stream;
         stream->refs++;
-        if (virNetServerProgramSendStreamData(remoteProgram,
-                                              client,
-                                              msg,
-                                              stream->procedure,
-                                              stream->serial,
-                                              buffer, rv) < 0)
-            goto cleanup;
+        if (rv >= DAEMON_STREAM_STEAL_MIN) {
+            /* Hand the buffer itself over to the message, so the
+             * data is written to the socket without another copy */
+            if (virNetServerProgramSendStreamDataSteal(remoteProgram,
+                                                       client,
+                                                       msg,
+                                                       stream->procedure,
+                                                       stream->serial,
+                                                       &stream->buffer,
+                                                       rv) < 0)
+                goto cleanup;
+        } else {
+            /* Small payloads are copied into the message instead,
+             * so the buffer survives for the next event */
+            if (virNetServerProgramSendStreamData(remoteProgram,
+                                                  client,
+                                                  msg,
+                                                  stream->procedure,
+                                                  stream->serial,
+                                                  stream->buffer, rv) < 0)
+                goto cleanup;
+        }
         msg = NULL;
+
+        /* If the read filled the buffer, use a larger one for the
+         * next event. Bulk streams thus ramp up to full-sized
+         * packets within a few events, while console streams stay
+         * on the small initial buffer */
+        if (rv > 0 && (size_t)rv == stream->bufferLen &&
+            stream->bufferLen < VIR_NET_MESSAGE_LEGACY_PAYLOAD_MAX) {
+            VIR_FREE(stream->buffer);
+            stream->bufferLen *= 4;
+            if (stream->bufferLen > VIR_NET_MESSAGE_LEGACY_PAYLOAD_MAX)
+                stream->bufferLen = VIR_NET_MESSAGE_LEGACY_PAYLOAD_MAX;
+        }
     }
 
     ret = 0;
  cleanup:
-    VIR_FREE(buffer);
     virNetMessageFree(msg);
     return ret;
 }
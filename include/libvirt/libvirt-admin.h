@@ -189,6 +189,54 @@ virAdmServerPtr virAdmConnectLookupServer(virAdmConnectPtr conn,
 
 # define VIR_THREADPOOL_JOB_QUEUE_DEPTH "jobQueueDepth"
 
+/**
+ * VIR_THREADPOOL_JOB_QUEUE_DEPTH_MAX:
+ * Macro for the threadpool jobQueueDepthMax attribute: represents the highest
+ * number of jobs that were waiting in a queue at any one time since the
+ * daemon started, as VIR_TYPED_PARAM_UINT.
+ *
+ * NOTE: This attribute is read-only and any attempt to set it will be denied
+ * by daemon
+ */
+
+# define VIR_THREADPOOL_JOB_QUEUE_DEPTH_MAX "jobQueueDepthMax"
+
+/**
+ * VIR_THREADPOOL_JOBS_COMPLETED:
+ * Macro for the threadpool jobsCompleted attribute: represents the total
+ * number of jobs finished by the workers since the daemon started, as
+ * VIR_TYPED_PARAM_ULLONG.
+ *
+ * NOTE: This attribute is read-only and any attempt to set it will be denied
+ * by daemon
+ */
+
+# define VIR_THREADPOOL_JOBS_COMPLETED "jobsCompleted"
+
+/**
+ * VIR_THREADPOOL_BUSY_TIME:
+ * Macro for the threadpool busyTime attribute: represents the total time in
+ * milliseconds the workers have spent executing jobs since the daemon
+ * started, as VIR_TYPED_PARAM_ULLONG.
+ *
+ * NOTE: This attribute is read-only and any attempt to set it will be denied
+ * by daemon
+ */
+
+# define VIR_THREADPOOL_BUSY_TIME "busyTime"
+
+/**
+ * VIR_THREADPOOL_JOB_QUEUE_WAIT_TIME:
+ * Macro for the threadpool queueWaitTime attribute: represents the total time
+ * in milliseconds that finished jobs have spent waiting in a queue before a
+ * worker picked them up, as VIR_TYPED_PARAM_ULLONG.
+ *
+ * NOTE: This attribute is read-only and any attempt to set it will be denied
+ * by daemon
+ */
+
+# define VIR_THREADPOOL_JOB_QUEUE_WAIT_TIME "queueWaitTime"
+
 /* Tunables for a server workerpool */
 int virAdmServerGetThreadPoolParameters(virAdmServerPtr srv,
                                         virTypedParameterPtr *params,
@@ -394,6 +442,18 @@ int virAdmClientClose(virAdmClientPtr client, unsigned int flags);
 
 # define VIR_SERVER_CLIENTS_UNAUTH_CURRENT "nclients_unauth"
 
+/**
+ * VIR_SERVER_CLIENT_REQUESTS_PER_SEC:
+ * Macro for per-server client_requests_per_sec limit: represents the maximum
+ * number of RPC requests the server accepts for processing from any one
+ * client per second, as VIR_TYPED_PARAM_UINT. A value of 0 means unlimited.
+ * A client may burst up to the limit at once; requests beyond that are left
+ * on the client's socket until tokens are replenished, so other clients'
+ * requests keep reaching the workers.
+ */
+
+# define VIR_SERVER_CLIENT_REQUESTS_PER_SEC "client_requests_per_sec"
+
 int virAdmServerGetClientLimits(virAdmServerPtr srv,
                                 virTypedParameterPtr *params,
                                 int *nparams,
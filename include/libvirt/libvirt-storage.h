@@ -328,6 +328,9 @@ const char*             virStorageVolGetKey             (virStorageVolPtr vol);
 typedef enum {
     VIR_STORAGE_VOL_CREATE_PREALLOC_METADATA = 1 << 0,
     VIR_STORAGE_VOL_CREATE_REFLINK = 1 << 1, /* perform a btrfs lightweight copy */
+    VIR_STORAGE_VOL_CREATE_NO_WAIT = 1 << 2, /* return before the volume build
+                                                has finished; a pool refresh
+                                                event signals completion */
 } virStorageVolCreateFlags;
 
 virStorageVolPtr        virStorageVolCreateXML          (virStoragePoolPtr pool,
@@ -337,6 +340,18 @@ virStorageVolPtr        virStorageVolCreateXMLFrom      (virStoragePoolPtr pool,
                                                          const char *xmldesc,
                                                          virStorageVolPtr clonevol,
                                                          unsigned int flags);
+typedef enum {
+    VIR_STORAGE_VOL_DOWNLOAD_BYPASS_CACHE = 1 << 0, /* read the volume
+                                                       bypassing the file
+                                                       system cache */
+} virStorageVolDownloadFlags;
+
+typedef enum {
+    VIR_STORAGE_VOL_UPLOAD_BYPASS_CACHE = 1 << 0, /* write the volume
+                                                     bypassing the file
+                                                     system cache */
+} virStorageVolUploadFlags;
+
 int                     virStorageVolDownload           (virStorageVolPtr vol,
                                                          virStreamPtr stream,
                                                          unsigned long long offset,
@@ -55,6 +55,7 @@ AC_DEFUN([LIBVIRT_CHECK_GNUTLS],[
     ]])
 
     AC_CHECK_FUNC([gnutls_rnd])
+    AC_CHECK_FUNCS([gnutls_record_cork])
     AC_CHECK_FUNC([gnutls_cipher_encrypt])
   fi
 ])
@@ -22,12 +22,16 @@
 
 #include "viraccessdriverpolkit.h"
 #include "viralloc.h"
+#include "virbuffer.h"
 #include "vircommand.h"
+#include "virhash.h"
 #include "virlog.h"
 #include "virprocess.h"
 #include "virerror.h"
 #include "virpolkit.h"
 #include "virstring.h"
+#include "virthread.h"
+#include "virtime.h"
 
 #define VIR_FROM_THIS VIR_FROM_ACCESS
 
@@ -39,16 +43,67 @@ VIR_LOG_INIT("access.accessdriverpolkit");
 
 #define VIR_ACCESS_DRIVER_POLKIT_ACTION_PREFIX "org.libvirt.api"
 
+/* How long in milliseconds a cached authorization result is served
+ * before polkit is queried again for the same caller, action and
+ * object. Changes to the polkit rules thus take effect for already
+ * connected clients after at most this delay. */
+#define VIR_ACCESS_DRIVER_POLKIT_CACHE_TTL 15000
+
+/* Once the cache holds this many entries, expired ones are swept out
+ * before inserting another. The key includes the client pid and start
+ * time, so without the sweep every short-lived client would leave
+ * behind entries which can never be hit again. */
+#define VIR_ACCESS_DRIVER_POLKIT_CACHE_MAX_SIZE 128
+
 typedef struct _virAccessDriverPolkitPrivate virAccessDriverPolkitPrivate;
 typedef virAccessDriverPolkitPrivate *virAccessDriverPolkitPrivatePtr;
 
 struct _virAccessDriverPolkitPrivate {
     bool ignore;
+
+    virMutex lock;
+    /* Map of action + caller identity + object attributes to
+     * virAccessDriverPolkitCacheEntry, so that repeated identical
+     * checks don't each query polkit. Protected by @lock */
+    virHashTablePtr cache;
+};
+
+typedef struct _virAccessDriverPolkitCacheEntry virAccessDriverPolkitCacheEntry;
+typedef virAccessDriverPolkitCacheEntry *virAccessDriverPolkitCacheEntryPtr;
+
+struct _virAccessDriverPolkitCacheEntry {
+    int result; /* 1 == allowed, 0 == denied; errors are never cached */
+    unsigned long long when; /* Time the verdict was obtained from polkit */
 };
 
 
-static void virAccessDriverPolkitCleanup(virAccessManagerPtr manager ATTRIBUTE_UNUSED)
+static int virAccessDriverPolkitSetup(virAccessManagerPtr manager)
 {
+    virAccessDriverPolkitPrivatePtr priv = virAccessManagerGetPrivateData(manager);
+
+    if (virMutexInit(&priv->lock) < 0) {
+        virAccessError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("Unable to initialize mutex"));
+        return -1;
+    }
+
+    if (!(priv->cache = virHashCreate(10, virHashValueFree))) {
+        virMutexDestroy(&priv->lock);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+static void virAccessDriverPolkitCleanup(virAccessManagerPtr manager)
+{
+    virAccessDriverPolkitPrivatePtr priv = virAccessManagerGetPrivateData(manager);
+
+    if (priv->cache) {
+        virHashFree(priv->cache);
+        virMutexDestroy(&priv->lock);
+    }
 }
 
 
@@ -112,13 +167,55 @@ virAccessDriverPolkitGetCaller(const char *actionid,
 }
 
 
+static char *
+virAccessDriverPolkitFormatCacheKey(const char *actionid,
+                                    pid_t pid,
+                                    unsigned long long startTime,
+                                    uid_t uid,
+                                    const char **attrs)
+{
+    virBuffer buf = VIR_BUFFER_INITIALIZER;
+
+    /* The attributes are exposed to the polkit rules, so they must
+     * be part of the key to avoid sharing verdicts across objects */
+    virBufferAsprintf(&buf, "%s %lld %llu %d",
+                      actionid, (long long) pid, startTime, (int) uid);
+    while (attrs && attrs[0] && attrs[1]) {
+        virBufferAsprintf(&buf, " %s=%s", attrs[0], attrs[1]);
+        attrs += 2;
+    }
+
+    if (virBufferCheckError(&buf) < 0)
+        return NULL;
+
+    return virBufferContentAndReset(&buf);
+}
+
+
+static int
+virAccessDriverPolkitCacheEntryExpired(const void *payload,
+                                       const void *name ATTRIBUTE_UNUSED,
+                                       const void *opaque)
+{
+    const virAccessDriverPolkitCacheEntry *entry = payload;
+    const unsigned long long *now = opaque;
+
+    return *now - entry->when >= VIR_ACCESS_DRIVER_POLKIT_CACHE_TTL;
+}
+
+
 static int
-virAccessDriverPolkitCheck(virAccessManagerPtr manager ATTRIBUTE_UNUSED,
+virAccessDriverPolkitCheck(virAccessManagerPtr manager,
                            const char *typename,
                            const char *permname,
                            const char **attrs)
 {
+    virAccessDriverPolkitPrivatePtr priv = virAccessManagerGetPrivateData(manager);
+    virAccessDriverPolkitCacheEntryPtr entry;
     char *actionid = NULL;
+    char *cachekey = NULL;
+    unsigned long long now = 0;
+    bool useCache = false;
     int ret = -1;
     pid_t pid;
     uid_t uid;
@@ -137,6 +234,28 @@ virAccessDriverPolkitCheck(virAccessManagerPtr manager ATTRIBUTE_UNUSED,
     VIR_DEBUG("Check action '%s' for process '%lld' time %lld uid %d",
               actionid, (long long) pid, startTime, uid);
 
+    /* If we can't get a timestamp just skip the cache entirely */
+    if (virTimeMillisNowRaw(&now) == 0) {
+        if (!(cachekey = virAccessDriverPolkitFormatCacheKey(actionid,
+                                                             pid,
+                                                             startTime,
+                                                             uid,
+                                                             attrs)))
+            goto cleanup;
+        useCache = true;
+
+        virMutexLock(&priv->lock);
+        entry = virHashLookup(priv->cache, cachekey);
+        if (entry &&
+            now - entry->when < VIR_ACCESS_DRIVER_POLKIT_CACHE_TTL) {
+            ret = entry->result;
+            virMutexUnlock(&priv->lock);
+            VIR_DEBUG("Cached result %d for action '%s'", ret, actionid);
+            goto cleanup;
+        }
+        virMutexUnlock(&priv->lock);
+    }
+
     rv = virPolkitCheckAuth(actionid,
                             pid,
                             startTime,
@@ -154,7 +273,29 @@ virAccessDriverPolkitCheck(virAccessManagerPtr manager ATTRIBUTE_UNUSED,
         }
     }
 
+    /* Only definitive verdicts are cached; errors talking to polkit
+     * may be transient and must be retried on the next check */
+    if (useCache && ret >= 0) {
+        virMutexLock(&priv->lock);
+        if (virHashSize(priv->cache) >= VIR_ACCESS_DRIVER_POLKIT_CACHE_MAX_SIZE)
+            virHashRemoveSet(priv->cache,
+                             virAccessDriverPolkitCacheEntryExpired,
+                             &now);
+        entry = virHashLookup(priv->cache, cachekey);
+        if (entry) {
+            entry->result = ret;
+            entry->when = now;
+        } else if (VIR_ALLOC_QUIET(entry) == 0) {
+            entry->result = ret;
+            entry->when = now;
+            if (virHashAddEntry(priv->cache, cachekey, entry) < 0)
+                VIR_FREE(entry);
+        }
+        virMutexUnlock(&priv->lock);
+    }
+
  cleanup:
+    VIR_FREE(cachekey);
     VIR_FREE(actionid);
     return ret;
 }
@@ -402,6 +543,7 @@ virAccessDriverPolkitCheckStorageVol(virAccessManagerPtr manager,
 virAccessDriver accessDriverPolkit = {
     .privateDataLen = sizeof(virAccessDriverPolkitPrivate),
     .name = "polkit",
+    .setup = virAccessDriverPolkitSetup,
     .cleanup = virAccessDriverPolkitCleanup,
     .checkConnect = virAccessDriverPolkitCheckConnect,
     .checkDomain = virAccessDriverPolkitCheckDomain,
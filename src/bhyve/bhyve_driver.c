@@ -1247,7 +1247,7 @@ bhyveStateInitialize(bool privileged,
     if (!(bhyve_driver->domainEventState = virObjectEventStateNew()))
         goto cleanup;
 
-    bhyve_driver->hostsysinfo = virSysinfoRead();
+    bhyve_driver->hostsysinfo = virSysinfoReadCached();
 
     if (virFileMakePath(BHYVE_LOG_DIR) < 0) {
         virReportSystemError(errno,
@@ -2802,6 +2802,8 @@ static void virDomainObjDispose(void *obj)
     virCondDestroy(&dom->cond);
     virDomainDefFree(dom->def);
     virDomainDefFree(dom->newDef);
+    VIR_FREE(dom->cachedXML);
+    VIR_FREE(dom->statusXML);
 
     if (dom->privateDataFreeFunc)
         (dom->privateDataFreeFunc)(dom->privateData);
@@ -2922,6 +2924,82 @@ void virDomainObjAssignDef(virDomainObjPtr domain,
             domain->def = def;
         }
     }
+
+    virDomainObjDefModified(domain);
+}
+
+
+/**
+ * virDomainObjDefModified:
+ * @domain: domain object
+ *
+ * Declare that one of the definitions of @domain was replaced or
+ * mutated in place. Invalidates any cached formatted XML. The conf
+ * helpers which swap definitions call this themselves; drivers
+ * modifying a definition directly must call it before relying on
+ * virDomainObjGetCachedXML().
+ */
+void
+virDomainObjDefModified(virDomainObjPtr domain)
+{
+    domain->defGeneration++;
+    VIR_FREE(domain->cachedXML);
+    domain->cachedXMLDef = NULL;
+}
+
+
+/**
+ * virDomainObjGetCachedXML:
+ * @domain: domain object
+ * @def: definition the caller is about to format
+ * @flags: formatting flags the caller would pass
+ *
+ * Returns a copy of the previously cached formatted XML if it was
+ * produced from the same definition with the same flags and no
+ * modification was declared since, or NULL on a cache miss.
+ */
+char *
+virDomainObjGetCachedXML(virDomainObjPtr domain,
+                         virDomainDefPtr def,
+                         unsigned int flags)
+{
+    char *xml;
+
+    if (!domain->cachedXML ||
+        domain->cachedXMLDef != def ||
+        domain->cachedXMLFlags != flags ||
+        domain->cachedXMLGeneration != domain->defGeneration)
+        return NULL;
+
+    if (VIR_STRDUP(xml, domain->cachedXML) < 0)
+        return NULL;
+
+    return xml;
+}
+
+
+/**
+ * virDomainObjSetCachedXML:
+ * @domain: domain object
+ * @def: definition @xml was formatted from
+ * @flags: formatting flags used to produce @xml
+ * @xml: the formatted document
+ *
+ * Remember @xml so a later virDomainObjGetCachedXML() with the same
+ * definition and flags can skip re-formatting it. Failure to copy
+ * the document merely leaves the cache empty.
+ */
+void
+virDomainObjSetCachedXML(virDomainObjPtr domain,
+                         virDomainDefPtr def,
+                         unsigned int flags,
+                         const char *xml)
+{
+    VIR_FREE(domain->cachedXML);
+    ignore_value(VIR_STRDUP_QUIET(domain->cachedXML, xml));
+    domain->cachedXMLDef = def;
+    domain->cachedXMLFlags = flags;
+    domain->cachedXMLGeneration = domain->defGeneration;
 }
 
 
@@ -3005,12 +3083,15 @@ virDomainObjWaitUntil(virDomainObjPtr vm,
  * @param caps pointer to capabilities info
  * @param xmlopt pointer to XML parser configuration object
  * @param domain domain object pointer
+ * @param parseOpaque driver data to pass to the post parse callbacks,
+ *                    saving them from re-deriving it, may be NULL
  * @return 0 on success, -1 on failure
  */
 int
 virDomainObjSetDefTransient(virCapsPtr caps,
                             virDomainXMLOptionPtr xmlopt,
-                            virDomainObjPtr domain)
+                            virDomainObjPtr domain,
+                            void *parseOpaque)
 {
     int ret = -1;
 
@@ -3020,9 +3101,11 @@ virDomainObjSetDefTransient(virCapsPtr caps,
     if (domain->newDef)
         return 0;
 
-    if (!(domain->newDef = virDomainDefCopy(domain->def, caps, xmlopt, NULL, false)))
+    if (!(domain->newDef = virDomainDefCopy(domain->def, caps, xmlopt,
+                                            parseOpaque, false)))
         goto out;
 
+    virDomainObjDefModified(domain);
     ret = 0;
  out:
     return ret;
@@ -3044,6 +3127,7 @@ virDomainObjRemoveTransientDef(virDomainObjPtr domain)
     domain->def = domain->newDef;
     domain->def->id = -1;
     domain->newDef = NULL;
+    virDomainObjDefModified(domain);
 }
 
 
@@ -3062,7 +3146,7 @@ virDomainObjGetPersistentDef(virCapsPtr caps,
                              virDomainObjPtr domain)
 {
     if (virDomainObjIsActive(domain) &&
-        virDomainObjSetDefTransient(caps, xmlopt, domain) < 0)
+        virDomainObjSetDefTransient(caps, xmlopt, domain, NULL) < 0)
         return NULL;
 
     if (domain->newDef)
@@ -9095,7 +9179,10 @@ virDomainNetDefParseXML(virDomainXMLOptionPtr xmlopt,
     virNWFilterHashTablePtr filterparams = NULL;
     virDomainActualNetDefPtr actual = NULL;
     xmlNodePtr oldnode = ctxt->node;
-    int ret, val;
+    xmlNodePtr driver_host = NULL;
+    xmlNodePtr driver_guest = NULL;
+    xmlNodePtr tune = NULL;
+    int val;
 
     if (VIR_ALLOC(def) < 0)
         return NULL;
@@ -9214,11 +9301,9 @@ virDomainNetDefParseXML(virDomainXMLOptionPtr xmlopt,
                 address = virXMLPropString(cur, "address");
                 port = virXMLPropString(cur, "port");
                 if (!localaddr && def->type == VIR_DOMAIN_NET_TYPE_UDP) {
-                    xmlNodePtr tmpnode = ctxt->node;
-                    ctxt->node = cur;
-                    localaddr = virXPathString("string(./local/@address)", ctxt);
-                    localport = virXPathString("string(./local/@port)", ctxt);
-                    ctxt->node = tmpnode;
+                    xmlNodePtr local = virXMLChildElement(cur, "local");
+                    localaddr = virXMLPropString(local, "address");
+                    localport = virXMLPropString(local, "port");
                 }
             } else if (!ifname &&
                        xmlStrEqual(cur->name, BAD_CAST "target")) {
@@ -9252,6 +9337,8 @@ virDomainNetDefParseXML(virDomainXMLOptionPtr xmlopt,
                 event_idx = virXMLPropString(cur, "event_idx");
                 queues = virXMLPropString(cur, "queues");
                 rx_queue_size = virXMLPropString(cur, "rx_queue_size");
+                driver_host = virXMLChildElement(cur, "host");
+                driver_guest = virXMLChildElement(cur, "guest");
             } else if (xmlStrEqual(cur->name, BAD_CAST "filterref")) {
                 if (filter) {
                     virReportError(VIR_ERR_XML_ERROR, "%s",
@@ -9284,6 +9371,8 @@ virDomainNetDefParseXML(virDomainXMLOptionPtr xmlopt,
             } else if (xmlStrEqual(cur->name, BAD_CAST "vlan")) {
                 if (virNetDevVlanParse(cur, ctxt, &def->vlan) < 0)
                     goto error;
+            } else if (!tune && xmlStrEqual(cur->name, BAD_CAST "tune")) {
+                tune = cur;
             } else if (xmlStrEqual(cur->name, BAD_CAST "backend")) {
                 char *tmp = NULL;
 
@@ -9645,7 +9734,7 @@ virDomainNetDefParseXML(virDomainXMLOptionPtr xmlopt,
             }
             def->driver.virtio.rx_queue_size = q;
         }
-        if ((str = virXPathString("string(./driver/host/@csum)", ctxt))) {
+        if ((str = virXMLPropString(driver_host, "csum"))) {
             if ((val = virTristateSwitchTypeFromString(str)) <= 0) {
                 virReportError(VIR_ERR_CONFIG_UNSUPPORTED,
                                _("unknown host csum mode '%s'"),
@@ -9655,7 +9744,7 @@ virDomainNetDefParseXML(virDomainXMLOptionPtr xmlopt,
             def->driver.virtio.host.csum = val;
         }
         VIR_FREE(str);
-        if ((str = virXPathString("string(./driver/host/@gso)", ctxt))) {
+        if ((str = virXMLPropString(driver_host, "gso"))) {
             if ((val = virTristateSwitchTypeFromString(str)) <= 0) {
                 virReportError(VIR_ERR_CONFIG_UNSUPPORTED,
                                _("unknown host gso mode '%s'"),
@@ -9665,7 +9754,7 @@ virDomainNetDefParseXML(virDomainXMLOptionPtr xmlopt,
             def->driver.virtio.host.gso = val;
         }
         VIR_FREE(str);
-        if ((str = virXPathString("string(./driver/host/@tso4)", ctxt))) {
+        if ((str = virXMLPropString(driver_host, "tso4"))) {
             if ((val = virTristateSwitchTypeFromString(str)) <= 0) {
                 virReportError(VIR_ERR_CONFIG_UNSUPPORTED,
                                _("unknown host tso4 mode '%s'"),
@@ -9675,7 +9764,7 @@ virDomainNetDefParseXML(virDomainXMLOptionPtr xmlopt,
             def->driver.virtio.host.tso4 = val;
         }
         VIR_FREE(str);
-        if ((str = virXPathString("string(./driver/host/@tso6)", ctxt))) {
+        if ((str = virXMLPropString(driver_host, "tso6"))) {
             if ((val = virTristateSwitchTypeFromString(str)) <= 0) {
                 virReportError(VIR_ERR_CONFIG_UNSUPPORTED,
                                _("unknown host tso6 mode '%s'"),
@@ -9685,7 +9774,7 @@ virDomainNetDefParseXML(virDomainXMLOptionPtr xmlopt,
             def->driver.virtio.host.tso6 = val;
         }
         VIR_FREE(str);
-        if ((str = virXPathString("string(./driver/host/@ecn)", ctxt))) {
+        if ((str = virXMLPropString(driver_host, "ecn"))) {
             if ((val = virTristateSwitchTypeFromString(str)) <= 0) {
                 virReportError(VIR_ERR_CONFIG_UNSUPPORTED,
                                _("unknown host ecn mode '%s'"),
@@ -9695,7 +9784,7 @@ virDomainNetDefParseXML(virDomainXMLOptionPtr xmlopt,
             def->driver.virtio.host.ecn = val;
         }
         VIR_FREE(str);
-        if ((str = virXPathString("string(./driver/host/@ufo)", ctxt))) {
+        if ((str = virXMLPropString(driver_host, "ufo"))) {
             if ((val = virTristateSwitchTypeFromString(str)) <= 0) {
                 virReportError(VIR_ERR_CONFIG_UNSUPPORTED,
                                _("unknown host ufo mode '%s'"),
@@ -9705,7 +9794,7 @@ virDomainNetDefParseXML(virDomainXMLOptionPtr xmlopt,
             def->driver.virtio.host.ufo = val;
         }
         VIR_FREE(str);
-        if ((str = virXPathString("string(./driver/host/@mrg_rxbuf)", ctxt))) {
+        if ((str = virXMLPropString(driver_host, "mrg_rxbuf"))) {
             if ((val = virTristateSwitchTypeFromString(str)) <= 0) {
                 virReportError(VIR_ERR_CONFIG_UNSUPPORTED,
                                _("unknown host mrg_rxbuf mode '%s'"),
@@ -9715,7 +9804,7 @@ virDomainNetDefParseXML(virDomainXMLOptionPtr xmlopt,
             def->driver.virtio.host.mrg_rxbuf = val;
         }
         VIR_FREE(str);
-        if ((str = virXPathString("string(./driver/guest/@csum)", ctxt))) {
+        if ((str = virXMLPropString(driver_guest, "csum"))) {
             if ((val = virTristateSwitchTypeFromString(str)) <= 0) {
                 virReportError(VIR_ERR_CONFIG_UNSUPPORTED,
                                _("unknown guest csum mode '%s'"),
@@ -9725,7 +9814,7 @@ virDomainNetDefParseXML(virDomainXMLOptionPtr xmlopt,
             def->driver.virtio.guest.csum = val;
         }
         VIR_FREE(str);
-        if ((str = virXPathString("string(./driver/guest/@tso4)", ctxt))) {
+        if ((str = virXMLPropString(driver_guest, "tso4"))) {
             if ((val = virTristateSwitchTypeFromString(str)) <= 0) {
                 virReportError(VIR_ERR_CONFIG_UNSUPPORTED,
                                _("unknown guest tso4 mode '%s'"),
@@ -9735,7 +9824,7 @@ virDomainNetDefParseXML(virDomainXMLOptionPtr xmlopt,
             def->driver.virtio.guest.tso4 = val;
         }
         VIR_FREE(str);
-        if ((str = virXPathString("string(./driver/guest/@tso6)", ctxt))) {
+        if ((str = virXMLPropString(driver_guest, "tso6"))) {
             if ((val = virTristateSwitchTypeFromString(str)) <= 0) {
                 virReportError(VIR_ERR_CONFIG_UNSUPPORTED,
                                _("unknown guest tso6 mode '%s'"),
@@ -9745,7 +9834,7 @@ virDomainNetDefParseXML(virDomainXMLOptionPtr xmlopt,
             def->driver.virtio.guest.tso6 = val;
         }
         VIR_FREE(str);
-        if ((str = virXPathString("string(./driver/guest/@ecn)", ctxt))) {
+        if ((str = virXMLPropString(driver_guest, "ecn"))) {
             if ((val = virTristateSwitchTypeFromString(str)) <= 0) {
                 virReportError(VIR_ERR_CONFIG_UNSUPPORTED,
                                _("unknown guest ecn mode '%s'"),
@@ -9755,7 +9844,7 @@ virDomainNetDefParseXML(virDomainXMLOptionPtr xmlopt,
             def->driver.virtio.guest.ecn = val;
         }
         VIR_FREE(str);
-        if ((str = virXPathString("string(./driver/guest/@ufo)", ctxt))) {
+        if ((str = virXMLPropString(driver_guest, "ufo"))) {
             if ((val = virTristateSwitchTypeFromString(str)) <= 0) {
                 virReportError(VIR_ERR_CONFIG_UNSUPPORTED,
                                _("unknown guest ufo mode '%s'"),
@@ -9793,13 +9882,17 @@ virDomainNetDefParseXML(virDomainXMLOptionPtr xmlopt,
         }
     }
 
-    ret = virXPathULong("string(./tune/sndbuf)", ctxt, &def->tune.sndbuf);
-    if (ret >= 0) {
-        def->tune.sndbuf_specified = true;
-    } else if (ret == -2) {
-        virReportError(VIR_ERR_XML_ERROR, "%s",
-                       _("sndbuf must be a positive integer"));
-        goto error;
+    if (tune && (cur = virXMLChildElement(tune, "sndbuf"))) {
+        str = (char *)xmlNodeGetContent(cur);
+        if (str && *str) {
+            if (virStrToLong_ul(str, NULL, 10, &def->tune.sndbuf) < 0) {
+                virReportError(VIR_ERR_XML_ERROR, "%s",
+                               _("sndbuf must be a positive integer"));
+                goto error;
+            }
+            def->tune.sndbuf_specified = true;
+        }
+        VIR_FREE(str);
     }
 
  cleanup:
@@ -24440,9 +24533,21 @@ virDomainSaveStatus(virDomainXMLOptionPtr xmlopt,
     if (!(xml = virDomainObjFormat(xmlopt, obj, caps, flags)))
         goto cleanup;
 
+    /* Saves are triggered by plenty of high frequency events which
+     * often leave the document byte for byte identical; skip the
+     * write + fsync + rename cycle for those */
+    if (STREQ_NULLABLE(obj->statusXML, xml)) {
+        ret = 0;
+        goto cleanup;
+    }
+
     if (virDomainSaveXML(statusDir, obj->def, xml))
         goto cleanup;
 
+    VIR_FREE(obj->statusXML);
+    obj->statusXML = xml;
+    xml = NULL;
+
     ret = 0;
  cleanup:
     VIR_FREE(xml);
@@ -24476,6 +24581,10 @@ virDomainDeleteConfig(const char *configDir,
         goto cleanup;
     }
 
+    /* The status file may just have been removed too, so don't let
+     * a stale copy suppress its next rewrite */
+    VIR_FREE(dom->statusXML);
+
     ret = 0;
 
  cleanup:
@@ -24814,12 +24923,13 @@ virDomainDefCopy(virDomainDefPtr src,
 virDomainDefPtr
 virDomainObjCopyPersistentDef(virDomainObjPtr dom,
                               virCapsPtr caps,
-                              virDomainXMLOptionPtr xmlopt)
+                              virDomainXMLOptionPtr xmlopt,
+                              void *parseOpaque)
 {
     virDomainDefPtr cur;
 
     cur = virDomainObjGetPersistentDef(caps, xmlopt, dom);
-    return virDomainDefCopy(cur, caps, xmlopt, NULL, false);
+    return virDomainDefCopy(cur, caps, xmlopt, parseOpaque, false);
 }
 
 
@@ -25550,6 +25660,8 @@ virDomainObjSetMetadata(virDomainObjPtr vm,
             return -1;
     }
 
+    virDomainObjDefModified(vm);
+
     return 0;
 }
 
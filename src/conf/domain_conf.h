@@ -2357,6 +2357,26 @@ struct _virDomainObj {
 
     unsigned long long original_memlock; /* Original RLIMIT_MEMLOCK, zero if no
                                           * restore will be required later */
+
+    /* Identity of the config file this definition was loaded from,
+     * so a reload can skip re-parsing configs which have not changed
+     * on disk. All zero if the definition did not come from a file. */
+    long long configMtime;
+    unsigned long long configIno;
+    unsigned long long configSize;
+
+    /* Cache of the most recently formatted XML, valid while the
+     * generation counter is unchanged. The counter must be bumped
+     * via virDomainObjDefModified() whenever a definition is
+     * replaced or mutated in place. */
+    unsigned long long defGeneration;
+    char *cachedXML;
+    virDomainDefPtr cachedXMLDef;
+    unsigned int cachedXMLFlags;
+    unsigned long long cachedXMLGeneration;
+
+    char *statusXML; /* Status XML as last written to the status dir,
+                      * used to elide rewrites of unchanged content */
 };
 
 typedef bool (*virDomainObjListACLFilter)(virConnectPtr conn,
@@ -2609,9 +2629,18 @@ void virDomainObjAssignDef(virDomainObjPtr domain,
                            virDomainDefPtr def,
                            bool live,
                            virDomainDefPtr *oldDef);
+void virDomainObjDefModified(virDomainObjPtr domain);
+char *virDomainObjGetCachedXML(virDomainObjPtr domain,
+                               virDomainDefPtr def,
+                               unsigned int flags);
+void virDomainObjSetCachedXML(virDomainObjPtr domain,
+                              virDomainDefPtr def,
+                              unsigned int flags,
+                              const char *xml);
 int virDomainObjSetDefTransient(virCapsPtr caps,
                                 virDomainXMLOptionPtr xmlopt,
-                                virDomainObjPtr domain);
+                                virDomainObjPtr domain,
+                                void *parseOpaque);
 void virDomainObjRemoveTransientDef(virDomainObjPtr domain);
 virDomainDefPtr
 virDomainObjGetPersistentDef(virCapsPtr caps,
@@ -2637,7 +2666,8 @@ virDomainDefPtr virDomainDefCopy(virDomainDefPtr src,
                                  bool migratable);
 virDomainDefPtr virDomainObjCopyPersistentDef(virDomainObjPtr dom,
                                               virCapsPtr caps,
-                                              virDomainXMLOptionPtr xmlopt);
+                                              virDomainXMLOptionPtr xmlopt,
+                                              void *parseOpaque);
 
 typedef enum {
     /* parse internal domain status information */
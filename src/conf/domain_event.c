@@ -1268,6 +1268,9 @@ virDomainEventBalloonChangeNewFromDom(virDomainPtr dom,
         return NULL;
 
     ev->actual = actual;
+    /* Only the latest balloon size is interesting, so a queued event
+     * may be replaced by a newer one */
+    ev->parent.parent.coalescable = true;
 
     return (virObjectEventPtr)ev;
 }
@@ -1286,6 +1289,8 @@ virDomainEventBalloonChangeNewFromObj(virDomainObjPtr obj,
         return NULL;
 
     ev->actual = actual;
+    /* See virDomainEventBalloonChangeNewFromDom */
+    ev->parent.parent.coalescable = true;
 
     return (virObjectEventPtr)ev;
 }
@@ -44,15 +44,27 @@
 #include "c-ctype.h"
 #include "virfile.h"
 #include "virstring.h"
+#include "virthread.h"
 
 #define VIR_FROM_THIS VIR_FROM_NETWORK
 /* currently, /sbin/tc implementation allows up to 16 bits for minor class size */
 #define CLASS_ID_BITMAP_SIZE (1<<16)
 
 struct _virNetworkObjList {
-    virObjectLockable parent;
+    virObject parent;
 
-    virHashTablePtr objs;
+    /* rwlock to protect the hash tables below; lookups and list
+     * enumeration only take the read lock, so they can proceed in
+     * parallel with each other */
+    virRWLock lock;
+
+    /* uuid string -> virNetworkObj  mapping
+     * for O(1), lockless lookup-by-uuid */
+    virHashTable *objs;
+
+    /* name -> virNetworkObj mapping for O(1),
+     * lockless lookup-by-name */
+    virHashTable *objsName;
 };
 
 VIR_ENUM_IMPL(virNetworkForward,
@@ -92,7 +104,7 @@ static int virNetworkObjOnceInit(void)
                                            virNetworkObjDispose)))
         return -1;
 
-    if (!(virNetworkObjListClass = virClassNew(virClassForObjectLockable(),
+    if (!(virNetworkObjListClass = virClassNew(virClassForObject(),
                                                "virNetworkObjList",
                                                sizeof(virNetworkObjList),
                                                virNetworkObjListDispose)))
@@ -147,10 +159,18 @@ virNetworkObjListPtr virNetworkObjListNew(void)
     if (virNetworkObjInitialize() < 0)
         return NULL;
 
-    if (!(nets = virObjectLockableNew(virNetworkObjListClass)))
+    if (!(nets = virObjectNew(virNetworkObjListClass)))
         return NULL;
 
-    if (!(nets->objs = virHashCreate(50, virObjectFreeHashData))) {
+    if (virRWLockInit(&nets->lock) < 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("Unable to initialize RW lock"));
+        virObjectUnref(nets);
+        return NULL;
+    }
+
+    if (!(nets->objs = virHashCreate(50, virObjectFreeHashData)) ||
+        !(nets->objsName = virHashCreate(50, virObjectFreeHashData))) {
         virObjectUnref(nets);
         return NULL;
     }
@@ -198,29 +218,14 @@ virNetworkObjFindByUUID(virNetworkObjListPtr nets,
 {
     virNetworkObjPtr ret;
 
-    virObjectLock(nets);
+    virRWLockRead(&nets->lock);
     ret = virNetworkObjFindByUUIDLocked(nets, uuid);
-    virObjectUnlock(nets);
+    virRWLockUnlock(&nets->lock);
     if (ret)
         virObjectLock(ret);
     return ret;
 }
 
-static int
-virNetworkObjSearchName(const void *payload,
-                        const void *name ATTRIBUTE_UNUSED,
-                        const void *data)
-{
-    virNetworkObjPtr net = (virNetworkObjPtr) payload;
-    int want = 0;
-
-    virObjectLock(net);
-    if (STREQ(net->def->name, (const char *)data))
-        want = 1;
-    virObjectUnlock(net);
-    return want;
-}
-
 /*
  * virNetworkObjFindByNameLocked:
  * @nets: list of network objects
@@ -236,7 +241,7 @@ virNetworkObjFindByNameLocked(virNetworkObjListPtr nets,
 {
     virNetworkObjPtr ret = NULL;
 
-    ret = virHashSearch(nets->objs, virNetworkObjSearchName, name);
+    ret = virHashLookup(nets->objsName, name);
     if (ret)
         virObjectRef(ret);
     return ret;
@@ -258,9 +263,9 @@ virNetworkObjFindByName(virNetworkObjListPtr nets,
 {
     virNetworkObjPtr ret;
 
-    virObjectLock(nets);
+    virRWLockRead(&nets->lock);
     ret = virNetworkObjFindByNameLocked(nets, name);
-    virObjectUnlock(nets);
+    virRWLockUnlock(&nets->lock);
     if (ret)
         virObjectLock(ret);
     return ret;
@@ -451,6 +456,8 @@ virNetworkObjListDispose(void *obj)
     virNetworkObjListPtr nets = obj;
 
     virHashFree(nets->objs);
+    virHashFree(nets->objsName);
+    virRWLockDestroy(&nets->lock);
 }
 
 /*
@@ -578,6 +585,19 @@ virNetworkAssignDefLocked(virNetworkObjListPtr nets,
         if (virHashAddEntry(nets->objs, uuidstr, network) < 0)
             goto cleanup;
 
+        if (virHashAddEntry(nets->objsName, def->name, network) < 0) {
+            /* Grab an extra reference before removing the objs entry,
+             * so that the object stays alive until virNetworkObjEndAPI
+             * in cleanup unlocks and unrefs it */
+            virObjectRef(network);
+            virHashRemoveEntry(nets->objs, uuidstr);
+            goto cleanup;
+        }
+
+        /* Since the network is in two hash tables, increment the
+         * reference counter */
+        virObjectRef(network);
+
         network->def = def;
         network->persistent = !(flags & VIR_NETWORK_OBJ_LIST_ADD_LIVE);
         virObjectRef(network);
@@ -613,9 +633,9 @@ virNetworkAssignDef(virNetworkObjListPtr nets,
 {
     virNetworkObjPtr network;
 
-    virObjectLock(nets);
+    virRWLockWrite(&nets->lock);
     network = virNetworkAssignDefLocked(nets, def, flags);
-    virObjectUnlock(nets);
+    virRWLockUnlock(&nets->lock);
     return network;
 }
 
@@ -785,10 +805,11 @@ void virNetworkRemoveInactive(virNetworkObjListPtr nets,
     virUUIDFormat(net->def->uuid, uuidstr);
     virObjectRef(net);
     virObjectUnlock(net);
-    virObjectLock(nets);
+    virRWLockWrite(&nets->lock);
     virObjectLock(net);
     virHashRemoveEntry(nets->objs, uuidstr);
-    virObjectUnlock(nets);
+    virHashRemoveEntry(nets->objsName, net->def->name);
+    virRWLockUnlock(&nets->lock);
     virObjectUnref(net);
 }
 
@@ -3482,9 +3503,9 @@ int virNetworkBridgeInUse(virNetworkObjListPtr nets,
     virNetworkObjPtr obj;
     struct virNetworkBridgeInUseHelperData data = {bridge, skipname};
 
-    virObjectLock(nets);
+    virRWLockRead(&nets->lock);
     obj = virHashSearch(nets->objs, virNetworkBridgeInUseHelper, &data);
-    virObjectUnlock(nets);
+    virRWLockUnlock(&nets->lock);
 
     return obj != NULL;
 }
@@ -4586,7 +4607,7 @@ virNetworkObjListExport(virConnectPtr conn,
     int ret = -1;
     struct virNetworkObjListData data = { conn, NULL, filter, flags, 0, false};
 
-    virObjectLock(netobjs);
+    virRWLockRead(&netobjs->lock);
     if (nets && VIR_ALLOC_N(data.nets, virHashSize(netobjs->objs) + 1) < 0)
         goto cleanup;
 
@@ -4604,7 +4625,7 @@ virNetworkObjListExport(virConnectPtr conn,
 
     ret = data.nnets;
  cleanup:
-    virObjectUnlock(netobjs);
+    virRWLockUnlock(&netobjs->lock);
     while (data.nets && data.nnets)
         virObjectUnref(data.nets[--data.nnets]);
 
@@ -4649,9 +4670,9 @@ virNetworkObjListForEach(virNetworkObjListPtr nets,
                          void *opaque)
 {
     struct virNetworkObjListForEachHelperData data = {callback, opaque, 0};
-    virObjectLock(nets);
+    virRWLockRead(&nets->lock);
     virHashForEach(nets->objs, virNetworkObjListForEachHelper, &data);
-    virObjectUnlock(nets);
+    virRWLockUnlock(&nets->lock);
     return data.ret;
 }
 
@@ -4714,9 +4735,9 @@ virNetworkObjListGetNames(virNetworkObjListPtr nets,
     struct virNetworkObjListGetHelperData data = {
         conn, filter, names, nnames, active, 0, false};
 
-    virObjectLock(nets);
+    virRWLockRead(&nets->lock);
     virHashForEach(nets->objs, virNetworkObjListGetHelper, &data);
-    virObjectUnlock(nets);
+    virRWLockUnlock(&nets->lock);
 
     if (data.error)
         goto cleanup;
@@ -4739,9 +4760,9 @@ virNetworkObjListNumOfNetworks(virNetworkObjListPtr nets,
     struct virNetworkObjListGetHelperData data = {
         conn, filter, NULL, -1, active, 0, false};
 
-    virObjectLock(nets);
+    virRWLockRead(&nets->lock);
     virHashForEach(nets->objs, virNetworkObjListGetHelper, &data);
-    virObjectUnlock(nets);
+    virRWLockUnlock(&nets->lock);
 
     return data.got;
 }
@@ -4779,7 +4800,8 @@ virNetworkObjListPrune(virNetworkObjListPtr nets,
 {
     struct virNetworkObjListPruneHelperData data = {flags};
 
-    virObjectLock(nets);
+    virRWLockWrite(&nets->lock);
+    virHashRemoveSet(nets->objsName, virNetworkObjListPruneHelper, &data);
     virHashRemoveSet(nets->objs, virNetworkObjListPruneHelper, &data);
-    virObjectUnlock(nets);
+    virRWLockUnlock(&nets->lock);
 }
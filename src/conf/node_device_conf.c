@@ -96,34 +96,26 @@ virNodeDeviceObjPtr
 virNodeDeviceFindBySysfsPath(virNodeDeviceObjListPtr devs,
                              const char *sysfs_path)
 {
-    size_t i;
+    virNodeDeviceObjPtr device = NULL;
 
-    for (i = 0; i < devs->count; i++) {
-        virNodeDeviceObjLock(devs->objs[i]);
-        if ((devs->objs[i]->def->sysfs_path != NULL) &&
-            (STREQ(devs->objs[i]->def->sysfs_path, sysfs_path))) {
-            return devs->objs[i];
-        }
-        virNodeDeviceObjUnlock(devs->objs[i]);
-    }
+    if (devs->sysfsPaths &&
+        (device = virHashLookup(devs->sysfsPaths, sysfs_path)))
+        virNodeDeviceObjLock(device);
 
-    return NULL;
+    return device;
 }
 
 
 virNodeDeviceObjPtr virNodeDeviceFindByName(virNodeDeviceObjListPtr devs,
                                             const char *name)
 {
-    size_t i;
+    virNodeDeviceObjPtr device = NULL;
 
-    for (i = 0; i < devs->count; i++) {
-        virNodeDeviceObjLock(devs->objs[i]);
-        if (STREQ(devs->objs[i]->def->name, name))
-            return devs->objs[i];
-        virNodeDeviceObjUnlock(devs->objs[i]);
-    }
+    if (devs->names &&
+        (device = virHashLookup(devs->names, name)))
+        virNodeDeviceObjLock(device);
 
-    return NULL;
+    return device;
 }
 
 
@@ -171,6 +163,10 @@ void virNodeDeviceObjListFree(virNodeDeviceObjListPtr devs)
         virNodeDeviceObjFree(devs->objs[i]);
     VIR_FREE(devs->objs);
     devs->count = 0;
+    virHashFree(devs->names);
+    devs->names = NULL;
+    virHashFree(devs->sysfsPaths);
+    devs->sysfsPaths = NULL;
 }
 
 virNodeDeviceObjPtr virNodeDeviceAssignDef(virNodeDeviceObjListPtr devs,
@@ -179,11 +175,32 @@ virNodeDeviceObjPtr virNodeDeviceAssignDef(virNodeDeviceObjListPtr devs,
     virNodeDeviceObjPtr device;
 
     if ((device = virNodeDeviceFindByName(devs, def->name))) {
+        /* reindex first so that the sysfs path index stays usable
+         * even if the path changed with the new definition */
+        if (def->sysfs_path &&
+            virHashUpdateEntry(devs->sysfsPaths, def->sysfs_path,
+                               device) < 0) {
+            virNodeDeviceObjUnlock(device);
+            return NULL;
+        }
+        if (device->def->sysfs_path &&
+            STRNEQ_NULLABLE(def->sysfs_path, device->def->sysfs_path))
+            ignore_value(virHashRemoveEntry(devs->sysfsPaths,
+                                            device->def->sysfs_path));
         virNodeDeviceDefFree(device->def);
         device->def = def;
         return device;
     }
 
+    /* The indexes don't hold references of their own; the array
+     * stays the owner of the objects */
+    if (!devs->names &&
+        !(devs->names = virHashCreate(50, NULL)))
+        return NULL;
+    if (!devs->sysfsPaths &&
+        !(devs->sysfsPaths = virHashCreate(50, NULL)))
+        return NULL;
+
     if (VIR_ALLOC(device) < 0)
         return NULL;
 
@@ -195,7 +212,25 @@ virNodeDeviceObjPtr virNodeDeviceAssignDef(virNodeDeviceObjListPtr devs,
     }
     virNodeDeviceObjLock(device);
 
+    if (virHashAddEntry(devs->names, def->name, device) < 0) {
+        virNodeDeviceObjUnlock(device);
+        virNodeDeviceObjFree(device);
+        return NULL;
+    }
+
+    if (def->sysfs_path &&
+        virHashAddEntry(devs->sysfsPaths, def->sysfs_path, device) < 0) {
+        ignore_value(virHashRemoveEntry(devs->names, def->name));
+        virNodeDeviceObjUnlock(device);
+        virNodeDeviceObjFree(device);
+        return NULL;
+    }
+
     if (VIR_APPEND_ELEMENT_COPY(devs->objs, devs->count, device) < 0) {
+        ignore_value(virHashRemoveEntry(devs->names, def->name));
+        if (def->sysfs_path)
+            ignore_value(virHashRemoveEntry(devs->sysfsPaths,
+                                            def->sysfs_path));
         virNodeDeviceObjUnlock(device);
         virNodeDeviceObjFree(device);
         return NULL;
@@ -217,6 +252,11 @@ void virNodeDeviceObjRemove(virNodeDeviceObjListPtr devs,
         virNodeDeviceObjLock(*dev);
         if (devs->objs[i] == *dev) {
             virNodeDeviceObjUnlock(*dev);
+            ignore_value(virHashRemoveEntry(devs->names,
+                                            devs->objs[i]->def->name));
+            if (devs->objs[i]->def->sysfs_path)
+                ignore_value(virHashRemoveEntry(devs->sysfsPaths,
+                                                devs->objs[i]->def->sysfs_path));
             virNodeDeviceObjFree(devs->objs[i]);
             *dev = NULL;
 
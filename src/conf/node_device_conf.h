@@ -27,6 +27,7 @@
 
 # include "internal.h"
 # include "virbitmap.h"
+# include "virhash.h"
 # include "virutil.h"
 # include "virthread.h"
 # include "virpci.h"
@@ -221,6 +222,13 @@ typedef virNodeDeviceObjList *virNodeDeviceObjListPtr;
 struct _virNodeDeviceObjList {
     size_t count;
     virNodeDeviceObjPtr *objs;
+
+    /* name -> virNodeDeviceObj and sysfs path -> virNodeDeviceObj
+     * indexes for O(1) lookup; created on first use because the list
+     * is embedded in the driver state and has no initializer of its
+     * own */
+    virHashTablePtr names;
+    virHashTablePtr sysfsPaths;
 };
 
 typedef struct _virNodeDeviceDriverState virNodeDeviceDriverState;
@@ -2812,6 +2812,34 @@ virNWFilterObjFindByName(virNWFilterObjListPtr nwfilters, const char *name)
 }
 
 
+/**
+ * virNWFilterObjLookupByName:
+ * @nwfilters: the filter list
+ * @name: name of the filter to find
+ *
+ * Find a filter without touching any object lock. The caller must
+ * hold the filter updates lock (at least for reading), which keeps
+ * the list and every filter definition immutable; unlike
+ * virNWFilterObjFindByName the object is returned unlocked, so
+ * threads instantiating unrelated filters do not contend on each
+ * other's objects.
+ *
+ * Returns the object or NULL if the name was not found.
+ */
+virNWFilterObjPtr
+virNWFilterObjLookupByName(virNWFilterObjListPtr nwfilters, const char *name)
+{
+    size_t i;
+
+    for (i = 0; i < nwfilters->count; i++) {
+        if (STREQ_NULLABLE(nwfilters->objs[i]->def->name, name))
+            return nwfilters->objs[i];
+    }
+
+    return NULL;
+}
+
+
 int virNWFilterSaveXML(const char *configDir,
                        virNWFilterDefPtr def,
                        const char *xml)
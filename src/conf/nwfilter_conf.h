@@ -610,6 +610,9 @@ virNWFilterObjPtr virNWFilterObjFindByUUID(virNWFilterObjListPtr nwfilters,
 virNWFilterObjPtr virNWFilterObjFindByName(virNWFilterObjListPtr nwfilters,
                                            const char *name);
 
+virNWFilterObjPtr virNWFilterObjLookupByName(virNWFilterObjListPtr nwfilters,
+                                             const char *name);
+
 
 int virNWFilterObjSaveDef(virNWFilterDriverStatePtr driver,
                           virNWFilterDefPtr def);
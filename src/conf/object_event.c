@@ -81,8 +81,14 @@ struct _virObjectEventState {
     int timer;
     /* Flag if we're in process of dispatching */
     bool isDispatching;
+    /* Number of queued events superseded by newer ones */
+    unsigned long long coalesced;
 };
 
+/* Queue depth at which we complain that events are being produced
+ * faster than the event loop dispatches them */
+#define VIR_OBJECT_EVENT_QUEUE_WARN_DEPTH 1000
+
 static virClassPtr virObjectEventClass;
 static virClassPtr virObjectEventStateClass;
 
@@ -664,6 +670,48 @@ virObjectEventQueuePush(virObjectEventQueuePtr evtQueue,
 }
 
 
+/**
+ * virObjectEventQueueCoalesce:
+ * @evtQueue: the object event queue
+ * @event: the event about to be queued
+ *
+ * Internal function to replace an already queued event that @event
+ * makes obsolete.  Only events marked coalescable take part: those
+ * report a current value (such as the balloon size), so when a newer
+ * reading for the same object and event ID is still waiting for
+ * dispatch, delivering both is pure overhead.  The newer event takes
+ * the queue slot of the older one, preserving ordering relative to
+ * other events for the object.
+ *
+ * Returns: true if @event replaced a queued event, false if the
+ * caller must push it as usual
+ */
+static bool
+virObjectEventQueueCoalesce(virObjectEventQueuePtr evtQueue,
+                            virObjectEventPtr event)
+{
+    size_t i;
+
+    if (!evtQueue || !event->coalescable)
+        return false;
+
+    for (i = 0; i < evtQueue->count; i++) {
+        virObjectEventPtr queued = evtQueue->events[i];
+
+        if (!queued->coalescable ||
+            queued->eventID != event->eventID ||
+            queued->remoteID != event->remoteID ||
+            STRNEQ(queued->meta.key, event->meta.key))
+            continue;
+
+        evtQueue->events[i] = event;
+        virObjectUnref(queued);
+        return true;
+    }
+    return false;
+}
+
+
 static bool
 virObjectEventDispatchMatchCallback(virObjectEventPtr event,
                                     virObjectEventCallbackPtr cb)
@@ -755,11 +803,18 @@ virObjectEventStateQueueRemote(virObjectEventStatePtr state,
     virObjectLock(state);
 
     event->remoteID = remoteID;
-    if (virObjectEventQueuePush(state->queue, event) < 0) {
+    if (virObjectEventQueueCoalesce(state->queue, event)) {
+        state->coalesced++;
+    } else if (virObjectEventQueuePush(state->queue, event) < 0) {
         VIR_DEBUG("Error adding event to queue");
         virObjectUnref(event);
     }
 
+    if (state->queue->count == VIR_OBJECT_EVENT_QUEUE_WARN_DEPTH)
+        VIR_WARN("Event queue grew to %zu entries; dispatch is not "
+                 "keeping up with event production",
+                 state->queue->count);
+
     if (state->queue->count == 1)
         virEventUpdateTimeout(state->timer, 0);
     virObjectUnlock(state);
@@ -819,6 +874,8 @@ virObjectEventStateFlush(virObjectEventStatePtr state)
     tempQueue.events = state->queue->events;
     state->queue->count = 0;
     state->queue->events = NULL;
+    VIR_DEBUG("Dispatching %zu events (%llu coalesced so far)",
+              tempQueue.count, state->coalesced);
     if (state->timer != -1)
         virEventUpdateTimeout(state->timer, -1);
 
@@ -51,6 +51,9 @@ struct _virObjectEvent {
     virObjectMeta meta;
     int remoteID;
     virObjectEventDispatchFunc dispatch;
+    bool coalescable; /* true if the event reports a current value, so
+                       * that a newer queued event for the same object
+                       * and event ID makes this one obsolete */
 };
 
 /**
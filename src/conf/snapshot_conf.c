@@ -935,10 +935,12 @@ virDomainSnapshotObjListGetNames(virDomainSnapshotObjListPtr snapshots,
         data.flags &= ~VIR_DOMAIN_SNAPSHOT_FILTERS_LOCATION;
 
     if (flags & VIR_DOMAIN_SNAPSHOT_LIST_DESCENDANTS) {
-        if (from->def)
+        if (from->def && (names || data.flags))
             virDomainSnapshotForEachDescendant(from,
                                                virDomainSnapshotObjListCopyNames,
                                                &data);
+        else if (from->def)
+            data.count = from->ndescendants;
         else if (names || data.flags)
             virHashForEach(snapshots->objs, virDomainSnapshotObjListCopyNames,
                            &data);
@@ -1048,6 +1050,32 @@ virDomainSnapshotForEachDescendant(virDomainSnapshotObjPtr snapshot,
     return act.number;
 }
 
+/* Propagate a change in subtree size to a snapshot and all of its
+ * ancestors, to keep the materialized descendant counts accurate.  */
+static void
+virDomainSnapshotAdjustDescendants(virDomainSnapshotObjPtr snapshot,
+                                   ssize_t change)
+{
+    while (snapshot) {
+        snapshot->ndescendants += change;
+        snapshot = snapshot->parent;
+    }
+}
+
+/* Add snapshot (and the subtree it already carries) as a child of
+ * parent, keeping the descendant counts of all ancestors accurate.  */
+void
+virDomainSnapshotSetParent(virDomainSnapshotObjPtr snapshot,
+                           virDomainSnapshotObjPtr parent)
+{
+    snapshot->parent = parent;
+    parent->nchildren++;
+    snapshot->sibling = parent->first_child;
+    parent->first_child = snapshot;
+    virDomainSnapshotAdjustDescendants(parent,
+                                       1 + snapshot->ndescendants);
+}
+
 /* Struct and callback function used as a hash table callback; each call
  * inspects the pre-existing snapshot->def->parent field, and adjusts
  * the snapshot->parent field as well as the parent's child fields to
@@ -1085,14 +1113,16 @@ virDomainSnapshotSetRelations(void *payload,
             tmp = tmp->parent;
         }
     }
-    obj->parent->nchildren++;
-    obj->sibling = obj->parent->first_child;
-    obj->parent->first_child = obj;
+    /* Any children obj already collected are transferred to the new
+     * ancestors along with obj, so the descendant counts end up right
+     * no matter in which order the hash table was visited.  */
+    virDomainSnapshotSetParent(obj, obj->parent);
     return 0;
 }
 
-/* Populate parent link and child count of all snapshots, with all
- * relations starting as 0/NULL.  Return 0 on success, -1 if a parent
+/* Populate parent link, child count and descendant count of all
+ * snapshots, with all relations starting as 0/NULL.  Return 0 on
+ * success, -1 if a parent
  * is missing or if a circular relationship was requested.  */
 int
 virDomainSnapshotUpdateRelations(virDomainSnapshotObjListPtr snapshots)
@@ -1114,6 +1144,8 @@ virDomainSnapshotDropParent(virDomainSnapshotObjPtr snapshot)
     virDomainSnapshotObjPtr curr = NULL;
 
     snapshot->parent->nchildren--;
+    virDomainSnapshotAdjustDescendants(snapshot->parent,
+                                       -1 - (ssize_t) snapshot->ndescendants);
     curr = snapshot->parent->first_child;
     while (curr != snapshot) {
         if (!curr) {
@@ -1131,6 +1163,18 @@ virDomainSnapshotDropParent(virDomainSnapshotObjPtr snapshot)
     snapshot->sibling = NULL;
 }
 
+/* Forget all children of snapshot, after the subtrees rooted at those
+ * children have been removed from the list, and charge the loss of the
+ * subtree to snapshot and all of its ancestors.  */
+void
+virDomainSnapshotDropChildren(virDomainSnapshotObjPtr snapshot)
+{
+    virDomainSnapshotAdjustDescendants(snapshot,
+                                       -(ssize_t) snapshot->ndescendants);
+    snapshot->nchildren = 0;
+    snapshot->first_child = NULL;
+}
+
 int
 virDomainListSnapshots(virDomainSnapshotObjListPtr snapshots,
                        virDomainSnapshotObjPtr from,
@@ -89,6 +89,8 @@ struct _virDomainSnapshotObj {
     virDomainSnapshotObjPtr sibling; /* NULL if last child of parent */
     size_t nchildren;
     virDomainSnapshotObjPtr first_child; /* NULL if no children */
+    size_t ndescendants; /* size of the subtree rooted here, excluding
+                            this snapshot itself */
 };
 
 virDomainSnapshotObjListPtr virDomainSnapshotObjListNew(void);
@@ -143,7 +145,10 @@ int virDomainSnapshotForEachDescendant(virDomainSnapshotObjPtr snapshot,
                                        virHashIterator iter,
                                        void *data);
 int virDomainSnapshotUpdateRelations(virDomainSnapshotObjListPtr snapshots);
+void virDomainSnapshotSetParent(virDomainSnapshotObjPtr snapshot,
+                                virDomainSnapshotObjPtr parent);
 void virDomainSnapshotDropParent(virDomainSnapshotObjPtr snapshot);
+void virDomainSnapshotDropChildren(virDomainSnapshotObjPtr snapshot);
 
 # define VIR_DOMAIN_SNAPSHOT_FILTERS_METADATA           \
                (VIR_DOMAIN_SNAPSHOT_LIST_METADATA     | \
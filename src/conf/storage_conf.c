@@ -1742,6 +1742,76 @@ virStoragePoolSourceFindDuplicateDevices(virStoragePoolObjPtr pool,
     return NULL;
 }
 
+static void
+virStoragePoolObjDropVolIndexes(virStoragePoolObjPtr pool)
+{
+    virHashFree(pool->volsByName);
+    pool->volsByName = NULL;
+    virHashFree(pool->volsByKey);
+    pool->volsByKey = NULL;
+    virHashFree(pool->volsByPath);
+    pool->volsByPath = NULL;
+}
+
+/*
+ * (Re)build the lookup indexes if they no longer exactly mirror the
+ * volume list.  The backends append to the list directly, so new
+ * volumes are picked up here through the size mismatch; removals on
+ * the other hand must eagerly call virStoragePoolObjUnindexVol, which
+ * guarantees a hash hit can never return a freed volume.  A miss is
+ * always double checked against the list itself.
+ */
+static void
+virStoragePoolObjRefreshVolIndexes(virStoragePoolObjPtr pool)
+{
+    size_t i;
+
+    if (pool->volsByName &&
+        virHashSize(pool->volsByName) == pool->volumes.count &&
+        virHashSize(pool->volsByKey) == pool->volumes.count &&
+        virHashSize(pool->volsByPath) == pool->volumes.count)
+        return;
+
+    virStoragePoolObjDropVolIndexes(pool);
+
+    if (!(pool->volsByName = virHashCreate(256, NULL)) ||
+        !(pool->volsByKey = virHashCreate(256, NULL)) ||
+        !(pool->volsByPath = virHashCreate(256, NULL)))
+        goto error;
+
+    for (i = 0; i < pool->volumes.count; i++) {
+        virStorageVolDefPtr vol = pool->volumes.objs[i];
+
+        if (virHashUpdateEntry(pool->volsByName, vol->name, vol) < 0)
+            goto error;
+        if (vol->key &&
+            virHashUpdateEntry(pool->volsByKey, vol->key, vol) < 0)
+            goto error;
+        if (vol->target.path &&
+            virHashUpdateEntry(pool->volsByPath, vol->target.path, vol) < 0)
+            goto error;
+    }
+
+    return;
+
+ error:
+    /* lookups simply fall back to scanning the list */
+    virStoragePoolObjDropVolIndexes(pool);
+}
+
+void
+virStoragePoolObjUnindexVol(virStoragePoolObjPtr pool,
+                            virStorageVolDefPtr voldef)
+{
+    if (pool->volsByName)
+        ignore_value(virHashRemoveEntry(pool->volsByName, voldef->name));
+    if (pool->volsByKey && voldef->key)
+        ignore_value(virHashRemoveEntry(pool->volsByKey, voldef->key));
+    if (pool->volsByPath && voldef->target.path)
+        ignore_value(virHashRemoveEntry(pool->volsByPath,
+                                        voldef->target.path));
+}
+
 void
 virStoragePoolObjClearVols(virStoragePoolObjPtr pool)
 {
@@ -1751,6 +1821,8 @@ virStoragePoolObjClearVols(virStoragePoolObjPtr pool)
 
     VIR_FREE(pool->volumes.objs);
     pool->volumes.count = 0;
+
+    virStoragePoolObjDropVolIndexes(pool);
 }
 
 virStorageVolDefPtr
@@ -1758,6 +1830,13 @@ virStorageVolDefFindByKey(virStoragePoolObjPtr pool,
                           const char *key)
 {
     size_t i;
+    virStorageVolDefPtr vol;
+
+    virStoragePoolObjRefreshVolIndexes(pool);
+
+    if (pool->volsByKey &&
+        (vol = virHashLookup(pool->volsByKey, key)))
+        return vol;
 
     for (i = 0; i < pool->volumes.count; i++)
         if (STREQ(pool->volumes.objs[i]->key, key))
@@ -1771,6 +1850,13 @@ virStorageVolDefFindByPath(virStoragePoolObjPtr pool,
                            const char *path)
 {
     size_t i;
+    virStorageVolDefPtr vol;
+
+    virStoragePoolObjRefreshVolIndexes(pool);
+
+    if (pool->volsByPath &&
+        (vol = virHashLookup(pool->volsByPath, path)))
+        return vol;
 
     for (i = 0; i < pool->volumes.count; i++)
         if (STREQ(pool->volumes.objs[i]->target.path, path))
@@ -1784,6 +1870,13 @@ virStorageVolDefFindByName(virStoragePoolObjPtr pool,
                            const char *name)
 {
     size_t i;
+    virStorageVolDefPtr vol;
+
+    virStoragePoolObjRefreshVolIndexes(pool);
+
+    if (pool->volsByName &&
+        (vol = virHashLookup(pool->volsByName, name)))
+        return vol;
 
     for (i = 0; i < pool->volumes.count; i++)
         if (STREQ(pool->volumes.objs[i]->name, name))
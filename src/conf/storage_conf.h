@@ -25,6 +25,7 @@
 # define __VIR_STORAGE_CONF_H__
 
 # include "internal.h"
+# include "virhash.h"
 # include "virstorageencryption.h"
 # include "virstoragefile.h"
 # include "virbitmap.h"
@@ -276,6 +277,14 @@ struct _virStoragePoolObj {
     virStoragePoolDefPtr newDef;
 
     virStorageVolDefList volumes;
+
+    /* Lookup indexes over @volumes, rebuilt lazily whenever they no
+     * longer mirror the list; payloads are borrowed pointers into
+     * volumes.objs, so removals must go through
+     * virStoragePoolObjUnindexVol */
+    virHashTablePtr volsByName;
+    virHashTablePtr volsByKey;
+    virHashTablePtr volsByPath;
 };
 
 typedef struct _virStoragePoolObjList virStoragePoolObjList;
@@ -352,6 +361,9 @@ virStorageVolDefFindByName(virStoragePoolObjPtr pool,
 
 void virStoragePoolObjClearVols(virStoragePoolObjPtr pool);
 
+void virStoragePoolObjUnindexVol(virStoragePoolObjPtr pool,
+                                 virStorageVolDefPtr voldef);
+
 virStoragePoolDefPtr virStoragePoolDefParseString(const char *xml);
 virStoragePoolDefPtr virStoragePoolDefParseFile(const char *filename);
 virStoragePoolDefPtr virStoragePoolDefParseNode(xmlDocPtr xml,
@@ -24,14 +24,20 @@
 
 #include <config.h>
 
+#include <sys/stat.h>
+
 #include "internal.h"
 #include "datatypes.h"
 #include "virdomainobjlist.h"
 #include "snapshot_conf.h"
 #include "viralloc.h"
 #include "virfile.h"
+#include "virhashcode.h"
+#include "virhostcpu.h"
 #include "virlog.h"
 #include "virstring.h"
+#include "virthread.h"
+#include "virutil.h"
 
 #define VIR_FROM_THIS VIR_FROM_DOMAIN
 
@@ -42,21 +48,33 @@ static void virDomainObjListDispose(void *obj);
 
 
 struct _virDomainObjList {
-    virObjectLockable parent;
+    virObject parent;
+
+    /* rwlock to protect the hash tables below; lookups and list
+     * enumeration only take the read lock, so they can proceed in
+     * parallel with each other */
+    virRWLock lock;
 
-    /* uuid string -> virDomainObj  mapping
+    /* raw uuid (VIR_UUID_BUFLEN bytes) -> virDomainObj mapping
      * for O(1), lockless lookup-by-uuid */
     virHashTable *objs;
 
     /* name -> virDomainObj mapping for O(1),
      * lockless lookup-by-name */
     virHashTable *objsName;
+
+    /* one-entry cache of the most recent failed lookup-by-name;
+     * clients probing for an optional domain repeat the same miss
+     * over and over, and this answers them without taking the
+     * rwlock. Guarded by missLock, which nests inside @lock */
+    virMutex missLock;
+    char *missName;
 };
 
 
 static int virDomainObjListOnceInit(void)
 {
-    if (!(virDomainObjListClass = virClassNew(virClassForObjectLockable(),
+    if (!(virDomainObjListClass = virClassNew(virClassForObject(),
                                               "virDomainObjList",
                                               sizeof(virDomainObjList),
                                               virDomainObjListDispose)))
@@ -67,6 +85,41 @@ static int virDomainObjListOnceInit(void)
 
 VIR_ONCE_GLOBAL_INIT(virDomainObjList)
 
+
+/* The objs table is keyed on the raw 16 byte UUID rather than its
+ * string form, so lookups coming from the wire need no conversion */
+static uint32_t
+virDomainObjListUUIDCode(const void *uuid,
+                         uint32_t seed)
+{
+    return virHashCodeGen(uuid, VIR_UUID_BUFLEN, seed);
+}
+
+static bool
+virDomainObjListUUIDEqual(const void *uuida,
+                          const void *uuidb)
+{
+    return memcmp(uuida, uuidb, VIR_UUID_BUFLEN) == 0;
+}
+
+static void *
+virDomainObjListUUIDCopy(const void *uuid)
+{
+    unsigned char *copy;
+
+    if (VIR_ALLOC_N(copy, VIR_UUID_BUFLEN) < 0)
+        return NULL;
+    memcpy(copy, uuid, VIR_UUID_BUFLEN);
+    return copy;
+}
+
+static void
+virDomainObjListUUIDFree(void *uuid)
+{
+    VIR_FREE(uuid);
+}
+
+
 virDomainObjListPtr virDomainObjListNew(void)
 {
     virDomainObjListPtr doms;
@@ -74,10 +127,28 @@ virDomainObjListPtr virDomainObjListNew(void)
     if (virDomainObjListInitialize() < 0)
         return NULL;
 
-    if (!(doms = virObjectLockableNew(virDomainObjListClass)))
+    if (!(doms = virObjectNew(virDomainObjListClass)))
+        return NULL;
+
+    if (virRWLockInit(&doms->lock) < 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("Unable to initialize RW lock"));
+        virObjectUnref(doms);
+        return NULL;
+    }
+
+    if (virMutexInit(&doms->missLock) < 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("Unable to initialize mutex"));
+        virObjectUnref(doms);
         return NULL;
+    }
 
-    if (!(doms->objs = virHashCreate(50, virObjectFreeHashData)) ||
+    if (!(doms->objs = virHashCreateFull(50, virObjectFreeHashData,
+                                         virDomainObjListUUIDCode,
+                                         virDomainObjListUUIDEqual,
+                                         virDomainObjListUUIDCopy,
+                                         virDomainObjListUUIDFree)) ||
         !(doms->objsName = virHashCreate(50, virObjectFreeHashData))) {
         virObjectUnref(doms);
         return NULL;
@@ -93,6 +164,21 @@ static void virDomainObjListDispose(void *obj)
 
     virHashFree(doms->objs);
     virHashFree(doms->objsName);
+    VIR_FREE(doms->missName);
+    virMutexDestroy(&doms->missLock);
+    virRWLockDestroy(&doms->lock);
+}
+
+
+/* Forget the cached negative lookup; must be called, with the list
+ * write lock held, after any change that can make a previously
+ * missing name resolve. */
+static void
+virDomainObjListMissCacheClear(virDomainObjListPtr doms)
+{
+    virMutexLock(&doms->missLock);
+    VIR_FREE(doms->missName);
+    virMutexUnlock(&doms->missLock);
 }
 
 
@@ -118,11 +204,11 @@ virDomainObjListFindByIDInternal(virDomainObjListPtr doms,
                                  bool ref)
 {
     virDomainObjPtr obj;
-    virObjectLock(doms);
+    virRWLockRead(&doms->lock);
     obj = virHashSearch(doms->objs, virDomainObjListSearchID, &id);
     if (ref) {
         virObjectRef(obj);
-        virObjectUnlock(doms);
+        virRWLockUnlock(&doms->lock);
     }
     if (obj) {
         virObjectLock(obj);
@@ -134,7 +220,7 @@ virDomainObjListFindByIDInternal(virDomainObjListPtr doms,
         }
     }
     if (!ref)
-        virObjectUnlock(doms);
+        virRWLockUnlock(&doms->lock);
     return obj;
 }
 
@@ -157,16 +243,13 @@ virDomainObjListFindByUUIDInternal(virDomainObjListPtr doms,
                                    const unsigned char *uuid,
                                    bool ref)
 {
-    char uuidstr[VIR_UUID_STRING_BUFLEN];
     virDomainObjPtr obj;
 
-    virObjectLock(doms);
-    virUUIDFormat(uuid, uuidstr);
-
-    obj = virHashLookup(doms->objs, uuidstr);
+    virRWLockRead(&doms->lock);
+    obj = virHashLookup(doms->objs, uuid);
     if (ref) {
         virObjectRef(obj);
-        virObjectUnlock(doms);
+        virRWLockUnlock(&doms->lock);
     }
     if (obj) {
         virObjectLock(obj);
@@ -178,7 +261,7 @@ virDomainObjListFindByUUIDInternal(virDomainObjListPtr doms,
         }
     }
     if (!ref)
-        virObjectUnlock(doms);
+        virRWLockUnlock(&doms->lock);
     return obj;
 }
 
@@ -204,10 +287,30 @@ virDomainObjPtr virDomainObjListFindByName(virDomainObjListPtr doms,
 {
     virDomainObjPtr obj;
 
-    virObjectLock(doms);
+    /* a repeat of the last failed lookup cannot have started
+     * resolving without the cache having been cleared first */
+    virMutexLock(&doms->missLock);
+    if (doms->missName && STREQ(doms->missName, name)) {
+        virMutexUnlock(&doms->missLock);
+        return NULL;
+    }
+    virMutexUnlock(&doms->missLock);
+
+    virRWLockRead(&doms->lock);
     obj = virHashLookup(doms->objsName, name);
+    if (!obj) {
+        /* record the miss while still holding the list lock, so a
+         * concurrent add of @name cannot be shadowed by a stale
+         * negative entry */
+        virMutexLock(&doms->missLock);
+        if (STRNEQ_NULLABLE(doms->missName, name)) {
+            VIR_FREE(doms->missName);
+            ignore_value(VIR_STRDUP_QUIET(doms->missName, name));
+        }
+        virMutexUnlock(&doms->missLock);
+    }
     virObjectRef(obj);
-    virObjectUnlock(doms);
+    virRWLockUnlock(&doms->lock);
     if (obj) {
         virObjectLock(obj);
         if (obj->removing) {
@@ -245,10 +348,8 @@ virDomainObjListAddLocked(virDomainObjListPtr doms,
     if (oldDef)
         *oldDef = NULL;
 
-    virUUIDFormat(def->uuid, uuidstr);
-
     /* See if a VM with matching UUID already exists */
-    if ((vm = virHashLookup(doms->objs, uuidstr))) {
+    if ((vm = virHashLookup(doms->objs, def->uuid))) {
         virObjectLock(vm);
         /* UUID matches, but if names don't match, refuse it */
         if (STRNEQ(vm->def->name, def->name)) {
@@ -294,20 +395,21 @@ virDomainObjListAddLocked(virDomainObjListPtr doms,
             goto cleanup;
         vm->def = def;
 
-        virUUIDFormat(def->uuid, uuidstr);
-        if (virHashAddEntry(doms->objs, uuidstr, vm) < 0) {
+        if (virHashAddEntry(doms->objs, def->uuid, vm) < 0) {
             virObjectUnref(vm);
             return NULL;
         }
 
         if (virHashAddEntry(doms->objsName, def->name, vm) < 0) {
-            virHashRemoveEntry(doms->objs, uuidstr);
+            virHashRemoveEntry(doms->objs, def->uuid);
             return NULL;
         }
 
         /* Since domain is in two hash tables, increment the
          * reference counter */
         virObjectRef(vm);
+
+        virDomainObjListMissCacheClear(doms);
     }
  cleanup:
     return vm;
@@ -327,9 +429,9 @@ virDomainObjPtr virDomainObjListAdd(virDomainObjListPtr doms,
 {
     virDomainObjPtr ret;
 
-    virObjectLock(doms);
+    virRWLockWrite(&doms->lock);
     ret = virDomainObjListAddLocked(doms, def, xmlopt, flags, oldDef);
-    virObjectUnlock(doms);
+    virRWLockUnlock(&doms->lock);
     return ret;
 }
 
@@ -342,20 +444,17 @@ virDomainObjPtr virDomainObjListAdd(virDomainObjListPtr doms,
 void virDomainObjListRemove(virDomainObjListPtr doms,
                             virDomainObjPtr dom)
 {
-    char uuidstr[VIR_UUID_STRING_BUFLEN];
-
     dom->removing = true;
-    virUUIDFormat(dom->def->uuid, uuidstr);
     virObjectRef(dom);
     virObjectUnlock(dom);
 
-    virObjectLock(doms);
+    virRWLockWrite(&doms->lock);
     virObjectLock(dom);
-    virHashRemoveEntry(doms->objs, uuidstr);
+    virHashRemoveEntry(doms->objs, dom->def->uuid);
     virHashRemoveEntry(doms->objsName, dom->def->name);
     virObjectUnlock(dom);
     virObjectUnref(dom);
-    virObjectUnlock(doms);
+    virRWLockUnlock(&doms->lock);
 }
 
 
@@ -394,7 +493,7 @@ virDomainObjListRename(virDomainObjListPtr doms,
      * hold a lock on dom but not refcount it. */
     virObjectRef(dom);
     virObjectUnlock(dom);
-    virObjectLock(doms);
+    virRWLockWrite(&doms->lock);
     virObjectLock(dom);
     virObjectUnref(dom);
 
@@ -408,6 +507,8 @@ virDomainObjListRename(virDomainObjListPtr doms,
     if (virHashAddEntry(doms->objsName, new_name, dom) < 0)
         goto cleanup;
 
+    virDomainObjListMissCacheClear(doms);
+
     /* Okay, this is crazy. virHashAddEntry() does not increment
      * the refcounter of @dom, but virHashRemoveEntry() does
      * decrement it. We need to work around it. */
@@ -420,7 +521,7 @@ virDomainObjListRename(virDomainObjListPtr doms,
 
     ret = 0;
  cleanup:
-    virObjectUnlock(doms);
+    virRWLockUnlock(&doms->lock);
     VIR_FREE(old_name);
     return ret;
 }
@@ -434,122 +535,262 @@ virDomainObjListRename(virDomainObjListPtr doms,
 void virDomainObjListRemoveLocked(virDomainObjListPtr doms,
                                   virDomainObjPtr dom)
 {
-    char uuidstr[VIR_UUID_STRING_BUFLEN];
-
-    virUUIDFormat(dom->def->uuid, uuidstr);
-
-    virHashRemoveEntry(doms->objs, uuidstr);
+    virHashRemoveEntry(doms->objs, dom->def->uuid);
     virHashRemoveEntry(doms->objsName, dom->def->name);
     virObjectUnlock(dom);
 }
 
 
-static virDomainObjPtr
-virDomainObjListLoadConfig(virDomainObjListPtr doms,
-                           virCapsPtr caps,
-                           virDomainXMLOptionPtr xmlopt,
-                           const char *configDir,
-                           const char *autostartDir,
-                           const char *name,
-                           virDomainLoadConfigNotify notify,
-                           void *opaque)
+/* Attempt to satisfy a config reload from the already loaded
+ * definition. Returns true if @name was fully handled without
+ * re-parsing it, false if it must go through a full load.
+ * The caller must hold the lock on @doms. */
+static bool
+virDomainObjListReloadIfUnchangedLocked(virDomainObjListPtr doms,
+                                        const char *configDir,
+                                        const char *autostartDir,
+                                        const char *name,
+                                        virDomainLoadConfigNotify notify,
+                                        void *opaque)
 {
     char *configFile = NULL, *autostartLink = NULL;
-    virDomainDefPtr def = NULL;
     virDomainObjPtr dom;
     int autostart;
-    virDomainDefPtr oldDef = NULL;
+    bool ret = false;
+    struct stat sb;
 
     if ((configFile = virDomainConfigFile(configDir, name)) == NULL)
-        goto error;
+        goto cleanup;
+
+    if (stat(configFile, &sb) < 0)
+        goto cleanup;
+
+    /* Skip the expensive XML round trip if the config file is still
+     * the one we last parsed. Configs are rewritten via rename(), so
+     * a content change always shows up as a new inode even within
+     * one mtime granule. */
+    if (!sb.st_ino ||
+        !(dom = virHashLookup(doms->objsName, name)) ||
+        dom->configMtime != (long long)sb.st_mtime ||
+        dom->configIno != (unsigned long long)sb.st_ino ||
+        dom->configSize != (unsigned long long)sb.st_size)
+        goto cleanup;
+
+    virObjectLock(dom);
+
+    if ((autostartLink = virDomainConfigFile(autostartDir, name)) == NULL ||
+        (autostart = virFileLinkPointsTo(autostartLink, configFile)) < 0) {
+        virObjectUnlock(dom);
+        goto cleanup;
+    }
+
+    dom->autostart = autostart;
+    dom->persistent = 1;
+
+    if (notify)
+        (*notify)(dom, 0, opaque);
+
+    virObjectUnlock(dom);
+    ret = true;
+
+ cleanup:
+    VIR_FREE(configFile);
+    VIR_FREE(autostartLink);
+    return ret;
+}
+
+
+/* Parse one config file. Performs no list accesses at all, so many
+ * instances can run concurrently. */
+static virDomainDefPtr
+virDomainObjListParseConfigFile(virCapsPtr caps,
+                                virDomainXMLOptionPtr xmlopt,
+                                const char *configDir,
+                                const char *autostartDir,
+                                const char *name,
+                                struct stat *sb,
+                                int *autostart)
+{
+    char *configFile = NULL, *autostartLink = NULL;
+    virDomainDefPtr def = NULL;
+
+    *autostart = 0;
+
+    if ((configFile = virDomainConfigFile(configDir, name)) == NULL)
+        goto cleanup;
+
+    if (stat(configFile, sb) < 0)
+        memset(sb, 0, sizeof(*sb));
+
     if (!(def = virDomainDefParseFile(configFile, caps, xmlopt, NULL,
                                       VIR_DOMAIN_DEF_PARSE_INACTIVE |
                                       VIR_DOMAIN_DEF_PARSE_SKIP_OSTYPE_CHECKS |
                                       VIR_DOMAIN_DEF_PARSE_SKIP_VALIDATE)))
-        goto error;
+        goto cleanup;
 
-    if ((autostartLink = virDomainConfigFile(autostartDir, name)) == NULL)
-        goto error;
+    if ((autostartLink = virDomainConfigFile(autostartDir, name)) == NULL ||
+        (*autostart = virFileLinkPointsTo(autostartLink, configFile)) < 0) {
+        virDomainDefFree(def);
+        def = NULL;
+    }
+
+ cleanup:
+    VIR_FREE(configFile);
+    VIR_FREE(autostartLink);
+    return def;
+}
 
-    if ((autostart = virFileLinkPointsTo(autostartLink, configFile)) < 0)
-        goto error;
+
+/* Insert a freshly parsed config definition into the list.
+ * The caller must hold the lock on @doms; @def is consumed on
+ * success and left to the caller on failure. */
+static virDomainObjPtr
+virDomainObjListLoadConfigLocked(virDomainObjListPtr doms,
+                                 virDomainXMLOptionPtr xmlopt,
+                                 virDomainDefPtr def,
+                                 const struct stat *sb,
+                                 int autostart,
+                                 virDomainLoadConfigNotify notify,
+                                 void *opaque)
+{
+    virDomainObjPtr dom;
+    virDomainDefPtr oldDef = NULL;
 
     if (!(dom = virDomainObjListAddLocked(doms, def, xmlopt, 0, &oldDef)))
-        goto error;
+        return NULL;
 
     dom->autostart = autostart;
+    dom->configMtime = (long long)sb->st_mtime;
+    dom->configIno = (unsigned long long)sb->st_ino;
+    dom->configSize = (unsigned long long)sb->st_size;
 
     if (notify)
         (*notify)(dom, oldDef == NULL, opaque);
 
     virDomainDefFree(oldDef);
-    VIR_FREE(configFile);
-    VIR_FREE(autostartLink);
     return dom;
-
- error:
-    VIR_FREE(configFile);
-    VIR_FREE(autostartLink);
-    virDomainDefFree(def);
-    return NULL;
 }
 
 
+/* Parse one status file. Performs no list accesses at all, so many
+ * instances can run concurrently. */
 static virDomainObjPtr
-virDomainObjListLoadStatus(virDomainObjListPtr doms,
-                           const char *statusDir,
-                           const char *name,
-                           virCapsPtr caps,
-                           virDomainXMLOptionPtr xmlopt,
-                           virDomainLoadConfigNotify notify,
-                           void *opaque)
+virDomainObjListParseStatusFile(virCapsPtr caps,
+                                virDomainXMLOptionPtr xmlopt,
+                                const char *statusDir,
+                                const char *name)
 {
     char *statusFile = NULL;
     virDomainObjPtr obj = NULL;
-    char uuidstr[VIR_UUID_STRING_BUFLEN];
 
     if ((statusFile = virDomainConfigFile(statusDir, name)) == NULL)
-        goto error;
+        return NULL;
 
-    if (!(obj = virDomainObjParseFile(statusFile, caps, xmlopt,
-                                      VIR_DOMAIN_DEF_PARSE_STATUS |
-                                      VIR_DOMAIN_DEF_PARSE_ACTUAL_NET |
-                                      VIR_DOMAIN_DEF_PARSE_PCI_ORIG_STATES |
-                                      VIR_DOMAIN_DEF_PARSE_SKIP_OSTYPE_CHECKS |
-                                      VIR_DOMAIN_DEF_PARSE_SKIP_VALIDATE)))
-        goto error;
+    obj = virDomainObjParseFile(statusFile, caps, xmlopt,
+                                VIR_DOMAIN_DEF_PARSE_STATUS |
+                                VIR_DOMAIN_DEF_PARSE_ACTUAL_NET |
+                                VIR_DOMAIN_DEF_PARSE_PCI_ORIG_STATES |
+                                VIR_DOMAIN_DEF_PARSE_SKIP_OSTYPE_CHECKS |
+                                VIR_DOMAIN_DEF_PARSE_SKIP_VALIDATE);
+
+    VIR_FREE(statusFile);
+    return obj;
+}
 
-    virUUIDFormat(obj->def->uuid, uuidstr);
 
-    if (virHashLookup(doms->objs, uuidstr) != NULL) {
+/* Insert a parsed status object into the list. The caller must hold
+ * the lock on @doms and owns a locked reference to @obj either way;
+ * on success the list takes its own extra references. */
+static virDomainObjPtr
+virDomainObjListLoadStatusLocked(virDomainObjListPtr doms,
+                                 virDomainObjPtr obj,
+                                 virDomainLoadConfigNotify notify,
+                                 void *opaque)
+{
+    if (virHashLookup(doms->objs, obj->def->uuid) != NULL) {
         virReportError(VIR_ERR_INTERNAL_ERROR,
                        _("unexpected domain %s already exists"),
                        obj->def->name);
-        goto error;
+        return NULL;
     }
 
-    if (virHashAddEntry(doms->objs, uuidstr, obj) < 0)
-        goto error;
+    if (virHashAddEntry(doms->objs, obj->def->uuid, obj) < 0)
+        return NULL;
 
     if (virHashAddEntry(doms->objsName, obj->def->name, obj) < 0) {
-        virHashRemoveEntry(doms->objs, uuidstr);
-        goto error;
+        virHashRemoveEntry(doms->objs, obj->def->uuid);
+        return NULL;
     }
 
     /* Since domain is in two hash tables, increment the
      * reference counter */
     virObjectRef(obj);
 
+    virDomainObjListMissCacheClear(doms);
+
     if (notify)
         (*notify)(obj, 1, opaque);
 
-    VIR_FREE(statusFile);
     return obj;
+}
 
- error:
-    virObjectUnref(obj);
-    VIR_FREE(statusFile);
-    return NULL;
+
+struct virDomainObjListLoadJobs {
+    virMutex lock;
+
+    char **names;
+    size_t nnames;
+    size_t next; /* next unparsed entry in @names, protected by @lock */
+
+    virCapsPtr caps;
+    virDomainXMLOptionPtr xmlopt;
+    const char *configDir;
+    const char *autostartDir;
+    int liveStatus;
+
+    /* one slot per name, written only by the worker which claimed
+     * the corresponding index */
+    virDomainDefPtr *defs;
+    virDomainObjPtr *objs;
+    struct stat *stamps;
+    int *autostarts;
+};
+
+
+static void
+virDomainObjListLoadWorker(void *opaque)
+{
+    struct virDomainObjListLoadJobs *jobs = opaque;
+
+    for (;;) {
+        size_t i;
+
+        virMutexLock(&jobs->lock);
+        i = jobs->next++;
+        virMutexUnlock(&jobs->lock);
+        if (i >= jobs->nnames)
+            break;
+
+        if (!jobs->names[i]) /* already satisfied from the old list */
+            continue;
+
+        /* NB: ignoring errors, so one malformed config doesn't
+           kill the whole process */
+        VIR_INFO("Loading config file '%s.xml'", jobs->names[i]);
+        if (jobs->liveStatus)
+            jobs->objs[i] = virDomainObjListParseStatusFile(jobs->caps,
+                                                            jobs->xmlopt,
+                                                            jobs->configDir,
+                                                            jobs->names[i]);
+        else
+            jobs->defs[i] = virDomainObjListParseConfigFile(jobs->caps,
+                                                            jobs->xmlopt,
+                                                            jobs->configDir,
+                                                            jobs->autostartDir,
+                                                            jobs->names[i],
+                                                            &jobs->stamps[i],
+                                                            &jobs->autostarts[i]);
+    }
 }
 
 
@@ -565,6 +806,10 @@ virDomainObjListLoadAllConfigs(virDomainObjListPtr doms,
 {
     DIR *dir;
     struct dirent *entry;
+    struct virDomainObjListLoadJobs jobs;
+    virThreadPtr workers = NULL;
+    size_t nworkers = 0;
+    size_t i;
     int ret = -1;
     int rc;
 
@@ -573,43 +818,140 @@ virDomainObjListLoadAllConfigs(virDomainObjListPtr doms,
     if ((rc = virDirOpenIfExists(&dir, configDir)) <= 0)
         return rc;
 
-    virObjectLock(doms);
+    memset(&jobs, 0, sizeof(jobs));
+    jobs.caps = caps;
+    jobs.xmlopt = xmlopt;
+    jobs.configDir = configDir;
+    jobs.autostartDir = autostartDir;
+    jobs.liveStatus = liveStatus;
 
-    while ((ret = virDirRead(dir, &entry, configDir)) > 0) {
-        virDomainObjPtr dom;
+    if (virMutexInit(&jobs.lock) < 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       "%s", _("cannot initialize mutex"));
+        VIR_DIR_CLOSE(dir);
+        return -1;
+    }
+
+    while ((rc = virDirRead(dir, &entry, configDir)) > 0) {
+        char *name;
 
         if (!virFileStripSuffix(entry->d_name, ".xml"))
             continue;
 
-        /* NB: ignoring errors, so one malformed config doesn't
-           kill the whole process */
-        VIR_INFO("Loading config file '%s.xml'", entry->d_name);
-        if (liveStatus)
-            dom = virDomainObjListLoadStatus(doms,
-                                             configDir,
-                                             entry->d_name,
-                                             caps,
-                                             xmlopt,
-                                             notify,
-                                             opaque);
-        else
-            dom = virDomainObjListLoadConfig(doms,
-                                             caps,
-                                             xmlopt,
-                                             configDir,
-                                             autostartDir,
-                                             entry->d_name,
-                                             notify,
-                                             opaque);
+        if (VIR_STRDUP(name, entry->d_name) < 0 ||
+            VIR_APPEND_ELEMENT(jobs.names, jobs.nnames, name) < 0) {
+            VIR_FREE(name);
+            VIR_DIR_CLOSE(dir);
+            goto cleanup;
+        }
+    }
+    VIR_DIR_CLOSE(dir);
+    if (rc < 0)
+        goto cleanup;
+
+    if (jobs.nnames == 0) {
+        ret = 0;
+        goto cleanup;
+    }
+
+    if (VIR_ALLOC_N(jobs.defs, jobs.nnames) < 0 ||
+        VIR_ALLOC_N(jobs.objs, jobs.nnames) < 0 ||
+        VIR_ALLOC_N(jobs.stamps, jobs.nnames) < 0 ||
+        VIR_ALLOC_N(jobs.autostarts, jobs.nnames) < 0)
+        goto cleanup;
+
+    /* On a reload of an already populated list most configs are
+     * usually unchanged; weed those out cheaply before paying for
+     * any parsing */
+    if (!liveStatus) {
+        virRWLockWrite(&doms->lock);
+        for (i = 0; i < jobs.nnames; i++) {
+            if (virDomainObjListReloadIfUnchangedLocked(doms,
+                                                        configDir,
+                                                        autostartDir,
+                                                        jobs.names[i],
+                                                        notify, opaque))
+                VIR_FREE(jobs.names[i]);
+        }
+        virRWLockUnlock(&doms->lock);
+    }
+
+    /* Parse everything else concurrently; the XML round trip burns
+     * CPU and the workers touch no shared state at all */
+    if ((rc = virHostCPUGetCount()) < 1)
+        rc = 1;
+    nworkers = MIN((size_t)rc, jobs.nnames);
+
+    if (nworkers > 1 && VIR_ALLOC_N(workers, nworkers) < 0)
+        goto cleanup;
+
+    if (nworkers <= 1 || !workers) {
+        virDomainObjListLoadWorker(&jobs);
+    } else {
+        size_t started = 0;
+
+        for (i = 0; i < nworkers; i++) {
+            if (virThreadCreate(&workers[i], true,
+                                virDomainObjListLoadWorker, &jobs) < 0)
+                break;
+            started++;
+        }
+
+        /* Pick up any leftovers ourselves if thread spawning failed */
+        virDomainObjListLoadWorker(&jobs);
+
+        for (i = 0; i < started; i++)
+            virThreadJoin(&workers[i]);
+    }
+
+    /* Insertion and the notify callbacks stay serialized under the
+     * list lock, exactly as with the old single threaded loader */
+    virRWLockWrite(&doms->lock);
+    for (i = 0; i < jobs.nnames; i++) {
+        virDomainObjPtr dom = NULL;
+
+        if (liveStatus && jobs.objs[i]) {
+            dom = virDomainObjListLoadStatusLocked(doms, jobs.objs[i],
+                                                   notify, opaque);
+            if (!dom)
+                virObjectUnref(jobs.objs[i]);
+            jobs.objs[i] = NULL;
+        } else if (!liveStatus && jobs.defs[i]) {
+            dom = virDomainObjListLoadConfigLocked(doms, xmlopt,
+                                                   jobs.defs[i],
+                                                   &jobs.stamps[i],
+                                                   jobs.autostarts[i],
+                                                   notify, opaque);
+            if (!dom)
+                virDomainDefFree(jobs.defs[i]);
+            jobs.defs[i] = NULL;
+        }
+
         if (dom) {
             if (!liveStatus)
                 dom->persistent = 1;
             virObjectUnlock(dom);
         }
     }
+    virRWLockUnlock(&doms->lock);
 
-    VIR_DIR_CLOSE(dir);
-    virObjectUnlock(doms);
+    ret = 0;
+
+ cleanup:
+    for (i = 0; i < jobs.nnames; i++) {
+        VIR_FREE(jobs.names[i]);
+        if (jobs.defs)
+            virDomainDefFree(jobs.defs[i]);
+        if (jobs.objs)
+            virObjectUnref(jobs.objs[i]);
+    }
+    VIR_FREE(jobs.names);
+    VIR_FREE(jobs.defs);
+    VIR_FREE(jobs.objs);
+    VIR_FREE(jobs.stamps);
+    VIR_FREE(jobs.autostarts);
+    VIR_FREE(workers);
+    virMutexDestroy(&jobs.lock);
     return ret;
 }
 
@@ -653,9 +995,9 @@ virDomainObjListNumOfDomains(virDomainObjListPtr doms,
                              virConnectPtr conn)
 {
     struct virDomainObjListData data = { filter, conn, active, 0 };
-    virObjectLock(doms);
+    virRWLockRead(&doms->lock);
     virHashForEach(doms->objs, virDomainObjListCount, &data);
-    virObjectUnlock(doms);
+    virRWLockUnlock(&doms->lock);
     return data.count;
 }
 
@@ -697,9 +1039,9 @@ virDomainObjListGetActiveIDs(virDomainObjListPtr doms,
 {
     struct virDomainIDData data = { filter, conn,
                                     0, maxids, ids };
-    virObjectLock(doms);
+    virRWLockRead(&doms->lock);
     virHashForEach(doms->objs, virDomainObjListCopyActiveIDs, &data);
-    virObjectUnlock(doms);
+    virRWLockUnlock(&doms->lock);
     return data.numids;
 }
 
@@ -751,9 +1093,9 @@ virDomainObjListGetInactiveNames(virDomainObjListPtr doms,
     struct virDomainNameData data = { filter, conn,
                                       0, 0, maxnames, names };
     size_t i;
-    virObjectLock(doms);
+    virRWLockRead(&doms->lock);
     virHashForEach(doms->objs, virDomainObjListCopyInactiveNames, &data);
-    virObjectUnlock(doms);
+    virRWLockUnlock(&doms->lock);
     if (data.oom) {
         for (i = 0; i < data.numnames; i++)
             VIR_FREE(data.names[i]);
@@ -792,9 +1134,9 @@ virDomainObjListForEach(virDomainObjListPtr doms,
     struct virDomainListIterData data = {
         callback, opaque, 0,
     };
-    virObjectLock(doms);
+    virRWLockWrite(&doms->lock);
     virHashForEach(doms->objs, virDomainObjListHelper, &data);
-    virObjectUnlock(doms);
+    virRWLockUnlock(&doms->lock);
     return data.ret;
 }
 
@@ -864,6 +1206,9 @@ virDomainObjMatchFilter(virDomainObjPtr vm,
 
 
 struct virDomainListData {
+    virConnectPtr conn;
+    virDomainObjListACLFilter filter;
+    unsigned int flags;
     virDomainObjPtr *vms;
     size_t nvms;
 };
@@ -875,8 +1220,24 @@ virDomainObjListCollectIterator(void *payload,
                                 void *opaque)
 {
     struct virDomainListData *data = opaque;
+    virDomainObjPtr vm = payload;
+
+    virObjectLock(vm);
+
+    /* do not collect the object if:
+     * 1) it's being removed.
+     * 2) connection does not have ACL to see it
+     * 3) it doesn't match the filter
+     */
+    if (vm->removing ||
+        (data->filter && !data->filter(data->conn, vm->def)) ||
+        !virDomainObjMatchFilter(vm, data->flags)) {
+        virObjectUnlock(vm);
+        return 0;
+    }
 
-    data->vms[data->nvms++] = virObjectRef(payload);
+    virObjectUnlock(vm);
+    data->vms[data->nvms++] = virObjectRef(vm);
     return 0;
 }
 
@@ -923,19 +1284,17 @@ virDomainObjListCollect(virDomainObjListPtr domlist,
                         virDomainObjListACLFilter filter,
                         unsigned int flags)
 {
-    struct virDomainListData data = { NULL, 0 };
+    struct virDomainListData data = { conn, filter, flags, NULL, 0 };
 
-    virObjectLock(domlist);
+    virRWLockRead(&domlist->lock);
     sa_assert(domlist->objs);
     if (VIR_ALLOC_N(data.vms, virHashSize(domlist->objs)) < 0) {
-        virObjectUnlock(domlist);
+        virRWLockUnlock(&domlist->lock);
         return -1;
     }
 
     virHashForEach(domlist->objs, virDomainObjListCollectIterator, &data);
-    virObjectUnlock(domlist);
-
-    virDomainObjListFilter(&data.vms, &data.nvms, conn, filter, flags);
+    virRWLockUnlock(&domlist->lock);
 
     *nvms = data.nvms;
     *vms = data.vms;
@@ -962,17 +1321,16 @@ virDomainObjListConvert(virDomainObjListPtr domlist,
     *nvms = 0;
     *vms = NULL;
 
-    virObjectLock(domlist);
+    virRWLockRead(&domlist->lock);
     for (i = 0; i < ndoms; i++) {
         virDomainPtr dom = doms[i];
 
-        virUUIDFormat(dom->uuid, uuidstr);
-
-        if (!(vm = virHashLookup(domlist->objs, uuidstr))) {
+        if (!(vm = virHashLookup(domlist->objs, dom->uuid))) {
             if (skip_missing)
                 continue;
 
-            virObjectUnlock(domlist);
+            virRWLockUnlock(&domlist->lock);
+            virUUIDFormat(dom->uuid, uuidstr);
             virReportError(VIR_ERR_NO_DOMAIN,
                            _("no domain with matching uuid '%s' (%s)"),
                            uuidstr, dom->name);
@@ -982,12 +1340,12 @@ virDomainObjListConvert(virDomainObjListPtr domlist,
         virObjectRef(vm);
 
         if (VIR_APPEND_ELEMENT(*vms, *nvms, vm) < 0) {
-            virObjectUnlock(domlist);
+            virRWLockUnlock(&domlist->lock);
             virObjectUnref(vm);
             goto error;
         }
     }
-    virObjectUnlock(domlist);
+    virRWLockUnlock(&domlist->lock);
 
     sa_assert(*vms);
     virDomainObjListFilter(vms, nvms, conn, filter, flags);
@@ -57,11 +57,12 @@ struct _virSecretObjList {
     /* uuid string -> virSecretObj  mapping
      * for O(1), lockless lookup-by-uuid */
     virHashTable *objs;
-};
 
-struct virSecretSearchData {
-    int usageType;
-    const char *usageID;
+    /* "usageType-usageID" -> virSecretObj secondary index for O(1)
+     * lookup-by-usage; does not hold its own reference, the entries
+     * are kept in sync with @objs. Secrets with usage type none are
+     * not indexed, they are never matched by usage */
+    virHashTable *objsUsage;
 };
 
 
@@ -124,7 +125,8 @@ virSecretObjListNew(void)
     if (!(secrets = virObjectLockableNew(virSecretObjListClass)))
         return NULL;
 
-    if (!(secrets->objs = virHashCreate(50, virObjectFreeHashData))) {
+    if (!(secrets->objs = virHashCreate(50, virObjectFreeHashData)) ||
+        !(secrets->objsUsage = virHashCreate(50, NULL))) {
         virObjectUnref(secrets);
         return NULL;
     }
@@ -133,6 +135,23 @@ virSecretObjListNew(void)
 }
 
 
+/* Build the key the usage index is hashed on. Returns NULL without
+ * reporting an error for secrets that cannot be found by usage. */
+static char *
+virSecretObjListUsageKey(int usageType,
+                         const char *usageID)
+{
+    char *key = NULL;
+
+    if (usageType == VIR_SECRET_USAGE_TYPE_NONE ||
+        !usageID || !*usageID)
+        return NULL;
+
+    ignore_value(virAsprintf(&key, "%d-%s", usageType, usageID));
+    return key;
+}
+
+
 static void
 virSecretObjDispose(void *obj)
 {
@@ -154,6 +173,7 @@ virSecretObjListDispose(void *obj)
 {
     virSecretObjListPtr secrets = obj;
 
+    virHashFree(secrets->objsUsage);
     virHashFree(secrets->objs);
 }
 
@@ -204,52 +224,6 @@ virSecretObjListFindByUUID(virSecretObjListPtr secrets,
 }
 
 
-static int
-virSecretObjSearchName(const void *payload,
-                       const void *name ATTRIBUTE_UNUSED,
-                       const void *opaque)
-{
-    virSecretObjPtr secret = (virSecretObjPtr) payload;
-    struct virSecretSearchData *data = (struct virSecretSearchData *) opaque;
-    int found = 0;
-
-    virObjectLock(secret);
-
-    if (secret->def->usage_type != data->usageType)
-        goto cleanup;
-
-    switch (data->usageType) {
-    case VIR_SECRET_USAGE_TYPE_NONE:
-    /* never match this */
-        break;
-
-    case VIR_SECRET_USAGE_TYPE_VOLUME:
-        if (STREQ(secret->def->usage.volume, data->usageID))
-            found = 1;
-        break;
-
-    case VIR_SECRET_USAGE_TYPE_CEPH:
-        if (STREQ(secret->def->usage.ceph, data->usageID))
-            found = 1;
-        break;
-
-    case VIR_SECRET_USAGE_TYPE_ISCSI:
-        if (STREQ(secret->def->usage.target, data->usageID))
-            found = 1;
-        break;
-
-    case VIR_SECRET_USAGE_TYPE_TLS:
-        if (STREQ(secret->def->usage.name, data->usageID))
-            found = 1;
-        break;
-    }
-
- cleanup:
-    virObjectUnlock(secret);
-    return found;
-}
-
-
 /**
  * virSecretObjFindByUsageLocked:
  * @secrets: list of secret objects
@@ -266,12 +240,16 @@ virSecretObjListFindByUsageLocked(virSecretObjListPtr secrets,
                                   const char *usageID)
 {
     virSecretObjPtr ret = NULL;
-    struct virSecretSearchData data = { .usageType = usageType,
-                                        .usageID = usageID };
+    char *key;
 
-    ret = virHashSearch(secrets->objs, virSecretObjSearchName, &data);
+    /* usage type none is never matched */
+    if (!(key = virSecretObjListUsageKey(usageType, usageID)))
+        return NULL;
+
+    ret = virHashLookup(secrets->objsUsage, key);
     if (ret)
         virObjectRef(ret);
+    VIR_FREE(key);
     return ret;
 }
 
@@ -317,6 +295,7 @@ virSecretObjListRemove(virSecretObjListPtr secrets,
                        virSecretObjPtr secret)
 {
     char uuidstr[VIR_UUID_STRING_BUFLEN];
+    char *usageKey;
 
     virUUIDFormat(secret->def->uuid, uuidstr);
     virObjectRef(secret);
@@ -324,6 +303,11 @@ virSecretObjListRemove(virSecretObjListPtr secrets,
 
     virObjectLock(secrets);
     virObjectLock(secret);
+    if ((usageKey = virSecretObjListUsageKey(secret->def->usage_type,
+                                             virSecretUsageIDForDef(secret->def)))) {
+        virHashRemoveEntry(secrets->objsUsage, usageKey);
+        VIR_FREE(usageKey);
+    }
     virHashRemoveEntry(secrets->objs, uuidstr);
     virObjectUnlock(secret);
     virObjectUnref(secret);
@@ -355,6 +339,7 @@ virSecretObjListAddLocked(virSecretObjListPtr secrets,
     const char *newUsageID = virSecretUsageIDForDef(def);
     char uuidstr[VIR_UUID_STRING_BUFLEN];
     char *configFile = NULL, *base64File = NULL;
+    char *usageKey = NULL;
 
     if (oldDef)
         *oldDef = NULL;
@@ -414,8 +399,22 @@ virSecretObjListAddLocked(virSecretObjListPtr secrets,
 
         virObjectLock(secret);
 
-        if (virHashAddEntry(secrets->objs, uuidstr, secret) < 0)
+        /* the usage index does not own a reference, so it can be
+         * inserted and unwound freely while the object is locked */
+        if ((usageKey = virSecretObjListUsageKey(def->usage_type,
+                                                 newUsageID)) &&
+            virHashAddEntry(secrets->objsUsage, usageKey, secret) < 0) {
+            VIR_FREE(usageKey);
             goto cleanup;
+        }
+
+        if (virHashAddEntry(secrets->objs, uuidstr, secret) < 0) {
+            if (usageKey)
+                virHashRemoveEntry(secrets->objsUsage, usageKey);
+            VIR_FREE(usageKey);
+            goto cleanup;
+        }
+        VIR_FREE(usageKey);
 
         secret->def = def;
         secret->configFile = configFile;
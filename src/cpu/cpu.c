@@ -473,6 +473,22 @@ cpuBaselineXML(const char **xmlCPUs,
         goto error;
 
     for (i = 0; i < ncpus; i++) {
+        size_t j;
+
+        /* Hosts in large pools are often homogeneous; parse each
+         * distinct XML document only once and copy the parsed
+         * definition for its duplicates
+         */
+        for (j = 0; j < i; j++) {
+            if (STREQ(xmlCPUs[i], xmlCPUs[j]))
+                break;
+        }
+        if (j < i) {
+            if (!(cpus[i] = virCPUDefCopy(cpus[j])))
+                goto error;
+            continue;
+        }
+
         if (!(doc = virXMLParseStringCtxt(xmlCPUs[i], _("(CPU_definition)"), &ctxt)))
             goto error;
 
@@ -29,6 +29,7 @@
 #include "cpu_map.h"
 #include "configmake.h"
 #include "virstring.h"
+#include "virthread.h"
 #include "virlog.h"
 
 #define VIR_FROM_THIS VIR_FROM_CPU
@@ -40,6 +41,19 @@ VIR_ENUM_IMPL(cpuMapElement, CPU_MAP_ELEMENT_LAST,
     "feature",
     "model")
 
+/* The parsed cpu_map.xml document is kept for the lifetime of the
+ * process and shared by all architectures; each architecture still
+ * extracts its section lazily on first use */
+static virMutex cpuMapDocLock;
+static xmlDocPtr cpuMapDoc;
+
+static int cpuMapDocOnceInit(void)
+{
+    return virMutexInit(&cpuMapDocLock);
+}
+
+VIR_ONCE_GLOBAL_INIT(cpuMapDoc)
+
 
 static int load(xmlXPathContextPtr ctxt,
                 cpuMapElement element,
@@ -75,35 +89,46 @@ int cpuMapLoad(const char *arch,
                cpuMapLoadCallback cb,
                void *data)
 {
-    xmlDocPtr xml = NULL;
     xmlXPathContextPtr ctxt = NULL;
     virBuffer buf = VIR_BUFFER_INITIALIZER;
     char *xpath = NULL;
     int ret = -1;
     int element;
-    char *mapfile;
-
-    if (!(mapfile = virFileFindResource("cpu_map.xml",
-                                        abs_topsrcdir "/src/cpu",
-                                        PKGDATADIR)))
-        return -1;
-
-    VIR_DEBUG("Loading CPU map from %s", mapfile);
+    char *mapfile = NULL;
 
     if (arch == NULL) {
         virReportError(VIR_ERR_INTERNAL_ERROR,
                        "%s", _("undefined hardware architecture"));
-        goto cleanup;
+        return -1;
     }
 
     if (cb == NULL) {
         virReportError(VIR_ERR_INTERNAL_ERROR,
                        "%s", _("no callback provided"));
-        goto cleanup;
+        return -1;
     }
 
-    if (!(xml = virXMLParseFileCtxt(mapfile, &ctxt)))
+    if (cpuMapDocInitialize() < 0)
+        return -1;
+
+    virMutexLock(&cpuMapDocLock);
+
+    if (!cpuMapDoc) {
+        if (!(mapfile = virFileFindResource("cpu_map.xml",
+                                            abs_topsrcdir "/src/cpu",
+                                            PKGDATADIR)))
+            goto cleanup;
+
+        VIR_DEBUG("Loading CPU map from %s", mapfile);
+
+        if (!(cpuMapDoc = virXMLParseFile(mapfile)))
+            goto cleanup;
+    }
+
+    if (!(ctxt = xmlXPathNewContext(cpuMapDoc))) {
+        virReportOOMError();
         goto cleanup;
+    }
 
     virBufferAsprintf(&buf, "./arch[@name='%s']", arch);
     if (virBufferCheckError(&buf) < 0)
@@ -111,7 +136,7 @@ int cpuMapLoad(const char *arch,
 
     xpath = virBufferContentAndReset(&buf);
 
-    ctxt->node = xmlDocGetRootElement(xml);
+    ctxt->node = xmlDocGetRootElement(cpuMapDoc);
 
     if ((ctxt->node = virXPathNode(xpath, ctxt)) == NULL) {
         virReportError(VIR_ERR_INTERNAL_ERROR,
@@ -130,8 +155,8 @@ int cpuMapLoad(const char *arch,
     ret = 0;
 
  cleanup:
+    virMutexUnlock(&cpuMapDocLock);
     xmlXPathFreeContext(ctxt);
-    xmlFreeDoc(xml);
     VIR_FREE(xpath);
     VIR_FREE(mapfile);
 
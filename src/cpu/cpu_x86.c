@@ -32,7 +32,9 @@
 #include "cpu_x86.h"
 #include "virbuffer.h"
 #include "virendian.h"
+#include "virhash.h"
 #include "virstring.h"
+#include "virthread.h"
 
 #define VIR_FROM_THIS VIR_FROM_CPU
 
@@ -150,9 +152,24 @@ struct _virCPUx86Map {
     virCPUx86ModelPtr *models;
     size_t nblockers;
     virCPUx86FeaturePtr *migrate_blockers;
+
+    /* Name indexes over the features/models arrays for O(1) lookups;
+     * the entries are owned by the arrays */
+    virHashTablePtr featureIndex;
+    virHashTablePtr modelIndex;
 };
 
 static virCPUx86MapPtr cpuMap;
+
+/* Cache of x86Decode results. The CPU map is immutable once loaded, so
+ * a decode result is fully determined by the CPUID data and the model
+ * list, preferred model and flags arguments, which together form the
+ * hash key. The cache is bounded so that baseline computations on
+ * client-supplied data cannot grow it without limit. */
+#define X86_DECODE_CACHE_MAX 32
+static virHashTablePtr cpuDecodeCache;
+static virMutex cpuDecodeCacheLock;
+
 int virCPUx86MapOnceInit(void);
 VIR_ONCE_GLOBAL_INIT(virCPUx86Map);
 
@@ -282,12 +299,23 @@ static virCPUx86CPUID *
 x86DataCpuid(const virCPUx86Data *data,
              const virCPUx86CPUID *cpuid)
 {
-    size_t i;
-
-    for (i = 0; i < data->len; i++) {
-        if (data->data[i].eax_in == cpuid->eax_in &&
-            data->data[i].ecx_in == cpuid->ecx_in)
-            return data->data + i;
+    size_t lo = 0;
+    size_t hi = data->len;
+
+    /* Leaves are kept sorted by eax_in/ecx_in (virCPUx86DataAddCPUID),
+     * so a binary search can be used */
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        virCPUx86CPUID *item = data->data + mid;
+
+        if (item->eax_in < cpuid->eax_in ||
+            (item->eax_in == cpuid->eax_in && item->ecx_in < cpuid->ecx_in))
+            lo = mid + 1;
+        else if (item->eax_in > cpuid->eax_in ||
+                 (item->eax_in == cpuid->eax_in && item->ecx_in > cpuid->ecx_in))
+            hi = mid;
+        else
+            return item;
     }
 
     return NULL;
@@ -741,14 +769,7 @@ static virCPUx86FeaturePtr
 x86FeatureFind(virCPUx86MapPtr map,
                const char *name)
 {
-    size_t i;
-
-    for (i = 0; i < map->nfeatures; i++) {
-        if (STREQ(map->features[i]->name, name))
-            return map->features[i];
-    }
-
-    return NULL;
+    return virHashLookup(map->featureIndex, name);
 }
 
 
@@ -941,6 +962,8 @@ x86FeaturesLoad(virCPUx86MapPtr map,
         if (!(feature = x86FeatureParse(ctxt, map)))
             return -1;
         map->features[map->nfeatures++] = feature;
+        if (virHashAddEntry(map->featureIndex, feature->name, feature) < 0)
+            return -1;
         if (!feature->migratable &&
             VIR_APPEND_ELEMENT(map->migrate_blockers,
                                map->nblockers,
@@ -1021,14 +1044,7 @@ static virCPUx86ModelPtr
 x86ModelFind(virCPUx86MapPtr map,
              const char *name)
 {
-    size_t i;
-
-    for (i = 0; i < map->nmodels; i++) {
-        if (STREQ(map->models[i]->name, name))
-            return map->models[i];
-    }
-
-    return NULL;
+    return virHashLookup(map->modelIndex, name);
 }
 
 
@@ -1313,6 +1329,8 @@ x86ModelsLoad(virCPUx86MapPtr map,
         if (!(model = x86ModelParse(ctxt, map)))
             return -1;
         map->models[map->nmodels++] = model;
+        if (virHashAddEntry(map->modelIndex, model->name, model) < 0)
+            return -1;
     }
 
     return 0;
@@ -1344,6 +1362,10 @@ x86MapFree(virCPUx86MapPtr map)
      */
     VIR_FREE(map->migrate_blockers);
 
+    /* the indexes only point to the features/models freed above */
+    virHashFree(map->featureIndex);
+    virHashFree(map->modelIndex);
+
     VIR_FREE(map);
 }
 
@@ -1380,6 +1402,10 @@ virCPUx86LoadMap(void)
     if (VIR_ALLOC(map) < 0)
         return NULL;
 
+    if (!(map->featureIndex = virHashCreate(250, NULL)) ||
+        !(map->modelIndex = virHashCreate(50, NULL)))
+        goto error;
+
     if (cpuMapLoad("x86", x86MapLoadCallback, map) < 0)
         goto error;
 
@@ -1391,9 +1417,24 @@ virCPUx86LoadMap(void)
 }
 
 
+static void
+x86DecodeCacheEntryFree(void *payload,
+                        const void *name ATTRIBUTE_UNUSED)
+{
+    virCPUDefFree(payload);
+}
+
+
 int
 virCPUx86MapOnceInit(void)
 {
+    if (virMutexInit(&cpuDecodeCacheLock) < 0)
+        return -1;
+
+    if (!(cpuDecodeCache = virHashCreate(X86_DECODE_CACHE_MAX,
+                                         x86DecodeCacheEntryFree)))
+        return -1;
+
     if (!(cpuMap = virCPUx86LoadMap()))
         return -1;
 
@@ -1798,6 +1839,42 @@ x86DecodeUseCandidate(virCPUx86ModelPtr current,
 }
 
 
+/*
+ * Formats the hash key identifying a decode operation: all x86Decode
+ * inputs apart from the immutable CPU map are folded into the key.
+ */
+static char *
+x86DecodeCacheKey(const virCPUDef *cpu,
+                  const virCPUx86Data *data,
+                  const char **models,
+                  unsigned int nmodels,
+                  const char *preferred,
+                  unsigned int flags)
+{
+    virBuffer buf = VIR_BUFFER_INITIALIZER;
+    size_t i;
+
+    virBufferAsprintf(&buf, "%d/%d/%u/%s",
+                      cpu->type, cpu->fallback, flags, NULLSTR(preferred));
+
+    for (i = 0; i < data->len; i++) {
+        virCPUx86CPUID *cpuid = data->data + i;
+
+        virBufferAsprintf(&buf, "|%x.%x:%x,%x,%x,%x",
+                          cpuid->eax_in, cpuid->ecx_in,
+                          cpuid->eax, cpuid->ebx, cpuid->ecx, cpuid->edx);
+    }
+
+    for (i = 0; i < nmodels; i++)
+        virBufferAsprintf(&buf, "|%s", models[i]);
+
+    if (virBufferCheckError(&buf) < 0)
+        return NULL;
+
+    return virBufferContentAndReset(&buf);
+}
+
+
 static int
 x86Decode(virCPUDefPtr cpu,
           const virCPUx86Data *data,
@@ -1815,6 +1892,8 @@ x86Decode(virCPUDefPtr cpu,
     virCPUx86Data copy = VIR_CPU_X86_DATA_INIT;
     virCPUx86Data features = VIR_CPU_X86_DATA_INIT;
     virCPUx86VendorPtr vendor;
+    virCPUDefPtr cached;
+    char *cachekey = NULL;
     uint32_t signature;
     ssize_t i;
     int rc;
@@ -1825,6 +1904,18 @@ x86Decode(virCPUDefPtr cpu,
     if (!data || !(map = virCPUx86GetMap()))
         return -1;
 
+    if (!(cachekey = x86DecodeCacheKey(cpu, data, models, nmodels,
+                                       preferred, flags)))
+        return -1;
+
+    virMutexLock(&cpuDecodeCacheLock);
+    if ((cached = virHashLookup(cpuDecodeCache, cachekey))) {
+        ret = virCPUDefCopyModel(cpu, cached, false);
+        virMutexUnlock(&cpuDecodeCacheLock);
+        goto cleanup;
+    }
+    virMutexUnlock(&cpuDecodeCacheLock);
+
     vendor = x86DataToVendor(data, map);
     signature = x86DataToSignature(data);
 
@@ -1924,10 +2015,24 @@ x86Decode(virCPUDefPtr cpu,
 
     ret = 0;
 
+    /* Remember the result for the next decode of the same data */
+    virMutexLock(&cpuDecodeCacheLock);
+    if (!virHashLookup(cpuDecodeCache, cachekey) &&
+        virHashSize(cpuDecodeCache) < X86_DECODE_CACHE_MAX) {
+        if (VIR_ALLOC_QUIET(cached) == 0) {
+            cached->type = cpu->type;
+            if (virCPUDefCopyModel(cached, cpu, false) < 0 ||
+                virHashAddEntry(cpuDecodeCache, cachekey, cached) < 0)
+                virCPUDefFree(cached);
+        }
+    }
+    virMutexUnlock(&cpuDecodeCacheLock);
+
  cleanup:
     virCPUDefFree(cpuModel);
     virCPUx86DataClear(&copy);
     virCPUx86DataClear(&features);
+    VIR_FREE(cachekey);
     return ret;
 }
 
@@ -36,6 +36,7 @@
 #include "esx_vi_methods.h"
 #include "esx_util.h"
 #include "virstring.h"
+#include "virtime.h"
 
 #define VIR_FROM_THIS VIR_FROM_ESX
 
@@ -965,10 +966,31 @@ ESX_VI__TEMPLATE__ALLOC(Context)
 /* esxVI_Context_Free */
 ESX_VI__TEMPLATE__FREE(Context,
 {
+    size_t i;
+    bool wasShared = false;
+
     if (item->sessionLock)
         virMutexDestroy(item->sessionLock);
 
+    /* esxVI_CURL_Free of the last shared handle frees the share
+     * itself, so only free it directly when no handle was added */
+    for (i = 0; i < ESX_VI_CONTEXT_CURL_POOL_SIZE; ++i) {
+        if (item->curlPool[i]) {
+            wasShared = wasShared || item->curlPool[i]->shared;
+            esxVI_CURL_Free(&item->curlPool[i]);
+        }
+    }
+
+    wasShared = wasShared || (item->curl && item->curl->shared);
+
     esxVI_CURL_Free(&item->curl);
+
+    if (!wasShared)
+        esxVI_SharedCURL_Free(&item->sharedCURL);
+
+    if (item->curlPoolLock)
+        virMutexDestroy(item->curlPoolLock);
+    VIR_FREE(item->curlPoolLock);
     VIR_FREE(item->url);
     VIR_FREE(item->ipAddress);
     VIR_FREE(item->username);
@@ -998,6 +1020,7 @@ esxVI_Context_Connect(esxVI_Context *ctx, const char *url,
 {
     int result = -1;
     char *escapedPassword = NULL;
+    size_t i;
 
     if (!ctx || !url || !ipAddress || !username ||
         !password || ctx->url || ctx->service || ctx->curl) {
@@ -1032,6 +1055,33 @@ esxVI_Context_Connect(esxVI_Context *ctx, const char *url,
         goto cleanup;
     }
 
+    /*
+     * Bind a small pool of additional handles into the same session.
+     * Sharing the cookie jar makes the login performed later valid for
+     * every handle in the pool, so independent API calls no longer
+     * serialize on a single connection.
+     */
+    if (esxVI_SharedCURL_Alloc(&ctx->sharedCURL) < 0 ||
+        esxVI_SharedCURL_Add(ctx->sharedCURL, ctx->curl) < 0)
+        goto cleanup;
+
+    if (VIR_ALLOC(ctx->curlPoolLock) < 0)
+        goto cleanup;
+
+    if (virMutexInit(ctx->curlPoolLock) < 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("Could not initialize CURL pool mutex"));
+        VIR_FREE(ctx->curlPoolLock);
+        goto cleanup;
+    }
+
+    for (i = 0; i < ESX_VI_CONTEXT_CURL_POOL_SIZE; ++i) {
+        if (esxVI_CURL_Alloc(&ctx->curlPool[i]) < 0 ||
+            esxVI_CURL_Connect(ctx->curlPool[i], parsedUri) < 0 ||
+            esxVI_SharedCURL_Add(ctx->sharedCURL, ctx->curlPool[i]) < 0)
+            goto cleanup;
+    }
+
     if (esxVI_RetrieveServiceContent(ctx, &ctx->service) < 0)
         goto cleanup;
 
@@ -1409,6 +1459,52 @@ esxVI_Context_LookupManagedObjectsByHostSystemIp(esxVI_Context *ctx,
     return result;
 }
 
+/* Pick an idle handle from the context's pool, falling back to the
+ * primary handle (and contending on its lock) when all are in use */
+static esxVI_CURL *
+esxVI_Context_AcquireCURL(esxVI_Context *ctx)
+{
+    esxVI_CURL *curl = ctx->curl;
+    size_t i;
+
+    if (!ctx->curlPoolLock)
+        return curl;
+
+    virMutexLock(ctx->curlPoolLock);
+
+    for (i = 0; i < ESX_VI_CONTEXT_CURL_POOL_SIZE; ++i) {
+        if (ctx->curlPool[i] && !ctx->curlPoolBusy[i]) {
+            ctx->curlPoolBusy[i] = true;
+            curl = ctx->curlPool[i];
+            break;
+        }
+    }
+
+    virMutexUnlock(ctx->curlPoolLock);
+
+    return curl;
+}
+
+static void
+esxVI_Context_ReleaseCURL(esxVI_Context *ctx, esxVI_CURL *curl)
+{
+    size_t i;
+
+    if (curl == ctx->curl)
+        return;
+
+    virMutexLock(ctx->curlPoolLock);
+
+    for (i = 0; i < ESX_VI_CONTEXT_CURL_POOL_SIZE; ++i) {
+        if (ctx->curlPool[i] == curl) {
+            ctx->curlPoolBusy[i] = false;
+            break;
+        }
+    }
+
+    virMutexUnlock(ctx->curlPoolLock);
+}
+
 int
 esxVI_Context_Execute(esxVI_Context *ctx, const char *methodName,
                       const char *request, esxVI_Response **response,
@@ -1420,6 +1516,7 @@ esxVI_Context_Execute(esxVI_Context *ctx, const char *methodName,
     char *xpathExpression = NULL;
     xmlXPathContextPtr xpathContext = NULL;
     xmlNodePtr responseNode = NULL;
+    esxVI_CURL *curl;
 
     if (!request || !response || *response) {
         virReportError(VIR_ERR_INTERNAL_ERROR, "%s", _("Invalid argument"));
@@ -1429,18 +1526,22 @@ esxVI_Context_Execute(esxVI_Context *ctx, const char *methodName,
     if (esxVI_Response_Alloc(response) < 0)
         return -1;
 
-    virMutexLock(&ctx->curl->lock);
+    curl = esxVI_Context_AcquireCURL(ctx);
+
+    virMutexLock(&curl->lock);
+
+    curl_easy_setopt(curl->handle, CURLOPT_URL, ctx->url);
+    curl_easy_setopt(curl->handle, CURLOPT_RANGE, NULL);
+    curl_easy_setopt(curl->handle, CURLOPT_WRITEDATA, &buffer);
+    curl_easy_setopt(curl->handle, CURLOPT_UPLOAD, 0);
+    curl_easy_setopt(curl->handle, CURLOPT_POSTFIELDS, request);
+    curl_easy_setopt(curl->handle, CURLOPT_POSTFIELDSIZE, strlen(request));
 
-    curl_easy_setopt(ctx->curl->handle, CURLOPT_URL, ctx->url);
-    curl_easy_setopt(ctx->curl->handle, CURLOPT_RANGE, NULL);
-    curl_easy_setopt(ctx->curl->handle, CURLOPT_WRITEDATA, &buffer);
-    curl_easy_setopt(ctx->curl->handle, CURLOPT_UPLOAD, 0);
-    curl_easy_setopt(ctx->curl->handle, CURLOPT_POSTFIELDS, request);
-    curl_easy_setopt(ctx->curl->handle, CURLOPT_POSTFIELDSIZE, strlen(request));
+    (*response)->responseCode = esxVI_CURL_Perform(curl, ctx->url);
 
-    (*response)->responseCode = esxVI_CURL_Perform(ctx->curl, ctx->url);
+    virMutexUnlock(&curl->lock);
 
-    virMutexUnlock(&ctx->curl->lock);
+    esxVI_Context_ReleaseCURL(ctx, curl);
 
     if ((*response)->responseCode < 0)
         goto cleanup;
@@ -2082,6 +2183,7 @@ esxVI_EnsureSession(esxVI_Context *ctx)
     esxVI_DynamicProperty *dynamicProperty = NULL;
     esxVI_UserSession *currentSession = NULL;
     char *escapedPassword = NULL;
+    unsigned long long now;
 
     if (!ctx->sessionLock) {
         virReportError(VIR_ERR_INTERNAL_ERROR, "%s", _("Invalid call, no mutex"));
@@ -2095,6 +2197,20 @@ esxVI_EnsureSession(esxVI_Context *ctx)
         goto cleanup;
     }
 
+    /*
+     * A session verified recently is still valid: the server side
+     * timeout for idle sessions is 30 minutes, and every successful
+     * verification refreshes the activity timestamp. Skipping the
+     * round trip here removes one SessionManager lookup from every
+     * API call issued in between.
+     */
+    if (ctx->sessionLastCheck != 0 &&
+        virTimeMillisNow(&now) == 0 &&
+        now - ctx->sessionLastCheck < ESX_VI_SESSION_CHECK_INTERVAL * 1000) {
+        result = 0;
+        goto cleanup;
+    }
+
     escapedPassword = esxUtil_EscapeForXml(ctx->password);
 
     if (!escapedPassword) {
@@ -2140,6 +2256,9 @@ esxVI_EnsureSession(esxVI_Context *ctx)
         goto cleanup;
     }
 
+    if (virTimeMillisNow(&now) == 0)
+        ctx->sessionLastCheck = now;
+
     result = 0;
 
  cleanup:
@@ -182,9 +182,28 @@ int esxVI_MultiCURL_CheckFirstMessage(esxVI_MultiCURL *multi, long *responseCode
  * Context
  */
 
+/*
+ * Number of additional CURL handles a context binds into its session,
+ * on top of the primary one. Independent API calls can run one SOAP
+ * request per handle concurrently; more handles than this show little
+ * gain while adding connections the server has to keep open.
+ */
+# define ESX_VI_CONTEXT_CURL_POOL_SIZE 4
+
+/*
+ * How long in seconds a successful session verification is considered
+ * current, avoiding one SessionManager round trip per API call. Far
+ * below the server's 30 minute idle timeout for sessions.
+ */
+# define ESX_VI_SESSION_CHECK_INTERVAL 30
+
 struct _esxVI_Context {
     /* All members are used read-only after esxVI_Context_Connect ... */
     esxVI_CURL *curl;
+    esxVI_SharedCURL *sharedCURL; /* binds all handles into one session */
+    esxVI_CURL *curlPool[ESX_VI_CONTEXT_CURL_POOL_SIZE];
+    bool curlPoolBusy[ESX_VI_CONTEXT_CURL_POOL_SIZE]; /* protected by curlPoolLock */
+    virMutexPtr curlPoolLock;
     char *url;
     char *ipAddress;
     char *username;
@@ -195,6 +214,9 @@ struct _esxVI_Context {
     unsigned long productVersion; /* = 1000000 * major + 1000 * minor + micro */
     esxVI_UserSession *session; /* ... except the session ... */
     virMutexPtr sessionLock; /* ... that is protected by this mutex */
+    unsigned long long sessionLastCheck; /* Time in ms the session was last
+                                          * verified against the server;
+                                          * protected by sessionLock too */
     esxVI_Datacenter *datacenter;
     char *datacenterPath; /* including folders */
     esxVI_ComputeResource *computeResource;
@@ -35,11 +35,28 @@
 #include "hyperv_wmi.h"
 #include "openwsman.h"
 #include "virstring.h"
+#include "virtime.h"
 
 #define VIR_FROM_THIS VIR_FROM_HYPERV
 
 VIR_LOG_INIT("hyperv.hyperv_driver");
 
+/* How long in milliseconds cached settings data is served before the
+ * host is queried again. Processor and memory settings only change on
+ * explicit reconfiguration, so a short window cuts three WS-Man round
+ * trips per domain from every poll without hiding changes for long */
+#define HYPERV_SETTINGS_CACHE_TTL 5000
+
+typedef struct _hypervSettingsCacheEntry hypervSettingsCacheEntry;
+typedef hypervSettingsCacheEntry *hypervSettingsCacheEntryPtr;
+
+struct _hypervSettingsCacheEntry {
+    unsigned long long when; /* Time the data was fetched from the host */
+    unsigned long maxMem;
+    unsigned long memory;
+    unsigned short nrVirtCpu;
+};
+
 static void
 hypervFreePrivate(hypervPrivate **priv)
 {
@@ -51,6 +68,11 @@ hypervFreePrivate(hypervPrivate **priv)
         wsmc_release((*priv)->client);
     }
 
+    if ((*priv)->settingsCache) {
+        virHashFree((*priv)->settingsCache);
+        virMutexDestroy(&(*priv)->settingsCacheLock);
+    }
+
     hypervFreeParsedUri(&(*priv)->parsedUri);
     VIR_FREE(*priv);
 }
@@ -112,6 +134,19 @@ hypervConnectOpen(virConnectPtr conn, virConnectAuthPtr auth,
     if (VIR_ALLOC(priv) < 0)
         goto cleanup;
 
+    if (virMutexInit(&priv->settingsCacheLock) < 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("cannot initialize mutex"));
+        VIR_FREE(priv);
+        goto cleanup;
+    }
+
+    if (!(priv->settingsCache = virHashCreate(10, virHashValueFree))) {
+        virMutexDestroy(&priv->settingsCacheLock);
+        VIR_FREE(priv);
+        goto cleanup;
+    }
+
     if (hypervParseUri(&priv->parsedUri, conn->uri) < 0)
         goto cleanup;
 
@@ -639,15 +674,41 @@ hypervDomainGetInfo(virDomainPtr domain, virDomainInfoPtr info)
     Msvm_VirtualSystemSettingData *virtualSystemSettingData = NULL;
     Msvm_ProcessorSettingData *processorSettingData = NULL;
     Msvm_MemorySettingData *memorySettingData = NULL;
+    hypervSettingsCacheEntryPtr entry;
+    unsigned long long now = 0;
+    bool useCache = false;
 
     memset(info, 0, sizeof(*info));
 
     virUUIDFormat(domain->uuid, uuid_string);
 
-    /* Get Msvm_ComputerSystem */
+    /* Get Msvm_ComputerSystem; the domain state is always fetched
+     * fresh, only the settings data below may be served from the
+     * cache */
     if (hypervMsvmComputerSystemFromDomain(domain, &computerSystem) < 0)
         goto cleanup;
 
+    info->state = hypervMsvmComputerSystemEnabledStateToDomainState(computerSystem);
+    info->cpuTime = 0;
+
+    /* If we can't get a timestamp just skip the cache entirely */
+    if (virTimeMillisNowRaw(&now) == 0) {
+        virMutexLock(&priv->settingsCacheLock);
+        entry = virHashLookup(priv->settingsCache, uuid_string);
+        if (entry &&
+            now - entry->when < HYPERV_SETTINGS_CACHE_TTL) {
+            info->maxMem = entry->maxMem;
+            info->memory = entry->memory;
+            info->nrVirtCpu = entry->nrVirtCpu;
+            virMutexUnlock(&priv->settingsCacheLock);
+
+            result = 0;
+            goto cleanup;
+        }
+        virMutexUnlock(&priv->settingsCacheLock);
+        useCache = true;
+    }
+
     /* Get Msvm_VirtualSystemSettingData */
     virBufferAsprintf(&query,
                       "associators of "
@@ -714,11 +775,26 @@ hypervDomainGetInfo(virDomainPtr domain, virDomainInfoPtr info)
     }
 
     /* Fill struct */
-    info->state = hypervMsvmComputerSystemEnabledStateToDomainState(computerSystem);
     info->maxMem = memorySettingData->data->Limit * 1024; /* megabyte to kilobyte */
     info->memory = memorySettingData->data->VirtualQuantity * 1024; /* megabyte to kilobyte */
     info->nrVirtCpu = processorSettingData->data->VirtualQuantity;
-    info->cpuTime = 0;
+
+    if (useCache) {
+        virMutexLock(&priv->settingsCacheLock);
+        entry = virHashLookup(priv->settingsCache, uuid_string);
+        if (!entry) {
+            if (VIR_ALLOC_QUIET(entry) == 0 &&
+                virHashAddEntry(priv->settingsCache, uuid_string, entry) < 0)
+                VIR_FREE(entry);
+        }
+        if (entry) {
+            entry->when = now;
+            entry->maxMem = info->maxMem;
+            entry->memory = info->memory;
+            entry->nrVirtCpu = info->nrVirtCpu;
+        }
+        virMutexUnlock(&priv->settingsCacheLock);
+    }
 
     result = 0;
 
@@ -25,6 +25,8 @@
 
 # include "internal.h"
 # include "virerror.h"
+# include "virhash.h"
+# include "virthread.h"
 # include "hyperv_util.h"
 # include "openwsman.h"
 
@@ -33,6 +35,12 @@ typedef struct _hypervPrivate hypervPrivate;
 struct _hypervPrivate {
     hypervParsedUri *parsedUri;
     WsManClient *client;
+
+    /* Map of domain UUID to hypervSettingsCacheEntry, so repeated
+     * polls don't re-issue the WS-Man round trips for rarely
+     * changing settings data. Protected by @settingsCacheLock */
+    virMutex settingsCacheLock;
+    virHashTablePtr settingsCache;
 };
 
 #endif /* __HYPERV_PRIVATE_H__ */
@@ -1549,7 +1549,7 @@ virStorageVolCreateXMLFrom(virStoragePoolPtr pool,
  * @stream: stream to use as output
  * @offset: position in @vol to start reading from
  * @length: limit on amount of data to download
- * @flags: extra flags; not used yet, so callers should always pass 0
+ * @flags: bitwise-OR of virStorageVolDownloadFlags
  *
  * Download the content of the volume as a stream. If @length
  * is zero, then the remaining contents of the volume after
@@ -1561,6 +1561,12 @@ virStorageVolCreateXMLFrom(virStoragePoolPtr pool,
  * detect any errors. The results will be unpredictable if
  * another active stream is writing to the storage volume.
  *
+ * If VIR_STORAGE_VOL_DOWNLOAD_BYPASS_CACHE is set in @flags, the
+ * volume is read bypassing the file system cache where the storage
+ * backend supports it, so that a bulk transfer does not evict data
+ * that other consumers of the host are still using. The backend may
+ * require @offset and @length to be block aligned in that case.
+ *
  * Returns 0, or -1 upon error.
  */
 int
@@ -1613,7 +1619,7 @@ virStorageVolDownload(virStorageVolPtr vol,
  * @stream: stream to use as input
  * @offset: position to start writing to
  * @length: limit on amount of data to upload
- * @flags: extra flags; not used yet, so callers should always pass 0
+ * @flags: bitwise-OR of virStorageVolUploadFlags
  *
  * Upload new content to the volume from a stream. This call
  * will fail if @offset + @length exceeds the size of the
@@ -1635,6 +1641,13 @@ virStorageVolDownload(virStorageVolPtr vol,
  * characteristics from the source stream such as format type,
  * capacity, and allocation.
  *
+ * If VIR_STORAGE_VOL_UPLOAD_BYPASS_CACHE is set in @flags, the
+ * volume is written bypassing the file system cache where the
+ * storage backend supports it, so that a bulk transfer does not
+ * evict data that other consumers of the host are still using. The
+ * backend may require @offset and @length to be block aligned in
+ * that case.
+ *
  * Returns 0, or -1 upon error.
  */
 int
@@ -45,6 +45,7 @@
 #include "libxl_conf.h"
 #include "libxl_utils.h"
 #include "virstoragefile.h"
+#include "virtime.h"
 #include "secret_util.h"
 
 
@@ -1460,6 +1461,106 @@ libxlDriverConfigGet(libxlDriverPrivatePtr driver)
     return cfg;
 }
 
+static void
+libxlDriverDominfoCacheClearLocked(libxlDriverPrivatePtr driver)
+{
+    if (driver->dominfoCache) {
+        libxl_dominfo_list_free(driver->dominfoCache,
+                                driver->ndominfoCache);
+        driver->dominfoCache = NULL;
+        driver->ndominfoCache = 0;
+    }
+    driver->dominfoCacheTime = 0;
+}
+
+/*
+ * Drop any cached domain list so the next lookup fetches fresh data
+ * from the hypervisor. Called when a domain changes state under our
+ * feet, e.g. from the libxl shutdown event handler.
+ */
+void
+libxlDriverDominfoCacheInvalidate(libxlDriverPrivatePtr driver)
+{
+    libxlDriverLock(driver);
+    libxlDriverDominfoCacheClearLocked(driver);
+    libxlDriverUnlock(driver);
+}
+
+void
+libxlDriverDominfoCacheFree(libxlDriverPrivatePtr driver)
+{
+    libxlDriverDominfoCacheClearLocked(driver);
+}
+
+/*
+ * libxlDriverGetDominfo:
+ *
+ * Look up the libxl_dominfo for domain @id, serving it from a cached
+ * libxl_list_domain snapshot no older than LIBXL_DOMINFO_CACHE_TTL
+ * milliseconds. One list call per poll cycle replaces one
+ * libxl_domain_info round trip per domain.
+ *
+ * On success @info is a copy of the cache entry and must not be
+ * passed to libxl_dominfo_dispose by the caller.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+libxlDriverGetDominfo(libxlDriverPrivatePtr driver,
+                      libxlDriverConfigPtr cfg,
+                      int id,
+                      libxl_dominfo *info)
+{
+    libxl_dominfo *list;
+    unsigned long long now;
+    int nb_domain;
+    bool refreshed = false;
+    int i;
+    int ret = -1;
+
+    if (virTimeMillisNow(&now) < 0)
+        return -1;
+
+    libxlDriverLock(driver);
+
+ retry:
+    if (!driver->dominfoCache ||
+        now - driver->dominfoCacheTime >= LIBXL_DOMINFO_CACHE_TTL) {
+        if (!(list = libxl_list_domain(cfg->ctx, &nb_domain))) {
+            virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                           _("libxl_list_domain failed"));
+            goto cleanup;
+        }
+        libxlDriverDominfoCacheClearLocked(driver);
+        driver->dominfoCache = list;
+        driver->ndominfoCache = nb_domain;
+        driver->dominfoCacheTime = now;
+        refreshed = true;
+    }
+
+    for (i = 0; i < driver->ndominfoCache; i++) {
+        if (driver->dominfoCache[i].domid == id) {
+            *info = driver->dominfoCache[i];
+            ret = 0;
+            goto cleanup;
+        }
+    }
+
+    /* A domain started after the last refresh is not in the snapshot
+     * yet, so force one refresh before giving up on it */
+    if (!refreshed) {
+        driver->dominfoCacheTime = 0;
+        goto retry;
+    }
+
+    virReportError(VIR_ERR_INTERNAL_ERROR,
+                   _("libxl_domain_info failed for domain '%d'"), id);
+
+ cleanup:
+    libxlDriverUnlock(driver);
+    return ret;
+}
+
 int libxlDriverConfigLoadFile(libxlDriverConfigPtr cfg,
                               const char *filename)
 {
@@ -141,8 +141,20 @@ struct _libxlDriverPrivate {
 
     /* Immutable pointer. lockless access */
     virLockManagerPluginPtr lockManager;
+
+    /* Cache of libxl_list_domain output. Require lock for all access.
+     * Refreshed at most once per LIBXL_DOMINFO_CACHE_TTL milliseconds,
+     * so stats pollers walking every domain cost one list hypercall
+     * per cycle instead of one libxl_domain_info call per domain. */
+    libxl_dominfo *dominfoCache;
+    int ndominfoCache;
+    unsigned long long dominfoCacheTime;
 };
 
+/* How long in milliseconds an entry in the dominfo cache is served
+ * before the domain list is fetched from the hypervisor again */
+# define LIBXL_DOMINFO_CACHE_TTL 1000
+
 # define LIBXL_SAVE_MAGIC "libvirt-xml\n \0 \r"
 # ifdef LIBXL_HAVE_SRM_V2
 #  define LIBXL_SAVE_VERSION 2
@@ -170,6 +182,18 @@ int
 libxlDriverNodeGetInfo(libxlDriverPrivatePtr driver,
                        virNodeInfoPtr info);
 
+int
+libxlDriverGetDominfo(libxlDriverPrivatePtr driver,
+                      libxlDriverConfigPtr cfg,
+                      int id,
+                      libxl_dominfo *info);
+
+void
+libxlDriverDominfoCacheInvalidate(libxlDriverPrivatePtr driver);
+
+void
+libxlDriverDominfoCacheFree(libxlDriverPrivatePtr driver);
+
 int libxlDriverConfigLoadFile(libxlDriverConfigPtr cfg,
                               const char *filename);
 
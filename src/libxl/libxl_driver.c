@@ -482,6 +482,7 @@ libxlStateCleanup(void)
     virObjectUnref(libxl_driver->domainEventState);
     virSysinfoDefFree(libxl_driver->hostsysinfo);
 
+    libxlDriverDominfoCacheFree(libxl_driver);
     virMutexDestroy(&libxl_driver->lock);
     VIR_FREE(libxl_driver);
 
@@ -735,7 +736,7 @@ libxlStateInitialize(bool privileged,
         goto error;
 
     /* read the host sysinfo */
-    libxl_driver->hostsysinfo = virSysinfoRead();
+    libxl_driver->hostsysinfo = virSysinfoReadCached();
 
     libxl_driver->domainEventState = virObjectEventStateNew();
     if (!libxl_driver->domainEventState)
@@ -1643,19 +1644,14 @@ libxlDomainGetInfo(virDomainPtr dom, virDomainInfoPtr info)
         info->memory = vm->def->mem.cur_balloon;
         info->maxMem = virDomainDefGetMemoryTotal(vm->def);
     } else {
-        libxl_dominfo_init(&d_info);
-
-        if (libxl_domain_info(cfg->ctx, &d_info, vm->def->id) != 0) {
-            virReportError(VIR_ERR_INTERNAL_ERROR,
-                           _("libxl_domain_info failed for domain '%d'"),
-                           vm->def->id);
+        /* Served from the shared libxl_list_domain snapshot; the copy
+         * aliases the cache entry and must not be disposed */
+        if (libxlDriverGetDominfo(driver, cfg, vm->def->id, &d_info) < 0)
             goto cleanup;
-        }
+
         info->cpuTime = d_info.cpu_time;
         info->memory = d_info.current_memkb;
         info->maxMem = d_info.max_memkb;
-
-        libxl_dominfo_dispose(&d_info);
     }
 
     info->state = virDomainObjGetState(vm, NULL);
@@ -4040,7 +4036,7 @@ libxlDomainAttachDeviceFlags(virDomainPtr dom, const char *xml,
 
         /* Make a copy for updated domain. */
         if (!(vmdef = virDomainObjCopyPersistentDef(vm, cfg->caps,
-                                                    driver->xmlopt)))
+                                                    driver->xmlopt, NULL)))
             goto endjob;
 
         if (libxlDomainAttachDeviceConfig(vmdef, dev) < 0)
@@ -4130,7 +4126,7 @@ libxlDomainDetachDeviceFlags(virDomainPtr dom, const char *xml,
 
         /* Make a copy for updated domain. */
         if (!(vmdef = virDomainObjCopyPersistentDef(vm, cfg->caps,
-                                                    driver->xmlopt)))
+                                                    driver->xmlopt, NULL)))
             goto endjob;
 
         if (libxlDomainDetachDeviceConfig(vmdef, dev) < 0)
@@ -4217,7 +4213,7 @@ libxlDomainUpdateDeviceFlags(virDomainPtr dom, const char *xml,
 
         /* Make a copy for updated domain. */
         if (!(vmdef = virDomainObjCopyPersistentDef(vm, cfg->caps,
-                                                    driver->xmlopt)))
+                                                    driver->xmlopt, NULL)))
             goto cleanup;
 
         if ((ret = libxlDomainUpdateDeviceConfig(vmdef, dev)) < 0)
@@ -63,6 +63,10 @@ struct _virLogHandler {
     size_t max_size;
     size_t max_backups;
 
+    /* Scratch buffer for draining log pipes, shared by all
+     * files since the handler is locked while reading */
+    char *readbuf;
+
     virLogHandlerLogFilePtr *files;
     size_t nfiles;
 
@@ -70,6 +74,12 @@ struct _virLogHandler {
     void *opaque;
 };
 
+/* Size of the pipe read buffer. Matches the default pipe capacity
+ * on Linux, so a single read can drain everything a guest wrote
+ * since the last wakeup and the rotating file sees one large
+ * append instead of a stream of 1k writes */
+#define VIR_LOG_HANDLER_READ_BUFLEN (64 * 1024)
+
 static virClassPtr virLogHandlerClass;
 static void virLogHandlerDispose(void *obj);
 
@@ -145,7 +155,6 @@ virLogHandlerDomainLogFileEvent(int watch,
 {
     virLogHandlerPtr handler = opaque;
     virLogHandlerLogFilePtr logfile;
-    char buf[1024];
     ssize_t len;
 
     virObjectLock(handler);
@@ -157,7 +166,7 @@ virLogHandlerDomainLogFileEvent(int watch,
     }
 
  reread:
-    len = read(fd, buf, sizeof(buf));
+    len = read(fd, handler->readbuf, VIR_LOG_HANDLER_READ_BUFLEN);
     if (len < 0) {
         if (errno == EINTR)
             goto reread;
@@ -167,7 +176,7 @@ virLogHandlerDomainLogFileEvent(int watch,
         goto error;
     }
 
-    if (virRotatingFileWriterAppend(logfile->file, buf, len) != len)
+    if (virRotatingFileWriterAppend(logfile->file, handler->readbuf, len) != len)
         goto error;
 
     if (events & VIR_EVENT_HANDLE_HANGUP)
@@ -198,6 +207,11 @@ virLogHandlerNew(bool privileged,
     if (!(handler = virObjectLockableNew(virLogHandlerClass)))
         goto error;
 
+    if (VIR_ALLOC_N(handler->readbuf, VIR_LOG_HANDLER_READ_BUFLEN) < 0) {
+        virObjectUnref(handler);
+        goto error;
+    }
+
     handler->privileged = privileged;
     handler->max_size = max_size;
     handler->max_backups = max_backups;
@@ -357,6 +371,7 @@ virLogHandlerDispose(void *obj)
         virLogHandlerLogFileFree(handler->files[i]);
     }
     VIR_FREE(handler->files);
+    VIR_FREE(handler->readbuf);
 }
 
 
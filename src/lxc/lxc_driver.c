@@ -1650,7 +1650,7 @@ static int lxcStateInitialize(bool privileged,
     if (!lxc_driver->domainEventState)
         goto cleanup;
 
-    lxc_driver->hostsysinfo = virSysinfoRead();
+    lxc_driver->hostsysinfo = virSysinfoReadCached();
 
     if (!(lxc_driver->config = cfg = virLXCDriverConfigNew()))
         goto cleanup;
@@ -1985,7 +1985,8 @@ lxcDomainSetSchedulerParametersFlags(virDomainPtr dom,
 
     if (persistentDef) {
         /* Make a copy for updated domain. */
-        persistentDefCopy = virDomainObjCopyPersistentDef(vm, caps, driver->xmlopt);
+        persistentDefCopy = virDomainObjCopyPersistentDef(vm, caps, driver->xmlopt,
+                                              NULL);
         if (!persistentDefCopy)
             goto endjob;
     }
@@ -4812,7 +4813,8 @@ static int lxcDomainAttachDeviceFlags(virDomainPtr dom,
 
     if (flags & VIR_DOMAIN_AFFECT_CONFIG) {
         /* Make a copy for updated domain. */
-        vmdef = virDomainObjCopyPersistentDef(vm, caps, driver->xmlopt);
+        vmdef = virDomainObjCopyPersistentDef(vm, caps, driver->xmlopt,
+                                              NULL);
         if (!vmdef)
             goto endjob;
 
@@ -4925,7 +4927,8 @@ static int lxcDomainUpdateDeviceFlags(virDomainPtr dom,
 
     if (flags & VIR_DOMAIN_AFFECT_CONFIG) {
         /* Make a copy for updated domain. */
-        vmdef = virDomainObjCopyPersistentDef(vm, caps, driver->xmlopt);
+        vmdef = virDomainObjCopyPersistentDef(vm, caps, driver->xmlopt,
+                                              NULL);
         if (!vmdef)
             goto endjob;
 
@@ -5022,7 +5025,8 @@ static int lxcDomainDetachDeviceFlags(virDomainPtr dom,
 
     if (flags & VIR_DOMAIN_AFFECT_CONFIG) {
         /* Make a copy for updated domain. */
-        vmdef = virDomainObjCopyPersistentDef(vm, caps, driver->xmlopt);
+        vmdef = virDomainObjCopyPersistentDef(vm, caps, driver->xmlopt,
+                                              NULL);
         if (!vmdef)
             goto endjob;
 
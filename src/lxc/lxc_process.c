@@ -49,6 +49,7 @@
 #include "lxc_hostdev.h"
 #include "virhook.h"
 #include "virstring.h"
+#include "virthread.h"
 #include "viratomic.h"
 #include "virprocess.h"
 #include "virsystemd.h"
@@ -1289,7 +1290,7 @@ int virLXCProcessStart(virConnectPtr conn,
      * report implicit runtime defaults in the XML, like vnc listen/socket
      */
     VIR_DEBUG("Setting current domain def as transient");
-    if (virDomainObjSetDefTransient(caps, driver->xmlopt, vm) < 0)
+    if (virDomainObjSetDefTransient(caps, driver->xmlopt, vm, NULL) < 0)
         goto cleanup;
 
     /* Run an early hook to set-up missing devices */
@@ -1616,16 +1617,18 @@ int virLXCProcessStart(virConnectPtr conn,
 struct virLXCProcessAutostartData {
     virLXCDriverPtr driver;
     virConnectPtr conn;
+    virDomainObjPtr vm;
 };
 
-static int
-virLXCProcessAutostartDomain(virDomainObjPtr vm,
-                             void *opaque)
+static void
+virLXCProcessAutostartDomain(void *opaque)
 {
-    const struct virLXCProcessAutostartData *data = opaque;
-    int ret = 0;
+    struct virLXCProcessAutostartData *data = opaque;
+    virDomainObjPtr vm = data->vm;
+    int ret;
 
-    virObjectLock(vm);
+    /* The domain object is locked and referenced by
+     * virLXCProcessAutostartHelper, which hands both over to us */
     if (vm->autostart &&
         !virDomainObjIsActive(vm)) {
         ret = virLXCProcessStart(data->conn, data->driver, vm,
@@ -1646,7 +1649,63 @@ virLXCProcessAutostartDomain(virDomainObjPtr vm,
         }
     }
     virObjectUnlock(vm);
-    return ret;
+    virObjectUnref(vm);
+    virObjectUnref(data->conn);
+    VIR_FREE(data);
+}
+
+
+struct virLXCProcessAutostartHelperData {
+    virLXCDriverPtr driver;
+    virConnectPtr conn;
+    virThreadPtr threads;
+    size_t nthreads;
+};
+
+static int
+virLXCProcessAutostartHelper(virDomainObjPtr vm,
+                             void *opaque)
+{
+    struct virLXCProcessAutostartHelperData *src = opaque;
+    struct virLXCProcessAutostartData *data;
+
+    /* Containers which don't need starting never get a thread, so a
+     * host with few autostarted containers doesn't pay for the rest */
+    if (!vm->autostart ||
+        virDomainObjIsActive(vm))
+        return 0;
+
+    if (VIR_ALLOC(data) < 0)
+        return -1;
+
+    data->driver = src->driver;
+    data->conn = src->conn;
+    data->vm = vm;
+
+    if (VIR_EXPAND_N(src->threads, src->nthreads, 1) < 0) {
+        VIR_FREE(data);
+        return -1;
+    }
+
+    /* This lock and these references are eventually transferred to the
+     * thread that handles the startup */
+    virObjectLock(vm);
+    virObjectRef(vm);
+    virObjectRef(data->conn);
+
+    if (virThreadCreate(&src->threads[src->nthreads - 1], true,
+                        virLXCProcessAutostartDomain, data) < 0) {
+        VIR_ERROR(_("Failed to create thread to autostart VM '%s'"),
+                  vm->def->name);
+        src->nthreads--;
+        virObjectUnref(data->conn);
+        virObjectUnlock(vm);
+        virObjectUnref(vm);
+        VIR_FREE(data);
+        return -1;
+    }
+
+    return 0;
 }
 
 
@@ -1661,12 +1720,23 @@ virLXCProcessAutostartAll(virLXCDriverPtr driver)
     virConnectPtr conn = virConnectOpen("lxc:///");
     /* Ignoring NULL conn which is mostly harmless here */
 
-    struct virLXCProcessAutostartData data = { driver, conn };
+    struct virLXCProcessAutostartHelperData data = { driver, conn, NULL, 0 };
+    size_t i;
 
+    /* Startup of each container is handed to its own thread so that the
+     * expensive parts - veth creation, cgroup setup and the controller
+     * handshake - overlap across containers instead of running back to
+     * back. We still wait for all of them before returning so that the
+     * daemon doesn't report itself ready with containers half started.
+     */
     virDomainObjListForEach(driver->domains,
-                            virLXCProcessAutostartDomain,
+                            virLXCProcessAutostartHelper,
                             &data);
 
+    for (i = 0; i < data.nthreads; i++)
+        virThreadJoin(&data.threads[i]);
+    VIR_FREE(data.threads);
+
     virObjectUnref(conn);
 }
 
@@ -1555,6 +1555,10 @@ networkRefreshDhcpDaemon(virNetworkDriverStatePtr driver,
     if ((ret = dnsmasqSave(dctx)) < 0)
         goto cleanup;
 
+    /* if none of the files changed, spare dnsmasq the re-read */
+    if (ret == 0)
+        goto cleanup;
+
     ret = kill(network->dnsmasqPid, SIGHUP);
  cleanup:
     dnsmasqContextFree(dctx);
@@ -3497,9 +3501,12 @@ networkUpdate(virNetworkPtr net,
                 }
             }
 
-            if ((newDhcpActive != oldDhcpActive &&
-                 networkRestartDhcpDaemon(driver, network) < 0) ||
-                networkRefreshDhcpDaemon(driver, network) < 0) {
+            if (newDhcpActive != oldDhcpActive) {
+                /* the restart rewrites the hosts files too, so no
+                 * separate refresh is needed */
+                if (networkRestartDhcpDaemon(driver, network) < 0)
+                    goto cleanup;
+            } else if (networkRefreshDhcpDaemon(driver, network) < 0) {
                 goto cleanup;
             }
 
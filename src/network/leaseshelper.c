@@ -255,6 +255,12 @@ main(int argc, char **argv)
         if (virFileRewrite(custom_lease_file, 0644,
                            customLeaseRewriteFile, &leases_str) < 0)
             goto cleanup;
+
+        /* Refresh the binary index the NSS plugin searches. On
+         * failure the stale index has been removed and readers fall
+         * back to parsing the JSON file, so the lease update itself
+         * still succeeds */
+        ignore_value(virLeaseIndexSave(custom_lease_file, leases_array_new));
         break;
 
     case VIR_LEASE_ACTION_LAST:
@@ -1326,18 +1326,23 @@ static void udevEventHandleCallback(int watch ATTRIBUTE_UNUSED,
         goto cleanup;
     }
 
-    action = udev_device_get_action(device);
-    VIR_DEBUG("udev action: '%s'", action);
+    /* The monitor socket is non-blocking, so drain everything that has
+     * queued up since the last wakeup instead of handling one device
+     * per event-loop iteration; a storm of uevents (a SAN rescan
+     * queues thousands) would otherwise be processed at the rate of
+     * one per poll cycle and the device list would lag far behind the
+     * kernel's view of the hardware */
+    do {
+        action = udev_device_get_action(device);
+        VIR_DEBUG("udev action: '%s'", action);
 
-    if (STREQ(action, "add") || STREQ(action, "change")) {
-        udevAddOneDevice(device);
-        goto cleanup;
-    }
+        if (STREQ(action, "add") || STREQ(action, "change"))
+            udevAddOneDevice(device);
+        else if (STREQ(action, "remove"))
+            udevRemoveOneDevice(device);
 
-    if (STREQ(action, "remove")) {
-        udevRemoveOneDevice(device);
-        goto cleanup;
-    }
+        udev_device_unref(device);
+    } while ((device = udev_monitor_receive_device(udev_monitor)));
 
  cleanup:
     udev_device_unref(device);
@@ -80,18 +80,27 @@ VIR_LOG_INIT("nwfilter.nwfilter_dhcpsnoop");
 # define LEASEFILE LEASEFILE_DIR "nwfilter.leases"
 # define TMPLEASEFILE LEASEFILE_DIR "nwfilter.ltmp"
 
+typedef struct _virNWFilterSnoopIfConf virNWFilterSnoopIfConf;
+typedef virNWFilterSnoopIfConf *virNWFilterSnoopIfConfPtr;
+
 struct virNWFilterSnoopState {
     /* lease file */
     int                  leaseFD;
     int                  nLeases; /* number of active leases */
     int                  wLeases; /* number of written leases */
-    int                  nThreads; /* number of running threads */
+    int                  nThreads; /* number of interfaces on the poll loop */
     /* thread management */
     virHashTablePtr      snoopReqs;
     virHashTablePtr      ifnameToKey;
     virMutex             snoopLock;  /* protects SnoopReqs and IfNameToKey */
     virHashTablePtr      active;
     virMutex             activeLock; /* protects Active */
+    /* poll thread management */
+    virNWFilterSnoopIfConfPtr ifConfs; /* interfaces watched by the poll thread */
+    bool                 pollRunning;
+    int                  pollPipe[2]; /* wakes up the poll thread */
+    virThreadPoolPtr     pollWorker;  /* decodes the DHCP messages */
+    virMutex             pollLock;   /* protects IfConfs, PollRunning & PollPipe */
 };
 
 # define virNWFilterSnoopLock() \
@@ -110,6 +119,14 @@ struct virNWFilterSnoopState {
     do { \
         virMutexUnlock(&virNWFilterSnoopState.activeLock); \
     } while (0)
+# define virNWFilterSnoopPollLock() \
+    do { \
+        virMutexLock(&virNWFilterSnoopState.pollLock); \
+    } while (0)
+# define virNWFilterSnoopPollUnlock() \
+    do { \
+        virMutexUnlock(&virNWFilterSnoopState.pollLock); \
+    } while (0)
 
 # define VIR_IFKEY_LEN   ((VIR_UUID_STRING_BUFLEN) + (VIR_MAC_STRING_BUFLEN))
 
@@ -119,12 +136,6 @@ typedef virNWFilterSnoopReq *virNWFilterSnoopReqPtr;
 typedef struct _virNWFilterSnoopIPLease virNWFilterSnoopIPLease;
 typedef virNWFilterSnoopIPLease *virNWFilterSnoopIPLeasePtr;
 
-typedef enum {
-    THREAD_STATUS_NONE,
-    THREAD_STATUS_OK,
-    THREAD_STATUS_FAIL,
-} virNWFilterSnoopThreadStatus;
-
 struct _virNWFilterSnoopReq {
     /*
      * reference counter: while the req is on the
@@ -147,9 +158,6 @@ struct _virNWFilterSnoopReq {
     virNWFilterSnoopIPLeasePtr           end;
     char                                *threadkey;
 
-    virNWFilterSnoopThreadStatus         threadStatus;
-    virCond                              threadStatusCond;
-
     int                                  jobCompletionStatus;
     /* the number of submitted jobs in the worker's queue */
     /*
@@ -161,7 +169,6 @@ struct _virNWFilterSnoopReq {
      * - start
      * - end
      * - a lease while it is on the list
-     * - threadStatus
      * (for refctr, see above)
      */
     virMutex                             lock;
@@ -171,8 +178,10 @@ struct _virNWFilterSnoopReq {
  * Note about lock-order:
  * 1st: virNWFilterSnoopLock()
  * 2nd: virNWFilterSnoopReqLock(req)
+ * 3rd: virNWFilterSnoopPollLock()
  *
- * Rationale: Former protects the SnoopReqs hash, latter its contents
+ * Rationale: First protects the SnoopReqs hash, second its contents,
+ * last the interface list of the poll thread
  */
 
 struct _virNWFilterSnoopIPLease {
@@ -241,6 +250,7 @@ typedef struct _virNWFilterDHCPDecodeJob virNWFilterDHCPDecodeJob;
 typedef virNWFilterDHCPDecodeJob *virNWFilterDHCPDecodeJobPtr;
 
 struct _virNWFilterDHCPDecodeJob {
+    virNWFilterSnoopReqPtr req; /* the job holds a reference */
     unsigned char packet[PCAP_PBUFSIZE];
     int caplen;
     bool fromVM;
@@ -266,9 +276,9 @@ struct _virNWFilterSnoopRateLimitConf {
     time_t prev;
     unsigned int pkt_ctr;
     time_t burst;
-    const unsigned int rate;
-    const unsigned int burstRate;
-    const unsigned int burstInterval;
+    unsigned int rate;
+    unsigned int burstRate;
+    unsigned int burstInterval;
 };
 # define SNOOP_POLL_MAX_TIMEOUT_MS  (10 * 1000) /* milliseconds */
 
@@ -277,14 +287,30 @@ typedef virNWFilterSnoopPcapConf *virNWFilterSnoopPcapConfPtr;
 
 struct _virNWFilterSnoopPcapConf {
     pcap_t *handle;
-    const pcap_direction_t dir;
+    pcap_direction_t dir;
     const char *filter;
     virNWFilterSnoopRateLimitConf rateLimit; /* indep. rate limiters */
     int qCtr; /* number of jobs in the worker's queue */
-    const unsigned int maxQSize;
+    unsigned int maxQSize;
     unsigned long long penaltyTimeoutAbs;
 };
 
+/*
+ * The pcap sockets of one snooped interface, as watched by the
+ * poll thread. The entry owns a reference to the req.
+ */
+struct _virNWFilterSnoopIfConf {
+    virNWFilterSnoopReqPtr        req;
+    char                         *threadkey; /* copy of req->threadkey */
+    int                           ifindex;
+    int                           errcount;
+    bool                          error; /* sockets unusable; stop snooping */
+    time_t                        lastRateReport;
+    time_t                        lastQueueReport;
+    virNWFilterSnoopPcapConf      pcapConf[2];
+    virNWFilterSnoopIfConfPtr     next;
+};
+
 /* local function prototypes */
 static int virNWFilterSnoopReqLeaseDel(virNWFilterSnoopReqPtr req,
                                        virSocketAddrPtr ipaddr,
@@ -297,9 +323,12 @@ static void virNWFilterSnoopReqUnlock(virNWFilterSnoopReqPtr req);
 static void virNWFilterSnoopLeaseFileLoad(void);
 static void virNWFilterSnoopLeaseFileSave(virNWFilterSnoopIPLeasePtr ipl);
 
+static void virNWFilterSnoopPollWakeup(void);
+
 /* local variables */
 static struct virNWFilterSnoopState virNWFilterSnoopState = {
     .leaseFD = -1,
+    .pollPipe = { -1, -1 },
 };
 
 static const unsigned char dhcp_magic[4] = { 99, 130, 83, 99 };
@@ -335,6 +364,9 @@ virNWFilterSnoopCancel(char **threadKey)
     VIR_FREE(*threadKey);
 
     virNWFilterSnoopActiveUnlock();
+
+    /* have the poll thread notice the cancellation */
+    virNWFilterSnoopPollWakeup();
 }
 
 static bool
@@ -589,22 +621,14 @@ virNWFilterSnoopReqNew(const char *ifkey)
     if (VIR_ALLOC(req) < 0)
         return NULL;
 
-    req->threadStatus = THREAD_STATUS_NONE;
-
     if (virStrcpyStatic(req->ifkey, ifkey) == NULL ||
         virMutexInitRecursive(&req->lock) < 0)
         goto err_free_req;
 
-    if (virCondInit(&req->threadStatusCond) < 0)
-        goto err_destroy_mutex;
-
     virNWFilterSnoopReqGet(req);
 
     return req;
 
- err_destroy_mutex:
-    virMutexDestroy(&req->lock);
-
  err_free_req:
     VIR_FREE(req);
 
@@ -638,7 +662,6 @@ virNWFilterSnoopReqFree(virNWFilterSnoopReqPtr req)
     virNWFilterHashTableFree(req->vars);
 
     virMutexDestroy(&req->lock);
-    virCondDestroy(&req->threadStatusCond);
 
     VIR_FREE(req);
 }
@@ -1159,10 +1182,11 @@ virNWFilterSnoopDHCPOpen(const char *ifname, virMacAddr *mac,
  * Worker function to decode the DHCP message and with that
  * also do the time-consuming work of instantiating the filters
  */
-static void virNWFilterDHCPDecodeWorker(void *jobdata, void *opaque)
+static void virNWFilterDHCPDecodeWorker(void *jobdata,
+                                        void *opaque ATTRIBUTE_UNUSED)
 {
-    virNWFilterSnoopReqPtr req = opaque;
     virNWFilterDHCPDecodeJobPtr job = jobdata;
+    virNWFilterSnoopReqPtr req = job->req;
     virNWFilterSnoopEthHdrPtr packet = (virNWFilterSnoopEthHdrPtr)job->packet;
 
     if (virNWFilterSnoopDHCPDecode(req, packet,
@@ -1174,6 +1198,7 @@ static void virNWFilterDHCPDecodeWorker(void *jobdata, void *opaque)
                          "interface '%s'"), req->ifname);
     }
     virAtomicIntDecAndTest(job->qCtr);
+    virNWFilterSnoopReqPut(req);
     VIR_FREE(job);
 }
 
@@ -1182,6 +1207,7 @@ static void virNWFilterDHCPDecodeWorker(void *jobdata, void *opaque)
  */
 static int
 virNWFilterSnoopDHCPDecodeJobSubmit(virThreadPoolPtr pool,
+                                    virNWFilterSnoopReqPtr req,
                                     virNWFilterSnoopEthHdrPtr pep,
                                     int len, pcap_direction_t dir,
                                     int *qCtr)
@@ -1195,6 +1221,10 @@ virNWFilterSnoopDHCPDecodeJobSubmit(virThreadPoolPtr pool,
     if (VIR_ALLOC(job) < 0)
         return -1;
 
+    /* keep the req alive until the job is done */
+    virNWFilterSnoopReqGet(req);
+
+    job->req = req;
     memcpy(job->packet, pep, len);
     job->caplen = len;
     job->fromVM = (dir == PCAP_D_IN);
@@ -1202,10 +1232,12 @@ virNWFilterSnoopDHCPDecodeJobSubmit(virThreadPoolPtr pool,
 
     ret = virThreadPoolSendJob(pool, 0, job);
 
-    if (ret == 0)
+    if (ret == 0) {
         virAtomicIntInc(qCtr);
-    else
+    } else {
+        virNWFilterSnoopReqPut(req);
         VIR_FREE(job);
+    }
 
     return ret;
 }
@@ -1328,251 +1360,447 @@ virNWFilterSnoopAdjustPoll(virNWFilterSnoopPcapConfPtr pc,
 }
 
 /*
- * The DHCP snooping thread. It spends most of its time in the pcap
- * library and if it gets suitable packets, it submits them to the worker
- * thread for processing.
+ * Wake up the poll thread so that it re-reads the list of watched
+ * interfaces right away.
  */
 static void
-virNWFilterDHCPSnoopThread(void *req0)
+virNWFilterSnoopPollWakeup(void)
 {
-    virNWFilterSnoopReqPtr req = req0;
+    char c = 0;
+
+    virNWFilterSnoopPollLock();
+
+    if (virNWFilterSnoopState.pollPipe[1] >= 0)
+        ignore_value(safewrite(virNWFilterSnoopState.pollPipe[1], &c, 1));
+
+    virNWFilterSnoopPollUnlock();
+}
+
+/*
+ * Free the pcap sockets of an interface and release the reference
+ * to its req. Only call this once no more decoder jobs reference
+ * the entry's job counters.
+ */
+static void
+virNWFilterSnoopIfConfFree(virNWFilterSnoopIfConfPtr conf)
+{
+    size_t i;
+
+    if (!conf)
+        return;
+
+    for (i = 0; i < ARRAY_CARDINALITY(conf->pcapConf); i++) {
+        if (conf->pcapConf[i].handle)
+            pcap_close(conf->pcapConf[i].handle);
+    }
+
+    virNWFilterSnoopReqPut(conf->req);
+
+    VIR_FREE(conf->threadkey);
+    VIR_FREE(conf);
+}
+
+/*
+ * Take an interface off the poll thread's list and close its pcap
+ * sockets. With disassociate set the snooping on the interface ends
+ * for good: the threadkey is cancelled and the interface name is
+ * dropped, allowing a later restart on the same interface.
+ */
+static void
+virNWFilterSnoopIfConfDetach(virNWFilterSnoopIfConfPtr conf,
+                             bool disassociate)
+{
+    virNWFilterSnoopIfConfPtr *prev;
+    size_t i;
+
+    virNWFilterSnoopPollLock();
+
+    for (prev = &virNWFilterSnoopState.ifConfs; *prev; prev = &(*prev)->next) {
+        if (*prev == conf) {
+            *prev = conf->next;
+            break;
+        }
+    }
+
+    virNWFilterSnoopPollUnlock();
+
+    conf->next = NULL;
+
+    for (i = 0; i < ARRAY_CARDINALITY(conf->pcapConf); i++) {
+        if (conf->pcapConf[i].handle) {
+            pcap_close(conf->pcapConf[i].handle);
+            conf->pcapConf[i].handle = NULL;
+        }
+    }
+
+    if (disassociate) {
+        /* protect IfNameToKey */
+        virNWFilterSnoopLock();
+
+        /* protect req->ifname & req->threadkey */
+        virNWFilterSnoopReqLock(conf->req);
+
+        virNWFilterSnoopCancel(&conf->req->threadkey);
+
+        ignore_value(virHashRemoveEntry(virNWFilterSnoopState.ifnameToKey,
+                                        conf->req->ifname));
+
+        VIR_FREE(conf->req->ifname);
+
+        virNWFilterSnoopReqUnlock(conf->req);
+        virNWFilterSnoopUnlock();
+    }
+}
+
+/*
+ * Read one packet from the given pcap socket of an interface and
+ * submit it to the worker thread.
+ *
+ * Returns 0 on success, -1 once the socket has become unusable.
+ */
+static int
+virNWFilterSnoopIfConfRecv(virNWFilterSnoopIfConfPtr conf,
+                           size_t idx)
+{
+    virNWFilterSnoopPcapConfPtr pc = &conf->pcapConf[idx];
+    virNWFilterSnoopReqPtr req = conf->req;
     struct pcap_pkthdr *hdr;
     virNWFilterSnoopEthHdrPtr packet;
-    int ifindex = 0;
-    int errcount = 0;
-    int tmp = -1, rv, n, pollTo;
-    size_t i;
-    char *threadkey = NULL;
-    virThreadPoolPtr worker = NULL;
-    time_t last_displayed = 0, last_displayed_queue = 0;
-    virNWFilterSnoopPcapConf pcapConf[] = {
-        {
-            .dir = PCAP_D_IN, /* from VM */
-            .filter = "dst port 67 and src port 68",
-            .rateLimit = {
-                .prev = time(0),
-                .rate = DHCP_PKT_RATE,
-                .burstRate = DHCP_PKT_BURST,
-                .burstInterval = DHCP_BURST_INTERVAL_S,
-            },
-            .maxQSize = MAX_QUEUED_JOBS,
-        }, {
-            .dir = PCAP_D_OUT, /* to VM */
-            .filter = "src port 67 and dst port 68",
-            .rateLimit = {
-                .prev = time(0),
-                .rate = DHCP_PKT_RATE,
-                .burstRate = DHCP_PKT_BURST,
-                .burstInterval = DHCP_BURST_INTERVAL_S,
-            },
-            .maxQSize = MAX_QUEUED_JOBS,
-        },
-    };
-    struct pollfd fds[] = {
-        {
-            /* get a POLLERR if interface goes down or disappears */
-            .events = POLLIN | POLLERR,
-        }, {
-            .events = POLLIN | POLLERR,
-        },
-    };
-    bool error = false;
-
-    /* whoever started us increased the reference counter for the req for us */
-
-    /* protect req->ifname & req->threadkey */
-    virNWFilterSnoopReqLock(req);
+    int rv, tmp;
 
-    if (req->ifname && req->threadkey) {
-        for (i = 0; i < ARRAY_CARDINALITY(pcapConf); i++) {
-            pcapConf[i].handle =
-                virNWFilterSnoopDHCPOpen(req->ifname, &req->macaddr,
-                                         pcapConf[i].filter,
-                                         pcapConf[i].dir);
-            if (!pcapConf[i].handle) {
-                error = true;
-                break;
-            }
-            fds[i].fd = pcap_fileno(pcapConf[i].handle);
+    rv = pcap_next_ex(pc->handle, &hdr, (const u_char **)&packet);
+
+    if (rv < 0) {
+        /* error reading from socket */
+        tmp = -1;
+
+        /* protect req->ifname */
+        virNWFilterSnoopReqLock(req);
+
+        if (req->ifname)
+            tmp = virNetDevValidateConfig(req->ifname, NULL, conf->ifindex);
+
+        virNWFilterSnoopReqUnlock(req);
+
+        if (tmp <= 0)
+            return -1;
+
+        if (++conf->errcount > PCAP_READ_MAXERRS) {
+            pcap_close(pc->handle);
+            pc->handle = NULL;
+
+            /* protect req->ifname */
+            virNWFilterSnoopReqLock(req);
+
+            virReportError(VIR_ERR_INTERNAL_ERROR,
+                           _("interface '%s' failing; "
+                             "reopening"),
+                           req->ifname);
+            if (req->ifname)
+                pc->handle =
+                    virNWFilterSnoopDHCPOpen(req->ifname, &req->macaddr,
+                                             pc->filter, pc->dir);
+
+            virNWFilterSnoopReqUnlock(req);
+
+            if (!pc->handle)
+                return -1;
         }
-        tmp = virNetDevGetIndex(req->ifname, &ifindex);
-        ignore_value(VIR_STRDUP(threadkey, req->threadkey));
-        worker = virThreadPoolNew(1, 1, 0,
-                                  virNWFilterDHCPDecodeWorker,
-                                  req);
+        return 0;
     }
 
-    /* let creator know how well we initialized */
-    if (error || !threadkey || tmp < 0 || !worker ||
-        ifindex != req->ifindex)
-        req->threadStatus = THREAD_STATUS_FAIL;
-    else
-        req->threadStatus = THREAD_STATUS_OK;
+    conf->errcount = 0;
 
-    virCondSignal(&req->threadStatusCond);
+    if (rv) {
+        unsigned int diff;
 
-    virNWFilterSnoopReqUnlock(req);
+        /* submit packet to worker thread */
+        if (virAtomicIntGet(&pc->qCtr) > pc->maxQSize) {
+            if (conf->lastQueueReport - time(0) > 10) {
+                conf->lastQueueReport = time(0);
+                VIR_WARN("Worker thread for interface '%s' has a "
+                         "job queue that is too long",
+                         req->ifname);
+            }
+            return 0;
+        }
 
-    if (req->threadStatus != THREAD_STATUS_OK)
-        goto exit;
+        diff = virNWFilterSnoopRateLimit(&pc->rateLimit);
+        if (diff > 0) {
+            virNWFilterSnoopRatePenalty(pc, diff, DHCP_PKT_RATE);
+            /* rate-limited warnings */
+            if (time(0) - conf->lastRateReport > 10) {
+                 conf->lastRateReport = time(0);
+                 VIR_WARN("Too many DHCP packets on interface '%s'",
+                          req->ifname);
+            }
+            return 0;
+        }
 
-    while (!error) {
-        if (virNWFilterSnoopAdjustPoll(pcapConf,
-                                       ARRAY_CARDINALITY(pcapConf),
-                                       fds, &pollTo) < 0) {
-            break;
+        if (virNWFilterSnoopDHCPDecodeJobSubmit(virNWFilterSnoopState.pollWorker,
+                                                req, packet,
+                                                hdr->caplen, pc->dir,
+                                                &pc->qCtr) < 0) {
+            virReportError(VIR_ERR_INTERNAL_ERROR,
+                           _("Job submission failed on "
+                             "interface '%s'"), req->ifname);
+            return -1;
         }
+    }
 
-        /* cap pollTo so we don't hold up the join for too long */
-        if (pollTo < 0 || pollTo > SNOOP_POLL_MAX_TIMEOUT_MS)
-            pollTo = SNOOP_POLL_MAX_TIMEOUT_MS;
+    return 0;
+}
 
-        n = poll(fds, ARRAY_CARDINALITY(fds), pollTo);
+/*
+ * The DHCP snooping poll thread. A single instance watches the pcap
+ * sockets of all snooped interfaces and if it gets suitable packets,
+ * it submits them to the worker thread for processing. The thread
+ * terminates once the last interface is gone.
+ */
+static void
+virNWFilterDHCPSnoopPollThread(void *opaque ATTRIBUTE_UNUSED)
+{
+    virNWFilterSnoopIfConfPtr dying = NULL;
+    virNWFilterSnoopIfConfPtr *confs = NULL;
+    struct pollfd *fds = NULL;
+    size_t nconfs = 0;
+    size_t i, j;
+
+    for (;;) {
+        virNWFilterSnoopIfConfPtr conf;
+        virNWFilterSnoopIfConfPtr *prevp;
+        virThreadPoolPtr worker;
+        int pollTo, n;
+
+        /* grab the current set of watched interfaces */
+        virNWFilterSnoopPollLock();
+
+        nconfs = 0;
+        for (conf = virNWFilterSnoopState.ifConfs; conf; conf = conf->next)
+            nconfs++;
+
+        if (nconfs == 0 && !dying) {
+            /* the last interface is gone -- wind the loop down */
+            worker = virNWFilterSnoopState.pollWorker;
+            virNWFilterSnoopState.pollWorker = NULL;
+            VIR_FORCE_CLOSE(virNWFilterSnoopState.pollPipe[0]);
+            VIR_FORCE_CLOSE(virNWFilterSnoopState.pollPipe[1]);
+            virNWFilterSnoopState.pollRunning = false;
+
+            virNWFilterSnoopPollUnlock();
+
+            virThreadPoolFree(worker);
+            break;
+        }
 
-        if (n < 0) {
-            if (errno != EAGAIN && errno != EINTR)
-                error = true;
+        if (VIR_REALLOC_N(confs, nconfs ? nconfs : 1) < 0 ||
+            VIR_REALLOC_N(fds, 2 * nconfs + 1) < 0) {
+            virNWFilterSnoopPollUnlock();
+            usleep(1000 * 1000);
+            continue;
         }
 
-        virNWFilterSnoopReqLeaseTimerRun(req);
+        i = 0;
+        for (conf = virNWFilterSnoopState.ifConfs; conf; conf = conf->next)
+            confs[i++] = conf;
 
-        /*
-         * Check whether we were cancelled or whether
-         * a previously submitted job failed.
-         */
-        if (!virNWFilterSnoopIsActive(threadkey) ||
-            req->jobCompletionStatus != 0)
-            goto exit;
+        /* only this thread removes entries, so they stay valid */
+        virNWFilterSnoopPollUnlock();
+
+        fds[0].fd = virNWFilterSnoopState.pollPipe[0];
+        fds[0].events = POLLIN;
+        fds[0].revents = 0;
+
+        pollTo = -1;
+        for (i = 0; i < nconfs; i++) {
+            int confTo;
 
-        for (i = 0; n > 0 && i < ARRAY_CARDINALITY(fds); i++) {
-            if (!fds[i].revents)
+            for (j = 0; j < ARRAY_CARDINALITY(confs[i]->pcapConf); j++) {
+                /* get a POLLERR if interface goes down or disappears */
+                fds[1 + 2 * i + j].fd =
+                    pcap_fileno(confs[i]->pcapConf[j].handle);
+                fds[1 + 2 * i + j].events = POLLIN | POLLERR;
+                fds[1 + 2 * i + j].revents = 0;
+            }
+
+            if (virNWFilterSnoopAdjustPoll(confs[i]->pcapConf,
+                                           ARRAY_CARDINALITY(confs[i]->pcapConf),
+                                           &fds[1 + 2 * i], &confTo) < 0) {
+                confs[i]->error = true;
                 continue;
+            }
+            if (confTo >= 0 && (pollTo < 0 || confTo < pollTo))
+                pollTo = confTo;
+        }
 
-            fds[i].revents = 0;
-            n--;
+        /* cap pollTo so we don't hold up the join for too long */
+        if (pollTo < 0 || pollTo > SNOOP_POLL_MAX_TIMEOUT_MS)
+            pollTo = SNOOP_POLL_MAX_TIMEOUT_MS;
 
-            rv = pcap_next_ex(pcapConf[i].handle, &hdr,
-                              (const u_char **)&packet);
+        n = poll(fds, 2 * nconfs + 1, pollTo);
 
-            if (rv < 0) {
-                /* error reading from socket */
-                tmp = -1;
+        if (n < 0 && errno != EAGAIN && errno != EINTR) {
+            for (i = 0; i < nconfs; i++)
+                confs[i]->error = true;
+        }
 
-                /* protect req->ifname */
-                virNWFilterSnoopReqLock(req);
+        if (n > 0 && fds[0].revents) {
+            char buf[32];
 
-                if (req->ifname)
-                    tmp = virNetDevValidateConfig(req->ifname, NULL, ifindex);
+            while (read(fds[0].fd, buf, sizeof(buf)) > 0)
+                ; /* empty */
+        }
 
-                virNWFilterSnoopReqUnlock(req);
+        for (i = 0; i < nconfs; i++) {
+            conf = confs[i];
 
-                if (tmp <= 0) {
-                    error = true;
-                    break;
-                }
+            virNWFilterSnoopReqLeaseTimerRun(conf->req);
 
-                if (++errcount > PCAP_READ_MAXERRS) {
-                    pcap_close(pcapConf[i].handle);
-                    pcapConf[i].handle = NULL;
-
-                    /* protect req->ifname */
-                    virNWFilterSnoopReqLock(req);
-
-                    virReportError(VIR_ERR_INTERNAL_ERROR,
-                                   _("interface '%s' failing; "
-                                     "reopening"),
-                                   req->ifname);
-                    if (req->ifname)
-                        pcapConf[i].handle =
-                            virNWFilterSnoopDHCPOpen(req->ifname, &req->macaddr,
-                                                     pcapConf[i].filter,
-                                                     pcapConf[i].dir);
-
-                    virNWFilterSnoopReqUnlock(req);
-
-                    if (!pcapConf[i].handle) {
-                        error = true;
-                        break;
-                    }
-                }
+            /*
+             * Check whether the interface was cancelled or whether
+             * a previously submitted job failed.
+             */
+            if (!virNWFilterSnoopIsActive(conf->threadkey) ||
+                conf->req->jobCompletionStatus != 0) {
+                virNWFilterSnoopIfConfDetach(conf, false);
+                conf->next = dying;
+                dying = conf;
                 continue;
             }
 
-            errcount = 0;
+            for (j = 0; !conf->error &&
+                        j < ARRAY_CARDINALITY(conf->pcapConf); j++) {
+                if (!fds[1 + 2 * i + j].revents)
+                    continue;
 
-            if (rv) {
-                unsigned int diff;
+                if (virNWFilterSnoopIfConfRecv(conf, j) < 0)
+                    conf->error = true;
+            }
 
-                /* submit packet to worker thread */
-                if (virAtomicIntGet(&pcapConf[i].qCtr) >
-                    pcapConf[i].maxQSize) {
-                    if (last_displayed_queue - time(0) > 10) {
-                        last_displayed_queue = time(0);
-                        VIR_WARN("Worker thread for interface '%s' has a "
-                                 "job queue that is too long",
-                                 req->ifname);
-                    }
-                    continue;
-                }
+            if (conf->error) {
+                virNWFilterSnoopIfConfDetach(conf, true);
+                conf->next = dying;
+                dying = conf;
+            }
+        }
 
-                diff = virNWFilterSnoopRateLimit(&pcapConf[i].rateLimit);
-                if (diff > 0) {
-                    virNWFilterSnoopRatePenalty(&pcapConf[i], diff,
-                                                DHCP_PKT_RATE);
-                    /* rate-limited warnings */
-                    if (time(0) - last_displayed > 10) {
-                         last_displayed = time(0);
-                         VIR_WARN("Too many DHCP packets on interface '%s'",
-                                  req->ifname);
-                    }
-                    continue;
-                }
+        /* free interfaces whose decoder jobs have all drained */
+        prevp = &dying;
+        while (*prevp) {
+            conf = *prevp;
 
-                if (virNWFilterSnoopDHCPDecodeJobSubmit(worker, packet,
-                                                      hdr->caplen,
-                                                      pcapConf[i].dir,
-                                                      &pcapConf[i].qCtr) < 0) {
-                    virReportError(VIR_ERR_INTERNAL_ERROR,
-                                   _("Job submission failed on "
-                                     "interface '%s'"), req->ifname);
-                    error = true;
-                    break;
-                }
+            if (virAtomicIntGet(&conf->pcapConf[0].qCtr) == 0 &&
+                virAtomicIntGet(&conf->pcapConf[1].qCtr) == 0) {
+                *prevp = conf->next;
+                virNWFilterSnoopIfConfFree(conf);
+                virAtomicIntDecAndTest(&virNWFilterSnoopState.nThreads);
+            } else {
+                prevp = &conf->next;
             }
-        } /* for all fds */
-    } /* while (!error) */
+        }
+    }
 
-    /* protect IfNameToKey */
-    virNWFilterSnoopLock();
+    VIR_FREE(confs);
+    VIR_FREE(fds);
+}
 
-    /* protect req->ifname & req->threadkey */
-    virNWFilterSnoopReqLock(req);
+/*
+ * virNWFilterSnoopIfConfRegister - start snooping on an interface
+ *
+ * Opens the pcap sockets for the interface described by @req and
+ * hands them to the poll thread; the poll thread and the decoder
+ * worker are started if they are not running yet.
+ *
+ * Call this function with the SnoopLock and the req lock held. On
+ * success the registration owns the caller's reference to @req.
+ *
+ * Returns 0 on success, -1 on failure with an error reported.
+ */
+static int
+virNWFilterSnoopIfConfRegister(virNWFilterSnoopReqPtr req)
+{
+    virNWFilterSnoopIfConfPtr conf;
+    virThread thread;
+    char c = 0;
+    size_t i;
 
-    virNWFilterSnoopCancel(&req->threadkey);
+    if (VIR_ALLOC(conf) < 0)
+        return -1;
 
-    ignore_value(virHashRemoveEntry(virNWFilterSnoopState.ifnameToKey,
-                                    req->ifname));
+    conf->pcapConf[0].dir = PCAP_D_IN; /* from VM */
+    conf->pcapConf[0].filter = "dst port 67 and src port 68";
+    conf->pcapConf[1].dir = PCAP_D_OUT; /* to VM */
+    conf->pcapConf[1].filter = "src port 67 and dst port 68";
 
-    VIR_FREE(req->ifname);
+    for (i = 0; i < ARRAY_CARDINALITY(conf->pcapConf); i++) {
+        virNWFilterSnoopPcapConfPtr pc = &conf->pcapConf[i];
 
-    virNWFilterSnoopReqUnlock(req);
-    virNWFilterSnoopUnlock();
+        pc->rateLimit.prev = time(0);
+        pc->rateLimit.rate = DHCP_PKT_RATE;
+        pc->rateLimit.burstRate = DHCP_PKT_BURST;
+        pc->rateLimit.burstInterval = DHCP_BURST_INTERVAL_S;
+        pc->maxQSize = MAX_QUEUED_JOBS;
 
- exit:
-    virThreadPoolFree(worker);
+        pc->handle = virNWFilterSnoopDHCPOpen(req->ifname, &req->macaddr,
+                                              pc->filter, pc->dir);
+        if (!pc->handle)
+            goto error;
+    }
 
-    virNWFilterSnoopReqPut(req);
+    conf->ifindex = req->ifindex;
+
+    if (VIR_STRDUP(conf->threadkey, req->threadkey) < 0)
+        goto error;
+
+    virNWFilterSnoopPollLock();
+
+    if (!virNWFilterSnoopState.pollRunning) {
+        if (pipe2(virNWFilterSnoopState.pollPipe,
+                  O_CLOEXEC | O_NONBLOCK) < 0) {
+            virReportSystemError(errno, "%s",
+                                 _("unable to create poll pipe"));
+            goto error_unlock;
+        }
+
+        if (!(virNWFilterSnoopState.pollWorker =
+              virThreadPoolNew(1, 1, 0,
+                               virNWFilterDHCPDecodeWorker, NULL)))
+            goto error_closepipe;
 
-    VIR_FREE(threadkey);
+        if (virThreadCreate(&thread, false,
+                            virNWFilterDHCPSnoopPollThread, NULL) < 0) {
+            virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                           _("unable to create DHCP snoop poll thread"));
+            virThreadPoolFree(virNWFilterSnoopState.pollWorker);
+            virNWFilterSnoopState.pollWorker = NULL;
+            goto error_closepipe;
+        }
 
-    for (i = 0; i < ARRAY_CARDINALITY(pcapConf); i++) {
-        if (pcapConf[i].handle)
-            pcap_close(pcapConf[i].handle);
+        virNWFilterSnoopState.pollRunning = true;
     }
 
-    virAtomicIntDecAndTest(&virNWFilterSnoopState.nThreads);
+    /* the registration takes over the caller's reference */
+    conf->req = req;
+    conf->next = virNWFilterSnoopState.ifConfs;
+    virNWFilterSnoopState.ifConfs = conf;
 
-    return;
+    virAtomicIntInc(&virNWFilterSnoopState.nThreads);
+
+    ignore_value(safewrite(virNWFilterSnoopState.pollPipe[1], &c, 1));
+
+    virNWFilterSnoopPollUnlock();
+
+    return 0;
+
+ error_closepipe:
+    VIR_FORCE_CLOSE(virNWFilterSnoopState.pollPipe[0]);
+    VIR_FORCE_CLOSE(virNWFilterSnoopState.pollPipe[1]);
+ error_unlock:
+    virNWFilterSnoopPollUnlock();
+ error:
+    virNWFilterSnoopIfConfFree(conf);
+
+    return -1;
 }
 
 static void
@@ -1598,7 +1826,6 @@ virNWFilterDHCPSnoopReq(virNWFilterTechDriverPtr techdriver,
     bool isnewreq;
     char ifkey[VIR_IFKEY_LEN];
     int tmp;
-    virThread thread;
     virNWFilterVarValuePtr dhcpsrvrs;
     bool threadPuts = false;
 
@@ -1682,21 +1909,9 @@ virNWFilterDHCPSnoopReq(virNWFilterTechDriverPtr techdriver,
         goto exit_rem_ifnametokey;
     }
 
-    /* prevent thread from holding req */
+    /* prevent the poll thread from dropping the req behind our back */
     virNWFilterSnoopReqLock(req);
 
-    if (virThreadCreate(&thread, false, virNWFilterDHCPSnoopThread,
-                        req) != 0) {
-        virReportError(VIR_ERR_INTERNAL_ERROR,
-                       _("virNWFilterDHCPSnoopReq virThreadCreate "
-                         "failed on interface '%s'"), ifname);
-        goto exit_snoopreq_unlock;
-    }
-
-    threadPuts = true;
-
-    virAtomicIntInc(&virNWFilterSnoopState.nThreads);
-
     req->threadkey = virNWFilterSnoopActivate(req);
     if (!req->threadkey) {
         virReportError(VIR_ERR_INTERNAL_ERROR,
@@ -1712,16 +1927,16 @@ virNWFilterDHCPSnoopReq(virNWFilterTechDriverPtr techdriver,
         goto exit_snoop_cancel;
     }
 
-    /* sync with thread */
-    if (virCondWait(&req->threadStatusCond, &req->lock) < 0 ||
-        req->threadStatus != THREAD_STATUS_OK)
+    if (virNWFilterSnoopIfConfRegister(req) < 0)
         goto exit_snoop_cancel;
 
+    threadPuts = true;
+
     virNWFilterSnoopReqUnlock(req);
 
     virNWFilterSnoopUnlock();
 
-    /* do not 'put' the req -- the thread will do this */
+    /* do not 'put' the req -- the poll thread will do this */
 
     return 0;
 
@@ -2012,13 +2227,13 @@ virNWFilterSnoopLeaseFileLoad(void)
 }
 
 /*
- * Wait until all threads have ended.
+ * Wait until the poll thread has dropped all interfaces.
  */
 static void
 virNWFilterSnoopJoinThreads(void)
 {
     while (virAtomicIntGet(&virNWFilterSnoopState.nThreads) != 0) {
-        VIR_WARN("Waiting for snooping threads to terminate: %u",
+        VIR_WARN("Waiting for snooping to end on %u interfaces",
                  virAtomicIntGet(&virNWFilterSnoopState.nThreads));
         usleep(1000 * 1000);
     }
@@ -2084,7 +2299,8 @@ virNWFilterDHCPSnoopInit(void)
     VIR_DEBUG("Initializing DHCP snooping");
 
     if (virMutexInitRecursive(&virNWFilterSnoopState.snoopLock) < 0 ||
-        virMutexInit(&virNWFilterSnoopState.activeLock) < 0)
+        virMutexInit(&virNWFilterSnoopState.activeLock) < 0 ||
+        virMutexInit(&virNWFilterSnoopState.pollLock) < 0)
         return -1;
 
     virNWFilterSnoopState.ifnameToKey = virHashCreate(0, NULL);
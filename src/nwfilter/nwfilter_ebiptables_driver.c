@@ -38,6 +38,7 @@
 #include "domain_conf.h"
 #include "nwfilter_conf.h"
 #include "nwfilter_driver.h"
+#include "nwfilter_ipaddrmap.h"
 #include "nwfilter_gentech_driver.h"
 #include "nwfilter_ebiptables_driver.h"
 #include "virfile.h"
@@ -45,6 +46,7 @@
 #include "configmake.h"
 #include "intprops.h"
 #include "virstring.h"
+#include "virthread.h"
 #include "virfirewall.h"
 
 #define VIR_FROM_THIS VIR_FROM_NWFILTER
@@ -93,6 +95,20 @@ static enum ctdirStatus iptables_ctdir_corrected;
 
 static bool newMatchState;
 
+/* The serialized form of the ruleset most recently applied to each
+ * interface. A filter update that regenerates the identical ruleset
+ * can then leave the live chains untouched instead of rebuilding and
+ * replacing them. */
+struct ebiptablesAppliedRules {
+    char *fwStr;   /* canonical string of the applied ruleset */
+    bool skipOld;  /* applyNewRules skipped programming the unchanged
+                      ruleset, so the following tearOldRules call must
+                      not touch the live chains */
+};
+
+static virMutex appliedRulesLock = VIR_MUTEX_INITIALIZER;
+static virHashTablePtr appliedRules;
+
 #define MATCH_PHYSDEV_IN_FW   "-m", "physdev", "--physdev-in"
 #define MATCH_PHYSDEV_OUT_FW  "-m", "physdev", "--physdev-is-bridged", "--physdev-out"
 #define MATCH_PHYSDEV_OUT_OLD_FW  "-m", "physdev", "--physdev-out"
@@ -3389,6 +3405,160 @@ ebtablesGetSubChainInsts(virHashTablePtr chains,
 
 }
 
+static void
+ebiptablesAppliedRulesFree(void *payload,
+                           const void *name ATTRIBUTE_UNUSED)
+{
+    struct ebiptablesAppliedRules *entry = payload;
+
+    VIR_FREE(entry->fwStr);
+    VIR_FREE(entry);
+}
+
+
+/**
+ * ebiptablesCheckUnchangedRules:
+ * @ifname : the name of the interface to which the rules apply
+ * @fwStr : canonical string of the ruleset about to be applied
+ *
+ * Check whether @fwStr is identical to the ruleset recorded as
+ * currently applied to @ifname. If so, mark the interface so that the
+ * following tearOldRules call becomes a no-op as well.
+ *
+ * Returns true if the ruleset is unchanged, false otherwise
+ */
+static bool
+ebiptablesCheckUnchangedRules(const char *ifname,
+                              const char *fwStr)
+{
+    struct ebiptablesAppliedRules *entry;
+    bool unchanged = false;
+
+    virMutexLock(&appliedRulesLock);
+    if (appliedRules &&
+        (entry = virHashLookup(appliedRules, ifname)) &&
+        STREQ_NULLABLE(entry->fwStr, fwStr)) {
+        entry->skipOld = true;
+        unchanged = true;
+    }
+    virMutexUnlock(&appliedRulesLock);
+
+    return unchanged;
+}
+
+
+/*
+ * Record @fwStr as the ruleset now applied to @ifname; @fwStr is
+ * consumed
+ */
+static void
+ebiptablesRememberRules(const char *ifname,
+                        char *fwStr)
+{
+    struct ebiptablesAppliedRules *entry;
+
+    virMutexLock(&appliedRulesLock);
+    if (!appliedRules)
+        goto cleanup;
+
+    if ((entry = virHashLookup(appliedRules, ifname))) {
+        VIR_FREE(entry->fwStr);
+        entry->fwStr = fwStr;
+        entry->skipOld = false;
+        fwStr = NULL;
+        goto cleanup;
+    }
+
+    if (VIR_ALLOC(entry) < 0)
+        goto cleanup;
+
+    entry->fwStr = fwStr;
+    fwStr = NULL;
+
+    if (virHashAddEntry(appliedRules, ifname, entry) < 0) {
+        VIR_FREE(entry->fwStr);
+        VIR_FREE(entry);
+    }
+
+ cleanup:
+    /* losing the entry merely costs a future rebuild */
+    virMutexUnlock(&appliedRulesLock);
+    VIR_FREE(fwStr);
+}
+
+
+static void
+ebiptablesForgetRules(const char *ifname)
+{
+    virMutexLock(&appliedRulesLock);
+    if (appliedRules)
+        virHashRemoveEntry(appliedRules, ifname);
+    virMutexUnlock(&appliedRulesLock);
+}
+
+
+/*
+ * Returns true if the preceding applyNewRules call left the unchanged
+ * ruleset in place; no tmp chains exist in that case. The mark is
+ * cleared.
+ */
+static bool
+ebiptablesConsumeSkipOld(const char *ifname)
+{
+    struct ebiptablesAppliedRules *entry;
+    bool skip = false;
+
+    virMutexLock(&appliedRulesLock);
+    if (appliedRules &&
+        (entry = virHashLookup(appliedRules, ifname))) {
+        skip = entry->skipOld;
+        entry->skipOld = false;
+    }
+    virMutexUnlock(&appliedRulesLock);
+
+    return skip;
+}
+
+
+/*
+ * Drop the conntrack state belonging to the addresses bound to
+ * @ifname so that flows established under the previous ruleset are
+ * re-evaluated by the new one right away; without this, stateful
+ * rules keep honouring decisions the old ruleset made. Only entries
+ * involving the interface's own addresses are deleted, never the
+ * whole table.
+ */
+static void
+ebiptablesInvalidateConntrack(const char *ifname)
+{
+    virNWFilterVarValuePtr ipvar = virNWFilterIPAddrMapGetIPAddr(ifname);
+    unsigned int card;
+    size_t i;
+
+    if (!ipvar)
+        return;
+
+    card = virNWFilterVarValueGetCardinality(ipvar);
+    for (i = 0; i < card; i++) {
+        const char *ip = virNWFilterVarValueGetNthValue(ipvar, i);
+        virCommandPtr cmd;
+        int status;
+
+        if (!ip)
+            continue;
+
+        /* a non-zero exit merely means there were no entries */
+        cmd = virCommandNewArgList(CONNTRACK_PATH, "-D", "-s", ip, NULL);
+        ignore_value(virCommandRun(cmd, &status));
+        virCommandFree(cmd);
+
+        cmd = virCommandNewArgList(CONNTRACK_PATH, "-D", "-d", ip, NULL);
+        ignore_value(virCommandRun(cmd, &status));
+        virCommandFree(cmd);
+    }
+}
+
+
 static int
 ebiptablesApplyNewRules(const char *ifname,
                         virNWFilterRuleInstPtr *rules,
@@ -3402,6 +3572,7 @@ ebiptablesApplyNewRules(const char *ifname,
     bool haveIptables = false;
     bool haveIp6tables = false;
     char *errmsg = NULL;
+    char *fwStr = NULL;
     struct ebtablesSubChainInst **subchains = NULL;
     size_t nsubchains = 0;
     int ret = -1;
@@ -3588,9 +3759,29 @@ ebiptablesApplyNewRules(const char *ifname,
     ebtablesRemoveTmpRootChainFW(fw, true, ifname);
     ebtablesRemoveTmpRootChainFW(fw, false, ifname);
 
+    if (!(fwStr = virFirewallToString(fw)))
+        goto cleanup;
+
+    /* updates of a filter often regenerate the very same ruleset;
+     * don't replace the live chains in that case */
+    if (ebiptablesCheckUnchangedRules(ifname, fwStr)) {
+        VIR_DEBUG("Ruleset for '%s' is unchanged, skipping reload",
+                  ifname);
+        ret = 0;
+        goto cleanup;
+    }
+
     if (virFirewallApply(fw) < 0)
         goto cleanup;
 
+    ebiptablesRememberRules(ifname, fwStr);
+    fwStr = NULL;
+
+    /* the ruleset really changed; invalidate conntrack state once
+     * for the whole batch, but only if there are stateful layers */
+    if (haveIptables || haveIp6tables)
+        ebiptablesInvalidateConntrack(ifname);
+
     ret = 0;
 
  cleanup:
@@ -3601,6 +3792,7 @@ ebiptablesApplyNewRules(const char *ifname,
     virHashFree(chains_in_set);
     virHashFree(chains_out_set);
 
+    VIR_FREE(fwStr);
     VIR_FREE(errmsg);
     return ret;
 }
@@ -3641,9 +3833,16 @@ ebiptablesTearNewRules(const char *ifname)
 static int
 ebiptablesTearOldRules(const char *ifname)
 {
-    virFirewallPtr fw = virFirewallNew();
+    virFirewallPtr fw;
     int ret = -1;
 
+    /* nothing was replaced if applyNewRules left the unchanged
+     * ruleset in place */
+    if (ebiptablesConsumeSkipOld(ifname))
+        return 0;
+
+    fw = virFirewallNew();
+
     virFirewallStartTransaction(fw, VIR_FIREWALL_TRANSACTION_IGNORE_ERRORS);
 
     iptablesUnlinkRootChainsFW(fw, VIR_FIREWALL_LAYER_IPV4, ifname);
@@ -3682,6 +3881,8 @@ ebiptablesAllTeardown(const char *ifname)
     virFirewallPtr fw = virFirewallNew();
     int ret = -1;
 
+    ebiptablesForgetRules(ifname);
+
     virFirewallStartTransaction(fw, VIR_FIREWALL_TRANSACTION_IGNORE_ERRORS);
 
     ebiptablesTearNewRulesFW(fw, ifname);
@@ -3822,6 +4023,13 @@ ebiptablesDriverInit(bool privileged)
     if (ebiptablesDriverProbeStateMatch() < 0)
         return -1;
 
+    virMutexLock(&appliedRulesLock);
+    if (!appliedRules)
+        appliedRules = virHashCreate(10, ebiptablesAppliedRulesFree);
+    virMutexUnlock(&appliedRulesLock);
+    if (!appliedRules)
+        return -1;
+
     ebiptables_driver.flags = TECHDRV_FLAG_INITIALIZED;
 
     return 0;
@@ -3831,5 +4039,10 @@ ebiptablesDriverInit(bool privileged)
 static void
 ebiptablesDriverShutdown(void)
 {
+    virMutexLock(&appliedRulesLock);
+    virHashFree(appliedRules);
+    appliedRules = NULL;
+    virMutexUnlock(&appliedRulesLock);
+
     ebiptables_driver.flags = 0;
 }
@@ -56,28 +56,23 @@ static virNWFilterTechDriverPtr filter_tech_drivers[] = {
     NULL
 };
 
-/* Serializes instantiation of filters. This is necessary
- * to avoid lock ordering deadlocks. eg __virNWFilterInstantiateFilter
- * will hold a lock on a virNWFilterObjPtr. This in turn invokes
- * virNWFilterInstantiate which invokes virNWFilterDetermineMissingVarsRec
- * which invokes virNWFilterObjFindByName. This iterates over every single
- * virNWFilterObjPtr in the list. So if 2 threads try to instantiate a
- * filter in parallel, they'll both hold 1 lock at the top level in
- * __virNWFilterInstantiateFilter which will cause the other thread
- * to deadlock in virNWFilterObjFindByName.
- *
- * XXX better long term solution is to make virNWFilterObjList use a
- * hash table as is done for virDomainObjList. You can then get
- * lockless lookup of objects by name.
+/* Instantiation locking scheme: every caller holds the filter
+ * updates lock (for reading in the instantiation paths, for writing
+ * in the define/undefine paths), which keeps the filter list and all
+ * definitions immutable. Lookups during instantiation therefore use
+ * virNWFilterObjLookupByName and take no object locks; only the
+ * top level filter object is locked, serializing concurrent
+ * instantiations of the same filter while filters on independent
+ * interfaces are applied in parallel. Since at most one object lock
+ * is held per thread there is no lock ordering to go wrong.
+ * Concurrent operations on the same interface are serialized by
+ * virNWFilterLockIface.
  */
-static virMutex updateMutex;
 
 int virNWFilterTechDriversInit(bool privileged)
 {
     size_t i = 0;
     VIR_DEBUG("Initializing NWFilter technology drivers");
-    if (virMutexInitRecursive(&updateMutex) < 0)
-        return -1;
 
     while (filter_tech_drivers[i]) {
         if (!(filter_tech_drivers[i]->flags & TECHDRV_FLAG_INITIALIZED))
@@ -96,7 +91,6 @@ void virNWFilterTechDriversShutdown(void)
             filter_tech_drivers[i]->shutdown();
         i++;
     }
-    virMutexDestroy(&updateMutex);
 }
 
 
@@ -302,8 +296,6 @@ virNWFilterCreateVarsFrom(virNWFilterHashTablePtr vars1,
 typedef struct _virNWFilterInst virNWFilterInst;
 typedef virNWFilterInst *virNWFilterInstPtr;
 struct _virNWFilterInst {
-    virNWFilterObjPtr *filters;
-    size_t nfilters;
     virNWFilterRuleInstPtr *rules;
     size_t nrules;
 };
@@ -314,11 +306,6 @@ virNWFilterInstReset(virNWFilterInstPtr inst)
 {
     size_t i;
 
-    for (i = 0; i < inst->nfilters; i++)
-        virNWFilterObjUnlock(inst->filters[i]);
-    VIR_FREE(inst->filters);
-    inst->nfilters = 0;
-
     for (i = 0; i < inst->nrules; i++)
         virNWFilterRuleInstFree(inst->rules[i]);
     VIR_FREE(inst->rules);
@@ -382,8 +369,10 @@ virNWFilterIncludeDefToRuleInst(virNWFilterDriverStatePtr driver,
     int ret = -1;
 
     VIR_DEBUG("Instantiating filter %s", inc->filterref);
-    obj = virNWFilterObjFindByName(&driver->nwfilters,
-                                   inc->filterref);
+    /* The filter updates lock each caller holds keeps the referenced
+     * filter alive and its definition stable without an object lock */
+    obj = virNWFilterObjLookupByName(&driver->nwfilters,
+                                     inc->filterref);
     if (!obj) {
         virReportError(VIR_ERR_INTERNAL_ERROR,
                        _("referenced filter '%s' is missing"),
@@ -415,12 +404,6 @@ virNWFilterIncludeDefToRuleInst(virNWFilterDriverStatePtr driver,
         break;
     }
 
-    if (VIR_APPEND_ELEMENT(inst->filters,
-                           inst->nfilters,
-                           obj) < 0)
-        goto cleanup;
-    obj = NULL;
-
     if (virNWFilterDefToInst(driver,
                              childdef,
                              tmpvars,
@@ -434,8 +417,6 @@ virNWFilterIncludeDefToRuleInst(virNWFilterDriverStatePtr driver,
     if (ret < 0)
         virNWFilterInstReset(inst);
     virNWFilterHashTableFree(tmpvars);
-    if (obj)
-        virNWFilterObjUnlock(obj);
     return ret;
 }
 
@@ -542,7 +523,8 @@ virNWFilterDetermineMissingVarsRec(virNWFilterDefPtr filter,
                 break;
         } else if (inc) {
             VIR_DEBUG("Following filter %s", inc->filterref);
-            obj = virNWFilterObjFindByName(&driver->nwfilters, inc->filterref);
+            obj = virNWFilterObjLookupByName(&driver->nwfilters,
+                                             inc->filterref);
             if (obj) {
 
                 if (obj->wantRemoved) {
@@ -550,7 +532,6 @@ virNWFilterDetermineMissingVarsRec(virNWFilterDefPtr filter,
                                    _("Filter '%s' is in use."),
                                    inc->filterref);
                     rc = -1;
-                    virNWFilterObjUnlock(obj);
                     break;
                 }
 
@@ -560,7 +541,6 @@ virNWFilterDetermineMissingVarsRec(virNWFilterDefPtr filter,
                                                                 vars);
                 if (!tmpvars) {
                     rc = -1;
-                    virNWFilterObjUnlock(obj);
                     break;
                 }
 
@@ -583,7 +563,6 @@ virNWFilterDetermineMissingVarsRec(virNWFilterDefPtr filter,
 
                 virNWFilterHashTableFree(tmpvars);
 
-                virNWFilterObjUnlock(obj);
                 if (rc < 0)
                     break;
             } else {
@@ -807,7 +786,7 @@ __virNWFilterInstantiateFilter(virNWFilterDriverStatePtr driver,
 
     VIR_DEBUG("filter name: %s", filtername);
 
-    obj = virNWFilterObjFindByName(&driver->nwfilters, filtername);
+    obj = virNWFilterObjLookupByName(&driver->nwfilters, filtername);
     if (!obj) {
         virReportError(VIR_ERR_NO_NWFILTER,
                        _("Could not find filter '%s'"),
@@ -815,6 +794,11 @@ __virNWFilterInstantiateFilter(virNWFilterDriverStatePtr driver,
         return -1;
     }
 
+    /* Serialize concurrent instantiations of the same filter; the
+     * lock is recursive so the define path may re-enter here while
+     * rebuilding the filters of running VMs */
+    virNWFilterObjLock(obj);
+
     if (obj->wantRemoved) {
         virReportError(VIR_ERR_NO_NWFILTER,
                        _("Filter '%s' is in use."),
@@ -903,11 +887,11 @@ _virNWFilterInstantiateFilter(virNWFilterDriverStatePtr driver,
     int ifindex;
     int rc;
 
-    virMutexLock(&updateMutex);
-
-    /* after grabbing the filter update lock check for the interface; if
-       it's not there anymore its filters will be or are being removed
-       (while holding the lock) and we don't want to build new ones */
+    /* check for the interface before building anything; if it's not
+       there anymore its filters will be or are being removed and we
+       don't want to build new ones. A disappearance after this check
+       is caught by the interface validation done under the interface
+       lock once the rules have been applied */
     if (virNetDevExists(net->ifname) != 1 ||
         virNetDevGetIndex(net->ifname, &ifindex) < 0) {
         /* interfaces / VMs can disappear during filter instantiation;
@@ -931,8 +915,6 @@ _virNWFilterInstantiateFilter(virNWFilterDriverStatePtr driver,
                                         foundNewFilter);
 
  cleanup:
-    virMutexUnlock(&updateMutex);
-
     return rc;
 }
 
@@ -951,7 +933,6 @@ virNWFilterInstantiateFilterLate(virNWFilterDriverStatePtr driver,
     bool foundNewFilter = false;
 
     virNWFilterReadLockFilterUpdates();
-    virMutexLock(&updateMutex);
 
     rc = __virNWFilterInstantiateFilter(driver,
                                         vmuuid,
@@ -976,7 +957,6 @@ virNWFilterInstantiateFilterLate(virNWFilterDriverStatePtr driver,
     }
 
     virNWFilterUnlockFilterUpdates();
-    virMutexUnlock(&updateMutex);
 
     return rc;
 }
@@ -1100,11 +1080,8 @@ _virNWFilterTeardownFilter(const char *ifname)
 int
 virNWFilterTeardownFilter(const virDomainNetDef *net)
 {
-    int ret;
-    virMutexLock(&updateMutex);
-    ret = _virNWFilterTeardownFilter(net->ifname);
-    virMutexUnlock(&updateMutex);
-    return ret;
+    /* mutual exclusion with instantiation is via the interface lock */
+    return _virNWFilterTeardownFilter(net->ifname);
 }
 
 
@@ -611,12 +611,10 @@ learnIPAddressThread(void *arg)
         sa.data.inet4.sin_addr.s_addr = vmaddr;
         char *inetaddr;
 
-        /* It is necessary to unlock interface here to avoid updateMutex and
-         * interface ordering deadlocks. Otherwise we are going to
-         * instantiate the filter, which will try to lock updateMutex, and
-         * some other thread instantiating a filter in parallel is holding
-         * updateMutex and is trying to lock interface, both will deadlock.
-         * Also it is safe to unlock interface here because we stopped
+        /* It is necessary to unlock interface here because instantiating
+         * the filter will want to take the interface lock itself around
+         * applying the rules and would deadlock against us holding it.
+         * It is safe to unlock interface here because we stopped
          * capturing and applied necessary rules on the interface, while
          * instantiating a new filter doesn't require a locked interface.*/
         virNWFilterUnlockIface(req->ifname);
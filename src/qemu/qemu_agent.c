@@ -122,6 +122,11 @@ struct _qemuAgent {
      * but fire up an event on qemu monitor instead.
      * Take that as indication of successful completion */
     qemuAgentEvent await_event;
+
+    /* The stream is known to be in sync, so the guest-sync handshake
+     * before the next command can be skipped. Cleared whenever a
+     * command is abandoned or an unexpected reply shows up. */
+    bool inSync;
 };
 
 static virClassPtr qemuAgentClass;
@@ -364,6 +369,7 @@ qemuAgentIOProcessLine(qemuAgentPtr mon,
         } else {
             /* we are out of sync */
             VIR_DEBUG("Ignoring delayed reply");
+            mon->inSync = false;
         }
         ret = 0;
     } else {
@@ -933,6 +939,11 @@ static int qemuAgentSend(qemuAgentPtr mon,
     ret = 0;
 
  cleanup:
+    /* if the command is abandoned before its reply arrived, a stale
+     * reply may still show up later; force a guest-sync handshake
+     * before the next command goes out */
+    if (!mon->msg->finished)
+        mon->inSync = false;
     mon->msg = NULL;
     qemuAgentUpdateWatch(mon);
 
@@ -1139,8 +1150,14 @@ qemuAgentCommand(qemuAgentPtr mon,
         return -1;
     }
 
-    if (qemuAgentGuestSync(mon) < 0)
-        return -1;
+    /* Once the stream has proven to be in sync the handshake is pure
+     * overhead, a full round trip to the guest per command; skip it
+     * until something desynchronizes the stream again. */
+    if (!mon->inSync) {
+        if (qemuAgentGuestSync(mon) < 0)
+            return -1;
+        mon->inSync = true;
+    }
 
     memset(&msg, 0, sizeof(msg));
 
@@ -44,16 +44,23 @@ VIR_LOG_INIT("qemu.qemu_blockjob");
  * @driver: qemu driver
  * @vm: domain
  * @disk: domain disk
+ * @save: if non-NULL, set to true instead of writing the status XML
  *
  * Update disk's mirror state in response to a block job event stored in
  * blockJobStatus by qemuProcessHandleBlockJob event handler.
  *
+ * When @save is non-NULL, a required status XML update is recorded in
+ * it rather than written immediately so that callers processing events
+ * for several disks can write the XML just once via
+ * qemuBlockJobSaveStatus once all disks were dealt with.
+ *
  * Returns the block job event processed or -1 if there was no pending event.
  */
 int
 qemuBlockJobUpdate(virQEMUDriverPtr driver,
                    virDomainObjPtr vm,
-                   virDomainDiskDefPtr disk)
+                   virDomainDiskDefPtr disk,
+                   bool *save)
 {
     qemuDomainDiskPrivatePtr diskPriv = QEMU_DOMAIN_DISK_PRIVATE(disk);
     int status = diskPriv->blockJobStatus;
@@ -61,7 +68,8 @@ qemuBlockJobUpdate(virQEMUDriverPtr driver,
     if (status != -1) {
         qemuBlockJobEventProcess(driver, vm, disk,
                                  diskPriv->blockJobType,
-                                 diskPriv->blockJobStatus);
+                                 diskPriv->blockJobStatus,
+                                 save);
         diskPriv->blockJobStatus = -1;
     }
 
@@ -69,6 +77,58 @@ qemuBlockJobUpdate(virQEMUDriverPtr driver,
 }
 
 
+/**
+ * qemuBlockJobSpliceCommittedChain:
+ * @disk: domain disk
+ *
+ * Update @disk's in-memory backing chain after a completed non-active
+ * block commit by unlinking the committed sub-chain [top..above base]
+ * and reattaching base to top's parent, mirroring what qemu did on
+ * disk. This avoids reprobing every image in the chain, which is
+ * expensive on network file systems.
+ *
+ * Both ends of the splice are validated against the current chain
+ * first; if anything rebuilt the chain while the job ran the splice
+ * is refused and the caller falls back to a full re-detection.
+ *
+ * Returns true if the chain was spliced, false if the caller must
+ * reprobe the chain instead.
+ */
+static bool
+qemuBlockJobSpliceCommittedChain(virDomainDiskDefPtr disk)
+{
+    qemuDomainDiskPrivatePtr diskPriv = QEMU_DOMAIN_DISK_PRIVATE(disk);
+    virStorageSourcePtr top = diskPriv->commitTop;
+    virStorageSourcePtr base = diskPriv->commitBase;
+    virStorageSourcePtr parent;
+    virStorageSourcePtr tail;
+
+    if (!top || !base || top == disk->src)
+        return false;
+
+    parent = disk->src;
+    while (parent && parent->backingStore != top)
+        parent = parent->backingStore;
+    if (!parent)
+        return false;
+
+    tail = top;
+    while (tail->backingStore && tail->backingStore != base)
+        tail = tail->backingStore;
+    if (!tail->backingStore)
+        return false;
+
+    VIR_DEBUG("splicing committed chain for disk %s: '%s' now backed by '%s'",
+              disk->dst, NULLSTR(parent->path), NULLSTR(base->path));
+
+    tail->backingStore = NULL;
+    parent->backingStore = base;
+    virStorageSourceFree(top);
+
+    return true;
+}
+
+
 /**
  * qemuBlockJobEventProcess:
  * @driver: qemu driver
@@ -76,6 +136,7 @@ qemuBlockJobUpdate(virQEMUDriverPtr driver,
  * @disk: domain disk
  * @type: block job type
  * @status: block job status
+ * @save: if non-NULL, defer writing the status XML to the caller
  *
  * Update disk's mirror state in response to a block job event
  * from QEMU. For mirror state's that must survive libvirt
@@ -86,14 +147,15 @@ qemuBlockJobEventProcess(virQEMUDriverPtr driver,
                          virDomainObjPtr vm,
                          virDomainDiskDefPtr disk,
                          int type,
-                         int status)
+                         int status,
+                         bool *save)
 {
     virObjectEventPtr event = NULL;
     virObjectEventPtr event2 = NULL;
     const char *path;
     virQEMUDriverConfigPtr cfg = virQEMUDriverGetConfig(driver);
     virDomainDiskDefPtr persistDisk = NULL;
-    bool save = false;
+    bool needSave = false;
     qemuDomainDiskPrivatePtr diskPriv = QEMU_DOMAIN_DISK_PRIVATE(disk);
 
     VIR_DEBUG("disk=%s, mirrorState=%s, type=%d, status=%d",
@@ -152,22 +214,27 @@ qemuBlockJobEventProcess(virQEMUDriverPtr driver,
             virStorageSourceFree(disk->mirror);
         }
 
-        /* Recompute the cached backing chain to match our
-         * updates.  Better would be storing the chain ourselves
-         * rather than reprobing, but we haven't quite completed
-         * that conversion to use our XML tracking. */
         disk->mirror = NULL;
-        save = disk->mirrorState != VIR_DOMAIN_DISK_MIRROR_STATE_NONE;
+        needSave = disk->mirrorState != VIR_DOMAIN_DISK_MIRROR_STATE_NONE;
         disk->mirrorState = VIR_DOMAIN_DISK_MIRROR_STATE_NONE;
         disk->mirrorJob = VIR_DOMAIN_BLOCK_JOB_TYPE_UNKNOWN;
-        ignore_value(qemuDomainDetermineDiskChain(driver, vm, disk,
-                                                  true, true));
+        /* A completed non-active commit changed exactly one link,
+         * which we can splice in place; everything else recomputes
+         * the cached backing chain to match our updates.  Better
+         * would be storing the chain ourselves rather than
+         * reprobing, but we haven't quite completed that conversion
+         * to use our XML tracking. */
+        if (!qemuBlockJobSpliceCommittedChain(disk))
+            ignore_value(qemuDomainDetermineDiskChain(driver, vm, disk,
+                                                      true, true));
+        diskPriv->commitTop = NULL;
+        diskPriv->commitBase = NULL;
         diskPriv->blockjob = false;
         break;
 
     case VIR_DOMAIN_BLOCK_JOB_READY:
         disk->mirrorState = VIR_DOMAIN_DISK_MIRROR_STATE_READY;
-        save = true;
+        needSave = true;
         break;
 
     case VIR_DOMAIN_BLOCK_JOB_FAILED:
@@ -176,7 +243,9 @@ qemuBlockJobEventProcess(virQEMUDriverPtr driver,
         disk->mirror = NULL;
         disk->mirrorState = VIR_DOMAIN_DISK_MIRROR_STATE_NONE;
         disk->mirrorJob = VIR_DOMAIN_BLOCK_JOB_TYPE_UNKNOWN;
-        save = true;
+        needSave = true;
+        diskPriv->commitTop = NULL;
+        diskPriv->commitBase = NULL;
         diskPriv->blockjob = false;
         break;
 
@@ -184,8 +253,11 @@ qemuBlockJobEventProcess(virQEMUDriverPtr driver,
         break;
     }
 
-    if (save) {
-        if (virDomainSaveStatus(driver->xmlopt, cfg->stateDir, vm, driver->caps) < 0)
+    if (needSave) {
+        if (save)
+            *save = true;
+        else if (virDomainSaveStatus(driver->xmlopt, cfg->stateDir,
+                                     vm, driver->caps) < 0)
             VIR_WARN("Unable to save status on vm %s after block job",
                      vm->def->name);
         if (persistDisk && virDomainSaveConfig(cfg->configDir,
@@ -202,6 +274,29 @@ qemuBlockJobEventProcess(virQEMUDriverPtr driver,
 }
 
 
+/**
+ * qemuBlockJobSaveStatus:
+ * @driver: qemu driver
+ * @vm: domain
+ *
+ * Write the domain's status XML after one or more calls to
+ * qemuBlockJobUpdate deferred doing so via their @save argument.
+ */
+void
+qemuBlockJobSaveStatus(virQEMUDriverPtr driver,
+                       virDomainObjPtr vm)
+{
+    virQEMUDriverConfigPtr cfg = virQEMUDriverGetConfig(driver);
+
+    if (virDomainSaveStatus(driver->xmlopt, cfg->stateDir,
+                            vm, driver->caps) < 0)
+        VIR_WARN("Unable to save status on vm %s after block job",
+                 vm->def->name);
+
+    virObjectUnref(cfg);
+}
+
+
 /**
  * qemuBlockJobSyncBegin:
  * @disk: domain disk
@@ -231,6 +326,7 @@ qemuBlockJobSyncBegin(virDomainDiskDefPtr disk)
  * @driver: qemu driver
  * @vm: domain
  * @disk: domain disk
+ * @save: if non-NULL, defer writing the status XML to the caller
  *
  * End a synchronous block job for @disk. Any pending block job event
  * for the disk is processed.
@@ -238,9 +334,10 @@ qemuBlockJobSyncBegin(virDomainDiskDefPtr disk)
 void
 qemuBlockJobSyncEnd(virQEMUDriverPtr driver,
                     virDomainObjPtr vm,
-                    virDomainDiskDefPtr disk)
+                    virDomainDiskDefPtr disk,
+                    bool *save)
 {
     VIR_DEBUG("disk=%s", disk->dst);
-    qemuBlockJobUpdate(driver, vm, disk);
+    qemuBlockJobUpdate(driver, vm, disk, save);
     QEMU_DOMAIN_DISK_PRIVATE(disk)->blockJobSync = false;
 }
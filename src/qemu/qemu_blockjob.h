@@ -27,16 +27,21 @@
 
 int qemuBlockJobUpdate(virQEMUDriverPtr driver,
                        virDomainObjPtr vm,
-                       virDomainDiskDefPtr disk);
+                       virDomainDiskDefPtr disk,
+                       bool *save);
 void qemuBlockJobEventProcess(virQEMUDriverPtr driver,
                               virDomainObjPtr vm,
                               virDomainDiskDefPtr disk,
                               int type,
-                              int status);
+                              int status,
+                              bool *save);
+void qemuBlockJobSaveStatus(virQEMUDriverPtr driver,
+                            virDomainObjPtr vm);
 
 void qemuBlockJobSyncBegin(virDomainDiskDefPtr disk);
 void qemuBlockJobSyncEnd(virQEMUDriverPtr driver,
                          virDomainObjPtr vm,
-                         virDomainDiskDefPtr disk);
+                         virDomainDiskDefPtr disk,
+                         bool *save);
 
 #endif /* __QEMU_BLOCKJOB_H__ */
@@ -50,6 +50,7 @@
 #include <sys/stat.h>
 #include <unistd.h>
 #include <sys/wait.h>
+#include <sys/utsname.h>
 #include <stdarg.h>
 
 #define VIR_FROM_THIS VIR_FROM_QEMU
@@ -381,6 +382,7 @@ struct _virQEMUCaps {
     unsigned int version;
     unsigned int kvmVersion;
     char *package;
+    char *kernelVersion;
 
     virArch arch;
 
@@ -1094,6 +1096,10 @@ virQEMUCapsInitPages(virCapsPtr caps)
 }
 
 
+static void virQEMUCapsCacheProbeAll(virCapsPtr caps,
+                                     virQEMUCapsCachePtr cache,
+                                     virArch hostarch);
+
 virCapsPtr virQEMUCapsInit(virQEMUCapsCachePtr cache)
 {
     virCapsPtr caps;
@@ -1128,6 +1134,10 @@ virCapsPtr virQEMUCapsInit(virQEMUCapsCachePtr cache)
     virCapabilitiesAddHostMigrateTransport(caps, "tcp");
     virCapabilitiesAddHostMigrateTransport(caps, "rdma");
 
+    /* Warm up the cache for all binaries concurrently, so startup is
+     * bounded by the slowest probe rather than the sum of them all */
+    virQEMUCapsCacheProbeAll(caps, cache, hostarch);
+
     /* QEMU can support pretty much every arch that exists,
      * so just probe for them all - we gracefully fail
      * if a qemu-system-$ARCH binary can't be found
@@ -2111,6 +2121,9 @@ virQEMUCapsPtr virQEMUCapsNewCopy(virQEMUCapsPtr qemuCaps)
     if (VIR_STRDUP(ret->package, qemuCaps->package) < 0)
         goto error;
 
+    if (VIR_STRDUP(ret->kernelVersion, qemuCaps->kernelVersion) < 0)
+        goto error;
+
     ret->arch = qemuCaps->arch;
 
     if (qemuCaps->cpuDefinitions) {
@@ -2164,6 +2177,7 @@ void virQEMUCapsDispose(void *obj)
     virBitmapFree(qemuCaps->flags);
 
     VIR_FREE(qemuCaps->package);
+    VIR_FREE(qemuCaps->kernelVersion);
     VIR_FREE(qemuCaps->binary);
 
     VIR_FREE(qemuCaps->gicCapabilities);
@@ -3064,6 +3078,8 @@ virQEMUCapsLoadCache(virCapsPtr caps,
     if (virXPathULong("string(./selfvers)", ctxt, &lu) == 0)
         *selfvers = lu;
 
+    qemuCaps->kernelVersion = virXPathString("string(./kernelVersion)", ctxt);
+
     qemuCaps->usedQMP = virXPathBoolean("count(./usedQMP) > 0",
                                         ctxt) > 0;
 
@@ -3299,6 +3315,10 @@ virQEMUCapsFormatCache(virQEMUCapsPtr qemuCaps,
         virBufferAsprintf(&buf, "<package>%s</package>\n",
                           qemuCaps->package);
 
+    if (qemuCaps->kernelVersion)
+        virBufferAsprintf(&buf, "<kernelVersion>%s</kernelVersion>\n",
+                          qemuCaps->kernelVersion);
+
     virBufferAsprintf(&buf, "<arch>%s</arch>\n",
                       virArchToString(qemuCaps->arch));
 
@@ -3421,6 +3441,7 @@ virQEMUCapsReset(virQEMUCapsPtr qemuCaps)
     virBitmapClearAll(qemuCaps->flags);
     qemuCaps->version = qemuCaps->kvmVersion = 0;
     VIR_FREE(qemuCaps->package);
+    VIR_FREE(qemuCaps->kernelVersion);
     qemuCaps->arch = VIR_ARCH_NONE;
     qemuCaps->usedQMP = false;
 
@@ -3442,6 +3463,21 @@ virQEMUCapsReset(virQEMUCapsPtr qemuCaps)
 }
 
 
+/* Capability probing results depend on the running kernel, e.g. via
+ * the features /dev/kvm exposes, so cached capabilities are only
+ * reused on the kernel they were probed under. */
+static char *
+virQEMUCapsKernelVersion(void)
+{
+    struct utsname ut;
+    char *version;
+
+    uname(&ut);
+    ignore_value(virAsprintf(&version, "%s %s", ut.release, ut.version));
+    return version;
+}
+
+
 static int
 virQEMUCapsInitCached(virCapsPtr caps,
                       virQEMUCapsPtr qemuCaps,
@@ -3451,6 +3487,7 @@ virQEMUCapsInitCached(virCapsPtr caps,
     char *capsfile = NULL;
     int ret = -1;
     char *binaryhash = NULL;
+    char *kernelVersion = NULL;
     struct stat sb;
     time_t qemuctime = qemuCaps->ctime;
     time_t selfctime;
@@ -3509,6 +3546,17 @@ virQEMUCapsInitCached(virCapsPtr caps,
         goto discard;
     }
 
+    if (!(kernelVersion = virQEMUCapsKernelVersion()))
+        goto cleanup;
+
+    if (STRNEQ_NULLABLE(qemuCaps->kernelVersion, kernelVersion)) {
+        VIR_DEBUG("Outdated capabilities for '%s': kernel changed "
+                  "('%s' vs '%s')",
+                  qemuCaps->binary,
+                  NULLSTR(qemuCaps->kernelVersion), kernelVersion);
+        goto discard;
+    }
+
     VIR_DEBUG("Loaded '%s' for '%s' ctime %lld usedQMP=%d",
               capsfile, qemuCaps->binary,
               (long long)qemuCaps->ctime, qemuCaps->usedQMP);
@@ -3517,6 +3565,7 @@ virQEMUCapsInitCached(virCapsPtr caps,
  cleanup:
     qemuCaps->ctime = qemuctime;
     VIR_FREE(binaryhash);
+    VIR_FREE(kernelVersion);
     VIR_FREE(capsfile);
     VIR_FREE(capsdir);
     return ret;
@@ -4050,6 +4099,9 @@ virQEMUCapsNewForBinaryInternal(virCapsPtr caps,
             goto error;
         }
 
+        if (!(qemuCaps->kernelVersion = virQEMUCapsKernelVersion()))
+            goto error;
+
         if (cacheDir &&
             virQEMUCapsRememberCached(qemuCaps, cacheDir) < 0)
             goto error;
@@ -4187,6 +4239,138 @@ virQEMUCapsCacheNew(const char *libDir,
 
 const char *qemuTestCapsName;
 
+struct virQEMUCapsProbeData {
+    virCapsPtr caps;
+    virQEMUCapsCachePtr cache;
+    const char *binary;
+};
+
+
+static void
+virQEMUCapsProbeWorker(void *opaque)
+{
+    struct virQEMUCapsProbeData *data = opaque;
+    virQEMUCapsCachePtr cache = data->cache;
+    virQEMUCapsPtr qemuCaps;
+
+    qemuCaps = virQEMUCapsNewForBinary(data->caps, data->binary,
+                                       cache->libDir, cache->cacheDir,
+                                       cache->runUid, cache->runGid);
+    if (!qemuCaps) {
+        /* the binary is simply skipped, as in virQEMUCapsInitGuest */
+        virResetLastError();
+        return;
+    }
+
+    virMutexLock(&cache->lock);
+    if (virHashLookup(cache->binaries, data->binary) ||
+        virHashAddEntry(cache->binaries, data->binary, qemuCaps) < 0)
+        virObjectUnref(qemuCaps);
+    virMutexUnlock(&cache->lock);
+}
+
+
+/* Probing one binary spawns a couple of qemu processes and takes a
+ * sizeable fraction of a second, so when several binaries need
+ * probing, do them concurrently. Binaries whose capabilities are
+ * already cached and valid are skipped; the probed results land in
+ * the cache for virQEMUCapsCacheLookup to pick up. */
+static void
+virQEMUCapsCacheProbeAll(virCapsPtr caps,
+                         virQEMUCapsCachePtr cache,
+                         virArch hostarch)
+{
+    const char *kvmbins[] = { "/usr/libexec/qemu-kvm", "qemu-kvm", "kvm" };
+    char **binaries = NULL;
+    size_t nbinaries = 0;
+    virThreadPtr threads = NULL;
+    struct virQEMUCapsProbeData *data = NULL;
+    size_t i;
+    size_t j;
+
+    /* This is used only by test suite!!! */
+    if (qemuTestCapsName)
+        return;
+
+    for (i = 0; i < VIR_ARCH_LAST; i++) {
+        char *binary = virQEMUCapsFindBinaryForArch(hostarch, i);
+
+        if (!binary)
+            continue;
+
+        for (j = 0; j < nbinaries; j++) {
+            if (STREQ(binaries[j], binary))
+                break;
+        }
+
+        if (j < nbinaries ||
+            VIR_APPEND_ELEMENT(binaries, nbinaries, binary) < 0)
+            VIR_FREE(binary);
+    }
+
+    for (i = 0; i < ARRAY_CARDINALITY(kvmbins); i++) {
+        char *binary = virFindFileInPath(kvmbins[i]);
+
+        if (!binary)
+            continue;
+
+        for (j = 0; j < nbinaries; j++) {
+            if (STREQ(binaries[j], binary))
+                break;
+        }
+
+        if (j < nbinaries ||
+            VIR_APPEND_ELEMENT(binaries, nbinaries, binary) < 0)
+            VIR_FREE(binary);
+    }
+
+    /* drop binaries whose cached capabilities are still usable */
+    virMutexLock(&cache->lock);
+    for (i = 0; i < nbinaries; i++) {
+        virQEMUCapsPtr qemuCaps = virHashLookup(cache->binaries, binaries[i]);
+
+        if (qemuCaps && virQEMUCapsIsValid(qemuCaps, 0)) {
+            VIR_FREE(binaries[i]);
+            binaries[i] = NULL;
+        }
+    }
+    virMutexUnlock(&cache->lock);
+
+    if (VIR_ALLOC_N(threads, nbinaries) < 0 ||
+        VIR_ALLOC_N(data, nbinaries) < 0)
+        goto cleanup;
+
+    for (i = 0; i < nbinaries; i++) {
+        if (!binaries[i])
+            continue;
+
+        data[i].caps = caps;
+        data[i].cache = cache;
+        data[i].binary = binaries[i];
+
+        if (virThreadCreate(&threads[i], true,
+                            virQEMUCapsProbeWorker, &data[i]) < 0) {
+            virResetLastError();
+            /* probe on this thread instead */
+            virQEMUCapsProbeWorker(&data[i]);
+            data[i].binary = NULL;
+        }
+    }
+
+    for (i = 0; i < nbinaries; i++) {
+        if (binaries[i] && data[i].binary)
+            virThreadJoin(&threads[i]);
+    }
+
+ cleanup:
+    for (i = 0; i < nbinaries; i++)
+        VIR_FREE(binaries[i]);
+    VIR_FREE(binaries);
+    VIR_FREE(threads);
+    VIR_FREE(data);
+}
+
+
 virQEMUCapsPtr
 virQEMUCapsCacheLookup(virCapsPtr caps,
                        virQEMUCapsCachePtr cache,
@@ -4288,6 +4472,110 @@ virQEMUCapsCacheLookupByArch(virQEMUCapsCachePtr cache,
 }
 
 
+struct virQEMUCapsStaleData {
+    char **binaries;
+    size_t nbinaries;
+};
+
+
+static int
+virQEMUCapsCacheCollectStale(void *payload,
+                             const void *name,
+                             void *opaque)
+{
+    virQEMUCapsPtr qemuCaps = payload;
+    struct virQEMUCapsStaleData *data = opaque;
+    char *binary;
+
+    if (virQEMUCapsIsValid(qemuCaps, 0))
+        return 0;
+
+    if (VIR_STRDUP_QUIET(binary, name) < 0 ||
+        VIR_APPEND_ELEMENT_QUIET(data->binaries, data->nbinaries, binary) < 0)
+        VIR_FREE(binary);
+
+    return 0;
+}
+
+
+struct virQEMUCapsRevalidateData {
+    virCapsPtr caps;
+    virQEMUCapsCachePtr cache;
+    char *binary;
+};
+
+
+static void
+virQEMUCapsRevalidateWorker(void *opaque)
+{
+    struct virQEMUCapsRevalidateData *data = opaque;
+    virQEMUCapsCachePtr cache = data->cache;
+    virQEMUCapsPtr qemuCaps;
+
+    qemuCaps = virQEMUCapsNewForBinary(data->caps, data->binary,
+                                       cache->libDir, cache->cacheDir,
+                                       cache->runUid, cache->runGid);
+    if (qemuCaps) {
+        virMutexLock(&cache->lock);
+        if (virHashLookup(cache->binaries, data->binary) ||
+            virHashAddEntry(cache->binaries, data->binary, qemuCaps) < 0)
+            virObjectUnref(qemuCaps);
+        virMutexUnlock(&cache->lock);
+    } else {
+        /* the binary will be probed again on the next lookup */
+        virResetLastError();
+    }
+
+    virObjectUnref(data->caps);
+    VIR_FREE(data->binary);
+    VIR_FREE(data);
+}
+
+
+/* Drop cached capabilities which no longer match their binary on disk
+ * (e.g. after a package upgrade underneath a running daemon) and probe
+ * replacements from detached background threads, so the next domain
+ * start finds fresh capabilities ready instead of paying for the QMP
+ * probing itself. Entries which are still valid are left alone. */
+void
+virQEMUCapsCacheRevalidate(virCapsPtr caps,
+                           virQEMUCapsCachePtr cache)
+{
+    struct virQEMUCapsStaleData stale = { NULL, 0 };
+    size_t i;
+
+    virMutexLock(&cache->lock);
+    virHashForEach(cache->binaries, virQEMUCapsCacheCollectStale, &stale);
+    for (i = 0; i < stale.nbinaries; i++)
+        virHashRemoveEntry(cache->binaries, stale.binaries[i]);
+    virMutexUnlock(&cache->lock);
+
+    for (i = 0; i < stale.nbinaries; i++) {
+        struct virQEMUCapsRevalidateData *data;
+        virThread thread;
+
+        if (VIR_ALLOC_QUIET(data) < 0)
+            break;
+
+        data->caps = virObjectRef(caps);
+        data->cache = cache;
+        data->binary = stale.binaries[i];
+        stale.binaries[i] = NULL;
+
+        if (virThreadCreate(&thread, false,
+                            virQEMUCapsRevalidateWorker, data) < 0) {
+            virObjectUnref(data->caps);
+            VIR_FREE(data->binary);
+            VIR_FREE(data);
+        }
+    }
+
+    for (i = 0; i < stale.nbinaries; i++)
+        VIR_FREE(stale.binaries[i]);
+    VIR_FREE(stale.binaries);
+}
+
+
 void
 virQEMUCapsCacheFree(virQEMUCapsCachePtr cache)
 {
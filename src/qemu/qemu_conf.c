@@ -310,6 +310,11 @@ virQEMUDriverConfigPtr virQEMUDriverConfigNew(bool privileged)
     cfg->keepAliveCount = 5;
     cfg->seccompSandbox = -1;
 
+    /* automatic ballooning is opt-in; 20% headroom above the guest's
+     * working set when it is enabled */
+    cfg->autoBalloonInterval = 0;
+    cfg->autoBalloonHeadroom = 20;
+
     cfg->logTimestamp = true;
     cfg->stdioLogD = true;
 
@@ -658,6 +663,14 @@ int virQEMUDriverConfigLoadFile(virQEMUDriverConfigPtr cfg,
         goto cleanup;
     if (virConfGetValueBool(conf, "auto_start_bypass_cache", &cfg->autoStartBypassCache) < 0)
         goto cleanup;
+    if (virConfGetValueUInt(conf, "max_parallel_autostart", &cfg->maxParallelAutostart) < 0)
+        goto cleanup;
+    if (virConfGetValueUInt(conf, "auto_balloon_interval", &cfg->autoBalloonInterval) < 0)
+        goto cleanup;
+    if (virConfGetValueUInt(conf, "auto_balloon_headroom", &cfg->autoBalloonHeadroom) < 0)
+        goto cleanup;
+    if (virConfGetValueUInt(conf, "auto_iothread_interval", &cfg->autoIOThreadInterval) < 0)
+        goto cleanup;
 
     if (virConfGetValueStringList(conf, "hugetlbfs_mount", true,
                                   &hugetlbfs) < 0)
@@ -762,6 +775,14 @@ int virQEMUDriverConfigLoadFile(virQEMUDriverConfigPtr cfg,
         goto cleanup;
     }
 
+    if (virConfGetValueUInt(conf, "migration_adaptive_downtime",
+                            &cfg->migrationAdaptiveDowntime) < 0)
+        goto cleanup;
+
+    if (virConfGetValueUInt(conf, "migration_postcopy_after_passes",
+                            &cfg->migrationPostCopyAfterPasses) < 0)
+        goto cleanup;
+
     if (virConfGetValueString(conf, "migration_address", &cfg->migrationAddress) < 0)
         goto cleanup;
     virStringStripIPv6Brackets(cfg->migrationAddress);
@@ -810,11 +831,13 @@ int virQEMUDriverConfigLoadFile(virQEMUDriverConfigPtr cfg,
 
 virQEMUDriverConfigPtr virQEMUDriverGetConfig(virQEMUDriverPtr driver)
 {
-    virQEMUDriverConfigPtr conf;
-    qemuDriverLock(driver);
-    conf = virObjectRef(driver->config);
-    qemuDriverUnlock(driver);
-    return conf;
+    /* The config object is created in qemuStateInitialize before any
+     * other thread can see the driver and is never replaced, so the
+     * pointer can be loaded without the driver lock; taking a
+     * reference is atomic already. If reloading qemu.conf at runtime
+     * is ever implemented, the swap will need to synchronize with
+     * this load again. */
+    return virObjectRef(driver->config);
 }
 
 bool
@@ -898,6 +921,39 @@ virCapsPtr virQEMUDriverCreateCapabilities(virQEMUDriverPtr driver)
 }
 
 
+/**
+ * virQEMUDriverHostTopologySignature:
+ *
+ * Build a string identifying the current host CPU/memory topology,
+ * made from the kernel's online CPU and NUMA node maps. The maps
+ * only change on CPU or memory hotplug, which is exactly when
+ * cached host capabilities go stale.
+ *
+ * Returns the signature, or NULL if it cannot be determined.
+ */
+static char *
+virQEMUDriverHostTopologySignature(void)
+{
+    char *cpus = NULL;
+    char *nodes = NULL;
+    char *sig = NULL;
+
+    if (virFileReadAllQuiet("/sys/devices/system/cpu/online",
+                            1024, &cpus) < 0)
+        return NULL;
+
+    /* not present on hosts without NUMA support built in */
+    ignore_value(virFileReadAllQuiet("/sys/devices/system/node/online",
+                                     1024, &nodes));
+
+    ignore_value(virAsprintf(&sig, "%s %s", cpus, nodes ? nodes : ""));
+
+    VIR_FREE(cpus);
+    VIR_FREE(nodes);
+    return sig;
+}
+
+
 /**
  * virQEMUDriverGetCapabilities:
  *
@@ -913,14 +969,36 @@ virCapsPtr virQEMUDriverGetCapabilities(virQEMUDriverPtr driver,
                                         bool refresh)
 {
     virCapsPtr ret = NULL;
+
+    /* Orchestrators tend to call virConnectGetCapabilities before
+     * every scheduling decision, and a full rebuild re-reads the host
+     * NUMA topology from sysfs each time. The host topology can only
+     * change on CPU/memory hotplug, so skip the rebuild while the
+     * online maps still match the ones the cached object was built
+     * from; if the signature cannot be determined, rebuild as
+     * before. */
     if (refresh) {
-        virCapsPtr caps = NULL;
-        if ((caps = virQEMUDriverCreateCapabilities(driver)) == NULL)
-            return NULL;
+        char *sig = virQEMUDriverHostTopologySignature();
 
         qemuDriverLock(driver);
-        virObjectUnref(driver->caps);
-        driver->caps = caps;
+        if (driver->caps && sig && STREQ_NULLABLE(sig, driver->capsTopology)) {
+            /* topology unchanged; the cached object is still valid */
+            VIR_FREE(sig);
+        } else {
+            virCapsPtr caps = NULL;
+
+            qemuDriverUnlock(driver);
+            if ((caps = virQEMUDriverCreateCapabilities(driver)) == NULL) {
+                VIR_FREE(sig);
+                return NULL;
+            }
+
+            qemuDriverLock(driver);
+            virObjectUnref(driver->caps);
+            driver->caps = caps;
+            VIR_FREE(driver->capsTopology);
+            driver->capsTopology = sig;
+        }
     } else {
         qemuDriverLock(driver);
     }
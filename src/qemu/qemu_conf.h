@@ -173,6 +173,12 @@ struct _virQEMUDriverConfig {
     char *autoDumpPath;
     bool autoDumpBypassCache;
     bool autoStartBypassCache;
+    unsigned int maxParallelAutostart;
+
+    unsigned int autoBalloonInterval;
+    unsigned int autoBalloonHeadroom;
+
+    unsigned int autoIOThreadInterval;
 
     char *lockManagerName;
 
@@ -186,6 +192,8 @@ struct _virQEMUDriverConfig {
     char *migrationAddress;
     unsigned int migrationPortMin;
     unsigned int migrationPortMax;
+    unsigned int migrationAdaptiveDowntime;
+    unsigned int migrationPostCopyAfterPasses;
 
     bool logTimestamp;
     bool stdioLogD;
@@ -232,12 +240,20 @@ struct _virQEMUDriver {
      */
     virCapsPtr caps;
 
+    /* Host topology signature 'caps' was built from; protected
+     * by the driver lock */
+    char *capsTopology;
+
     /* Immutable pointer, Immutable object */
     virDomainXMLOptionPtr xmlopt;
 
     /* Immutable pointer, self-locking APIs */
     virQEMUCapsCachePtr qemuCapsCache;
 
+    /* Immutable after initialization; event loop timer which
+     * revalidates qemuCapsCache, or -1 when no event loop exists */
+    int qemuCapsRefreshTimer;
+
     /* Immutable pointer, self-locking APIs */
     virObjectEventStatePtr domainEventState;
 
@@ -269,6 +285,22 @@ struct _virQEMUDriver {
 
     /* Immutable pointer, self-locking APIs */
     virHashAtomicPtr migrationErrors;
+
+    /* Automatic balloon policy worker; fields immutable after state
+     * init apart from balloonQuit, protected by balloonLock */
+    virThread balloonThread;
+    bool balloonThreadStarted;
+    virMutex balloonLock;
+    virCond balloonCond;
+    bool balloonQuit;
+
+    /* Host-level iothread balance worker; same locking rules as the
+     * balloon policy worker above */
+    virThread iothreadBalanceThread;
+    bool iothreadBalanceThreadStarted;
+    virMutex iothreadBalanceLock;
+    virCond iothreadBalanceCond;
+    bool iothreadBalanceQuit;
 };
 
 typedef struct _qemuDomainCmdlineDef qemuDomainCmdlineDef;
@@ -38,13 +38,17 @@
 #include "cpu/cpu.h"
 #include "viruuid.h"
 #include "virfile.h"
+#include "virhostcpu.h"
 #include "domain_addr.h"
 #include "domain_event.h"
 #include "virtime.h"
 #include "virstoragefile.h"
 #include "virstring.h"
+#include "virthread.h"
 #include "virthreadjob.h"
+#include "virutil.h"
 #include "viratomic.h"
+#include "virprobe.h"
 #include "virprocess.h"
 #include "vircrypto.h"
 #include "secret_util.h"
@@ -53,6 +57,10 @@
 
 #include "storage/storage_driver.h"
 
+#ifdef WITH_DTRACE_PROBES
+# include "libvirt_qemu_probes.h"
+#endif
+
 #include <sys/time.h>
 #include <fcntl.h>
 
@@ -3264,6 +3272,7 @@ qemuDomainObjBeginJobInternal(virQEMUDriverPtr driver,
     virQEMUDriverConfigPtr cfg = virQEMUDriverGetConfig(driver);
     const char *blocker = NULL;
     int ret = -1;
+    unsigned long long start;
     unsigned long long duration = 0;
     unsigned long long asyncDuration = 0;
     const char *jobStr;
@@ -3278,6 +3287,10 @@ qemuDomainObjBeginJobInternal(virQEMUDriverPtr driver,
               qemuDomainJobTypeToString(priv->job.active),
               qemuDomainAsyncJobTypeToString(priv->job.asyncJob));
 
+    PROBE(QEMU_DOMAIN_JOB_WAIT,
+          "obj=%p name=%s job=%s",
+          obj, obj->def->name, jobStr);
+
     if (virTimeMillisNow(&now) < 0) {
         virObjectUnref(cfg);
         return -1;
@@ -3285,6 +3298,7 @@ qemuDomainObjBeginJobInternal(virQEMUDriverPtr driver,
 
     priv->jobs_queued++;
     then = now + QEMU_JOB_WAIT_TIME;
+    start = now;
 
  retry:
     if (cfg->maxQueuedJobs &&
@@ -3313,6 +3327,28 @@ qemuDomainObjBeginJobInternal(virQEMUDriverPtr driver,
 
     ignore_value(virTimeMillisNow(&now));
 
+    /* record how long we were queued behind other jobs so that lock
+     * convoys show up in the logs rather than just as slow APIs */
+    if (now > start) {
+        unsigned long long waited = now - start;
+
+        priv->job.waits++;
+        priv->job.waitTime += waited;
+        if (waited > priv->job.waitTimeMax)
+            priv->job.waitTimeMax = waited;
+        VIR_DEBUG("Job %s for domain %s waited %llums to start "
+                  "(%d queued; %llu waits totalling %llums, longest %llums)",
+                  jobStr, obj->def->name, waited, priv->jobs_queued,
+                  priv->job.waits, priv->job.waitTime, priv->job.waitTimeMax);
+        if (waited > QEMU_JOB_WAIT_TIME / 3)
+            VIR_WARN("Job %s for domain %s waited %llums to start",
+                     jobStr, obj->def->name, waited);
+    }
+
+    PROBE(QEMU_DOMAIN_JOB_START,
+          "obj=%p name=%s job=%s waited=%llu",
+          obj, obj->def->name, jobStr, now > start ? now - start : 0);
+
     if (job != QEMU_JOB_ASYNC) {
         VIR_DEBUG("Started job: %s (async=%s vm=%p name=%s)",
                    qemuDomainJobTypeToString(job),
@@ -3351,7 +3387,7 @@ qemuDomainObjBeginJobInternal(virQEMUDriverPtr driver,
 
     VIR_WARN("Cannot start job (%s, %s) for domain %s; "
              "current job is (%s, %s) owned by (%llu %s, %llu %s) "
-             "for (%llus, %llus)",
+             "for (%llus, %llus); %d jobs queued",
              qemuDomainJobTypeToString(job),
              qemuDomainAsyncJobTypeToString(asyncJob),
              obj->def->name,
@@ -3359,7 +3395,8 @@ qemuDomainObjBeginJobInternal(virQEMUDriverPtr driver,
              qemuDomainAsyncJobTypeToString(priv->job.asyncJob),
              priv->job.owner, NULLSTR(priv->job.ownerAPI),
              priv->job.asyncOwner, NULLSTR(priv->job.asyncOwnerAPI),
-             duration / 1000, asyncDuration / 1000);
+             duration / 1000, asyncDuration / 1000,
+             priv->jobs_queued);
 
     if (nested || qemuDomainNestedJobAllowed(priv, job))
         blocker = priv->job.ownerAPI;
@@ -3465,6 +3502,8 @@ qemuDomainObjEndJob(virQEMUDriverPtr driver, virDomainObjPtr obj)
 {
     qemuDomainObjPrivatePtr priv = obj->privateData;
     qemuDomainJob job = priv->job.active;
+    unsigned long long now = 0;
+    unsigned long long duration = 0;
 
     priv->jobs_queued--;
 
@@ -3473,6 +3512,20 @@ qemuDomainObjEndJob(virQEMUDriverPtr driver, virDomainObjPtr obj)
               qemuDomainAsyncJobTypeToString(priv->job.asyncJob),
               obj, obj->def->name);
 
+    if (priv->job.started) {
+        ignore_value(virTimeMillisNow(&now));
+        if (now > priv->job.started)
+            duration = now - priv->job.started;
+    }
+    PROBE(QEMU_DOMAIN_JOB_END,
+          "obj=%p name=%s job=%s duration=%llu",
+          obj, obj->def->name, qemuDomainJobTypeToString(job), duration);
+
+    /* Anything but a query job may have changed the definitions,
+     * so conservatively invalidate the cached formatted XML */
+    if (job != QEMU_JOB_QUERY)
+        virDomainObjDefModified(obj);
+
     qemuDomainObjResetJob(priv);
     if (qemuDomainTrackJob(job))
         qemuDomainObjSaveJob(driver, obj);
@@ -3490,6 +3543,7 @@ qemuDomainObjEndAsyncJob(virQEMUDriverPtr driver, virDomainObjPtr obj)
               qemuDomainAsyncJobTypeToString(priv->job.asyncJob),
               obj, obj->def->name);
 
+    virDomainObjDefModified(obj);
     qemuDomainObjResetAsyncJob(priv);
     qemuDomainObjSaveJob(driver, obj);
     virCondBroadcast(&priv->job.asyncCond);
@@ -3891,15 +3945,25 @@ char *qemuDomainFormatXML(virQEMUDriverPtr driver,
                           unsigned int flags)
 {
     virDomainDefPtr def;
+    char *xml;
 
     if ((flags & VIR_DOMAIN_XML_INACTIVE) && vm->newDef) {
+        /* The persistent definition only changes under a modify job,
+         * which invalidates the cache, so frequent polling of the
+         * inactive XML can reuse the previously formatted document */
         def = vm->newDef;
-    } else {
-        def = vm->def;
-        if (virDomainObjIsActive(vm))
-            flags &= ~VIR_DOMAIN_XML_UPDATE_CPU;
+        if ((xml = virDomainObjGetCachedXML(vm, def, flags)))
+            return xml;
+
+        if ((xml = qemuDomainDefFormatXML(driver, def, flags)))
+            virDomainObjSetCachedXML(vm, def, flags, xml);
+        return xml;
     }
 
+    def = vm->def;
+    if (virDomainObjIsActive(vm))
+        flags &= ~VIR_DOMAIN_XML_UPDATE_CPU;
+
     return qemuDomainDefFormatXML(driver, def, flags);
 }
 
@@ -4751,6 +4815,45 @@ qemuDomainCheckDiskStartupPolicy(virQEMUDriverPtr driver,
 }
 
 
+struct qemuDomainDiskChainJobs {
+    virMutex lock;
+    virQEMUDriverPtr driver;
+    virDomainObjPtr vm;
+    virDomainDiskDefPtr *disks;
+    size_t ndisks;
+    size_t next;
+    int *results;
+    virErrorPtr *errors;
+};
+
+
+static void
+qemuDomainCheckDiskPresenceWorker(void *opaque)
+{
+    struct qemuDomainDiskChainJobs *jobs = opaque;
+
+    for (;;) {
+        size_t i;
+
+        virMutexLock(&jobs->lock);
+        i = jobs->next++;
+        virMutexUnlock(&jobs->lock);
+
+        if (i >= jobs->ndisks)
+            break;
+
+        jobs->results[i] = qemuDomainDetermineDiskChain(jobs->driver,
+                                                        jobs->vm,
+                                                        jobs->disks[i],
+                                                        true, true);
+        if (jobs->results[i] < 0) {
+            jobs->errors[i] = virSaveLastError();
+            virResetLastError();
+        }
+    }
+}
+
+
 int
 qemuDomainCheckDiskPresence(virConnectPtr conn,
                             virQEMUDriverPtr driver,
@@ -4760,8 +4863,29 @@ qemuDomainCheckDiskPresence(virConnectPtr conn,
     size_t i;
     bool pretend = flags & VIR_QEMU_PROCESS_START_PRETEND;
     bool cold_boot = flags & VIR_QEMU_PROCESS_START_COLD;
+    int ret = -1;
+    int hostcpus;
+    size_t nworkers;
+    virThreadPtr workers = NULL;
+    size_t nspawned = 0;
+    struct qemuDomainDiskChainJobs jobs = { .next = 0 };
 
     VIR_DEBUG("Checking for disk presence");
+
+    if (virMutexInit(&jobs.lock) < 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("cannot initialize mutex"));
+        return -1;
+    }
+
+    jobs.driver = driver;
+    jobs.vm = vm;
+
+    if (VIR_ALLOC_N(jobs.disks, vm->def->ndisks) < 0 ||
+        VIR_ALLOC_N(jobs.results, vm->def->ndisks) < 0 ||
+        VIR_ALLOC_N(jobs.errors, vm->def->ndisks) < 0)
+        goto cleanup;
+
     for (i = vm->def->ndisks; i > 0; i--) {
         size_t idx = i - 1;
         virDomainDiskDefPtr disk = vm->def->disks[idx];
@@ -4770,7 +4894,7 @@ qemuDomainCheckDiskPresence(virConnectPtr conn,
         if (virStorageTranslateDiskSourcePool(conn, vm->def->disks[idx]) < 0) {
             if (pretend ||
                 qemuDomainCheckDiskStartupPolicy(driver, vm, idx, cold_boot) < 0)
-                return -1;
+                goto cleanup;
             continue;
         }
 
@@ -4789,16 +4913,74 @@ qemuDomainCheckDiskPresence(virConnectPtr conn,
             virFileExists(virDomainDiskGetSource(disk)))
             continue;
 
-        if (qemuDomainDetermineDiskChain(driver, vm, disk, true, true) >= 0)
+        jobs.disks[jobs.ndisks++] = disk;
+    }
+
+    if (jobs.ndisks == 0) {
+        ret = 0;
+        goto cleanup;
+    }
+
+    /* Probing a backing chain is mostly I/O; fan the disks out over a
+     * few threads so a many-disk guest isn't serialized on it. Each
+     * worker only ever touches the disk sources it claimed. */
+    if ((hostcpus = virHostCPUGetCount()) < 1)
+        hostcpus = 1;
+    nworkers = MIN((size_t) hostcpus, jobs.ndisks);
+
+    if (nworkers > 1 &&
+        VIR_ALLOC_N(workers, nworkers - 1) < 0)
+        goto cleanup;
+
+    for (i = 0; i < nworkers - 1; i++) {
+        if (virThreadCreate(&workers[i], true,
+                            qemuDomainCheckDiskPresenceWorker, &jobs) < 0)
+            break;
+        nspawned++;
+    }
+
+    /* this thread works too, and picks up everything when no worker
+     * could be spawned */
+    qemuDomainCheckDiskPresenceWorker(&jobs);
+
+    for (i = 0; i < nspawned; i++)
+        virThreadJoin(&workers[i]);
+
+    /* apply the startup policy serially; it may drop disks from the
+     * definition */
+    for (i = 0; i < jobs.ndisks; i++) {
+        size_t idx;
+
+        if (jobs.results[i] >= 0)
             continue;
 
-        if (qemuDomainCheckDiskStartupPolicy(driver, vm, idx, cold_boot) >= 0)
+        for (idx = 0; idx < vm->def->ndisks; idx++) {
+            if (vm->def->disks[idx] == jobs.disks[i])
+                break;
+        }
+        if (idx == vm->def->ndisks)
             continue;
 
-        return -1;
+        if (jobs.errors[i])
+            virSetError(jobs.errors[i]);
+
+        if (qemuDomainCheckDiskStartupPolicy(driver, vm, idx, cold_boot) < 0)
+            goto cleanup;
     }
 
-    return 0;
+    ret = 0;
+
+ cleanup:
+    if (jobs.errors) {
+        for (i = 0; i < jobs.ndisks; i++)
+            virFreeError(jobs.errors[i]);
+    }
+    VIR_FREE(jobs.disks);
+    VIR_FREE(jobs.results);
+    VIR_FREE(jobs.errors);
+    VIR_FREE(workers);
+    virMutexDestroy(&jobs.lock);
+    return ret;
 }
 
 /*
@@ -4954,10 +5136,16 @@ qemuDomainDetermineDiskChain(virQEMUDriverPtr driver,
         goto cleanup;
 
     if (disk->src->backingStore) {
-        if (force_probe)
+        if (force_probe) {
+            qemuDomainDiskPrivatePtr diskPriv = QEMU_DOMAIN_DISK_PRIVATE(disk);
+
             virStorageSourceBackingStoreClear(disk->src);
-        else
+            /* any pending commit splice pointers now dangle */
+            diskPriv->commitTop = NULL;
+            diskPriv->commitBase = NULL;
+        } else {
             goto cleanup;
+        }
     }
 
     qemuDomainGetImageIds(cfg, vm, disk->src, &uid, &gid);
@@ -143,6 +143,12 @@ struct qemuDomainJobObj {
                                          * should wait for it to finish */
     bool spiceMigrated;                 /* spice migration completed */
     bool postcopyEnabled;               /* post-copy migration was enabled */
+
+    /* Aggregate job contention statistics for this domain; these are
+     * never reset while the domain object lives */
+    unsigned long long waits;           /* Jobs which had to wait to start */
+    unsigned long long waitTime;        /* Total time jobs waited (ms) */
+    unsigned long long waitTimeMax;     /* Longest wait for a job (ms) */
 };
 
 typedef void (*qemuDomainCleanupCallback)(virQEMUDriverPtr driver,
@@ -292,6 +298,13 @@ struct _qemuDomainDiskPrivate {
     int blockJobStatus; /* status of the finished block job */
     bool blockJobSync; /* the block job needs synchronized termination */
 
+    /* set while a non-active block commit runs, so that on completion
+     * the backing chain can be spliced in place instead of fully
+     * reprobed; both point into disk->src's chain and are cleared
+     * whenever that chain is rebuilt */
+    virStorageSourcePtr commitTop;
+    virStorageSourcePtr commitBase;
+
     bool migrating; /* the disk is being migrated */
 
     /* for storage devices using auth/secret
@@ -125,6 +125,10 @@ VIR_LOG_INIT("qemu.qemu_driver");
 
 #define QEMU_GUEST_VCPU_MAX_ID 4096
 
+/* How often to check whether cached QEMU capabilities went stale
+ * because a binary was replaced, e.g. by a package upgrade */
+#define QEMU_CAPS_CACHE_REFRESH_INTERVAL (60 * 1000)
+
 #define QEMU_NB_BLKIO_PARAM  6
 
 #define QEMU_NB_BANDWIDTH_PARAM 7
@@ -301,6 +305,53 @@ qemuAutostartDomain(virDomainObjPtr vm,
 }
 
 
+struct qemuAutostartJobs {
+    virMutex lock;
+    struct qemuAutostartData *data;
+    virDomainObjPtr *vms;
+    size_t nvms;
+    size_t next;
+};
+
+
+static int
+qemuAutostartDomainCollect(virDomainObjPtr vm,
+                           void *opaque)
+{
+    struct qemuAutostartJobs *jobs = opaque;
+
+    virObjectLock(vm);
+    if (vm->autostart &&
+        !virDomainObjIsActive(vm)) {
+        virObjectRef(vm);
+        if (VIR_APPEND_ELEMENT_COPY(jobs->vms, jobs->nvms, vm) < 0)
+            virObjectUnref(vm);
+    }
+    virObjectUnlock(vm);
+    return 0;
+}
+
+
+static void
+qemuAutostartDomainsWorker(void *opaque)
+{
+    struct qemuAutostartJobs *jobs = opaque;
+
+    for (;;) {
+        size_t i;
+
+        virMutexLock(&jobs->lock);
+        i = jobs->next++;
+        virMutexUnlock(&jobs->lock);
+
+        if (i >= jobs->nvms)
+            break;
+
+        qemuAutostartDomain(jobs->vms[i], jobs->data);
+    }
+}
+
+
 static void
 qemuAutostartDomains(virQEMUDriverPtr driver)
 {
@@ -313,9 +364,62 @@ qemuAutostartDomains(virQEMUDriverPtr driver)
     virConnectPtr conn = virConnectOpen(cfg->uri);
     /* Ignoring NULL conn which is mostly harmless here */
     struct qemuAutostartData data = { driver, conn };
+    struct qemuAutostartJobs jobs = { .next = 0 };
+    virThreadPtr workers = NULL;
+    size_t nworkers;
+    size_t nspawned = 0;
+    size_t i;
+
+    jobs.data = &data;
+
+    if (virMutexInit(&jobs.lock) < 0) {
+        /* fall back to starting the domains one by one */
+        virDomainObjListForEach(driver->domains, qemuAutostartDomain, &data);
+        goto cleanup;
+    }
+
+    virDomainObjListForEach(driver->domains, qemuAutostartDomainCollect, &jobs);
 
-    virDomainObjListForEach(driver->domains, qemuAutostartDomain, &data);
+    if (jobs.nvms == 0)
+        goto done;
 
+    /* Start a bounded number of domains in parallel; an unbounded
+     * boot storm just makes every guest fight for disk and CPU */
+    if ((nworkers = cfg->maxParallelAutostart) == 0) {
+        int hostcpus;
+
+        if ((hostcpus = virHostCPUGetCount()) < 1)
+            hostcpus = 1;
+        nworkers = hostcpus;
+    }
+    if (nworkers > jobs.nvms)
+        nworkers = jobs.nvms;
+
+    if (nworkers > 1 &&
+        VIR_ALLOC_N(workers, nworkers - 1) < 0)
+        nworkers = 1;
+
+    for (i = 0; i < nworkers - 1; i++) {
+        if (virThreadCreate(&workers[i], true,
+                            qemuAutostartDomainsWorker, &jobs) < 0)
+            break;
+        nspawned++;
+    }
+
+    /* this thread starts domains too, and picks up everything
+     * when no worker could be spawned */
+    qemuAutostartDomainsWorker(&jobs);
+
+    for (i = 0; i < nspawned; i++)
+        virThreadJoin(&workers[i]);
+
+ done:
+    for (i = 0; i < jobs.nvms; i++)
+        virObjectUnref(jobs.vms[i]);
+    VIR_FREE(jobs.vms);
+    VIR_FREE(workers);
+    virMutexDestroy(&jobs.lock);
+ cleanup:
     virObjectUnref(conn);
     virObjectUnref(cfg);
 }
@@ -569,6 +673,111 @@ qemuDomainSnapshotLoad(virDomainObjPtr vm,
 }
 
 
+struct qemuDomainSnapshotLoadJobs {
+    virMutex lock;
+    char *baseDir;
+    virDomainObjPtr *vms;
+    size_t nvms;
+    size_t next;
+};
+
+
+static int
+qemuDomainSnapshotLoadCollect(virDomainObjPtr vm,
+                              void *opaque)
+{
+    struct qemuDomainSnapshotLoadJobs *jobs = opaque;
+
+    virObjectRef(vm);
+    if (VIR_APPEND_ELEMENT_COPY(jobs->vms, jobs->nvms, vm) < 0)
+        virObjectUnref(vm);
+    return 0;
+}
+
+
+static void
+qemuDomainSnapshotLoadWorker(void *opaque)
+{
+    struct qemuDomainSnapshotLoadJobs *jobs = opaque;
+
+    for (;;) {
+        size_t i;
+
+        virMutexLock(&jobs->lock);
+        i = jobs->next++;
+        virMutexUnlock(&jobs->lock);
+
+        if (i >= jobs->nvms)
+            break;
+
+        qemuDomainSnapshotLoad(jobs->vms[i], jobs->baseDir);
+    }
+}
+
+
+static void
+qemuDomainSnapshotLoadAll(virQEMUDriverPtr driver,
+                          char *baseDir)
+{
+    struct qemuDomainSnapshotLoadJobs jobs = { .next = 0 };
+    virThreadPtr workers = NULL;
+    size_t nworkers;
+    size_t nspawned = 0;
+    size_t i;
+    int hostcpus;
+
+    jobs.baseDir = baseDir;
+
+    if (virMutexInit(&jobs.lock) < 0) {
+        /* fall back to loading snapshots one domain at a time */
+        virDomainObjListForEach(driver->domains, qemuDomainSnapshotLoad,
+                                baseDir);
+        return;
+    }
+
+    virDomainObjListForEach(driver->domains, qemuDomainSnapshotLoadCollect,
+                            &jobs);
+
+    if (jobs.nvms == 0)
+        goto cleanup;
+
+    /* Loading is dominated by reading and parsing many small XML
+     * files; each domain's snapshots stay on one thread, so domains
+     * with large snapshot trees overlap with the rest instead of
+     * serializing daemon startup */
+    if ((hostcpus = virHostCPUGetCount()) < 1)
+        hostcpus = 1;
+    nworkers = hostcpus;
+    if (nworkers > jobs.nvms)
+        nworkers = jobs.nvms;
+
+    if (nworkers > 1 &&
+        VIR_ALLOC_N(workers, nworkers - 1) < 0)
+        nworkers = 1;
+
+    for (i = 0; i < nworkers - 1; i++) {
+        if (virThreadCreate(&workers[i], true,
+                            qemuDomainSnapshotLoadWorker, &jobs) < 0)
+            break;
+        nspawned++;
+    }
+
+    /* this thread loads snapshots too, and picks up everything
+     * when no worker could be spawned */
+    qemuDomainSnapshotLoadWorker(&jobs);
+
+    for (i = 0; i < nspawned; i++)
+        virThreadJoin(&workers[i]);
+
+ cleanup:
+    for (i = 0; i < jobs.nvms; i++)
+        virObjectUnref(jobs.vms[i]);
+    VIR_FREE(jobs.vms);
+    VIR_FREE(workers);
+    virMutexDestroy(&jobs.lock);
+}
+
+
 static int
 qemuDomainNetsRestart(virDomainObjPtr vm,
                       void *data ATTRIBUTE_UNUSED)
@@ -602,12 +811,419 @@ static int
 qemuDomainFindMaxID(virDomainObjPtr vm,
                     void *data)
 {
-    int *driver_maxid = data;
+    int *driver_maxid = data;
+
+    if (vm->def->id > *driver_maxid)
+        *driver_maxid = vm->def->id;
+
+    return 0;
+}
+
+
+struct qemuBalloonPolicyTarget {
+    unsigned long long desired; /* balloon target in KiB */
+    unsigned long long floor;   /* never shrink below this, in KiB */
+};
+
+
+/**
+ * qemuBalloonPolicyRun:
+ * @driver: qemu driver
+ * @cfg: driver configuration
+ *
+ * Run one cycle of the automatic balloon policy: collect virtio
+ * balloon statistics from every running domain with a stats period
+ * configured, compute a per-domain target of working set plus
+ * headroom, scale all targets down proportionally if they exceed
+ * host memory, and apply the changed ones straight on the monitor.
+ */
+static void
+qemuBalloonPolicyRun(virQEMUDriverPtr driver,
+                     virQEMUDriverConfigPtr cfg)
+{
+    virDomainObjPtr *vms = NULL;
+    size_t nvms = 0;
+    struct qemuBalloonPolicyTarget *targets = NULL;
+    unsigned long long hostKB = 0;
+    unsigned long long totalDesired = 0;
+    size_t i;
+
+    if (virDomainObjListCollect(driver->domains, NULL, &vms, &nvms,
+                                NULL, 0) < 0)
+        return;
+
+    if (nvms == 0 || VIR_ALLOC_N(targets, nvms) < 0)
+        goto cleanup;
+
+    /* First pass: gather statistics and compute desired targets */
+    for (i = 0; i < nvms; i++) {
+        virDomainObjPtr vm = vms[i];
+        virDomainMemoryStatStruct stats[VIR_DOMAIN_MEMORY_STAT_NR];
+        unsigned long long unused = 0;
+        unsigned long long available = 0;
+        unsigned long long used;
+        int nr_stats;
+        size_t j;
+
+        virObjectLock(vm);
+
+        if (!virDomainObjIsActive(vm) ||
+            !vm->def->memballoon ||
+            vm->def->memballoon->model != VIR_DOMAIN_MEMBALLOON_MODEL_VIRTIO ||
+            vm->def->memballoon->period <= 0) {
+            virObjectUnlock(vm);
+            continue;
+        }
+
+        if (qemuDomainObjBeginJob(driver, vm, QEMU_JOB_QUERY) < 0) {
+            virObjectUnlock(vm);
+            continue;
+        }
+
+        nr_stats = -1;
+        if (virDomainObjIsActive(vm)) {
+            qemuDomainObjEnterMonitor(driver, vm);
+            nr_stats = qemuMonitorGetMemoryStats(qemuDomainGetMonitor(vm),
+                                                 vm->def->memballoon, stats,
+                                                 VIR_DOMAIN_MEMORY_STAT_NR);
+            if (qemuDomainObjExitMonitor(driver, vm) < 0)
+                nr_stats = -1;
+        }
+
+        qemuDomainObjEndJob(driver, vm);
+        virObjectUnlock(vm);
+
+        for (j = 0; nr_stats > 0 && j < (size_t)nr_stats; j++) {
+            if (stats[j].tag == VIR_DOMAIN_MEMORY_STAT_UNUSED)
+                unused = stats[j].val;
+            else if (stats[j].tag == VIR_DOMAIN_MEMORY_STAT_AVAILABLE)
+                available = stats[j].val;
+        }
+
+        /* without guest statistics there is no basis for a decision */
+        if (!unused || !available || unused > available)
+            continue;
+
+        used = available - unused;
+        targets[i].floor = used;
+        targets[i].desired = used + used * cfg->autoBalloonHeadroom / 100;
+        totalDesired += targets[i].desired;
+    }
+
+    /* Fleet-wide scaling: when every guest's desired target cannot
+     * fit in host memory, shrink the targets proportionally but
+     * never below the measured working set */
+    if (virHostMemGetInfo(&hostKB, NULL) == 0)
+        hostKB >>= 10;
+    if (hostKB && totalDesired > hostKB) {
+        for (i = 0; i < nvms; i++) {
+            if (!targets[i].desired)
+                continue;
+            targets[i].desired = targets[i].desired / totalDesired * hostKB +
+                (targets[i].desired % totalDesired) * hostKB / totalDesired;
+            if (targets[i].desired < targets[i].floor)
+                targets[i].desired = targets[i].floor;
+        }
+    }
+
+    /* Second pass: apply the targets that changed enough to matter */
+    for (i = 0; i < nvms; i++) {
+        virDomainObjPtr vm = vms[i];
+        unsigned long long target = targets[i].desired;
+        unsigned long long maxmem;
+        unsigned long long drift;
+
+        if (!target)
+            continue;
+
+        virObjectLock(vm);
+
+        if (qemuDomainObjBeginJob(driver, vm, QEMU_JOB_MODIFY) < 0) {
+            virObjectUnlock(vm);
+            continue;
+        }
+
+        if (!virDomainObjIsActive(vm))
+            goto endjob;
+
+        maxmem = virDomainDefGetMemoryTotal(vm->def);
+        if (target > maxmem)
+            target = maxmem;
+
+        /* ignore drift below 1/32 of the maximum so guests don't
+         * shuffle pages for marginal gains every cycle */
+        if (target > vm->def->mem.cur_balloon)
+            drift = target - vm->def->mem.cur_balloon;
+        else
+            drift = vm->def->mem.cur_balloon - target;
+        if (drift * 32 < maxmem)
+            goto endjob;
+
+        VIR_DEBUG("balloon policy: domain %s current %llu target %llu",
+                  vm->def->name, vm->def->mem.cur_balloon, target);
+
+        qemuDomainObjEnterMonitor(driver, vm);
+        if (qemuMonitorSetBalloon(qemuDomainGetMonitor(vm), target) < 0)
+            VIR_WARN("balloon policy: unable to set balloon of domain "
+                     "%s to %llu: %s", vm->def->name, target,
+                     virGetLastErrorMessage());
+        ignore_value(qemuDomainObjExitMonitor(driver, vm));
+
+ endjob:
+        qemuDomainObjEndJob(driver, vm);
+        virObjectUnlock(vm);
+    }
+
+    virResetLastError();
+
+ cleanup:
+    VIR_FREE(targets);
+    virObjectListFreeCount(vms, nvms);
+}
+
+
+static void
+qemuBalloonPolicyThread(void *opaque)
+{
+    virQEMUDriverPtr driver = opaque;
+
+    for (;;) {
+        virQEMUDriverConfigPtr cfg = virQEMUDriverGetConfig(driver);
+        unsigned long long interval = cfg->autoBalloonInterval * 1000ULL;
+        unsigned long long then;
+        bool quit;
+
+        ignore_value(virTimeMillisNow(&then));
+        then += interval;
+
+        virMutexLock(&driver->balloonLock);
+        while (!driver->balloonQuit &&
+               virCondWaitUntil(&driver->balloonCond,
+                                &driver->balloonLock, then) == 0)
+            ;
+        quit = driver->balloonQuit;
+        virMutexUnlock(&driver->balloonLock);
+
+        if (!quit)
+            qemuBalloonPolicyRun(driver, cfg);
+        virObjectUnref(cfg);
+
+        if (quit)
+            break;
+    }
+}
+
+
+/* Utilization bounds for the iothread balance policy: iothreads
+ * above the busy mark get a host CPU of their own, iothreads below
+ * the idle mark are released back to the full host CPU set */
+#define QEMU_IOTHREAD_BUSY_PCT 75
+#define QEMU_IOTHREAD_IDLE_PCT 5
+
+struct qemuIOThreadSample {
+    unsigned long long cpuTime;    /* cumulative, in ns */
+    unsigned long long generation; /* cycle the sample was last seen */
+};
+
+
+static int
+qemuIOThreadSamplePrune(const void *payload,
+                        const void *name ATTRIBUTE_UNUSED,
+                        const void *data)
+{
+    const struct qemuIOThreadSample *sample = payload;
+    const unsigned long long *generation = data;
+
+    return sample->generation != *generation;
+}
+
+
+/**
+ * qemuIOThreadBalanceRun:
+ * @driver: qemu driver
+ * @samples: per-iothread samples from previous cycles
+ * @generation: current cycle number
+ * @intervalMS: milliseconds since the previous cycle
+ *
+ * Run one cycle of the host-level iothread balance policy: sample
+ * the cumulative CPU time of every iothread whose placement libvirt
+ * chose itself (no explicit cpuset in the domain config), classify
+ * them against the utilization bounds, and rebalance: each busy
+ * iothread is pinned to a host CPU of its own, distributed fleet
+ * wide, while idle ones are relaxed back to the full host CPU set
+ * so the scheduler can fill the gaps.
+ */
+static void
+qemuIOThreadBalanceRun(virQEMUDriverPtr driver,
+                       virHashTablePtr samples,
+                       unsigned long long generation,
+                       unsigned int intervalMS)
+{
+    virDomainObjPtr *vms = NULL;
+    size_t nvms = 0;
+    pid_t *busy = NULL;
+    pid_t *idle = NULL;
+    size_t nbusy = 0;
+    size_t nidle = 0;
+    virBitmapPtr map = NULL;
+    int hostcpus;
+    size_t i, j;
+    char uuidstr[VIR_UUID_STRING_BUFLEN];
+
+    if (virDomainObjListCollect(driver->domains, NULL, &vms, &nvms,
+                                NULL, 0) < 0)
+        return;
+
+    for (i = 0; i < nvms; i++) {
+        virDomainObjPtr vm = vms[i];
+
+        virObjectLock(vm);
+
+        if (!virDomainObjIsActive(vm)) {
+            virObjectUnlock(vm);
+            continue;
+        }
+
+        virUUIDFormat(vm->def->uuid, uuidstr);
+
+        for (j = 0; j < vm->def->niothreadids; j++) {
+            virDomainIOThreadIDDefPtr iothr = vm->def->iothreadids[j];
+            struct qemuIOThreadSample *sample;
+            unsigned long long cpuTime;
+            pid_t tid = iothr->thread_id;
+            char *key;
+
+            /* explicit pinning is a user decision we never override */
+            if (tid <= 0 || iothr->cpumask)
+                continue;
+
+            if (virProcessGetStatInfo(&cpuTime, NULL, NULL,
+                                      vm->pid, tid) < 0)
+                continue;
+
+            if (virAsprintf(&key, "%s/%u", uuidstr, iothr->iothread_id) < 0)
+                continue;
+
+            if ((sample = virHashLookup(samples, key))) {
+                unsigned long long pct = 0;
+
+                if (cpuTime > sample->cpuTime)
+                    pct = (cpuTime - sample->cpuTime) /
+                        (intervalMS * 10000ULL);
+
+                if (pct >= QEMU_IOTHREAD_BUSY_PCT)
+                    ignore_value(VIR_APPEND_ELEMENT(busy, nbusy, tid));
+                else if (pct <= QEMU_IOTHREAD_IDLE_PCT)
+                    ignore_value(VIR_APPEND_ELEMENT(idle, nidle, tid));
+
+                sample->cpuTime = cpuTime;
+                sample->generation = generation;
+            } else if (VIR_ALLOC(sample) == 0) {
+                sample->cpuTime = cpuTime;
+                sample->generation = generation;
+                if (virHashAddEntry(samples, key, sample) < 0)
+                    VIR_FREE(sample);
+            }
+
+            VIR_FREE(key);
+        }
+
+        virObjectUnlock(vm);
+    }
+
+    /* forget iothreads that disappeared with their domains */
+    ignore_value(virHashRemoveSet(samples, qemuIOThreadSamplePrune,
+                                  &generation));
+
+    if ((nbusy == 0 && nidle == 0) ||
+        (hostcpus = virHostCPUGetCount()) < 1 ||
+        !(map = virBitmapNew(hostcpus)))
+        goto cleanup;
+
+    for (i = 0; i < nbusy; i++) {
+        virBitmapClearAll(map);
+        ignore_value(virBitmapSetBit(map, i % hostcpus));
+        if (virProcessSetAffinity(busy[i], map) < 0)
+            virResetLastError();
+    }
+
+    virBitmapSetAll(map);
+    for (i = 0; i < nidle; i++) {
+        if (virProcessSetAffinity(idle[i], map) < 0)
+            virResetLastError();
+    }
+
+ cleanup:
+    virBitmapFree(map);
+    VIR_FREE(busy);
+    VIR_FREE(idle);
+    virObjectListFreeCount(vms, nvms);
+}
+
+
+static void
+qemuIOThreadSampleFree(void *payload,
+                       const void *name ATTRIBUTE_UNUSED)
+{
+    VIR_FREE(payload);
+}
+
+
+static void
+qemuIOThreadBalanceThread(void *opaque)
+{
+    virQEMUDriverPtr driver = opaque;
+    virHashTablePtr samples;
+    unsigned long long generation = 0;
+
+    if (!(samples = virHashCreate(64, qemuIOThreadSampleFree)))
+        return;
+
+    for (;;) {
+        virQEMUDriverConfigPtr cfg = virQEMUDriverGetConfig(driver);
+        unsigned long long interval = cfg->autoIOThreadInterval * 1000ULL;
+        unsigned long long then;
+        bool quit;
+
+        virObjectUnref(cfg);
+
+        ignore_value(virTimeMillisNow(&then));
+        then += interval;
+
+        virMutexLock(&driver->iothreadBalanceLock);
+        while (!driver->iothreadBalanceQuit &&
+               virCondWaitUntil(&driver->iothreadBalanceCond,
+                                &driver->iothreadBalanceLock, then) == 0)
+            ;
+        quit = driver->iothreadBalanceQuit;
+        virMutexUnlock(&driver->iothreadBalanceLock);
+
+        if (quit)
+            break;
+
+        generation++;
+        qemuIOThreadBalanceRun(driver, samples, generation, interval);
+    }
+
+    virHashFree(samples);
+}
+
+
+/* Re-probe capabilities of binaries which changed on disk since they
+ * were cached, so the first domain start after a QEMU upgrade doesn't
+ * pay for the probing. The probes run in background threads */
+static void
+qemuCapsCacheRefreshTimer(int timer ATTRIBUTE_UNUSED,
+                          void *opaque)
+{
+    virQEMUDriverPtr driver = opaque;
+    virCapsPtr caps;
 
-    if (vm->def->id > *driver_maxid)
-        *driver_maxid = vm->def->id;
+    if (!(caps = virQEMUDriverGetCapabilities(driver, false)))
+        return;
 
-    return 0;
+    virQEMUCapsCacheRevalidate(caps, driver->qemuCapsCache);
+    virObjectUnref(caps);
 }
 
 
@@ -643,6 +1259,7 @@ qemuStateInitialize(bool privileged,
     qemu_driver->inhibitOpaque = opaque;
 
     qemu_driver->privileged = privileged;
+    qemu_driver->qemuCapsRefreshTimer = -1;
 
     if (!(qemu_driver->domains = virDomainObjListNew()))
         goto error;
@@ -654,7 +1271,7 @@ qemuStateInitialize(bool privileged,
 
     /* read the host sysinfo */
     if (privileged)
-        qemu_driver->hostsysinfo = virSysinfoRead();
+        qemu_driver->hostsysinfo = virSysinfoReadCached();
 
     if (!(qemu_driver->config = cfg = virQEMUDriverConfigNew(privileged)))
         goto error;
@@ -845,6 +1462,12 @@ qemuStateInitialize(bool privileged,
     if ((qemu_driver->caps = virQEMUDriverCreateCapabilities(qemu_driver)) == NULL)
         goto error;
 
+    /* May fail when no event loop is registered (e.g. in tests); the
+     * stale entries are then simply re-probed on the next lookup */
+    qemu_driver->qemuCapsRefreshTimer =
+        virEventAddTimeout(QEMU_CAPS_CACHE_REFRESH_INTERVAL,
+                           qemuCapsCacheRefreshTimer, qemu_driver, NULL);
+
     if (!(qemu_driver->xmlopt = virQEMUDriverCreateXMLConf(qemu_driver)))
         goto error;
 
@@ -913,9 +1536,7 @@ qemuStateInitialize(bool privileged,
                                        NULL, NULL) < 0)
         goto error;
 
-    virDomainObjListForEach(qemu_driver->domains,
-                            qemuDomainSnapshotLoad,
-                            cfg->snapshotDir);
+    qemuDomainSnapshotLoadAll(qemu_driver, cfg->snapshotDir);
 
     virDomainObjListForEach(qemu_driver->domains,
                             qemuDomainManagedSaveLoad,
@@ -927,6 +1548,28 @@ qemuStateInitialize(bool privileged,
     if (!qemu_driver->workerPool)
         goto error;
 
+    if (cfg->autoBalloonInterval > 0) {
+        if (virMutexInit(&qemu_driver->balloonLock) < 0 ||
+            virCondInit(&qemu_driver->balloonCond) < 0 ||
+            virThreadCreate(&qemu_driver->balloonThread, true,
+                            qemuBalloonPolicyThread, qemu_driver) < 0) {
+            VIR_WARN("Unable to start automatic balloon policy thread");
+        } else {
+            qemu_driver->balloonThreadStarted = true;
+        }
+    }
+
+    if (cfg->autoIOThreadInterval > 0) {
+        if (virMutexInit(&qemu_driver->iothreadBalanceLock) < 0 ||
+            virCondInit(&qemu_driver->iothreadBalanceCond) < 0 ||
+            virThreadCreate(&qemu_driver->iothreadBalanceThread, true,
+                            qemuIOThreadBalanceThread, qemu_driver) < 0) {
+            VIR_WARN("Unable to start iothread balance policy thread");
+        } else {
+            qemu_driver->iothreadBalanceThreadStarted = true;
+        }
+    }
+
     virObjectUnref(conn);
 
     virNWFilterRegisterCallbackDriver(&qemuCallbackDriver);
@@ -1070,11 +1713,35 @@ qemuStateCleanup(void)
         return -1;
 
     virNWFilterUnRegisterCallbackDriver(&qemuCallbackDriver);
+
+    if (qemu_driver->balloonThreadStarted) {
+        virMutexLock(&qemu_driver->balloonLock);
+        qemu_driver->balloonQuit = true;
+        virCondSignal(&qemu_driver->balloonCond);
+        virMutexUnlock(&qemu_driver->balloonLock);
+        virThreadJoin(&qemu_driver->balloonThread);
+        virCondDestroy(&qemu_driver->balloonCond);
+        virMutexDestroy(&qemu_driver->balloonLock);
+    }
+
+    if (qemu_driver->iothreadBalanceThreadStarted) {
+        virMutexLock(&qemu_driver->iothreadBalanceLock);
+        qemu_driver->iothreadBalanceQuit = true;
+        virCondSignal(&qemu_driver->iothreadBalanceCond);
+        virMutexUnlock(&qemu_driver->iothreadBalanceLock);
+        virThreadJoin(&qemu_driver->iothreadBalanceThread);
+        virCondDestroy(&qemu_driver->iothreadBalanceCond);
+        virMutexDestroy(&qemu_driver->iothreadBalanceLock);
+    }
+
     virThreadPoolFree(qemu_driver->workerPool);
     virObjectUnref(qemu_driver->config);
     virObjectUnref(qemu_driver->hostdevMgr);
     virHashFree(qemu_driver->sharedDevices);
     virObjectUnref(qemu_driver->caps);
+    VIR_FREE(qemu_driver->capsTopology);
+    if (qemu_driver->qemuCapsRefreshTimer >= 0)
+        virEventRemoveTimeout(qemu_driver->qemuCapsRefreshTimer);
     virQEMUCapsCacheFree(qemu_driver->qemuCapsCache);
 
     virObjectUnref(qemu_driver->domains);
@@ -1388,67 +2055,6 @@ qemuGetSchedInfo(unsigned long long *cpuWait,
 }
 
 
-static int
-qemuGetProcessInfo(unsigned long long *cpuTime, int *lastCpu, long *vm_rss,
-                   pid_t pid, int tid)
-{
-    char *proc;
-    FILE *pidinfo;
-    unsigned long long usertime = 0, systime = 0;
-    long rss = 0;
-    int cpu = 0;
-    int ret;
-
-    /* In general, we cannot assume pid_t fits in int; but /proc parsing
-     * is specific to Linux where int works fine.  */
-    if (tid)
-        ret = virAsprintf(&proc, "/proc/%d/task/%d/stat", (int) pid, tid);
-    else
-        ret = virAsprintf(&proc, "/proc/%d/stat", (int) pid);
-    if (ret < 0)
-        return -1;
-
-    pidinfo = fopen(proc, "r");
-    VIR_FREE(proc);
-
-    /* See 'man proc' for information about what all these fields are. We're
-     * only interested in a very few of them */
-    if (!pidinfo ||
-        fscanf(pidinfo,
-               /* pid -> stime */
-               "%*d (%*[^)]) %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu"
-               /* cutime -> endcode */
-               "%*d %*d %*d %*d %*d %*d %*u %*u %ld %*u %*u %*u"
-               /* startstack -> processor */
-               "%*u %*u %*u %*u %*u %*u %*u %*u %*u %*u %*d %d",
-               &usertime, &systime, &rss, &cpu) != 4) {
-        VIR_WARN("cannot parse process status data");
-    }
-
-    /* We got jiffies
-     * We want nanoseconds
-     * _SC_CLK_TCK is jiffies per second
-     * So calculate thus....
-     */
-    if (cpuTime)
-        *cpuTime = 1000ull * 1000ull * 1000ull * (usertime + systime)
-            / (unsigned long long)sysconf(_SC_CLK_TCK);
-    if (lastCpu)
-        *lastCpu = cpu;
-
-    if (vm_rss)
-        *vm_rss = rss * virGetSystemPageSizeKB();
-
-
-    VIR_DEBUG("Got status for %d/%d user=%llu sys=%llu cpu=%d rss=%ld",
-              (int) pid, tid, usertime, systime, cpu, rss);
-
-    VIR_FORCE_FCLOSE(pidinfo);
-
-    return 0;
-}
-
-
 static int
 qemuDomainHelperGetVcpus(virDomainObjPtr vm,
                          virVcpuInfoPtr info,
@@ -1491,9 +2097,9 @@ qemuDomainHelperGetVcpus(virDomainObjPtr vm,
             vcpuinfo->number = i;
             vcpuinfo->state = VIR_VCPU_RUNNING;
 
-            if (qemuGetProcessInfo(&vcpuinfo->cpuTime,
-                                   &vcpuinfo->cpu, NULL,
-                                   vm->pid, vcpupid) < 0) {
+            if (virProcessGetStatInfo(&vcpuinfo->cpuTime,
+                                      &vcpuinfo->cpu, NULL,
+                                      vm->pid, vcpupid) < 0) {
                 virReportSystemError(errno, "%s",
                                      _("cannot get vCPU placement & pCPU time"));
                 return -1;
@@ -2652,7 +3258,8 @@ qemuDomainGetInfo(virDomainPtr dom,
     }
 
     if (virDomainObjIsActive(vm)) {
-        if (qemuGetProcessInfo(&(info->cpuTime), NULL, NULL, vm->pid, 0) < 0) {
+        if (virProcessGetStatInfo(&(info->cpuTime), NULL, NULL,
+                                  vm->pid, 0) < 0) {
             virReportError(VIR_ERR_OPERATION_FAILED, "%s",
                            _("cannot read cputime for domain"));
             goto cleanup;
@@ -4510,7 +5117,7 @@ processBlockJobEvent(virQEMUDriverPtr driver,
     }
 
     if ((disk = qemuProcessFindDomainDiskByAlias(vm, diskAlias)))
-        qemuBlockJobEventProcess(driver, vm, disk, type, status);
+        qemuBlockJobEventProcess(driver, vm, disk, type, status, NULL);
 
  endjob:
     qemuDomainObjEndJob(driver, vm);
@@ -6572,6 +7179,102 @@ qemuDomainSaveImageOpen(virQEMUDriverPtr driver,
     return -1;
 }
 
+#if HAVE_POSIX_FADVISE
+
+/* How far ahead of QEMU's current read position the image is staged
+ * into the page cache. The kernel merges overlapping requests, so a
+ * generous fixed window works across storage types. */
+# define QEMU_SAVE_IMAGE_PREFETCH_WINDOW (64ULL * 1024 * 1024)
+
+struct qemuSaveImagePrefetchData {
+    virThread thread;
+    int fd;          /* dup of the image fd, shares the file offset */
+    virMutex lock;
+    virCond cond;
+    bool quit;
+};
+
+static void
+qemuSaveImagePrefetchWorker(void *opaque)
+{
+    struct qemuSaveImagePrefetchData *data = opaque;
+    off_t done = -1;
+
+    ignore_value(posix_fadvise(data->fd, 0, 0, POSIX_FADV_SEQUENTIAL));
+
+    virMutexLock(&data->lock);
+    while (!data->quit) {
+        off_t pos;
+        unsigned long long now;
+
+        /* the reader advances the shared file offset, so lseek tells
+         * us how far QEMU (or the decompressor) has got */
+        if ((pos = lseek(data->fd, 0, SEEK_CUR)) < 0)
+            break;
+
+        if (pos + (off_t)QEMU_SAVE_IMAGE_PREFETCH_WINDOW != done) {
+            ignore_value(posix_fadvise(data->fd, pos,
+                                       QEMU_SAVE_IMAGE_PREFETCH_WINDOW,
+                                       POSIX_FADV_WILLNEED));
+            done = pos + QEMU_SAVE_IMAGE_PREFETCH_WINDOW;
+        }
+
+        if (virTimeMillisNow(&now) < 0)
+            break;
+        while (!data->quit &&
+               virCondWaitUntil(&data->cond, &data->lock, now + 100) == 0)
+            ;
+    }
+    virMutexUnlock(&data->lock);
+}
+
+static bool
+qemuSaveImagePrefetchStart(struct qemuSaveImagePrefetchData *data,
+                           int fd)
+{
+    if ((data->fd = dup(fd)) < 0)
+        return false;
+
+    /* a bypass-cache restore hands us the pipe from the I/O helper;
+     * there is nothing to prefetch through a pipe */
+    if (lseek(data->fd, 0, SEEK_CUR) < 0)
+        goto error;
+
+    if (virMutexInit(&data->lock) < 0)
+        goto error;
+    if (virCondInit(&data->cond) < 0) {
+        virMutexDestroy(&data->lock);
+        goto error;
+    }
+    data->quit = false;
+    if (virThreadCreate(&data->thread, true,
+                        qemuSaveImagePrefetchWorker, data) < 0) {
+        virCondDestroy(&data->cond);
+        virMutexDestroy(&data->lock);
+        goto error;
+    }
+    return true;
+
+ error:
+    VIR_FORCE_CLOSE(data->fd);
+    return false;
+}
+
+static void
+qemuSaveImagePrefetchStop(struct qemuSaveImagePrefetchData *data)
+{
+    virMutexLock(&data->lock);
+    data->quit = true;
+    virCondSignal(&data->cond);
+    virMutexUnlock(&data->lock);
+    virThreadJoin(&data->thread);
+    virCondDestroy(&data->cond);
+    virMutexDestroy(&data->lock);
+    VIR_FORCE_CLOSE(data->fd);
+}
+
+#endif /* HAVE_POSIX_FADVISE */
+
 static int ATTRIBUTE_NONNULL(4) ATTRIBUTE_NONNULL(5) ATTRIBUTE_NONNULL(6)
 qemuDomainSaveImageStartVM(virConnectPtr conn,
                            virQEMUDriverPtr driver,
@@ -6589,6 +7292,15 @@ qemuDomainSaveImageStartVM(virConnectPtr conn,
     virCommandPtr cmd = NULL;
     char *errbuf = NULL;
     virQEMUDriverConfigPtr cfg = virQEMUDriverGetConfig(driver);
+#if HAVE_POSIX_FADVISE
+    struct qemuSaveImagePrefetchData prefetch = { .fd = -1 };
+    bool prefetching;
+
+    /* Keep a window of the image staged in the page cache ahead of
+     * the consumer so reads off slow or remote storage overlap with
+     * QEMU loading the guest */
+    prefetching = qemuSaveImagePrefetchStart(&prefetch, *fd);
+#endif
 
     if ((header->version == 2) &&
         (header->compressed != QEMU_SAVE_FORMAT_RAW)) {
@@ -6680,6 +7392,10 @@ qemuDomainSaveImageStartVM(virConnectPtr conn,
     ret = 0;
 
  cleanup:
+#if HAVE_POSIX_FADVISE
+    if (prefetching)
+        qemuSaveImagePrefetchStop(&prefetch);
+#endif
     virCommandFree(cmd);
     VIR_FREE(errbuf);
     if (virSecurityManagerRestoreSavedStateLabel(driver->securityManager,
@@ -8285,6 +9001,156 @@ qemuDomainUpdateDeviceConfig(virDomainDefPtr vmdef,
     return 0;
 }
 
+/* Attach every child element of a <devices> document as one
+ * transaction: a single working copy of the persistent definition,
+ * one status file write at the end, and rollback of the devices
+ * already plugged in when a later one fails. */
+static int
+qemuDomainAttachDeviceListLiveAndConfig(virConnectPtr conn,
+                                        virDomainObjPtr vm,
+                                        virQEMUDriverPtr driver,
+                                        xmlDocPtr doc,
+                                        unsigned int flags)
+{
+    qemuDomainObjPrivatePtr priv = vm->privateData;
+    virQEMUDriverConfigPtr cfg = NULL;
+    virCapsPtr caps = NULL;
+    virDomainDefPtr vmdef = NULL;
+    char **devxml = NULL;
+    size_t ndev = 0;
+    size_t nlive = 0; /* devices attached to the live guest so far */
+    xmlNodePtr node;
+    size_t i;
+    int ret = -1;
+    unsigned int parse_flags = VIR_DOMAIN_DEF_PARSE_INACTIVE |
+                               VIR_DOMAIN_DEF_PARSE_ABI_UPDATE;
+
+    virCheckFlags(VIR_DOMAIN_AFFECT_LIVE |
+                  VIR_DOMAIN_AFFECT_CONFIG, -1);
+
+    cfg = virQEMUDriverGetConfig(driver);
+
+    if (!(caps = virQEMUDriverGetCapabilities(driver, false)))
+        goto cleanup;
+
+    /* The per-device attach code wants one XML snippet per device */
+    for (node = xmlDocGetRootElement(doc)->children; node; node = node->next) {
+        char *one;
+
+        if (node->type != XML_ELEMENT_NODE)
+            continue;
+        if (!(one = virXMLNodeToString(doc, node)))
+            goto cleanup;
+        if (VIR_APPEND_ELEMENT(devxml, ndev, one) < 0) {
+            VIR_FREE(one);
+            goto cleanup;
+        }
+    }
+
+    if (ndev == 0) {
+        virReportError(VIR_ERR_XML_ERROR, "%s",
+                       _("no devices found in the device list"));
+        goto cleanup;
+    }
+
+    /* All config changes go to one working copy, which replaces the
+     * persistent definition only once every device has applied */
+    if (flags & VIR_DOMAIN_AFFECT_CONFIG) {
+        if (!(vmdef = virDomainObjCopyPersistentDef(vm, caps, driver->xmlopt,
+                                                    priv->qemuCaps)))
+            goto cleanup;
+
+        for (i = 0; i < ndev; i++) {
+            virDomainDeviceDefPtr dev;
+            int rc;
+
+            if (!(dev = virDomainDeviceDefParse(devxml[i], vm->def, caps,
+                                                driver->xmlopt, parse_flags)))
+                goto cleanup;
+
+            rc = virDomainDefCompatibleDevice(vmdef, dev,
+                                              VIR_DOMAIN_DEVICE_ACTION_ATTACH);
+            if (rc == 0)
+                rc = qemuDomainAttachDeviceConfig(vmdef, dev, conn, caps,
+                                                  parse_flags, driver->xmlopt);
+            virDomainDeviceDefFree(dev);
+            if (rc < 0)
+                goto cleanup;
+        }
+    }
+
+    if (flags & VIR_DOMAIN_AFFECT_LIVE) {
+        for (nlive = 0; nlive < ndev; nlive++) {
+            virDomainDeviceDefPtr dev;
+            int rc = -1;
+
+            if ((dev = virDomainDeviceDefParse(devxml[nlive], vm->def, caps,
+                                               driver->xmlopt, parse_flags))) {
+                rc = virDomainDefCompatibleDevice(vm->def, dev,
+                                                  VIR_DOMAIN_DEVICE_ACTION_ATTACH);
+                if (rc == 0)
+                    rc = qemuDomainAttachDeviceLive(vm, dev, conn, driver);
+                virDomainDeviceDefFree(dev);
+            }
+            if (rc < 0)
+                break;
+        }
+
+        if (nlive < ndev) {
+            /* Unplug what already made it in, so a partial failure
+             * leaves the guest as it was. Best effort: the guest may
+             * hold on to a device, which is logged but cannot be
+             * undone. */
+            virErrorPtr orig_err = virSaveLastError();
+
+            while (nlive--) {
+                virDomainDeviceDefPtr dev;
+
+                if (!(dev = virDomainDeviceDefParse(devxml[nlive], vm->def,
+                                                    caps, driver->xmlopt,
+                                                    parse_flags)) ||
+                    qemuDomainDetachDeviceLive(vm, dev, driver) < 0)
+                    VIR_WARN("cannot roll back attach of device %zu on domain %s",
+                             nlive, vm->def->name);
+                virDomainDeviceDefFree(dev);
+            }
+
+            if (orig_err) {
+                virSetError(orig_err);
+                virFreeError(orig_err);
+            }
+
+            ignore_value(virDomainSaveStatus(driver->xmlopt, cfg->stateDir,
+                                             vm, driver->caps));
+            goto cleanup;
+        }
+
+        /* one status write covers the whole batch */
+        if (virDomainSaveStatus(driver->xmlopt, cfg->stateDir, vm,
+                                driver->caps) < 0)
+            goto cleanup;
+    }
+
+    if (flags & VIR_DOMAIN_AFFECT_CONFIG) {
+        if (virDomainSaveConfig(cfg->configDir, driver->caps, vmdef) < 0)
+            goto cleanup;
+        virDomainObjAssignDef(vm, vmdef, false, NULL);
+        vmdef = NULL;
+    }
+
+    ret = 0;
+
+ cleanup:
+    virDomainDefFree(vmdef);
+    for (i = 0; i < ndev; i++)
+        VIR_FREE(devxml[i]);
+    VIR_FREE(devxml);
+    virObjectUnref(cfg);
+    virObjectUnref(caps);
+
+    return ret;
+}
+
 static int
 qemuDomainAttachDeviceLiveAndConfig(virConnectPtr conn,
                                     virDomainObjPtr vm,
@@ -8292,9 +9158,12 @@ qemuDomainAttachDeviceLiveAndConfig(virConnectPtr conn,
                                     const char *xml,
                                     unsigned int flags)
 {
+    qemuDomainObjPrivatePtr priv = vm->privateData;
     virDomainDefPtr vmdef = NULL;
     virQEMUDriverConfigPtr cfg = NULL;
     virDomainDeviceDefPtr dev = NULL, dev_copy = NULL;
+    xmlDocPtr doc = NULL;
+    xmlXPathContextPtr ctxt = NULL;
     int ret = -1;
     virCapsPtr caps = NULL;
     unsigned int parse_flags = VIR_DOMAIN_DEF_PARSE_INACTIVE |
@@ -8303,6 +9172,19 @@ qemuDomainAttachDeviceLiveAndConfig(virConnectPtr conn,
     virCheckFlags(VIR_DOMAIN_AFFECT_LIVE |
                   VIR_DOMAIN_AFFECT_CONFIG, -1);
 
+    /* A document rooted at <devices> attaches each child device as
+     * one transaction under the job the caller already holds */
+    if ((doc = virXMLParseStringCtxt(xml, _("(device_definition)"), &ctxt)) &&
+        xmlStrEqual(xmlDocGetRootElement(doc)->name, BAD_CAST "devices")) {
+        ret = qemuDomainAttachDeviceListLiveAndConfig(conn, vm, driver,
+                                                      doc, flags);
+        xmlXPathFreeContext(ctxt);
+        xmlFreeDoc(doc);
+        return ret;
+    }
+    if (!doc)
+        return -1;
+
     cfg = virQEMUDriverGetConfig(driver);
 
     if (!(caps = virQEMUDriverGetCapabilities(driver, false)))
@@ -8327,7 +9209,8 @@ qemuDomainAttachDeviceLiveAndConfig(virConnectPtr conn,
 
     if (flags & VIR_DOMAIN_AFFECT_CONFIG) {
         /* Make a copy for updated domain. */
-        vmdef = virDomainObjCopyPersistentDef(vm, caps, driver->xmlopt);
+        vmdef = virDomainObjCopyPersistentDef(vm, caps, driver->xmlopt,
+                                              priv->qemuCaps);
         if (!vmdef)
             goto cleanup;
 
@@ -8372,6 +9255,8 @@ qemuDomainAttachDeviceLiveAndConfig(virConnectPtr conn,
     if (dev != dev_copy)
         virDomainDeviceDefFree(dev_copy);
     virDomainDeviceDefFree(dev);
+    xmlXPathFreeContext(ctxt);
+    xmlFreeDoc(doc);
     virObjectUnref(cfg);
     virObjectUnref(caps);
 
@@ -8488,7 +9373,8 @@ static int qemuDomainUpdateDeviceFlags(virDomainPtr dom,
 
     if (flags & VIR_DOMAIN_AFFECT_CONFIG) {
         /* Make a copy for updated domain. */
-        vmdef = virDomainObjCopyPersistentDef(vm, caps, driver->xmlopt);
+        vmdef = virDomainObjCopyPersistentDef(vm, caps, driver->xmlopt,
+                                              qemuCaps);
         if (!vmdef)
             goto endjob;
 
@@ -8551,6 +9437,7 @@ qemuDomainDetachDeviceLiveAndConfig(virQEMUDriverPtr driver,
                                     const char *xml,
                                     unsigned int flags)
 {
+    qemuDomainObjPrivatePtr priv = vm->privateData;
     virCapsPtr caps = NULL;
     virQEMUDriverConfigPtr cfg = NULL;
     virDomainDeviceDefPtr dev = NULL, dev_copy = NULL;
@@ -8589,7 +9476,8 @@ qemuDomainDetachDeviceLiveAndConfig(virQEMUDriverPtr driver,
 
     if (flags & VIR_DOMAIN_AFFECT_CONFIG) {
         /* Make a copy for updated domain. */
-        vmdef = virDomainObjCopyPersistentDef(vm, caps, driver->xmlopt);
+        vmdef = virDomainObjCopyPersistentDef(vm, caps, driver->xmlopt,
+                                              priv->qemuCaps);
         if (!vmdef)
             goto cleanup;
 
@@ -10160,7 +11048,8 @@ qemuDomainSetSchedulerParametersFlags(virDomainPtr dom,
     if (persistentDef) {
         /* Make a copy for updated domain. */
         if (!(persistentDefCopy = virDomainObjCopyPersistentDef(vm, caps,
-                                                                driver->xmlopt)))
+                                                                driver->xmlopt,
+                                                                priv->qemuCaps)))
             goto endjob;
     }
 
@@ -11350,7 +12239,7 @@ qemuDomainMemoryStatsInternal(virQEMUDriverPtr driver,
         ret = 0;
     }
 
-    if (qemuGetProcessInfo(NULL, NULL, &rss, vm->pid, 0) < 0) {
+    if (virProcessGetStatInfo(NULL, NULL, &rss, vm->pid, 0) < 0) {
         virReportError(VIR_ERR_OPERATION_FAILED, "%s",
                        _("cannot get RSS for domain"));
     } else {
@@ -11736,11 +12625,8 @@ qemuDomainGetBlockInfo(virDomainPtr dom,
     }
 
     qemuDomainObjEnterMonitor(driver, vm);
-    rc = qemuMonitorGetAllBlockStatsInfo(qemuDomainGetMonitor(vm),
-                                         &stats, false);
-    if (rc >= 0)
-        rc = qemuMonitorBlockStatsUpdateCapacity(qemuDomainGetMonitor(vm),
-                                                 stats, false);
+    rc = qemuMonitorGetAllBlockStatsAndCapacity(qemuDomainGetMonitor(vm),
+                                                &stats, false);
 
     if (qemuDomainObjExitMonitor(driver, vm) < 0 || rc < 0)
         goto endjob;
@@ -14817,10 +15703,7 @@ qemuDomainSnapshotCreateXML(virDomainPtr domain,
                 vm->current_snapshot = snap;
             other = virDomainSnapshotFindByName(vm->snapshots,
                                                 snap->def->parent);
-            snap->parent = other;
-            other->nchildren++;
-            snap->sibling = other->first_child;
-            other->first_child = snap;
+            virDomainSnapshotSetParent(snap, other);
         }
     } else if (snap) {
         virDomainSnapshotObjListRemove(vm->snapshots, snap);
@@ -15722,11 +16605,13 @@ qemuDomainSnapshotDelete(virDomainSnapshotPtr snapshot,
         snap->parent->nchildren += snap->nchildren;
         rep.last->sibling = snap->parent->first_child;
         snap->parent->first_child = snap->first_child;
+        /* The descendants now hang off the parent directly, so only
+         * snap itself is subtracted when it drops off below.  */
+        snap->ndescendants = 0;
     }
 
     if (flags & VIR_DOMAIN_SNAPSHOT_DELETE_CHILDREN_ONLY) {
-        snap->nchildren = 0;
-        snap->first_child = NULL;
+        virDomainSnapshotDropChildren(snap);
         ret = 0;
     } else {
         virDomainSnapshotDropParent(snap);
@@ -16374,23 +17259,23 @@ qemuDomainBlockJobAbort(virDomainPtr dom,
              * the rest as usual */
             qemuBlockJobEventProcess(driver, vm, disk,
                                      VIR_DOMAIN_BLOCK_JOB_TYPE_PULL,
-                                     VIR_DOMAIN_BLOCK_JOB_CANCELED);
+                                     VIR_DOMAIN_BLOCK_JOB_CANCELED, NULL);
         } else {
             qemuDomainDiskPrivatePtr diskPriv = QEMU_DOMAIN_DISK_PRIVATE(disk);
-            qemuBlockJobUpdate(driver, vm, disk);
+            qemuBlockJobUpdate(driver, vm, disk, NULL);
             while (diskPriv->blockjob) {
                 if (virDomainObjWait(vm) < 0) {
                     ret = -1;
                     goto endjob;
                 }
-                qemuBlockJobUpdate(driver, vm, disk);
+                qemuBlockJobUpdate(driver, vm, disk, NULL);
             }
         }
     }
 
  endjob:
     if (disk)
-        qemuBlockJobSyncEnd(driver, vm, disk);
+        qemuBlockJobSyncEnd(driver, vm, disk, NULL);
     qemuDomainObjEndJob(driver, vm);
 
  cleanup:
@@ -17153,8 +18038,16 @@ qemuDomainBlockCommit(virDomainPtr dom,
         goto endjob;
     }
 
-    if (ret == 0)
+    if (ret == 0) {
         QEMU_DOMAIN_DISK_PRIVATE(disk)->blockjob = true;
+        /* Remember which links the commit will remove, so that the
+         * completion handler can splice the chain in place rather
+         * than reprobing every image */
+        if (!mirror) {
+            QEMU_DOMAIN_DISK_PRIVATE(disk)->commitTop = topSource;
+            QEMU_DOMAIN_DISK_PRIVATE(disk)->commitBase = baseSource;
+        }
+    }
 
     if (mirror) {
         if (ret == 0) {
@@ -19342,11 +20235,8 @@ qemuDomainGetStatsBlock(virQEMUDriverPtr driver,
 
     if (HAVE_JOB(privflags) && virDomainObjIsActive(dom)) {
         qemuDomainObjEnterMonitor(driver, dom);
-        rc = qemuMonitorGetAllBlockStatsInfo(priv->mon, &stats,
-                                             visitBacking);
-        if (rc >= 0)
-            ignore_value(qemuMonitorBlockStatsUpdateCapacity(priv->mon, stats,
-                                                             visitBacking));
+        rc = qemuMonitorGetAllBlockStatsAndCapacity(priv->mon, &stats,
+                                                    visitBacking);
         if (qemuDomainObjExitMonitor(driver, dom) < 0)
             goto cleanup;
 
@@ -19394,31 +20284,6 @@ qemuDomainGetStatsBlock(virQEMUDriverPtr driver,
 
 #undef QEMU_ADD_COUNT_PARAM
 
-static int
-qemuDomainGetStatsPerfOneEvent(virPerfPtr perf,
-                               virPerfEventType type,
-                               virDomainStatsRecordPtr record,
-                               int *maxparams)
-{
-    char param_name[VIR_TYPED_PARAM_FIELD_LENGTH];
-    uint64_t value = 0;
-
-    if (virPerfReadEvent(perf, type, &value) < 0)
-        return -1;
-
-    snprintf(param_name, VIR_TYPED_PARAM_FIELD_LENGTH, "perf.%s",
-             virPerfEventTypeToString(type));
-
-    if (virTypedParamsAddULLong(&record->params,
-                                &record->nparams,
-                                maxparams,
-                                param_name,
-                                value) < 0)
-        return -1;
-
-    return 0;
-}
-
 static int
 qemuDomainGetStatsPerf(virQEMUDriverPtr driver ATTRIBUTE_UNUSED,
                        virDomainObjPtr dom,
@@ -19428,14 +20293,27 @@ qemuDomainGetStatsPerf(virQEMUDriverPtr driver ATTRIBUTE_UNUSED,
 {
     size_t i;
     qemuDomainObjPrivatePtr priv = dom->privateData;
+    char param_name[VIR_TYPED_PARAM_FIELD_LENGTH];
+    uint64_t values[VIR_PERF_EVENT_LAST];
+    bool have[VIR_PERF_EVENT_LAST];
     int ret = -1;
 
+    /* counters grouped on one PMU are all fetched with one syscall */
+    if (virPerfReadEvents(priv->perf, values, have) < 0)
+        goto cleanup;
+
     for (i = 0; i < VIR_PERF_EVENT_LAST; i++) {
-        if (!virPerfEventIsEnabled(priv->perf, i))
-             continue;
+        if (!have[i])
+            continue;
 
-        if (qemuDomainGetStatsPerfOneEvent(priv->perf, i,
-                                           record, maxparams) < 0)
+        snprintf(param_name, VIR_TYPED_PARAM_FIELD_LENGTH, "perf.%s",
+                 virPerfEventTypeToString(i));
+
+        if (virTypedParamsAddULLong(&record->params,
+                                    &record->nparams,
+                                    maxparams,
+                                    param_name,
+                                    values[i]) < 0)
             goto cleanup;
     }
 
@@ -19552,6 +20430,67 @@ qemuDomainGetStats(virConnectPtr conn,
 }
 
 
+struct qemuConnectGetAllDomainStatsData {
+    virMutex lock;
+    virConnectPtr conn;
+    virQEMUDriverPtr driver;
+    virDomainObjPtr *vms;
+    size_t nvms;
+    size_t next;
+    unsigned int stats;
+    unsigned int flags;
+    unsigned int privflags;
+    virDomainStatsRecordPtr *records;
+    virErrorPtr err;
+};
+
+
+static void
+qemuConnectGetAllDomainStatsWorker(void *opaque)
+{
+    struct qemuConnectGetAllDomainStatsData *data = opaque;
+
+    for (;;) {
+        size_t i;
+        virDomainObjPtr vm;
+        unsigned int domflags = 0;
+
+        virMutexLock(&data->lock);
+        i = data->next++;
+        virMutexUnlock(&data->lock);
+
+        if (i >= data->nvms)
+            break;
+
+        vm = data->vms[i];
+
+        virObjectLock(vm);
+
+        if (HAVE_JOB(data->privflags) &&
+            qemuDomainObjBeginJob(data->driver, vm, QEMU_JOB_QUERY) == 0)
+            domflags |= QEMU_DOMAIN_STATS_HAVE_JOB;
+        /* else: without a job it's still possible to gather some data */
+
+        if (data->flags & VIR_CONNECT_GET_ALL_DOMAINS_STATS_BACKING)
+            domflags |= QEMU_DOMAIN_STATS_BACKING;
+
+        if (qemuDomainGetStats(data->conn, vm, data->stats,
+                               &data->records[i], domflags) < 0) {
+            virMutexLock(&data->lock);
+            if (!data->err)
+                data->err = virSaveLastError();
+            virMutexUnlock(&data->lock);
+            virResetLastError();
+        }
+
+        if (HAVE_JOB(domflags))
+            qemuDomainObjEndJob(data->driver, vm);
+
+        virObjectUnlock(vm);
+    }
+}
+
+
 static int
 qemuConnectGetAllDomainStats(virConnectPtr conn,
                              virDomainPtr *doms,
@@ -19562,15 +20501,17 @@ qemuConnectGetAllDomainStats(virConnectPtr conn,
 {
     virQEMUDriverPtr driver = conn->privateData;
     virDomainObjPtr *vms = NULL;
-    virDomainObjPtr vm;
     size_t nvms;
     virDomainStatsRecordPtr *tmpstats = NULL;
     bool enforce = !!(flags & VIR_CONNECT_GET_ALL_DOMAINS_STATS_ENFORCE_STATS);
     int nstats = 0;
     size_t i;
     int ret = -1;
-    unsigned int privflags = 0;
-    unsigned int domflags = 0;
+    int hostcpus;
+    size_t nworkers;
+    size_t nspawned = 0;
+    virThreadPtr workers = NULL;
+    struct qemuConnectGetAllDomainStatsData data = { .next = 0 };
     unsigned int lflags = flags & (VIR_CONNECT_LIST_DOMAINS_FILTERS_ACTIVE |
                                    VIR_CONNECT_LIST_DOMAINS_FILTERS_PERSISTENT |
                                    VIR_CONNECT_LIST_DOMAINS_FILTERS_STATE);
@@ -19599,41 +20540,66 @@ qemuConnectGetAllDomainStats(virConnectPtr conn,
             return -1;
     }
 
-    if (VIR_ALLOC_N(tmpstats, nvms + 1) < 0)
+    if (virMutexInit(&data.lock) < 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("cannot initialize mutex"));
+        virObjectListFreeCount(vms, nvms);
         return -1;
+    }
 
-    if (qemuDomainGetStatsNeedMonitor(stats))
-        privflags |= QEMU_DOMAIN_STATS_HAVE_JOB;
+    if (VIR_ALLOC_N(tmpstats, nvms + 1) < 0 ||
+        VIR_ALLOC_N(data.records, nvms) < 0)
+        goto cleanup;
 
-    for (i = 0; i < nvms; i++) {
-        virDomainStatsRecordPtr tmp = NULL;
-        domflags = 0;
-        vm = vms[i];
+    if (qemuDomainGetStatsNeedMonitor(stats))
+        data.privflags |= QEMU_DOMAIN_STATS_HAVE_JOB;
+
+    data.conn = conn;
+    data.driver = driver;
+    data.vms = vms;
+    data.nvms = nvms;
+    data.stats = stats;
+    data.flags = flags;
+
+    /* Process the domains from a small worker pool; a stats query may
+     * spend most of its time waiting for a domain's job lock or its
+     * monitor, and waiting on all domains at once beats doing so one
+     * domain at a time. */
+    if ((hostcpus = virHostCPUGetCount()) < 1)
+        hostcpus = 1;
+    nworkers = hostcpus;
+    if (nworkers > nvms)
+        nworkers = nvms;
+
+    if (nworkers > 1 &&
+        VIR_ALLOC_N(workers, nworkers - 1) < 0)
+        nworkers = 1;
+
+    for (i = 0; nvms && i < nworkers - 1; i++) {
+        if (virThreadCreate(&workers[i], true,
+                            qemuConnectGetAllDomainStatsWorker, &data) < 0)
+            break;
+        nspawned++;
+    }
 
-        virObjectLock(vm);
+    /* this thread also collects stats, and handles everything when no
+     * worker could be spawned */
+    if (nvms)
+        qemuConnectGetAllDomainStatsWorker(&data);
 
-        if (HAVE_JOB(privflags) &&
-            qemuDomainObjBeginJob(driver, vm, QEMU_JOB_QUERY) == 0)
-            domflags |= QEMU_DOMAIN_STATS_HAVE_JOB;
-        /* else: without a job it's still possible to gather some data */
+    for (i = 0; i < nspawned; i++)
+        virThreadJoin(&workers[i]);
 
-        if (flags & VIR_CONNECT_GET_ALL_DOMAINS_STATS_BACKING)
-            domflags |= QEMU_DOMAIN_STATS_BACKING;
-        if (qemuDomainGetStats(conn, vm, stats, &tmp, domflags) < 0) {
-            if (HAVE_JOB(domflags) && vm)
-                qemuDomainObjEndJob(driver, vm);
+    if (data.err) {
+        virSetError(data.err);
+        goto cleanup;
+    }
 
-            virObjectUnlock(vm);
-            goto cleanup;
+    for (i = 0; i < nvms; i++) {
+        if (data.records[i]) {
+            tmpstats[nstats++] = data.records[i];
+            data.records[i] = NULL;
         }
-
-        if (tmp)
-            tmpstats[nstats++] = tmp;
-
-        if (HAVE_JOB(domflags))
-            qemuDomainObjEndJob(driver, vm);
-
-        virObjectUnlock(vm);
     }
 
     *retStats = tmpstats;
@@ -19642,8 +20608,22 @@ qemuConnectGetAllDomainStats(virConnectPtr conn,
     ret = nstats;
 
  cleanup:
+    if (data.records) {
+        for (i = 0; i < nvms; i++) {
+            if (data.records[i]) {
+                virTypedParamsFree(data.records[i]->params,
+                                   data.records[i]->nparams);
+                virDomainFree(data.records[i]->dom);
+                VIR_FREE(data.records[i]);
+            }
+        }
+        VIR_FREE(data.records);
+    }
+    virFreeError(data.err);
+    VIR_FREE(workers);
     virDomainStatsRecordListFree(tmpstats);
     virObjectListFreeCount(vms, nvms);
+    virMutexDestroy(&data.lock);
 
     return ret;
 }
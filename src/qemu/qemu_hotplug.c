@@ -397,11 +397,8 @@ qemuDomainAttachVirtioDiskDevice(virConnectPtr conn,
         encobjAdded = true;
     }
 
-    if (qemuMonitorAddDrive(priv->mon, drivestr) < 0)
-        goto exit_monitor;
-    driveAdded = true;
-
-    if (qemuMonitorAddDevice(priv->mon, devstr) < 0)
+    if (qemuMonitorAddDriveAndDevice(priv->mon, drivestr, devstr,
+                                     &driveAdded) < 0)
         goto exit_monitor;
 
     if (qemuDomainObjExitMonitor(driver, vm) < 0) {
@@ -407,6 +407,30 @@ qemuMigrationCookieNetworkAlloc(virQEMUDriverPtr driver ATTRIBUTE_UNUSED,
     return NULL;
 }
 
+/* Every cookie bake and eat wants the canonical local hostname, and
+ * resolving it can go through getaddrinfo; with up to five cookie
+ * exchanges per migration that lookup dominates cookie handling when
+ * hundreds of domains are evacuated. Resolve hostname and host UUID
+ * once; a hostname change while the daemon runs needs a restart to
+ * be picked up, which migrations in flight could not tolerate
+ * anyway. */
+static virOnceControl qemuMigrationCookieHostOnce = VIR_ONCE_CONTROL_INITIALIZER;
+static char *qemuMigrationCookieHostname;
+static unsigned char qemuMigrationCookieHostuuid[VIR_UUID_BUFLEN];
+static bool qemuMigrationCookieHostReady;
+
+static void
+qemuMigrationCookieHostInit(void)
+{
+    if (!(qemuMigrationCookieHostname = virGetHostname()))
+        return;
+    if (virGetHostUUID(qemuMigrationCookieHostuuid) < 0) {
+        VIR_FREE(qemuMigrationCookieHostname);
+        return;
+    }
+    qemuMigrationCookieHostReady = true;
+}
+
 static qemuMigrationCookiePtr
 qemuMigrationCookieNew(virDomainObjPtr dom)
 {
@@ -425,13 +449,15 @@ qemuMigrationCookieNew(virDomainObjPtr dom)
         goto error;
     memcpy(mig->uuid, dom->def->uuid, VIR_UUID_BUFLEN);
 
-    if (!(mig->localHostname = virGetHostname()))
-        goto error;
-    if (virGetHostUUID(mig->localHostuuid) < 0) {
+    if (virOnce(&qemuMigrationCookieHostOnce, qemuMigrationCookieHostInit) < 0 ||
+        !qemuMigrationCookieHostReady) {
         virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
-                       _("Unable to obtain host UUID"));
+                       _("Unable to obtain host name or UUID"));
         goto error;
     }
+    if (VIR_STRDUP(mig->localHostname, qemuMigrationCookieHostname) < 0)
+        goto error;
+    memcpy(mig->localHostuuid, qemuMigrationCookieHostuuid, VIR_UUID_BUFLEN);
 
     return mig;
 
@@ -1855,6 +1881,8 @@ qemuMigrationDriveMirrorReady(virQEMUDriverPtr driver,
     size_t i;
     size_t notReady = 0;
     int status;
+    bool save = false;
+    int ret = -1;
 
     for (i = 0; i < vm->def->ndisks; i++) {
         virDomainDiskDefPtr disk = vm->def->disks[i];
@@ -1863,12 +1891,12 @@ qemuMigrationDriveMirrorReady(virQEMUDriverPtr driver,
         if (!diskPriv->migrating)
             continue;
 
-        status = qemuBlockJobUpdate(driver, vm, disk);
+        status = qemuBlockJobUpdate(driver, vm, disk, &save);
         if (status == VIR_DOMAIN_BLOCK_JOB_FAILED) {
             virReportError(VIR_ERR_OPERATION_FAILED,
                            _("migration of disk %s failed"),
                            disk->dst);
-            return -1;
+            goto cleanup;
         }
 
         if (disk->mirrorState != VIR_DOMAIN_DISK_MIRROR_STATE_READY)
@@ -1877,11 +1905,16 @@ qemuMigrationDriveMirrorReady(virQEMUDriverPtr driver,
 
     if (notReady) {
         VIR_DEBUG("Waiting for %zu disk mirrors to get ready", notReady);
-        return 0;
+        ret = 0;
     } else {
         VIR_DEBUG("All disk mirrors are ready");
-        return 1;
+        ret = 1;
     }
+
+ cleanup:
+    if (save)
+        qemuBlockJobSaveStatus(driver, vm);
+    return ret;
 }
 
 
@@ -1904,6 +1937,7 @@ qemuMigrationDriveMirrorCancelled(virQEMUDriverPtr driver,
     size_t active = 0;
     int status;
     bool failed = false;
+    bool save = false;
 
     for (i = 0; i < vm->def->ndisks; i++) {
         virDomainDiskDefPtr disk = vm->def->disks[i];
@@ -1912,7 +1946,7 @@ qemuMigrationDriveMirrorCancelled(virQEMUDriverPtr driver,
         if (!diskPriv->migrating)
             continue;
 
-        status = qemuBlockJobUpdate(driver, vm, disk);
+        status = qemuBlockJobUpdate(driver, vm, disk, &save);
         switch (status) {
         case VIR_DOMAIN_BLOCK_JOB_FAILED:
             if (check) {
@@ -1924,7 +1958,7 @@ qemuMigrationDriveMirrorCancelled(virQEMUDriverPtr driver,
             /* fallthrough */
         case VIR_DOMAIN_BLOCK_JOB_CANCELED:
         case VIR_DOMAIN_BLOCK_JOB_COMPLETED:
-            qemuBlockJobSyncEnd(driver, vm, disk);
+            qemuBlockJobSyncEnd(driver, vm, disk, &save);
             diskPriv->migrating = false;
             break;
 
@@ -1933,6 +1967,9 @@ qemuMigrationDriveMirrorCancelled(virQEMUDriverPtr driver,
         }
     }
 
+    if (save)
+        qemuBlockJobSaveStatus(driver, vm);
+
     if (failed) {
         if (active) {
             VIR_DEBUG("Some disk mirrors failed; still waiting for %zu "
@@ -1972,7 +2009,7 @@ qemuMigrationCancelOneDriveMirror(virQEMUDriverPtr driver,
     int status;
     int rv;
 
-    status = qemuBlockJobUpdate(driver, vm, disk);
+    status = qemuBlockJobUpdate(driver, vm, disk, NULL);
     switch (status) {
     case VIR_DOMAIN_BLOCK_JOB_FAILED:
     case VIR_DOMAIN_BLOCK_JOB_CANCELED:
@@ -2049,7 +2086,7 @@ qemuMigrationCancelDriveMirror(virQEMUDriverPtr driver,
                     err = virSaveLastError();
                 failed = true;
             }
-            qemuBlockJobSyncEnd(driver, vm, disk);
+            qemuBlockJobSyncEnd(driver, vm, disk, NULL);
             diskPriv->migrating = false;
         }
     }
@@ -2180,7 +2217,7 @@ qemuMigrationDriveMirror(virQEMUDriverPtr driver,
         VIR_FREE(nbd_dest);
 
         if (qemuDomainObjExitMonitor(driver, vm) < 0 || mon_ret < 0) {
-            qemuBlockJobSyncEnd(driver, vm, disk);
+            qemuBlockJobSyncEnd(driver, vm, disk, NULL);
             goto cleanup;
         }
         diskPriv->migrating = true;
@@ -2765,6 +2802,157 @@ qemuMigrationCompleted(virQEMUDriverPtr driver,
 }
 
 
+/* QEMU's default migration downtime limit in milliseconds */
+#define QEMU_MIGRATION_DOWNTIME_DEFAULT 300
+
+typedef struct _qemuMigrationDowntimeTuner qemuMigrationDowntimeTuner;
+typedef qemuMigrationDowntimeTuner *qemuMigrationDowntimeTunerPtr;
+struct _qemuMigrationDowntimeTuner {
+    unsigned long long limitMax;    /* cap from qemu.conf in ms; 0 disables */
+    unsigned long long limit;       /* the limit we last set */
+    unsigned long long lastSample;
+    unsigned long long lastRemaining;
+    unsigned long long lastIteration;
+    bool stalled;                   /* previous pass made no progress */
+};
+
+
+/* Sample the migration stats at most once per second and double the
+ * downtime limit (up to migration_adaptive_downtime from qemu.conf)
+ * once two successive passes over guest memory complete without
+ * shrinking the amount left to transfer, i.e. the guest dirties
+ * memory at least as fast as the stream can move it.
+ */
+static void
+qemuMigrationTuneDowntime(virQEMUDriverPtr driver,
+                          virDomainObjPtr vm,
+                          qemuDomainAsyncJob asyncJob,
+                          qemuMigrationDowntimeTunerPtr tuner)
+{
+    qemuDomainObjPrivatePtr priv = vm->privateData;
+    qemuMonitorMigrationStatsPtr stats = &priv->job.current->stats;
+    unsigned long long now;
+    unsigned long long limit;
+    bool stalled;
+    int rc;
+
+    if (!tuner->limitMax ||
+        stats->status != QEMU_MONITOR_MIGRATION_STATUS_ACTIVE)
+        return;
+
+    if (virTimeMillisNowRaw(&now) < 0)
+        return;
+
+    if (tuner->lastSample == 0) {
+        tuner->lastSample = now;
+        tuner->lastRemaining = stats->ram_remaining;
+        tuner->lastIteration = stats->ram_iteration;
+        return;
+    }
+
+    if (now < tuner->lastSample + 1000)
+        return;
+    tuner->lastSample = now;
+
+    /* still within the same pass over guest memory */
+    if (stats->ram_iteration == tuner->lastIteration)
+        return;
+
+    stalled = stats->ram_remaining >= tuner->lastRemaining;
+    tuner->lastIteration = stats->ram_iteration;
+    tuner->lastRemaining = stats->ram_remaining;
+
+    if (!stalled) {
+        tuner->stalled = false;
+        return;
+    }
+
+    if (!tuner->stalled) {
+        tuner->stalled = true;
+        return;
+    }
+
+    if (tuner->limit >= tuner->limitMax)
+        return;
+
+    limit = tuner->limit * 2;
+    if (limit > tuner->limitMax)
+        limit = tuner->limitMax;
+
+    if (qemuDomainObjEnterMonitorAsync(driver, vm, asyncJob) < 0)
+        goto disable;
+    rc = qemuMonitorSetMigrationDowntime(priv->mon, limit);
+    if (qemuDomainObjExitMonitor(driver, vm) < 0 || rc < 0)
+        goto disable;
+
+    VIR_DEBUG("vm=%s not converging, downtime limit raised to %llu ms",
+              vm->def->name, limit);
+    tuner->limit = limit;
+    tuner->stalled = false;
+    return;
+
+ disable:
+    VIR_WARN("Unable to adjust migration downtime limit for domain %s; "
+             "disabling adaptive downtime", vm->def->name);
+    virResetLastError();
+    tuner->limitMax = 0;
+}
+
+
+typedef struct _qemuMigrationPostCopyTrigger qemuMigrationPostCopyTrigger;
+typedef qemuMigrationPostCopyTrigger *qemuMigrationPostCopyTriggerPtr;
+struct _qemuMigrationPostCopyTrigger {
+    unsigned long long afterPasses; /* from qemu.conf; 0 disables */
+    bool triggered;
+};
+
+
+/* Switch a migration that was started with the post-copy capability
+ * over to post-copy mode once the configured number of full passes
+ * over guest memory has completed without converging, so the total
+ * migration time stays bounded even for guests that dirty memory
+ * faster than it can be transferred.
+ */
+static void
+qemuMigrationTriggerPostCopy(virQEMUDriverPtr driver,
+                             virDomainObjPtr vm,
+                             qemuDomainAsyncJob asyncJob,
+                             qemuMigrationPostCopyTriggerPtr trigger)
+{
+    qemuDomainObjPrivatePtr priv = vm->privateData;
+    qemuMonitorMigrationStatsPtr stats = &priv->job.current->stats;
+    int rc;
+
+    if (!trigger->afterPasses || trigger->triggered)
+        return;
+
+    if (stats->status != QEMU_MONITOR_MIGRATION_STATUS_ACTIVE)
+        return;
+
+    /* ram_iteration is the pass currently in progress, so the first
+     * pass is complete once it exceeds the configured count */
+    if (stats->ram_iteration <= trigger->afterPasses)
+        return;
+
+    if (qemuDomainObjEnterMonitorAsync(driver, vm, asyncJob) < 0)
+        goto disable;
+    rc = qemuMonitorMigrateStartPostCopy(priv->mon);
+    if (qemuDomainObjExitMonitor(driver, vm) < 0 || rc < 0)
+        goto disable;
+
+    VIR_DEBUG("vm=%s switched to post-copy after %llu memory passes",
+              vm->def->name, trigger->afterPasses);
+    trigger->triggered = true;
+    return;
+
+ disable:
+    VIR_WARN("Unable to switch migration of domain %s to post-copy",
+             vm->def->name);
+    virResetLastError();
+    trigger->afterPasses = 0;
+}
+
+
 /* Returns 0 on success, -2 when migration needs to be cancelled, or -1 when
  * QEMU reports failed migration.
  */
@@ -2778,8 +2966,21 @@ qemuMigrationWaitForCompletion(virQEMUDriverPtr driver,
     qemuDomainObjPrivatePtr priv = vm->privateData;
     qemuDomainJobInfoPtr jobInfo = priv->job.current;
     bool events = virQEMUCapsGet(priv->qemuCaps, QEMU_CAPS_MIGRATION_EVENT);
+    qemuMigrationDowntimeTuner tuner = {
+        .limit = QEMU_MIGRATION_DOWNTIME_DEFAULT,
+    };
+    qemuMigrationPostCopyTrigger trigger = { 0 };
     int rv;
 
+    if (asyncJob == QEMU_ASYNC_JOB_MIGRATION_OUT) {
+        virQEMUDriverConfigPtr cfg = virQEMUDriverGetConfig(driver);
+        tuner.limitMax = cfg->migrationAdaptiveDowntime;
+        if (flags & QEMU_MIGRATION_COMPLETED_POSTCOPY &&
+            priv->job.postcopyEnabled)
+            trigger.afterPasses = cfg->migrationPostCopyAfterPasses;
+        virObjectUnref(cfg);
+    }
+
     flags |= QEMU_MIGRATION_COMPLETED_UPDATE_STATS;
 
     jobInfo->type = VIR_DOMAIN_JOB_UNBOUNDED;
@@ -2788,6 +2989,9 @@ qemuMigrationWaitForCompletion(virQEMUDriverPtr driver,
         if (rv < 0)
             return rv;
 
+        qemuMigrationTuneDowntime(driver, vm, asyncJob, &tuner);
+        qemuMigrationTriggerPostCopy(driver, vm, asyncJob, &trigger);
+
         if (events) {
             if (virDomainObjWait(vm) < 0) {
                 jobInfo->type = VIR_DOMAIN_JOB_FAILED;
@@ -3572,6 +3776,24 @@ qemuMigrationSetParams(virQEMUDriverPtr driver,
 }
 
 
+/* Enlarge the pipe between qemu and the tunnel thread so qemu can
+ * burst several buffers ahead of the stream instead of blocking on
+ * the default pipe capacity after every page */
+#define TUNNEL_PIPE_SIZE (1024 * 1024)
+
+static void
+qemuMigrationSetPipeSize(int fd ATTRIBUTE_UNUSED)
+{
+#ifdef F_SETPIPE_SZ
+    if (fcntl(fd, F_SETPIPE_SZ, TUNNEL_PIPE_SIZE) < 0) {
+        char ebuf[1024];
+        VIR_DEBUG("Unable to enlarge migration pipe: %s",
+                  virStrerror(errno, ebuf, sizeof(ebuf)));
+    }
+#endif
+}
+
+
 static int
 qemuMigrationPrepareAny(virQEMUDriverPtr driver,
                         virConnectPtr dconn,
@@ -3745,11 +3967,13 @@ qemuMigrationPrepareAny(virQEMUDriverPtr driver,
     if (flags & VIR_MIGRATE_OFFLINE)
         goto done;
 
-    if (tunnel &&
-        (pipe(dataFD) < 0 || virSetCloseExec(dataFD[1]) < 0)) {
-        virReportSystemError(errno, "%s",
-                             _("cannot create pipe for tunnelled migration"));
-        goto stopjob;
+    if (tunnel) {
+        if (pipe(dataFD) < 0 || virSetCloseExec(dataFD[1]) < 0) {
+            virReportSystemError(errno, "%s",
+                                 _("cannot create pipe for tunnelled migration"));
+            goto stopjob;
+        }
+        qemuMigrationSetPipeSize(dataFD[1]);
     }
 
     if (qemuProcessInit(driver, vm, QEMU_ASYNC_JOB_MIGRATION_IN,
@@ -5093,6 +5317,7 @@ static int doTunnelMigrate(virQEMUDriverPtr driver,
     if (pipe2(fds, O_CLOEXEC) == 0) {
         spec.dest.fd.qemu = fds[1];
         spec.dest.fd.local = fds[0];
+        qemuMigrationSetPipeSize(fds[1]);
     }
     if (spec.dest.fd.qemu == -1 ||
         virSecurityManagerSetImageFDLabel(driver->securityManager, vm->def,
@@ -6486,10 +6711,15 @@ qemuMigrationToFile(virQEMUDriverPtr driver, virDomainObjPtr vm,
         return -1;
     }
 
-    if (compressor && pipe(pipeFD) < 0) {
-        virReportSystemError(errno, "%s",
-                             _("Failed to create pipe for migration"));
-        return -1;
+    if (compressor) {
+        if (pipe(pipeFD) < 0) {
+            virReportSystemError(errno, "%s",
+                                 _("Failed to create pipe for migration"));
+            return -1;
+        }
+        /* qemu writes the memory image in large chunks; a bigger pipe
+         * between qemu and the compressor keeps both sides busy */
+        qemuMigrationSetPipeSize(pipeFD[1]);
     }
 
     /* All right! We can use fd migration, which means that qemu
@@ -6638,7 +6868,7 @@ qemuMigrationCancel(virQEMUDriverPtr driver,
             VIR_DEBUG("Drive mirror on disk %s is still running", disk->dst);
         } else {
             VIR_DEBUG("Drive mirror on disk %s is gone", disk->dst);
-            qemuBlockJobSyncEnd(driver, vm, disk);
+            qemuBlockJobSyncEnd(driver, vm, disk, NULL);
             diskPriv->migrating = false;
         }
     }
@@ -6660,7 +6890,7 @@ qemuMigrationCancel(virQEMUDriverPtr driver,
             qemuDomainDiskPrivatePtr diskPriv = QEMU_DOMAIN_DISK_PRIVATE(disk);
 
             if (diskPriv->migrating) {
-                qemuBlockJobSyncEnd(driver, vm, disk);
+                qemuBlockJobSyncEnd(driver, vm, disk, NULL);
                 diskPriv->migrating = false;
             }
         }
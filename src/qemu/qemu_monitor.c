@@ -55,6 +55,20 @@ VIR_LOG_INIT("qemu.qemu_monitor");
 #define DEBUG_IO 0
 #define DEBUG_RAW_IO 0
 
+#define QEMU_MONITOR_EVENT_COALESCE_MS 250
+
+typedef struct _qemuMonitorCoalescedEvent qemuMonitorCoalescedEvent;
+typedef qemuMonitorCoalescedEvent *qemuMonitorCoalescedEventPtr;
+struct _qemuMonitorCoalescedEvent {
+    char *event;
+    long long seconds;
+    unsigned int micros;
+    char *details;
+    virJSONValuePtr data;
+    qemuMonitorEventDataHandler handler;
+    qemuMonitorCoalescedEventPtr next;
+};
+
 struct _qemuMonitor {
     virObjectLockable parent;
 
@@ -77,6 +91,9 @@ struct _qemuMonitor {
      * code to process & find message boundaries */
     size_t bufferOffset;
     size_t bufferLength;
+    /* number of leading buffer bytes already searched for a line
+     * ending without finding one */
+    size_t bufferScanned;
     char *buffer;
 
     /* If anything went wrong, this will be fed back
@@ -95,6 +112,12 @@ struct _qemuMonitor {
     char *balloonpath;
     bool ballooninit;
 
+    /* 'last value wins' events awaiting deferred delivery, at most
+     * one pending entry per event type */
+    qemuMonitorCoalescedEventPtr coalesced;
+    int coalesceTimer;
+    unsigned long long coalesceDropped;
+
     /* Log file context of the qemu process to dig for usable info */
     qemuMonitorReportDomainLogError logFunc;
     void *logOpaque;
@@ -147,6 +170,7 @@ struct _qemuMonitor {
 
 static virClassPtr qemuMonitorClass;
 static void qemuMonitorDispose(void *obj);
+static void qemuMonitorCoalesceFlush(qemuMonitorPtr mon, bool deliver);
 
 static int qemuMonitorOnceInit(void)
 {
@@ -318,6 +342,7 @@ qemuMonitorDispose(void *obj)
         (mon->cb->destroy)(mon, mon->vm, mon->callbackOpaque);
     virObjectUnref(mon->vm);
 
+    qemuMonitorCoalesceFlush(mon, false);
     virResetError(&mon->lastError);
     virCondDestroy(&mon->notify);
     VIR_FREE(mon->buffer);
@@ -428,6 +453,17 @@ qemuMonitorIOProcess(qemuMonitorPtr mon)
     PROBE(QEMU_MONITOR_IO_PROCESS,
           "mon=%p buf=%s len=%zu", mon, mon->buffer, mon->bufferOffset);
 
+    /* A large reply may arrive split across many reads. Don't rescan
+     * the part of the buffer that is already known not to contain a
+     * line ending, or accumulating an N byte message costs O(N^2). */
+    if (mon->json &&
+        mon->bufferOffset > mon->bufferScanned &&
+        !memchr(mon->buffer + mon->bufferScanned, '\n',
+                mon->bufferOffset - mon->bufferScanned)) {
+        mon->bufferScanned = mon->bufferOffset;
+        return 0;
+    }
+
     if (mon->json)
         len = qemuMonitorJSONIOProcess(mon,
                                        mon->buffer, mon->bufferOffset,
@@ -446,9 +482,12 @@ qemuMonitorIOProcess(qemuMonitorPtr mon)
     if (len < mon->bufferOffset) {
         memmove(mon->buffer, mon->buffer + len, mon->bufferOffset - len);
         mon->bufferOffset -= len;
+        /* whatever is left over is an incomplete line */
+        mon->bufferScanned = mon->bufferOffset;
     } else {
         VIR_FREE(mon->buffer);
         mon->bufferOffset = mon->bufferLength = 0;
+        mon->bufferScanned = 0;
     }
 #if DEBUG_IO
     VIR_DEBUG("Process done %d used %d", (int)mon->bufferOffset, len);
@@ -814,6 +853,7 @@ qemuMonitorOpenInternal(virDomainObjPtr vm,
         goto cleanup;
     }
     mon->fd = fd;
+    mon->coalesceTimer = -1;
     mon->hasSendFD = hasSendFD;
     mon->vm = virObjectRef(vm);
     mon->json = json;
@@ -940,6 +980,12 @@ qemuMonitorClose(qemuMonitorPtr mon)
 
     qemuMonitorSetDomainLog(mon, NULL, NULL, NULL);
 
+    if (mon->coalesceTimer != -1) {
+        virEventRemoveTimeout(mon->coalesceTimer);
+        mon->coalesceTimer = -1;
+    }
+    qemuMonitorCoalesceFlush(mon, false);
+
     if (mon->fd >= 0) {
         qemuMonitorUnregister(mon);
         VIR_FORCE_CLOSE(mon->fd);
@@ -991,6 +1037,8 @@ int
 qemuMonitorSend(qemuMonitorPtr mon,
                 qemuMonitorMessagePtr msg)
 {
+    unsigned long long start = 0;
+    unsigned long long now = 0;
     int ret = -1;
 
     /* Check whether qemu quit unexpectedly */
@@ -1004,6 +1052,7 @@ qemuMonitorSend(qemuMonitorPtr mon,
     mon->msg = msg;
     qemuMonitorUpdateWatch(mon);
 
+    ignore_value(virTimeMillisNow(&start));
     PROBE(QEMU_MONITOR_SEND_MSG,
           "mon=%p msg=%s fd=%d",
           mon, mon->msg->txBuffer, mon->msg->txFD);
@@ -1029,6 +1078,12 @@ qemuMonitorSend(qemuMonitorPtr mon,
     mon->msg = NULL;
     qemuMonitorUpdateWatch(mon);
 
+    /* full round trip: write queued, reply parsed and matched */
+    ignore_value(virTimeMillisNow(&now));
+    PROBE(QEMU_MONITOR_SEND_DONE,
+          "mon=%p ret=%d duration=%llu",
+          mon, ret, now > start ? now - start : 0);
+
     return ret;
 }
 
@@ -1233,6 +1288,140 @@ qemuMonitorHMPCommandWithFd(qemuMonitorPtr mon,
 }
 
 
+static void
+qemuMonitorCoalescedEventFree(qemuMonitorCoalescedEventPtr ev)
+{
+    if (!ev)
+        return;
+
+    VIR_FREE(ev->event);
+    VIR_FREE(ev->details);
+    virJSONValueFree(ev->data);
+    VIR_FREE(ev);
+}
+
+
+/* Deliver (or drop, if @deliver is false) all pending coalesced
+ * events. Call with the monitor locked. */
+static void
+qemuMonitorCoalesceFlush(qemuMonitorPtr mon, bool deliver)
+{
+    qemuMonitorCoalescedEventPtr ev = mon->coalesced;
+
+    mon->coalesced = NULL;
+
+    while (ev) {
+        qemuMonitorCoalescedEventPtr next = ev->next;
+
+        if (deliver) {
+            qemuMonitorEmitEvent(mon, ev->event, ev->seconds, ev->micros,
+                                 ev->details);
+            if (ev->handler)
+                (ev->handler)(mon, ev->data);
+        }
+
+        qemuMonitorCoalescedEventFree(ev);
+        ev = next;
+    }
+}
+
+
+static void
+qemuMonitorCoalesceTimer(int timer ATTRIBUTE_UNUSED, void *opaque)
+{
+    qemuMonitorPtr mon = opaque;
+
+    virObjectLock(mon);
+
+    if (mon->coalesceTimer != -1) {
+        virEventRemoveTimeout(mon->coalesceTimer);
+        mon->coalesceTimer = -1;
+    }
+
+    qemuMonitorCoalesceFlush(mon, true);
+
+    virObjectUnlock(mon);
+}
+
+
+/**
+ * qemuMonitorCoalesceEvent:
+ * @mon: monitor object
+ * @event: QMP event type name
+ * @seconds: event timestamp
+ * @micros: event timestamp
+ * @details: stringified event data, may be NULL; consumed
+ * @data: event data, may be NULL; consumed
+ * @handler: event specific handler to invoke on delivery, may be NULL
+ *
+ * Queue a 'last value wins' event for delivery once the coalescing
+ * window expires. If an event of the same type is already pending its
+ * value is superseded, so a guest emitting such events at high rate
+ * costs one delivery per window instead of one per event. @details
+ * and @data are consumed even on failure.
+ *
+ * Call with the monitor locked.
+ */
+int
+qemuMonitorCoalesceEvent(qemuMonitorPtr mon,
+                         const char *event,
+                         long long seconds,
+                         unsigned int micros,
+                         char *details,
+                         virJSONValuePtr data,
+                         qemuMonitorEventDataHandler handler)
+{
+    qemuMonitorCoalescedEventPtr ev;
+
+    for (ev = mon->coalesced; ev; ev = ev->next) {
+        if (STREQ(ev->event, event))
+            break;
+    }
+
+    if (!ev) {
+        if (VIR_ALLOC(ev) < 0)
+            goto error;
+        if (VIR_STRDUP(ev->event, event) < 0) {
+            VIR_FREE(ev);
+            goto error;
+        }
+        ev->next = mon->coalesced;
+        mon->coalesced = ev;
+    } else {
+        VIR_FREE(ev->details);
+        virJSONValueFree(ev->data);
+        mon->coalesceDropped++;
+        VIR_DEBUG("superseding pending %s event (%llu dropped so far)",
+                  event, mon->coalesceDropped);
+    }
+
+    ev->seconds = seconds;
+    ev->micros = micros;
+    ev->details = details;
+    ev->data = data;
+    ev->handler = handler;
+
+    if (mon->coalesceTimer == -1) {
+        virObjectRef(mon);
+        if ((mon->coalesceTimer =
+             virEventAddTimeout(QEMU_MONITOR_EVENT_COALESCE_MS,
+                                qemuMonitorCoalesceTimer, mon,
+                                virObjectFreeCallback)) < 0) {
+            virObjectUnref(mon);
+            /* without a timer just deliver everything right away */
+            qemuMonitorCoalesceFlush(mon, true);
+        }
+    }
+
+    return 0;
+
+ error:
+    VIR_FREE(details);
+    virJSONValueFree(data);
+    return -1;
+}
+
+
 /* Ensure proper locking around callbacks.  */
 #define QEMU_MONITOR_CALLBACK(mon, ret, callback, ...)          \
     do {                                                        \
@@ -2177,6 +2366,42 @@ qemuMonitorBlockStatsUpdateCapacity(qemuMonitorPtr mon,
 }
 
 
+/**
+ * qemuMonitorGetAllBlockStatsAndCapacity:
+ * @mon: monitor object
+ * @ret_stats: pointer that is filled with a hash table containing the stats
+ * @backingChain: recurse into the backing chain of devices
+ *
+ * Equivalent to qemuMonitorGetAllBlockStatsInfo followed by
+ * qemuMonitorBlockStatsUpdateCapacity, but both QMP queries are sent
+ * back-to-back on the wire before any reply is read, so the whole
+ * exchange costs a single monitor round trip.
+ *
+ * Returns < 0 on error, count of supported block stats fields on success.
+ */
+int
+qemuMonitorGetAllBlockStatsAndCapacity(qemuMonitorPtr mon,
+                                       virHashTablePtr *ret_stats,
+                                       bool backingChain)
+{
+    int ret;
+    VIR_DEBUG("ret_stats=%p, backing=%d", ret_stats, backingChain);
+
+    QEMU_CHECK_MONITOR_JSON(mon);
+
+    if (!(*ret_stats = virHashCreate(10, virHashValueFree)))
+        return -1;
+
+    if ((ret = qemuMonitorJSONGetAllBlockStatsAndCapacity(mon, *ret_stats,
+                                                          backingChain)) < 0) {
+        virHashFree(*ret_stats);
+        *ret_stats = NULL;
+    }
+
+    return ret;
+}
+
+
 int
 qemuMonitorBlockResize(qemuMonitorPtr mon,
                        const char *device,
@@ -3118,6 +3343,44 @@ qemuMonitorAddDrive(qemuMonitorPtr mon,
 }
 
 
+/**
+ * qemuMonitorAddDriveAndDevice:
+ * @mon: monitor object
+ * @drivestr: drive specification
+ * @devicestr: device specification
+ * @driveAdded: set to true once the drive was added
+ *
+ * Adds a drive and the device frontend using it in a single monitor
+ * round trip where the monitor supports it. @driveAdded tells the
+ * caller whether a failure left the drive behind, in which case it
+ * is responsible for removing it again.
+ *
+ * Returns 0 on success -1 on error.
+ */
+int
+qemuMonitorAddDriveAndDevice(qemuMonitorPtr mon,
+                             const char *drivestr,
+                             const char *devicestr,
+                             bool *driveAdded)
+{
+    VIR_DEBUG("drive=%s device=%s", drivestr, devicestr);
+
+    QEMU_CHECK_MONITOR(mon);
+
+    *driveAdded = false;
+
+    if (mon->json)
+        return qemuMonitorJSONAddDriveAndDevice(mon, drivestr, devicestr,
+                                                driveAdded);
+
+    if (qemuMonitorTextAddDrive(mon, drivestr) < 0)
+        return -1;
+    *driveAdded = true;
+
+    return qemuMonitorTextAddDevice(mon, devicestr);
+}
+
+
 int
 qemuMonitorSetDrivePassphrase(qemuMonitorPtr mon,
                               const char *alias,
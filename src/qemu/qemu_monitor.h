@@ -55,12 +55,23 @@ struct _qemuMonitorMessage {
     int txOffset;
     int txLength;
 
+    /* 'id' attached to the command by the JSON monitor, used to
+     * correlate the reply */
+    const char *txID;
+
     /* Used by the text monitor reply / error */
     char *rxBuffer;
     int rxLength;
     /* Used by the JSON monitor to hold reply / error */
     void *rxObject;
 
+    /* Used by the JSON monitor when several commands are pipelined
+     * in txBuffer; the replies are collected here in order and
+     * 'finished' is only set once all of them have arrived */
+    void **rxObjects;
+    size_t nrxObjects;
+    size_t nrxWanted;
+
     /* True if rxBuffer / rxObject are ready, or a
      * fatal error occurred on the monitor channel
      */
@@ -271,6 +282,17 @@ int qemuMonitorSetLink(qemuMonitorPtr mon,
 
 /* These APIs are for use by the internal Text/JSON monitor impl code only */
 char *qemuMonitorNextCommandID(qemuMonitorPtr mon);
+
+typedef void (*qemuMonitorEventDataHandler)(qemuMonitorPtr mon,
+                                            virJSONValuePtr data);
+
+int qemuMonitorCoalesceEvent(qemuMonitorPtr mon,
+                             const char *event,
+                             long long seconds,
+                             unsigned int micros,
+                             char *details,
+                             virJSONValuePtr data,
+                             qemuMonitorEventDataHandler handler);
 int qemuMonitorSend(qemuMonitorPtr mon,
                     qemuMonitorMessagePtr msg);
 virJSONValuePtr qemuMonitorGetOptions(qemuMonitorPtr mon)
@@ -500,6 +522,11 @@ int qemuMonitorBlockStatsUpdateCapacity(qemuMonitorPtr mon,
                                         bool backingChain)
     ATTRIBUTE_NONNULL(1) ATTRIBUTE_NONNULL(2);
 
+int qemuMonitorGetAllBlockStatsAndCapacity(qemuMonitorPtr mon,
+                                           virHashTablePtr *ret_stats,
+                                           bool backingChain)
+    ATTRIBUTE_NONNULL(1) ATTRIBUTE_NONNULL(2);
+
 int qemuMonitorBlockResize(qemuMonitorPtr mon,
                            const char *dev_name,
                            unsigned long long size);
@@ -771,6 +798,10 @@ int qemuMonitorDelObject(qemuMonitorPtr mon,
 
 int qemuMonitorAddDrive(qemuMonitorPtr mon,
                         const char *drivestr);
+int qemuMonitorAddDriveAndDevice(qemuMonitorPtr mon,
+                                 const char *drivestr,
+                                 const char *devicestr,
+                                 bool *driveAdded);
 
 int qemuMonitorDriveDel(qemuMonitorPtr mon,
                         const char *drivestr);
@@ -37,6 +37,7 @@
 #include "qemu_parse_command.h"
 #include "qemu_capabilities.h"
 #include "viralloc.h"
+#include "virbuffer.h"
 #include "virlog.h"
 #include "driver.h"
 #include "datatypes.h"
@@ -137,6 +138,17 @@ qemuMonitorEventCompare(const void *key, const void *elt)
     return strcmp(type, handler->type);
 }
 
+
+/* Whether only the most recent value of an event type is interesting.
+ * Some guests emit these at very high rate; delivering each one takes
+ * the domain lock and can starve operations waiting for it. */
+static bool
+qemuMonitorJSONEventIsLastValueOnly(const char *type)
+{
+    return STREQ(type, "RTC_CHANGE") ||
+           STREQ(type, "BALLOON_CHANGE");
+}
+
 static int
 qemuMonitorJSONIOProcessEvent(qemuMonitorPtr mon,
                               virJSONValuePtr obj)
@@ -167,11 +179,26 @@ qemuMonitorJSONIOProcessEvent(qemuMonitorPtr mon,
         ignore_value(virJSONValueObjectGetNumberUint(timestamp, "microseconds",
                                                      &micros));
     }
-    qemuMonitorEmitEvent(mon, type, seconds, micros, details);
-    VIR_FREE(details);
 
     handler = bsearch(type, eventHandlers, ARRAY_CARDINALITY(eventHandlers),
                       sizeof(eventHandlers[0]), qemuMonitorEventCompare);
+
+    if (qemuMonitorJSONEventIsLastValueOnly(type)) {
+        virJSONValuePtr stolen = NULL;
+
+        /* detach the data so it outlives @obj; ownership of it and of
+         * @details passes to the coalescer */
+        ignore_value(virJSONValueObjectRemoveKey(obj, "data", &stolen));
+        ignore_value(qemuMonitorCoalesceEvent(mon, type, seconds, micros,
+                                              details, stolen,
+                                              handler ? handler->handler
+                                                      : NULL));
+        return 0;
+    }
+
+    qemuMonitorEmitEvent(mon, type, seconds, micros, details);
+    VIR_FREE(details);
+
     if (handler) {
         VIR_DEBUG("handle %s handler=%p data=%p", type,
                   handler->handler, data);
@@ -210,10 +237,27 @@ qemuMonitorJSONIOProcessLine(qemuMonitorPtr mon,
         PROBE(QEMU_MONITOR_RECV_REPLY,
               "mon=%p reply=%s", mon, line);
         if (msg) {
-            msg->rxObject = obj;
-            msg->finished = 1;
-            obj = NULL;
-            ret = 0;
+            const char *id = virJSONValueObjectGetString(obj, "id");
+
+            if (msg->txID && id && STRNEQ(id, msg->txID)) {
+                /* a reply to an earlier command whose caller has
+                 * already given up waiting; drop it rather than
+                 * completing the pending message with the wrong data */
+                VIR_DEBUG("Discarding stale reply id='%s', expecting '%s'",
+                          id, msg->txID);
+                ret = 0;
+            } else if (msg->nrxWanted) {
+                msg->rxObjects[msg->nrxObjects++] = obj;
+                obj = NULL;
+                if (msg->nrxObjects == msg->nrxWanted)
+                    msg->finished = 1;
+                ret = 0;
+            } else {
+                msg->rxObject = obj;
+                msg->finished = 1;
+                obj = NULL;
+                ret = 0;
+            }
         } else {
             virReportError(VIR_ERR_INTERNAL_ERROR,
                            _("Unexpected JSON reply '%s'"), line);
@@ -229,7 +273,7 @@ qemuMonitorJSONIOProcessLine(qemuMonitorPtr mon,
 }
 
 int qemuMonitorJSONIOProcess(qemuMonitorPtr mon,
-                             const char *data,
+                             char *data,
                              size_t len,
                              qemuMonitorMessagePtr msg)
 {
@@ -240,18 +284,15 @@ int qemuMonitorJSONIOProcess(qemuMonitorPtr mon,
         char *nl = strstr(data + used, LINE_ENDING);
 
         if (nl) {
-            int got = nl - (data + used);
-            char *line;
-            if (VIR_STRNDUP(line, data + used, got) < 0)
+            char *line = data + used;
+
+            used += (nl - line) + strlen(LINE_ENDING);
+            /* the consumed part of the buffer is discarded by the
+             * caller, so the line can be terminated in place instead
+             * of copying it out */
+            *nl = '\0';
+            if (qemuMonitorJSONIOProcessLine(mon, line, msg) < 0)
                 return -1;
-            used += got + strlen(LINE_ENDING);
-            line[got] = '\0'; /* kill \n */
-            if (qemuMonitorJSONIOProcessLine(mon, line, msg) < 0) {
-                VIR_FREE(line);
-                return -1;
-            }
-
-            VIR_FREE(line);
         } else {
             break;
         }
@@ -284,6 +325,7 @@ qemuMonitorJSONCommandWithFd(qemuMonitorPtr mon,
                            _("Unable to append command 'id' string"));
             goto cleanup;
         }
+        msg.txID = id;
     }
 
     if (!(cmdstr = virJSONValueToString(cmd, false)))
@@ -328,6 +370,83 @@ qemuMonitorJSONCommand(qemuMonitorPtr mon,
     return qemuMonitorJSONCommandWithFd(mon, cmd, -1, reply);
 }
 
+
+/* Send several commands pipelined on the wire before waiting for any
+ * reply, so the whole exchange costs a single round trip. QMP replies
+ * are guaranteed to arrive in command order, which is how they are
+ * matched up. On success the caller owns the virJSONValues placed
+ * into @replies. */
+static int
+qemuMonitorJSONCommandBatch(qemuMonitorPtr mon,
+                            virJSONValuePtr *cmds,
+                            virJSONValuePtr *replies,
+                            size_t ncmds)
+{
+    int ret = -1;
+    qemuMonitorMessage msg;
+    virBuffer buf = VIR_BUFFER_INITIALIZER;
+    char *id = NULL;
+    size_t i;
+
+    memset(&msg, 0, sizeof(msg));
+
+    if (VIR_ALLOC_N(msg.rxObjects, ncmds) < 0)
+        return -1;
+    msg.nrxWanted = ncmds;
+
+    for (i = 0; i < ncmds; i++) {
+        char *cmdstr;
+
+        if (!(id = qemuMonitorNextCommandID(mon)))
+            goto cleanup;
+        if (virJSONValueObjectAppendString(cmds[i], "id", id) < 0) {
+            virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                           _("Unable to append command 'id' string"));
+            goto cleanup;
+        }
+        VIR_FREE(id);
+
+        if (!(cmdstr = virJSONValueToString(cmds[i], false)))
+            goto cleanup;
+        virBufferAsprintf(&buf, "%s\r\n", cmdstr);
+        VIR_FREE(cmdstr);
+    }
+
+    if (virBufferCheckError(&buf) < 0)
+        goto cleanup;
+
+    msg.txLength = virBufferUse(&buf);
+    msg.txBuffer = virBufferContentAndReset(&buf);
+    msg.txFD = -1;
+
+    VIR_DEBUG("Send batch of %zu commands:\n%s", ncmds, msg.txBuffer);
+
+    if (qemuMonitorSend(mon, &msg) < 0)
+        goto cleanup;
+
+    if (msg.nrxObjects != ncmds) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("Expected %zu monitor replies, got %zu"),
+                       ncmds, msg.nrxObjects);
+        goto cleanup;
+    }
+
+    for (i = 0; i < ncmds; i++)
+        replies[i] = msg.rxObjects[i];
+    msg.nrxObjects = 0;
+
+    ret = 0;
+
+ cleanup:
+    for (i = 0; i < msg.nrxObjects; i++)
+        virJSONValueFree(msg.rxObjects[i]);
+    VIR_FREE(msg.rxObjects);
+    VIR_FREE(msg.txBuffer);
+    VIR_FREE(id);
+    virBufferFreeAndReset(&buf);
+    return ret;
+}
+
 /* Ignoring OOM in this method, since we're already reporting
  * a more important error
  *
@@ -1982,32 +2101,20 @@ qemuMonitorJSONGetOneBlockStatsInfo(virJSONValuePtr dev,
 }
 
 
-int
-qemuMonitorJSONGetAllBlockStatsInfo(qemuMonitorPtr mon,
+static int
+qemuMonitorJSONBlockStatsCollectAll(virJSONValuePtr reply,
                                     virHashTablePtr hash,
                                     bool backingChain)
 {
-    int ret = -1;
     int nstats = 0;
     int rc;
     size_t i;
-    virJSONValuePtr cmd;
-    virJSONValuePtr reply = NULL;
     virJSONValuePtr devices;
 
-    if (!(cmd = qemuMonitorJSONMakeCommand("query-blockstats", NULL)))
-        return -1;
-
-    if ((rc = qemuMonitorJSONCommand(mon, cmd, &reply)) < 0)
-        goto cleanup;
-
-    if (qemuMonitorJSONCheckError(cmd, reply) < 0)
-        goto cleanup;
-
     if (!(devices = virJSONValueObjectGetArray(reply, "return"))) {
         virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
                        _("blockstats reply was missing device list"));
-        goto cleanup;
+        return -1;
     }
 
     for (i = 0; i < virJSONValueArraySize(devices); i++) {
@@ -2018,27 +2125,49 @@ qemuMonitorJSONGetAllBlockStatsInfo(qemuMonitorPtr mon,
             virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
                            _("blockstats device entry was not "
                              "in expected format"));
-            goto cleanup;
+            return -1;
         }
 
         if (!(dev_name = virJSONValueObjectGetString(dev, "device"))) {
             virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
                            _("blockstats device entry was not "
                              "in expected format"));
-            goto cleanup;
+            return -1;
         }
 
         rc = qemuMonitorJSONGetOneBlockStatsInfo(dev, dev_name, 0, hash,
                                                  backingChain);
 
         if (rc < 0)
-            goto cleanup;
+            return -1;
 
         if (rc > nstats)
             nstats = rc;
     }
 
-    ret = nstats;
+    return nstats;
+}
+
+
+int
+qemuMonitorJSONGetAllBlockStatsInfo(qemuMonitorPtr mon,
+                                    virHashTablePtr hash,
+                                    bool backingChain)
+{
+    int ret = -1;
+    virJSONValuePtr cmd;
+    virJSONValuePtr reply = NULL;
+
+    if (!(cmd = qemuMonitorJSONMakeCommand("query-blockstats", NULL)))
+        return -1;
+
+    if (qemuMonitorJSONCommand(mon, cmd, &reply) < 0)
+        goto cleanup;
+
+    if (qemuMonitorJSONCheckError(cmd, reply) < 0)
+        goto cleanup;
+
+    ret = qemuMonitorJSONBlockStatsCollectAll(reply, hash, backingChain);
 
  cleanup:
     virJSONValueFree(cmd);
@@ -2096,17 +2225,13 @@ qemuMonitorJSONBlockStatsUpdateCapacityOne(virJSONValuePtr image,
 }
 
 
-int
-qemuMonitorJSONBlockStatsUpdateCapacity(qemuMonitorPtr mon,
-                                        virHashTablePtr stats,
-                                        bool backingChain)
+static int
+qemuMonitorJSONBlockStatsUpdateCapacityData(virJSONValuePtr devices,
+                                            virHashTablePtr stats,
+                                            bool backingChain)
 {
     int ret = -1;
     size_t i;
-    virJSONValuePtr devices;
-
-    if (!(devices = qemuMonitorJSONQueryBlock(mon)))
-        return -1;
 
     for (i = 0; i < virJSONValueArraySize(devices); i++) {
         virJSONValuePtr dev;
@@ -2134,11 +2259,80 @@ qemuMonitorJSONBlockStatsUpdateCapacity(qemuMonitorPtr mon,
     ret = 0;
 
  cleanup:
+    return ret;
+}
+
+
+int
+qemuMonitorJSONBlockStatsUpdateCapacity(qemuMonitorPtr mon,
+                                        virHashTablePtr stats,
+                                        bool backingChain)
+{
+    int ret;
+    virJSONValuePtr devices;
+
+    if (!(devices = qemuMonitorJSONQueryBlock(mon)))
+        return -1;
+
+    ret = qemuMonitorJSONBlockStatsUpdateCapacityData(devices, stats,
+                                                      backingChain);
+
     virJSONValueFree(devices);
     return ret;
 }
 
 
+/* Fetch block I/O stats and image capacity info with query-blockstats
+ * and query-block pipelined in a single monitor round trip.
+ * Equivalent to qemuMonitorJSONGetAllBlockStatsInfo followed by
+ * qemuMonitorJSONBlockStatsUpdateCapacity. */
+int
+qemuMonitorJSONGetAllBlockStatsAndCapacity(qemuMonitorPtr mon,
+                                           virHashTablePtr hash,
+                                           bool backingChain)
+{
+    int ret = -1;
+    size_t i;
+    virJSONValuePtr cmds[2] = { NULL, NULL };
+    virJSONValuePtr replies[2] = { NULL, NULL };
+    virJSONValuePtr devices;
+
+    if (!(cmds[0] = qemuMonitorJSONMakeCommand("query-blockstats", NULL)) ||
+        !(cmds[1] = qemuMonitorJSONMakeCommand("query-block", NULL)))
+        goto cleanup;
+
+    if (qemuMonitorJSONCommandBatch(mon, cmds, replies,
+                                    ARRAY_CARDINALITY(cmds)) < 0)
+        goto cleanup;
+
+    if (qemuMonitorJSONCheckError(cmds[0], replies[0]) < 0 ||
+        qemuMonitorJSONCheckError(cmds[1], replies[1]) < 0)
+        goto cleanup;
+
+    if ((ret = qemuMonitorJSONBlockStatsCollectAll(replies[0], hash,
+                                                   backingChain)) < 0)
+        goto cleanup;
+
+    if (!(devices = virJSONValueObjectGetArray(replies[1], "return"))) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("query-block reply was missing device list"));
+        ret = -1;
+        goto cleanup;
+    }
+
+    if (qemuMonitorJSONBlockStatsUpdateCapacityData(devices, hash,
+                                                    backingChain) < 0)
+        ret = -1;
+
+ cleanup:
+    for (i = 0; i < ARRAY_CARDINALITY(cmds); i++) {
+        virJSONValueFree(cmds[i]);
+        virJSONValueFree(replies[i]);
+    }
+    return ret;
+}
+
+
 /* Return 0 on success, -1 on failure, or -2 if not supported.  Size
  * is in bytes.  */
 int qemuMonitorJSONBlockResize(qemuMonitorPtr mon,
@@ -3664,6 +3858,95 @@ qemuMonitorJSONAddDevice(qemuMonitorPtr mon,
 }
 
 
+int
+qemuMonitorJSONAddDriveAndDevice(qemuMonitorPtr mon,
+                                 const char *drivestr,
+                                 const char *devicestr,
+                                 bool *driveAdded)
+{
+    int ret = -1;
+    char *safe_str = NULL;
+    char *cmd_str = NULL;
+    const char *hmpreply;
+    virJSONValuePtr args = NULL;
+    virJSONValuePtr cmds[2] = { NULL, NULL };
+    virJSONValuePtr replies[2] = { NULL, NULL };
+    size_t i;
+
+    *driveAdded = false;
+
+    if (!(safe_str = qemuMonitorEscapeArg(drivestr)))
+        return -1;
+
+    /* 'dummy' here is just a placeholder since there is no PCI
+     * address required when attaching drives to a controller */
+    if (virAsprintf(&cmd_str, "drive_add dummy %s", safe_str) < 0)
+        goto cleanup;
+
+    if (!(cmds[0] = qemuMonitorJSONMakeCommand("human-monitor-command",
+                                               "s:command-line", cmd_str,
+                                               NULL)))
+        goto cleanup;
+
+    if (!(args = qemuMonitorJSONKeywordStringToJSON(devicestr, "driver")))
+        goto cleanup;
+
+    if (!(cmds[1] = qemuMonitorJSONMakeCommand("device_add", NULL)))
+        goto cleanup;
+
+    if (virJSONValueObjectAppend(cmds[1], "arguments", args) < 0)
+        goto cleanup;
+    args = NULL; /* cmds[1] owns reference to args now */
+
+    if (qemuMonitorJSONCommandBatch(mon, cmds, replies, 2) < 0)
+        goto cleanup;
+
+    if (qemuMonitorJSONHasError(replies[0], "CommandNotFound")) {
+        virReportError(VIR_ERR_OPERATION_UNSUPPORTED,
+                       _("Human monitor command is not available to run %s"),
+                       cmd_str);
+        goto cleanup;
+    }
+
+    if (qemuMonitorJSONCheckError(cmds[0], replies[0]) < 0)
+        goto cleanup;
+
+    hmpreply = virJSONValueGetString(virJSONValueObjectGet(replies[0],
+                                                           "return"));
+
+    if (hmpreply && strstr(hmpreply, "unknown command:")) {
+        virReportError(VIR_ERR_OPERATION_FAILED, "%s",
+                       _("drive hotplug is not supported"));
+        goto cleanup;
+    }
+
+    if (hmpreply && strstr(hmpreply, "could not open disk image")) {
+        virReportError(VIR_ERR_OPERATION_FAILED, "%s",
+                       _("open disk image file failed"));
+        goto cleanup;
+    }
+
+    /* the drive is in place; from here on a failure of device_add
+     * requires the caller to roll the drive back */
+    *driveAdded = true;
+
+    if (qemuMonitorJSONCheckError(cmds[1], replies[1]) < 0)
+        goto cleanup;
+
+    ret = 0;
+
+ cleanup:
+    for (i = 0; i < 2; i++) {
+        virJSONValueFree(cmds[i]);
+        virJSONValueFree(replies[i]);
+    }
+    virJSONValueFree(args);
+    VIR_FREE(cmd_str);
+    VIR_FREE(safe_str);
+    return ret;
+}
+
+
 int qemuMonitorJSONAddObject(qemuMonitorPtr mon,
                              const char *type,
                              const char *objalias,
@@ -37,7 +37,7 @@ int qemuMonitorJSONIOProcessLine(qemuMonitorPtr mon,
                                  qemuMonitorMessagePtr msg);
 
 int qemuMonitorJSONIOProcess(qemuMonitorPtr mon,
-                             const char *data,
+                             char *data,
                              size_t len,
                              qemuMonitorMessagePtr msg);
 
@@ -86,6 +86,9 @@ int qemuMonitorJSONGetAllBlockStatsInfo(qemuMonitorPtr mon,
 int qemuMonitorJSONBlockStatsUpdateCapacity(qemuMonitorPtr mon,
                                             virHashTablePtr stats,
                                             bool backingChain);
+int qemuMonitorJSONGetAllBlockStatsAndCapacity(qemuMonitorPtr mon,
+                                               virHashTablePtr hash,
+                                               bool backingChain);
 int qemuMonitorJSONBlockResize(qemuMonitorPtr mon,
                                const char *devce,
                                unsigned long long size);
@@ -220,6 +223,10 @@ int qemuMonitorJSONAddDeviceArgs(qemuMonitorPtr mon,
                                  virJSONValuePtr args);
 int qemuMonitorJSONAddDevice(qemuMonitorPtr mon,
                              const char *devicestr);
+int qemuMonitorJSONAddDriveAndDevice(qemuMonitorPtr mon,
+                                     const char *drivestr,
+                                     const char *devicestr,
+                                     bool *driveAdded);
 
 int qemuMonitorJSONDelDevice(qemuMonitorPtr mon,
                              const char *devalias);
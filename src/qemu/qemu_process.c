@@ -4628,7 +4628,8 @@ qemuProcessInit(virQEMUDriverPtr driver,
      * report implicit runtime defaults in the XML, like vnc listen/socket
      */
     VIR_DEBUG("Setting current domain def as transient");
-    if (virDomainObjSetDefTransient(caps, driver->xmlopt, vm) < 0)
+    if (virDomainObjSetDefTransient(caps, driver->xmlopt, vm,
+                                    priv->qemuCaps) < 0)
         goto stop;
 
     if (!(flags & VIR_QEMU_PROCESS_START_PRETEND)) {
@@ -5914,6 +5915,8 @@ void qemuProcessStop(virQEMUDriverPtr driver,
     virDomainDefPtr def;
     virNetDevVPortProfilePtr vport = NULL;
     size_t i;
+    char **ovsPorts = NULL;
+    size_t novsPorts = 0;
     char *timestamp;
     virQEMUDriverConfigPtr cfg = virQEMUDriverGetConfig(driver);
 
@@ -6105,10 +6108,15 @@ void qemuProcessStop(virQEMUDriverPtr driver,
         if (vport) {
             if (vport->virtPortType == VIR_NETDEV_VPORT_PROFILE_MIDONET) {
                 ignore_value(virNetDevMidonetUnbindPort(vport));
-            } else if (vport->virtPortType == VIR_NETDEV_VPORT_PROFILE_OPENVSWITCH) {
-                ignore_value(virNetDevOpenvswitchRemovePort(
-                                 virDomainNetGetActualBridgeName(net),
-                                 net->ifname));
+            } else if (vport->virtPortType == VIR_NETDEV_VPORT_PROFILE_OPENVSWITCH &&
+                       net->ifname) {
+                /* collected here, removed in one batched ovs-vsctl
+                 * run once all interfaces have been torn down */
+                char *ovsPort = NULL;
+
+                if (VIR_STRDUP_QUIET(ovsPort, net->ifname) < 0 ||
+                    VIR_APPEND_ELEMENT(ovsPorts, novsPorts, ovsPort) < 0)
+                    VIR_FREE(ovsPort);
             }
         }
 
@@ -6117,6 +6125,13 @@ void qemuProcessStop(virQEMUDriverPtr driver,
         networkReleaseActualDevice(vm->def, net);
     }
 
+    if (novsPorts) {
+        ignore_value(virNetDevOpenvswitchRemovePorts(ovsPorts, novsPorts));
+        for (i = 0; i < novsPorts; i++)
+            VIR_FREE(ovsPorts[i]);
+        VIR_FREE(ovsPorts);
+    }
+
  retry:
     if ((ret = qemuRemoveCgroup(vm)) < 0) {
         if (ret == -EBUSY && (retries++ < 5)) {
@@ -6251,7 +6266,8 @@ int qemuProcessAttach(virConnectPtr conn ATTRIBUTE_UNUSED,
      * report implicit runtime defaults in the XML, like vnc listen/socket
      */
     VIR_DEBUG("Setting current domain def as transient");
-    if (virDomainObjSetDefTransient(caps, driver->xmlopt, vm) < 0)
+    if (virDomainObjSetDefTransient(caps, driver->xmlopt, vm,
+                                    priv->qemuCaps) < 0)
         goto error;
 
     vm->def->id = qemuDriverAllocateID(driver);
@@ -769,6 +769,7 @@ doRemoteOpen(virConnectPtr conn,
     char *name = NULL, *command = NULL, *sockname = NULL, *netcat = NULL;
     char *port = NULL, *authtype = NULL, *username = NULL;
     bool sanity = true, verify = true, tty ATTRIBUTE_UNUSED = true;
+    bool compress ATTRIBUTE_UNUSED = false;
     char *pkipath = NULL, *keyfile = NULL, *sshauth = NULL;
 
     char *knownHostsVerify = NULL,  *knownHosts = NULL;
@@ -822,6 +823,20 @@ doRemoteOpen(virConnectPtr conn,
             EXTRACT_URI_ARG_BOOL("no_verify", verify);
             EXTRACT_URI_ARG_BOOL("no_tty", tty);
 
+            /* Positive sense, so EXTRACT_URI_ARG_BOOL can't be used */
+            if (STRCASEEQ(var->name, "compress")) {
+                int tmp;
+                if (virStrToLong_i(var->value, NULL, 10, &tmp) < 0) {
+                    virReportError(VIR_ERR_INVALID_ARG,
+                                   _("Failed to parse value of URI component %s"),
+                                   var->name);
+                    goto failed;
+                }
+                compress = tmp != 0;
+                var->ignore = 1;
+                continue;
+            }
+
             if (STRCASEEQ(var->name, "authfile")) {
                 /* Strip this param, used by virauth.c */
                 var->ignore = 1;
@@ -1024,6 +1039,7 @@ doRemoteOpen(virConnectPtr conn,
                                                 username,
                                                 !tty,
                                                 !verify,
+                                                compress,
                                                 netcat ? netcat : "nc",
                                                 keyfile,
                                                 sockname)))
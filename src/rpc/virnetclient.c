@@ -60,6 +60,11 @@ struct _virNetClientCall {
     bool nonBlock;
     bool haveThread;
 
+    /* Calls issued as one pipelined batch share a counter of
+     * still incomplete thread-less siblings; the batch owner
+     * only finishes once it drops to zero */
+    size_t *batchRemaining;
+
     virCond cond;
 
     virNetClientCallPtr next;
@@ -369,6 +374,7 @@ virNetClientPtr virNetClientNewSSH(const char *nodename,
                                    const char *username,
                                    bool noTTY,
                                    bool noVerify,
+                                   bool compress,
                                    const char *netcat,
                                    const char *keyfile,
                                    const char *path)
@@ -376,7 +382,8 @@ virNetClientPtr virNetClientNewSSH(const char *nodename,
     virNetSocketPtr sock;
 
     if (virNetSocketNewConnectSSH(nodename, service, binary, username, noTTY,
-                                  noVerify, netcat, keyfile, path, &sock) < 0)
+                                  noVerify, compress, netcat, keyfile, path,
+                                  &sock) < 0)
         return NULL;
 
     return virNetClientNew(sock, NULL);
@@ -987,7 +994,7 @@ virNetClientCallDispatchReply(virNetClientPtr client)
         return -1;
     }
 
-    if (VIR_REALLOC_N(thecall->msg->buffer, client->msg.bufferLength) < 0)
+    if (virNetMessageBufferEnsure(thecall->msg, client->msg.bufferLength) < 0)
         return -1;
 
     memcpy(thecall->msg->buffer, client->msg.buffer, client->msg.bufferLength);
@@ -1234,7 +1241,7 @@ virNetClientIOReadMessage(virNetClientPtr client)
     /* Start by reading length word */
     if (client->msg.bufferLength == 0) {
         client->msg.bufferLength = 4;
-        if (VIR_ALLOC_N(client->msg.buffer, client->msg.bufferLength) < 0)
+        if (virNetMessageBufferEnsure(&client->msg, client->msg.bufferLength) < 0)
             return -ENOMEM;
     }
 
@@ -1366,6 +1373,12 @@ static bool virNetClientIOEventLoopRemoveDone(virNetClientCallPtr call,
     if (call->mode != VIR_NET_CLIENT_MODE_COMPLETE)
         return false;
 
+    /* A sleeping batch owner must stay queued until all its
+     * pipelined siblings have their replies too */
+    if (call->haveThread && call->batchRemaining &&
+        *call->batchRemaining > 0)
+        return false;
+
     /*
      * ...if the call being removed from the list
      * still has a thread, then wake that thread up,
@@ -1376,7 +1389,15 @@ static bool virNetClientIOEventLoopRemoveDone(virNetClientCallPtr call,
      * we release our mutex a short while
      * later...
      */
-    if (call->haveThread) {
+    if (call->batchRemaining && !call->haveThread) {
+        /* A pipelined sibling; the batch owner still references the
+         * message and will decode the reply from it, so only the
+         * call record is released here */
+        VIR_DEBUG("Removing completed batch call %p", call);
+        (*call->batchRemaining)--;
+        virCondDestroy(&call->cond);
+        VIR_FREE(call);
+    } else if (call->haveThread) {
         VIR_DEBUG("Waking up sleep %p", call);
         virCondSignal(&call->cond);
     } else {
@@ -1392,6 +1413,24 @@ static bool virNetClientIOEventLoopRemoveDone(virNetClientCallPtr call,
 }
 
 
+static bool
+virNetClientIOEventLoopRemoveBatch(virNetClientCallPtr call,
+                                   void *opaque)
+{
+    virNetClientCallPtr thiscall = opaque;
+
+    if (call == thiscall ||
+        call->haveThread ||
+        call->batchRemaining != thiscall->batchRemaining)
+        return false;
+
+    VIR_DEBUG("Removing batch call %p", call);
+    virCondDestroy(&call->cond);
+    VIR_FREE(call);
+    return true;
+}
+
+
 static void
 virNetClientIODetachNonBlocking(virNetClientCallPtr call)
 {
@@ -1589,8 +1628,11 @@ static int virNetClientIOEventLoop(virNetClientPtr client,
                                         virNetClientIOEventLoopRemoveDone,
                                         thiscall);
 
-        /* Now see if *we* are done */
-        if (thiscall->mode == VIR_NET_CLIENT_MODE_COMPLETE) {
+        /* Now see if *we* are done, including any pipelined
+         * siblings when this call heads a batch */
+        if (thiscall->mode == VIR_NET_CLIENT_MODE_COMPLETE &&
+            (!thiscall->batchRemaining ||
+             *thiscall->batchRemaining == 0)) {
             virNetClientCallRemove(&client->waitDispatch, thiscall);
             virNetClientIOEventLoopPassTheBuck(client, thiscall);
             return 0;
@@ -1620,6 +1662,10 @@ static int virNetClientIOEventLoop(virNetClientPtr client,
         virSetError(client->error);
     }
     virNetClientCallRemove(&client->waitDispatch, thiscall);
+    if (thiscall->batchRemaining)
+        virNetClientCallRemovePredicate(&client->waitDispatch,
+                                        virNetClientIOEventLoopRemoveBatch,
+                                        thiscall);
     virNetClientIOEventLoopPassTheBuck(client, thiscall);
     return -1;
 }
@@ -1769,7 +1815,9 @@ static int virNetClientIO(virNetClientPtr client,
          *     be the dispatcher to finish waiting for
          *     our reply
          */
-        if (thiscall->mode == VIR_NET_CLIENT_MODE_COMPLETE) {
+        if (thiscall->mode == VIR_NET_CLIENT_MODE_COMPLETE &&
+            (!thiscall->batchRemaining ||
+             *thiscall->batchRemaining == 0)) {
             rv = 0;
             /*
              * We avoided catching the buck and our reply is ready !
@@ -2012,6 +2060,86 @@ int virNetClientSendWithReply(virNetClientPtr client,
 }
 
 
+/*
+ * @msgs: an array of @nmsgs messages allocated on heap or stack
+ *
+ * Send a batch of messages pipelined on the wire, without waiting
+ * for the reply to one call before transmitting the next, then wait
+ * for all replies. Replies are decoded into the respective message
+ * on return, in whatever order the server produced them.
+ *
+ * The caller is responsible for free'ing the messages if they were
+ * allocated on the heap
+ *
+ * Returns 0 on success (all replies received), -1 on failure
+ */
+int virNetClientSendWithReplyBatch(virNetClientPtr client,
+                                   virNetMessagePtr *msgs,
+                                   size_t nmsgs)
+{
+    virNetClientCallPtr call;
+    size_t remaining = 0;
+    size_t i;
+    int ret = -1;
+
+    if (nmsgs == 0)
+        return 0;
+    if (nmsgs == 1)
+        return virNetClientSendWithReply(client, msgs[0]);
+
+    virObjectLock(client);
+
+    if (!client->sock || client->wantClose) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("client socket is closed"));
+        goto cleanup;
+    }
+
+    /* Queue all but the last message as thread-less calls tied to
+     * this batch; they go onto the wire back-to-back without waiting
+     * for earlier replies */
+    for (i = 0; i < nmsgs - 1; i++) {
+        virNetClientCallPtr sibling;
+
+        if (!(sibling = virNetClientCallNew(msgs[i], true, false)))
+            goto purge;
+
+        sibling->batchRemaining = &remaining;
+        remaining++;
+        virNetClientCallQueue(&client->waitDispatch, sibling);
+    }
+
+    if (!(call = virNetClientCallNew(msgs[nmsgs - 1], true, false)))
+        goto purge;
+
+    call->haveThread = true;
+    call->batchRemaining = &remaining;
+
+    ret = virNetClientIO(client, call);
+
+    virCondDestroy(&call->cond);
+    VIR_FREE(call);
+
+    /* On failure any still queued siblings reference our stack
+     * based counter, so they must not outlive this call frame */
+    if (ret < 0)
+        goto purge;
+
+ cleanup:
+    virObjectUnlock(client);
+    return ret < 0 ? -1 : 0;
+
+ purge:
+    {
+        virNetClientCall purgecall = { .batchRemaining = &remaining };
+        virNetClientCallRemovePredicate(&client->waitDispatch,
+                                        virNetClientIOEventLoopRemoveBatch,
+                                        &purgecall);
+    }
+    goto cleanup;
+}
+
+
 /*
  * @msg: a message allocated on heap or stack
  *
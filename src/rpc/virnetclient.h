@@ -50,6 +50,7 @@ virNetClientPtr virNetClientNewSSH(const char *nodename,
                                    const char *username,
                                    bool noTTY,
                                    bool noVerify,
+                                   bool compress,
                                    const char *netcat,
                                    const char *keyfile,
                                    const char *path);
@@ -98,6 +99,10 @@ void virNetClientRemoveStream(virNetClientPtr client,
 int virNetClientSendWithReply(virNetClientPtr client,
                               virNetMessagePtr msg);
 
+int virNetClientSendWithReplyBatch(virNetClientPtr client,
+                                   virNetMessagePtr *msgs,
+                                   size_t nmsgs);
+
 int virNetClientSendNoReply(virNetClientPtr client,
                             virNetMessagePtr msg);
 
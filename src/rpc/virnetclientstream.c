@@ -283,8 +283,10 @@ int virNetClientStreamQueuePacket(virNetClientStreamPtr st,
     tmp_msg->buffer = msg->buffer;
     tmp_msg->bufferLength = msg->bufferLength;
     tmp_msg->bufferOffset = msg->bufferOffset;
+    tmp_msg->bufferCapacity = msg->bufferCapacity;
     msg->buffer = NULL;
     msg->bufferLength = msg->bufferOffset = 0;
+    msg->bufferCapacity = 0;
 
     virObjectLock(st);
 
@@ -40,6 +40,7 @@
 #include "virhash.h"
 #include "virstring.h"
 #include "virsystemd.h"
+#include "vireventepoll.h"
 
 #ifndef SA_SIGINFO
 # define SA_SIGINFO 0
@@ -79,6 +80,8 @@ struct _virNetDaemon {
     size_t autoShutdownInhibitions;
     bool autoShutdownCallingInhibit;
     int autoShutdownInhibitFd;
+
+    size_t nWorkerEventLoops;
 };
 
 
@@ -92,6 +95,9 @@ virNetDaemonDispose(void *obj)
 
     VIR_FORCE_CLOSE(dmn->autoShutdownInhibitFd);
 
+    if (dmn->nWorkerEventLoops)
+        virEventEpollWorkersStop();
+
     for (i = 0; i < dmn->nsignals; i++) {
         sigaction(dmn->signals[i]->signum, &dmn->signals[i]->oldaction, NULL);
         VIR_FREE(dmn->signals[i]);
@@ -424,6 +430,45 @@ virNetDaemonIsPrivileged(virNetDaemonPtr dmn)
 }
 
 
+/**
+ * virNetDaemonSetWorkerEventLoops:
+ * @dmn: the daemon to configure
+ * @nloops: number of worker event loop threads to spawn
+ *
+ * Spawns @nloops threads each driving a private event loop, and
+ * arranges for the I/O of subsequently accepted clients to be
+ * sharded over them by file descriptor. The main event loop keeps
+ * handling listener sockets, timers and signals. Must be called
+ * before virNetDaemonRun().
+ *
+ * Returns 0 on success, -1 on error
+ */
+int
+virNetDaemonSetWorkerEventLoops(virNetDaemonPtr dmn,
+                                size_t nloops)
+{
+    int ret = -1;
+
+    virObjectLock(dmn);
+
+    if (dmn->nWorkerEventLoops) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("Worker event loops are already configured"));
+        goto cleanup;
+    }
+
+    if (virEventEpollWorkersStart(nloops) < 0)
+        goto cleanup;
+
+    dmn->nWorkerEventLoops = nloops;
+    ret = 0;
+
+ cleanup:
+    virObjectUnlock(dmn);
+    return ret;
+}
+
+
 void
 virNetDaemonAutoShutdown(virNetDaemonPtr dmn,
                          unsigned int timeout)
@@ -56,6 +56,9 @@ typedef int (*virNetDaemonAutoShutdownFunc)(virNetDaemonPtr dmn, void *opaque);
 
 bool virNetDaemonIsPrivileged(virNetDaemonPtr dmn);
 
+int virNetDaemonSetWorkerEventLoops(virNetDaemonPtr dmn,
+                                    size_t nloops);
+
 void virNetDaemonAutoShutdown(virNetDaemonPtr dmn,
                               unsigned int timeout);
 
@@ -25,9 +25,11 @@
 
 #include "virnetmessage.h"
 #include "viralloc.h"
+#include "viratomic.h"
 #include "virerror.h"
 #include "virlog.h"
 #include "virfile.h"
+#include "virthread.h"
 #include "virutil.h"
 #include "virstring.h"
 
@@ -35,6 +37,89 @@
 
 VIR_LOG_INIT("rpc.netmessage");
 
+/* Nearly every RPC message needs a buffer of the standard initial
+ * size, which is immediately freed again once the call completes.
+ * Rather than hitting the allocator for 64kb on every call, keep a
+ * small pool of released buffers for reuse. Buffers which grew
+ * beyond the standard size are always freed, so a burst of large
+ * messages does not pin memory indefinitely. */
+#define VIR_NET_MESSAGE_BUFFER_POOL_SIZE \
+    (VIR_NET_MESSAGE_INITIAL + VIR_NET_MESSAGE_LEN_MAX)
+#define VIR_NET_MESSAGE_BUFFER_POOL_MAX 16
+
+static virMutex virNetMessageBufferPoolLock = VIR_MUTEX_INITIALIZER;
+static char *virNetMessageBufferPool[VIR_NET_MESSAGE_BUFFER_POOL_MAX];
+static size_t virNetMessageBufferPoolCount;
+
+struct _virNetMessagePayload {
+    int refs;
+    char *data;
+    size_t len;
+};
+
+
+/**
+ * virNetMessageBufferEnsure:
+ * @msg: message requiring buffer space
+ * @length: minimum required buffer length in bytes
+ *
+ * Ensure that @msg->buffer can hold at least @length bytes of
+ * data, recycling a buffer from the pool where possible. The
+ * buffer is never shrunk, so a message which repeatedly adjusts
+ * bufferLength does not trigger repeated reallocation.
+ *
+ * Returns 0 on success, -1 on OOM
+ */
+int virNetMessageBufferEnsure(virNetMessagePtr msg,
+                              size_t length)
+{
+    if (length <= msg->bufferCapacity)
+        return 0;
+
+    if (!msg->buffer &&
+        length <= VIR_NET_MESSAGE_BUFFER_POOL_SIZE) {
+        virMutexLock(&virNetMessageBufferPoolLock);
+        if (virNetMessageBufferPoolCount > 0)
+            msg->buffer =
+                virNetMessageBufferPool[--virNetMessageBufferPoolCount];
+        virMutexUnlock(&virNetMessageBufferPoolLock);
+
+        if (msg->buffer) {
+            msg->bufferCapacity = VIR_NET_MESSAGE_BUFFER_POOL_SIZE;
+            return 0;
+        }
+
+        /* Allocate the standard size up front, so the buffer is
+         * eligible for the pool once the message is released */
+        length = VIR_NET_MESSAGE_BUFFER_POOL_SIZE;
+    }
+
+    if (VIR_REALLOC_N(msg->buffer, length) < 0)
+        return -1;
+
+    msg->bufferCapacity = length;
+    return 0;
+}
+
+
+static void virNetMessageBufferRelease(virNetMessagePtr msg)
+{
+    if (msg->buffer &&
+        msg->bufferCapacity == VIR_NET_MESSAGE_BUFFER_POOL_SIZE) {
+        virMutexLock(&virNetMessageBufferPoolLock);
+        if (virNetMessageBufferPoolCount < VIR_NET_MESSAGE_BUFFER_POOL_MAX) {
+            virNetMessageBufferPool[virNetMessageBufferPoolCount++] =
+                msg->buffer;
+            msg->buffer = NULL;
+        }
+        virMutexUnlock(&virNetMessageBufferPoolLock);
+    }
+
+    VIR_FREE(msg->buffer);
+    msg->bufferCapacity = 0;
+}
+
+
 virNetMessagePtr virNetMessageNew(bool tracked)
 {
     virNetMessagePtr msg;
@@ -63,7 +148,18 @@ virNetMessageClearPayload(virNetMessagePtr msg)
 
     msg->bufferOffset = 0;
     msg->bufferLength = 0;
-    VIR_FREE(msg->buffer);
+    virNetMessageBufferRelease(msg);
+
+    msg->externalOffset = 0;
+    msg->externalLength = 0;
+    if (msg->sharedPayload) {
+        /* @external only borrows the shared payload body */
+        msg->external = NULL;
+        virNetMessagePayloadUnref(msg->sharedPayload);
+        msg->sharedPayload = NULL;
+    } else {
+        VIR_FREE(msg->external);
+    }
 }
 
 
@@ -154,7 +250,7 @@ int virNetMessageDecodeLength(virNetMessagePtr msg)
     /* Extend our declared buffer length and carry
        on reading the header + payload */
     msg->bufferLength += len;
-    if (VIR_REALLOC_N(msg->buffer, msg->bufferLength) < 0)
+    if (virNetMessageBufferEnsure(msg, msg->bufferLength) < 0)
         goto cleanup;
 
     VIR_DEBUG("Got length, now need %zu total (%u more)",
@@ -231,7 +327,7 @@ int virNetMessageEncodeHeader(virNetMessagePtr msg)
     unsigned int len = 0;
 
     msg->bufferLength = VIR_NET_MESSAGE_INITIAL + VIR_NET_MESSAGE_LEN_MAX;
-    if (VIR_REALLOC_N(msg->buffer, msg->bufferLength) < 0)
+    if (virNetMessageBufferEnsure(msg, msg->bufferLength) < 0)
         return ret;
     msg->bufferOffset = 0;
 
@@ -350,6 +446,25 @@ int virNetMessageEncodePayload(virNetMessagePtr msg,
     XDR xdr;
     unsigned int msglen;
 
+#ifdef HAVE_XDR_SIZEOF
+    /* Size the buffer upfront where we can, since each trip around
+     * the grow loop below restarts the encode of the entire payload
+     * from scratch. Sizing is much cheaper than a failed encode, so
+     * large replies are then encoded in a single pass. */
+    {
+        unsigned long wantlen = xdr_sizeof(filter, data);
+
+        if (wantlen > msg->bufferLength - msg->bufferOffset &&
+            msg->bufferOffset + wantlen - VIR_NET_MESSAGE_LEN_MAX <=
+            VIR_NET_MESSAGE_MAX) {
+            msg->bufferLength = msg->bufferOffset + wantlen;
+
+            if (virNetMessageBufferEnsure(msg, msg->bufferLength) < 0)
+                return -1;
+        }
+    }
+#endif
+
     /* Serialise payload of the message. This assumes that
      * virNetMessageEncodeHeader has already been run, so
      * just appends to that data */
@@ -369,7 +484,7 @@ int virNetMessageEncodePayload(virNetMessagePtr msg,
 
         msg->bufferLength = newlen + VIR_NET_MESSAGE_LEN_MAX;
 
-        if (VIR_REALLOC_N(msg->buffer, msg->bufferLength) < 0)
+        if (virNetMessageBufferEnsure(msg, msg->bufferLength) < 0)
             goto error;
 
         xdrmem_create(&xdr, msg->buffer + msg->bufferOffset,
@@ -453,7 +568,7 @@ int virNetMessageEncodePayloadRaw(virNetMessagePtr msg,
 
         msg->bufferLength = msg->bufferOffset + len;
 
-        if (VIR_REALLOC_N(msg->buffer, msg->bufferLength) < 0)
+        if (virNetMessageBufferEnsure(msg, msg->bufferLength) < 0)
             return -1;
 
         VIR_DEBUG("Increased message buffer length = %zu", msg->bufferLength);
@@ -482,6 +597,250 @@ int virNetMessageEncodePayloadRaw(virNetMessagePtr msg,
 }
 
 
+/*
+ * Zero-copy variant of virNetMessageEncodePayloadRaw. Rather than
+ * copying @*buf into the message buffer, ownership of the allocated
+ * buffer is transferred to the message and it is sent on the wire
+ * directly after the encoded header. On success @*buf is cleared.
+ */
+int virNetMessageEncodePayloadRawSteal(virNetMessagePtr msg,
+                                       char **buf,
+                                       size_t len)
+{
+    XDR xdr;
+    unsigned int msglen;
+
+    if ((msg->bufferOffset + len) >
+        (VIR_NET_MESSAGE_MAX + VIR_NET_MESSAGE_LEN_MAX)) {
+        virReportError(VIR_ERR_RPC,
+                       _("Stream data too long to send "
+                         "(%zu bytes needed, %zu bytes available)"),
+                       len,
+                       VIR_NET_MESSAGE_MAX +
+                       VIR_NET_MESSAGE_LEN_MAX -
+                       msg->bufferOffset);
+        return -1;
+    }
+
+    /* Re-encode the length word to cover the external payload too. */
+    VIR_DEBUG("Encode length as %zu", msg->bufferOffset + len);
+    xdrmem_create(&xdr, msg->buffer, VIR_NET_MESSAGE_HEADER_XDR_LEN, XDR_ENCODE);
+    msglen = msg->bufferOffset + len;
+    if (!xdr_u_int(&xdr, &msglen)) {
+        virReportError(VIR_ERR_RPC, "%s", _("Unable to encode message length"));
+        goto error;
+    }
+    xdr_destroy(&xdr);
+
+    msg->external = *buf;
+    msg->externalLength = len;
+    msg->externalOffset = 0;
+    *buf = NULL;
+
+    msg->bufferLength = msg->bufferOffset;
+    msg->bufferOffset = 0;
+    return 0;
+
+ error:
+    xdr_destroy(&xdr);
+    return -1;
+}
+
+
+/*
+ * virNetMessagePayloadNewEncoded:
+ * @filter: stub to XDR encode @data
+ * @data: the data to encode
+ *
+ * Encode @data into a standalone reference counted payload body
+ * which can back the external payload of any number of messages
+ * via virNetMessageEncodePayloadShared(), so the encoding cost is
+ * paid only once however many recipients there are.
+ *
+ * Returns the new payload with one reference, or NULL on error
+ */
+virNetMessagePayloadPtr virNetMessagePayloadNewEncoded(xdrproc_t filter,
+                                                       void *data)
+{
+    virNetMessagePayloadPtr payload;
+    XDR xdr;
+    size_t len = VIR_NET_MESSAGE_INITIAL;
+
+    if (VIR_ALLOC(payload) < 0)
+        return NULL;
+
+    if (VIR_ALLOC_N(payload->data, len) < 0)
+        goto error;
+
+ retry:
+    xdrmem_create(&xdr, payload->data, len, XDR_ENCODE);
+
+    if (!(*filter)(&xdr, data)) {
+        size_t newlen = len * 4;
+
+        xdr_destroy(&xdr);
+
+        if (newlen > VIR_NET_MESSAGE_MAX) {
+            virReportError(VIR_ERR_RPC, "%s",
+                           _("Unable to encode message payload"));
+            goto error;
+        }
+
+        if (VIR_REALLOC_N(payload->data, newlen) < 0)
+            goto error;
+        len = newlen;
+
+        VIR_DEBUG("Increased payload buffer length = %zu", len);
+        goto retry;
+    }
+
+    payload->len = xdr_getpos(&xdr);
+    xdr_destroy(&xdr);
+
+    payload->refs = 1;
+    return payload;
+
+ error:
+    VIR_FREE(payload->data);
+    VIR_FREE(payload);
+    return NULL;
+}
+
+
+virNetMessagePayloadPtr virNetMessagePayloadRef(virNetMessagePayloadPtr payload)
+{
+    virAtomicIntInc(&payload->refs);
+    return payload;
+}
+
+
+void virNetMessagePayloadUnref(virNetMessagePayloadPtr payload)
+{
+    if (!payload)
+        return;
+
+    if (!virAtomicIntDecAndTest(&payload->refs))
+        return;
+
+    VIR_FREE(payload->data);
+    VIR_FREE(payload);
+}
+
+
+/*
+ * virNetMessageEncodePayloadShared:
+ * @msg: the message to finish
+ * @payload: the encoded payload body to attach
+ *
+ * Attach @payload as the external payload of @msg, following any
+ * data already encoded into the message buffer, and re-encode the
+ * length word to match. The message keeps a reference on @payload
+ * until its payload is cleared. Must be the last encoding step.
+ *
+ * Returns 0 on success, -1 on error
+ */
+int virNetMessageEncodePayloadShared(virNetMessagePtr msg,
+                                     virNetMessagePayloadPtr payload)
+{
+    XDR xdr;
+    unsigned int msglen;
+
+    if ((msg->bufferOffset + payload->len) >
+        (VIR_NET_MESSAGE_MAX + VIR_NET_MESSAGE_LEN_MAX)) {
+        virReportError(VIR_ERR_RPC,
+                       _("Message payload too long to send "
+                         "(%zu bytes needed, %zu bytes available)"),
+                       payload->len,
+                       VIR_NET_MESSAGE_MAX +
+                       VIR_NET_MESSAGE_LEN_MAX -
+                       msg->bufferOffset);
+        return -1;
+    }
+
+    /* An earlier encode step may have re-encoded the length word
+     * and reset the offsets ready for sending; undo that so the
+     * shared body lands after the data already in the buffer */
+    if (msg->bufferOffset == 0)
+        msg->bufferOffset = msg->bufferLength;
+
+    /* Re-encode the length word to cover the shared payload too. */
+    VIR_DEBUG("Encode length as %zu", msg->bufferOffset + payload->len);
+    xdrmem_create(&xdr, msg->buffer, VIR_NET_MESSAGE_HEADER_XDR_LEN, XDR_ENCODE);
+    msglen = msg->bufferOffset + payload->len;
+    if (!xdr_u_int(&xdr, &msglen)) {
+        virReportError(VIR_ERR_RPC, "%s", _("Unable to encode message length"));
+        xdr_destroy(&xdr);
+        return -1;
+    }
+    xdr_destroy(&xdr);
+
+    msg->sharedPayload = virNetMessagePayloadRef(payload);
+    msg->external = payload->data;
+    msg->externalLength = payload->len;
+    msg->externalOffset = 0;
+
+    msg->bufferLength = msg->bufferOffset;
+    msg->bufferOffset = 0;
+    return 0;
+}
+
+
+
+/*
+ * Returns true if any part of the message, including an external
+ * payload, still has to be written to the wire.
+ */
+bool virNetMessageSendPending(virNetMessagePtr msg)
+{
+    return msg->bufferOffset < msg->bufferLength ||
+        msg->externalOffset < msg->externalLength;
+}
+
+
+/*
+ * Fill @iov with the unsent portions of the message buffer and
+ * any external payload, for submission with writev().
+ * Returns the number of entries used.
+ */
+size_t virNetMessageGetSendIOV(virNetMessagePtr msg,
+                               struct iovec iov[2])
+{
+    size_t niov = 0;
+
+    if (msg->bufferOffset < msg->bufferLength) {
+        iov[niov].iov_base = msg->buffer + msg->bufferOffset;
+        iov[niov].iov_len = msg->bufferLength - msg->bufferOffset;
+        niov++;
+    }
+    if (msg->externalOffset < msg->externalLength) {
+        iov[niov].iov_base = msg->external + msg->externalOffset;
+        iov[niov].iov_len = msg->externalLength - msg->externalOffset;
+        niov++;
+    }
+
+    return niov;
+}
+
+
+/*
+ * Record that @len further bytes of the message, spanning the
+ * message buffer and then any external payload, hit the wire.
+ */
+void virNetMessageMarkSent(virNetMessagePtr msg,
+                           size_t len)
+{
+    size_t got;
+
+    got = msg->bufferLength - msg->bufferOffset;
+    if (got > len)
+        got = len;
+    msg->bufferOffset += got;
+    len -= got;
+
+    msg->externalOffset += len;
+}
+
+
 int virNetMessageEncodePayloadEmpty(virNetMessagePtr msg)
 {
     XDR xdr;
@@ -21,6 +21,17 @@
 #ifndef __VIR_NET_MESSAGE_H__
 # define __VIR_NET_MESSAGE_H__
 
+# ifdef HAVE_SYS_UIO_H
+#  include <sys/uio.h>
+# else
+/* Win32 lacks readv/writev entirely; provide the struct so the
+ * iovec based helpers keep a uniform signature everywhere */
+struct iovec {
+    void *iov_base;
+    size_t iov_len;
+};
+# endif
+
 # include "virnetprotocol.h"
 
 typedef struct virNetMessageHeader *virNetMessageHeaderPtr;
@@ -29,6 +40,13 @@ typedef struct virNetMessageError *virNetMessageErrorPtr;
 typedef struct _virNetMessage virNetMessage;
 typedef virNetMessage *virNetMessagePtr;
 
+/* An immutable, reference counted, XDR encoded payload body which
+ * can back the external payload of many messages at once, so an
+ * identical event needs encoding only once however many clients
+ * are subscribed to it */
+typedef struct _virNetMessagePayload virNetMessagePayload;
+typedef virNetMessagePayload *virNetMessagePayloadPtr;
+
 typedef void (*virNetMessageFreeCallback)(virNetMessagePtr msg, void *opaque);
 
 struct _virNetMessage {
@@ -38,6 +56,18 @@ struct _virNetMessage {
                   /* Maximum   VIR_NET_MESSAGE_MAX     + VIR_NET_MESSAGE_LEN_MAX */
     size_t bufferLength;
     size_t bufferOffset;
+    size_t bufferCapacity; /* Allocated size of @buffer; may exceed
+                            * bufferLength when recycled from the pool */
+
+    /* Optional external payload, sent on the wire after the data
+     * in @buffer without ever being copied into it. Owned by the
+     * message and freed together with the other payload data,
+     * unless it borrows the body of @sharedPayload, in which case
+     * only the reference is dropped. */
+    char *external;
+    size_t externalLength;
+    size_t externalOffset;
+    virNetMessagePayloadPtr sharedPayload;
 
     virNetMessageHeader header;
 
@@ -66,6 +96,10 @@ void virNetMessageQueuePush(virNetMessagePtr *queue,
                             virNetMessagePtr msg)
     ATTRIBUTE_NONNULL(1) ATTRIBUTE_NONNULL(2);
 
+int virNetMessageBufferEnsure(virNetMessagePtr msg,
+                              size_t length)
+    ATTRIBUTE_NONNULL(1) ATTRIBUTE_RETURN_CHECK;
+
 int virNetMessageEncodeHeader(virNetMessagePtr msg)
     ATTRIBUTE_NONNULL(1) ATTRIBUTE_RETURN_CHECK;
 int virNetMessageDecodeLength(virNetMessagePtr msg)
@@ -89,6 +123,27 @@ int virNetMessageEncodePayloadRaw(virNetMessagePtr msg,
                                   const char *buf,
                                   size_t len)
     ATTRIBUTE_NONNULL(1) ATTRIBUTE_RETURN_CHECK;
+int virNetMessageEncodePayloadRawSteal(virNetMessagePtr msg,
+                                       char **buf,
+                                       size_t len)
+    ATTRIBUTE_NONNULL(1) ATTRIBUTE_NONNULL(2) ATTRIBUTE_RETURN_CHECK;
+virNetMessagePayloadPtr virNetMessagePayloadNewEncoded(xdrproc_t filter,
+                                                       void *data)
+    ATTRIBUTE_NONNULL(1) ATTRIBUTE_NONNULL(2);
+virNetMessagePayloadPtr virNetMessagePayloadRef(virNetMessagePayloadPtr payload)
+    ATTRIBUTE_NONNULL(1);
+void virNetMessagePayloadUnref(virNetMessagePayloadPtr payload);
+int virNetMessageEncodePayloadShared(virNetMessagePtr msg,
+                                     virNetMessagePayloadPtr payload)
+    ATTRIBUTE_NONNULL(1) ATTRIBUTE_NONNULL(2) ATTRIBUTE_RETURN_CHECK;
+bool virNetMessageSendPending(virNetMessagePtr msg)
+    ATTRIBUTE_NONNULL(1);
+size_t virNetMessageGetSendIOV(virNetMessagePtr msg,
+                               struct iovec iov[2])
+    ATTRIBUTE_NONNULL(1) ATTRIBUTE_NONNULL(2);
+void virNetMessageMarkSent(virNetMessagePtr msg,
+                           size_t len)
+    ATTRIBUTE_NONNULL(1);
 int virNetMessageEncodePayloadEmpty(virNetMessagePtr msg)
     ATTRIBUTE_NONNULL(1) ATTRIBUTE_RETURN_CHECK;
 
@@ -69,6 +69,8 @@ struct _virNetServer {
     size_t nclients_max;                /* Max allowed clients count */
     size_t nclients_unauth;             /* Unauthenticated clients count */
     size_t nclients_unauth_max;         /* Max allowed unauth clients count */
+    size_t clientRateLimit;             /* Max requests accepted from one
+                                         * client per second; 0 = unlimited */
 
     int keepaliveInterval;
     unsigned int keepaliveCount;
@@ -296,6 +298,9 @@ int virNetServerAddClient(virNetServerPtr srv,
                                     virNetServerDispatchNewMessage,
                                     srv);
 
+    if (srv->clientRateLimit)
+        virNetServerClientSetRateLimit(client, srv->clientRateLimit);
+
     virNetServerClientInitKeepAlive(client, srv->keepaliveInterval,
                                     srv->keepaliveCount);
 
@@ -905,7 +910,11 @@ virNetServerGetThreadPoolParameters(virNetServerPtr srv,
                                     size_t *nWorkers,
                                     size_t *freeWorkers,
                                     size_t *nPrioWorkers,
-                                    size_t *jobQueueDepth)
+                                    size_t *jobQueueDepth,
+                                    size_t *jobQueueDepthMax,
+                                    unsigned long long *jobsCompleted,
+                                    unsigned long long *busyTime,
+                                    unsigned long long *queueWaitTime)
 {
     virObjectLock(srv);
 
@@ -915,6 +924,10 @@ virNetServerGetThreadPoolParameters(virNetServerPtr srv,
     *nWorkers = virThreadPoolGetCurrentWorkers(srv->workers);
     *nPrioWorkers = virThreadPoolGetPriorityWorkers(srv->workers);
     *jobQueueDepth = virThreadPoolGetJobQueueDepth(srv->workers);
+    *jobQueueDepthMax = virThreadPoolGetJobQueueDepthMax(srv->workers);
+    *jobsCompleted = virThreadPoolGetJobsCompleted(srv->workers);
+    *busyTime = virThreadPoolGetBusyTime(srv->workers);
+    *queueWaitTime = virThreadPoolGetQueueWaitTime(srv->workers);
 
     virObjectUnlock(srv);
     return 0;
@@ -936,6 +949,16 @@ virNetServerSetThreadPoolParameters(virNetServerPtr srv,
     return ret;
 }
 
+void
+virNetServerSetJobPromoteDelay(virNetServerPtr srv,
+                               unsigned long long delay)
+{
+    virObjectLock(srv);
+    if (srv->workers)
+        virThreadPoolSetPromoteDelay(srv->workers, delay);
+    virObjectUnlock(srv);
+}
+
 size_t
 virNetServerGetMaxClients(virNetServerPtr srv)
 {
@@ -1039,10 +1062,12 @@ virNetServerGetClient(virNetServerPtr srv,
 int
 virNetServerSetClientLimits(virNetServerPtr srv,
                             long long int maxClients,
-                            long long int maxClientsUnauth)
+                            long long int maxClientsUnauth,
+                            long long int clientRateLimit)
 {
     int ret = -1;
     size_t max, max_unauth;
+    size_t i;
 
     virObjectLock(srv);
 
@@ -1064,6 +1089,14 @@ virNetServerSetClientLimits(virNetServerPtr srv,
     if (maxClientsUnauth >= 0)
         srv->nclients_unauth_max = maxClientsUnauth;
 
+    if (clientRateLimit >= 0) {
+        srv->clientRateLimit = clientRateLimit;
+        /* Apply to clients that are already connected too, so a
+         * noisy neighbor can be reined in without a reconnect */
+        for (i = 0; i < srv->nclients; i++)
+            virNetServerClientSetRateLimit(srv->clients[i], clientRateLimit);
+    }
+
     virNetServerCheckLimits(srv);
 
     ret = 0;
@@ -1071,3 +1104,15 @@ virNetServerSetClientLimits(virNetServerPtr srv,
     virObjectUnlock(srv);
     return ret;
 }
+
+size_t
+virNetServerGetClientRateLimit(virNetServerPtr srv)
+{
+    size_t limit;
+
+    virObjectLock(srv);
+    limit = srv->clientRateLimit;
+    virObjectUnlock(srv);
+
+    return limit;
+}
@@ -96,13 +96,20 @@ int virNetServerGetThreadPoolParameters(virNetServerPtr srv,
                                         size_t *nWorkers,
                                         size_t *freeWorkers,
                                         size_t *nPrioWorkers,
-                                        size_t *jobQueueDepth);
+                                        size_t *jobQueueDepth,
+                                        size_t *jobQueueDepthMax,
+                                        unsigned long long *jobsCompleted,
+                                        unsigned long long *busyTime,
+                                        unsigned long long *queueWaitTime);
 
 int virNetServerSetThreadPoolParameters(virNetServerPtr srv,
                                         long long int minWorkers,
                                         long long int maxWorkers,
                                         long long int prioWorkers);
 
+void virNetServerSetJobPromoteDelay(virNetServerPtr srv,
+                                    unsigned long long delay);
+
 unsigned long long virNetServerNextClientID(virNetServerPtr srv);
 
 virNetServerClientPtr virNetServerGetClient(virNetServerPtr srv,
@@ -115,9 +122,11 @@ size_t virNetServerGetMaxClients(virNetServerPtr srv);
 size_t virNetServerGetCurrentClients(virNetServerPtr srv);
 size_t virNetServerGetMaxUnauthClients(virNetServerPtr srv);
 size_t virNetServerGetCurrentUnauthClients(virNetServerPtr srv);
+size_t virNetServerGetClientRateLimit(virNetServerPtr srv);
 
 int virNetServerSetClientLimits(virNetServerPtr srv,
                                 long long int maxClients,
-                                long long int maxClientsUnauth);
+                                long long int maxClientsUnauth,
+                                long long int clientRateLimit);
 
 #endif /* __VIR_NET_SERVER_H__ */
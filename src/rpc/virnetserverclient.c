@@ -38,6 +38,8 @@
 #include "virkeepalive.h"
 #include "virprobe.h"
 #include "virstring.h"
+#include "virtime.h"
+#include "vireventepoll.h"
 #include "virutil.h"
 
 #define VIR_FROM_THIS VIR_FROM_RPC
@@ -99,6 +101,16 @@ struct _virNetServerClient
      * throttling calculations */
     size_t nrequests;
     size_t nrequests_max;
+    /* Token bucket limiting the rate at which requests from this
+     * client are accepted for processing; 0 means unlimited. The
+     * bucket is replenished at 'rateLimit' tokens per second up to
+     * a burst of 'rateLimit', and one token is taken each time a
+     * receive buffer is set up for the next request. */
+    size_t rateLimit;
+    size_t rateTokens;
+    unsigned long long rateLastFill; /* Time of last refill in ms */
+    int rateTimer; /* Timer resuming the receive queue once a token
+                    * is due for a client throttled by the bucket */
     /* Zero or one messages being received. Zero if
      * nrequests >= max_clients and throttling */
     virNetMessagePtr rx;
@@ -180,7 +192,8 @@ virNetServerClientCalculateHandleMode(virNetServerClientPtr client)
         case VIR_NET_TLS_HANDSHAKE_COMPLETE:
             if (client->rx)
                 mode |= VIR_EVENT_HANDLE_READABLE;
-            if (client->tx)
+            if (client->tx ||
+                virNetTLSSessionHasPendingWrite(client->tls))
                 mode |= VIR_EVENT_HANDLE_WRITABLE;
         }
     } else {
@@ -215,6 +228,11 @@ static int virNetServerClientRegisterEvent(virNetServerClientPtr client)
 
     virObjectRef(client);
     VIR_DEBUG("Registering client event callback %d", mode);
+    /* Shard client I/O over the worker event loops, if the daemon
+     * has started any; falls back to the default event loop */
+    virNetSocketSetEventLoop(client->sock,
+                             virEventEpollWorkerLoopForFD(
+                                 virNetSocketGetFD(client->sock)));
     if (virNetSocketAddIOCallback(client->sock,
                                   mode,
                                   virNetServerClientDispatchEvent,
@@ -326,7 +344,7 @@ virNetServerClientCheckAccess(virNetServerClientPtr client)
      * (NB. The '\1' byte is sent in an encrypted record).
      */
     confirm->bufferLength = 1;
-    if (VIR_ALLOC_N(confirm->buffer, confirm->bufferLength) < 0) {
+    if (virNetMessageBufferEnsure(confirm, confirm->bufferLength) < 0) {
         virNetMessageFree(confirm);
         return -1;
     }
@@ -354,6 +372,83 @@ static void virNetServerClientSockTimerFunc(int timer,
 }
 
 
+/*
+ * Refill the request token bucket and try to take a token for the
+ * next receive buffer. The client must be locked.
+ *
+ * Returns true if the caller may set up another receive buffer, false
+ * if the client must wait; in the latter case the rate timer is armed
+ * for the moment the next token becomes available.
+ */
+static bool
+virNetServerClientRateAcquire(virNetServerClientPtr client)
+{
+    unsigned long long now;
+    unsigned long long next;
+    int wait;
+
+    if (client->rateLimit == 0)
+        return true;
+
+    /* Never block progress when there is no clock to refill from */
+    if (virTimeMillisNow(&now) < 0)
+        return true;
+
+    if (now > client->rateLastFill) {
+        size_t add = (now - client->rateLastFill) * client->rateLimit / 1000;
+
+        if (add) {
+            client->rateTokens = MIN(client->rateTokens + add,
+                                     client->rateLimit);
+            /* Advance by the time the granted tokens correspond to,
+             * keeping the sub-token remainder for the next refill */
+            client->rateLastFill += add * 1000 / client->rateLimit;
+        }
+        if (client->rateTokens == client->rateLimit)
+            client->rateLastFill = now;
+    }
+
+    if (client->rateTokens > 0) {
+        client->rateTokens--;
+        return true;
+    }
+
+    next = client->rateLastFill + 1000 / client->rateLimit;
+    wait = next > now ? next - now : 1;
+    virEventUpdateTimeout(client->rateTimer, wait);
+    return false;
+}
+
+
+static void virNetServerClientRateTimerFunc(int timer,
+                                            void *opaque)
+{
+    virNetServerClientPtr client = opaque;
+
+    virObjectLock(client);
+    virEventUpdateTimeout(timer, -1);
+    /* The receive queue may have been resumed by a completed
+     * transmission while this timer was pending */
+    if (!client->rx &&
+        client->nrequests < client->nrequests_max &&
+        virNetServerClientRateAcquire(client)) {
+        if (!(client->rx = virNetMessageNew(true))) {
+            client->wantClose = true;
+        } else {
+            client->rx->bufferLength = VIR_NET_MESSAGE_LEN_MAX;
+            if (virNetMessageBufferEnsure(client->rx,
+                                          client->rx->bufferLength) < 0) {
+                client->wantClose = true;
+            } else {
+                client->nrequests++;
+            }
+        }
+        virNetServerClientUpdateEvent(client);
+    }
+    virObjectUnlock(client);
+}
+
+
 static virNetServerClientPtr
 virNetServerClientNewInternal(unsigned long long id,
                               virNetSocketPtr sock,
@@ -388,11 +483,16 @@ virNetServerClientNewInternal(unsigned long long id,
     if (client->sockTimer < 0)
         goto error;
 
+    client->rateTimer = virEventAddTimeout(-1, virNetServerClientRateTimerFunc,
+                                           client, NULL);
+    if (client->rateTimer < 0)
+        goto error;
+
     /* Prepare one for packet receive */
     if (!(client->rx = virNetMessageNew(true)))
         goto error;
     client->rx->bufferLength = VIR_NET_MESSAGE_LEN_MAX;
-    if (VIR_ALLOC_N(client->rx->buffer, client->rx->bufferLength) < 0)
+    if (virNetMessageBufferEnsure(client->rx, client->rx->bufferLength) < 0)
         goto error;
     client->nrequests = 1;
 
@@ -903,6 +1003,43 @@ void virNetServerClientSetDispatcher(virNetServerClientPtr client,
 }
 
 
+/*
+ * @limit: max requests accepted per second, 0 for unlimited
+ *
+ * Limit the rate at which requests from @client are accepted for
+ * processing. The client may still burst up to @limit requests at
+ * once; past that, further requests are left on its socket until
+ * tokens are replenished. Changing the limit refills the bucket.
+ */
+void virNetServerClientSetRateLimit(virNetServerClientPtr client,
+                                    size_t limit)
+{
+    virObjectLock(client);
+    client->rateLimit = limit;
+    client->rateTokens = limit;
+    if (virTimeMillisNow(&client->rateLastFill) < 0)
+        client->rateLastFill = 0;
+    /* Wake a client that was waiting on the old bucket so the
+     * receive queue is re-evaluated against the new limit */
+    if (!client->rx &&
+        client->nrequests < client->nrequests_max)
+        virEventUpdateTimeout(client->rateTimer, 0);
+    virObjectUnlock(client);
+}
+
+
+size_t virNetServerClientGetRateLimit(virNetServerClientPtr client)
+{
+    size_t limit;
+
+    virObjectLock(client);
+    limit = client->rateLimit;
+    virObjectUnlock(client);
+
+    return limit;
+}
+
+
 const char *virNetServerClientLocalAddrStringSASL(virNetServerClientPtr client)
 {
     if (!client->sock)
@@ -943,6 +1080,8 @@ void virNetServerClientDispose(void *obj)
 #endif
     if (client->sockTimer > 0)
         virEventRemoveTimeout(client->sockTimer);
+    if (client->rateTimer > 0)
+        virEventRemoveTimeout(client->rateTimer);
 #if WITH_GNUTLS
     virObjectUnref(client->tls);
     virObjectUnref(client->tlsCtxt);
@@ -1274,13 +1413,14 @@ static void virNetServerClientDispatchRead(virNetServerClientPtr client)
         }
 
         /* Possibly need to create another receive buffer */
-        if (client->nrequests < client->nrequests_max) {
+        if (client->nrequests < client->nrequests_max &&
+            virNetServerClientRateAcquire(client)) {
             if (!(client->rx = virNetMessageNew(true))) {
                 client->wantClose = true;
             } else {
                 client->rx->bufferLength = VIR_NET_MESSAGE_LEN_MAX;
-                if (VIR_ALLOC_N(client->rx->buffer,
-                                client->rx->bufferLength) < 0) {
+                if (virNetMessageBufferEnsure(client->rx,
+                                              client->rx->bufferLength) < 0) {
                     client->wantClose = true;
                 } else {
                     client->nrequests++;
@@ -1302,6 +1442,8 @@ static void virNetServerClientDispatchRead(virNetServerClientPtr client)
  */
 static ssize_t virNetServerClientWrite(virNetServerClientPtr client)
 {
+    struct iovec iov[2];
+    size_t niov;
     ssize_t ret;
 
     if (client->tx->bufferLength < client->tx->bufferOffset) {
@@ -1312,16 +1454,15 @@ static ssize_t virNetServerClientWrite(virNetServerClientPtr client)
         return -1;
     }
 
-    if (client->tx->bufferLength == client->tx->bufferOffset)
+    if (!virNetMessageSendPending(client->tx))
         return 1;
 
-    ret = virNetSocketWrite(client->sock,
-                            client->tx->buffer + client->tx->bufferOffset,
-                            client->tx->bufferLength - client->tx->bufferOffset);
+    niov = virNetMessageGetSendIOV(client->tx, iov);
+    ret = virNetSocketWritev(client->sock, iov, niov);
     if (ret <= 0)
         return ret; /* -1 error, 0 = egain */
 
-    client->tx->bufferOffset += ret;
+    virNetMessageMarkSent(client->tx, ret);
     return ret;
 }
 
@@ -1331,10 +1472,10 @@ static ssize_t virNetServerClientWrite(virNetServerClientPtr client)
  * we would block on I/O
  */
 static void
-virNetServerClientDispatchWrite(virNetServerClientPtr client)
+virNetServerClientWriteQueue(virNetServerClientPtr client)
 {
     while (client->tx) {
-        if (client->tx->bufferOffset < client->tx->bufferLength) {
+        if (virNetMessageSendPending(client->tx)) {
             ssize_t ret;
             ret = virNetServerClientWrite(client);
             if (ret < 0) {
@@ -1345,7 +1486,7 @@ virNetServerClientDispatchWrite(virNetServerClientPtr client)
                 return; /* Would block on write EAGAIN */
         }
 
-        if (client->tx->bufferOffset == client->tx->bufferLength) {
+        if (!virNetMessageSendPending(client->tx)) {
             virNetMessagePtr msg;
             size_t i;
 
@@ -1378,11 +1519,12 @@ virNetServerClientDispatchWrite(virNetServerClientPtr client)
                 client->nrequests--;
                 /* See if the recv queue is currently throttled */
                 if (!client->rx &&
-                    client->nrequests < client->nrequests_max) {
+                    client->nrequests < client->nrequests_max &&
+                    virNetServerClientRateAcquire(client)) {
                     /* Ready to recv more messages */
                     virNetMessageClear(msg);
                     msg->bufferLength = VIR_NET_MESSAGE_LEN_MAX;
-                    if (VIR_ALLOC_N(msg->buffer, msg->bufferLength) < 0) {
+                    if (virNetMessageBufferEnsure(msg, msg->bufferLength) < 0) {
                         virNetMessageFree(msg);
                         return;
                     }
@@ -1403,6 +1545,28 @@ virNetServerClientDispatchWrite(virNetServerClientPtr client)
 }
 
 
+/*
+ * Flush the tx queue, coalescing the messages queued since the
+ * last flush into as few TLS records as possible when the
+ * transport is TLS
+ */
+static void
+virNetServerClientDispatchWrite(virNetServerClientPtr client)
+{
+#if WITH_GNUTLS
+    if (client->tls) {
+        virNetTLSSessionCork(client->tls);
+        virNetServerClientWriteQueue(client);
+        if (virNetTLSSessionUncork(client->tls) < 0 &&
+            errno != EAGAIN && errno != EINTR)
+            client->wantClose = true;
+        return;
+    }
+#endif
+    virNetServerClientWriteQueue(client);
+}
+
+
 #if WITH_GNUTLS
 static void
 virNetServerClientDispatchHandshake(virNetServerClientPtr client)
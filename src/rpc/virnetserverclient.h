@@ -122,6 +122,9 @@ void virNetServerClientSetCloseHook(virNetServerClientPtr client,
 void virNetServerClientSetDispatcher(virNetServerClientPtr client,
                                      virNetServerClientDispatchFunc func,
                                      void *opaque);
+void virNetServerClientSetRateLimit(virNetServerClientPtr client,
+                                    size_t limit);
+size_t virNetServerClientGetRateLimit(virNetServerClientPtr client);
 void virNetServerClientClose(virNetServerClientPtr client);
 bool virNetServerClientIsClosed(virNetServerClientPtr client);
 
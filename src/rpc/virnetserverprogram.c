@@ -31,11 +31,23 @@
 #include "virlog.h"
 #include "virfile.h"
 #include "virthread.h"
+#include "virtime.h"
+#include "virprobe.h"
 
 #define VIR_FROM_THIS VIR_FROM_RPC
 
 VIR_LOG_INIT("rpc.netserverprogram");
 
+/* Cumulative per-procedure dispatch accounting, so an operator can
+ * see what a busy daemon is spending its time on without tracing */
+typedef struct _virNetServerProgramCallStats virNetServerProgramCallStats;
+typedef virNetServerProgramCallStats *virNetServerProgramCallStatsPtr;
+struct _virNetServerProgramCallStats {
+    unsigned long long calls;
+    unsigned long long totalMs;
+    unsigned long long maxMs;
+};
+
 struct _virNetServerProgram {
     virObject object;
 
@@ -43,6 +55,9 @@ struct _virNetServerProgram {
     unsigned version;
     virNetServerProgramProcPtr procs;
     size_t nprocs;
+
+    virMutex statsLock;
+    virNetServerProgramCallStatsPtr stats; /* one slot per procedure */
 };
 
 
@@ -81,6 +96,19 @@ virNetServerProgramPtr virNetServerProgramNew(unsigned program,
     prog->procs = procs;
     prog->nprocs = nprocs;
 
+    if (virMutexInit(&prog->statsLock) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("cannot initialize stats mutex"));
+        virObjectUnref(prog);
+        return NULL;
+    }
+
+    if (VIR_ALLOC_N(prog->stats, nprocs) < 0) {
+        virMutexDestroy(&prog->statsLock);
+        virObjectUnref(prog);
+        return NULL;
+    }
+
     VIR_DEBUG("prog=%p", prog);
 
     return prog;
@@ -127,6 +155,61 @@ static virNetServerProgramProcPtr virNetServerProgramGetProc(virNetServerProgram
     return proc;
 }
 
+static void
+virNetServerProgramRecordCall(virNetServerProgramPtr prog,
+                              int procedure,
+                              unsigned long long duration)
+{
+    virNetServerProgramCallStatsPtr stats;
+
+    if (procedure < 0 || procedure >= prog->nprocs)
+        return;
+
+    virMutexLock(&prog->statsLock);
+    stats = &prog->stats[procedure];
+    stats->calls++;
+    stats->totalMs += duration;
+    if (duration > stats->maxMs)
+        stats->maxMs = duration;
+    virMutexUnlock(&prog->statsLock);
+}
+
+
+/**
+ * virNetServerProgramCallStatsWalk:
+ * @prog: server program
+ * @iter: callback invoked for each procedure that has been called
+ * @opaque: data passed through to @iter
+ *
+ * Report cumulative dispatch counts and handler latency per
+ * procedure. The walk runs on a snapshot of the counters, so @iter
+ * may dispatch RPC calls or log without deadlocking.
+ */
+void
+virNetServerProgramCallStatsWalk(virNetServerProgramPtr prog,
+                                 virNetServerProgramCallStatsIterator iter,
+                                 void *opaque)
+{
+    virNetServerProgramCallStatsPtr snapshot;
+    size_t i;
+
+    if (VIR_ALLOC_N_QUIET(snapshot, prog->nprocs) < 0)
+        return;
+
+    virMutexLock(&prog->statsLock);
+    memcpy(snapshot, prog->stats, sizeof(*snapshot) * prog->nprocs);
+    virMutexUnlock(&prog->statsLock);
+
+    for (i = 0; i < prog->nprocs; i++) {
+        if (snapshot[i].calls)
+            iter(prog->program, i, snapshot[i].calls,
+                 snapshot[i].totalMs, snapshot[i].maxMs, opaque);
+    }
+
+    VIR_FREE(snapshot);
+}
+
+
 unsigned int
 virNetServerProgramGetPriority(virNetServerProgramPtr prog,
                                int procedure)
@@ -279,6 +362,11 @@ int virNetServerProgramDispatch(virNetServerProgramPtr prog,
 {
     int ret = -1;
     virNetMessageError rerr;
+    /* sending the reply may release @msg, so grab what the probes
+     * need from the header up front */
+    unsigned int program = msg->header.prog;
+    unsigned int proc = msg->header.proc;
+    unsigned int serial = msg->header.serial;
 
     memset(&rerr, 0, sizeof(rerr));
 
@@ -286,6 +374,11 @@ int virNetServerProgramDispatch(virNetServerProgramPtr prog,
               msg->header.prog, msg->header.vers, msg->header.type,
               msg->header.status, msg->header.serial, msg->header.proc);
 
+    PROBE(RPC_SERVER_PROGRAM_DISPATCH,
+          "client=%p prog=%d ver=%d proc=%d serial=%u",
+          client, msg->header.prog, msg->header.vers,
+          msg->header.proc, msg->header.serial);
+
     /* Check version, etc. */
     if (msg->header.prog != prog->program) {
         virReportError(VIR_ERR_RPC,
@@ -331,7 +424,7 @@ int virNetServerProgramDispatch(virNetServerProgramPtr prog,
         goto error;
     }
 
-    return ret;
+    goto cleanup;
 
  error:
     if (msg->header.type == VIR_NET_CALL ||
@@ -349,6 +442,9 @@ int virNetServerProgramDispatch(virNetServerProgramPtr prog,
     }
 
  cleanup:
+    PROBE(RPC_SERVER_PROGRAM_DISPATCH_DONE,
+          "client=%p prog=%u proc=%u serial=%u rv=%d",
+          client, program, proc, serial, ret);
     return ret;
 }
 
@@ -376,6 +472,8 @@ virNetServerProgramDispatchCall(virNetServerProgramPtr prog,
     int rv = -1;
     virNetServerProgramProcPtr dispatcher;
     virNetMessageError rerr;
+    unsigned long long start = 0;
+    unsigned long long now = 0;
     size_t i;
     virIdentityPtr identity = NULL;
 
@@ -434,8 +532,14 @@ virNetServerProgramDispatchCall(virNetServerProgramPtr prog,
      *
      *   'args and 'ret'
      */
+    ignore_value(virTimeMillisNow(&start));
+
     rv = (dispatcher->func)(server, client, msg, &rerr, arg, ret);
 
+    ignore_value(virTimeMillisNow(&now));
+    virNetServerProgramRecordCall(prog, msg->header.proc,
+                                  now > start ? now - start : 0);
+
     if (virIdentitySetCurrent(NULL) < 0)
         goto error;
 
@@ -548,6 +652,48 @@ int virNetServerProgramSendStreamData(virNetServerProgramPtr prog,
 }
 
 
-void virNetServerProgramDispose(void *obj ATTRIBUTE_UNUSED)
+/*
+ * Variant of virNetServerProgramSendStreamData which takes ownership
+ * of the heap allocated @*data rather than copying it into the
+ * message buffer, avoiding one full copy of every stream packet.
+ * On success @*data is cleared; @len must be greater than zero.
+ */
+int virNetServerProgramSendStreamDataSteal(virNetServerProgramPtr prog,
+                                           virNetServerClientPtr client,
+                                           virNetMessagePtr msg,
+                                           int procedure,
+                                           unsigned int serial,
+                                           char **data,
+                                           size_t len)
 {
+    VIR_DEBUG("client=%p msg=%p data=%p len=%zu", client, msg, *data, len);
+
+    msg->header.prog = prog->program;
+    msg->header.vers = prog->version;
+    msg->header.proc = procedure;
+    msg->header.type = VIR_NET_STREAM;
+    msg->header.serial = serial;
+    msg->header.status = VIR_NET_CONTINUE;
+
+    if (virNetMessageEncodeHeader(msg) < 0)
+        return -1;
+
+    if (virNetMessageEncodePayloadRawSteal(msg, data, len) < 0)
+        return -1;
+
+    VIR_DEBUG("Total %zu", msg->bufferLength + msg->externalLength);
+
+    return virNetServerClientSendMessage(client, msg);
+}
+
+
+void virNetServerProgramDispose(void *obj)
+{
+    virNetServerProgramPtr prog = obj;
+
+    /* stats is only set once the mutex is known good */
+    if (prog->stats) {
+        VIR_FREE(prog->stats);
+        virMutexDestroy(&prog->statsLock);
+    }
 }
@@ -71,6 +71,17 @@ int virNetServerProgramGetVersion(virNetServerProgramPtr prog);
 unsigned int virNetServerProgramGetPriority(virNetServerProgramPtr prog,
                                             int procedure);
 
+typedef void (*virNetServerProgramCallStatsIterator)(unsigned program,
+                                                     int procedure,
+                                                     unsigned long long calls,
+                                                     unsigned long long totalMs,
+                                                     unsigned long long maxMs,
+                                                     void *opaque);
+
+void virNetServerProgramCallStatsWalk(virNetServerProgramPtr prog,
+                                      virNetServerProgramCallStatsIterator iter,
+                                      void *opaque);
+
 int virNetServerProgramMatches(virNetServerProgramPtr prog,
                                virNetMessagePtr msg);
 
@@ -104,4 +115,12 @@ int virNetServerProgramSendStreamData(virNetServerProgramPtr prog,
                                       const char *data,
                                       size_t len);
 
+int virNetServerProgramSendStreamDataSteal(virNetServerProgramPtr prog,
+                                           virNetServerClientPtr client,
+                                           virNetMessagePtr msg,
+                                           int procedure,
+                                           unsigned int serial,
+                                           char **data,
+                                           size_t len);
+
 #endif /* __VIR_NET_SERVER_PROGRAM_H__ */
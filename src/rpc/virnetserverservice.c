@@ -33,6 +33,10 @@
 
 #define VIR_FROM_THIS VIR_FROM_RPC
 
+/* Upper bound on connections accepted in one event loop wakeup,
+ * so a connection storm cannot starve the other event handlers */
+#define VIR_NET_SERVER_SERVICE_ACCEPT_MAX 32
+
 struct _virNetServerService {
     virObject object;
 
@@ -74,21 +78,27 @@ static void virNetServerServiceAccept(virNetSocketPtr sock,
                                       void *opaque)
 {
     virNetServerServicePtr svc = opaque;
-    virNetSocketPtr clientsock = NULL;
+    size_t i;
 
-    if (virNetSocketAccept(sock, &clientsock) < 0)
-        goto cleanup;
+    /* The listen socket is non-blocking, so drain the whole accept
+     * backlog in this wakeup rather than taking a single connection
+     * per event loop iteration. Otherwise a burst of hundreds of
+     * connections per second can overflow the listen backlog while
+     * we crawl through it one event at a time. */
+    for (i = 0; i < VIR_NET_SERVER_SERVICE_ACCEPT_MAX; i++) {
+        virNetSocketPtr clientsock = NULL;
 
-    if (!clientsock) /* Connection already went away */
-        goto cleanup;
+        if (virNetSocketAccept(sock, &clientsock) < 0)
+            break;
 
-    if (!svc->dispatchFunc)
-        goto cleanup;
+        if (!clientsock) /* Backlog drained, or connection went away */
+            break;
 
-    svc->dispatchFunc(svc, clientsock, svc->dispatchOpaque);
+        if (svc->dispatchFunc)
+            svc->dispatchFunc(svc, clientsock, svc->dispatchOpaque);
 
- cleanup:
-    virObjectUnref(clientsock);
+        virObjectUnref(clientsock);
+    }
 }
 
 
@@ -179,6 +189,11 @@ virNetServerServicePtr virNetServerServiceNewTCP(const char *nodename,
         if (virNetSocketListen(svc->socks[i], max_queued_clients) < 0)
             goto error;
 
+        /* Non-blocking, so the accept handler can drain the whole
+         * backlog in one wakeup and stop cleanly on EAGAIN */
+        if (virNetSocketSetBlocking(svc->socks[i], false) < 0)
+            goto error;
+
         /* IO callback is initially disabled, until we're ready
          * to deal with incoming clients */
         virObjectRef(svc);
@@ -243,6 +258,11 @@ virNetServerServicePtr virNetServerServiceNewUNIX(const char *path,
         if (virNetSocketListen(svc->socks[i], max_queued_clients) < 0)
             goto error;
 
+        /* Non-blocking, so the accept handler can drain the whole
+         * backlog in one wakeup and stop cleanly on EAGAIN */
+        if (virNetSocketSetBlocking(svc->socks[i], false) < 0)
+            goto error;
+
         /* IO callback is initially disabled, until we're ready
          * to deal with incoming clients */
         virObjectRef(svc);
@@ -301,6 +321,11 @@ virNetServerServicePtr virNetServerServiceNewFD(int fd,
         if (virNetSocketListen(svc->socks[i], max_queued_clients) < 0)
             goto error;
 
+        /* Non-blocking, so the accept handler can drain the whole
+         * backlog in one wakeup and stop cleanly on EAGAIN */
+        if (virNetSocketSetBlocking(svc->socks[i], false) < 0)
+            goto error;
+
         /* IO callback is initially disabled, until we're ready
          * to deal with incoming clients */
         virObjectRef(svc);
@@ -382,6 +407,11 @@ virNetServerServicePtr virNetServerServiceNewPostExecRestart(virJSONValuePtr obj
 
         svc->socks[i] = sock;
 
+        /* Non-blocking, so the accept handler can drain the whole
+         * backlog in one wakeup and stop cleanly on EAGAIN */
+        if (virNetSocketSetBlocking(sock, false) < 0)
+            goto error;
+
         /* IO callback is initially disabled, until we're ready
          * to deal with incoming clients */
         virObjectRef(svc);
@@ -25,6 +25,9 @@
 
 #include <sys/stat.h>
 #include <sys/socket.h>
+#ifdef HAVE_SYS_UIO_H
+# include <sys/uio.h>
+#endif
 #include <unistd.h>
 #include <sys/wait.h>
 #include <signal.h>
@@ -57,6 +60,7 @@
 #include "virpidfile.h"
 #include "virprobe.h"
 #include "virprocess.h"
+#include "vireventepoll.h"
 #include "virstring.h"
 #include "dirname.h"
 #include "passfd.h"
@@ -74,6 +78,7 @@ struct _virNetSocket {
 
     int fd;
     int watch;
+    virEventEpollLoopPtr eventLoop;
     pid_t pid;
     int errfd;
     bool client;
@@ -101,7 +106,14 @@ struct _virNetSocket {
 
     const char *saslEncoded;
     size_t saslEncodedLength;
+    size_t saslEncodedRawLength;
     size_t saslEncodedOffset;
+
+    /* Buffers reused across calls to avoid a malloc/free per
+     * SASL record; both are sized to the negotiated max buffer
+     * size on first use */
+    char *saslReadBuf;
+    char *saslEncodeBuf;
 #endif
 #if WITH_SSH2
     virNetSSHSessionPtr sshSession;
@@ -823,6 +835,7 @@ int virNetSocketNewConnectSSH(const char *nodename,
                               const char *username,
                               bool noTTY,
                               bool noVerify,
+                              bool compress,
                               const char *netcat,
                               const char *keyfile,
                               const char *path,
@@ -854,6 +867,8 @@ int virNetSocketNewConnectSSH(const char *nodename,
                              "-e", "none", NULL);
     if (noVerify)
         virCommandAddArgList(cmd, "-o", "StrictHostKeyChecking=no", NULL);
+    if (compress)
+        virCommandAddArg(cmd, "-C");
 
     if (!netcat)
         netcat = "nc";
@@ -1176,7 +1191,10 @@ void virNetSocketDispose(void *obj)
           "sock=%p", sock);
 
     if (sock->watch >= 0) {
-        virEventRemoveHandle(sock->watch);
+        if (sock->eventLoop)
+            virEventEpollLoopRemoveHandle(sock->eventLoop, sock->watch);
+        else
+            virEventRemoveHandle(sock->watch);
         sock->watch = -1;
     }
 
@@ -1196,6 +1214,8 @@ void virNetSocketDispose(void *obj)
 #endif
 #if WITH_SASL
     virObjectUnref(sock->saslSession);
+    VIR_FREE(sock->saslReadBuf);
+    VIR_FREE(sock->saslEncodeBuf);
 #endif
 
 #if WITH_SSH2
@@ -1670,6 +1690,43 @@ static ssize_t virNetSocketWriteWire(virNetSocketPtr sock, const char *buf, size
 }
 
 
+/*
+ * Scatter/gather variant of virNetSocketWriteWire. Only used on
+ * plain sockets; encrypted sessions fall back to writing the
+ * first segment since the wrapping layers work on linear buffers.
+ */
+static ssize_t virNetSocketWritevWire(virNetSocketPtr sock,
+                                      struct iovec *iov,
+                                      size_t niov)
+{
+#ifdef HAVE_SYS_UIO_H
+    ssize_t ret;
+
+ rewritev:
+    ret = writev(sock->fd, iov, niov);
+    if (ret < 0) {
+        if (errno == EINTR)
+            goto rewritev;
+        if (errno == EAGAIN)
+            return 0;
+
+        virReportSystemError(errno, "%s",
+                             _("Cannot write data"));
+        return -1;
+    }
+    if (ret == 0) {
+        virReportSystemError(EIO, "%s",
+                             _("End of file while writing data"));
+        return -1;
+    }
+
+    return ret;
+#else /* !HAVE_SYS_UIO_H */
+    return virNetSocketWriteWire(sock, iov[0].iov_base, iov[0].iov_len);
+#endif /* !HAVE_SYS_UIO_H */
+}
+
+
 #if WITH_SASL
 static ssize_t virNetSocketReadSASL(virNetSocketPtr sock, char *buf, size_t len)
 {
@@ -1678,23 +1735,20 @@ static ssize_t virNetSocketReadSASL(virNetSocketPtr sock, char *buf, size_t len)
     /* Need to read some more data off the wire */
     if (sock->saslDecoded == NULL) {
         ssize_t encodedLen = virNetSASLSessionGetMaxBufSize(sock->saslSession);
-        char *encoded;
-        if (VIR_ALLOC_N(encoded, encodedLen) < 0)
+
+        if (!sock->saslReadBuf &&
+            VIR_ALLOC_N(sock->saslReadBuf, encodedLen) < 0)
             return -1;
-        encodedLen = virNetSocketReadWire(sock, encoded, encodedLen);
 
-        if (encodedLen <= 0) {
-            VIR_FREE(encoded);
+        encodedLen = virNetSocketReadWire(sock, sock->saslReadBuf, encodedLen);
+
+        if (encodedLen <= 0)
             return encodedLen;
-        }
 
         if (virNetSASLSessionDecode(sock->saslSession,
-                                    encoded, encodedLen,
-                                    &sock->saslDecoded, &sock->saslDecodedLength) < 0) {
-            VIR_FREE(encoded);
+                                    sock->saslReadBuf, encodedLen,
+                                    &sock->saslDecoded, &sock->saslDecodedLength) < 0)
             return -1;
-        }
-        VIR_FREE(encoded);
 
         sock->saslDecodedOffset = 0;
     }
@@ -1717,24 +1771,54 @@ static ssize_t virNetSocketReadSASL(virNetSocketPtr sock, char *buf, size_t len)
 }
 
 
-static ssize_t virNetSocketWriteSASL(virNetSocketPtr sock, const char *buf, size_t len)
+static ssize_t virNetSocketWritevSASL(virNetSocketPtr sock,
+                                      struct iovec *iov,
+                                      size_t niov)
 {
     int ret;
-    size_t tosend = virNetSASLSessionGetMaxBufSize(sock->saslSession);
+    size_t maxbufsize = virNetSASLSessionGetMaxBufSize(sock->saslSession);
 
-    /* SASL doesn't necessarily let us send the whole
-       buffer at once */
-    if (tosend > len)
-        tosend = len;
-
-    /* Not got any pending encoded data, so we need to encode raw stuff */
+    /* Not got any pending encoded data, so we need to encode raw stuff.
+     * Consecutive buffers are gathered into a single SASL record up to
+     * the negotiated max buffer size, so a message header and payload
+     * don't each pay the per-record integrity/cipher overhead */
     if (sock->saslEncoded == NULL) {
+        const char *input;
+        size_t inputLen;
+
+        if (niov == 1 || iov[0].iov_len >= maxbufsize) {
+            /* SASL doesn't necessarily let us send the whole
+               buffer at once */
+            input = iov[0].iov_base;
+            inputLen = iov[0].iov_len;
+            if (inputLen > maxbufsize)
+                inputLen = maxbufsize;
+        } else {
+            size_t i;
+
+            if (!sock->saslEncodeBuf &&
+                VIR_ALLOC_N(sock->saslEncodeBuf, maxbufsize) < 0)
+                return -1;
+
+            inputLen = 0;
+            for (i = 0; i < niov && inputLen < maxbufsize; i++) {
+                size_t tocopy = iov[i].iov_len;
+                if (tocopy > maxbufsize - inputLen)
+                    tocopy = maxbufsize - inputLen;
+                memcpy(sock->saslEncodeBuf + inputLen,
+                       iov[i].iov_base, tocopy);
+                inputLen += tocopy;
+            }
+            input = sock->saslEncodeBuf;
+        }
+
         if (virNetSASLSessionEncode(sock->saslSession,
-                                    buf, tosend,
+                                    input, inputLen,
                                     &sock->saslEncoded,
                                     &sock->saslEncodedLength) < 0)
             return -1;
 
+        sock->saslEncodedRawLength = inputLen;
         sock->saslEncodedOffset = 0;
     }
 
@@ -1751,20 +1835,31 @@ static ssize_t virNetSocketWriteSASL(virNetSocketPtr sock, const char *buf, size
 
     /* Sent all encoded, so update raw buffer to indicate completion */
     if (sock->saslEncodedOffset == sock->saslEncodedLength) {
+        ssize_t done = sock->saslEncodedRawLength;
+
         sock->saslEncoded = NULL;
         sock->saslEncodedOffset = sock->saslEncodedLength = 0;
+        sock->saslEncodedRawLength = 0;
 
         /* Mark as complete, so caller detects completion */
-        return tosend;
+        return done;
     } else {
         /* Still have stuff pending in saslEncoded buffer.
          * Pretend to caller that we didn't send any yet.
-         * The caller will then retry with same buffer
+         * The caller will then retry with same buffers
          * shortly, which lets us finish saslEncoded.
          */
         return 0;
     }
 }
+
+
+static ssize_t virNetSocketWriteSASL(virNetSocketPtr sock, const char *buf, size_t len)
+{
+    struct iovec iov = { .iov_base = (char *)buf, .iov_len = len };
+
+    return virNetSocketWritevSASL(sock, &iov, 1);
+}
 #endif
 
 ssize_t virNetSocketRead(virNetSocketPtr sock, char *buf, size_t len)
@@ -1797,6 +1892,47 @@ ssize_t virNetSocketWrite(virNetSocketPtr sock, const char *buf, size_t len)
 }
 
 
+/*
+ * Write several buffers in a single syscall where the transport
+ * allows it, so a message header and an external payload reach
+ * the wire without being copied into one linear buffer first.
+ */
+ssize_t virNetSocketWritev(virNetSocketPtr sock,
+                           struct iovec *iov,
+                           size_t niov)
+{
+    ssize_t ret;
+
+    virObjectLock(sock);
+#if WITH_SASL
+    if (sock->saslSession) {
+        ret = virNetSocketWritevSASL(sock, iov, niov);
+        virObjectUnlock(sock);
+        return ret;
+    }
+#endif
+#if WITH_SSH2
+    if (sock->sshSession) {
+        ret = virNetSocketWriteWire(sock, iov[0].iov_base, iov[0].iov_len);
+        virObjectUnlock(sock);
+        return ret;
+    }
+#endif
+#if WITH_GNUTLS
+    if (sock->tlsSession &&
+        virNetTLSSessionGetHandshakeStatus(sock->tlsSession) ==
+        VIR_NET_TLS_HANDSHAKE_COMPLETE) {
+        ret = virNetSocketWriteWire(sock, iov[0].iov_base, iov[0].iov_len);
+        virObjectUnlock(sock);
+        return ret;
+    }
+#endif
+    ret = virNetSocketWritevWire(sock, iov, niov);
+    virObjectUnlock(sock);
+    return ret;
+}
+
+
 /*
  * Returns 1 if an FD was sent, 0 if it would block, -1 on error
  */
@@ -1962,6 +2098,27 @@ static void virNetSocketEventFree(void *opaque)
     virObjectUnref(sock);
 }
 
+/**
+ * virNetSocketSetEventLoop:
+ * @sock: socket to monitor
+ * @loop: private event loop to monitor it on, or NULL
+ *
+ * Arranges for any subsequently registered I/O callback to be
+ * dispatched from @loop rather than the default event loop. Must
+ * be called before virNetSocketAddIOCallback(). Passing NULL keeps
+ * the default event loop.
+ */
+void virNetSocketSetEventLoop(virNetSocketPtr sock,
+                              virEventEpollLoopPtr loop)
+{
+    virObjectLock(sock);
+    if (sock->watch >= 0)
+        VIR_WARN("Watch already registered on socket %p, ignoring loop", sock);
+    else
+        sock->eventLoop = loop;
+    virObjectUnlock(sock);
+}
+
 int virNetSocketAddIOCallback(virNetSocketPtr sock,
                               int events,
                               virNetSocketIOFunc func,
@@ -1977,11 +2134,20 @@ int virNetSocketAddIOCallback(virNetSocketPtr sock,
         goto cleanup;
     }
 
-    if ((sock->watch = virEventAddHandle(sock->fd,
-                                         events,
-                                         virNetSocketEventHandle,
-                                         sock,
-                                         virNetSocketEventFree)) < 0) {
+    if (sock->eventLoop)
+        sock->watch = virEventEpollLoopAddHandle(sock->eventLoop,
+                                                 sock->fd,
+                                                 events,
+                                                 virNetSocketEventHandle,
+                                                 sock,
+                                                 virNetSocketEventFree);
+    else
+        sock->watch = virEventAddHandle(sock->fd,
+                                        events,
+                                        virNetSocketEventHandle,
+                                        sock,
+                                        virNetSocketEventFree);
+    if (sock->watch < 0) {
         VIR_DEBUG("Failed to register watch on socket %p", sock);
         goto cleanup;
     }
@@ -2008,7 +2174,10 @@ void virNetSocketUpdateIOCallback(virNetSocketPtr sock,
         return;
     }
 
-    virEventUpdateHandle(sock->watch, events);
+    if (sock->eventLoop)
+        virEventEpollLoopUpdateHandle(sock->eventLoop, sock->watch, events);
+    else
+        virEventUpdateHandle(sock->watch, events);
 
     virObjectUnlock(sock);
 }
@@ -2023,7 +2192,10 @@ void virNetSocketRemoveIOCallback(virNetSocketPtr sock)
         return;
     }
 
-    virEventRemoveHandle(sock->watch);
+    if (sock->eventLoop)
+        virEventEpollLoopRemoveHandle(sock->eventLoop, sock->watch);
+    else
+        virEventRemoveHandle(sock->watch);
     /* Don't unref @sock, it's done via eventloop callback. */
     sock->watch = -1;
 
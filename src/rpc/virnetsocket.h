@@ -34,6 +34,10 @@
 #  include "virnetsaslcontext.h"
 # endif
 # include "virjson.h"
+# include "vireventepoll.h"
+# ifdef HAVE_SYS_UIO_H
+#  include <sys/uio.h>
+# endif
 # include "viruri.h"
 
 typedef struct _virNetSocket virNetSocket;
@@ -82,6 +86,7 @@ int virNetSocketNewConnectSSH(const char *nodename,
                               const char *username,
                               bool noTTY,
                               bool noVerify,
+                              bool compress,
                               const char *netcat,
                               const char *keyfile,
                               const char *path,
@@ -132,6 +137,7 @@ int virNetSocketSetBlocking(virNetSocketPtr sock,
 
 ssize_t virNetSocketRead(virNetSocketPtr sock, char *buf, size_t len);
 ssize_t virNetSocketWrite(virNetSocketPtr sock, const char *buf, size_t len);
+ssize_t virNetSocketWritev(virNetSocketPtr sock, struct iovec *iov, size_t niov);
 
 int virNetSocketSendFD(virNetSocketPtr sock, int fd);
 int virNetSocketRecvFD(virNetSocketPtr sock, int *fd);
@@ -156,6 +162,9 @@ int virNetSocketListen(virNetSocketPtr sock, int backlog);
 int virNetSocketAccept(virNetSocketPtr sock,
                        virNetSocketPtr *clientsock);
 
+void virNetSocketSetEventLoop(virNetSocketPtr sock,
+                              virEventEpollLoopPtr loop);
+
 int virNetSocketAddIOCallback(virNetSocketPtr sock,
                               int events,
                               virNetSocketIOFunc func,
@@ -1330,6 +1330,108 @@ ssize_t virNetTLSSessionRead(virNetTLSSessionPtr sess,
     return ret;
 }
 
+
+/*
+ * virNetTLSSessionCork:
+ * @sess: the TLS session object
+ *
+ * Begin delaying transmission of written data, so that several
+ * small messages flushed back to back coalesce into full sized
+ * TLS records instead of paying the per-record overhead for each
+ * one. Must be paired with virNetTLSSessionUncork(). A no-op if
+ * the linked gnutls has no record corking support.
+ */
+void virNetTLSSessionCork(virNetTLSSessionPtr sess
+#if !HAVE_GNUTLS_RECORD_CORK
+                          ATTRIBUTE_UNUSED
+#endif
+                          )
+{
+#if HAVE_GNUTLS_RECORD_CORK
+    virObjectLock(sess);
+    gnutls_record_cork(sess->session);
+    virObjectUnlock(sess);
+#endif
+}
+
+
+/*
+ * virNetTLSSessionUncork:
+ * @sess: the TLS session object
+ *
+ * Stop delaying transmission and attempt to flush any data
+ * buffered since virNetTLSSessionCork() without blocking. Data
+ * which cannot be sent yet stays pending; the caller should poll
+ * for writability while virNetTLSSessionHasPendingWrite() is true
+ * and call this again.
+ *
+ * Returns the number of bytes flushed, or -1 with errno set on
+ * error (EAGAIN when the transport would block)
+ */
+ssize_t virNetTLSSessionUncork(virNetTLSSessionPtr sess
+#if !HAVE_GNUTLS_RECORD_CORK
+                               ATTRIBUTE_UNUSED
+#endif
+                               )
+{
+#if HAVE_GNUTLS_RECORD_CORK
+    ssize_t ret;
+
+    virObjectLock(sess);
+    ret = gnutls_record_uncork(sess->session, 0);
+
+    if (ret >= 0)
+        goto cleanup;
+
+    switch (ret) {
+    case GNUTLS_E_AGAIN:
+        errno = EAGAIN;
+        break;
+    case GNUTLS_E_INTERRUPTED:
+        errno = EINTR;
+        break;
+    default:
+        errno = EIO;
+        break;
+    }
+
+    ret = -1;
+
+ cleanup:
+    virObjectUnlock(sess);
+    return ret;
+#else
+    return 0;
+#endif
+}
+
+
+/*
+ * virNetTLSSessionHasPendingWrite:
+ * @sess: the TLS session object
+ *
+ * Returns true if corked data is still awaiting transmission
+ */
+bool virNetTLSSessionHasPendingWrite(virNetTLSSessionPtr sess
+#if !HAVE_GNUTLS_RECORD_CORK
+                                     ATTRIBUTE_UNUSED
+#endif
+                                     )
+{
+#if HAVE_GNUTLS_RECORD_CORK
+    bool ret;
+
+    virObjectLock(sess);
+    ret = gnutls_record_check_corked(sess->session) > 0;
+    virObjectUnlock(sess);
+
+    return ret;
+#else
+    return false;
+#endif
+}
+
+
 int virNetTLSSessionHandshake(virNetTLSSessionPtr sess)
 {
     int ret;
@@ -85,6 +85,10 @@ ssize_t virNetTLSSessionWrite(virNetTLSSessionPtr sess,
 ssize_t virNetTLSSessionRead(virNetTLSSessionPtr sess,
                              char *buf, size_t len);
 
+void virNetTLSSessionCork(virNetTLSSessionPtr sess);
+ssize_t virNetTLSSessionUncork(virNetTLSSessionPtr sess);
+bool virNetTLSSessionHasPendingWrite(virNetTLSSessionPtr sess);
+
 int virNetTLSSessionHandshake(virNetTLSSessionPtr sess);
 
 typedef enum {
@@ -31,6 +31,7 @@
 #include "security_dac.h"
 #include "virerror.h"
 #include "virfile.h"
+#include "virhash.h"
 #include "viralloc.h"
 #include "virlog.h"
 #include "virpci.h"
@@ -57,6 +58,12 @@ struct _virSecurityDACData {
     bool dynamicOwnership;
     char *baselabel;
     virSecurityManagerDACChownCallback chownCallback;
+
+    /* Original owners of the files we have chowned, keyed by device
+     * and inode number so that the same image reached through
+     * different paths shares one entry. Accessed only with the
+     * security manager lock held; created on first use */
+    virHashTablePtr ownerLedger;
 };
 
 typedef struct _virSecurityDACCallbackData virSecurityDACCallbackData;
@@ -184,24 +191,89 @@ virSecurityDACGetImageIds(virSecurityLabelDefPtr seclabel,
     return 0;
 }
 
+typedef struct _virSecurityDACOwnerEntry virSecurityDACOwnerEntry;
+typedef virSecurityDACOwnerEntry *virSecurityDACOwnerEntryPtr;
+struct _virSecurityDACOwnerEntry {
+    uid_t uid;
+    gid_t gid;
+    unsigned int refs;
+};
+
+static void
+virSecurityDACOwnerEntryFree(void *payload,
+                             const void *name ATTRIBUTE_UNUSED)
+{
+    VIR_FREE(payload);
+}
+
+static char *
+virSecurityDACOwnerLedgerKey(const struct stat *sb)
+{
+    char *key;
+
+    ignore_value(virAsprintf(&key, "%llu:%llu",
+                             (unsigned long long) sb->st_dev,
+                             (unsigned long long) sb->st_ino));
+    return key;
+}
+
 /**
  * virSecurityDACRememberLabel:
  * @priv: driver's private data
  * @path: path to the file
- * @uid: user owning the @path
- * @gid: group owning the @path
+ * @sb: stat data of @path before it was chowned
  *
- * Remember the owner of @path (represented by @uid:@gid).
+ * Remember the owner of @path. The entry is keyed by device and
+ * inode number, so the same image reached through different paths
+ * (or symlinks) is accounted only once, and each additional user
+ * just bumps a reference counter.
  *
  * Returns: 0 on success, -1 on failure
  */
 static int
-virSecurityDACRememberLabel(virSecurityDACDataPtr priv ATTRIBUTE_UNUSED,
-                            const char *path ATTRIBUTE_UNUSED,
-                            uid_t uid ATTRIBUTE_UNUSED,
-                            gid_t gid ATTRIBUTE_UNUSED)
+virSecurityDACRememberLabel(virSecurityDACDataPtr priv,
+                            const char *path,
+                            const struct stat *sb)
 {
-    return 0;
+    virSecurityDACOwnerEntryPtr entry;
+    char *key = NULL;
+    int ret = -1;
+
+    if (!priv->ownerLedger &&
+        !(priv->ownerLedger = virHashCreate(50, virSecurityDACOwnerEntryFree)))
+        return -1;
+
+    if (!(key = virSecurityDACOwnerLedgerKey(sb)))
+        return -1;
+
+    if ((entry = virHashLookup(priv->ownerLedger, key))) {
+        /* Keep the owner recorded by the first user; it is the one
+         * to return to once the last user is gone */
+        entry->refs++;
+        VIR_DEBUG("Recorded another user of '%s', %u in total",
+                  path, entry->refs);
+        ret = 0;
+        goto cleanup;
+    }
+
+    if (VIR_ALLOC(entry) < 0)
+        goto cleanup;
+
+    entry->uid = sb->st_uid;
+    entry->gid = sb->st_gid;
+    entry->refs = 1;
+
+    if (virHashAddEntry(priv->ownerLedger, key, entry) < 0) {
+        VIR_FREE(entry);
+        goto cleanup;
+    }
+
+    VIR_DEBUG("Remembered owner '%ld:%ld' of '%s'",
+              (long) sb->st_uid, (long) sb->st_gid, path);
+    ret = 0;
+ cleanup:
+    VIR_FREE(key);
+    return ret;
 }
 
 /**
@@ -220,12 +292,46 @@ virSecurityDACRememberLabel(virSecurityDACDataPtr priv ATTRIBUTE_UNUSED,
  *         -1 on failure (@uid and @gid not touched)
  */
 static int
-virSecurityDACRecallLabel(virSecurityDACDataPtr priv ATTRIBUTE_UNUSED,
-                          const char *path ATTRIBUTE_UNUSED,
-                          uid_t *uid ATTRIBUTE_UNUSED,
-                          gid_t *gid ATTRIBUTE_UNUSED)
+virSecurityDACRecallLabel(virSecurityDACDataPtr priv,
+                          const char *path,
+                          uid_t *uid,
+                          gid_t *gid)
 {
-    return 0;
+    virSecurityDACOwnerEntryPtr entry;
+    struct stat sb;
+    char *key = NULL;
+    int ret = -1;
+
+    /* If the file is gone or we never recorded it (e.g. the daemon
+     * was restarted since the domain started), fall back to the
+     * default the caller initialized @uid and @gid with */
+    if (!priv->ownerLedger ||
+        stat(path, &sb) < 0)
+        return 0;
+
+    if (!(key = virSecurityDACOwnerLedgerKey(&sb)))
+        return -1;
+
+    if (!(entry = virHashLookup(priv->ownerLedger, key))) {
+        ret = 0;
+        goto cleanup;
+    }
+
+    if (--entry->refs) {
+        /* Still in use by somebody else */
+        VIR_DEBUG("'%s' still has %u other users, not restoring",
+                  path, entry->refs);
+        ret = 1;
+        goto cleanup;
+    }
+
+    *uid = entry->uid;
+    *gid = entry->gid;
+    virHashRemoveEntry(priv->ownerLedger, key);
+    ret = 0;
+ cleanup:
+    VIR_FREE(key);
+    return ret;
 }
 
 static virSecurityDriverStatus
@@ -246,6 +352,8 @@ virSecurityDACClose(virSecurityManagerPtr mgr)
     virSecurityDACDataPtr priv = virSecurityManagerGetPrivateData(mgr);
     VIR_FREE(priv->groups);
     VIR_FREE(priv->baselabel);
+    virHashFree(priv->ownerLedger);
+    priv->ownerLedger = NULL;
     return 0;
 }
 
@@ -367,7 +475,7 @@ virSecurityDACSetOwnership(virSecurityDACDataPtr priv,
             return -1;
         }
 
-        if (virSecurityDACRememberLabel(priv, path, sb.st_uid, sb.st_gid) < 0)
+        if (virSecurityDACRememberLabel(priv, path, &sb) < 0)
             return -1;
     }
 
@@ -891,6 +891,22 @@ virSecuritySELinuxSetFileconHelper(const char *path, char *tcon,
 
     VIR_INFO("Setting SELinux context on '%s' to '%s'", path, tcon);
 
+    /* Check the current label first. If the desired label is already
+     * in place the setfilecon call would be a no-op, but on network
+     * filesystems it would still pay a full round trip to the server;
+     * with deep backing chains those round trips dominate domain
+     * start time. This also collapses repeated relabels of an image
+     * shared between several devices into a single write. */
+    if (getfilecon_raw(path, &econ) >= 0) {
+        bool match = STREQ(tcon, econ);
+
+        freecon(econ);
+        if (match) {
+            VIR_DEBUG("SELinux context on '%s' already correct", path);
+            return 0;
+        }
+    }
+
     if (setfilecon_raw(path, tcon) < 0) {
         int setfilecon_errno = errno;
 
@@ -965,6 +981,18 @@ virSecuritySELinuxFSetFilecon(int fd, char *tcon)
 
     VIR_INFO("Setting SELinux context on fd %d to '%s'", fd, tcon);
 
+    /* Don't pay for the write if the desired label is already in
+     * place; see virSecuritySELinuxSetFileconHelper */
+    if (fgetfilecon_raw(fd, &econ) >= 0) {
+        bool match = STREQ(tcon, econ);
+
+        freecon(econ);
+        if (match) {
+            VIR_DEBUG("SELinux context on fd %d already correct", fd);
+            return 0;
+        }
+    }
+
     if (fsetfilecon_raw(fd, tcon) < 0) {
         int fsetfilecon_errno = errno;
 
@@ -2233,8 +2233,20 @@ virStorageBackendVolUploadLocal(virConnectPtr conn ATTRIBUTE_UNUSED,
     char *target_path = vol->target.path;
     int ret = -1;
     int has_snap = 0;
+    int oflags = O_WRONLY;
+
+    virCheckFlags(VIR_STORAGE_VOL_UPLOAD_BYPASS_CACHE, -1);
+
+    if (flags & VIR_STORAGE_VOL_UPLOAD_BYPASS_CACHE) {
+        int directFlag = virFileDirectFdFlag();
+        if (directFlag < 0) {
+            virReportError(VIR_ERR_OPERATION_FAILED, "%s",
+                           _("bypass cache unsupported by this system"));
+            return -1;
+        }
+        oflags |= directFlag;
+    }
 
-    virCheckFlags(0, -1);
     /* if volume has target format VIR_STORAGE_FILE_PLOOP
      * we need to restore DiskDescriptor.xml, according to
      * new contents of volume. This operation will be perfomed
@@ -2259,7 +2271,7 @@ virStorageBackendVolUploadLocal(virConnectPtr conn ATTRIBUTE_UNUSED,
     /* Not using O_CREAT because the file is required to already exist at
      * this point */
     ret = virFDStreamOpenBlockDevice(stream, target_path,
-                                     offset, len, O_WRONLY);
+                                     offset, len, oflags);
 
  cleanup:
     VIR_FREE(path);
@@ -2279,8 +2291,20 @@ virStorageBackendVolDownloadLocal(virConnectPtr conn ATTRIBUTE_UNUSED,
     char *target_path = vol->target.path;
     int ret = -1;
     int has_snap = 0;
+    int oflags = O_RDONLY;
+
+    virCheckFlags(VIR_STORAGE_VOL_DOWNLOAD_BYPASS_CACHE, -1);
+
+    if (flags & VIR_STORAGE_VOL_DOWNLOAD_BYPASS_CACHE) {
+        int directFlag = virFileDirectFdFlag();
+        if (directFlag < 0) {
+            virReportError(VIR_ERR_OPERATION_FAILED, "%s",
+                           _("bypass cache unsupported by this system"));
+            return -1;
+        }
+        oflags |= directFlag;
+    }
 
-    virCheckFlags(0, -1);
     if (vol->target.format == VIR_STORAGE_FILE_PLOOP) {
         has_snap = virStorageBackendPloopHasSnapshots(vol->target.path);
         if (has_snap < 0) {
@@ -2297,7 +2321,7 @@ virStorageBackendVolDownloadLocal(virConnectPtr conn ATTRIBUTE_UNUSED,
     }
 
     ret = virFDStreamOpenBlockDevice(stream, target_path,
-                                     offset, len, O_RDONLY);
+                                     offset, len, oflags);
 
  cleanup:
     VIR_FREE(path);
@@ -43,6 +43,7 @@ typedef int (*virStorageBackendBuildPool)(virConnectPtr conn,
                                           unsigned int flags);
 typedef int (*virStorageBackendRefreshPool)(virConnectPtr conn,
                                             virStoragePoolObjPtr pool);
+typedef bool (*virStorageBackendPoolUpToDate)(virStoragePoolObjPtr pool);
 typedef int (*virStorageBackendStopPool)(virConnectPtr conn,
                                          virStoragePoolObjPtr pool);
 typedef int (*virStorageBackendDeletePool)(virConnectPtr conn,
@@ -171,6 +172,7 @@ struct _virStorageBackend {
     virStorageBackendStartPool startPool;
     virStorageBackendBuildPool buildPool;
     virStorageBackendRefreshPool refreshPool; /* Must be non-NULL */
+    virStorageBackendPoolUpToDate poolUpToDate; /* Optional, skips refreshes */
     virStorageBackendStopPool stopPool;
     virStorageBackendDeletePool deletePool;
 
@@ -49,8 +49,17 @@
 #include "viralloc.h"
 #include "virxml.h"
 #include "virfile.h"
+#include "virhash.h"
+#include "virhostcpu.h"
 #include "virlog.h"
 #include "virstring.h"
+#include "virthread.h"
+#include "viruuid.h"
+#include "virutil.h"
+
+#ifdef __linux__
+# include <sys/inotify.h>
+#endif
 
 #define VIR_FROM_THIS VIR_FROM_STORAGE
 
@@ -874,6 +883,279 @@ virStorageBackendFileSystemBuild(virConnectPtr conn ATTRIBUTE_UNUSED,
 }
 
 
+#ifdef __linux__
+
+/*
+ * Directory content watches let an explicit pool refresh become a
+ * no-op when nothing changed since the last scan.  The state lives in
+ * a table keyed on the pool UUID rather than on the pool object so it
+ * survives virStoragePoolObjClearVols and pool restarts.  Only local
+ * filesystems can be watched this way; a netfs pool never registers
+ * here since remote writers produce no inotify events.
+ */
+typedef struct _virStorageBackendFsWatch virStorageBackendFsWatch;
+struct _virStorageBackendFsWatch {
+    int fd;       /* inotify descriptor watching the pool directory */
+    bool primed;  /* a full scan finished with the watch armed */
+};
+
+static virMutex virStorageBackendFsWatchLock;
+static virHashTablePtr virStorageBackendFsWatches;
+
+/* Anything that creates, removes, renames or rewrites a file in the
+ * pool directory; IN_ATTRIB covers chown and chmod, which change what
+ * the volume XML reports. */
+# define VIR_STORAGE_FS_WATCH_EVENTS \
+    (IN_ATTRIB | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | \
+     IN_MOVED_FROM | IN_MOVED_TO)
+
+static void
+virStorageBackendFsWatchDataFree(void *payload,
+                                 const void *name ATTRIBUTE_UNUSED)
+{
+    virStorageBackendFsWatch *watch = payload;
+
+    VIR_FORCE_CLOSE(watch->fd);
+    VIR_FREE(watch);
+}
+
+static int
+virStorageBackendFsWatchOnceInit(void)
+{
+    if (virMutexInit(&virStorageBackendFsWatchLock) < 0)
+        return -1;
+
+    if (!(virStorageBackendFsWatches =
+          virHashCreate(10, virStorageBackendFsWatchDataFree)))
+        return -1;
+
+    return 0;
+}
+
+VIR_ONCE_GLOBAL_INIT(virStorageBackendFsWatch)
+
+/*
+ * Check whether the directory may have changed since the watch was
+ * last drained.  Returns false only when the kernel positively
+ * reported no events; a queue overflow or the demise of the watched
+ * directory invalidates the watch so it is recreated on the next
+ * scan.
+ */
+static bool
+virStorageBackendFsWatchDirty(virStorageBackendFsWatch *watch)
+{
+    char buf[4096]
+        __attribute__((aligned(__alignof__(struct inotify_event))));
+    bool dirty = false;
+    ssize_t len;
+
+    while ((len = read(watch->fd, buf, sizeof(buf))) != 0) {
+        size_t off = 0;
+
+        if (len < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN) {
+                VIR_FORCE_CLOSE(watch->fd);
+                watch->primed = false;
+                return true;
+            }
+            break;
+        }
+
+        dirty = true;
+        while (off < (size_t) len) {
+            struct inotify_event *ev = (struct inotify_event *) (buf + off);
+
+            if (ev->mask & (IN_IGNORED | IN_DELETE_SELF |
+                            IN_MOVE_SELF | IN_Q_OVERFLOW)) {
+                VIR_FORCE_CLOSE(watch->fd);
+                watch->primed = false;
+                return true;
+            }
+            off += sizeof(*ev) + ev->len;
+        }
+    }
+
+    if (dirty)
+        watch->primed = false;
+    return dirty;
+}
+
+/* Make sure the pool directory is being watched, recreating the
+ * descriptor if a previous watch was invalidated.  Failure is not
+ * fatal - the pool merely keeps doing full rescans. */
+static void
+virStorageBackendFileSystemArmWatch(virStoragePoolObjPtr pool)
+{
+    char uuid[VIR_UUID_STRING_BUFLEN];
+    virStorageBackendFsWatch *watch;
+
+    if (pool->def->type == VIR_STORAGE_POOL_NETFS ||
+        virStorageBackendFsWatchInitialize() < 0)
+        return;
+
+    virUUIDFormat(pool->def->uuid, uuid);
+
+    virMutexLock(&virStorageBackendFsWatchLock);
+    if (!(watch = virHashLookup(virStorageBackendFsWatches, uuid))) {
+        if (VIR_ALLOC_QUIET(watch) < 0)
+            goto cleanup;
+        watch->fd = -1;
+        if (virHashAddEntry(virStorageBackendFsWatches, uuid, watch) < 0) {
+            VIR_FREE(watch);
+            goto cleanup;
+        }
+    }
+
+    /* a scan is about to start; the watch only covers the volume list
+     * again once that scan finishes successfully */
+    watch->primed = false;
+
+    if (watch->fd == -1) {
+        if ((watch->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) < 0)
+            goto cleanup;
+        if (inotify_add_watch(watch->fd, pool->def->target.path,
+                              VIR_STORAGE_FS_WATCH_EVENTS) < 0)
+            VIR_FORCE_CLOSE(watch->fd);
+    }
+ cleanup:
+    virMutexUnlock(&virStorageBackendFsWatchLock);
+}
+
+/* Mark the watch as covering the volume list just built.  Events that
+ * arrived while the scan ran stay queued and simply cause one more
+ * full scan later. */
+static void
+virStorageBackendFileSystemPrimeWatch(virStoragePoolObjPtr pool)
+{
+    char uuid[VIR_UUID_STRING_BUFLEN];
+    virStorageBackendFsWatch *watch;
+
+    if (pool->def->type == VIR_STORAGE_POOL_NETFS ||
+        virStorageBackendFsWatchInitialize() < 0)
+        return;
+
+    virUUIDFormat(pool->def->uuid, uuid);
+
+    virMutexLock(&virStorageBackendFsWatchLock);
+    if ((watch = virHashLookup(virStorageBackendFsWatches, uuid)) &&
+        watch->fd != -1)
+        watch->primed = true;
+    virMutexUnlock(&virStorageBackendFsWatchLock);
+}
+
+static void
+virStorageBackendFileSystemForgetWatch(virStoragePoolObjPtr pool)
+{
+    char uuid[VIR_UUID_STRING_BUFLEN];
+
+    if (virStorageBackendFsWatchInitialize() < 0)
+        return;
+
+    virUUIDFormat(pool->def->uuid, uuid);
+
+    virMutexLock(&virStorageBackendFsWatchLock);
+    ignore_value(virHashRemoveEntry(virStorageBackendFsWatches, uuid));
+    virMutexUnlock(&virStorageBackendFsWatchLock);
+}
+
+static bool
+virStorageBackendFileSystemIsUpToDate(virStoragePoolObjPtr pool)
+{
+    char uuid[VIR_UUID_STRING_BUFLEN];
+    virStorageBackendFsWatch *watch;
+    bool fresh = false;
+
+    if (virStorageBackendFsWatchInitialize() < 0)
+        return false;
+
+    virUUIDFormat(pool->def->uuid, uuid);
+
+    virMutexLock(&virStorageBackendFsWatchLock);
+    if ((watch = virHashLookup(virStorageBackendFsWatches, uuid)) &&
+        watch->fd != -1 &&
+        !virStorageBackendFsWatchDirty(watch) &&
+        watch->primed)
+        fresh = true;
+    virMutexUnlock(&virStorageBackendFsWatchLock);
+
+    return fresh;
+}
+
+#else /* !__linux__ */
+
+static void
+virStorageBackendFileSystemArmWatch(virStoragePoolObjPtr pool ATTRIBUTE_UNUSED)
+{
+}
+
+static void
+virStorageBackendFileSystemPrimeWatch(virStoragePoolObjPtr pool ATTRIBUTE_UNUSED)
+{
+}
+
+static void
+virStorageBackendFileSystemForgetWatch(virStoragePoolObjPtr pool ATTRIBUTE_UNUSED)
+{
+}
+
+static bool
+virStorageBackendFileSystemIsUpToDate(virStoragePoolObjPtr pool ATTRIBUTE_UNUSED)
+{
+    return false;
+}
+
+#endif /* !__linux__ */
+
+
+struct virStorageBackendFileSystemProbeJobs {
+    virMutex lock;
+    virStorageVolDefPtr *vols;
+    size_t nvols;
+    size_t next;
+    int *results;
+    virErrorPtr *errors;
+};
+
+
+static void
+virStorageBackendFileSystemProbeWorker(void *opaque)
+{
+    struct virStorageBackendFileSystemProbeJobs *jobs = opaque;
+
+    for (;;) {
+        size_t i;
+        virStorageVolDefPtr vol;
+
+        virMutexLock(&jobs->lock);
+        i = jobs->next++;
+        virMutexUnlock(&jobs->lock);
+
+        if (i >= jobs->nvols)
+            break;
+
+        vol = jobs->vols[i];
+        jobs->results[i] = virStorageBackendProbeTarget(&vol->target,
+                                                        &vol->target.encryption);
+        if (jobs->results[i] < 0 && jobs->results[i] != -3) {
+            jobs->errors[i] = virSaveLastError();
+            virResetLastError();
+            continue;
+        }
+
+        if (vol->target.backingStore) {
+            ignore_value(virStorageBackendUpdateVolTargetInfo(vol->target.backingStore,
+                                                              false,
+                                                              VIR_STORAGE_VOL_OPEN_DEFAULT, 0));
+            /* If this failed, the backing file is currently unavailable,
+             * the capacity, allocation, owner, group and mode are unknown.
+             * An error message was raised, but we just continue. */
+        }
+    }
+}
+
+
 /**
  * Iterate over the pool's directory and enumerate all disk images
  * within it. This is non-recursive.
@@ -888,15 +1170,29 @@ virStorageBackendFileSystemRefresh(virConnectPtr conn ATTRIBUTE_UNUSED,
     struct stat statbuf;
     virStorageVolDefPtr vol = NULL;
     virStorageSourcePtr target = NULL;
+    struct virStorageBackendFileSystemProbeJobs jobs = { .next = 0 };
+    virThreadPtr workers = NULL;
+    size_t nspawned = 0;
+    size_t nworkers;
+    int hostcpus;
+    size_t i;
     int direrr;
     int fd = -1, ret = -1;
 
+    if (virMutexInit(&jobs.lock) < 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("cannot initialize mutex"));
+        return -1;
+    }
+
+    /* Watch the directory before scanning it, so any change racing
+     * with the scan is reported and triggers another scan later */
+    virStorageBackendFileSystemArmWatch(pool);
+
     if (virDirOpen(&dir, pool->def->target.path) < 0)
         goto cleanup;
 
     while ((direrr = virDirRead(dir, &ent, pool->def->target.path)) > 0) {
-        int err;
-
         if (virStringHasControlChars(ent->d_name)) {
             VIR_WARN("Ignoring file with control characters under '%s'",
                      pool->def->target.path);
@@ -919,8 +1215,53 @@ virStorageBackendFileSystemRefresh(virConnectPtr conn ATTRIBUTE_UNUSED,
         if (VIR_STRDUP(vol->key, vol->target.path) < 0)
             goto cleanup;
 
-        if ((err = virStorageBackendProbeTarget(&vol->target,
-                                                &vol->target.encryption)) < 0) {
+        if (VIR_APPEND_ELEMENT(jobs.vols, jobs.nvols, vol) < 0)
+            goto cleanup;
+    }
+    if (direrr < 0)
+        goto cleanup;
+    VIR_DIR_CLOSE(dir);
+
+    if (jobs.nvols) {
+        if (VIR_ALLOC_N(jobs.results, jobs.nvols) < 0 ||
+            VIR_ALLOC_N(jobs.errors, jobs.nvols) < 0)
+            goto cleanup;
+
+        /* Probing a volume is dominated by I/O (stat, open and header
+         * reads), which on network filesystems has a high per-file
+         * latency; fan the probing out over a few threads. Each worker
+         * only ever touches the volumes it claimed. */
+        if ((hostcpus = virHostCPUGetCount()) < 1)
+            hostcpus = 1;
+        nworkers = MIN((size_t) hostcpus, jobs.nvols);
+
+        if (nworkers > 1 &&
+            VIR_ALLOC_N(workers, nworkers - 1) < 0)
+            goto cleanup;
+
+        for (i = 0; i < nworkers - 1; i++) {
+            if (virThreadCreate(&workers[i], true,
+                                virStorageBackendFileSystemProbeWorker,
+                                &jobs) < 0)
+                break;
+            nspawned++;
+        }
+
+        /* this thread works too, and picks up everything when no
+         * worker could be spawned */
+        virStorageBackendFileSystemProbeWorker(&jobs);
+
+        for (i = 0; i < nspawned; i++)
+            virThreadJoin(&workers[i]);
+    }
+
+    for (i = 0; i < jobs.nvols; i++) {
+        int err = jobs.results[i];
+
+        vol = jobs.vols[i];
+        jobs.vols[i] = NULL;
+
+        if (err < 0) {
             if (err == -2) {
                 /* Silently ignore non-regular files,
                  * eg 'lost+found', dangling symbolic link */
@@ -934,6 +1275,11 @@ virStorageBackendFileSystemRefresh(virConnectPtr conn ATTRIBUTE_UNUSED,
                  * break virStorageVolTargetDefFormat() generating the line
                  * <format type='...'/>. */
             } else {
+                if (jobs.errors[i]) {
+                    virSetError(jobs.errors[i]);
+                    virFreeError(jobs.errors[i]);
+                    jobs.errors[i] = NULL;
+                }
                 goto cleanup;
             }
         }
@@ -945,21 +1291,9 @@ virStorageBackendFileSystemRefresh(virConnectPtr conn ATTRIBUTE_UNUSED,
         if (vol->target.format == VIR_STORAGE_FILE_PLOOP)
             vol->type = VIR_STORAGE_VOL_PLOOP;
 
-        if (vol->target.backingStore) {
-            ignore_value(virStorageBackendUpdateVolTargetInfo(vol->target.backingStore,
-                                                              false,
-                                                              VIR_STORAGE_VOL_OPEN_DEFAULT, 0));
-            /* If this failed, the backing file is currently unavailable,
-             * the capacity, allocation, owner, group and mode are unknown.
-             * An error message was raised, but we just continue. */
-        }
-
         if (VIR_APPEND_ELEMENT(pool->volumes.objs, pool->volumes.count, vol) < 0)
             goto cleanup;
     }
-    if (direrr < 0)
-        goto cleanup;
-    VIR_DIR_CLOSE(dir);
     vol = NULL;
 
     if (VIR_ALLOC(target))
@@ -1003,11 +1337,23 @@ virStorageBackendFileSystemRefresh(virConnectPtr conn ATTRIBUTE_UNUSED,
     if (VIR_STRDUP(pool->def->target.perms.label, target->perms->label) < 0)
         goto cleanup;
 
+    virStorageBackendFileSystemPrimeWatch(pool);
+
     ret = 0;
  cleanup:
     VIR_DIR_CLOSE(dir);
     VIR_FORCE_CLOSE(fd);
     virStorageVolDefFree(vol);
+    for (i = 0; i < jobs.nvols; i++) {
+        virStorageVolDefFree(jobs.vols[i]);
+        if (jobs.errors)
+            virFreeError(jobs.errors[i]);
+    }
+    VIR_FREE(jobs.vols);
+    VIR_FREE(jobs.results);
+    VIR_FREE(jobs.errors);
+    VIR_FREE(workers);
+    virMutexDestroy(&jobs.lock);
     virStorageSourceFree(target);
     if (ret < 0)
         virStoragePoolObjClearVols(pool);
@@ -1029,6 +1375,8 @@ static int
 virStorageBackendFileSystemStop(virConnectPtr conn ATTRIBUTE_UNUSED,
                                 virStoragePoolObjPtr pool)
 {
+    virStorageBackendFileSystemForgetWatch(pool);
+
     if (virStorageBackendFileSystemUnmount(pool) < 0)
         return -1;
 
@@ -1052,6 +1400,8 @@ virStorageBackendFileSystemDelete(virConnectPtr conn ATTRIBUTE_UNUSED,
 {
     virCheckFlags(0, -1);
 
+    virStorageBackendFileSystemForgetWatch(pool);
+
     /* XXX delete all vols first ? */
 
     if (rmdir(pool->def->target.path) < 0) {
@@ -1407,6 +1757,7 @@ virStorageBackend virStorageBackendDirectory = {
     .buildPool = virStorageBackendFileSystemBuild,
     .checkPool = virStorageBackendFileSystemCheck,
     .refreshPool = virStorageBackendFileSystemRefresh,
+    .poolUpToDate = virStorageBackendFileSystemIsUpToDate,
     .deletePool = virStorageBackendFileSystemDelete,
     .buildVol = virStorageBackendFileSystemVolBuild,
     .buildVolFrom = virStorageBackendFileSystemVolBuildFrom,
@@ -1427,6 +1778,7 @@ virStorageBackend virStorageBackendFileSystem = {
     .checkPool = virStorageBackendFileSystemCheck,
     .startPool = virStorageBackendFileSystemStart,
     .refreshPool = virStorageBackendFileSystemRefresh,
+    .poolUpToDate = virStorageBackendFileSystemIsUpToDate,
     .stopPool = virStorageBackendFileSystemStop,
     .deletePool = virStorageBackendFileSystemDelete,
     .buildVol = virStorageBackendFileSystemVolBuild,
@@ -71,6 +71,7 @@ virStorageBackendLogicalSetActive(virStoragePoolObjPtr pool,
 struct virStorageBackendLogicalPoolVolData {
     virStoragePoolObjPtr pool;
     virStorageVolDefPtr vol;
+    bool vgInfoSet;
 };
 
 static int
@@ -215,6 +216,18 @@ virStorageBackendLogicalMakeVol(char **const groups,
     int ret = -1;
     const char *attrs = groups[9];
 
+    /* The volume group totals ride along on every row; parse them
+     * before any of the skip checks below so that even rows we
+     * otherwise ignore update the pool information */
+    if (virStrToLong_ull(groups[10], NULL, 10, &pool->def->capacity) < 0 ||
+        virStrToLong_ull(groups[11], NULL, 10, &pool->def->available) < 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       "%s", _("malformed volume group size value"));
+        return -1;
+    }
+    pool->def->allocation = pool->def->capacity - pool->def->available;
+    data->vgInfoSet = true;
+
     /* Skip inactive volume */
     if (attrs[4] != 'a')
         return 0;
@@ -323,9 +336,11 @@ virStorageBackendLogicalMakeVol(char **const groups,
 #define VIR_STORAGE_VOL_LOGICAL_VG_EXTENT_SIZE_REGEX "([0-9]+)#"
 #define VIR_STORAGE_VOL_LOGICAL_SIZE_REGEX "([0-9]+)#"
 #define VIR_STORAGE_VOL_LOGICAL_LV_ATTR_REGEX "(\\S+)#"
+#define VIR_STORAGE_VOL_LOGICAL_VG_SIZE_REGEX "([0-9]+)#"
+#define VIR_STORAGE_VOL_LOGICAL_VG_FREE_REGEX "([0-9]+)#"
 #define VIR_STORAGE_VOL_LOGICAL_SUFFIX_REGEX "?\\s*$"
 
-#define VIR_STORAGE_VOL_LOGICAL_REGEX_COUNT 10
+#define VIR_STORAGE_VOL_LOGICAL_REGEX_COUNT 12
 #define VIR_STORAGE_VOL_LOGICAL_REGEX \
            VIR_STORAGE_VOL_LOGICAL_PREFIX_REGEX \
            VIR_STORAGE_VOL_LOGICAL_LV_NAME_REGEX \
@@ -338,15 +353,18 @@ virStorageBackendLogicalMakeVol(char **const groups,
            VIR_STORAGE_VOL_LOGICAL_VG_EXTENT_SIZE_REGEX \
            VIR_STORAGE_VOL_LOGICAL_SIZE_REGEX \
            VIR_STORAGE_VOL_LOGICAL_LV_ATTR_REGEX \
+           VIR_STORAGE_VOL_LOGICAL_VG_SIZE_REGEX \
+           VIR_STORAGE_VOL_LOGICAL_VG_FREE_REGEX \
            VIR_STORAGE_VOL_LOGICAL_SUFFIX_REGEX
 
 static int
 virStorageBackendLogicalFindLVs(virStoragePoolObjPtr pool,
-                                virStorageVolDefPtr vol)
+                                virStorageVolDefPtr vol,
+                                bool *vgInfoSet)
 {
     /*
      * # lvs --separator # --noheadings --units b --unbuffered --nosuffix --options \
-     * "lv_name,origin,uuid,devices,segtype,stripes,seg_size,vg_extent_size,size,lv_attr" VGNAME
+     * "lv_name,origin,uuid,devices,segtype,stripes,seg_size,vg_extent_size,size,lv_attr,vg_size,vg_free" VGNAME
      *
      * RootLV##06UgP5-2rhb-w3Bo-3mdR-WeoL-pytO-SAa2ky#/dev/hda2(0)#linear#1#5234491392#33554432#5234491392#-wi-ao
      * SwapLV##oHviCK-8Ik0-paqS-V20c-nkhY-Bm1e-zgzU0M#/dev/hda2(156)#linear#1#1040187392#33554432#1040187392#-wi-ao
@@ -389,7 +407,7 @@ virStorageBackendLogicalFindLVs(virStoragePoolObjPtr pool,
                                "--unbuffered",
                                "--nosuffix",
                                "--options",
-                               "lv_name,origin,uuid,devices,segtype,stripes,seg_size,vg_extent_size,size,lv_attr",
+                               "lv_name,origin,uuid,devices,segtype,stripes,seg_size,vg_extent_size,size,lv_attr,vg_size,vg_free",
                                pool->def->source.name,
                                NULL);
     if (virCommandRunRegex(cmd,
@@ -402,6 +420,9 @@ virStorageBackendLogicalFindLVs(virStoragePoolObjPtr pool,
                            NULL) < 0)
         goto cleanup;
 
+    if (vgInfoSet)
+        *vgInfoSet = cbdata.vgInfoSet;
+
     ret = 0;
  cleanup:
     virCommandFree(cmd);
@@ -775,14 +796,23 @@ virStorageBackendLogicalRefreshPool(virConnectPtr conn ATTRIBUTE_UNUSED,
         2
     };
     virCommandPtr cmd = NULL;
+    bool vgInfoSet = false;
     int ret = -1;
 
     virFileWaitForDevices();
 
     /* Get list of all logical volumes */
-    if (virStorageBackendLogicalFindLVs(pool, NULL) < 0)
+    if (virStorageBackendLogicalFindLVs(pool, NULL, &vgInfoSet) < 0)
         goto cleanup;
 
+    /* lvs already reported the volume group totals along with every
+     * volume; only an empty group, which produces no lvs output at
+     * all, still needs the separate vgs invocation */
+    if (vgInfoSet) {
+        ret = 0;
+        goto cleanup;
+    }
+
     cmd = virCommandNewArgList(VGS,
                                "--separator", ":",
                                "--noheadings",
@@ -985,7 +1015,7 @@ virStorageBackendLogicalCreateVol(virConnectPtr conn,
     }
 
     /* Fill in data about this new vol */
-    if (virStorageBackendLogicalFindLVs(pool, vol) < 0) {
+    if (virStorageBackendLogicalFindLVs(pool, vol, NULL) < 0) {
         virReportSystemError(errno,
                              _("cannot find newly created volume '%s'"),
                              vol->target.path);
@@ -34,6 +34,8 @@
 #include "viruuid.h"
 #include "virstring.h"
 #include "virrandom.h"
+#include "virhostcpu.h"
+#include "virutil.h"
 #include "rados/librados.h"
 #include "rbd/librbd.h"
 #include "secret_util.h"
@@ -260,6 +262,96 @@ virStorageBackendRBDNewState(virConnectPtr conn,
 }
 
 
+/* Cached RADOS connections, keyed by pool UUID.
+ *
+ * Establishing a RADOS connection means several round trips to the
+ * monitors for authentication and retrieving the cluster maps before
+ * the first RBD operation can even be issued. Keep the handle of each
+ * pool around between operations instead of paying that price on
+ * every volume refresh or creation. A handle is dropped rather than
+ * returned to the cache whenever the operation using it failed, so a
+ * broken connection heals itself on the next call.
+ */
+static virMutex virStorageBackendRBDConnCacheLock;
+static virHashTablePtr virStorageBackendRBDConnCache;
+
+static void
+virStorageBackendRBDConnCacheDataFree(void *payload,
+                                      const void *name ATTRIBUTE_UNUSED)
+{
+    virStorageBackendRBDStatePtr ptr = payload;
+
+    virStorageBackendRBDFreeState(&ptr);
+}
+
+static int
+virStorageBackendRBDConnCacheOnceInit(void)
+{
+    if (virMutexInit(&virStorageBackendRBDConnCacheLock) < 0)
+        return -1;
+
+    if (!(virStorageBackendRBDConnCache =
+          virHashCreate(5, virStorageBackendRBDConnCacheDataFree)))
+        return -1;
+
+    return 0;
+}
+
+VIR_ONCE_GLOBAL_INIT(virStorageBackendRBDConnCache)
+
+
+static virStorageBackendRBDStatePtr
+virStorageBackendRBDAcquireState(virConnectPtr conn,
+                                 virStoragePoolObjPtr pool)
+{
+    virStorageBackendRBDStatePtr ptr = NULL;
+    char uuidstr[VIR_UUID_STRING_BUFLEN];
+
+    if (virStorageBackendRBDConnCacheInitialize() == 0) {
+        virUUIDFormat(pool->def->uuid, uuidstr);
+
+        virMutexLock(&virStorageBackendRBDConnCacheLock);
+        ptr = virHashSteal(virStorageBackendRBDConnCache, uuidstr);
+        virMutexUnlock(&virStorageBackendRBDConnCacheLock);
+
+        if (ptr) {
+            VIR_DEBUG("Reusing cached RADOS connection for pool %s", uuidstr);
+            return ptr;
+        }
+    }
+
+    return virStorageBackendRBDNewState(conn, pool);
+}
+
+
+/* Hand back a connection obtained via virStorageBackendRBDAcquireState.
+ * If @failed is true the handle may be in an undefined state and is
+ * closed instead of being put back into the cache. */
+static void
+virStorageBackendRBDReleaseState(virStoragePoolObjPtr pool,
+                                 virStorageBackendRBDStatePtr *ptr,
+                                 bool failed)
+{
+    char uuidstr[VIR_UUID_STRING_BUFLEN];
+
+    if (!*ptr)
+        return;
+
+    if (!failed &&
+        virStorageBackendRBDConnCacheInitialize() == 0) {
+        virUUIDFormat(pool->def->uuid, uuidstr);
+
+        virMutexLock(&virStorageBackendRBDConnCacheLock);
+        if (virHashUpdateEntry(virStorageBackendRBDConnCache,
+                               uuidstr, *ptr) == 0)
+            *ptr = NULL;
+        virMutexUnlock(&virStorageBackendRBDConnCacheLock);
+    }
+
+    virStorageBackendRBDFreeState(ptr);
+}
+
+
 static int
 volStorageBackendRBDGetFeatures(rbd_image_t image,
                                 const char *volname,
@@ -408,6 +500,46 @@ volStorageBackendRBDRefreshVolInfo(virStorageVolDefPtr vol,
     return ret;
 }
 
+struct virStorageBackendRBDRefreshJobs {
+    virMutex lock;
+    virStoragePoolObjPtr pool;
+    virStorageBackendRBDStatePtr ptr;
+    virStorageVolDefPtr *vols;
+    size_t nvols;
+    size_t next;
+    int *results;
+    virErrorPtr *errors;
+};
+
+
+static void
+virStorageBackendRBDRefreshWorker(void *opaque)
+{
+    struct virStorageBackendRBDRefreshJobs *jobs = opaque;
+
+    for (;;) {
+        size_t i;
+
+        virMutexLock(&jobs->lock);
+        i = jobs->next++;
+        virMutexUnlock(&jobs->lock);
+
+        if (i >= jobs->nvols)
+            break;
+
+        /* librados io contexts may be used from several threads; each
+         * worker opens and stats only the images it claimed */
+        jobs->results[i] = volStorageBackendRBDRefreshVolInfo(jobs->vols[i],
+                                                              jobs->pool,
+                                                              jobs->ptr);
+        if (jobs->results[i] != 0) {
+            jobs->errors[i] = virSaveLastError();
+            virResetLastError();
+        }
+    }
+}
+
+
 static int
 virStorageBackendRBDRefreshPool(virConnectPtr conn,
                                 virStoragePoolObjPtr pool)
@@ -418,10 +550,23 @@ virStorageBackendRBDRefreshPool(virConnectPtr conn,
     int r = 0;
     char *name, *names = NULL;
     virStorageBackendRBDStatePtr ptr = NULL;
+    struct virStorageBackendRBDRefreshJobs jobs = { .next = 0 };
+    virThreadPtr workers = NULL;
+    size_t nspawned = 0;
+    size_t nworkers;
+    int hostcpus;
+    size_t i;
     struct rados_cluster_stat_t clusterstat;
     struct rados_pool_stat_t poolstat;
 
-    if (!(ptr = virStorageBackendRBDNewState(conn, pool)))
+    if (virMutexInit(&jobs.lock) < 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("cannot initialize mutex"));
+        return -1;
+    }
+    jobs.pool = pool;
+
+    if (!(ptr = virStorageBackendRBDAcquireState(conn, pool)))
         goto cleanup;
 
     if ((r = rados_cluster_stat(ptr->cluster, &clusterstat)) < 0) {
@@ -474,7 +619,51 @@ virStorageBackendRBDRefreshPool(virConnectPtr conn,
 
         name += strlen(name) + 1;
 
-        r = volStorageBackendRBDRefreshVolInfo(vol, pool, ptr);
+        if (VIR_APPEND_ELEMENT(jobs.vols, jobs.nvols, vol) < 0) {
+            virStorageVolDefFree(vol);
+            goto cleanup;
+        }
+    }
+
+    if (jobs.nvols) {
+        if (VIR_ALLOC_N(jobs.results, jobs.nvols) < 0 ||
+            VIR_ALLOC_N(jobs.errors, jobs.nvols) < 0)
+            goto cleanup;
+
+        /* Stating an image is a round trip to the OSD holding its
+         * header object; done serially a big pool takes minutes to
+         * refresh, so fan the per-image queries out over a few
+         * threads sharing the one connection */
+        jobs.ptr = ptr;
+        if ((hostcpus = virHostCPUGetCount()) < 1)
+            hostcpus = 1;
+        nworkers = MIN((size_t) hostcpus, jobs.nvols);
+
+        if (nworkers > 1 &&
+            VIR_ALLOC_N(workers, nworkers - 1) < 0)
+            goto cleanup;
+
+        for (i = 0; i < nworkers - 1; i++) {
+            if (virThreadCreate(&workers[i], true,
+                                virStorageBackendRBDRefreshWorker,
+                                &jobs) < 0)
+                break;
+            nspawned++;
+        }
+
+        /* this thread works too, and picks up everything when no
+         * worker could be spawned */
+        virStorageBackendRBDRefreshWorker(&jobs);
+
+        for (i = 0; i < nspawned; i++)
+            virThreadJoin(&workers[i]);
+    }
+
+    for (i = 0; i < jobs.nvols; i++) {
+        virStorageVolDefPtr vol = jobs.vols[i];
+
+        jobs.vols[i] = NULL;
+        r = jobs.results[i];
 
         /* It could be that a volume has been deleted through a different route
          * then libvirt and that will cause a -ENOENT to be returned.
@@ -485,10 +674,17 @@ virStorageBackendRBDRefreshPool(virConnectPtr conn,
          *
          * Do not error out and simply ignore the volume
          */
-        if (r < 0) {
-            if (r == -ENOENT || r == -ETIMEDOUT)
+        if (r != 0) {
+            if (r == ENOENT || r == ETIMEDOUT) {
+                virStorageVolDefFree(vol);
                 continue;
+            }
 
+            if (jobs.errors[i]) {
+                virSetError(jobs.errors[i]);
+                virFreeError(jobs.errors[i]);
+                jobs.errors[i] = NULL;
+            }
             virStorageVolDefFree(vol);
             goto cleanup;
         }
@@ -507,7 +703,17 @@ virStorageBackendRBDRefreshPool(virConnectPtr conn,
 
  cleanup:
     VIR_FREE(names);
-    virStorageBackendRBDFreeState(&ptr);
+    for (i = 0; i < jobs.nvols; i++) {
+        virStorageVolDefFree(jobs.vols[i]);
+        if (jobs.errors)
+            virFreeError(jobs.errors[i]);
+    }
+    VIR_FREE(jobs.vols);
+    VIR_FREE(jobs.errors);
+    VIR_FREE(jobs.results);
+    VIR_FREE(workers);
+    virMutexDestroy(&jobs.lock);
+    virStorageBackendRBDReleaseState(pool, &ptr, ret < 0);
     return ret;
 }
 
@@ -607,7 +813,7 @@ virStorageBackendRBDDeleteVol(virConnectPtr conn,
     if (flags & VIR_STORAGE_VOL_DELETE_ZEROED)
         VIR_WARN("%s", "This storage backend does not support zeroed removal of volumes");
 
-    if (!(ptr = virStorageBackendRBDNewState(conn, pool)))
+    if (!(ptr = virStorageBackendRBDAcquireState(conn, pool)))
         goto cleanup;
 
     if (flags & VIR_STORAGE_VOL_DELETE_WITH_SNAPSHOTS) {
@@ -628,7 +834,7 @@ virStorageBackendRBDDeleteVol(virConnectPtr conn,
     ret = 0;
 
  cleanup:
-    virStorageBackendRBDFreeState(&ptr);
+    virStorageBackendRBDReleaseState(pool, &ptr, ret < 0);
     return ret;
 }
 
@@ -702,7 +908,7 @@ virStorageBackendRBDBuildVol(virConnectPtr conn,
         goto cleanup;
     }
 
-    if (!(ptr = virStorageBackendRBDNewState(conn, pool)))
+    if (!(ptr = virStorageBackendRBDAcquireState(conn, pool)))
         goto cleanup;
 
     if ((r = virStorageBackendRBDCreateImage(ptr->ioctx, vol->name,
@@ -716,7 +922,7 @@ virStorageBackendRBDBuildVol(virConnectPtr conn,
     ret = 0;
 
  cleanup:
-    virStorageBackendRBDFreeState(&ptr);
+    virStorageBackendRBDReleaseState(pool, &ptr, ret < 0);
     return ret;
 }
 
@@ -1040,7 +1246,7 @@ virStorageBackendRBDBuildVolFrom(virConnectPtr conn,
 
     virCheckFlags(0, -1);
 
-    if (!(ptr = virStorageBackendRBDNewState(conn, pool)))
+    if (!(ptr = virStorageBackendRBDAcquireState(conn, pool)))
         goto cleanup;
 
     if ((virStorageBackendRBDCloneImage(ptr->ioctx, origvol->name,
@@ -1050,7 +1256,7 @@ virStorageBackendRBDBuildVolFrom(virConnectPtr conn,
     ret = 0;
 
  cleanup:
-    virStorageBackendRBDFreeState(&ptr);
+    virStorageBackendRBDReleaseState(pool, &ptr, ret < 0);
     return ret;
 }
 
@@ -1062,7 +1268,7 @@ virStorageBackendRBDRefreshVol(virConnectPtr conn,
     virStorageBackendRBDStatePtr ptr = NULL;
     int ret = -1;
 
-    if (!(ptr = virStorageBackendRBDNewState(conn, pool)))
+    if (!(ptr = virStorageBackendRBDAcquireState(conn, pool)))
         goto cleanup;
 
     if (volStorageBackendRBDRefreshVolInfo(vol, pool, ptr) < 0)
@@ -1071,7 +1277,7 @@ virStorageBackendRBDRefreshVol(virConnectPtr conn,
     ret = 0;
 
  cleanup:
-    virStorageBackendRBDFreeState(&ptr);
+    virStorageBackendRBDReleaseState(pool, &ptr, ret < 0);
     return ret;
 }
 
@@ -1089,7 +1295,7 @@ virStorageBackendRBDResizeVol(virConnectPtr conn ATTRIBUTE_UNUSED,
 
     virCheckFlags(0, -1);
 
-    if (!(ptr = virStorageBackendRBDNewState(conn, pool)))
+    if (!(ptr = virStorageBackendRBDAcquireState(conn, pool)))
         goto cleanup;
 
     if ((r = rbd_open(ptr->ioctx, vol->name, &image, NULL)) < 0) {
@@ -1109,7 +1315,7 @@ virStorageBackendRBDResizeVol(virConnectPtr conn ATTRIBUTE_UNUSED,
  cleanup:
     if (image != NULL)
        rbd_close(image);
-    virStorageBackendRBDFreeState(&ptr);
+    virStorageBackendRBDReleaseState(pool, &ptr, ret < 0);
     return ret;
 }
 
@@ -1205,7 +1411,7 @@ virStorageBackendRBDVolWipe(virConnectPtr conn,
 
     VIR_DEBUG("Wiping RBD image %s/%s", pool->def->source.name, vol->name);
 
-    if (!(ptr = virStorageBackendRBDNewState(conn, pool)))
+    if (!(ptr = virStorageBackendRBDAcquireState(conn, pool)))
         goto cleanup;
 
     if ((r = rbd_open(ptr->ioctx, vol->name, &image, NULL)) < 0) {
@@ -1264,7 +1470,7 @@ virStorageBackendRBDVolWipe(virConnectPtr conn,
     if (image)
         rbd_close(image);
 
-    virStorageBackendRBDFreeState(&ptr);
+    virStorageBackendRBDReleaseState(pool, &ptr, ret < 0);
 
     return ret;
 }
@@ -35,6 +35,9 @@
 #include "virfile.h"
 #include "vircommand.h"
 #include "virstring.h"
+#include "virthread.h"
+#include "virhostcpu.h"
+#include "virutil.h"
 
 #define VIR_FROM_THIS VIR_FROM_STORAGE
 
@@ -147,7 +150,9 @@ virStorageBackendSCSISerial(const char *dev)
 
 
 /*
- * Attempt to create a new LUN
+ * Attempt to build a new LUN; the volume is returned via @volRet and
+ * not yet part of the pool, so this may safely run from several
+ * threads concurrently.
  *
  * Returns:
  *
@@ -157,12 +162,13 @@ virStorageBackendSCSISerial(const char *dev)
  *  -2 => Failure to find a stable path, not fatal, caller can try another
  */
 static int
-virStorageBackendSCSINewLun(virStoragePoolObjPtr pool,
-                            uint32_t host ATTRIBUTE_UNUSED,
-                            uint32_t bus,
-                            uint32_t target,
-                            uint32_t lun,
-                            const char *dev)
+virStorageBackendSCSIBuildLun(virStoragePoolObjPtr pool,
+                              uint32_t host ATTRIBUTE_UNUSED,
+                              uint32_t bus,
+                              uint32_t target,
+                              uint32_t lun,
+                              const char *dev,
+                              virStorageVolDefPtr *volRet)
 {
     virStorageVolDefPtr vol = NULL;
     char *devpath = NULL;
@@ -233,12 +239,7 @@ virStorageBackendSCSINewLun(virStoragePoolObjPtr pool,
     if (!(vol->key = virStorageBackendSCSISerial(vol->target.path)))
         goto cleanup;
 
-    pool->def->capacity += vol->target.capacity;
-    pool->def->allocation += vol->target.allocation;
-
-    if (VIR_APPEND_ELEMENT(pool->volumes.objs, pool->volumes.count, vol) < 0)
-        goto cleanup;
-
+    *volRet = vol;
     vol = NULL;
     retval = 0;
 
@@ -395,7 +396,8 @@ processLU(virStoragePoolObjPtr pool,
           uint32_t host,
           uint32_t bus,
           uint32_t target,
-          uint32_t lun)
+          uint32_t lun,
+          virStorageVolDefPtr *vol)
 {
     int retval = -1;
     int device_type;
@@ -426,8 +428,8 @@ processLU(virStoragePoolObjPtr pool,
         return retval;
     }
 
-    retval = virStorageBackendSCSINewLun(pool, host, bus, target, lun,
-                                         block_device);
+    retval = virStorageBackendSCSIBuildLun(pool, host, bus, target, lun,
+                                           block_device, vol);
     if (retval < 0) {
         VIR_DEBUG("Failed to create new storage volume for %u:%u:%u:%u",
                   host, bus, target, lun);
@@ -443,29 +445,92 @@ processLU(virStoragePoolObjPtr pool,
 }
 
 
+typedef struct _virStorageBackendSCSILUAddr virStorageBackendSCSILUAddr;
+struct _virStorageBackendSCSILUAddr {
+    uint32_t bus;
+    uint32_t target;
+    uint32_t lun;
+};
+
+struct virStorageBackendSCSIFindLUsJobs {
+    virMutex lock;
+    virStoragePoolObjPtr pool;
+    uint32_t scanhost;
+    virStorageBackendSCSILUAddr *lus;
+    size_t nlus;
+    size_t next;
+    virStorageVolDefPtr *vols;
+    int *results;
+    virErrorPtr *errors;
+};
+
+
+static void
+virStorageBackendSCSIFindLUsWorker(void *opaque)
+{
+    struct virStorageBackendSCSIFindLUsJobs *jobs = opaque;
+
+    for (;;) {
+        size_t i;
+
+        virMutexLock(&jobs->lock);
+        i = jobs->next++;
+        virMutexUnlock(&jobs->lock);
+
+        if (i >= jobs->nlus)
+            break;
+
+        jobs->results[i] = processLU(jobs->pool, jobs->scanhost,
+                                     jobs->lus[i].bus,
+                                     jobs->lus[i].target,
+                                     jobs->lus[i].lun,
+                                     &jobs->vols[i]);
+        if (jobs->results[i] == -1) {
+            jobs->errors[i] = virSaveLastError();
+            virResetLastError();
+        }
+    }
+}
+
+
 int
 virStorageBackendSCSIFindLUs(virStoragePoolObjPtr pool,
                               uint32_t scanhost)
 {
-    int retval = 0;
+    int retval = -1;
     uint32_t bus, target, lun;
     const char *device_path = "/sys/bus/scsi/devices";
     DIR *devicedir = NULL;
     struct dirent *lun_dirent = NULL;
     char devicepattern[64];
+    struct virStorageBackendSCSIFindLUsJobs jobs = { .next = 0 };
+    virThreadPtr workers = NULL;
+    size_t nspawned = 0;
+    size_t nworkers;
+    int hostcpus;
+    size_t i;
+    int direrr;
     int found = 0;
 
     VIR_DEBUG("Discovering LUs on host %u", scanhost);
 
+    if (virMutexInit(&jobs.lock) < 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("cannot initialize mutex"));
+        return -1;
+    }
+    jobs.pool = pool;
+    jobs.scanhost = scanhost;
+
     virFileWaitForDevices();
 
     if (virDirOpen(&devicedir, device_path) < 0)
-        return -1;
+        goto cleanup;
 
     snprintf(devicepattern, sizeof(devicepattern), "%u:%%u:%%u:%%u\n", scanhost);
 
-    while ((retval = virDirRead(devicedir, &lun_dirent, device_path)) > 0) {
-        int rc;
+    while ((direrr = virDirRead(devicedir, &lun_dirent, device_path)) > 0) {
+        virStorageBackendSCSILUAddr addr;
 
         if (sscanf(lun_dirent->d_name, devicepattern,
                    &bus, &target, &lun) != 3) {
@@ -474,23 +539,97 @@ virStorageBackendSCSIFindLUs(virStoragePoolObjPtr pool,
 
         VIR_DEBUG("Found possible LU '%s'", lun_dirent->d_name);
 
-        rc = processLU(pool, scanhost, bus, target, lun);
-        if (rc == -1) {
-            retval = -1;
-            break;
+        addr.bus = bus;
+        addr.target = target;
+        addr.lun = lun;
+        if (VIR_APPEND_ELEMENT_COPY(jobs.lus, jobs.nlus, addr) < 0)
+            goto cleanup;
+    }
+    if (direrr < 0)
+        goto cleanup;
+
+    if (jobs.nlus) {
+        if (VIR_ALLOC_N(jobs.vols, jobs.nlus) < 0 ||
+            VIR_ALLOC_N(jobs.results, jobs.nlus) < 0 ||
+            VIR_ALLOC_N(jobs.errors, jobs.nlus) < 0)
+            goto cleanup;
+
+        /* Each LUN costs an scsi_id invocation plus opening the block
+         * device, which on a busy SAN can block for a while; spread
+         * the work over a few threads. Building a volume only reads
+         * the pool, the results are collected below. */
+        if ((hostcpus = virHostCPUGetCount()) < 1)
+            hostcpus = 1;
+        nworkers = MIN((size_t) hostcpus, jobs.nlus);
+
+        if (nworkers > 1 &&
+            VIR_ALLOC_N(workers, nworkers - 1) < 0)
+            goto cleanup;
+
+        for (i = 0; i < nworkers - 1; i++) {
+            if (virThreadCreate(&workers[i], true,
+                                virStorageBackendSCSIFindLUsWorker,
+                                &jobs) < 0)
+                break;
+            nspawned++;
         }
-        if (rc == 0)
-            found++;
+
+        /* this thread works too, and picks up everything when no
+         * worker could be spawned */
+        virStorageBackendSCSIFindLUsWorker(&jobs);
+
+        for (i = 0; i < nspawned; i++)
+            virThreadJoin(&workers[i]);
     }
 
-    VIR_DIR_CLOSE(devicedir);
+    for (i = 0; i < jobs.nlus; i++) {
+        virStorageVolDefPtr vol = jobs.vols[i];
 
-    if (retval < 0)
-        return -1;
+        jobs.vols[i] = NULL;
+
+        if (jobs.results[i] == -1) {
+            if (jobs.errors[i]) {
+                virSetError(jobs.errors[i]);
+                virFreeError(jobs.errors[i]);
+                jobs.errors[i] = NULL;
+            }
+            virStorageVolDefFree(vol);
+            goto cleanup;
+        }
+
+        if (jobs.results[i] == 0) {
+            pool->def->capacity += vol->target.capacity;
+            pool->def->allocation += vol->target.allocation;
+
+            if (VIR_APPEND_ELEMENT(pool->volumes.objs, pool->volumes.count,
+                                   vol) < 0) {
+                virStorageVolDefFree(vol);
+                goto cleanup;
+            }
+
+            found++;
+        }
+    }
 
     VIR_DEBUG("Found %d LUs for pool %s", found, pool->def->name);
 
-    return found;
+    retval = found;
+
+ cleanup:
+    VIR_DIR_CLOSE(devicedir);
+    for (i = 0; i < jobs.nlus; i++) {
+        if (jobs.vols)
+            virStorageVolDefFree(jobs.vols[i]);
+        if (jobs.errors)
+            virFreeError(jobs.errors[i]);
+    }
+    VIR_FREE(jobs.lus);
+    VIR_FREE(jobs.vols);
+    VIR_FREE(jobs.results);
+    VIR_FREE(jobs.errors);
+    VIR_FREE(workers);
+    virMutexDestroy(&jobs.lock);
+    return retval;
 }
 
 
@@ -29,6 +29,7 @@
 #include <sys/stat.h>
 #include <sys/param.h>
 #include <fcntl.h>
+#include <time.h>
 
 #if HAVE_PWD_H
 # include <pwd.h>
@@ -50,7 +51,14 @@
 #include "configmake.h"
 #include "virstring.h"
 #include "viraccessapicheck.h"
+#include "virprobe.h"
+#include "virtime.h"
 #include "dirname.h"
+#include "stat-time.h"
+
+#ifdef WITH_DTRACE_PROBES
+# include "libvirt_storage_probes.h"
+#endif
 
 #define VIR_FROM_THIS VIR_FROM_STORAGE
 
@@ -1185,22 +1193,30 @@ storagePoolRefresh(virStoragePoolPtr obj,
         goto cleanup;
     }
 
-    virStoragePoolObjClearVols(pool);
-    if (backend->refreshPool(obj->conn, pool) < 0) {
-        if (backend->stopPool)
-            backend->stopPool(obj->conn, pool);
+    /* Backends watching their pool's content can tell us that nothing
+     * changed since the last scan, in which case the volume list is
+     * still accurate and the rescan can be skipped entirely. */
+    if (backend->poolUpToDate &&
+        backend->poolUpToDate(pool)) {
+        VIR_DEBUG("pool '%s' unchanged since last refresh", pool->def->name);
+    } else {
+        virStoragePoolObjClearVols(pool);
+        if (backend->refreshPool(obj->conn, pool) < 0) {
+            if (backend->stopPool)
+                backend->stopPool(obj->conn, pool);
 
-        event = virStoragePoolEventLifecycleNew(pool->def->name,
-                                                pool->def->uuid,
-                                                VIR_STORAGE_POOL_EVENT_STOPPED,
-                                                0);
-        pool->active = false;
+            event = virStoragePoolEventLifecycleNew(pool->def->name,
+                                                    pool->def->uuid,
+                                                    VIR_STORAGE_POOL_EVENT_STOPPED,
+                                                    0);
+            pool->active = false;
 
-        if (pool->configFile == NULL) {
-            virStoragePoolObjRemove(&driver->pools, pool);
-            pool = NULL;
+            if (pool->configFile == NULL) {
+                virStoragePoolObjRemove(&driver->pools, pool);
+                pool = NULL;
+            }
+            goto cleanup;
         }
-        goto cleanup;
     }
 
     event = virStoragePoolEventRefreshNew(pool->def->name,
@@ -1728,6 +1744,7 @@ storageVolRemoveFromPool(virStoragePoolObjPtr pool,
         if (pool->volumes.objs[i] == vol) {
             VIR_INFO("Deleting volume '%s' from storage pool '%s'",
                      vol->name, pool->def->name);
+            virStoragePoolObjUnindexVol(pool, vol);
             virStorageVolDefFree(vol);
 
             VIR_DELETE_ELEMENT(pool->volumes.objs, i, pool->volumes.count);
@@ -1865,6 +1882,80 @@ storageVolDelete(virStorageVolPtr obj,
 }
 
 
+typedef struct _virStorageVolBuildData virStorageVolBuildData;
+typedef virStorageVolBuildData *virStorageVolBuildDataPtr;
+struct _virStorageVolBuildData {
+    virConnectPtr conn;
+    virStoragePoolObjPtr pool;
+    virStorageBackendPtr backend;
+    virStorageVolDefPtr voldef;      /* owned by the pool, building is set */
+    virStorageVolDefPtr buildvoldef; /* shallow copy, freed by the worker */
+    unsigned int flags;
+};
+
+
+/* Worker for VIR_STORAGE_VOL_CREATE_NO_WAIT; runs the volume build the
+ * caller did not want to wait for. The pool cannot go away while the
+ * build is running since asyncjobs blocks destroy/delete/undefine. */
+static void
+storageVolCreateBuildWorker(void *opaque)
+{
+    virStorageVolBuildDataPtr data = opaque;
+    virStoragePoolObjPtr pool = data->pool;
+    virObjectEventPtr event = NULL;
+    int buildret;
+
+    buildret = data->backend->buildVol(data->conn, pool, data->buildvoldef,
+                                       data->flags);
+
+    VIR_FREE(data->buildvoldef);
+
+    storageDriverLock();
+    virStoragePoolObjLock(pool);
+
+    data->voldef->building = false;
+    pool->asyncjobs--;
+
+    if (buildret < 0) {
+        /* buildVol handles deleting volume on failure */
+        storageVolRemoveFromPool(pool, data->voldef);
+    } else if (data->backend->refreshVol &&
+               data->backend->refreshVol(data->conn, pool,
+                                         data->voldef) < 0) {
+        if (data->backend->deleteVol)
+            ignore_value(data->backend->deleteVol(data->conn, pool,
+                                                  data->voldef, 0));
+        storageVolRemoveFromPool(pool, data->voldef);
+    } else {
+        /* Update pool metadata ignoring the disk backend since
+         * it updates the pool values.
+         */
+        if (pool->def->type != VIR_STORAGE_POOL_DISK) {
+            pool->def->allocation += data->voldef->target.allocation;
+            pool->def->available -= data->voldef->target.allocation;
+        }
+
+        VIR_INFO("Finished building volume '%s' in storage pool '%s'",
+                 data->voldef->name, pool->def->name);
+    }
+
+    /* There is no per-volume event in the public API; a refresh event
+     * tells anyone watching that the volume list settled, whatever the
+     * outcome of the build was */
+    event = virStoragePoolEventRefreshNew(pool->def->name,
+                                          pool->def->uuid);
+
+    virStoragePoolObjUnlock(pool);
+
+    if (event)
+        virObjectEventStateQueue(driver->storageEventState, event);
+    storageDriverUnlock();
+
+    virObjectUnref(data->conn);
+    VIR_FREE(data);
+}
+
+
 static virStorageVolPtr
 storageVolCreateXML(virStoragePoolPtr obj,
                     const char *xmldesc,
@@ -1875,7 +1966,8 @@ storageVolCreateXML(virStoragePoolPtr obj,
     virStorageVolDefPtr voldef = NULL;
     virStorageVolPtr ret = NULL, volobj = NULL;
 
-    virCheckFlags(VIR_STORAGE_VOL_CREATE_PREALLOC_METADATA, NULL);
+    virCheckFlags(VIR_STORAGE_VOL_CREATE_PREALLOC_METADATA |
+                  VIR_STORAGE_VOL_CREATE_NO_WAIT, NULL);
 
     if (!(pool = virStoragePoolObjFromStoragePool(obj)))
         return NULL;
@@ -1931,6 +2023,7 @@ storageVolCreateXML(virStoragePoolPtr obj,
     volobj = virGetStorageVol(obj->conn, pool->def->name, voldef->name,
                               voldef->key, NULL, NULL);
     if (!volobj) {
+        virStoragePoolObjUnindexVol(pool, voldef);
         pool->volumes.count--;
         goto cleanup;
     }
@@ -1954,9 +2047,41 @@ storageVolCreateXML(virStoragePoolPtr obj,
         /* Drop the pool lock during volume allocation */
         pool->asyncjobs++;
         voldef->building = true;
+
+        if (flags & VIR_STORAGE_VOL_CREATE_NO_WAIT) {
+            virStorageVolBuildDataPtr data;
+            virThread thread;
+
+            if (VIR_ALLOC(data) == 0) {
+                data->conn = virObjectRef(obj->conn);
+                data->pool = pool;
+                data->backend = backend;
+                data->voldef = voldef;
+                data->buildvoldef = buildvoldef;
+                data->flags = flags & ~VIR_STORAGE_VOL_CREATE_NO_WAIT;
+
+                if (virThreadCreate(&thread, false,
+                                    storageVolCreateBuildWorker, data) == 0) {
+                    VIR_INFO("Creating volume '%s' in storage pool '%s' "
+                             "in the background",
+                             volobj->name, pool->def->name);
+                    ret = volobj;
+                    volobj = NULL;
+                    voldef = NULL;
+                    goto cleanup;
+                }
+
+                virObjectUnref(data->conn);
+                VIR_FREE(data);
+            }
+
+            /* could not spawn a worker; build synchronously after all */
+        }
+
         virStoragePoolObjUnlock(pool);
 
-        buildret = backend->buildVol(obj->conn, pool, buildvoldef, flags);
+        buildret = backend->buildVol(obj->conn, pool, buildvoldef,
+                                     flags & ~VIR_STORAGE_VOL_CREATE_NO_WAIT);
 
         VIR_FREE(buildvoldef);
 
@@ -2140,6 +2265,7 @@ storageVolCreateXMLFrom(virStoragePoolPtr obj,
     volobj = virGetStorageVol(obj->conn, pool->def->name, newvol->name,
                               newvol->key, NULL, NULL);
     if (!volobj) {
+        virStoragePoolObjUnindexVol(pool, newvol);
         pool->volumes.count--;
         goto cleanup;
     }
@@ -2219,7 +2345,7 @@ storageVolDownload(virStorageVolPtr obj,
     virStorageVolDefPtr vol = NULL;
     int ret = -1;
 
-    virCheckFlags(0, -1);
+    virCheckFlags(VIR_STORAGE_VOL_DOWNLOAD_BYPASS_CACHE, -1);
 
     if (!(vol = virStorageVolDefFromVol(obj, &pool, &backend)))
         return -1;
@@ -2387,7 +2513,7 @@ storageVolUpload(virStorageVolPtr obj,
     virStorageVolStreamInfoPtr cbdata = NULL;
     int ret = -1;
 
-    virCheckFlags(0, -1);
+    virCheckFlags(VIR_STORAGE_VOL_UPLOAD_BYPASS_CACHE, -1);
 
     if (!(vol = virStorageVolDefFromVol(obj, &pool, &backend)))
         return -1;
@@ -3177,6 +3303,261 @@ virStorageFileChown(virStorageSourcePtr src,
 }
 
 
+/* Cache of backing chains parsed by virStorageFileGetMetadata.
+ *
+ * Domains backed by the same base images re-read identical headers on
+ * every start and every block job pivot, which is especially costly on
+ * network filesystems.  The cache keeps a deep copy of each fully
+ * resolved chain together with the (inode, size, mtime) identity of
+ * every element; a hit is only served if all elements still match,
+ * since a deeper backing file may be rewritten (e.g. committed into
+ * from another domain) without the top image changing at all.
+ *
+ * Only chains consisting purely of local regular files are cached;
+ * anything involving network storage, block devices or encryption
+ * takes the full parsing path.
+ */
+typedef struct _virStorageFileMetadataCacheId virStorageFileMetadataCacheId;
+typedef virStorageFileMetadataCacheId *virStorageFileMetadataCacheIdPtr;
+struct _virStorageFileMetadataCacheId {
+    struct timespec mtime;
+    unsigned long long ino;
+    unsigned long long size;
+};
+
+typedef struct _virStorageFileMetadataCacheEntry virStorageFileMetadataCacheEntry;
+typedef virStorageFileMetadataCacheEntry *virStorageFileMetadataCacheEntryPtr;
+struct _virStorageFileMetadataCacheEntry {
+    virStorageSourcePtr chain;  /* deep copy, owned by the cache */
+    virStorageFileMetadataCacheIdPtr ids;  /* one per chain element */
+    size_t nids;
+    uid_t uid;
+    gid_t gid;
+    bool allow_probe;
+    int format;  /* format the lookup started out with */
+};
+
+#define VIR_STORAGE_FILE_METADATA_CACHE_MAX 256
+
+static virMutex virStorageFileMetadataCacheLock;
+static virHashTablePtr virStorageFileMetadataCache;
+
+static void
+virStorageFileMetadataCacheEntryFree(void *payload,
+                                     const void *name ATTRIBUTE_UNUSED)
+{
+    virStorageFileMetadataCacheEntryPtr entry = payload;
+
+    if (!entry)
+        return;
+
+    virStorageSourceFree(entry->chain);
+    VIR_FREE(entry->ids);
+    VIR_FREE(entry);
+}
+
+static int
+virStorageFileMetadataCacheOnceInit(void)
+{
+    if (virMutexInit(&virStorageFileMetadataCacheLock) < 0)
+        return -1;
+
+    if (!(virStorageFileMetadataCache =
+          virHashCreate(53, virStorageFileMetadataCacheEntryFree)))
+        return -1;
+
+    return 0;
+}
+
+VIR_ONCE_GLOBAL_INIT(virStorageFileMetadataCache)
+
+
+/* Fetch the current identity of @src. Returns 0 on success, or -1 if
+ * @src is not a plain local regular file and thus not cacheable. */
+static int
+virStorageFileMetadataCacheGetId(virStorageSourcePtr src,
+                                 virStorageFileMetadataCacheIdPtr id)
+{
+    struct stat sb;
+
+    if (!virStorageSourceIsLocalStorage(src) || !src->path)
+        return -1;
+
+    if (stat(src->path, &sb) < 0 || !S_ISREG(sb.st_mode))
+        return -1;
+
+    id->mtime = get_stat_mtime(&sb);
+    id->ino = sb.st_ino;
+    id->size = sb.st_size;
+    return 0;
+}
+
+
+/* Copy the metadata the parser would have produced from @cached into
+ * @src, leaving the caller-owned fields of @src alone. */
+static int
+virStorageFileMetadataCacheFill(virStorageSourcePtr src,
+                                virStorageSourcePtr cached)
+{
+    virStorageSourcePtr backingStore = NULL;
+    virBitmapPtr features = NULL;
+    char *compat = NULL;
+    char *backingStoreRaw = NULL;
+
+    if (cached->backingStore &&
+        !(backingStore = virStorageSourceCopy(cached->backingStore, true)))
+        return -1;
+
+    if (cached->features &&
+        !(features = virBitmapNewCopy(cached->features)))
+        goto error;
+
+    if (VIR_STRDUP(compat, cached->compat) < 0 ||
+        VIR_STRDUP(backingStoreRaw, cached->backingStoreRaw) < 0)
+        goto error;
+
+    src->format = cached->format;
+    src->capacity = cached->capacity;
+
+    virBitmapFree(src->features);
+    src->features = features;
+
+    VIR_FREE(src->compat);
+    src->compat = compat;
+
+    VIR_FREE(src->backingStoreRaw);
+    src->backingStoreRaw = backingStoreRaw;
+
+    virStorageSourceFree(src->backingStore);
+    src->backingStore = backingStore;
+
+    return 0;
+
+ error:
+    virStorageSourceFree(backingStore);
+    virBitmapFree(features);
+    VIR_FREE(compat);
+    VIR_FREE(backingStoreRaw);
+    return -1;
+}
+
+
+/* Try to satisfy a virStorageFileGetMetadata call for @src from the
+ * cache. Returns true if @src was populated; false on a miss, in which
+ * case the caller parses the chain as usual. */
+static bool
+virStorageFileMetadataCacheLookup(virStorageSourcePtr src,
+                                  uid_t uid, gid_t gid,
+                                  bool allow_probe)
+{
+    virStorageFileMetadataCacheEntryPtr entry;
+    virStorageSourcePtr p;
+    virStorageFileMetadataCacheId id;
+    bool ret = false;
+    size_t i;
+
+    if (!src->path ||
+        virStorageFileMetadataCacheInitialize() < 0)
+        return false;
+
+    virMutexLock(&virStorageFileMetadataCacheLock);
+
+    if (!(entry = virHashLookup(virStorageFileMetadataCache, src->path)))
+        goto cleanup;
+
+    if (entry->uid != uid || entry->gid != gid ||
+        entry->allow_probe != allow_probe ||
+        entry->format != src->format)
+        goto cleanup;
+
+    for (p = entry->chain, i = 0; p; p = p->backingStore, i++) {
+        if (virStorageFileMetadataCacheGetId(p, &id) < 0 ||
+            id.ino != entry->ids[i].ino ||
+            id.size != entry->ids[i].size ||
+            id.mtime.tv_sec != entry->ids[i].mtime.tv_sec ||
+            id.mtime.tv_nsec != entry->ids[i].mtime.tv_nsec) {
+            virHashRemoveEntry(virStorageFileMetadataCache, src->path);
+            goto cleanup;
+        }
+    }
+
+    if (virStorageFileMetadataCacheFill(src, entry->chain) < 0)
+        goto cleanup;
+
+    VIR_DEBUG("serving backing chain of '%s' from metadata cache",
+              src->path);
+    ret = true;
+
+ cleanup:
+    virMutexUnlock(&virStorageFileMetadataCacheLock);
+    return ret;
+}
+
+
+/* Record the freshly parsed chain of @src in the cache. Best effort;
+ * chains the cache cannot represent are silently skipped. */
+static void
+virStorageFileMetadataCacheStore(virStorageSourcePtr src,
+                                 uid_t uid, gid_t gid,
+                                 bool allow_probe,
+                                 int format)
+{
+    virStorageFileMetadataCacheEntryPtr entry = NULL;
+    virStorageSourcePtr p;
+    time_t now = time(NULL);
+    size_t i;
+
+    if (!src->path ||
+        virStorageFileMetadataCacheInitialize() < 0)
+        return;
+
+    if (VIR_ALLOC(entry) < 0)
+        return;
+
+    for (p = src; p; p = p->backingStore)
+        entry->nids++;
+
+    if (VIR_ALLOC_N(entry->ids, entry->nids) < 0)
+        goto cleanup;
+
+    for (p = src, i = 0; p; p = p->backingStore, i++) {
+        /* don't cache broken or encrypted chains, nor files modified
+         * this very second, where a writer may still be racing the
+         * header reads we just did */
+        if (p->encryption ||
+            (p->backingStoreRaw && !p->backingStore) ||
+            virStorageFileMetadataCacheGetId(p, &entry->ids[i]) < 0 ||
+            entry->ids[i].mtime.tv_sec >= now)
+            goto cleanup;
+    }
+
+    if (!(entry->chain = virStorageSourceCopy(src, true)))
+        goto cleanup;
+
+    entry->uid = uid;
+    entry->gid = gid;
+    entry->allow_probe = allow_probe;
+    entry->format = format;
+
+    virMutexLock(&virStorageFileMetadataCacheLock);
+
+    /* the set of images on a host is naturally bounded, but guard
+     * against pathological churn by starting over when full */
+    if (virHashSize(virStorageFileMetadataCache) >=
+        VIR_STORAGE_FILE_METADATA_CACHE_MAX)
+        ignore_value(virHashRemoveAll(virStorageFileMetadataCache));
+
+    if (virHashUpdateEntry(virStorageFileMetadataCache,
+                           src->path, entry) == 0)
+        entry = NULL;
+
+    virMutexUnlock(&virStorageFileMetadataCacheLock);
+
+ cleanup:
+    virStorageFileMetadataCacheEntryFree(entry, NULL);
+}
+
+
 /* Recursive workhorse for virStorageFileGetMetadata.  */
 static int
 virStorageFileGetMetadataRecurse(virStorageSourcePtr src,
@@ -3315,19 +3696,44 @@ virStorageFileGetMetadata(virStorageSourcePtr src,
               allow_probe, report_broken);
 
     virHashTablePtr cycle = NULL;
+    unsigned long long start = 0;
+    unsigned long long now = 0;
+    int format;
     int ret = -1;
 
-    if (!(cycle = virHashCreate(5, NULL)))
-        return -1;
-
     if (src->format <= VIR_STORAGE_FILE_NONE)
         src->format = allow_probe ?
             VIR_STORAGE_FILE_AUTO : VIR_STORAGE_FILE_RAW;
+    format = src->format;
+
+    if (virStorageFileMetadataCacheLookup(src, uid, gid, allow_probe)) {
+        PROBE(STORAGE_FILE_GET_METADATA,
+              "src=%p path=%s format=%d duration=%llu ret=%d",
+              src, NULLSTR(src->path), format, 0ull, 0);
+        return 0;
+    }
+
+    ignore_value(virTimeMillisNow(&start));
+
+    if (!(cycle = virHashCreate(5, NULL)))
+        return -1;
 
     ret = virStorageFileGetMetadataRecurse(src, src, uid, gid,
                                            allow_probe, report_broken, cycle);
 
+    if (ret == 0)
+        virStorageFileMetadataCacheStore(src, uid, gid, allow_probe, format);
+
     virHashFree(cycle);
+
+    /* walking an uncached backing chain does open()+read() per layer,
+     * possibly over the network, and is a known source of stalls */
+    ignore_value(virTimeMillisNow(&now));
+    PROBE(STORAGE_FILE_GET_METADATA,
+          "src=%p path=%s format=%d duration=%llu ret=%d",
+          src, NULLSTR(src->path), format,
+          now > start ? now - start : 0, ret);
+
     return ret;
 }
 
@@ -627,7 +627,7 @@ testDomainStartState(testDriverPtr privconn,
 
     if (virDomainObjSetDefTransient(privconn->caps,
                                     privconn->xmlopt,
-                                    dom) < 0) {
+                                    dom, NULL) < 0) {
         goto cleanup;
     }
 
@@ -5168,6 +5168,7 @@ testStorageVolDelete(virStorageVolPtr vol,
 
     for (i = 0; i < privpool->volumes.count; i++) {
         if (privpool->volumes.objs[i] == privvol) {
+            virStoragePoolObjUnindexVol(privpool, privvol);
             virStorageVolDefFree(privvol);
 
             VIR_DELETE_ELEMENT(privpool->volumes.objs, i, privpool->volumes.count);
@@ -6455,10 +6456,7 @@ testDomainSnapshotCreateXML(virDomainPtr domain,
                 vm->current_snapshot = snap;
             other = virDomainSnapshotFindByName(vm->snapshots,
                                                 snap->def->parent);
-            snap->parent = other;
-            other->nchildren++;
-            snap->sibling = other->first_child;
-            other->first_child = snap;
+            virDomainSnapshotSetParent(snap, other);
         }
         virDomainObjEndAPI(&vm);
     }
@@ -6570,11 +6568,13 @@ testDomainSnapshotDelete(virDomainSnapshotPtr snapshot,
         snap->parent->nchildren += snap->nchildren;
         rep.last->sibling = snap->parent->first_child;
         snap->parent->first_child = snap->first_child;
+        /* The descendants now hang off the parent directly, so only
+         * snap itself is subtracted when it drops off below.  */
+        snap->ndescendants = 0;
     }
 
     if (flags & VIR_DOMAIN_SNAPSHOT_DELETE_CHILDREN_ONLY) {
-        snap->nchildren = 0;
-        snap->first_child = NULL;
+        virDomainSnapshotDropChildren(snap);
     } else {
         virDomainSnapshotDropParent(snap);
         if (snap == vm->current_snapshot) {
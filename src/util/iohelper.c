@@ -31,6 +31,10 @@
 #include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/stat.h>
+#ifdef __linux__
+# include <linux/falloc.h>
+#endif
 
 #include "virutil.h"
 #include "virthread.h"
@@ -72,6 +76,144 @@ prepare(const char *path, int oflags, int mode,
     return fd;
 }
 
+/* Skip a block of zeros on the output file: deallocate whatever the
+ * block currently covers so stale data from an earlier upload cannot
+ * shine through, then step over the resulting hole. Returns -1 if the
+ * filesystem cannot do this, in which case the zeros are written out
+ * like any other data. */
+static int
+skipZeroBlock(int fd, size_t len)
+{
+#if HAVE_FALLOCATE - 0 && defined(FALLOC_FL_PUNCH_HOLE)
+    off_t off;
+
+    if ((off = lseek(fd, 0, SEEK_CUR)) < 0)
+        return -1;
+
+    if (fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                  off, len) < 0)
+        return -1;
+
+    if (lseek(fd, len, SEEK_CUR) < 0)
+        return -1;
+
+    return 0;
+#else
+    return -1;
+#endif
+}
+
+/* O_DIRECT transfers must cover whole, aligned blocks; once the
+ * remainder of a transfer is smaller than that, the tail is finished
+ * with ordinary cached I/O instead of failing the whole copy. */
+static int
+clearDirect(int fd, int oflags, const char *name)
+{
+#ifdef F_SETFL
+    if (fcntl(fd, F_SETFL, oflags & ~O_DIRECT) < 0) {
+        virReportSystemError(errno,
+                             _("unable to clear O_DIRECT flag on %s"),
+                             name);
+        return -1;
+    }
+    return 0;
+#else
+    virReportSystemError(EINVAL,
+                         _("unable to clear O_DIRECT flag on %s"),
+                         name);
+    return -1;
+#endif
+}
+
+/* The copy runs with two buffers in flight: a reader thread fills
+ * one while the main thread writes out the other, so the producer
+ * and consumer side of the copy overlap instead of taking strict
+ * turns on the same buffer. */
+struct ioSlot {
+    char *buf;     /* aligned scratch area */
+    ssize_t got;   /* filled bytes, 0 on EOF, -1 on read error */
+    int err;       /* errno of a failed read */
+    bool full;
+};
+
+struct ioCopy {
+    virMutex lock;
+    virCond cond;
+    struct ioSlot slots[2];
+    size_t buflen;
+    unsigned long long length;
+    int fdin;
+    int fd;          /* the file, for clearing O_DIRECT on tail reads */
+    int oflags;
+    const char *path;
+    bool directRead; /* fdin is the file and it is opened O_DIRECT */
+    intptr_t alignMask;
+    bool abort;      /* the writing side failed, stop reading */
+};
+
+static void
+runIOReader(void *opaque)
+{
+    struct ioCopy *copy = opaque;
+    unsigned long long total = 0;
+    size_t idx = 0;
+
+    for (;;) {
+        struct ioSlot *slot = &copy->slots[idx];
+        size_t want = copy->buflen;
+        ssize_t got = 0;
+
+        virMutexLock(&copy->lock);
+        while (slot->full && !copy->abort)
+            virCondWait(&copy->cond, &copy->lock);
+        if (copy->abort) {
+            virMutexUnlock(&copy->lock);
+            return;
+        }
+        virMutexUnlock(&copy->lock);
+
+        if (copy->length &&
+            (copy->length - total) < want)
+            want = copy->length - total;
+
+        /* An unaligned tail read from an O_DIRECT file has to go
+         * through the cache. Errors only get an errno recorded here;
+         * libvirt errors are thread local, so the main thread turns
+         * them into proper reports. */
+        if (want && copy->directRead && (want & copy->alignMask)) {
+#ifdef F_SETFL
+            if (fcntl(copy->fd, F_SETFL, copy->oflags & ~O_DIRECT) < 0) {
+                slot->err = errno;
+                got = -1;
+            } else {
+                copy->directRead = false;
+            }
+#else
+            slot->err = EINVAL;
+            got = -1;
+#endif
+        }
+
+        if (got == 0 && want &&
+            (got = saferead(copy->fdin, slot->buf, want)) < 0)
+            slot->err = errno;
+
+        if (got > 0)
+            total += got;
+
+        virMutexLock(&copy->lock);
+        slot->got = got;
+        slot->full = true;
+        virCondBroadcast(&copy->cond);
+        virMutexUnlock(&copy->lock);
+
+        if (got <= 0)
+            return;
+
+        idx = !idx;
+    }
+}
+
 static int
 runIO(const char *path, int fd, int oflags, unsigned long long length)
 {
@@ -82,19 +224,32 @@ runIO(const char *path, int fd, int oflags, unsigned long long length)
     int ret = -1;
     int fdin, fdout;
     const char *fdinname, *fdoutname;
-    unsigned long long total = 0;
     bool direct = O_DIRECT && ((oflags & O_DIRECT) != 0);
-    bool shortRead = false; /* true if we hit a short read */
-    off_t end = 0;
+    bool sparse = false;
+    bool skippedEnd = false; /* true if the last block became a hole */
+    struct ioCopy copy = { .abort = false };
+    virThread reader;
+    bool haveReader = false;
+    size_t idx = 0;
+    const char *env;
+    unsigned int bufkb;
+    struct stat sb;
+
+    /* Larger chunks keep fast devices busier at the cost of memory;
+     * the value is rounded up to a whole alignment block so O_DIRECT
+     * transfers stay aligned */
+    if ((env = getenv("LIBVIRT_IOHELPER_BUFFER_KB")) &&
+        virStrToLong_ui(env, NULL, 10, &bufkb) == 0 && bufkb > 0)
+        buflen = ((size_t)bufkb * 1024 + alignMask) & ~alignMask;
 
 #if HAVE_POSIX_MEMALIGN
-    if (posix_memalign(&base, alignMask + 1, buflen)) {
+    if (posix_memalign(&base, alignMask + 1, 2 * buflen)) {
         virReportOOMError();
         goto cleanup;
     }
     buf = base;
 #else
-    if (VIR_ALLOC_N(buf, buflen + alignMask) < 0)
+    if (VIR_ALLOC_N(buf, 2 * buflen + alignMask) < 0)
         goto cleanup;
     base = buf;
     buf = (char *) (((intptr_t) base + alignMask) & ~alignMask);
@@ -106,26 +261,23 @@ runIO(const char *path, int fd, int oflags, unsigned long long length)
         fdinname = path;
         fdout = STDOUT_FILENO;
         fdoutname = "stdout";
-        /* To make the implementation simpler, we give up on any
-         * attempt to use O_DIRECT in a non-trivial manner.  */
-        if (direct && ((end = lseek(fd, 0, SEEK_CUR)) != 0 || length)) {
-            virReportSystemError(end < 0 ? errno : EINVAL, "%s",
-                                 _("O_DIRECT read needs entire seekable file"));
-            goto cleanup;
-        }
+#if HAVE_POSIX_FADVISE
+        /* The file is read strictly sequentially exactly once, which
+         * is what the kernel readahead logic optimizes for best */
+        if (!direct)
+            ignore_value(posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL));
+#endif
         break;
     case O_WRONLY:
         fdin = STDIN_FILENO;
         fdinname = "stdin";
         fdout = fd;
         fdoutname = path;
-        /* To make the implementation simpler, we give up on any
-         * attempt to use O_DIRECT in a non-trivial manner.  */
-        if (direct && (end = lseek(fd, 0, SEEK_END)) != 0) {
-            virReportSystemError(end < 0 ? errno : EINVAL, "%s",
-                                 _("O_DIRECT write needs empty seekable file"));
-            goto cleanup;
-        }
+        /* Mostly sparse images arrive as long runs of zeros; rather
+         * than materializing them turn such blocks back into holes.
+         * O_DIRECT keeps the plain aligned-write path. */
+        if (!direct && fstat(fd, &sb) == 0 && S_ISREG(sb.st_mode))
+            sparse = true;
         break;
 
     case O_RDWR:
@@ -136,42 +288,86 @@ runIO(const char *path, int fd, int oflags, unsigned long long length)
         goto cleanup;
     }
 
+    copy.buflen = buflen;
+    copy.length = length;
+    copy.fdin = fdin;
+    copy.fd = fd;
+    copy.oflags = oflags;
+    copy.path = path;
+    copy.alignMask = alignMask;
+    copy.directRead = direct && fdin == fd;
+    copy.slots[0].buf = buf;
+    copy.slots[1].buf = buf + buflen;
+
+    if (virMutexInit(&copy.lock) < 0) {
+        virReportSystemError(errno, "%s", _("Unable to initialize mutex"));
+        goto cleanup;
+    }
+    if (virCondInit(&copy.cond) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("Unable to initialize condition variable"));
+        virMutexDestroy(&copy.lock);
+        goto cleanup;
+    }
+    if (virThreadCreate(&reader, true, runIOReader, &copy) < 0) {
+        virReportSystemError(errno, "%s", _("Unable to create reader thread"));
+        virCondDestroy(&copy.cond);
+        virMutexDestroy(&copy.lock);
+        goto cleanup;
+    }
+    haveReader = true;
+
     while (1) {
+        struct ioSlot *slot = &copy.slots[idx];
         ssize_t got;
+        bool skipped = false;
 
-        if (length &&
-            (length - total) < buflen)
-            buflen = length - total;
-
-        if (buflen == 0)
-            break; /* End of requested data from client */
+        virMutexLock(&copy.lock);
+        while (!slot->full)
+            virCondWait(&copy.cond, &copy.lock);
+        virMutexUnlock(&copy.lock);
 
-        if ((got = saferead(fdin, buf, buflen)) < 0) {
-            virReportSystemError(errno, _("Unable to read %s"), fdinname);
+        got = slot->got;
+        if (got < 0) {
+            virReportSystemError(slot->err, _("Unable to read %s"), fdinname);
             goto cleanup;
         }
         if (got == 0)
-            break; /* End of file before end of requested data */
-        if (got < buflen || (buflen & alignMask)) {
-            /* O_DIRECT can handle at most one short read, at end of file */
-            if (direct && shortRead) {
-                virReportSystemError(EINVAL, "%s",
-                                     _("Too many short reads for O_DIRECT"));
-            }
-            shortRead = true;
-        }
-
-        total += got;
-        if (fdout == fd && direct && shortRead) {
-            end = total;
-            memset(buf + got, 0, buflen - got);
-            got = (got + alignMask) & ~alignMask;
+            break; /* End of file, or end of requested data */
+
+        if (fdout == fd && direct && (got & alignMask)) {
+            /* A short read from the client ends the transfer mid
+             * block, so the final write has to go through the cache */
+            if (clearDirect(fd, oflags, path) < 0)
+                goto cleanup;
+            direct = false;
         }
-        if (safewrite(fdout, buf, got) < 0) {
+        if (sparse &&
+            slot->buf[0] == '\0' &&
+            memcmp(slot->buf, slot->buf + 1, got - 1) == 0 &&
+            skipZeroBlock(fd, got) == 0)
+            skipped = true;
+        if (!skipped && safewrite(fdout, slot->buf, got) < 0) {
             virReportSystemError(errno, _("Unable to write %s"), fdoutname);
             goto cleanup;
         }
-        if (end && ftruncate(fd, end) < 0) {
+        skippedEnd = skipped;
+
+        virMutexLock(&copy.lock);
+        slot->full = false;
+        virCondBroadcast(&copy.cond);
+        virMutexUnlock(&copy.lock);
+
+        idx = !idx;
+    }
+
+    /* A hole at the end of the file still has to move EOF */
+    if (skippedEnd) {
+        off_t cur;
+
+        if ((cur = lseek(fd, 0, SEEK_CUR)) < 0 ||
+            (fstat(fd, &sb) == 0 && sb.st_size < cur &&
+             ftruncate(fd, cur) < 0)) {
             virReportSystemError(errno, _("Unable to truncate %s"), fdoutname);
             goto cleanup;
         }
@@ -186,9 +382,26 @@ runIO(const char *path, int fd, int oflags, unsigned long long length)
         }
     }
 
+#if HAVE_POSIX_FADVISE
+    /* The helper only ever does one-shot bulk copies, so the pages
+     * left behind in the page cache have no future readers; release
+     * them rather than let them push out more useful data */
+    ignore_value(posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED));
+#endif
+
     ret = 0;
 
  cleanup:
+    if (haveReader) {
+        virMutexLock(&copy.lock);
+        copy.abort = true;
+        virCondBroadcast(&copy.cond);
+        virMutexUnlock(&copy.lock);
+        virThreadJoin(&reader);
+        virCondDestroy(&copy.cond);
+        virMutexDestroy(&copy.lock);
+    }
+
     if (VIR_CLOSE(fd) < 0 &&
         ret == 0) {
         virReportSystemError(errno, _("Unable to close %s"), path);
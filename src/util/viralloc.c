@@ -26,11 +26,113 @@
 #include "viralloc.h"
 #include "virlog.h"
 #include "virerror.h"
+#include "virthread.h"
 
 #define VIR_FROM_THIS VIR_FROM_NONE
 
 VIR_LOG_INIT("util.alloc");
 
+/* Optional allocation accounting, keyed by the VIR_FROM_* code that
+ * every caller already passes down via VIR_FROM_THIS. Off by default;
+ * while enabled each successful allocation takes a global lock, so
+ * this is strictly a diagnostic mode for chasing memory growth on
+ * hosts which cannot be restarted under valgrind */
+static bool virAllocStatsActive;
+static virMutex virAllocStatsLock;
+static unsigned long long virAllocStatsAllocs[VIR_ERR_DOMAIN_LAST];
+static unsigned long long virAllocStatsBytes[VIR_ERR_DOMAIN_LAST];
+
+static int virAllocStatsOnceInit(void)
+{
+    return virMutexInit(&virAllocStatsLock);
+}
+
+VIR_ONCE_GLOBAL_INIT(virAllocStats)
+
+/**
+ * virAllocStatsEnable:
+ *
+ * Zero all counters and start accounting allocations. Only
+ * allocations made between this call and virAllocStatsDisable
+ * are counted.
+ *
+ * Returns 0 on success, -1 on failure
+ */
+int virAllocStatsEnable(void)
+{
+    if (virAllocStatsInitialize() < 0)
+        return -1;
+
+    virMutexLock(&virAllocStatsLock);
+    memset(virAllocStatsAllocs, 0, sizeof(virAllocStatsAllocs));
+    memset(virAllocStatsBytes, 0, sizeof(virAllocStatsBytes));
+    virAllocStatsActive = true;
+    virMutexUnlock(&virAllocStatsLock);
+    return 0;
+}
+
+/**
+ * virAllocStatsDisable:
+ *
+ * Stop accounting allocations. The counters keep their values
+ * and may still be read with virAllocStatsWalk.
+ */
+void virAllocStatsDisable(void)
+{
+    if (virAllocStatsInitialize() < 0)
+        return;
+
+    virMutexLock(&virAllocStatsLock);
+    virAllocStatsActive = false;
+    virMutexUnlock(&virAllocStatsLock);
+}
+
+/**
+ * virAllocStatsWalk:
+ * @iter: callback invoked for each error domain with counted allocations
+ * @opaque: data passed through to @iter
+ *
+ * Report the accounted allocations. The callback runs on a snapshot
+ * of the counters, so it may safely allocate memory itself. Note the
+ * counters are cumulative totals of requested bytes, including
+ * reallocations at their full new size; they do not track frees and
+ * thus are not a measure of live memory.
+ */
+void virAllocStatsWalk(virAllocStatsIterator iter, void *opaque)
+{
+    unsigned long long allocs[VIR_ERR_DOMAIN_LAST];
+    unsigned long long bytes[VIR_ERR_DOMAIN_LAST];
+    size_t i;
+
+    if (virAllocStatsInitialize() < 0)
+        return;
+
+    virMutexLock(&virAllocStatsLock);
+    memcpy(allocs, virAllocStatsAllocs, sizeof(allocs));
+    memcpy(bytes, virAllocStatsBytes, sizeof(bytes));
+    virMutexUnlock(&virAllocStatsLock);
+
+    for (i = 0; i < VIR_ERR_DOMAIN_LAST; i++) {
+        if (allocs[i] == 0)
+            continue;
+        iter(i, allocs[i], bytes[i], opaque);
+    }
+}
+
+static void virAllocStatsAdd(int domcode, size_t bytes)
+{
+    if (domcode < 0 || domcode >= VIR_ERR_DOMAIN_LAST)
+        domcode = VIR_FROM_NONE;
+
+    virMutexLock(&virAllocStatsLock);
+    /* recheck under the lock; a racing disable must win */
+    if (virAllocStatsActive) {
+        virAllocStatsAllocs[domcode]++;
+        virAllocStatsBytes[domcode] += bytes;
+    }
+    virMutexUnlock(&virAllocStatsLock);
+}
+
 #if TEST_OOM
 static int testMallocNext;
 static int testMallocFailFirst;
@@ -147,6 +249,8 @@ int virAlloc(void *ptrptr,
             virReportOOMErrorFull(domcode, filename, funcname, linenr);
         return -1;
     }
+    if (virAllocStatsActive)
+        virAllocStatsAdd(domcode, size);
     return 0;
 }
 
@@ -194,6 +298,8 @@ int virAllocN(void *ptrptr,
             virReportOOMErrorFull(domcode, filename, funcname, linenr);
         return -1;
     }
+    if (virAllocStatsActive)
+        virAllocStatsAdd(domcode, size * count);
     return 0;
 }
 
@@ -249,6 +355,8 @@ int virReallocN(void *ptrptr,
         return -1;
     }
     *(void**)ptrptr = tmp;
+    if (virAllocStatsActive)
+        virAllocStatsAdd(domcode, size * count);
     return 0;
 }
 
@@ -563,6 +671,8 @@ int virAllocVar(void *ptrptr,
             virReportOOMErrorFull(domcode, filename, funcname, linenr);
         return -1;
     }
+    if (virAllocStatsActive)
+        virAllocStatsAdd(domcode, alloc_size);
     return 0;
 }
 
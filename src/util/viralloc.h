@@ -596,4 +596,24 @@ void virAllocTestInit(void);
 int virAllocTestCount(void);
 void virAllocTestOOM(int n, int m);
 void virAllocTestHook(void (*func)(int, void*), void *data);
+
+/**
+ * virAllocStatsIterator:
+ * @domcode: the VIR_FROM_* code the allocations were accounted to
+ * @allocs: number of allocations counted for @domcode
+ * @bytes: total bytes requested by those allocations
+ * @opaque: user data passed to virAllocStatsWalk
+ *
+ * Callback invoked by virAllocStatsWalk for each error domain
+ * with a non-zero allocation count.
+ */
+typedef void (*virAllocStatsIterator)(int domcode,
+                                      unsigned long long allocs,
+                                      unsigned long long bytes,
+                                      void *opaque);
+
+int virAllocStatsEnable(void);
+void virAllocStatsDisable(void);
+void virAllocStatsWalk(virAllocStatsIterator iter, void *opaque);
+
 #endif /* __VIR_MEMORY_H_ */
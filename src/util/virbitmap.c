@@ -34,6 +34,7 @@
 #include "viralloc.h"
 #include "virbuffer.h"
 #include "c-ctype.h"
+#include "count-leading-zeros.h"
 #include "count-one-bits.h"
 #include "virstring.h"
 #include "virerror.h"
@@ -187,7 +188,7 @@ int virBitmapSetBit(virBitmapPtr bitmap, size_t b)
  */
 static int virBitmapExpand(virBitmapPtr map, size_t b)
 {
-    size_t new_len = VIR_DIV_UP(b, VIR_BITMAP_BITS_PER_UNIT);
+    size_t new_len = VIR_DIV_UP(b + 1, VIR_BITMAP_BITS_PER_UNIT);
 
     /* resize the memory if necessary */
     if (map->map_len < new_len) {
@@ -949,7 +950,6 @@ virBitmapNextSetBit(virBitmapPtr bitmap, ssize_t pos)
 ssize_t
 virBitmapLastSetBit(virBitmapPtr bitmap)
 {
-    ssize_t i;
     int unusedBits;
     ssize_t sz;
     unsigned long bits;
@@ -979,12 +979,8 @@ virBitmapLastSetBit(virBitmapPtr bitmap)
     return -1;
 
  found:
-    for (i = VIR_BITMAP_BITS_PER_UNIT - 1; i >= 0; i--) {
-        if (bits & 1UL << i)
-            return i + sz * VIR_BITMAP_BITS_PER_UNIT;
-    }
-
-    return -1;
+    return VIR_BITMAP_BITS_PER_UNIT - 1 - count_leading_zeros_l(bits) +
+        sz * VIR_BITMAP_BITS_PER_UNIT;
 }
 
 /**
@@ -1112,3 +1108,54 @@ virBitmapSubtract(virBitmapPtr a,
     for (i = 0; i < max; i++)
         a->map[i] &= ~b->map[i];
 }
+
+/**
+ * virBitmapIntersect:
+ * @a: bitmap, modified to contain result
+ * @b: bitmap
+ *
+ * Performs intersection of two bitmaps: a = intersect(a, b)
+ */
+void
+virBitmapIntersect(virBitmapPtr a,
+                   virBitmapPtr b)
+{
+    size_t i;
+    size_t max = a->map_len;
+
+    if (max > b->map_len)
+        max = b->map_len;
+
+    for (i = 0; i < max; i++)
+        a->map[i] &= b->map[i];
+
+    /* bits that @b is too short to cover cannot be in the result */
+    for (; i < a->map_len; i++)
+        a->map[i] = 0;
+}
+
+/**
+ * virBitmapUnion:
+ * @a: bitmap, modified to contain result
+ * @b: other bitmap
+ *
+ * Performs union of two bitmaps: a = union(a, b), expanding @a as
+ * necessary to hold all the bits of @b.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+virBitmapUnion(virBitmapPtr a,
+               virBitmapPtr b)
+{
+    size_t i;
+
+    if (a->max_bit < b->max_bit &&
+        virBitmapExpand(a, b->max_bit - 1) < 0)
+        return -1;
+
+    for (i = 0; i < b->map_len; i++)
+        a->map[i] |= b->map[i];
+
+    return 0;
+}
@@ -117,7 +117,7 @@ virBufferGetIndent(const virBuffer *buf, bool dynamic)
 static int
 virBufferGrow(virBufferPtr buf, unsigned int len)
 {
-    int size;
+    unsigned int size;
 
     if (buf->error)
         return -1;
@@ -127,6 +127,11 @@ virBufferGrow(virBufferPtr buf, unsigned int len)
 
     size = buf->use + len + 1000;
 
+    /* grow geometrically so that building a large document out of
+     * many small appends stays linear overall */
+    if (size < buf->size * 2)
+        size = buf->size * 2;
+
     if (VIR_REALLOC_N_QUIET(buf->content, size) < 0) {
         virBufferSetError(buf, errno);
         return -1;
@@ -382,6 +387,24 @@ virBufferVasprintf(virBufferPtr buf, const char *format, va_list argptr)
     if (buf->error)
         return;
 
+    /* short-circuit the two vsnprintf passes for the common cases of
+     * a bare string argument or a format without any conversions */
+    if (STREQ(format, "%s")) {
+        const char *str;
+
+        va_copy(copy, argptr);
+        str = va_arg(copy, const char *);
+        if (str) {
+            virBufferAdd(buf, str, -1);
+            va_end(copy);
+            return;
+        }
+        va_end(copy);
+    } else if (!strchr(format, '%')) {
+        virBufferAdd(buf, format, -1);
+        return;
+    }
+
     virBufferAddLit(buf, ""); /* auto-indent */
 
     if (buf->size == 0 &&
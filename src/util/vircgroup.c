@@ -356,13 +356,10 @@ virCgroupCopyMounts(virCgroupPtr group,
         if (!parent->controllers[i].mountPoint)
             continue;
 
-        if (VIR_STRDUP(group->controllers[i].mountPoint,
-                       parent->controllers[i].mountPoint) < 0)
-            return -1;
-
-        if (VIR_STRDUP(group->controllers[i].linkPoint,
-                       parent->controllers[i].linkPoint) < 0)
-            return -1;
+        /* mount and link points are interned strings, so child groups
+         * can share them with the parent */
+        group->controllers[i].mountPoint = parent->controllers[i].mountPoint;
+        group->controllers[i].linkPoint = parent->controllers[i].linkPoint;
     }
     return 0;
 }
@@ -415,8 +412,8 @@ virCgroupDetectMountsFromFile(virCgroupPtr group,
                     struct stat sb;
                     char *tmp2;
 
-                    if (VIR_STRDUP(group->controllers[i].mountPoint,
-                                   entry.mnt_dir) < 0)
+                    if (!(group->controllers[i].mountPoint =
+                          (char *) virStringIntern(entry.mnt_dir)))
                         goto error;
 
                     tmp2 = strrchr(entry.mnt_dir, '/');
@@ -452,7 +449,11 @@ virCgroupDetectMountsFromFile(virCgroupPtr group,
                                 VIR_WARN("Expecting a symlink at %s for controller %s",
                                          linksrc, typestr);
                             } else {
-                                group->controllers[i].linkPoint = linksrc;
+                                group->controllers[i].linkPoint =
+                                    (char *) virStringIntern(linksrc);
+                                VIR_FREE(linksrc);
+                                if (!group->controllers[i].linkPoint)
+                                    goto error;
                             }
                         }
                     }
@@ -685,7 +686,7 @@ virCgroupDetect(virCgroupPtr group,
                         return -1;
                     }
                 }
-                VIR_FREE(group->controllers[i].mountPoint);
+                group->controllers[i].mountPoint = NULL;
             }
         }
     } else {
@@ -715,8 +716,17 @@ virCgroupDetect(virCgroupPtr group,
         virCgroupCopyPlacement(group, path, parent) < 0)
         return -1;
 
-    /* ... but use /proc/cgroups to fill in the rest */
-    if (virCgroupDetectPlacement(group, pid, path) < 0)
+    /* ... but use /proc/cgroups to fill in the rest, unless the copy
+     * above already covered every remaining controller; reparsing the
+     * proc file for every per-vcpu group adds up quickly when stats
+     * are polled */
+    for (i = 0; i < VIR_CGROUP_CONTROLLER_LAST; i++) {
+        if (group->controllers[i].mountPoint &&
+            !group->controllers[i].placement)
+            break;
+    }
+    if (i < VIR_CGROUP_CONTROLLER_LAST &&
+        virCgroupDetectPlacement(group, pid, path) < 0)
         return -1;
 
     /* Check that for every mounted controller, we found our placement */
@@ -773,6 +783,35 @@ virCgroupGetBlockDevString(const char *path)
 }
 
 
+/* Return a cached FD of the controller's placement directory, opening
+ * it on first use. Returns -1 without reporting an error if the
+ * directory cannot be opened; callers fall back to full-path I/O.
+ */
+static int
+virCgroupDirFdOfController(virCgroupPtr group,
+                           int controller)
+{
+    char *path = NULL;
+
+    if (controller < 0 || controller >= VIR_CGROUP_CONTROLLER_LAST)
+        return -1;
+
+    if (group->controllers[controller].dirfd != -1)
+        return group->controllers[controller].dirfd;
+
+    if (virCgroupPathOfController(group, controller, "", &path) < 0) {
+        virResetLastError();
+        return -1;
+    }
+
+    group->controllers[controller].dirfd = open(path,
+                                                O_RDONLY | O_DIRECTORY);
+    VIR_FREE(path);
+
+    return group->controllers[controller].dirfd;
+}
+
+
 static int
 virCgroupSetValueStr(virCgroupPtr group,
                      int controller,
@@ -782,27 +821,47 @@ virCgroupSetValueStr(virCgroupPtr group,
     int ret = -1;
     char *keypath = NULL;
     char *tmp = NULL;
+    int dirfd;
+    int fd = -1;
 
     if (virCgroupPathOfController(group, controller, key, &keypath) < 0)
         return -1;
 
     VIR_DEBUG("Set value '%s' to '%s'", keypath, value);
-    if (virFileWriteStr(keypath, value, 0) < 0) {
-        if (errno == EINVAL &&
-            (tmp = strrchr(keypath, '/'))) {
-            virReportSystemError(errno,
-                                 _("Invalid value '%s' for '%s'"),
-                                 value, tmp + 1);
-            goto cleanup;
-        }
-        virReportSystemError(errno,
-                             _("Unable to write to '%s'"), keypath);
-        goto cleanup;
+
+    /* Write relative to a cached directory FD where possible; this
+     * spares the kernel one full path walk per parameter, and setting
+     * up a guest writes dozens of parameters into the same handful of
+     * directories */
+    if ((dirfd = virCgroupDirFdOfController(group, controller)) >= 0) {
+        if ((fd = openat(dirfd, key, O_WRONLY | O_TRUNC)) < 0)
+            goto report;
+
+        if (safewrite(fd, value, strlen(value)) < 0)
+            goto report;
+
+        if (VIR_CLOSE(fd) < 0)
+            goto report;
+    } else if (virFileWriteStr(keypath, value, 0) < 0) {
+        goto report;
     }
 
     ret = 0;
+    goto cleanup;
+
+ report:
+    if (errno == EINVAL &&
+        (tmp = strrchr(keypath, '/'))) {
+        virReportSystemError(errno,
+                             _("Invalid value '%s' for '%s'"),
+                             value, tmp + 1);
+    } else {
+        virReportSystemError(errno,
+                             _("Unable to write to '%s'"), keypath);
+    }
 
  cleanup:
+    VIR_FORCE_CLOSE(fd);
     VIR_FREE(keypath);
     return ret;
 }
@@ -1077,7 +1136,7 @@ virCgroupMakeGroup(virCgroupPtr parent,
                  * treat blkio as unmounted if mkdir fails. */
                 if (i == VIR_CGROUP_CONTROLLER_BLKIO) {
                     VIR_DEBUG("Ignoring mkdir failure with blkio controller. Kernel probably too old");
-                    VIR_FREE(group->controllers[i].mountPoint);
+                    group->controllers[i].mountPoint = NULL;
                     VIR_FREE(path);
                     continue;
                 } else {
@@ -1147,6 +1206,8 @@ virCgroupNew(pid_t pid,
              int controllers,
              virCgroupPtr *group)
 {
+    size_t i;
+
     VIR_DEBUG("pid=%lld path=%s parent=%p controllers=%d group=%p",
               (long long) pid, path, parent, controllers, group);
     *group = NULL;
@@ -1154,6 +1215,9 @@ virCgroupNew(pid_t pid,
     if (VIR_ALLOC((*group)) < 0)
         goto error;
 
+    for (i = 0; i < VIR_CGROUP_CONTROLLER_LAST; i++)
+        (*group)->controllers[i].dirfd = -1;
+
     if (path[0] == '/' || !parent) {
         if (VIR_STRDUP((*group)->path, path) < 0)
             goto error;
@@ -1760,9 +1824,9 @@ virCgroupFree(virCgroupPtr *group)
         return;
 
     for (i = 0; i < VIR_CGROUP_CONTROLLER_LAST; i++) {
-        VIR_FREE((*group)->controllers[i].mountPoint);
-        VIR_FREE((*group)->controllers[i].linkPoint);
+        /* mount and link points are interned and thus never freed */
         VIR_FREE((*group)->controllers[i].placement);
+        VIR_FORCE_CLOSE((*group)->controllers[i].dirfd);
     }
 
     VIR_FREE((*group)->path);
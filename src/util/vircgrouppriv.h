@@ -33,6 +33,7 @@
 
 struct virCgroupController {
     int type;
+    /* Interned via virStringIntern; shared between groups, never freed */
     char *mountPoint;
     /* If mountPoint holds several controllers co-mounted,
      * then linkPoint is path of the symlink to the mountPoint
@@ -40,6 +41,10 @@ struct virCgroupController {
      */
     char *linkPoint;
     char *placement;
+    /* Cached FD of the placement directory, opened on first parameter
+     * write so that subsequent writes go through openat() instead of
+     * a full path walk; -1 while unopened */
+    int dirfd;
 };
 
 struct virCgroup {
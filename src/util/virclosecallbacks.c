@@ -28,6 +28,7 @@
 #include "virclosecallbacks.h"
 #include "virlog.h"
 #include "virobject.h"
+#include "virthread.h"
 
 #define VIR_FROM_THIS VIR_FROM_NONE
 
@@ -313,6 +314,60 @@ virCloseCallbacksGetForConn(virCloseCallbacksPtr closeCallbacks,
 }
 
 
+static void
+virCloseCallbacksRunOne(virCloseCallbacksListEntryPtr entry,
+                        virConnectPtr conn,
+                        virDomainObjListPtr domains,
+                        void *opaque)
+{
+    virDomainObjPtr vm;
+
+    if (!(vm = virDomainObjListFindByUUID(domains, entry->uuid))) {
+        char uuidstr[VIR_UUID_STRING_BUFLEN];
+        virUUIDFormat(entry->uuid, uuidstr);
+        VIR_DEBUG("No domain object with UUID %s", uuidstr);
+        return;
+    }
+
+    vm = entry->callback(vm, conn, opaque);
+    if (vm)
+        virObjectUnlock(vm);
+}
+
+struct virCloseCallbacksRunData {
+    virCloseCallbacksListPtr list;
+    virConnectPtr conn;
+    virDomainObjListPtr domains;
+    void *opaque;
+
+    virMutex lock; /* protects @next */
+    size_t next;
+};
+
+static void
+virCloseCallbacksRunWorker(void *opaque)
+{
+    struct virCloseCallbacksRunData *data = opaque;
+
+    for (;;) {
+        size_t i;
+
+        virMutexLock(&data->lock);
+        if (data->next >= data->list->nentries) {
+            virMutexUnlock(&data->lock);
+            return;
+        }
+        i = data->next++;
+        virMutexUnlock(&data->lock);
+
+        virCloseCallbacksRunOne(&data->list->entries[i],
+                                data->conn, data->domains, data->opaque);
+    }
+}
+
+/* Upper bound on extra threads running close callbacks concurrently */
+#define VIR_CLOSE_CALLBACKS_MAX_HELPERS 4
+
 void
 virCloseCallbacksRun(virCloseCallbacksPtr closeCallbacks,
                      virConnectPtr conn,
@@ -320,6 +375,7 @@ virCloseCallbacksRun(virCloseCallbacksPtr closeCallbacks,
                      void *opaque)
 {
     virCloseCallbacksListPtr list;
+    struct virCloseCallbacksRunData data;
     size_t i;
 
     VIR_DEBUG("conn=%p", conn);
@@ -331,8 +387,10 @@ virCloseCallbacksRun(virCloseCallbacksPtr closeCallbacks,
 
     virObjectLock(closeCallbacks);
     list = virCloseCallbacksGetForConn(closeCallbacks, conn);
-    if (!list)
+    if (!list) {
+        virObjectUnlock(closeCallbacks);
         return;
+    }
 
     for (i = 0; i < list->nentries; i++) {
         char uuidstr[VIR_UUID_STRING_BUFLEN];
@@ -341,21 +399,41 @@ virCloseCallbacksRun(virCloseCallbacksPtr closeCallbacks,
     }
     virObjectUnlock(closeCallbacks);
 
-    for (i = 0; i < list->nentries; i++) {
-        virDomainObjPtr vm;
-
-        if (!(vm = virDomainObjListFindByUUID(domains,
-                                              list->entries[i].uuid))) {
-            char uuidstr[VIR_UUID_STRING_BUFLEN];
-            virUUIDFormat(list->entries[i].uuid, uuidstr);
-            VIR_DEBUG("No domain object with UUID %s", uuidstr);
-            continue;
+    if (list->nentries > 1 && virMutexInit(&data.lock) == 0) {
+        /* The callbacks cover distinct domains and can be heavy
+         * (auto-destroy stops the guest), so share them between a
+         * few threads rather than letting a mass disconnect pay for
+         * every domain serially. A failed thread spawn just leaves
+         * more of the work for this thread */
+        virThread helpers[VIR_CLOSE_CALLBACKS_MAX_HELPERS];
+        size_t nhelpers = list->nentries - 1;
+        size_t spawned;
+
+        if (nhelpers > VIR_CLOSE_CALLBACKS_MAX_HELPERS)
+            nhelpers = VIR_CLOSE_CALLBACKS_MAX_HELPERS;
+
+        data.list = list;
+        data.conn = conn;
+        data.domains = domains;
+        data.opaque = opaque;
+        data.next = 0;
+
+        for (spawned = 0; spawned < nhelpers; spawned++) {
+            if (virThreadCreate(&helpers[spawned], true,
+                                virCloseCallbacksRunWorker, &data) < 0)
+                break;
         }
 
-        vm = list->entries[i].callback(vm, conn, opaque);
-        if (vm)
-            virObjectUnlock(vm);
+        virCloseCallbacksRunWorker(&data);
+
+        for (i = 0; i < spawned; i++)
+            virThreadJoin(&helpers[i]);
+        virMutexDestroy(&data.lock);
+    } else {
+        for (i = 0; i < list->nentries; i++)
+            virCloseCallbacksRunOne(&list->entries[i], conn, domains, opaque);
     }
+
     VIR_FREE(list->entries);
     VIR_FREE(list);
 }
@@ -42,6 +42,7 @@
 #include "virutil.h"
 #include "vircommand.h"
 #include "viralloc.h"
+#include "virbuffer.h"
 #include "virerror.h"
 #include "virlog.h"
 #include "virfile.h"
@@ -54,6 +55,75 @@ VIR_LOG_INIT("util.dnsmasq");
 #define DNSMASQ_HOSTSFILE_SUFFIX "hostsfile"
 #define DNSMASQ_ADDNHOSTSFILE_SUFFIX "addnhosts"
 
+/* upper limit when re-reading one of our own files for comparison */
+#define DNSMASQ_FILE_LEN_MAX (32 * 1024 * 1024)
+
+/*
+ * Write @content to @path. If the file already has exactly that
+ * content, the write is skipped, so that no-op updates keep the
+ * file untouched and callers can avoid telling dnsmasq to re-read
+ * its files for nothing.
+ *
+ * Returns 1 if the file was (re-)written, 0 if it was already up to
+ * date, a negative errno value on failure.
+ */
+static int
+dnsmasqFileWrite(const char *path,
+                 const char *content)
+{
+    char *old = NULL;
+    char *tmp = NULL;
+    FILE *f;
+    bool istmp = true;
+    int rc = 0;
+
+    if (virFileReadAllQuiet(path, DNSMASQ_FILE_LEN_MAX, &old) >= 0 &&
+        STREQ(old, content)) {
+        VIR_FREE(old);
+        return 0;
+    }
+    VIR_FREE(old);
+
+    if (virAsprintf(&tmp, "%s.new", path) < 0)
+        return -ENOMEM;
+
+    if (!(f = fopen(tmp, "w"))) {
+        istmp = false;
+        if (!(f = fopen(path, "w"))) {
+            rc = -errno;
+            goto cleanup;
+        }
+    }
+
+    if (fputs(content, f) == EOF) {
+        rc = -errno;
+        VIR_FORCE_FCLOSE(f);
+
+        if (istmp)
+            unlink(tmp);
+
+        goto cleanup;
+    }
+
+    if (VIR_FCLOSE(f) == EOF) {
+        rc = -errno;
+        goto cleanup;
+    }
+
+    if (istmp && rename(tmp, path) < 0) {
+        rc = -errno;
+        unlink(tmp);
+        goto cleanup;
+    }
+
+    rc = 1;
+
+ cleanup:
+    VIR_FREE(tmp);
+
+    return rc;
+}
+
 static void
 dhcphostFree(dnsmasqDhcpHost *host)
 {
@@ -178,74 +248,37 @@ addnhostsWrite(const char *path,
                dnsmasqAddnHost *hosts,
                unsigned int nhosts)
 {
-    char *tmp;
-    FILE *f;
-    bool istmp = true;
+    virBuffer buf = VIR_BUFFER_INITIALIZER;
+    char *content;
     size_t i, j;
-    int rc = 0;
+    int rc;
 
     /* even if there are 0 hosts, create a 0 length file, to allow
      * for runtime addition.
      */
 
-    if (virAsprintf(&tmp, "%s.new", path) < 0)
-        return -ENOMEM;
-
-    if (!(f = fopen(tmp, "w"))) {
-        istmp = false;
-        if (!(f = fopen(path, "w"))) {
-            rc = -errno;
-            goto cleanup;
-        }
-    }
-
     for (i = 0; i < nhosts; i++) {
-        if (fputs(hosts[i].ip, f) == EOF || fputc('\t', f) == EOF) {
-            rc = -errno;
-            VIR_FORCE_FCLOSE(f);
-
-            if (istmp)
-                unlink(tmp);
-
-            goto cleanup;
-        }
+        virBufferAdd(&buf, hosts[i].ip, -1);
+        virBufferAddChar(&buf, '\t');
 
         for (j = 0; j < hosts[i].nhostnames; j++) {
-            if (fputs(hosts[i].hostnames[j], f) == EOF || fputc('\t', f) == EOF) {
-                rc = -errno;
-                VIR_FORCE_FCLOSE(f);
-
-                if (istmp)
-                    unlink(tmp);
-
-                goto cleanup;
-            }
+            virBufferAdd(&buf, hosts[i].hostnames[j], -1);
+            virBufferAddChar(&buf, '\t');
         }
 
-        if (fputc('\n', f) == EOF) {
-            rc = -errno;
-            VIR_FORCE_FCLOSE(f);
-
-            if (istmp)
-                unlink(tmp);
-
-            goto cleanup;
-        }
+        virBufferAddChar(&buf, '\n');
     }
 
-    if (VIR_FCLOSE(f) == EOF) {
-        rc = -errno;
-        goto cleanup;
+    if (virBufferError(&buf)) {
+        virBufferFreeAndReset(&buf);
+        return -ENOMEM;
     }
 
-    if (istmp && rename(tmp, path) < 0) {
-        rc = -errno;
-        unlink(tmp);
-        goto cleanup;
-    }
+    content = virBufferContentAndReset(&buf);
 
- cleanup:
-    VIR_FREE(tmp);
+    rc = dnsmasqFileWrite(path, content ? content : "");
+
+    VIR_FREE(content);
 
     return rc;
 }
@@ -262,7 +295,7 @@ addnhostsSave(dnsmasqAddnHostsfile *addnhostsfile)
         return -1;
     }
 
-    return 0;
+    return err;
 }
 
 static int
@@ -391,52 +424,30 @@ hostsfileWrite(const char *path,
                dnsmasqDhcpHost *hosts,
                unsigned int nhosts)
 {
-    char *tmp;
-    FILE *f;
-    bool istmp = true;
+    virBuffer buf = VIR_BUFFER_INITIALIZER;
+    char *content;
     size_t i;
-    int rc = 0;
+    int rc;
 
     /* even if there are 0 hosts, create a 0 length file, to allow
      * for runtime addition.
      */
 
-    if (virAsprintf(&tmp, "%s.new", path) < 0)
-        return -ENOMEM;
-
-    if (!(f = fopen(tmp, "w"))) {
-        istmp = false;
-        if (!(f = fopen(path, "w"))) {
-            rc = -errno;
-            goto cleanup;
-        }
-    }
-
     for (i = 0; i < nhosts; i++) {
-        if (fputs(hosts[i].host, f) == EOF || fputc('\n', f) == EOF) {
-            rc = -errno;
-            VIR_FORCE_FCLOSE(f);
-
-            if (istmp)
-                unlink(tmp);
-
-            goto cleanup;
-        }
+        virBufferAdd(&buf, hosts[i].host, -1);
+        virBufferAddChar(&buf, '\n');
     }
 
-    if (VIR_FCLOSE(f) == EOF) {
-        rc = -errno;
-        goto cleanup;
+    if (virBufferError(&buf)) {
+        virBufferFreeAndReset(&buf);
+        return -ENOMEM;
     }
 
-    if (istmp && rename(tmp, path) < 0) {
-        rc = -errno;
-        unlink(tmp);
-        goto cleanup;
-    }
+    content = virBufferContentAndReset(&buf);
 
- cleanup:
-    VIR_FREE(tmp);
+    rc = dnsmasqFileWrite(path, content ? content : "");
+
+    VIR_FREE(content);
 
     return rc;
 }
@@ -453,7 +464,7 @@ hostsfileSave(dnsmasqHostsfile *hostsfile)
         return -1;
     }
 
-    return 0;
+    return err;
 }
 
 /**
@@ -551,11 +562,17 @@ dnsmasqAddHost(dnsmasqContext *ctx,
  * @ctx: pointer to the dnsmasq context for each network
  *
  * Saves all the configurations associated with a context to disk.
+ * Files whose content has not changed since the last save are left
+ * untouched.
+ *
+ * Returns a positive value if any file was rewritten, 0 if all files
+ * were already up to date, -1 on error.
  */
 int
 dnsmasqSave(const dnsmasqContext *ctx)
 {
-    int ret = 0;
+    int changed = 0;
+    int rc;
 
     if (virFileMakePath(ctx->config_dir) < 0) {
         virReportSystemError(errno, _("cannot create config directory '%s'"),
@@ -563,14 +580,18 @@ dnsmasqSave(const dnsmasqContext *ctx)
         return -1;
     }
 
-    if (ctx->hostsfile)
-        ret = hostsfileSave(ctx->hostsfile);
-    if (ret == 0) {
-        if (ctx->addnhostsfile)
-            ret = addnhostsSave(ctx->addnhostsfile);
+    if (ctx->hostsfile) {
+        if ((rc = hostsfileSave(ctx->hostsfile)) < 0)
+            return -1;
+        changed |= rc;
+    }
+    if (ctx->addnhostsfile) {
+        if ((rc = addnhostsSave(ctx->addnhostsfile)) < 0)
+            return -1;
+        changed |= rc;
     }
 
-    return ret;
+    return changed;
 }
 
 
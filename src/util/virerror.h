@@ -23,6 +23,9 @@
 # define __VIRT_ERROR_H_
 
 # include "internal.h"
+# include "virutil.h"
+
+VIR_ENUM_DECL(virErrorDomain)
 
 extern virErrorFunc virErrorHandler;
 extern void *virUserData;
@@ -25,6 +25,7 @@
 
 #include "virevent.h"
 #include "vireventpoll.h"
+#include "vireventepoll.h"
 #include "virlog.h"
 #include "virerror.h"
 
@@ -245,10 +246,10 @@ void virEventRegisterImpl(virEventAddHandleFunc addHandle,
  * virEventRegisterDefaultImpl:
  *
  * Registers a default event implementation based on the
- * poll() system call. This is a generic implementation
- * that can be used by any client application which does
- * not have a need to integrate with an external event
- * loop impl.
+ * epoll() system call where supported, falling back to a
+ * generic poll() based implementation elsewhere. This can
+ * be used by any client application which does not have a
+ * need to integrate with an external event loop impl.
  *
  * For proper event handling, it is important that the event implementation
  * is registered before a connection to the Hypervisor is opened.
@@ -268,18 +269,18 @@ int virEventRegisterDefaultImpl(void)
 
     virResetLastError();
 
-    if (virEventPollInit() < 0) {
+    if (virEventEpollInit() < 0) {
         virDispatchError(NULL);
         return -1;
     }
 
     virEventRegisterImpl(
-        virEventPollAddHandle,
-        virEventPollUpdateHandle,
-        virEventPollRemoveHandle,
-        virEventPollAddTimeout,
-        virEventPollUpdateTimeout,
-        virEventPollRemoveTimeout
+        virEventEpollAddHandle,
+        virEventEpollUpdateHandle,
+        virEventEpollRemoveHandle,
+        virEventEpollAddTimeout,
+        virEventEpollUpdateTimeout,
+        virEventEpollRemoveTimeout
         );
 
     return 0;
@@ -311,7 +312,7 @@ int virEventRunDefaultImpl(void)
     VIR_DEBUG("running default event implementation");
     virResetLastError();
 
-    if (virEventPollRunOnce() < 0) {
+    if (virEventEpollRunOnce() < 0) {
         virDispatchError(NULL);
         return -1;
     }
@@ -0,0 +1,1086 @@
+/*
+ * vireventepoll.c: epoll() based event loop for monitoring file handles
+ *
+ * Copyright (C) 2016 Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#if WITH_EPOLL
+# include <sys/epoll.h>
+#endif
+
+#include "virthread.h"
+#include "virlog.h"
+#include "vireventepoll.h"
+#include "vireventpoll.h"
+#include "viralloc.h"
+#include "virutil.h"
+#include "virfile.h"
+#include "virerror.h"
+#include "virprobe.h"
+#include "virtime.h"
+
+#define EVENT_DEBUG(fmt, ...) VIR_DEBUG(fmt, __VA_ARGS__)
+
+#define VIR_FROM_THIS VIR_FROM_EVENT
+
+VIR_LOG_INIT("util.eventepoll");
+
+#if WITH_EPOLL
+
+/* State for a single file handle being monitored.
+ * Records are individually heap allocated so that the kernel
+ * can hand us back a direct pointer via epoll_event.data.ptr,
+ * avoiding any per-wakeup scan of registered handles. */
+struct virEventEpollHandle {
+    int watch;
+    int fd;
+    int events;
+    virEventHandleCallback cb;
+    virFreeCallback ff;
+    void *opaque;
+    int deleted;
+};
+
+/* State for a single timer being generated */
+struct virEventEpollTimeout {
+    int timer;
+    int frequency;
+    unsigned long long expiresAt;
+    virEventTimeoutCallback cb;
+    virFreeCallback ff;
+    void *opaque;
+    int deleted;
+};
+
+/* Allocate extra slots for virEventEpollTimeout
+   records in this multiple */
+# define EVENT_ALLOC_EXTENT 10
+
+/* Largest number of ready file handles fetched per epoll_wait().
+ * A burst larger than this simply takes further loop iterations */
+# define EVENT_EPOLL_MAX_EVENTS 64
+
+/* State for one event loop. The default loop used by
+ * virEventRegisterDefaultImpl() is a static instance; further
+ * instances can be created via virEventEpollLoopNew() to spread
+ * file handle monitoring over multiple threads. */
+struct _virEventEpollLoop {
+    virMutex lock;
+    int running;
+    virThread leader;
+    int epollfd;
+    int wakeupfd[2];
+    int nextWatch;
+    int nextTimer;
+    size_t handlesCount;
+    size_t handlesAlloc;
+    struct virEventEpollHandle **handles;
+    size_t timeoutsCount;
+    size_t timeoutsAlloc;
+    struct virEventEpollTimeout *timeouts;
+};
+
+/* The default event loop */
+static virEventEpollLoop eventLoop;
+
+static int virEventEpollInterruptLocked(virEventEpollLoopPtr loop);
+
+
+static uint32_t
+virEventEpollToNativeEvents(int events)
+{
+    uint32_t ret = 0;
+    if (events & VIR_EVENT_HANDLE_READABLE)
+        ret |= EPOLLIN;
+    if (events & VIR_EVENT_HANDLE_WRITABLE)
+        ret |= EPOLLOUT;
+    if (events & VIR_EVENT_HANDLE_ERROR)
+        ret |= EPOLLERR;
+    if (events & VIR_EVENT_HANDLE_HANGUP)
+        ret |= EPOLLHUP;
+    return ret;
+}
+
+static int
+virEventEpollFromNativeEvents(uint32_t events)
+{
+    int ret = 0;
+    if (events & EPOLLIN)
+        ret |= VIR_EVENT_HANDLE_READABLE;
+    if (events & EPOLLOUT)
+        ret |= VIR_EVENT_HANDLE_WRITABLE;
+    if (events & EPOLLERR)
+        ret |= VIR_EVENT_HANDLE_ERROR;
+    if (events & EPOLLHUP)
+        ret |= VIR_EVENT_HANDLE_HANGUP;
+    return ret;
+}
+
+
+/*
+ * Register a callback for monitoring file handle events.
+ * NB, it *must* be safe to call this from within a callback
+ * For this reason we only ever append to existing list.
+ */
+int virEventEpollLoopAddHandle(virEventEpollLoopPtr loop,
+                               int fd, int events,
+                               virEventHandleCallback cb,
+                               void *opaque,
+                               virFreeCallback ff)
+{
+    struct virEventEpollHandle *handle;
+    struct epoll_event ev;
+    int watch;
+
+    if (VIR_ALLOC(handle) < 0)
+        return -1;
+
+    virMutexLock(&loop->lock);
+    if (loop->handlesCount == loop->handlesAlloc) {
+        EVENT_DEBUG("Used %zu handle slots, adding at least %d more",
+                    loop->handlesAlloc, EVENT_ALLOC_EXTENT);
+        if (VIR_RESIZE_N(loop->handles, loop->handlesAlloc,
+                         loop->handlesCount, EVENT_ALLOC_EXTENT) < 0) {
+            virMutexUnlock(&loop->lock);
+            VIR_FREE(handle);
+            return -1;
+        }
+    }
+
+    watch = loop->nextWatch++;
+
+    handle->watch = watch;
+    handle->fd = fd;
+    handle->events = events;
+    handle->cb = cb;
+    handle->ff = ff;
+    handle->opaque = opaque;
+    handle->deleted = 0;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = virEventEpollToNativeEvents(events);
+    ev.data.ptr = handle;
+    if (epoll_ctl(loop->epollfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        virReportSystemError(errno,
+                             _("Unable to add handle %d to epoll"), fd);
+        virMutexUnlock(&loop->lock);
+        VIR_FREE(handle);
+        return -1;
+    }
+
+    loop->handles[loop->handlesCount++] = handle;
+
+    virEventEpollInterruptLocked(loop);
+
+    PROBE(EVENT_POLL_ADD_HANDLE,
+          "watch=%d fd=%d events=%d cb=%p opaque=%p ff=%p",
+          watch, fd, events, cb, opaque, ff);
+    virMutexUnlock(&loop->lock);
+
+    return watch;
+}
+
+void virEventEpollLoopUpdateHandle(virEventEpollLoopPtr loop,
+                                   int watch, int events)
+{
+    size_t i;
+    bool found = false;
+    PROBE(EVENT_POLL_UPDATE_HANDLE,
+          "watch=%d events=%d",
+          watch, events);
+
+    if (watch <= 0) {
+        VIR_WARN("Ignoring invalid update watch %d", watch);
+        return;
+    }
+
+    virMutexLock(&loop->lock);
+    for (i = 0; i < loop->handlesCount; i++) {
+        struct virEventEpollHandle *handle = loop->handles[i];
+        if (handle->watch == watch && !handle->deleted) {
+            struct epoll_event ev;
+            memset(&ev, 0, sizeof(ev));
+            ev.events = virEventEpollToNativeEvents(events);
+            ev.data.ptr = handle;
+            if (epoll_ctl(loop->epollfd, EPOLL_CTL_MOD,
+                          handle->fd, &ev) < 0)
+                VIR_WARN("Unable to update epoll for watch %d fd %d: %d",
+                         watch, handle->fd, errno);
+            else
+                handle->events = events;
+            found = true;
+            break;
+        }
+    }
+    virMutexUnlock(&loop->lock);
+
+    if (!found)
+        VIR_WARN("Got update for non-existent handle watch %d", watch);
+}
+
+/*
+ * Unregister a callback from a file handle
+ * NB, it *must* be safe to call this from within a callback
+ * For this reason we only ever set a flag in the existing list.
+ * Actual deletion will be done out-of-band
+ */
+int virEventEpollLoopRemoveHandle(virEventEpollLoopPtr loop, int watch)
+{
+    size_t i;
+    PROBE(EVENT_POLL_REMOVE_HANDLE,
+          "watch=%d",
+          watch);
+
+    if (watch <= 0) {
+        VIR_WARN("Ignoring invalid remove watch %d", watch);
+        return -1;
+    }
+
+    virMutexLock(&loop->lock);
+    for (i = 0; i < loop->handlesCount; i++) {
+        struct virEventEpollHandle *handle = loop->handles[i];
+        if (handle->deleted)
+            continue;
+
+        if (handle->watch == watch) {
+            EVENT_DEBUG("mark delete %zu %d", i, handle->fd);
+            /* Detach from the kernel right away so a pending event on
+             * the fd cannot be reported once the caller returns; the
+             * record itself is freed out-of-band to stay re-entrant safe */
+            if (epoll_ctl(loop->epollfd, EPOLL_CTL_DEL,
+                          handle->fd, NULL) < 0)
+                VIR_DEBUG("Unable to detach fd %d from epoll: %d",
+                          handle->fd, errno);
+            handle->deleted = 1;
+            virEventEpollInterruptLocked(loop);
+            virMutexUnlock(&loop->lock);
+            return 0;
+        }
+    }
+    virMutexUnlock(&loop->lock);
+    return -1;
+}
+
+
+/*
+ * Register a callback for a timer event
+ * NB, it *must* be safe to call this from within a callback
+ * For this reason we only ever append to existing list.
+ */
+static int virEventEpollLoopAddTimeout(virEventEpollLoopPtr loop,
+                                       int frequency,
+                                       virEventTimeoutCallback cb,
+                                       void *opaque,
+                                       virFreeCallback ff)
+{
+    unsigned long long now;
+    int ret;
+
+    if (virTimeMillisNow(&now) < 0)
+        return -1;
+
+    virMutexLock(&loop->lock);
+    if (loop->timeoutsCount == loop->timeoutsAlloc) {
+        EVENT_DEBUG("Used %zu timeout slots, adding at least %d more",
+                    loop->timeoutsAlloc, EVENT_ALLOC_EXTENT);
+        if (VIR_RESIZE_N(loop->timeouts, loop->timeoutsAlloc,
+                         loop->timeoutsCount, EVENT_ALLOC_EXTENT) < 0) {
+            virMutexUnlock(&loop->lock);
+            return -1;
+        }
+    }
+
+    loop->timeouts[loop->timeoutsCount].timer = loop->nextTimer++;
+    loop->timeouts[loop->timeoutsCount].frequency = frequency;
+    loop->timeouts[loop->timeoutsCount].cb = cb;
+    loop->timeouts[loop->timeoutsCount].ff = ff;
+    loop->timeouts[loop->timeoutsCount].opaque = opaque;
+    loop->timeouts[loop->timeoutsCount].deleted = 0;
+    loop->timeouts[loop->timeoutsCount].expiresAt =
+        frequency >= 0 ? frequency + now : 0;
+
+    loop->timeoutsCount++;
+    ret = loop->nextTimer-1;
+    virEventEpollInterruptLocked(loop);
+
+    PROBE(EVENT_POLL_ADD_TIMEOUT,
+          "timer=%d frequency=%d cb=%p opaque=%p ff=%p",
+          ret, frequency, cb, opaque, ff);
+    virMutexUnlock(&loop->lock);
+    return ret;
+}
+
+static void virEventEpollLoopUpdateTimeout(virEventEpollLoopPtr loop,
+                                           int timer, int frequency)
+{
+    unsigned long long now;
+    size_t i;
+    bool found = false;
+    PROBE(EVENT_POLL_UPDATE_TIMEOUT,
+          "timer=%d frequency=%d",
+          timer, frequency);
+
+    if (timer <= 0) {
+        VIR_WARN("Ignoring invalid update timer %d", timer);
+        return;
+    }
+
+    if (virTimeMillisNow(&now) < 0)
+        return;
+
+    virMutexLock(&loop->lock);
+    for (i = 0; i < loop->timeoutsCount; i++) {
+        if (loop->timeouts[i].timer == timer) {
+            loop->timeouts[i].frequency = frequency;
+            loop->timeouts[i].expiresAt =
+                frequency >= 0 ? frequency + now : 0;
+            VIR_DEBUG("Set timer freq=%d expires=%llu", frequency,
+                      loop->timeouts[i].expiresAt);
+            virEventEpollInterruptLocked(loop);
+            found = true;
+            break;
+        }
+    }
+    virMutexUnlock(&loop->lock);
+
+    if (!found)
+        VIR_WARN("Got update for non-existent timer %d", timer);
+}
+
+/*
+ * Unregister a callback for a timer
+ * NB, it *must* be safe to call this from within a callback
+ * For this reason we only ever set a flag in the existing list.
+ * Actual deletion will be done out-of-band
+ */
+static int virEventEpollLoopRemoveTimeout(virEventEpollLoopPtr loop,
+                                          int timer)
+{
+    size_t i;
+    PROBE(EVENT_POLL_REMOVE_TIMEOUT,
+          "timer=%d",
+          timer);
+
+    if (timer <= 0) {
+        VIR_WARN("Ignoring invalid remove timer %d", timer);
+        return -1;
+    }
+
+    virMutexLock(&loop->lock);
+    for (i = 0; i < loop->timeoutsCount; i++) {
+        if (loop->timeouts[i].deleted)
+            continue;
+
+        if (loop->timeouts[i].timer == timer) {
+            loop->timeouts[i].deleted = 1;
+            virEventEpollInterruptLocked(loop);
+            virMutexUnlock(&loop->lock);
+            return 0;
+        }
+    }
+    virMutexUnlock(&loop->lock);
+    return -1;
+}
+
+/* Iterates over all registered timeouts and determine which
+ * will be the first to expire.
+ * @timeout: filled with expiry time of soonest timer, or -1 if
+ *           no timeout is pending
+ * returns: 0 on success, -1 on error
+ */
+static int virEventEpollCalculateTimeout(virEventEpollLoopPtr loop,
+                                         int *timeout)
+{
+    unsigned long long then = 0;
+    size_t i;
+    EVENT_DEBUG("Calculate expiry of %zu timers", loop->timeoutsCount);
+    for (i = 0; i < loop->timeoutsCount; i++) {
+        if (loop->timeouts[i].deleted)
+            continue;
+        if (loop->timeouts[i].frequency < 0)
+            continue;
+
+        if (then == 0 ||
+            loop->timeouts[i].expiresAt < then)
+            then = loop->timeouts[i].expiresAt;
+    }
+
+    if (then > 0) {
+        unsigned long long now;
+
+        if (virTimeMillisNow(&now) < 0)
+            return -1;
+
+        EVENT_DEBUG("Schedule timeout then=%llu now=%llu", then, now);
+        if (then <= now)
+            *timeout = 0;
+        else
+            *timeout = ((then - now) > INT_MAX) ? INT_MAX : (then - now);
+    } else {
+        *timeout = -1;
+    }
+
+    if (*timeout > -1)
+        EVENT_DEBUG("Timeout at %llu due in %d ms", then, *timeout);
+    else
+        EVENT_DEBUG("%s", "No timeout is pending");
+
+    return 0;
+}
+
+
+/*
+ * Iterate over all timers and determine if any have expired.
+ * Invoke the user supplied callback for each timer whose
+ * expiry time is met, and schedule the next timeout. Does
+ * not try to 'catch up' on time if the actual expiry time
+ * was later than the requested time.
+ *
+ * This method must cope with new timers being registered
+ * by a callback, and must skip any timers marked as deleted.
+ *
+ * Returns 0 upon success, -1 if an error occurred
+ */
+static int virEventEpollDispatchTimeouts(virEventEpollLoopPtr loop)
+{
+    unsigned long long now;
+    size_t i;
+    /* Save this now - it may be changed during dispatch */
+    int ntimeouts = loop->timeoutsCount;
+    VIR_DEBUG("Dispatch %d", ntimeouts);
+
+    if (virTimeMillisNow(&now) < 0)
+        return -1;
+
+    for (i = 0; i < ntimeouts; i++) {
+        if (loop->timeouts[i].deleted || loop->timeouts[i].frequency < 0)
+            continue;
+
+        /* Add 20ms fuzz so we don't pointlessly spin doing
+         * <10ms sleeps, particularly on kernels with low HZ
+         * it is fine that a timer expires 20ms earlier than
+         * requested
+         */
+        if (loop->timeouts[i].expiresAt <= (now+20)) {
+            virEventTimeoutCallback cb = loop->timeouts[i].cb;
+            int timer = loop->timeouts[i].timer;
+            void *opaque = loop->timeouts[i].opaque;
+            loop->timeouts[i].expiresAt =
+                now + loop->timeouts[i].frequency;
+
+            PROBE(EVENT_POLL_DISPATCH_TIMEOUT,
+                  "timer=%d",
+                  timer);
+            virMutexUnlock(&loop->lock);
+            (cb)(timer, opaque);
+            virMutexLock(&loop->lock);
+        }
+    }
+    return 0;
+}
+
+
+/* Iterate over the handles the kernel reported ready and
+ * invoke the user supplied callback for each.
+ *
+ * This method must cope with new handles being registered
+ * by a callback, and must skip any handles marked as deleted.
+ *
+ * Returns 0 upon success, -1 if an error occurred
+ */
+static int virEventEpollDispatchHandles(virEventEpollLoopPtr loop,
+                                        int nfds,
+                                        struct epoll_event *events)
+{
+    size_t n;
+    VIR_DEBUG("Dispatch %d", nfds);
+
+    for (n = 0; n < nfds; n++) {
+        struct virEventEpollHandle *handle = events[n].data.ptr;
+
+        /* A callback invoked earlier in this batch may have marked
+         * the handle deleted; the record is only freed post-dispatch
+         * so the pointer is still safe to examine */
+        if (handle->deleted) {
+            EVENT_DEBUG("Skip deleted w=%d f=%d",
+                        handle->watch, handle->fd);
+            continue;
+        }
+
+        if (events[n].events) {
+            virEventHandleCallback cb = handle->cb;
+            int watch = handle->watch;
+            int fd = handle->fd;
+            void *opaque = handle->opaque;
+            int hEvents = virEventEpollFromNativeEvents(events[n].events);
+            PROBE(EVENT_POLL_DISPATCH_HANDLE,
+                  "watch=%d events=%d",
+                  watch, hEvents);
+            virMutexUnlock(&loop->lock);
+            (cb)(watch, fd, hEvents, opaque);
+            virMutexLock(&loop->lock);
+        }
+    }
+
+    return 0;
+}
+
+
+/* Used post dispatch to actually remove any timers that
+ * were previously marked as deleted. This asynchronous
+ * cleanup is needed to make dispatch re-entrant safe.
+ */
+static void virEventEpollCleanupTimeouts(virEventEpollLoopPtr loop)
+{
+    size_t i;
+    size_t gap;
+    VIR_DEBUG("Cleanup %zu", loop->timeoutsCount);
+
+    for (i = 0; i < loop->timeoutsCount;) {
+        if (!loop->timeouts[i].deleted) {
+            i++;
+            continue;
+        }
+
+        PROBE(EVENT_POLL_PURGE_TIMEOUT,
+              "timer=%d",
+              loop->timeouts[i].timer);
+        if (loop->timeouts[i].ff) {
+            virFreeCallback ff = loop->timeouts[i].ff;
+            void *opaque = loop->timeouts[i].opaque;
+            virMutexUnlock(&loop->lock);
+            ff(opaque);
+            virMutexLock(&loop->lock);
+        }
+
+        if ((i+1) < loop->timeoutsCount) {
+            memmove(loop->timeouts+i,
+                    loop->timeouts+i+1,
+                    sizeof(struct virEventEpollTimeout)*(loop->timeoutsCount
+                                                     -(i+1)));
+        }
+        loop->timeoutsCount--;
+    }
+
+    /* Release some memory if we've got a big chunk free */
+    gap = loop->timeoutsAlloc - loop->timeoutsCount;
+    if (loop->timeoutsCount == 0 ||
+        (gap > loop->timeoutsCount && gap > EVENT_ALLOC_EXTENT)) {
+        EVENT_DEBUG("Found %zu out of %zu timeout slots used, releasing %zu",
+                    loop->timeoutsCount, loop->timeoutsAlloc, gap);
+        VIR_SHRINK_N(loop->timeouts, loop->timeoutsAlloc, gap);
+    }
+}
+
+/* Used post dispatch to actually remove any handles that
+ * were previously marked as deleted. This asynchronous
+ * cleanup is needed to make dispatch re-entrant safe.
+ */
+static void virEventEpollCleanupHandles(virEventEpollLoopPtr loop)
+{
+    size_t i;
+    size_t gap;
+    VIR_DEBUG("Cleanup %zu", loop->handlesCount);
+
+    for (i = 0; i < loop->handlesCount;) {
+        struct virEventEpollHandle *handle = loop->handles[i];
+        if (!handle->deleted) {
+            i++;
+            continue;
+        }
+
+        PROBE(EVENT_POLL_PURGE_HANDLE,
+              "watch=%d",
+              handle->watch);
+        if (handle->ff) {
+            virFreeCallback ff = handle->ff;
+            void *opaque = handle->opaque;
+            virMutexUnlock(&loop->lock);
+            ff(opaque);
+            virMutexLock(&loop->lock);
+        }
+
+        if ((i+1) < loop->handlesCount) {
+            memmove(loop->handles+i,
+                    loop->handles+i+1,
+                    sizeof(struct virEventEpollHandle *)*(loop->handlesCount
+                                                      -(i+1)));
+        }
+        loop->handlesCount--;
+        VIR_FREE(handle);
+    }
+
+    /* Release some memory if we've got a big chunk free */
+    gap = loop->handlesAlloc - loop->handlesCount;
+    if (loop->handlesCount == 0 ||
+        (gap > loop->handlesCount && gap > EVENT_ALLOC_EXTENT)) {
+        EVENT_DEBUG("Found %zu out of %zu handles slots used, releasing %zu",
+                    loop->handlesCount, loop->handlesAlloc, gap);
+        VIR_SHRINK_N(loop->handles, loop->handlesAlloc, gap);
+    }
+}
+
+/*
+ * Run a single iteration of the event loop, blocking until
+ * at least one file handle has an event, or a timer expires
+ */
+int virEventEpollLoopRunOnce(virEventEpollLoopPtr loop)
+{
+    struct epoll_event events[EVENT_EPOLL_MAX_EVENTS];
+    int ret, timeout;
+
+    virMutexLock(&loop->lock);
+    loop->running = 1;
+    virThreadSelf(&loop->leader);
+
+    virEventEpollCleanupTimeouts(loop);
+    virEventEpollCleanupHandles(loop);
+
+    if (virEventEpollCalculateTimeout(loop, &timeout) < 0)
+        goto error;
+
+    virMutexUnlock(&loop->lock);
+
+ retry:
+    PROBE(EVENT_POLL_RUN,
+          "nhandles=%zu timeout=%d",
+          loop->handlesCount, timeout);
+    ret = epoll_wait(loop->epollfd, events,
+                     EVENT_EPOLL_MAX_EVENTS, timeout);
+    if (ret < 0) {
+        EVENT_DEBUG("Poll got error event %d", errno);
+        if (errno == EINTR || errno == EAGAIN)
+            goto retry;
+        virReportSystemError(errno, "%s",
+                             _("Unable to poll on file handles"));
+        return -1;
+    }
+    EVENT_DEBUG("Poll got %d event(s)", ret);
+
+    virMutexLock(&loop->lock);
+    if (virEventEpollDispatchTimeouts(loop) < 0)
+        goto error;
+
+    if (ret > 0 &&
+        virEventEpollDispatchHandles(loop, ret, events) < 0)
+        goto error;
+
+    virEventEpollCleanupTimeouts(loop);
+    virEventEpollCleanupHandles(loop);
+
+    loop->running = 0;
+    virMutexUnlock(&loop->lock);
+    return 0;
+
+ error:
+    virMutexUnlock(&loop->lock);
+    return -1;
+}
+
+
+static void virEventEpollHandleWakeup(int watch ATTRIBUTE_UNUSED,
+                                      int fd,
+                                      int events ATTRIBUTE_UNUSED,
+                                      void *opaque)
+{
+    virEventEpollLoopPtr loop = opaque;
+    char c;
+    virMutexLock(&loop->lock);
+    ignore_value(saferead(fd, &c, sizeof(c)));
+    virMutexUnlock(&loop->lock);
+}
+
+static int virEventEpollLoopInitInternal(virEventEpollLoopPtr loop)
+{
+    loop->nextWatch = 1;
+    loop->nextTimer = 1;
+
+    if (virMutexInit(&loop->lock) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("Unable to initialize mutex"));
+        return -1;
+    }
+
+    if ((loop->epollfd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("Unable to create epoll fd"));
+        return -1;
+    }
+
+    if (pipe2(loop->wakeupfd, O_CLOEXEC | O_NONBLOCK) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("Unable to setup wakeup pipe"));
+        VIR_FORCE_CLOSE(loop->epollfd);
+        return -1;
+    }
+
+    if (virEventEpollLoopAddHandle(loop,
+                                   loop->wakeupfd[0],
+                                   VIR_EVENT_HANDLE_READABLE,
+                                   virEventEpollHandleWakeup,
+                                   loop, NULL) < 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("Unable to add handle %d to event loop"),
+                       loop->wakeupfd[0]);
+        VIR_FORCE_CLOSE(loop->wakeupfd[0]);
+        VIR_FORCE_CLOSE(loop->wakeupfd[1]);
+        VIR_FORCE_CLOSE(loop->epollfd);
+        return -1;
+    }
+
+    return 0;
+}
+
+virEventEpollLoopPtr virEventEpollLoopNew(void)
+{
+    virEventEpollLoopPtr loop;
+
+    if (VIR_ALLOC(loop) < 0)
+        return NULL;
+
+    if (virEventEpollLoopInitInternal(loop) < 0) {
+        VIR_FREE(loop);
+        return NULL;
+    }
+
+    return loop;
+}
+
+void virEventEpollLoopFree(virEventEpollLoopPtr loop)
+{
+    size_t i;
+
+    if (!loop)
+        return;
+
+    for (i = 0; i < loop->handlesCount; i++)
+        VIR_FREE(loop->handles[i]);
+    VIR_FREE(loop->handles);
+    VIR_FREE(loop->timeouts);
+    VIR_FORCE_CLOSE(loop->wakeupfd[0]);
+    VIR_FORCE_CLOSE(loop->wakeupfd[1]);
+    VIR_FORCE_CLOSE(loop->epollfd);
+    virMutexDestroy(&loop->lock);
+    VIR_FREE(loop);
+}
+
+static int virEventEpollInterruptLocked(virEventEpollLoopPtr loop)
+{
+    char c = '\0';
+
+    if (!loop->running ||
+        virThreadIsSelf(&loop->leader)) {
+        VIR_DEBUG("Skip interrupt, %d %llu", loop->running,
+                  virThreadID(&loop->leader));
+        return 0;
+    }
+
+    VIR_DEBUG("Interrupting");
+    if (safewrite(loop->wakeupfd[1], &c, sizeof(c)) != sizeof(c))
+        return -1;
+    return 0;
+}
+
+int virEventEpollLoopInterrupt(virEventEpollLoopPtr loop)
+{
+    int ret;
+    virMutexLock(&loop->lock);
+    ret = virEventEpollInterruptLocked(loop);
+    virMutexUnlock(&loop->lock);
+    return ret;
+}
+
+
+/*
+ * Entry points for the default event loop, matching the
+ * contract expected by virEventRegisterDefaultImpl()
+ */
+
+int virEventEpollAddHandle(int fd, int events,
+                           virEventHandleCallback cb,
+                           void *opaque,
+                           virFreeCallback ff)
+{
+    return virEventEpollLoopAddHandle(&eventLoop, fd, events, cb, opaque, ff);
+}
+
+void virEventEpollUpdateHandle(int watch, int events)
+{
+    virEventEpollLoopUpdateHandle(&eventLoop, watch, events);
+}
+
+int virEventEpollRemoveHandle(int watch)
+{
+    return virEventEpollLoopRemoveHandle(&eventLoop, watch);
+}
+
+int virEventEpollAddTimeout(int frequency,
+                            virEventTimeoutCallback cb,
+                            void *opaque,
+                            virFreeCallback ff)
+{
+    return virEventEpollLoopAddTimeout(&eventLoop, frequency, cb, opaque, ff);
+}
+
+void virEventEpollUpdateTimeout(int timer, int frequency)
+{
+    virEventEpollLoopUpdateTimeout(&eventLoop, timer, frequency);
+}
+
+int virEventEpollRemoveTimeout(int timer)
+{
+    return virEventEpollLoopRemoveTimeout(&eventLoop, timer);
+}
+
+int virEventEpollInit(void)
+{
+    return virEventEpollLoopInitInternal(&eventLoop);
+}
+
+int virEventEpollRunOnce(void)
+{
+    return virEventEpollLoopRunOnce(&eventLoop);
+}
+
+int virEventEpollInterrupt(void)
+{
+    return virEventEpollLoopInterrupt(&eventLoop);
+}
+
+
+/*
+ * Worker event loop pool. Daemons hosting very many file handles
+ * can spread handle monitoring over several threads, each running
+ * a private event loop, with handles sharded by file descriptor.
+ */
+
+struct virEventEpollWorker {
+    virEventEpollLoopPtr loop;
+    virThread thread;
+};
+
+static struct virEventEpollWorker *eventWorkers;
+static size_t nEventWorkers;
+static bool eventWorkersQuit;
+
+static void virEventEpollWorkerMain(void *opaque)
+{
+    virEventEpollLoopPtr loop = opaque;
+
+    while (!eventWorkersQuit) {
+        if (virEventEpollLoopRunOnce(loop) < 0) {
+            VIR_DEBUG("Worker event loop iteration error, exiting");
+            break;
+        }
+    }
+}
+
+int virEventEpollWorkersStart(size_t nworkers)
+{
+    size_t i;
+
+    if (eventWorkers) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("Worker event loops already started"));
+        return -1;
+    }
+
+    if (VIR_ALLOC_N(eventWorkers, nworkers) < 0)
+        return -1;
+
+    eventWorkersQuit = false;
+
+    for (i = 0; i < nworkers; i++) {
+        if (!(eventWorkers[i].loop = virEventEpollLoopNew()))
+            goto error;
+
+        if (virThreadCreate(&eventWorkers[i].thread, true,
+                            virEventEpollWorkerMain,
+                            eventWorkers[i].loop) < 0) {
+            virReportSystemError(errno, "%s",
+                                 _("Unable to create worker event loop thread"));
+            virEventEpollLoopFree(eventWorkers[i].loop);
+            eventWorkers[i].loop = NULL;
+            goto error;
+        }
+        nEventWorkers++;
+    }
+
+    return 0;
+
+ error:
+    virEventEpollWorkersStop();
+    return -1;
+}
+
+void virEventEpollWorkersStop(void)
+{
+    size_t i;
+
+    if (!eventWorkers)
+        return;
+
+    eventWorkersQuit = true;
+    for (i = 0; i < nEventWorkers; i++)
+        virEventEpollLoopInterrupt(eventWorkers[i].loop);
+    for (i = 0; i < nEventWorkers; i++) {
+        virThreadJoin(&eventWorkers[i].thread);
+        virEventEpollLoopFree(eventWorkers[i].loop);
+    }
+    VIR_FREE(eventWorkers);
+    nEventWorkers = 0;
+}
+
+virEventEpollLoopPtr virEventEpollWorkerLoopForFD(int fd)
+{
+    if (!nEventWorkers || fd < 0)
+        return NULL;
+
+    return eventWorkers[fd % nEventWorkers].loop;
+}
+
+#else /* ! WITH_EPOLL */
+
+/* On platforms without epoll() the poll() based implementation
+ * is registered by virEventRegisterDefaultImpl() instead, so
+ * these entry points simply delegate to it. This keeps the
+ * exported symbol list identical on all platforms. Worker event
+ * loop pools are not available without epoll().
+ */
+
+int virEventEpollAddHandle(int fd, int events,
+                           virEventHandleCallback cb,
+                           void *opaque,
+                           virFreeCallback ff)
+{
+    return virEventPollAddHandle(fd, events, cb, opaque, ff);
+}
+
+void virEventEpollUpdateHandle(int watch, int events)
+{
+    virEventPollUpdateHandle(watch, events);
+}
+
+int virEventEpollRemoveHandle(int watch)
+{
+    return virEventPollRemoveHandle(watch);
+}
+
+int virEventEpollAddTimeout(int frequency,
+                            virEventTimeoutCallback cb,
+                            void *opaque,
+                            virFreeCallback ff)
+{
+    return virEventPollAddTimeout(frequency, cb, opaque, ff);
+}
+
+void virEventEpollUpdateTimeout(int timer, int frequency)
+{
+    virEventPollUpdateTimeout(timer, frequency);
+}
+
+int virEventEpollRemoveTimeout(int timer)
+{
+    return virEventPollRemoveTimeout(timer);
+}
+
+int virEventEpollInit(void)
+{
+    return virEventPollInit();
+}
+
+int virEventEpollRunOnce(void)
+{
+    return virEventPollRunOnce();
+}
+
+int virEventEpollInterrupt(void)
+{
+    return virEventPollInterrupt();
+}
+
+virEventEpollLoopPtr virEventEpollLoopNew(void)
+{
+    virReportSystemError(ENOSYS, "%s",
+                         _("Worker event loops require epoll support"));
+    return NULL;
+}
+
+void virEventEpollLoopFree(virEventEpollLoopPtr loop ATTRIBUTE_UNUSED)
+{
+}
+
+int virEventEpollLoopAddHandle(virEventEpollLoopPtr loop ATTRIBUTE_UNUSED,
+                               int fd ATTRIBUTE_UNUSED,
+                               int events ATTRIBUTE_UNUSED,
+                               virEventHandleCallback cb ATTRIBUTE_UNUSED,
+                               void *opaque ATTRIBUTE_UNUSED,
+                               virFreeCallback ff ATTRIBUTE_UNUSED)
+{
+    virReportSystemError(ENOSYS, "%s",
+                         _("Worker event loops require epoll support"));
+    return -1;
+}
+
+void virEventEpollLoopUpdateHandle(virEventEpollLoopPtr loop ATTRIBUTE_UNUSED,
+                                   int watch ATTRIBUTE_UNUSED,
+                                   int events ATTRIBUTE_UNUSED)
+{
+}
+
+int virEventEpollLoopRemoveHandle(virEventEpollLoopPtr loop ATTRIBUTE_UNUSED,
+                                  int watch ATTRIBUTE_UNUSED)
+{
+    return -1;
+}
+
+int virEventEpollLoopRunOnce(virEventEpollLoopPtr loop ATTRIBUTE_UNUSED)
+{
+    virReportSystemError(ENOSYS, "%s",
+                         _("Worker event loops require epoll support"));
+    return -1;
+}
+
+int virEventEpollLoopInterrupt(virEventEpollLoopPtr loop ATTRIBUTE_UNUSED)
+{
+    return 0;
+}
+
+int virEventEpollWorkersStart(size_t nworkers ATTRIBUTE_UNUSED)
+{
+    virReportSystemError(ENOSYS, "%s",
+                         _("Worker event loops require epoll support"));
+    return -1;
+}
+
+void virEventEpollWorkersStop(void)
+{
+}
+
+virEventEpollLoopPtr virEventEpollWorkerLoopForFD(int fd ATTRIBUTE_UNUSED)
+{
+    return NULL;
+}
+
+#endif /* ! WITH_EPOLL */
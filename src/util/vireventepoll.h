@@ -0,0 +1,227 @@
+/*
+ * vireventepoll.h: epoll() based event loop for monitoring file handles
+ *
+ * Copyright (C) 2016 Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __VIR_EVENT_EPOLL_H__
+# define __VIR_EVENT_EPOLL_H__
+
+# include "internal.h"
+
+typedef struct _virEventEpollLoop virEventEpollLoop;
+typedef virEventEpollLoop *virEventEpollLoopPtr;
+
+/**
+ * virEventEpollAddHandle: register a callback for monitoring file handle events
+ *
+ * @fd: file handle to monitor for events
+ * @events: bitset of events to watch from virEventHandleType constants
+ * @cb: callback to invoke when an event occurs
+ * @opaque: user data to pass to callback
+ *
+ * Unlike the poll() based event loop, registration is O(1) and a
+ * wakeup only visits the handles which actually have pending events.
+ *
+ * returns -1 if the file handle cannot be registered, 0 upon success
+ */
+int virEventEpollAddHandle(int fd, int events,
+                           virEventHandleCallback cb,
+                           void *opaque,
+                           virFreeCallback ff);
+
+/**
+ * virEventEpollUpdateHandle: change event set for a monitored file handle
+ *
+ * @watch: watch whose handle to update
+ * @events: bitset of events to watch from virEventHandleType constants
+ *
+ * Will not fail if fd exists
+ */
+void virEventEpollUpdateHandle(int watch, int events);
+
+/**
+ * virEventEpollRemoveHandle: unregister a callback from a file handle
+ *
+ * @watch: watch whose handle to remove
+ *
+ * returns -1 if the file handle was not registered, 0 upon success
+ */
+int virEventEpollRemoveHandle(int watch);
+
+/**
+ * virEventEpollAddTimeout: register a callback for a timer event
+ *
+ * @frequency: time between events in milliseconds
+ * @cb: callback to invoke when an event occurs
+ * @opaque: user data to pass to callback
+ *
+ * Setting frequency to -1 will disable the timer. Setting the frequency
+ * to zero will cause it to fire on every event loop iteration.
+ *
+ * returns -1 if the file handle cannot be registered, a positive
+ * integer timer id upon success
+ */
+int virEventEpollAddTimeout(int frequency,
+                            virEventTimeoutCallback cb,
+                            void *opaque,
+                            virFreeCallback ff);
+
+/**
+ * virEventEpollUpdateTimeout: change frequency for a timer
+ *
+ * @timer: timer id to change
+ * @frequency: time between events in milliseconds
+ *
+ * Setting frequency to -1 will disable the timer. Setting the frequency
+ * to zero will cause it to fire on every event loop iteration.
+ *
+ * Will not fail if timer exists
+ */
+void virEventEpollUpdateTimeout(int timer, int frequency);
+
+/**
+ * virEventEpollRemoveTimeout: unregister a callback for a timer
+ *
+ * @timer: the timer id to remove
+ *
+ * returns -1 if the timer was not registered, 0 upon success
+ */
+int virEventEpollRemoveTimeout(int timer);
+
+/**
+ * virEventEpollInit: Initialize the event loop
+ *
+ * returns -1 if initialization failed
+ */
+int virEventEpollInit(void);
+
+/**
+ * virEventEpollRunOnce: run a single iteration of the event loop.
+ *
+ * Blocks the caller until at least one file handle has an
+ * event or the first timer expires.
+ *
+ * returns -1 if the event monitoring failed
+ */
+int virEventEpollRunOnce(void);
+
+/**
+ * virEventEpollInterrupt: wakeup any thread waiting in epoll_wait()
+ *
+ * return -1 if wakup failed
+ */
+int virEventEpollInterrupt(void);
+
+/**
+ * virEventEpollLoopNew: allocate a private event loop instance
+ *
+ * Creates an event loop independent of the default one registered
+ * by virEventRegisterDefaultImpl(). The caller is responsible for
+ * driving it via virEventEpollLoopRunOnce() from a dedicated thread.
+ *
+ * returns the new loop, or NULL on error
+ */
+virEventEpollLoopPtr virEventEpollLoopNew(void);
+
+/**
+ * virEventEpollLoopFree: release a private event loop instance
+ *
+ * @loop: the event loop to release
+ *
+ * The loop must no longer be running in any thread.
+ */
+void virEventEpollLoopFree(virEventEpollLoopPtr loop);
+
+/**
+ * virEventEpollLoopAddHandle: register a file handle on a private loop
+ *
+ * Semantics match virEventEpollAddHandle(), except the handle is
+ * monitored by @loop rather than the default event loop.
+ *
+ * returns -1 if the file handle cannot be registered, a positive
+ * watch number upon success
+ */
+int virEventEpollLoopAddHandle(virEventEpollLoopPtr loop,
+                               int fd, int events,
+                               virEventHandleCallback cb,
+                               void *opaque,
+                               virFreeCallback ff);
+
+/**
+ * virEventEpollLoopUpdateHandle: change event set on a private loop
+ *
+ * Semantics match virEventEpollUpdateHandle()
+ */
+void virEventEpollLoopUpdateHandle(virEventEpollLoopPtr loop,
+                                   int watch, int events);
+
+/**
+ * virEventEpollLoopRemoveHandle: unregister a handle from a private loop
+ *
+ * Semantics match virEventEpollRemoveHandle()
+ */
+int virEventEpollLoopRemoveHandle(virEventEpollLoopPtr loop,
+                                  int watch);
+
+/**
+ * virEventEpollLoopRunOnce: run one iteration of a private loop
+ *
+ * Semantics match virEventEpollRunOnce()
+ */
+int virEventEpollLoopRunOnce(virEventEpollLoopPtr loop);
+
+/**
+ * virEventEpollLoopInterrupt: wakeup a thread blocked in a private loop
+ *
+ * Semantics match virEventEpollInterrupt()
+ */
+int virEventEpollLoopInterrupt(virEventEpollLoopPtr loop);
+
+/**
+ * virEventEpollWorkersStart: start a pool of worker event loops
+ *
+ * @nworkers: number of event loop threads to spawn
+ *
+ * Spawns @nworkers threads, each driving a private event loop.
+ * File handles can subsequently be sharded over the workers via
+ * virEventEpollWorkerLoopForFD(). Only one pool may exist.
+ *
+ * returns 0 on success, -1 on error
+ */
+int virEventEpollWorkersStart(size_t nworkers);
+
+/**
+ * virEventEpollWorkersStop: stop the pool of worker event loops
+ *
+ * Interrupts and joins all worker threads and releases their
+ * event loops. Any handles still registered are dropped.
+ */
+void virEventEpollWorkersStop(void);
+
+/**
+ * virEventEpollWorkerLoopForFD: look up the worker loop for a file handle
+ *
+ * @fd: the file descriptor to be monitored
+ *
+ * Shards @fd over the running worker pool. Returns NULL if no
+ * worker pool is running, in which case the caller should fall
+ * back to the default event loop.
+ */
+virEventEpollLoopPtr virEventEpollWorkerLoopForFD(int fd);
+
+#endif /* __VIR_EVENT_EPOLL_H__ */
@@ -39,6 +39,7 @@
 #include "virfile.h"
 #include "virerror.h"
 #include "virprobe.h"
+#include "virstring.h"
 #include "virtime.h"
 
 #define EVENT_DEBUG(fmt, ...) VIR_DEBUG(fmt, __VA_ARGS__)
@@ -98,6 +99,51 @@ static int nextWatch = 1;
 /* Unique ID for the next timer to be registered */
 static int nextTimer = 1;
 
+/* Log2 histogram of per-callback dispatch times. Bucket 0 counts
+ * callbacks completing in under 1ms, bucket N covers the range
+ * [2^(N-1), 2^N) ms and the last bucket collects everything slower.
+ * While a callback runs the loop cannot service any other handle,
+ * so slow callbacks show up to clients as monitor/RPC latency.
+ * All counters are updated with eventLoop.lock held. */
+#define EVENT_DISPATCH_BUCKETS 12
+
+static unsigned long long eventDispatchHist[EVENT_DISPATCH_BUCKETS];
+static unsigned long long eventDispatchMax;
+static unsigned long long eventDispatchOverruns;
+
+/* Warn about any single callback holding up the loop for longer
+ * than this many milliseconds. Overridable at process startup via
+ * the LIBVIRT_EVENT_DISPATCH_WARN_MS env variable; 0 disables the
+ * warning but the histogram is still maintained. */
+#define EVENT_DISPATCH_WARN_MS 200
+
+static long long eventDispatchWarnMS = -1;
+
+static unsigned long long
+virEventPollDispatchWarnMS(void)
+{
+    if (eventDispatchWarnMS < 0) {
+        unsigned long long ms = EVENT_DISPATCH_WARN_MS;
+        const char *env = getenv("LIBVIRT_EVENT_DISPATCH_WARN_MS");
+        if (env && virStrToLong_ull(env, NULL, 10, &ms) < 0)
+            ms = EVENT_DISPATCH_WARN_MS;
+        eventDispatchWarnMS = ms;
+    }
+    return eventDispatchWarnMS;
+}
+
+static void
+virEventPollDispatchAccount(unsigned long long ms)
+{
+    size_t bucket = 0;
+
+    while (ms >> bucket && bucket < EVENT_DISPATCH_BUCKETS - 1)
+        bucket++;
+    eventDispatchHist[bucket]++;
+    if (ms > eventDispatchMax)
+        eventDispatchMax = ms;
+}
+
 /*
  * Register a callback for monitoring file handle events.
  * NB, it *must* be safe to call this from within a callback
@@ -447,6 +493,9 @@ static int virEventPollDispatchTimeouts(void)
             virEventTimeoutCallback cb = eventLoop.timeouts[i].cb;
             int timer = eventLoop.timeouts[i].timer;
             void *opaque = eventLoop.timeouts[i].opaque;
+            unsigned long long start = 0;
+            unsigned long long end = 0;
+            unsigned long long warn = virEventPollDispatchWarnMS();
             eventLoop.timeouts[i].expiresAt =
                 now + eventLoop.timeouts[i].frequency;
 
@@ -454,8 +503,21 @@ static int virEventPollDispatchTimeouts(void)
                   "timer=%d",
                   timer);
             virMutexUnlock(&eventLoop.lock);
+            if (virTimeMillisNowRaw(&start) < 0)
+                start = 0;
             (cb)(timer, opaque);
+            if (start == 0 ||
+                virTimeMillisNowRaw(&end) < 0 ||
+                end < start)
+                end = start;
             virMutexLock(&eventLoop.lock);
+            virEventPollDispatchAccount(end - start);
+            if (warn && (end - start) >= warn) {
+                eventDispatchOverruns++;
+                VIR_WARN("Timer %d callback %p (opaque %p) blocked "
+                         "the event loop for %llu ms",
+                         timer, cb, opaque, end - start);
+            }
         }
     }
     return 0;
@@ -501,12 +563,28 @@ static int virEventPollDispatchHandles(int nfds, struct pollfd *fds)
             int watch = eventLoop.handles[i].watch;
             void *opaque = eventLoop.handles[i].opaque;
             int hEvents = virEventPollFromNativeEvents(fds[n].revents);
+            unsigned long long start = 0;
+            unsigned long long end = 0;
+            unsigned long long warn = virEventPollDispatchWarnMS();
             PROBE(EVENT_POLL_DISPATCH_HANDLE,
                   "watch=%d events=%d",
                   watch, hEvents);
             virMutexUnlock(&eventLoop.lock);
+            if (virTimeMillisNowRaw(&start) < 0)
+                start = 0;
             (cb)(watch, fds[n].fd, hEvents, opaque);
+            if (start == 0 ||
+                virTimeMillisNowRaw(&end) < 0 ||
+                end < start)
+                end = start;
             virMutexLock(&eventLoop.lock);
+            virEventPollDispatchAccount(end - start);
+            if (warn && (end - start) >= warn) {
+                eventDispatchOverruns++;
+                VIR_WARN("Watch %d (fd %d) callback %p (opaque %p) blocked "
+                         "the event loop for %llu ms",
+                         watch, fds[n].fd, cb, opaque, end - start);
+            }
         }
     }
 
@@ -619,6 +697,8 @@ static void virEventPollCleanupHandles(void)
 int virEventPollRunOnce(void)
 {
     struct pollfd *fds = NULL;
+    unsigned long long dispatchStart = 0;
+    unsigned long long dispatchEnd = 0;
     int ret, timeout, nfds;
 
     virMutexLock(&eventLoop.lock);
@@ -648,6 +728,12 @@ int virEventPollRunOnce(void)
         goto error_unlocked;
     }
     EVENT_DEBUG("Poll got %d event(s)", ret);
+    PROBE(EVENT_POLL_AWOKEN,
+          "nready=%d",
+          ret);
+
+    if (virTimeMillisNowRaw(&dispatchStart) < 0)
+        dispatchStart = 0;
 
     virMutexLock(&eventLoop.lock);
     if (virEventPollDispatchTimeouts() < 0)
@@ -660,6 +746,16 @@ int virEventPollRunOnce(void)
     virEventPollCleanupTimeouts();
     virEventPollCleanupHandles();
 
+    /* time spent in callbacks is time the loop could not service
+     * other handles, i.e. an event loop stall */
+    if (dispatchStart == 0 ||
+        virTimeMillisNowRaw(&dispatchEnd) < 0 ||
+        dispatchEnd < dispatchStart)
+        dispatchEnd = dispatchStart;
+    PROBE(EVENT_POLL_RUN_DONE,
+          "nhandles=%d nready=%d dispatchms=%llu",
+          nfds, ret, dispatchEnd - dispatchStart);
+
     eventLoop.running = 0;
     virMutexUnlock(&eventLoop.lock);
     VIR_FREE(fds);
@@ -673,6 +769,39 @@ int virEventPollRunOnce(void)
 }
 
 
+void virEventPollDispatchStatsLog(void)
+{
+    unsigned long long hist[EVENT_DISPATCH_BUCKETS];
+    unsigned long long max;
+    unsigned long long overruns;
+    unsigned long long lo;
+    unsigned long long hi;
+    size_t i;
+
+    virMutexLock(&eventLoop.lock);
+    memcpy(hist, eventDispatchHist, sizeof(hist));
+    max = eventDispatchMax;
+    overruns = eventDispatchOverruns;
+    virMutexUnlock(&eventLoop.lock);
+
+    VIR_INFO("Event loop dispatch stats: max %llu ms, "
+             "%llu callbacks over the %llu ms budget",
+             max, overruns, virEventPollDispatchWarnMS());
+    for (i = 0; i < EVENT_DISPATCH_BUCKETS; i++) {
+        if (!hist[i])
+            continue;
+        lo = i ? 1ULL << (i - 1) : 0;
+        hi = 1ULL << i;
+        if (i == EVENT_DISPATCH_BUCKETS - 1)
+            VIR_INFO("Event loop dispatch stats: >= %llu ms: %llu calls",
+                     lo, hist[i]);
+        else
+            VIR_INFO("Event loop dispatch stats: [%llu, %llu) ms: %llu calls",
+                     lo, hi, hist[i]);
+    }
+}
+
+
 static void virEventPollHandleWakeup(int watch ATTRIBUTE_UNUSED,
                                      int fd,
                                      int events ATTRIBUTE_UNUSED,
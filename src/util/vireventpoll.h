@@ -117,6 +117,15 @@ int virEventPollInit(void);
  */
 int virEventPollRunOnce(void);
 
+/**
+ * virEventPollDispatchStatsLog: log per-callback dispatch statistics
+ *
+ * Emits the histogram of time spent inside individual handle and
+ * timer callbacks, the worst observed callback duration and the
+ * number of callbacks that exceeded the configured warning budget.
+ */
+void virEventPollDispatchStatsLog(void);
+
 int virEventPollFromNativeEvents(int events);
 int virEventPollToNativeEvents(int events);
 
@@ -1268,6 +1268,17 @@ saferead_lim(int fd, size_t max_len, size_t *length)
     size_t alloc = 0;
     size_t size = 0;
     int save_errno;
+    struct stat st;
+
+    /* Files on proc and sys report a zero size; for anything else the
+       size is a good hint that lets the whole content land in a single
+       allocation and be fetched with a single read.  */
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        alloc = MIN((unsigned long long) st.st_size + BUFSIZ + 1,
+                    max_len + 1);
+        if (VIR_REALLOC_N(buf, alloc) < 0)
+            return NULL;
+    }
 
     for (;;) {
         int count;
@@ -26,6 +26,7 @@
 #define __VIR_FIREWALL_PRIV_H_ALLOW__
 
 #include <stdarg.h>
+#include <string.h>
 
 #include "viralloc.h"
 #include "virfirewallpriv.h"
@@ -55,6 +56,14 @@ VIR_ENUM_DECL(virFirewallLayerFirewallD)
 VIR_ENUM_IMPL(virFirewallLayerFirewallD, VIR_FIREWALL_LAYER_LAST,
               "eb", "ipv4", "ipv6")
 
+/* ebtables-restore cannot preserve rules it did not create, so the
+ * ethernet layer is never batched and has no restore command */
+VIR_ENUM_DECL(virFirewallLayerRestoreCommand)
+VIR_ENUM_IMPL(virFirewallLayerRestoreCommand, VIR_FIREWALL_LAYER_LAST,
+              "",
+              IPTABLES_RESTORE_PATH,
+              IP6TABLES_RESTORE_PATH);
+
 
 struct _virFirewallRule {
     virFirewallLayer layer;
@@ -108,6 +117,8 @@ static bool iptablesUseLock;
 static bool ip6tablesUseLock;
 static bool ebtablesUseLock;
 static bool lockOverride; /* true to avoid lock probes */
+static bool iptablesUseRestore;
+static bool ip6tablesUseRestore;
 
 void
 virFirewallSetLockOverride(bool avoid)
@@ -195,6 +206,16 @@ virFirewallValidateBackend(virFirewallBackend backend)
             }
         }
         VIR_DEBUG("found iptables/ip6tables/ebtables, using direct backend");
+
+        /* The lock override is set by the test suites, which expect
+         * one process per rule, so skip the restore probe with it */
+        if (!lockOverride) {
+            iptablesUseRestore = virFileIsExecutable(IPTABLES_RESTORE_PATH);
+            ip6tablesUseRestore = virFileIsExecutable(IP6TABLES_RESTORE_PATH);
+            VIR_DEBUG("iptables-restore %savailable, ip6tables-restore %savailable",
+                      iptablesUseRestore ? "" : "un",
+                      ip6tablesUseRestore ? "" : "un");
+        }
     }
 
     currentBackend = backend;
@@ -692,6 +713,51 @@ virFirewallRuleToString(virFirewallRulePtr rule)
     return virBufferContentAndReset(&buf);
 }
 
+/**
+ * virFirewallToString:
+ * @firewall: the firewall ruleset
+ *
+ * Render every action rule of the ruleset into one string, in
+ * application order. The result is not executable; it provides a
+ * canonical description of the ruleset that can be compared against
+ * another one for equality.
+ *
+ * Returns the string, or NULL on allocation failure or if the
+ * ruleset contains no rules
+ */
+char *
+virFirewallToString(virFirewallPtr firewall)
+{
+    virBuffer buf = VIR_BUFFER_INITIALIZER;
+    size_t i, j;
+
+    if (!firewall || firewall->err)
+        return NULL;
+
+    for (i = 0; i < firewall->ngroups; i++) {
+        virFirewallGroupPtr group = firewall->groups[i];
+
+        for (j = 0; j < group->naction; j++) {
+            char *str = virFirewallRuleToString(group->action[j]);
+
+            if (!str) {
+                virBufferFreeAndReset(&buf);
+                virReportOOMError();
+                return NULL;
+            }
+            virBufferAdd(&buf, str, -1);
+            virBufferAddChar(&buf, '\n');
+            VIR_FREE(str);
+        }
+    }
+
+    if (virBufferCheckError(&buf) < 0)
+        return NULL;
+
+    return virBufferContentAndReset(&buf);
+}
+
+
 static int
 virFirewallApplyRuleDirect(virFirewallRulePtr rule,
                            bool ignoreErrors,
@@ -883,25 +949,239 @@ virFirewallApplyRule(virFirewallPtr firewall,
     return ret;
 }
 
+typedef struct _virFirewallBatch virFirewallBatch;
+typedef virFirewallBatch *virFirewallBatchPtr;
+struct _virFirewallBatch {
+    virBuffer buf;
+    char *table; /* table of the section currently open in @buf */
+    size_t nrules;
+};
+
+
+/*
+ * Decide whether a rule can be folded into a *tables-restore
+ * payload. Rules needing their output back, or whose failure must be
+ * tolerated, have to run on their own since a restore run is
+ * all-or-nothing and produces no per-rule output.
+ */
+static bool
+virFirewallRuleBatchable(virFirewallRulePtr rule,
+                         bool ignoreErrors)
+{
+    size_t i = 0;
+    const char *op;
+
+    if (currentBackend != VIR_FIREWALL_BACKEND_DIRECT)
+        return false;
+
+    if (rule->queryCB || rule->ignoreErrors || ignoreErrors)
+        return false;
+
+    switch (rule->layer) {
+    case VIR_FIREWALL_LAYER_IPV4:
+        if (!iptablesUseRestore)
+            return false;
+        break;
+    case VIR_FIREWALL_LAYER_IPV6:
+        if (!ip6tablesUseRestore)
+            return false;
+        break;
+    case VIR_FIREWALL_LAYER_ETHERNET:
+    case VIR_FIREWALL_LAYER_LAST:
+        return false;
+    }
+
+    /* Find the command option, stepping over the lock flag and any
+     * table selection, both of which the restore tool handles itself */
+    while (i < rule->argsLen) {
+        if (STREQ(rule->args[i], "-w")) {
+            i++;
+            continue;
+        }
+        if ((STREQ(rule->args[i], "-t") ||
+             STREQ(rule->args[i], "--table")) &&
+            i + 1 < rule->argsLen) {
+            i += 2;
+            continue;
+        }
+        break;
+    }
+    if (i >= rule->argsLen)
+        return false;
+
+    /* Only the chain/rule editing commands are valid inside a
+     * restore payload; anything else (listing, renaming, ...)
+     * keeps the one-process-per-rule path */
+    op = rule->args[i];
+    return STREQ(op, "-N") || STREQ(op, "--new-chain") ||
+           STREQ(op, "-A") || STREQ(op, "--append") ||
+           STREQ(op, "-I") || STREQ(op, "--insert") ||
+           STREQ(op, "-D") || STREQ(op, "--delete") ||
+           STREQ(op, "-F") || STREQ(op, "--flush") ||
+           STREQ(op, "-X") || STREQ(op, "--delete-chain");
+}
+
+
+static void
+virFirewallBatchEscapeArg(virBufferPtr buf,
+                          const char *arg)
+{
+    /* The restore tools split each line on unquoted whitespace */
+    if (*arg && !strpbrk(arg, " \t\"\\")) {
+        virBufferAdd(buf, arg, -1);
+        return;
+    }
+
+    virBufferAddChar(buf, '"');
+    for (; *arg; arg++) {
+        if (*arg == '"' || *arg == '\\')
+            virBufferAddChar(buf, '\\');
+        virBufferAddChar(buf, *arg);
+    }
+    virBufferAddChar(buf, '"');
+}
+
+
+static int
+virFirewallBatchAddRule(virFirewallBatchPtr batch,
+                        virFirewallRulePtr rule)
+{
+    const char *table = "filter";
+    size_t i;
+
+    for (i = 0; i < rule->argsLen; i++) {
+        if ((STREQ(rule->args[i], "-t") ||
+             STREQ(rule->args[i], "--table")) &&
+            i + 1 < rule->argsLen) {
+            table = rule->args[i + 1];
+            break;
+        }
+    }
+
+    if (!batch->table || STRNEQ(batch->table, table)) {
+        if (batch->table)
+            virBufferAddLit(&batch->buf, "COMMIT\n");
+        virBufferAsprintf(&batch->buf, "*%s\n", table);
+        VIR_FREE(batch->table);
+        if (VIR_STRDUP(batch->table, table) < 0)
+            return -1;
+    }
+
+    for (i = 0; i < rule->argsLen; i++) {
+        if (STREQ(rule->args[i], "-w"))
+            continue;
+        if ((STREQ(rule->args[i], "-t") ||
+             STREQ(rule->args[i], "--table")) &&
+            i + 1 < rule->argsLen) {
+            i++;
+            continue;
+        }
+        virFirewallBatchEscapeArg(&batch->buf, rule->args[i]);
+        virBufferAddLit(&batch->buf, " ");
+    }
+    virBufferTrim(&batch->buf, " ", -1);
+    virBufferAddLit(&batch->buf, "\n");
+    batch->nrules++;
+
+    return virBufferCheckError(&batch->buf);
+}
+
+
+static int
+virFirewallBatchFlush(virFirewallLayer layer,
+                      virFirewallBatchPtr batch)
+{
+    const char *bin = virFirewallLayerRestoreCommandTypeToString(layer);
+    virCommandPtr cmd = NULL;
+    char *payload = NULL;
+    char *error = NULL;
+    int status;
+    int ret = -1;
+
+    if (batch->nrules == 0)
+        return 0;
+
+    virBufferAddLit(&batch->buf, "COMMIT\n");
+    if (virBufferCheckError(&batch->buf) < 0)
+        goto cleanup;
+    payload = virBufferContentAndReset(&batch->buf);
+
+    VIR_INFO("Applying %zu rule(s) through '%s':\n%s",
+             batch->nrules, bin, payload);
+
+    cmd = virCommandNewArgList(bin, "--noflush", NULL);
+    virCommandSetInputBuffer(cmd, payload);
+    virCommandSetErrorBuffer(cmd, &error);
+
+    if (virCommandRun(cmd, &status) < 0)
+        goto cleanup;
+
+    if (status != 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("Failed to apply firewall rules %s: %s"),
+                       payload, NULLSTR(error));
+        goto cleanup;
+    }
+
+    ret = 0;
+ cleanup:
+    batch->nrules = 0;
+    VIR_FREE(batch->table);
+    VIR_FREE(payload);
+    VIR_FREE(error);
+    virCommandFree(cmd);
+    return ret;
+}
+
+
 static int
 virFirewallApplyGroup(virFirewallPtr firewall,
                       size_t idx)
 {
     virFirewallGroupPtr group = firewall->groups[idx];
     bool ignoreErrors = (group->actionFlags & VIR_FIREWALL_TRANSACTION_IGNORE_ERRORS);
-    size_t i;
+    virFirewallBatch batches[VIR_FIREWALL_LAYER_LAST];
+    size_t i, j;
+    int ret = -1;
+
+    memset(batches, 0, sizeof(batches));
 
     VIR_INFO("Starting transaction for firewall=%p group=%p flags=%x",
              firewall, group, group->actionFlags);
     firewall->currentGroup = idx;
     group->addingRollback = false;
     for (i = 0; i < group->naction; i++) {
-        if (virFirewallApplyRule(firewall,
-                                 group->action[i],
-                                 ignoreErrors) < 0)
-            return -1;
+        virFirewallRulePtr rule = group->action[i];
+
+        if (virFirewallRuleBatchable(rule, ignoreErrors)) {
+            if (virFirewallBatchAddRule(&batches[rule->layer], rule) < 0)
+                goto cleanup;
+            continue;
+        }
+
+        /* The rule needs a process of its own; push out anything
+         * batched so far to keep the ordering intact */
+        for (j = 0; j < VIR_FIREWALL_LAYER_LAST; j++) {
+            if (virFirewallBatchFlush(j, &batches[j]) < 0)
+                goto cleanup;
+        }
+
+        if (virFirewallApplyRule(firewall, rule, ignoreErrors) < 0)
+            goto cleanup;
     }
-    return 0;
+
+    for (j = 0; j < VIR_FIREWALL_LAYER_LAST; j++) {
+        if (virFirewallBatchFlush(j, &batches[j]) < 0)
+            goto cleanup;
+    }
+
+    ret = 0;
+ cleanup:
+    for (j = 0; j < VIR_FIREWALL_LAYER_LAST; j++) {
+        virBufferFreeAndReset(&batches[j].buf);
+        VIR_FREE(batches[j].table);
+    }
+    return ret;
 }
 
 
@@ -106,6 +106,8 @@ void virFirewallStartRollback(virFirewallPtr firewall,
 
 int virFirewallApply(virFirewallPtr firewall);
 
+char *virFirewallToString(virFirewallPtr firewall);
+
 void virFirewallSetLockOverride(bool avoid);
 
 #endif /* __VIR_FIREWALL_H__ */
@@ -56,6 +56,8 @@ struct _virHashEntry {
     struct _virHashEntry *next;
     void *name;
     void *payload;
+    uint32_t code; /* hash code of @name, to skip failing comparisons
+                      and to avoid rehashing the key when growing */
 };
 
 /*
@@ -65,7 +67,10 @@ struct _virHashTable {
     virHashEntryPtr *table;
     uint32_t seed;
     size_t size;
+    size_t minSize; /* creation size; auto-shrink never goes below this */
     size_t nbElems;
+    size_t grows;
+    size_t shrinks;
     /* True iff we are iterating over hash entries. */
     bool iterating;
     /* Pointer to the current entry during iteration. */
@@ -129,11 +134,16 @@ virHashValueFree(void *value, const void *name ATTRIBUTE_UNUSED)
 }
 
 
+static uint32_t
+virHashComputeCode(const virHashTable *table, const void *name)
+{
+    return table->keyCode(name, table->seed);
+}
+
 static size_t
-virHashComputeKey(const virHashTable *table, const void *name)
+virHashComputeBucket(const virHashTable *table, uint32_t code)
 {
-    uint32_t value = table->keyCode(name, table->seed);
-    return value % table->size;
+    return code % table->size;
 }
 
 /**
@@ -166,6 +176,7 @@ virHashTablePtr virHashCreateFull(ssize_t size,
 
     table->seed = virRandomBits(32);
     table->size = size;
+    table->minSize = size;
     table->nbElems = 0;
     table->dataFree = dataFree;
     table->keyCode = keyCode;
@@ -254,8 +265,6 @@ virHashGrow(virHashTablePtr table, size_t size)
         return -1;
     if (size < 8)
         return -1;
-    if (size > 8 * 2048)
-        return -1;
 
     oldsize = table->size;
     oldtable = table->table;
@@ -272,7 +281,7 @@ virHashGrow(virHashTablePtr table, size_t size)
         virHashEntryPtr iter = oldtable[i];
         while (iter) {
             virHashEntryPtr next = iter->next;
-            size_t key = virHashComputeKey(table, iter->name);
+            size_t key = virHashComputeBucket(table, iter->code);
 
             iter->next = table->table[key];
             table->table[key] = iter;
@@ -286,6 +295,11 @@ virHashGrow(virHashTablePtr table, size_t size)
 
     VIR_FREE(oldtable);
 
+    if (size > oldsize)
+        table->grows++;
+    else
+        table->shrinks++;
+
 #ifdef DEBUG_GROW
     VIR_DEBUG("virHashGrow : from %d to %d, %ld elems", oldsize,
               size, nbElem);
@@ -294,6 +308,35 @@ virHashGrow(virHashTablePtr table, size_t size)
     return 0;
 }
 
+
+/**
+ * virHashMaybeShrink:
+ * @table: the hash table
+ *
+ * Halve the bucket array if the table has drained to well below its
+ * capacity, so that a table surviving a churn spike does not carry an
+ * oversized, mostly empty bucket array for the rest of the daemon's
+ * lifetime. The table never shrinks below its creation size and the
+ * hysteresis (shrink at 1/8 load, grow at 1/1) prevents flapping
+ * around a steady population.
+ */
+static void
+virHashMaybeShrink(virHashTablePtr table)
+{
+    size_t newsize = table->size / 2;
+
+    if (table->iterating)
+        return;
+
+    if (newsize < table->minSize || newsize < 8)
+        return;
+
+    if (table->nbElems * 8 >= table->size)
+        return;
+
+    virHashGrow(table, newsize);
+}
+
 /**
  * virHashFree:
  * @table: the hash table
@@ -333,6 +376,7 @@ virHashAddOrUpdateEntry(virHashTablePtr table, const void *name,
                         bool is_update)
 {
     size_t key, len = 0;
+    uint32_t code;
     virHashEntryPtr entry;
     void *new_name;
 
@@ -342,11 +386,12 @@ virHashAddOrUpdateEntry(virHashTablePtr table, const void *name,
     if (table->iterating)
         virHashIterationError(-1);
 
-    key = virHashComputeKey(table, name);
+    code = virHashComputeCode(table, name);
+    key = virHashComputeBucket(table, code);
 
     /* Check for duplicate entry */
     for (entry = table->table[key]; entry; entry = entry->next) {
-        if (table->keyEqual(entry->name, name)) {
+        if (entry->code == code && table->keyEqual(entry->name, name)) {
             if (is_update) {
                 if (table->dataFree)
                     table->dataFree(entry->payload, entry->name);
@@ -368,13 +413,23 @@ virHashAddOrUpdateEntry(virHashTablePtr table, const void *name,
 
     entry->name = new_name;
     entry->payload = userdata;
+    entry->code = code;
     entry->next = table->table[key];
     table->table[key] = entry;
 
     table->nbElems++;
 
-    if (len > MAX_HASH_LEN)
-        virHashGrow(table, MAX_HASH_LEN * table->size);
+    /* Grow on overall load rather than waiting for a single bucket to
+     * degrade, so lookups stay short even with many entries; a long
+     * bucket in an underfull table still forces a grow in case the
+     * keys hash unevenly.  */
+    if (table->nbElems > table->size || len > MAX_HASH_LEN) {
+        size_t newsize = table->size * 2;
+
+        if (newsize < 8)
+            newsize = 8;
+        virHashGrow(table, newsize);
+    }
 
     return 0;
 }
@@ -443,14 +498,16 @@ void *
 virHashLookup(const virHashTable *table, const void *name)
 {
     size_t key;
+    uint32_t code;
     virHashEntryPtr entry;
 
     if (!table || !name)
         return NULL;
 
-    key = virHashComputeKey(table, name);
+    code = virHashComputeCode(table, name);
+    key = virHashComputeBucket(table, code);
     for (entry = table->table[key]; entry; entry = entry->next) {
-        if (table->keyEqual(entry->name, name))
+        if (entry->code == code && table->keyEqual(entry->name, name))
             return entry->payload;
     }
     return NULL;
@@ -544,13 +601,15 @@ virHashRemoveEntry(virHashTablePtr table, const void *name)
 {
     virHashEntryPtr entry;
     virHashEntryPtr *nextptr;
+    uint32_t code;
 
     if (table == NULL || name == NULL)
         return -1;
 
-    nextptr = table->table + virHashComputeKey(table, name);
+    code = virHashComputeCode(table, name);
+    nextptr = table->table + virHashComputeBucket(table, code);
     for (entry = *nextptr; entry; entry = entry->next) {
-        if (table->keyEqual(entry->name, name)) {
+        if (entry->code == code && table->keyEqual(entry->name, name)) {
             if (table->iterating && table->current != entry)
                 virHashIterationError(-1);
 
@@ -561,6 +620,7 @@ virHashRemoveEntry(virHashTablePtr table, const void *name)
             *nextptr = entry->next;
             VIR_FREE(entry);
             table->nbElems--;
+            virHashMaybeShrink(table);
             return 0;
         }
         nextptr = &entry->next;
@@ -570,6 +630,50 @@ virHashRemoveEntry(virHashTablePtr table, const void *name)
 }
 
 
+/**
+ * virHashGetStats:
+ * @table: the hash table
+ * @stats: filled with the table's statistics
+ *
+ * Report occupancy statistics for the hash @table: element and
+ * bucket counts, the longest collision chain and how often the
+ * bucket array was resized. Intended for debugging degenerate
+ * tables in long-running daemons.
+ *
+ * Returns 0 on success, -1 in case of error.
+ */
+int
+virHashGetStats(const virHashTable *table,
+                virHashStatsPtr stats)
+{
+    size_t i;
+
+    if (table == NULL || stats == NULL)
+        return -1;
+
+    memset(stats, 0, sizeof(*stats));
+    stats->nbElems = table->nbElems;
+    stats->nBuckets = table->size;
+    stats->grows = table->grows;
+    stats->shrinks = table->shrinks;
+
+    for (i = 0; i < table->size; i++) {
+        virHashEntryPtr entry;
+        size_t chain = 0;
+
+        for (entry = table->table[i]; entry; entry = entry->next)
+            chain++;
+
+        if (chain == 0)
+            stats->emptyBuckets++;
+        else if (chain > stats->maxChain)
+            stats->maxChain = chain;
+    }
+
+    return 0;
+}
+
+
 /**
  * virHashForEach
  * @table: the hash table to process
@@ -669,6 +773,9 @@ virHashRemoveSet(virHashTablePtr table,
     }
     table->iterating = false;
 
+    if (count)
+        virHashMaybeShrink(table);
+
     return count;
 }
 
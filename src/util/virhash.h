@@ -118,6 +118,22 @@ void virHashFree(virHashTablePtr table);
 ssize_t virHashSize(const virHashTable *table);
 ssize_t virHashTableSize(const virHashTable *table);
 
+/*
+ * Occupancy statistics, for debugging degenerate tables.
+ */
+typedef struct _virHashStats virHashStats;
+typedef virHashStats *virHashStatsPtr;
+struct _virHashStats {
+    size_t nbElems;      /* number of elements stored */
+    size_t nBuckets;     /* current size of the bucket array */
+    size_t maxChain;     /* longest collision chain */
+    size_t emptyBuckets; /* buckets holding no element */
+    size_t grows;        /* times the bucket array was enlarged */
+    size_t shrinks;      /* times the bucket array was halved */
+};
+int virHashGetStats(const virHashTable *table,
+                    virHashStatsPtr stats);
+
 /*
  * Add a new entry to the hash table.
  */
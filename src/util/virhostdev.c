@@ -38,6 +38,7 @@
 #include "virfile.h"
 #include "virerror.h"
 #include "virlog.h"
+#include "virthread.h"
 #include "virutil.h"
 #include "virnetdev.h"
 #include "configmake.h"
@@ -476,6 +477,30 @@ virHostdevNetConfigRestore(virDomainHostdevDefPtr hostdev,
     return ret;
 }
 
+struct virHostdevPCIDetachThreadData {
+    virThread thread;
+    bool threaded;
+    virPCIDevicePtr pci;
+    int ret;
+    virErrorPtr err;
+};
+
+static void
+virHostdevPCIDetachThread(void *opaque)
+{
+    struct virHostdevPCIDetachThreadData *data = opaque;
+
+    /* Passing NULL device lists makes virPCIDeviceDetach() skip all
+     * list manipulation and just bind the device to its stub driver,
+     * which is the only slow part and the only part that is safe to
+     * run outside the list locks; the caller does the bookkeeping
+     * serially after joining the threads. The error has to be saved
+     * here because the error object is thread local. */
+    data->ret = virPCIDeviceDetach(data->pci, NULL, NULL);
+    if (data->ret < 0)
+        data->err = virSaveLastError();
+}
+
 int
 virHostdevPreparePCIDevices(virHostdevManagerPtr mgr,
                             const char *drv_name,
@@ -490,6 +515,9 @@ virHostdevPreparePCIDevices(virHostdevManagerPtr mgr,
     size_t i;
     int ret = -1;
     virPCIDeviceAddressPtr devAddr = NULL;
+    struct virHostdevPCIDetachThreadData *detachData = NULL;
+    size_t ndetachData = 0;
+    bool detachParallel = true;
 
     if (!nhostdevs)
         return 0;
@@ -546,15 +574,15 @@ virHostdevPreparePCIDevices(virHostdevManagerPtr mgr,
         if (virPCIDeviceGetManaged(pci)) {
 
             /* We can't look up the actual device because it has not been
-             * created yet: virPCIDeviceDetach() will insert a copy of 'pci'
-             * into the list of inactive devices, and that copy will be the
-             * actual device going forward */
-            VIR_DEBUG("Detaching managed PCI device %s",
-                      virPCIDeviceGetName(pci));
-            if (virPCIDeviceDetach(pci,
-                                   mgr->activePCIHostdevs,
-                                   mgr->inactivePCIHostdevs) < 0)
+             * created yet: a copy of 'pci' will be inserted into the list
+             * of inactive devices below, and that copy will be the actual
+             * device going forward. Just collect the device here; the
+             * actual detaching is done in the next step */
+            if (VIR_EXPAND_N(detachData, ndetachData, 1) < 0)
                 goto reattachdevs;
+            detachData[ndetachData - 1].pci = pci;
+            if (!virPCIDeviceHasDriverOverride(pci))
+                detachParallel = false;
         } else {
             char *driverPath;
             char *driverName;
@@ -607,6 +635,86 @@ virHostdevPreparePCIDevices(virHostdevManagerPtr mgr,
         }
     }
 
+    /* Step 2b: bind the managed devices collected above to their stub
+     * driver. Each bind is a synchronous sysfs write that waits for the
+     * kernel to unbind the old driver and probe the new one, so for a
+     * guest with many VFs doing them one after the other adds up; when
+     * every device supports the driver_override interface the binds
+     * are independent of each other and are run from one thread each,
+     * with a single join barrier before the devices are marked as
+     * inactive. The older new_id interface manipulates the stub
+     * driver's dynamic ID table, which is shared between all devices
+     * with the same vendor/product pair - exactly what a VF set is -
+     * so in that case the devices are detached one at a time as
+     * before. */
+    if (detachParallel && ndetachData > 1) {
+        for (i = 0; i < ndetachData; i++) {
+            virPCIDevicePtr pci = detachData[i].pci;
+
+            /* virPCIDeviceDetach() would perform this check itself if
+             * we passed it the device lists */
+            if (virPCIDeviceListFind(mgr->activePCIHostdevs, pci)) {
+                virReportError(VIR_ERR_INTERNAL_ERROR,
+                               _("Not detaching active device %s"),
+                               virPCIDeviceGetName(pci));
+                goto reattachdevs;
+            }
+        }
+
+        for (i = 0; i < ndetachData; i++) {
+            VIR_DEBUG("Detaching managed PCI device %s",
+                      virPCIDeviceGetName(detachData[i].pci));
+            if (virThreadCreate(&detachData[i].thread, true,
+                                virHostdevPCIDetachThread,
+                                &detachData[i]) < 0) {
+                /* couldn't spawn a thread; do the work right here */
+                virHostdevPCIDetachThread(&detachData[i]);
+            } else {
+                detachData[i].threaded = true;
+            }
+        }
+
+        for (i = 0; i < ndetachData; i++) {
+            if (detachData[i].threaded)
+                virThreadJoin(&detachData[i].thread);
+        }
+
+        /* Devices that were bound successfully are added to the
+         * inactive list even if another device failed, so that the
+         * rollback below can reattach them */
+        for (i = 0; i < ndetachData; i++) {
+            virPCIDevicePtr pci = detachData[i].pci;
+
+            if (detachData[i].ret < 0)
+                continue;
+
+            if (!virPCIDeviceListFind(mgr->inactivePCIHostdevs, pci)) {
+                VIR_DEBUG("Adding PCI device %s to inactive list",
+                          virPCIDeviceGetName(pci));
+                if (virPCIDeviceListAddCopy(mgr->inactivePCIHostdevs,
+                                            pci) < 0)
+                    goto reattachdevs;
+            }
+        }
+
+        for (i = 0; i < ndetachData; i++) {
+            if (detachData[i].ret < 0) {
+                if (detachData[i].err)
+                    virSetError(detachData[i].err);
+                goto reattachdevs;
+            }
+        }
+    } else {
+        for (i = 0; i < ndetachData; i++) {
+            VIR_DEBUG("Detaching managed PCI device %s",
+                      virPCIDeviceGetName(detachData[i].pci));
+            if (virPCIDeviceDetach(detachData[i].pci,
+                                   mgr->activePCIHostdevs,
+                                   mgr->inactivePCIHostdevs) < 0)
+                goto reattachdevs;
+        }
+    }
+
     /* At this point, all devices are attached to the stub driver and have
      * been marked as inactive */
 
@@ -754,6 +862,9 @@ virHostdevPreparePCIDevices(virHostdevManagerPtr mgr,
     }
 
  cleanup:
+    for (i = 0; i < ndetachData; i++)
+        virFreeError(detachData[i].err);
+    VIR_FREE(detachData);
     virObjectUnref(pcidevs);
     virObjectUnlock(mgr->activePCIHostdevs);
     virObjectUnlock(mgr->inactivePCIHostdevs);
@@ -59,11 +59,13 @@ struct _virJSONObjectPair {
 
 struct _virJSONObject {
     size_t npairs;
+    size_t npairsAlloc;
     virJSONObjectPairPtr pairs;
 };
 
 struct _virJSONArray {
     size_t nvalues;
+    size_t nvaluesAlloc;
     virJSONValuePtr *values;
 };
 
@@ -25,12 +25,19 @@
 #include "virlease.h"
 
 #include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#if HAVE_MMAP
+# include <sys/mman.h>
+#endif
 
 #include "virfile.h"
 #include "virstring.h"
 #include "virerror.h"
 #include "viralloc.h"
 #include "virutil.h"
+#include "virsocketaddr.h"
 
 #define VIR_FROM_THIS VIR_FROM_NETWORK
 
@@ -295,3 +302,273 @@ virLeaseNew(virJSONValuePtr *lease_ret,
     virJSONValueFree(lease_new);
     return ret;
 }
+
+
+static int
+virLeaseIndexRecordCompare(const void *a,
+                           const void *b)
+{
+    const virLeaseIndexRecord *reca = a;
+    const virLeaseIndexRecord *recb = b;
+
+    return strcmp(reca->name, recb->name);
+}
+
+
+/* Fetch the generation counter of an existing index, so that a
+ * rewrite can bump it. A missing or unrecognized index counts as
+ * generation zero. */
+static uint64_t
+virLeaseIndexGeneration(const char *path)
+{
+    virLeaseIndexHeader hdr;
+    uint64_t generation = 0;
+    int fd;
+
+    if ((fd = open(path, O_RDONLY)) < 0)
+        return 0;
+
+    if (saferead(fd, &hdr, sizeof(hdr)) == sizeof(hdr) &&
+        hdr.magic == VIR_LEASE_INDEX_MAGIC &&
+        hdr.version == VIR_LEASE_INDEX_VERSION)
+        generation = hdr.generation;
+
+    VIR_FORCE_CLOSE(fd);
+    return generation;
+}
+
+
+struct virLeaseIndexRewriteData {
+    virLeaseIndexHeader hdr;
+    virLeaseIndexRecordPtr records;
+};
+
+static int
+virLeaseIndexRewriteFile(int fd, void *opaque)
+{
+    struct virLeaseIndexRewriteData *data = opaque;
+
+    if (safewrite(fd, &data->hdr, sizeof(data->hdr)) < 0)
+        return -1;
+
+    if (data->hdr.nrecords &&
+        safewrite(fd, data->records,
+                  data->hdr.nrecords * sizeof(*data->records)) < 0)
+        return -1;
+
+    return 0;
+}
+
+
+/**
+ * virLeaseIndexSave:
+ * @custom_lease_file: path of the JSON lease file the index belongs to
+ * @leases_array: array of leases to index
+ *
+ * Rebuild the binary hostname index next to @custom_lease_file. The
+ * index is written to a temporary file and renamed into place, so
+ * readers either see the old or the new version, never a torn one.
+ * On any failure a previously existing index is removed instead,
+ * since a stale index would be worse than none at all.
+ *
+ * Returns 0 on success, -1 on error
+ */
+int
+virLeaseIndexSave(const char *custom_lease_file,
+                  virJSONValuePtr leases_array)
+{
+    struct virLeaseIndexRewriteData data = {
+        .hdr = {
+            .magic = VIR_LEASE_INDEX_MAGIC,
+            .version = VIR_LEASE_INDEX_VERSION,
+        },
+    };
+    virLeaseIndexRecordPtr records = NULL;
+    size_t nrecords = 0;
+    char *path = NULL;
+    size_t i;
+    int ret = -1;
+
+    if (virAsprintf(&path, "%s%s",
+                    custom_lease_file, VIR_LEASE_INDEX_SUFFIX) < 0)
+        return -1;
+
+    for (i = 0; i < virJSONValueArraySize(leases_array); i++) {
+        virJSONValuePtr lease = virJSONValueArrayGet(leases_array, i);
+        const char *hostname;
+        const char *ip;
+        long long expirytime;
+        virSocketAddr sa;
+        virLeaseIndexRecordPtr rec;
+        int family;
+
+        /* Leases without a hostname can never match a lookup */
+        if (!lease ||
+            !(hostname = virJSONValueObjectGetString(lease, "hostname")))
+            continue;
+
+        /* A name too long for a record would make lookups for it
+         * miss; give up on the whole index rather than lie */
+        if (strlen(hostname) >= VIR_LEASE_INDEX_NAME_MAX)
+            goto cleanup;
+
+        if (!(ip = virJSONValueObjectGetString(lease, "ip-address")) ||
+            virJSONValueObjectGetNumberLong(lease, "expiry-time",
+                                            &expirytime) < 0) {
+            virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                           _("failed to parse json"));
+            goto cleanup;
+        }
+
+        if (virSocketAddrParse(&sa, ip, AF_UNSPEC) < 0)
+            goto cleanup;
+
+        if (VIR_REALLOC_N(records, nrecords + 1) < 0)
+            goto cleanup;
+
+        family = VIR_SOCKET_ADDR_FAMILY(&sa);
+        rec = &records[nrecords++];
+        memset(rec, 0, sizeof(*rec));
+        memcpy(rec->name, hostname, strlen(hostname) + 1);
+        rec->expirytime = expirytime;
+        rec->family = family;
+        memcpy(rec->addr,
+               (family == AF_INET ?
+                (void *) &sa.data.inet4.sin_addr.s_addr :
+                (void *) &sa.data.inet6.sin6_addr.s6_addr),
+               family == AF_INET ? 4 : 16);
+    }
+
+    if (nrecords)
+        qsort(records, nrecords, sizeof(*records), virLeaseIndexRecordCompare);
+
+    data.hdr.generation = virLeaseIndexGeneration(path) + 1;
+    data.hdr.nrecords = nrecords;
+    data.records = records;
+
+    if (virFileRewrite(path, 0644, virLeaseIndexRewriteFile, &data) < 0)
+        goto cleanup;
+
+    ret = 0;
+
+ cleanup:
+    if (ret < 0)
+        unlink(path);
+    VIR_FREE(records);
+    VIR_FREE(path);
+    return ret;
+}
+
+
+#if HAVE_MMAP
+/**
+ * virLeaseIndexLookup:
+ * @custom_lease_file: path of the JSON lease file the index belongs to
+ * @name: hostname to look up
+ * @records: filled with copies of all records matching @name
+ * @nrecords: number of elements in @records
+ *
+ * Binary search the index next to @custom_lease_file for @name. All
+ * matching records are returned regardless of expiry time or address
+ * family; filtering is left to the caller. This function never
+ * raises an error since it may run inside the NSS plugin.
+ *
+ * Returns 0 on success (with @nrecords possibly zero),
+ *        -1 if there is no usable index and the caller must fall
+ *           back to parsing the JSON file
+ */
+int
+virLeaseIndexLookup(const char *custom_lease_file,
+                    const char *name,
+                    virLeaseIndexRecordPtr *records,
+                    size_t *nrecords)
+{
+    const virLeaseIndexHeader *hdr;
+    const virLeaseIndexRecord *recs;
+    struct stat stidx, stlease;
+    void *map = MAP_FAILED;
+    size_t maplen = 0;
+    size_t lo, hi, nmatch;
+    char *path = NULL;
+    int fd = -1;
+    int ret = -1;
+
+    *records = NULL;
+    *nrecords = 0;
+
+    if (virAsprintfQuiet(&path, "%s%s",
+                         custom_lease_file, VIR_LEASE_INDEX_SUFFIX) < 0)
+        return -1;
+
+    if ((fd = open(path, O_RDONLY)) < 0)
+        goto cleanup;
+
+    /* The index is rewritten after the lease file; one which is
+     * older than the lease file is left over from a failed rewrite
+     * and must not be trusted */
+    if (fstat(fd, &stidx) < 0 ||
+        stat(custom_lease_file, &stlease) < 0 ||
+        stidx.st_mtime < stlease.st_mtime)
+        goto cleanup;
+
+    maplen = stidx.st_size;
+    if (maplen < sizeof(*hdr))
+        goto cleanup;
+
+    if ((map = mmap(NULL, maplen, PROT_READ, MAP_SHARED, fd, 0)) == MAP_FAILED)
+        goto cleanup;
+
+    hdr = map;
+    if (hdr->magic != VIR_LEASE_INDEX_MAGIC ||
+        hdr->version != VIR_LEASE_INDEX_VERSION ||
+        hdr->nrecords > (maplen - sizeof(*hdr)) / sizeof(*recs))
+        goto cleanup;
+
+    recs = (const virLeaseIndexRecord *)((const char *) map + sizeof(*hdr));
+
+    /* Find the first record with a name not less than @name */
+    lo = 0;
+    hi = hdr->nrecords;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if (strcmp(recs[mid].name, name) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    nmatch = 0;
+    while (lo + nmatch < hdr->nrecords &&
+           STREQ(recs[lo + nmatch].name, name))
+        nmatch++;
+
+    if (nmatch) {
+        if (VIR_ALLOC_N_QUIET(*records, nmatch) < 0)
+            goto cleanup;
+        memcpy(*records, &recs[lo], nmatch * sizeof(**records));
+    }
+
+    *nrecords = nmatch;
+    ret = 0;
+
+ cleanup:
+    if (map != MAP_FAILED)
+        munmap(map, maplen);
+    VIR_FORCE_CLOSE(fd);
+    VIR_FREE(path);
+    return ret;
+}
+#else /* !HAVE_MMAP */
+int
+virLeaseIndexLookup(const char *custom_lease_file ATTRIBUTE_UNUSED,
+                    const char *name ATTRIBUTE_UNUSED,
+                    virLeaseIndexRecordPtr *records,
+                    size_t *nrecords)
+{
+    /* Without mmap callers simply keep parsing the JSON file */
+    *records = NULL;
+    *nrecords = 0;
+    return -1;
+}
+#endif /* !HAVE_MMAP */
@@ -41,4 +41,46 @@ int virLeaseNew(virJSONValuePtr *lease_ret,
                 const char *hostname,
                 const char *iaid,
                 const char *server_duid);
+
+/*
+ * Compact binary index over a custom lease file, stored next to the
+ * JSON file with the VIR_LEASE_INDEX_SUFFIX appended to its name.
+ * The index is rewritten atomically by leaseshelper whenever the
+ * lease file changes and holds fixed size records sorted by
+ * hostname, so that readers (the NSS plugin in particular) can
+ * binary search it without parsing any JSON.
+ */
+# define VIR_LEASE_INDEX_SUFFIX ".idx"
+# define VIR_LEASE_INDEX_MAGIC 0x766c6978 /* "vlix" */
+# define VIR_LEASE_INDEX_VERSION 1
+# define VIR_LEASE_INDEX_NAME_MAX 256
+# define VIR_LEASE_INDEX_ADDR_MAX 16
+
+typedef struct _virLeaseIndexHeader virLeaseIndexHeader;
+typedef virLeaseIndexHeader *virLeaseIndexHeaderPtr;
+struct _virLeaseIndexHeader {
+    uint32_t magic;             /* VIR_LEASE_INDEX_MAGIC */
+    uint32_t version;           /* VIR_LEASE_INDEX_VERSION */
+    uint64_t generation;        /* bumped on every rewrite */
+    uint64_t nrecords;          /* number of records after the header */
+};
+
+typedef struct _virLeaseIndexRecord virLeaseIndexRecord;
+typedef virLeaseIndexRecord *virLeaseIndexRecordPtr;
+struct _virLeaseIndexRecord {
+    char name[VIR_LEASE_INDEX_NAME_MAX]; /* NUL terminated hostname */
+    long long expirytime;
+    int32_t family;             /* AF_INET or AF_INET6 */
+    unsigned char addr[VIR_LEASE_INDEX_ADDR_MAX]; /* network order,
+                                                     4 or 16 bytes used */
+    unsigned char pad[4];       /* keep the on-disk record size fixed */
+};
+
+int virLeaseIndexSave(const char *custom_lease_file,
+                      virJSONValuePtr leases_array);
+
+int virLeaseIndexLookup(const char *custom_lease_file,
+                        const char *name,
+                        virLeaseIndexRecordPtr *records,
+                        size_t *nrecords);
 #endif /* __VIR_LEASE_H */
@@ -28,6 +28,7 @@
 #include "virutil.h"
 #include "virfile.h"
 #include "virhash.h"
+#include "virhashcode.h"
 #include "virthread.h"
 #include "virstring.h"
 
@@ -41,6 +42,13 @@ VIR_LOG_INIT("util.lockspace");
 
 #define VIR_LOCKSPACE_TABLE_SIZE 10
 
+/* The resource table is split into shards, each with its own mutex,
+ * hashed on the resource name. Acquiring a resource holds its shard's
+ * lock across the open+fcntl of the lock file, so spreading resources
+ * over shards lets unrelated acquisitions proceed in parallel instead
+ * of serializing on one lockspace-wide mutex. */
+#define VIR_LOCKSPACE_NSHARDS 8
+
 typedef struct _virLockSpaceResource virLockSpaceResource;
 typedef virLockSpaceResource *virLockSpaceResourcePtr;
 
@@ -54,13 +62,31 @@ struct _virLockSpaceResource {
     pid_t *owners;
 };
 
-struct _virLockSpace {
-    char *dir;
+typedef struct _virLockSpaceShard virLockSpaceShard;
+typedef virLockSpaceShard *virLockSpaceShardPtr;
+
+struct _virLockSpaceShard {
     virMutex lock;
 
     virHashTablePtr resources;
 };
 
+struct _virLockSpace {
+    char *dir;
+
+    virLockSpaceShard shards[VIR_LOCKSPACE_NSHARDS];
+};
+
+
+static virLockSpaceShardPtr
+virLockSpaceGetShard(virLockSpacePtr lockspace,
+                     const char *resname)
+{
+    uint32_t code = virHashCodeGen(resname, strlen(resname), 0);
+
+    return &lockspace->shards[code % VIR_LOCKSPACE_NSHARDS];
+}
+
 
 static char *virLockSpaceGetResourcePath(virLockSpacePtr lockspace,
                                          const char *resname)
@@ -239,6 +265,38 @@ static void virLockSpaceResourceDataFree(void *opaque, const void *name ATTRIBUT
 }
 
 
+/* Either initializes every shard mutex and resource table, or unwinds
+ * completely so the caller can simply VIR_FREE the lockspace */
+static int virLockSpaceInitShards(virLockSpacePtr lockspace)
+{
+    size_t i, j;
+
+    for (i = 0; i < VIR_LOCKSPACE_NSHARDS; i++) {
+        if (virMutexInit(&lockspace->shards[i].lock) < 0) {
+            virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                           _("Unable to initialize lockspace mutex"));
+            while (i--)
+                virMutexDestroy(&lockspace->shards[i].lock);
+            return -1;
+        }
+    }
+
+    for (i = 0; i < VIR_LOCKSPACE_NSHARDS; i++) {
+        if (!(lockspace->shards[i].resources =
+              virHashCreate(VIR_LOCKSPACE_TABLE_SIZE,
+                            virLockSpaceResourceDataFree))) {
+            for (j = 0; j < VIR_LOCKSPACE_NSHARDS; j++) {
+                virHashFree(lockspace->shards[j].resources);
+                virMutexDestroy(&lockspace->shards[j].lock);
+            }
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+
 virLockSpacePtr virLockSpaceNew(const char *directory)
 {
     virLockSpacePtr lockspace;
@@ -248,9 +306,7 @@ virLockSpacePtr virLockSpaceNew(const char *directory)
     if (VIR_ALLOC(lockspace) < 0)
         return NULL;
 
-    if (virMutexInit(&lockspace->lock) < 0) {
-        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
-                       _("Unable to initialize lockspace mutex"));
+    if (virLockSpaceInitShards(lockspace) < 0) {
         VIR_FREE(lockspace);
         return NULL;
     }
@@ -258,10 +314,6 @@ virLockSpacePtr virLockSpaceNew(const char *directory)
     if (VIR_STRDUP(lockspace->dir, directory) < 0)
         goto error;
 
-    if (!(lockspace->resources = virHashCreate(VIR_LOCKSPACE_TABLE_SIZE,
-                                               virLockSpaceResourceDataFree)))
-        goto error;
-
     if (directory) {
         if (virFileExists(directory)) {
             if (!virFileIsDir(directory)) {
@@ -301,17 +353,11 @@ virLockSpacePtr virLockSpaceNewPostExecRestart(virJSONValuePtr object)
     if (VIR_ALLOC(lockspace) < 0)
         return NULL;
 
-    if (virMutexInit(&lockspace->lock) < 0) {
-        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
-                       _("Unable to initialize lockspace mutex"));
+    if (virLockSpaceInitShards(lockspace) < 0) {
         VIR_FREE(lockspace);
         return NULL;
     }
 
-    if (!(lockspace->resources = virHashCreate(VIR_LOCKSPACE_TABLE_SIZE,
-                                               virLockSpaceResourceDataFree)))
-        goto error;
-
     if (virJSONValueObjectHasKey(object, "directory")) {
         const char *dir = virJSONValueObjectGetString(object, "directory");
         if (VIR_STRDUP(lockspace->dir, dir) < 0)
@@ -423,7 +469,8 @@ virLockSpacePtr virLockSpaceNewPostExecRestart(virJSONValuePtr object)
             res->owners[j] = (pid_t)owner;
         }
 
-        if (virHashAddEntry(lockspace->resources, res->name, res) < 0) {
+        if (virHashAddEntry(virLockSpaceGetShard(lockspace, res->name)->resources,
+                            res->name, res) < 0) {
             virLockSpaceResourceFree(res);
             goto error;
         }
@@ -442,11 +489,15 @@ virJSONValuePtr virLockSpacePreExecRestart(virLockSpacePtr lockspace)
     virJSONValuePtr object = virJSONValueNewObject();
     virJSONValuePtr resources;
     virHashKeyValuePairPtr pairs = NULL, tmp;
+    size_t shard;
 
     if (!object)
         return NULL;
 
-    virMutexLock(&lockspace->lock);
+    /* Lock all shards so the serialized state is one consistent
+     * snapshot of the whole lockspace */
+    for (shard = 0; shard < VIR_LOCKSPACE_NSHARDS; shard++)
+        virMutexLock(&lockspace->shards[shard].lock);
 
     if (lockspace->dir &&
         virJSONValueObjectAppendString(object, "directory", lockspace->dir) < 0)
@@ -460,76 +511,84 @@ virJSONValuePtr virLockSpacePreExecRestart(virLockSpacePtr lockspace)
         goto error;
     }
 
-    tmp = pairs = virHashGetItems(lockspace->resources, NULL);
-    while (tmp && tmp->value) {
-        virLockSpaceResourcePtr res = (virLockSpaceResourcePtr)tmp->value;
-        virJSONValuePtr child = virJSONValueNewObject();
-        virJSONValuePtr owners = NULL;
-        size_t i;
+    for (shard = 0; shard < VIR_LOCKSPACE_NSHARDS; shard++) {
+        tmp = pairs = virHashGetItems(lockspace->shards[shard].resources, NULL);
+        while (tmp && tmp->value) {
+            virLockSpaceResourcePtr res = (virLockSpaceResourcePtr)tmp->value;
+            virJSONValuePtr child = virJSONValueNewObject();
+            virJSONValuePtr owners = NULL;
+            size_t i;
 
-        if (!child)
-            goto error;
-
-        if (virJSONValueArrayAppend(resources, child) < 0) {
-            virJSONValueFree(child);
-            goto error;
-        }
-
-        if (virJSONValueObjectAppendString(child, "name", res->name) < 0 ||
-            virJSONValueObjectAppendString(child, "path", res->path) < 0 ||
-            virJSONValueObjectAppendNumberInt(child, "fd", res->fd) < 0 ||
-            virJSONValueObjectAppendBoolean(child, "lockHeld", res->lockHeld) < 0 ||
-            virJSONValueObjectAppendNumberUint(child, "flags", res->flags) < 0)
-            goto error;
+            if (!child)
+                goto error;
 
-        if (virSetInherit(res->fd, true) < 0) {
-            virReportSystemError(errno, "%s",
-                                 _("Cannot disable close-on-exec flag"));
-            goto error;
-        }
+            if (virJSONValueArrayAppend(resources, child) < 0) {
+                virJSONValueFree(child);
+                goto error;
+            }
 
-        if (!(owners = virJSONValueNewArray()))
-            goto error;
+            if (virJSONValueObjectAppendString(child, "name", res->name) < 0 ||
+                virJSONValueObjectAppendString(child, "path", res->path) < 0 ||
+                virJSONValueObjectAppendNumberInt(child, "fd", res->fd) < 0 ||
+                virJSONValueObjectAppendBoolean(child, "lockHeld", res->lockHeld) < 0 ||
+                virJSONValueObjectAppendNumberUint(child, "flags", res->flags) < 0)
+                goto error;
 
-        if (virJSONValueObjectAppend(child, "owners", owners) < 0) {
-            virJSONValueFree(owners);
-            goto error;
-        }
+            if (virSetInherit(res->fd, true) < 0) {
+                virReportSystemError(errno, "%s",
+                                     _("Cannot disable close-on-exec flag"));
+                goto error;
+            }
 
-        for (i = 0; i < res->nOwners; i++) {
-            virJSONValuePtr owner = virJSONValueNewNumberUlong(res->owners[i]);
-            if (!owner)
+            if (!(owners = virJSONValueNewArray()))
                 goto error;
 
-            if (virJSONValueArrayAppend(owners, owner) < 0) {
-                virJSONValueFree(owner);
+            if (virJSONValueObjectAppend(child, "owners", owners) < 0) {
+                virJSONValueFree(owners);
                 goto error;
             }
-        }
 
-        tmp++;
+            for (i = 0; i < res->nOwners; i++) {
+                virJSONValuePtr owner = virJSONValueNewNumberUlong(res->owners[i]);
+                if (!owner)
+                    goto error;
+
+                if (virJSONValueArrayAppend(owners, owner) < 0) {
+                    virJSONValueFree(owner);
+                    goto error;
+                }
+            }
+
+            tmp++;
+        }
+        VIR_FREE(pairs);
     }
-    VIR_FREE(pairs);
 
-    virMutexUnlock(&lockspace->lock);
+    for (shard = 0; shard < VIR_LOCKSPACE_NSHARDS; shard++)
+        virMutexUnlock(&lockspace->shards[shard].lock);
     return object;
 
  error:
     VIR_FREE(pairs);
     virJSONValueFree(object);
-    virMutexUnlock(&lockspace->lock);
+    for (shard = 0; shard < VIR_LOCKSPACE_NSHARDS; shard++)
+        virMutexUnlock(&lockspace->shards[shard].lock);
     return NULL;
 }
 
 
 void virLockSpaceFree(virLockSpacePtr lockspace)
 {
+    size_t i;
+
     if (!lockspace)
         return;
 
-    virHashFree(lockspace->resources);
+    for (i = 0; i < VIR_LOCKSPACE_NSHARDS; i++) {
+        virHashFree(lockspace->shards[i].resources);
+        virMutexDestroy(&lockspace->shards[i].lock);
+    }
     VIR_FREE(lockspace->dir);
-    virMutexDestroy(&lockspace->lock);
     VIR_FREE(lockspace);
 }
 
@@ -543,14 +602,15 @@ const char *virLockSpaceGetDirectory(virLockSpacePtr lockspace)
 int virLockSpaceCreateResource(virLockSpacePtr lockspace,
                                const char *resname)
 {
+    virLockSpaceShardPtr shard = virLockSpaceGetShard(lockspace, resname);
     int ret = -1;
     char *respath = NULL;
 
     VIR_DEBUG("lockspace=%p resname=%s", lockspace, resname);
 
-    virMutexLock(&lockspace->lock);
+    virMutexLock(&shard->lock);
 
-    if (virHashLookup(lockspace->resources, resname) != NULL) {
+    if (virHashLookup(shard->resources, resname) != NULL) {
         virReportError(VIR_ERR_RESOURCE_BUSY,
                        _("Lockspace resource '%s' is locked"),
                        resname);
@@ -566,7 +626,7 @@ int virLockSpaceCreateResource(virLockSpacePtr lockspace,
     ret = 0;
 
  cleanup:
-    virMutexUnlock(&lockspace->lock);
+    virMutexUnlock(&shard->lock);
     VIR_FREE(respath);
     return ret;
 }
@@ -575,14 +635,15 @@ int virLockSpaceCreateResource(virLockSpacePtr lockspace,
 int virLockSpaceDeleteResource(virLockSpacePtr lockspace,
                                const char *resname)
 {
+    virLockSpaceShardPtr shard = virLockSpaceGetShard(lockspace, resname);
     int ret = -1;
     char *respath = NULL;
 
     VIR_DEBUG("lockspace=%p resname=%s", lockspace, resname);
 
-    virMutexLock(&lockspace->lock);
+    virMutexLock(&shard->lock);
 
-    if (virHashLookup(lockspace->resources, resname) != NULL) {
+    if (virHashLookup(shard->resources, resname) != NULL) {
         virReportError(VIR_ERR_RESOURCE_BUSY,
                        _("Lockspace resource '%s' is locked"),
                        resname);
@@ -603,7 +664,7 @@ int virLockSpaceDeleteResource(virLockSpacePtr lockspace,
     ret = 0;
 
  cleanup:
-    virMutexUnlock(&lockspace->lock);
+    virMutexUnlock(&shard->lock);
     VIR_FREE(respath);
     return ret;
 }
@@ -614,6 +675,7 @@ int virLockSpaceAcquireResource(virLockSpacePtr lockspace,
                                 pid_t owner,
                                 unsigned int flags)
 {
+    virLockSpaceShardPtr shard = virLockSpaceGetShard(lockspace, resname);
     int ret = -1;
     virLockSpaceResourcePtr res;
 
@@ -623,9 +685,9 @@ int virLockSpaceAcquireResource(virLockSpacePtr lockspace,
     virCheckFlags(VIR_LOCK_SPACE_ACQUIRE_SHARED |
                   VIR_LOCK_SPACE_ACQUIRE_AUTOCREATE, -1);
 
-    virMutexLock(&lockspace->lock);
+    virMutexLock(&shard->lock);
 
-    if ((res = virHashLookup(lockspace->resources, resname))) {
+    if ((res = virHashLookup(shard->resources, resname))) {
         if ((res->flags & VIR_LOCK_SPACE_ACQUIRE_SHARED) &&
             (flags & VIR_LOCK_SPACE_ACQUIRE_SHARED)) {
 
@@ -644,7 +706,7 @@ int virLockSpaceAcquireResource(virLockSpacePtr lockspace,
     if (!(res = virLockSpaceResourceNew(lockspace, resname, flags, owner)))
         goto cleanup;
 
-    if (virHashAddEntry(lockspace->resources, resname, res) < 0) {
+    if (virHashAddEntry(shard->resources, resname, res) < 0) {
         virLockSpaceResourceFree(res);
         goto cleanup;
     }
@@ -653,7 +715,7 @@ int virLockSpaceAcquireResource(virLockSpacePtr lockspace,
     ret = 0;
 
  cleanup:
-    virMutexUnlock(&lockspace->lock);
+    virMutexUnlock(&shard->lock);
     return ret;
 }
 
@@ -662,6 +724,7 @@ int virLockSpaceReleaseResource(virLockSpacePtr lockspace,
                                 const char *resname,
                                 pid_t owner)
 {
+    virLockSpaceShardPtr shard = virLockSpaceGetShard(lockspace, resname);
     int ret = -1;
     virLockSpaceResourcePtr res;
     size_t i;
@@ -669,9 +732,9 @@ int virLockSpaceReleaseResource(virLockSpacePtr lockspace,
     VIR_DEBUG("lockspace=%p resname=%s owner=%lld",
               lockspace, resname, (unsigned long long)owner);
 
-    virMutexLock(&lockspace->lock);
+    virMutexLock(&shard->lock);
 
-    if (!(res = virHashLookup(lockspace->resources, resname))) {
+    if (!(res = virHashLookup(shard->resources, resname))) {
         virReportError(VIR_ERR_RESOURCE_BUSY,
                        _("Lockspace resource '%s' is not locked"),
                        resname);
@@ -693,13 +756,13 @@ int virLockSpaceReleaseResource(virLockSpacePtr lockspace,
     VIR_DELETE_ELEMENT(res->owners, i, res->nOwners);
 
     if ((res->nOwners == 0) &&
-        virHashRemoveEntry(lockspace->resources, resname) < 0)
+        virHashRemoveEntry(shard->resources, resname) < 0)
         goto cleanup;
 
     ret = 0;
 
  cleanup:
-    virMutexUnlock(&lockspace->lock);
+    virMutexUnlock(&shard->lock);
     return ret;
 }
 
@@ -747,25 +810,27 @@ int virLockSpaceReleaseResourcesForOwner(virLockSpacePtr lockspace,
                                          pid_t owner)
 {
     int ret = 0;
+    size_t shard;
     struct virLockSpaceRemoveData data = {
         owner, 0
     };
 
     VIR_DEBUG("lockspace=%p owner=%lld", lockspace, (unsigned long long)owner);
 
-    virMutexLock(&lockspace->lock);
+    for (shard = 0; shard < VIR_LOCKSPACE_NSHARDS; shard++) {
+        virMutexLock(&lockspace->shards[shard].lock);
 
-    if (virHashRemoveSet(lockspace->resources,
-                         virLockSpaceRemoveResourcesForOwner,
-                         &data) < 0)
-        goto error;
+        if (virHashRemoveSet(lockspace->shards[shard].resources,
+                             virLockSpaceRemoveResourcesForOwner,
+                             &data) < 0) {
+            virMutexUnlock(&lockspace->shards[shard].lock);
+            return -1;
+        }
+
+        virMutexUnlock(&lockspace->shards[shard].lock);
+    }
 
     ret = data.count;
 
-    virMutexUnlock(&lockspace->lock);
     return ret;
-
- error:
-    virMutexUnlock(&lockspace->lock);
-    return -1;
 }
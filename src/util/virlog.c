@@ -129,21 +129,30 @@ static void virLogOutputToFd(virLogSourcePtr src,
 
 
 /*
- * Logs accesses must be serialized though a mutex
+ * Changes to the filter and output lists must be serialized though
+ * an exclusive lock; message emission only needs to keep the lists
+ * stable, so concurrent emitters can share the lock
  */
-virMutex virLogMutex;
+static virRWLock virLogDataLock;
 
 void
 virLogLock(void)
 {
-    virMutexLock(&virLogMutex);
+    virRWLockWrite(&virLogDataLock);
+}
+
+
+static void
+virLogLockRead(void)
+{
+    virRWLockRead(&virLogDataLock);
 }
 
 
 void
 virLogUnlock(void)
 {
-    virMutexUnlock(&virLogMutex);
+    virRWLockUnlock(&virLogDataLock);
 }
 
 
@@ -167,7 +176,7 @@ virLogPriorityString(virLogPriority lvl)
 static int
 virLogOnceInit(void)
 {
-    if (virMutexInit(&virLogMutex) < 0)
+    if (virRWLockInit(&virLogDataLock) < 0)
         return -1;
 
     virLogLock();
@@ -478,10 +487,12 @@ virLogVMessage(virLogSourcePtr source,
     char *str = NULL;
     char *msg = NULL;
     char timestamp[VIR_TIME_STRING_BUFLEN];
+    unsigned long long nowms;
     int ret;
     size_t i;
     int saved_errno = errno;
     unsigned int filterflags = 0;
+    bool needsFormat = false;
 
     if (virLogInitialize() < 0)
         return;
@@ -504,19 +515,49 @@ virLogVMessage(virLogSourcePtr source,
     filterflags = source->flags;
 
     /*
-     * serialize the error message, add level and timestamp
+     * serialize the error message
      */
     if (virVasprintfQuiet(&str, fmt, vargs) < 0)
         goto cleanup;
 
-    ret = virLogFormatString(&msg, linenr, funcname, priority, str);
-    if (ret < 0)
-        goto cleanup;
+    timestamp[0] = '\0';
 
-    if (virTimeStringNowRaw(timestamp) < 0)
-        timestamp[0] = '\0';
+    /*
+     * The message was serialized above, so emission only needs
+     * the output list to stay stable; a shared lock lets concurrent
+     * threads push their messages without serializing on each other.
+     * The logInitMessage flags may be read and cleared by several
+     * emitters at once, worst case result is the initial banner
+     * being written more than once.
+     */
+    virLogLockRead();
 
-    virLogLock();
+    /*
+     * Journald receives the raw string together with structured
+     * fields and builds its own timestamp, so the single line text
+     * rendering is only produced if some other output consumes it.
+     */
+    for (i = 0; i < virLogNbOutputs; i++) {
+        if (priority >= virLogOutputs[i]->priority &&
+            virLogOutputs[i]->dest != VIR_LOG_TO_JOURNALD)
+            needsFormat = true;
+    }
+    if (virLogNbOutputs == 0)
+        needsFormat = true;
+
+    if (needsFormat) {
+        ret = virLogFormatString(&msg, linenr, funcname, priority, str);
+        if (ret < 0) {
+            virLogUnlock();
+            goto cleanup;
+        }
+
+        /* the coarse clock is plenty for log timestamps and avoids
+         * a precise clock read on every single message */
+        if (virTimeMillisNowCoarseRaw(&nowms) < 0 ||
+            virTimeStringThenRaw(nowms, timestamp) < 0)
+            timestamp[0] = '\0';
+    }
 
     /*
      * Push the message to the outputs defined, if none exist then
@@ -29,9 +29,11 @@
 #include "virerror.h"
 #include "vircommand.h"
 #include "viralloc.h"
+#include "virhash.h"
 #include "virpci.h"
 #include "virlog.h"
 #include "virstring.h"
+#include "virthread.h"
 #include "virutil.h"
 
 #include <sys/ioctl.h>
@@ -1859,6 +1861,184 @@ VIR_ENUM_IMPL(virNetDevFeature,
               "rdma",
               "txudptnl")
 
+#if defined(__linux__) && defined(HAVE_LIBNL)
+
+/*
+ * Cache of link state per interface, answered out of memory so that
+ * repeated virNetDevGetLinkInfo() calls don't re-read sysfs for
+ * every query. Entries are dropped whenever the kernel broadcasts an
+ * RTM_NEWLINK/RTM_DELLINK event for the interface, which requires
+ * the NETLINK_ROUTE event service to have joined RTNLGRP_LINK. The
+ * generation counter is bumped on every such event; a sysfs read
+ * started before an event is only cached if the generation is still
+ * the same afterwards, so a concurrent link change can never leave a
+ * stale entry behind.
+ */
+typedef struct _virNetDevLinkCacheEntry virNetDevLinkCacheEntry;
+typedef virNetDevLinkCacheEntry *virNetDevLinkCacheEntryPtr;
+struct _virNetDevLinkCacheEntry {
+    virNetDevIfLink lnk;
+};
+
+static virMutex virNetDevLinkCacheLock = VIR_MUTEX_INITIALIZER;
+static virHashTablePtr virNetDevLinkCache;
+static unsigned long long virNetDevLinkCacheGeneration;
+static bool virNetDevLinkCacheBroken;
+
+static void
+virNetDevLinkCacheDataFree(void *payload,
+                           const void *name ATTRIBUTE_UNUSED)
+{
+    VIR_FREE(payload);
+}
+
+
+static void
+virNetDevLinkCacheCallback(struct nlmsghdr *msg,
+                           unsigned int length ATTRIBUTE_UNUSED,
+                           struct sockaddr_nl *peer ATTRIBUTE_UNUSED,
+                           bool *handled,
+                           void *opaque ATTRIBUTE_UNUSED)
+{
+    struct nlattr *tb[IFLA_MAX + 1];
+    const char *ifname;
+
+    if (msg->nlmsg_type != RTM_NEWLINK &&
+        msg->nlmsg_type != RTM_DELLINK)
+        return;
+
+    if (nlmsg_parse(msg, sizeof(struct ifinfomsg), tb, IFLA_MAX, NULL) < 0 ||
+        !tb[IFLA_IFNAME])
+        return;
+
+    ifname = nla_get_string(tb[IFLA_IFNAME]);
+    VIR_DEBUG("Invalidating cached link state of '%s'", ifname);
+
+    virMutexLock(&virNetDevLinkCacheLock);
+    virNetDevLinkCacheGeneration++;
+    if (virNetDevLinkCache)
+        virHashRemoveEntry(virNetDevLinkCache, ifname);
+    virMutexUnlock(&virNetDevLinkCacheLock);
+
+    *handled = true;
+}
+
+
+/* Called with virNetDevLinkCacheLock held */
+static int
+virNetDevLinkCacheInitLocked(void)
+{
+    if (virNetDevLinkCache)
+        return 0;
+
+    /* Without the event service there is nothing to invalidate
+     * entries, so the cache must stay disabled */
+    if (virNetDevLinkCacheBroken ||
+        !virNetlinkEventServiceIsRunning(NETLINK_ROUTE))
+        return -1;
+
+    if (!(virNetDevLinkCache = virHashCreate(50, virNetDevLinkCacheDataFree)))
+        goto error;
+
+    if (virNetlinkEventAddClient(virNetDevLinkCacheCallback,
+                                 NULL, NULL, NULL, NETLINK_ROUTE) < 0)
+        goto error;
+
+    return 0;
+
+ error:
+    virHashFree(virNetDevLinkCache);
+    virNetDevLinkCache = NULL;
+    virNetDevLinkCacheBroken = true;
+    return -1;
+}
+
+
+/*
+ * Returns 1 if @lnk was filled in from the cache,
+ *         0 on a cache miss, with @generation set for a later
+ *           virNetDevLinkCacheStore() of the fresh result,
+ *        -1 if the cache is unusable
+ */
+static int
+virNetDevLinkCacheLookup(const char *ifname,
+                         virNetDevIfLinkPtr lnk,
+                         unsigned long long *generation)
+{
+    virNetDevLinkCacheEntryPtr entry;
+    int ret = -1;
+
+    virMutexLock(&virNetDevLinkCacheLock);
+
+    if (virNetDevLinkCacheInitLocked() < 0)
+        goto cleanup;
+
+    if ((entry = virHashLookup(virNetDevLinkCache, ifname))) {
+        *lnk = entry->lnk;
+        ret = 1;
+        goto cleanup;
+    }
+
+    *generation = virNetDevLinkCacheGeneration;
+    ret = 0;
+
+ cleanup:
+    virMutexUnlock(&virNetDevLinkCacheLock);
+    return ret;
+}
+
+
+static void
+virNetDevLinkCacheStore(const char *ifname,
+                        const virNetDevIfLink *lnk,
+                        unsigned long long generation)
+{
+    virNetDevLinkCacheEntryPtr entry = NULL;
+
+    virMutexLock(&virNetDevLinkCacheLock);
+
+    /* The link may have changed while sysfs was being read; trust
+     * the result only if no event arrived in between */
+    if (!virNetDevLinkCache ||
+        generation != virNetDevLinkCacheGeneration)
+        goto cleanup;
+
+    if (VIR_ALLOC_QUIET(entry) < 0)
+        goto cleanup;
+
+    entry->lnk = *lnk;
+
+    /* Losing the entry merely costs a future sysfs re-read */
+    if (virHashUpdateEntry(virNetDevLinkCache, ifname, entry) < 0)
+        goto cleanup;
+
+    entry = NULL;
+
+ cleanup:
+    VIR_FREE(entry);
+    virMutexUnlock(&virNetDevLinkCacheLock);
+}
+
+#elif defined(__linux__)
+
+static int
+virNetDevLinkCacheLookup(const char *ifname ATTRIBUTE_UNUSED,
+                         virNetDevIfLinkPtr lnk ATTRIBUTE_UNUSED,
+                         unsigned long long *generation ATTRIBUTE_UNUSED)
+{
+    return -1;
+}
+
+
+static void
+virNetDevLinkCacheStore(const char *ifname ATTRIBUTE_UNUSED,
+                        const virNetDevIfLink *lnk ATTRIBUTE_UNUSED,
+                        unsigned long long generation ATTRIBUTE_UNUSED)
+{
+}
+
+#endif /* defined(__linux__) */
+
 #ifdef __linux__
 int
 virNetDevGetLinkInfo(const char *ifname,
@@ -1870,6 +2050,11 @@ virNetDevGetLinkInfo(const char *ifname,
     char *tmp;
     int tmp_state;
     unsigned int tmp_speed;
+    unsigned long long generation = 0;
+    int cached;
+
+    if ((cached = virNetDevLinkCacheLookup(ifname, lnk, &generation)) > 0)
+        return 0;
 
     if (virNetDevSysfsFile(&path, ifname, "operstate") < 0)
         goto cleanup;
@@ -1941,6 +2126,8 @@ virNetDevGetLinkInfo(const char *ifname,
 
     ret = 0;
  cleanup:
+    if (ret == 0 && cached == 0)
+        virNetDevLinkCacheStore(ifname, lnk, generation);
     VIR_FREE(buf);
     VIR_FREE(path);
     return ret;
@@ -195,6 +195,46 @@ int virNetDevOpenvswitchRemovePort(const char *brname ATTRIBUTE_UNUSED, const ch
     return ret;
 }
 
+/**
+ * virNetDevOpenvswitchRemovePorts:
+ * @ifnames: array of network interface names
+ * @nifnames: number of elements in @ifnames
+ *
+ * Deletes several interfaces from their OVS bridges with a single
+ * ovs-vsctl invocation, so that tearing down a guest with many ports
+ * costs one fork/exec and one database transaction instead of one
+ * per port.
+ *
+ * Returns 0 in case of success or -1 in case of failure.
+ */
+int virNetDevOpenvswitchRemovePorts(char **ifnames, size_t nifnames)
+{
+    int ret = -1;
+    size_t i;
+    virCommandPtr cmd = NULL;
+
+    if (nifnames == 0)
+        return 0;
+
+    cmd = virCommandNew(OVSVSCTL);
+    virCommandAddArg(cmd, "--timeout=5");
+
+    for (i = 0; i < nifnames; i++)
+        virCommandAddArgList(cmd, "--", "--if-exists", "del-port",
+                             ifnames[i], NULL);
+
+    if (virCommandRun(cmd, NULL) < 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("Unable to delete %zu ports from OVS"), nifnames);
+        goto cleanup;
+    }
+
+    ret = 0;
+ cleanup:
+    virCommandFree(cmd);
+    return ret;
+}
+
 /**
  * virNetDevOpenvswitchGetMigrateData:
  * @migrate: a pointer to store the data into, allocated by this function
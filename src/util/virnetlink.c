@@ -99,6 +99,10 @@ static int nextWatch = 1;
  records in this multiple */
 # define NETLINK_EVENT_ALLOC_EXTENT 10
 
+/* Upper bound on messages drained per event loop pass, so that a
+ * storm of netlink events cannot starve other event handlers */
+# define NETLINK_EVENT_BATCH_MAX 256
+
 /* Linux kernel supports up to MAX_LINKS (32 at the time) individual
  * netlink protocols. */
 static virNetlinkEventSrvPrivatePtr server[MAX_LINKS] = {NULL};
@@ -619,40 +623,56 @@ virNetlinkEventCallback(int watch,
     virNetlinkEventSrvPrivatePtr srv = opaque;
     struct nlmsghdr *msg;
     struct sockaddr_nl peer;
-    struct ucred *creds = NULL;
+    struct ucred *creds;
     size_t i;
     int length;
-    bool handled = false;
+    bool handled;
+    int nmsgs = 0;
 
-    length = nl_recv(srv->netlinknh, &peer,
-                     (unsigned char **)&msg, &creds);
+    virNetlinkEventServerLock(srv);
 
-    if (length == 0)
-        return;
-    if (length < 0) {
-        virReportSystemError(errno,
-                             "%s", _("nl_recv returned with error"));
-        return;
-    }
+    /* Drain the queue in one pass rather than taking a full event
+     * loop iteration per message; interface churn (e.g. containers
+     * creating and destroying veths) can queue thousands of them.
+     * The socket is non-blocking, so the loop ends as soon as the
+     * queue is empty, and the batch is bounded to keep the other
+     * event handlers responsive - any leftover messages re-trigger
+     * the watch right away. */
+    while (nmsgs++ < NETLINK_EVENT_BATCH_MAX) {
+        creds = NULL;
+        length = nl_recv(srv->netlinknh, &peer,
+                         (unsigned char **)&msg, &creds);
+
+        if (length == 0)
+            break;
+        if (length < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                virReportSystemError(errno,
+                                     "%s", _("nl_recv returned with error"));
+            break;
+        }
 
-    virNetlinkEventServerLock(srv);
+        handled = false;
 
-    VIR_DEBUG("dispatching to max %d clients, called from event watch %d",
-            (int)srv->handlesCount, watch);
+        VIR_DEBUG("dispatching to max %d clients, called from event watch %d",
+                (int)srv->handlesCount, watch);
 
-    for (i = 0; i < srv->handlesCount; i++) {
-        if (srv->handles[i].deleted != VIR_NETLINK_HANDLE_VALID)
-            continue;
+        for (i = 0; i < srv->handlesCount; i++) {
+            if (srv->handles[i].deleted != VIR_NETLINK_HANDLE_VALID)
+                continue;
+
+            VIR_DEBUG("dispatching client %zu.", i);
 
-        VIR_DEBUG("dispatching client %zu.", i);
+            (srv->handles[i].handleCB)(msg, length, &peer, &handled,
+                                       srv->handles[i].opaque);
+        }
 
-        (srv->handles[i].handleCB)(msg, length, &peer, &handled,
-                                   srv->handles[i].opaque);
+        if (!handled)
+            VIR_DEBUG("event not handled.");
+        VIR_FREE(msg);
+        VIR_FREE(creds);
     }
 
-    if (!handled)
-        VIR_DEBUG("event not handled.");
-    VIR_FREE(msg);
     virNetlinkEventServerUnlock(srv);
 }
 
@@ -43,15 +43,106 @@
 #include "virlog.h"
 #include "viralloc.h"
 #include "virbitmap.h"
+#include "virhash.h"
 #include "virstring.h"
 #include "virfile.h"
 #include "virhostmem.h"
+#include "virthread.h"
+#include "virtime.h"
 
 #define VIR_FROM_THIS VIR_FROM_NONE
 
 VIR_LOG_INIT("util.numa");
 
 
+/**
+ * virNumaGetNativePlacementAdvice:
+ * @vcpus: number of vCPUs the domain will run
+ * @balloon: size of the domain memory in KiB
+ *
+ * Compute an advisory nodeset from the host NUMA topology without
+ * consulting numad.  Nodes are picked in descending order of currently
+ * free memory until the selected set has enough free memory for
+ * @balloon and at least as many CPUs as @vcpus, so a domain that fits
+ * in one node stays local to it while larger domains spill over to the
+ * emptiest neighbours.
+ *
+ * Returns the nodeset as a string on success, NULL with an error
+ * reported on failure.
+ */
+static char *
+virNumaGetNativePlacementAdvice(unsigned short vcpus,
+                                unsigned long long balloon)
+{
+    char *output = NULL;
+    virBitmapPtr nodeset = NULL;
+    virBitmapPtr cpus = NULL;
+    unsigned long long wantmem = balloon * 1024;
+    unsigned long long gotmem = 0;
+    size_t gotcpus = 0;
+    int maxnode;
+    int node;
+    int ncpus;
+
+    if (!virNumaIsAvailable() ||
+        (maxnode = virNumaGetMaxNode()) < 0) {
+        virReportError(VIR_ERR_CONFIG_UNSUPPORTED, "%s",
+                       _("Host NUMA topology is not available"));
+        return NULL;
+    }
+
+    if (!(nodeset = virBitmapNew(maxnode + 1)))
+        return NULL;
+
+    while (gotmem < wantmem || gotcpus < vcpus) {
+        unsigned long long bestfree = 0;
+        int best = -1;
+
+        for (node = 0; node <= maxnode; node++) {
+            unsigned long long memsize;
+            unsigned long long memfree;
+
+            if (virBitmapIsBitSet(nodeset, node) ||
+                !virNumaNodeIsAvailable(node))
+                continue;
+
+            if (virNumaGetNodeMemory(node, &memsize, &memfree) < 0)
+                continue;
+
+            if (best < 0 || memfree > bestfree) {
+                best = node;
+                bestfree = memfree;
+            }
+        }
+
+        if (best < 0) {
+            virReportError(VIR_ERR_INTERNAL_ERROR,
+                           _("Host NUMA nodes lack %llu KiB of free memory "
+                             "or %u CPUs needed for automatic placement"),
+                           balloon, vcpus);
+            goto cleanup;
+        }
+
+        /* A node unknown to libnuma (-2) simply contributes no CPUs */
+        if ((ncpus = virNumaGetNodeCPUs(best, &cpus)) == -1)
+            goto cleanup;
+
+        ignore_value(virBitmapSetBit(nodeset, best));
+        gotmem += bestfree;
+        if (ncpus > 0)
+            gotcpus += ncpus;
+        virBitmapFree(cpus);
+        cpus = NULL;
+    }
+
+    output = virBitmapFormat(nodeset);
+
+ cleanup:
+    virBitmapFree(nodeset);
+    virBitmapFree(cpus);
+    return output;
+}
+
 #if HAVE_NUMAD
 char *
 virNumaGetAutoPlacementAdvice(unsigned short vcpus,
@@ -66,22 +157,22 @@ virNumaGetAutoPlacementAdvice(unsigned short vcpus,
 
     virCommandSetOutputBuffer(cmd, &output);
 
-    if (virCommandRun(cmd, NULL) < 0)
-        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
-                       _("Failed to query numad for the "
-                         "advisory nodeset"));
+    if (virCommandRun(cmd, NULL) < 0) {
+        VIR_WARN("Failed to query numad for the advisory nodeset, "
+                 "falling back to native placement");
+        VIR_FREE(output);
+        output = virNumaGetNativePlacementAdvice(vcpus, balloon);
+    }
 
     virCommandFree(cmd);
     return output;
 }
 #else /* !HAVE_NUMAD */
 char *
-virNumaGetAutoPlacementAdvice(unsigned short vcpus ATTRIBUTE_UNUSED,
-                              unsigned long long balloon ATTRIBUTE_UNUSED)
+virNumaGetAutoPlacementAdvice(unsigned short vcpus,
+                              unsigned long long balloon)
 {
-    virReportError(VIR_ERR_CONFIG_UNSUPPORTED, "%s",
-                   _("numad is not available on this host"));
-    return NULL;
+    return virNumaGetNativePlacementAdvice(vcpus, balloon);
 }
 #endif /* !HAVE_NUMAD */
 
@@ -542,6 +633,120 @@ virNumaGetHugePageInfoDir(char **path, int node)
     }
 }
 
+/* A short lived ledger of the huge page pools. Pool sizes and free
+ * counts are re-read from sysfs only once the previous answer has
+ * expired or the pool has been resized through
+ * virNumaSetPagePoolSize(); within the timeout all queries are
+ * served from the cache. This keeps a boot storm of hugepage
+ * backed guests from contending on the very same sysfs reads while
+ * still noticing allocations made behind our back reasonably
+ * quickly. */
+
+# define VIR_NUMA_HUGE_PAGE_LEDGER_TIMEOUT 1000 /* ms */
+
+typedef struct _virNumaHugePageLedgerEntry virNumaHugePageLedgerEntry;
+typedef virNumaHugePageLedgerEntry *virNumaHugePageLedgerEntryPtr;
+struct _virNumaHugePageLedgerEntry {
+    unsigned int avail;
+    unsigned int free;
+    unsigned long long when;    /* when the entry was read, in ms */
+};
+
+static virMutex virNumaHugePageLedgerLock = VIR_MUTEX_INITIALIZER;
+static virHashTablePtr virNumaHugePageLedger;
+
+static void
+virNumaHugePageLedgerDataFree(void *payload,
+                              const void *name ATTRIBUTE_UNUSED)
+{
+    VIR_FREE(payload);
+}
+
+static char *
+virNumaHugePageLedgerKey(int node,
+                         unsigned int page_size)
+{
+    char *key;
+
+    ignore_value(virAsprintf(&key, "%d-%u", node, page_size));
+    return key;
+}
+
+static bool
+virNumaHugePageLedgerGet(int node,
+                         unsigned int page_size,
+                         unsigned int *page_avail,
+                         unsigned int *page_free)
+{
+    virNumaHugePageLedgerEntryPtr entry;
+    unsigned long long now;
+    char *key;
+    bool ret = false;
+
+    if (virTimeMillisNowRaw(&now) < 0 ||
+        !(key = virNumaHugePageLedgerKey(node, page_size)))
+        return false;
+
+    virMutexLock(&virNumaHugePageLedgerLock);
+    if (virNumaHugePageLedger &&
+        (entry = virHashLookup(virNumaHugePageLedger, key)) &&
+        now - entry->when < VIR_NUMA_HUGE_PAGE_LEDGER_TIMEOUT) {
+        *page_avail = entry->avail;
+        *page_free = entry->free;
+        ret = true;
+    }
+    virMutexUnlock(&virNumaHugePageLedgerLock);
+    VIR_FREE(key);
+    return ret;
+}
+
+static void
+virNumaHugePageLedgerStore(int node,
+                           unsigned int page_size,
+                           unsigned int page_avail,
+                           unsigned int page_free)
+{
+    virNumaHugePageLedgerEntryPtr entry;
+    unsigned long long now;
+    char *key;
+
+    if (virTimeMillisNowRaw(&now) < 0 ||
+        !(key = virNumaHugePageLedgerKey(node, page_size)))
+        return;
+
+    virMutexLock(&virNumaHugePageLedgerLock);
+    if (!virNumaHugePageLedger &&
+        !(virNumaHugePageLedger = virHashCreate(50,
+                                                virNumaHugePageLedgerDataFree)))
+        goto cleanup;
+
+    if (!(entry = virHashLookup(virNumaHugePageLedger, key))) {
+        if (VIR_ALLOC_QUIET(entry) < 0 ||
+            virHashAddEntry(virNumaHugePageLedger, key, entry) < 0) {
+            VIR_FREE(entry);
+            goto cleanup;
+        }
+    }
+
+    entry->avail = page_avail;
+    entry->free = page_free;
+    entry->when = now;
+ cleanup:
+    virMutexUnlock(&virNumaHugePageLedgerLock);
+    VIR_FREE(key);
+}
+
+static void
+virNumaHugePageLedgerFlush(void)
+{
+    virMutexLock(&virNumaHugePageLedgerLock);
+    /* Resizing one pool shifts memory between the overall and the
+     * per-node accounting too, so just drop everything */
+    virHashFree(virNumaHugePageLedger);
+    virNumaHugePageLedger = NULL;
+    virMutexUnlock(&virNumaHugePageLedgerLock);
+}
+
 /**
  * virNumaGetHugePageInfo:
  * @node: NUMA node id
@@ -570,43 +775,54 @@ virNumaGetHugePageInfo(int node,
     char *path = NULL;
     char *buf = NULL;
     char *end;
+    unsigned int avail = 0;
+    unsigned int free_pages = 0;
 
-    if (page_avail) {
-        if (virNumaGetHugePageInfoPath(&path, node,
-                                       page_size, "nr_hugepages") < 0)
-            goto cleanup;
+    if (virNumaHugePageLedgerGet(node, page_size, &avail, &free_pages))
+        goto done;
 
-        if (virFileReadAll(path, 1024, &buf) < 0)
-            goto cleanup;
+    /* Read both counts even if the caller asked for just one so
+     * that the ledger entry is complete */
+    if (virNumaGetHugePageInfoPath(&path, node,
+                                   page_size, "nr_hugepages") < 0)
+        goto cleanup;
 
-        if (virStrToLong_ui(buf, &end, 10, page_avail) < 0 ||
-            *end != '\n') {
-            virReportError(VIR_ERR_INTERNAL_ERROR,
-                           _("unable to parse: %s"),
-                           buf);
-            goto cleanup;
-        }
-        VIR_FREE(buf);
-        VIR_FREE(path);
+    if (virFileReadAll(path, 1024, &buf) < 0)
+        goto cleanup;
+
+    if (virStrToLong_ui(buf, &end, 10, &avail) < 0 ||
+        *end != '\n') {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("unable to parse: %s"),
+                       buf);
+        goto cleanup;
     }
+    VIR_FREE(buf);
+    VIR_FREE(path);
 
-    if (page_free) {
-        if (virNumaGetHugePageInfoPath(&path, node,
-                                       page_size, "free_hugepages") < 0)
-            goto cleanup;
+    if (virNumaGetHugePageInfoPath(&path, node,
+                                   page_size, "free_hugepages") < 0)
+        goto cleanup;
 
-        if (virFileReadAll(path, 1024, &buf) < 0)
-            goto cleanup;
+    if (virFileReadAll(path, 1024, &buf) < 0)
+        goto cleanup;
 
-        if (virStrToLong_ui(buf, &end, 10, page_free) < 0 ||
-            *end != '\n') {
-            virReportError(VIR_ERR_INTERNAL_ERROR,
-                           _("unable to parse: %s"),
-                           buf);
-            goto cleanup;
-        }
+    if (virStrToLong_ui(buf, &end, 10, &free_pages) < 0 ||
+        *end != '\n') {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("unable to parse: %s"),
+                       buf);
+        goto cleanup;
     }
 
+    virNumaHugePageLedgerStore(node, page_size, avail, free_pages);
+
+ done:
+    if (page_avail)
+        *page_avail = avail;
+    if (page_free)
+        *page_free = free_pages;
+
     ret = 0;
  cleanup:
     VIR_FREE(buf);
@@ -900,6 +1116,10 @@ virNumaSetPagePoolSize(int node,
         goto cleanup;
     }
 
+    /* The pool just changed size; whatever the ledger remembered
+     * about any of the pools is outdated now */
+    virNumaHugePageLedgerFlush();
+
     /* And now do the check. */
 
     VIR_FREE(nr_buf);
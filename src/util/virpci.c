@@ -42,8 +42,10 @@
 #include "vircommand.h"
 #include "virerror.h"
 #include "virfile.h"
+#include "virhash.h"
 #include "virkmod.h"
 #include "virstring.h"
+#include "virthread.h"
 #include "virutil.h"
 
 VIR_LOG_INIT("util.pci");
@@ -104,6 +106,122 @@ struct _virPCIDeviceList {
 /* For virReportOOMError()  and virReportSystemError() */
 #define VIR_FROM_THIS VIR_FROM_NONE
 
+/* Cache of sysfs facts that stay fixed for the lifetime of a device
+ * node, keyed by the device name ("dddd:bb:ss.f"). Preparing a guest
+ * with many hostdevs re-reads the same vendor/product ID files and
+ * iommu_group links over and over (every virPCIDeviceIterDevices walk
+ * constructs a virPCIDevice for each device on the bus); the cache
+ * turns the repeats into hash lookups. Nothing mutable is cached -
+ * driver binding and VF allocation are always re-read from sysfs -
+ * and an entry is dropped as soon as the device's config file
+ * disappears, which covers device unplug.
+ */
+typedef struct _virPCIDeviceCacheEntry virPCIDeviceCacheEntry;
+typedef virPCIDeviceCacheEntry *virPCIDeviceCacheEntryPtr;
+struct _virPCIDeviceCacheEntry {
+    char id[PCI_ID_LEN];  /* product vendor, empty if not yet read */
+    bool hasIOMMUGroup;
+    int iommuGroup;       /* group number, -2 if the device has none */
+};
+
+static virMutex virPCIDeviceCacheLock = VIR_MUTEX_INITIALIZER;
+static virHashTablePtr virPCIDeviceCache;
+
+static void
+virPCIDeviceCacheDataFree(void *payload, const void *name ATTRIBUTE_UNUSED)
+{
+    VIR_FREE(payload);
+}
+
+/* Look up or create the cache entry for @name. Returns NULL if the
+ * cache cannot be allocated; callers just fall back to sysfs. The
+ * cache lock must be held. */
+static virPCIDeviceCacheEntryPtr
+virPCIDeviceCacheGetLocked(const char *name)
+{
+    virPCIDeviceCacheEntryPtr entry;
+
+    if (!virPCIDeviceCache &&
+        !(virPCIDeviceCache = virHashCreate(50, virPCIDeviceCacheDataFree)))
+        return NULL;
+
+    if ((entry = virHashLookup(virPCIDeviceCache, name)))
+        return entry;
+
+    if (VIR_ALLOC_QUIET(entry) < 0)
+        return NULL;
+
+    if (virHashAddEntry(virPCIDeviceCache, name, entry) < 0) {
+        VIR_FREE(entry);
+        return NULL;
+    }
+
+    return entry;
+}
+
+static bool
+virPCIDeviceCacheGetID(const char *name, char *id)
+{
+    virPCIDeviceCacheEntryPtr entry;
+    bool found = false;
+
+    virMutexLock(&virPCIDeviceCacheLock);
+    if ((entry = virPCIDeviceCacheGetLocked(name)) && entry->id[0]) {
+        memcpy(id, entry->id, PCI_ID_LEN);
+        found = true;
+    }
+    virMutexUnlock(&virPCIDeviceCacheLock);
+    return found;
+}
+
+static void
+virPCIDeviceCacheStoreID(const char *name, const char *id)
+{
+    virPCIDeviceCacheEntryPtr entry;
+
+    virMutexLock(&virPCIDeviceCacheLock);
+    if ((entry = virPCIDeviceCacheGetLocked(name)))
+        memcpy(entry->id, id, PCI_ID_LEN);
+    virMutexUnlock(&virPCIDeviceCacheLock);
+}
+
+static bool
+virPCIDeviceCacheGetIOMMUGroup(const char *name, int *group)
+{
+    virPCIDeviceCacheEntryPtr entry;
+    bool found = false;
+
+    virMutexLock(&virPCIDeviceCacheLock);
+    if ((entry = virPCIDeviceCacheGetLocked(name)) && entry->hasIOMMUGroup) {
+        *group = entry->iommuGroup;
+        found = true;
+    }
+    virMutexUnlock(&virPCIDeviceCacheLock);
+    return found;
+}
+
+static void
+virPCIDeviceCacheStoreIOMMUGroup(const char *name, int group)
+{
+    virPCIDeviceCacheEntryPtr entry;
+
+    virMutexLock(&virPCIDeviceCacheLock);
+    if ((entry = virPCIDeviceCacheGetLocked(name))) {
+        entry->iommuGroup = group;
+        entry->hasIOMMUGroup = true;
+    }
+    virMutexUnlock(&virPCIDeviceCacheLock);
+}
+
+static void
+virPCIDeviceCacheDrop(const char *name)
+{
+    virMutexLock(&virPCIDeviceCacheLock);
+    if (virPCIDeviceCache)
+        ignore_value(virHashRemoveEntry(virPCIDeviceCache, name));
+    virMutexUnlock(&virPCIDeviceCacheLock);
+}
+
 /* Specifications referenced in comments:
  *  PCI30  - PCI Local Bus Specification 3.0
  *  PCIe20 - PCI Express Base Specification 2.0
@@ -1492,6 +1610,29 @@ virPCIDeviceBindToStub(virPCIDevicePtr dev)
     return ret;
 }
 
+/* virPCIDeviceHasDriverOverride:
+ *
+ * Returns true if the kernel exposes the driver_override interface
+ * for @dev. Binding through driver_override only touches per-device
+ * state, unlike the older new_id interface which manipulates the
+ * stub driver's shared dynamic ID table, so it is the only way a
+ * device can be rebound without affecting other devices that have
+ * the same vendor/product pair.
+ */
+bool
+virPCIDeviceHasDriverOverride(virPCIDevicePtr dev)
+{
+    char *path;
+    bool ret;
+
+    if (!(path = virPCIFile(dev->name, "driver_override")))
+        return false;
+
+    ret = virFileExists(path);
+    VIR_FREE(path);
+    return ret;
+}
+
 /* virPCIDeviceDetach:
  *
  * Detach this device from the host driver, attach it to the stub
@@ -1754,26 +1895,32 @@ virPCIDeviceNew(unsigned int domain,
         virReportSystemError(errno,
                              _("Device %s not found: could not access %s"),
                              dev->name, dev->path);
+        /* the device is gone; whatever was cached for it is stale */
+        virPCIDeviceCacheDrop(dev->name);
         goto error;
     }
 
-    vendor  = virPCIDeviceReadID(dev, "vendor");
-    product = virPCIDeviceReadID(dev, "device");
+    if (!virPCIDeviceCacheGetID(dev->name, dev->id)) {
+        vendor  = virPCIDeviceReadID(dev, "vendor");
+        product = virPCIDeviceReadID(dev, "device");
 
-    if (!vendor || !product) {
-        virReportError(VIR_ERR_INTERNAL_ERROR,
-                       _("Failed to read product/vendor ID for %s"),
-                       dev->name);
-        goto error;
-    }
+        if (!vendor || !product) {
+            virReportError(VIR_ERR_INTERNAL_ERROR,
+                           _("Failed to read product/vendor ID for %s"),
+                           dev->name);
+            goto error;
+        }
 
-    /* strings contain '0x' prefix */
-    if (snprintf(dev->id, sizeof(dev->id), "%s %s", &vendor[2],
-                 &product[2]) >= sizeof(dev->id)) {
-        virReportError(VIR_ERR_INTERNAL_ERROR,
-                       _("dev->id buffer overflow: %s %s"),
-                       &vendor[2], &product[2]);
-        goto error;
+        /* strings contain '0x' prefix */
+        if (snprintf(dev->id, sizeof(dev->id), "%s %s", &vendor[2],
+                     &product[2]) >= sizeof(dev->id)) {
+            virReportError(VIR_ERR_INTERNAL_ERROR,
+                           _("dev->id buffer overflow: %s %s"),
+                           &vendor[2], &product[2]);
+            goto error;
+        }
+
+        virPCIDeviceCacheStoreID(dev->name, dev->id);
     }
 
     VIR_DEBUG("%s %s: initialized", dev->id, dev->name);
@@ -2313,10 +2460,16 @@ virPCIDeviceAddressGetIOMMUGroupNum(virPCIDeviceAddressPtr addr)
                     addr->bus, addr->slot, addr->function) < 0)
         goto cleanup;
 
+    /* which group a device belongs to is fixed by the hardware
+     * topology, so the answer can be cached indefinitely */
+    if (virPCIDeviceCacheGetIOMMUGroup(devName, &ret))
+        goto cleanup;
+
     if (!(devPath = virPCIFile(devName, "iommu_group")))
         goto cleanup;
     if (virFileIsLink(devPath) != 1) {
         ret = -2;
+        virPCIDeviceCacheStoreIOMMUGroup(devName, ret);
         goto cleanup;
     }
     if (virFileResolveLink(devPath, &groupPath) < 0) {
@@ -2337,6 +2490,7 @@ virPCIDeviceAddressGetIOMMUGroupNum(virPCIDeviceAddressPtr addr)
     }
 
     ret = groupNum;
+    virPCIDeviceCacheStoreIOMMUGroup(devName, ret);
  cleanup:
     VIR_FREE(devName);
     VIR_FREE(devPath);
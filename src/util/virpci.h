@@ -98,6 +98,7 @@ virPCIDevicePtr virPCIDeviceCopy(virPCIDevicePtr dev);
 void virPCIDeviceFree(virPCIDevicePtr dev);
 const char *virPCIDeviceGetName(virPCIDevicePtr dev);
 
+bool virPCIDeviceHasDriverOverride(virPCIDevicePtr dev);
 int virPCIDeviceDetach(virPCIDevicePtr dev,
                        virPCIDeviceListPtr activeDevs,
                        virPCIDeviceListPtr inactiveDevs);
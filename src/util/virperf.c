@@ -46,6 +46,8 @@ struct virPerfEvent {
     int type;
     int fd;
     bool enabled;
+    bool grouped;           /* fd was opened with PERF_FORMAT_GROUP */
+    unsigned long long id;  /* kernel id of the counter, valid when grouped */
     union {
         /* cmt */
         struct {
@@ -165,6 +167,10 @@ virPerfEventEnable(virPerfPtr perf,
 {
     char *buf = NULL;
     struct perf_event_attr attr;
+# ifdef PERF_EVENT_IOC_ID
+    int group_fd = -1;
+    size_t i;
+# endif
     virPerfEventPtr event = virPerfGetEvent(perf, type);
     virPerfEventAttrPtr event_attr = virPerfGetEventAttr(type);
 
@@ -202,7 +208,45 @@ virPerfEventEnable(virPerfPtr perf,
     attr.type = event_attr->attrType;
     attr.config = event_attr->attrConfig;
 
-    event->fd = syscall(__NR_perf_event_open, &attr, pid, -1, -1, 0);
+    event->fd = -1;
+# ifdef PERF_EVENT_IOC_ID
+    /* Counters of the same PMU are opened as one group, so every
+     * enabled counter of that PMU can be read with a single syscall */
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_ID;
+
+    for (i = 0; i < VIR_PERF_EVENT_LAST; i++) {
+        virPerfEventPtr other = perf->events + i;
+
+        if (other->enabled && other->grouped &&
+            attrs[i].attrType == event_attr->attrType) {
+            group_fd = other->fd;
+            break;
+        }
+    }
+
+    if ((event->fd = syscall(__NR_perf_event_open, &attr,
+                             pid, -1, group_fd, 0)) < 0 &&
+        group_fd != -1) {
+        /* grouping can fail when the group no longer fits on the
+         * PMU; fall back to a standalone counter */
+        event->fd = syscall(__NR_perf_event_open, &attr, pid, -1, -1, 0);
+    }
+
+    if (event->fd >= 0) {
+        if (ioctl(event->fd, PERF_EVENT_IOC_ID, &event->id) == 0) {
+            event->grouped = true;
+        } else {
+            /* kernel too old to query counter ids; reopen ungrouped */
+            VIR_FORCE_CLOSE(event->fd);
+        }
+    }
+# endif
+
+    if (event->fd < 0) {
+        attr.read_format = 0;
+        event->grouped = false;
+        event->fd = syscall(__NR_perf_event_open, &attr, pid, -1, -1, 0);
+    }
     if (event->fd < 0) {
         virReportSystemError(errno,
                              _("unable to open host cpu perf event for %s"),
@@ -245,6 +289,8 @@ virPerfEventDisable(virPerfPtr perf,
     }
 
     event->enabled = false;
+    event->grouped = false;
+    event->id = 0;
     VIR_FORCE_CLOSE(event->fd);
     return 0;
 }
@@ -259,6 +305,68 @@ bool virPerfEventIsEnabled(virPerfPtr perf,
     return event->enabled;
 }
 
+# ifdef PERF_EVENT_IOC_ID
+
+/* Layout returned by reading a fd opened with
+ * PERF_FORMAT_GROUP | PERF_FORMAT_ID: the number of counters in the
+ * group followed by one value/id pair per counter. */
+struct virPerfGroupData {
+    unsigned long long nr;
+    struct {
+        unsigned long long value;
+        unsigned long long id;
+    } entries[VIR_PERF_EVENT_LAST];
+};
+
+/* Read @event's whole group with one syscall and credit each
+ * returned counter to the event owning its id, with the cmt scaling
+ * factor already applied. */
+static int
+virPerfReadGroup(virPerfPtr perf,
+                 virPerfEventPtr event,
+                 uint64_t *values,
+                 bool *have)
+{
+    struct virPerfGroupData data;
+    ssize_t len;
+    size_t i;
+    size_t j;
+
+    /* a plain read; the fd returns the whole snapshot every time, so
+     * looping for more bytes would just read it again */
+    if ((len = read(event->fd, &data, sizeof(data))) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("Unable to read perf counter group"));
+        return -1;
+    }
+
+    if (len < (ssize_t)sizeof(data.nr) ||
+        data.nr > VIR_PERF_EVENT_LAST ||
+        len < (ssize_t)(sizeof(data.nr) + data.nr * sizeof(data.entries[0]))) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("malformed perf counter group data"));
+        return -1;
+    }
+
+    for (i = 0; i < data.nr; i++) {
+        for (j = 0; j < VIR_PERF_EVENT_LAST; j++) {
+            virPerfEventPtr other = perf->events + j;
+
+            if (other->enabled && other->grouped &&
+                other->id == data.entries[i].id) {
+                values[j] = data.entries[i].value;
+                if (j == VIR_PERF_EVENT_CMT)
+                    values[j] *= other->efields.cmt.scale;
+                have[j] = true;
+            }
+        }
+    }
+
+    return 0;
+}
+
+# endif /* PERF_EVENT_IOC_ID */
+
 int
 virPerfReadEvent(virPerfPtr perf,
                  virPerfEventType type,
@@ -268,6 +376,23 @@ virPerfReadEvent(virPerfPtr perf,
     if (event == NULL || !event->enabled)
         return -1;
 
+# ifdef PERF_EVENT_IOC_ID
+    if (event->grouped) {
+        uint64_t values[VIR_PERF_EVENT_LAST];
+        bool have[VIR_PERF_EVENT_LAST] = { false };
+
+        if (virPerfReadGroup(perf, event, values, have) < 0)
+            return -1;
+        if (!have[type]) {
+            virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                           _("perf counter missing from its group"));
+            return -1;
+        }
+        *value = values[type];
+        return 0;
+    }
+# endif
+
     if (saferead(event->fd, value, sizeof(uint64_t)) < 0) {
         virReportSystemError(errno, "%s",
                              _("Unable to read cache data"));
@@ -280,6 +405,43 @@ virPerfReadEvent(virPerfPtr perf,
     return 0;
 }
 
+int
+virPerfReadEvents(virPerfPtr perf,
+                  uint64_t *values,
+                  bool *have)
+{
+    size_t i;
+
+    for (i = 0; i < VIR_PERF_EVENT_LAST; i++)
+        have[i] = false;
+
+    if (!perf)
+        return 0;
+
+    for (i = 0; i < VIR_PERF_EVENT_LAST; i++) {
+        virPerfEventPtr event = perf->events + i;
+
+        if (!event->enabled || have[i])
+            continue;
+
+# ifdef PERF_EVENT_IOC_ID
+        if (event->grouped) {
+            /* fills in every counter sharing this event's group */
+            if (virPerfReadGroup(perf, event, values, have) < 0)
+                return -1;
+            if (have[i])
+                continue;
+        }
+# endif
+
+        if (virPerfReadEvent(perf, i, &values[i]) < 0)
+            return -1;
+        have[i] = true;
+    }
+
+    return 0;
+}
+
 #else
 static int
 virPerfRdtAttrInit(void)
@@ -324,6 +486,19 @@ virPerfReadEvent(virPerfPtr perf ATTRIBUTE_UNUSED,
     return -1;
 }
 
+int
+virPerfReadEvents(virPerfPtr perf ATTRIBUTE_UNUSED,
+                  uint64_t *values ATTRIBUTE_UNUSED,
+                  bool *have)
+{
+    size_t i;
+
+    for (i = 0; i < VIR_PERF_EVENT_LAST; i++)
+        have[i] = false;
+
+    return 0;
+}
+
 #endif
 
 virPerfPtr
@@ -63,4 +63,12 @@ int virPerfReadEvent(virPerfPtr perf,
                      virPerfEventType type,
                      uint64_t *value);
 
+/* Read every enabled counter, using one group read per PMU where the
+ * kernel supports it. @values and @have must each hold
+ * VIR_PERF_EVENT_LAST entries; @have marks the events whose value
+ * was filled in. */
+int virPerfReadEvents(virPerfPtr perf,
+                      uint64_t *values,
+                      bool *have);
+
 #endif /* __VIR_PERF_H__ */
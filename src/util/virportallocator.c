@@ -44,6 +44,11 @@ struct _virPortAllocator {
     unsigned short start;
     unsigned short end;
 
+    /* Bitmap index at which the next acquire starts scanning, so
+     * candidates which bind-probing found taken by other processes
+     * are not probed again on every single acquire */
+    size_t hint;
+
     unsigned int flags;
 };
 
@@ -176,37 +181,59 @@ int virPortAllocatorAcquire(virPortAllocatorPtr pa,
                             unsigned short *port)
 {
     int ret = -1;
-    size_t i;
+    size_t capacity = (pa->end - pa->start) + 1;
+    bool wrapped = false;
+    ssize_t bit;
 
     *port = 0;
     virObjectLock(pa);
 
-    for (i = pa->start; i <= pa->end && !*port; i++) {
+    /* Scan only the clear bits, starting where the previous search
+     * stopped and wrapping around once, so ports reserved by us are
+     * skipped without syscalls and ports held by other processes
+     * aren't re-probed by every acquire */
+    bit = virBitmapNextClearBit(pa->bitmap, (ssize_t)pa->hint - 1);
+
+    for (;;) {
         bool used = false, v6used = false;
+        unsigned short candidate;
 
-        if (virBitmapIsBitSet(pa->bitmap, i - pa->start))
+        if (bit < 0) {
+            if (wrapped)
+                break;
+            wrapped = true;
+            bit = virBitmapNextClearBit(pa->bitmap, -1);
             continue;
+        }
+
+        if (wrapped && (size_t)bit >= pa->hint)
+            break;
+
+        candidate = pa->start + bit;
 
         if (!(pa->flags & VIR_PORT_ALLOCATOR_SKIP_BIND_CHECK)) {
-            if (virPortAllocatorBindToPort(&v6used, i, AF_INET6) < 0 ||
-                virPortAllocatorBindToPort(&used, i, AF_INET) < 0)
+            if (virPortAllocatorBindToPort(&v6used, candidate, AF_INET6) < 0 ||
+                virPortAllocatorBindToPort(&used, candidate, AF_INET) < 0)
                 goto cleanup;
         }
 
         if (!used && !v6used) {
             /* Add port to bitmap of reserved ports */
-            if (virBitmapSetBit(pa->bitmap,
-                                i - pa->start) < 0) {
+            if (virBitmapSetBit(pa->bitmap, bit) < 0) {
                 virReportError(VIR_ERR_INTERNAL_ERROR,
-                               _("Failed to reserve port %zu"), i);
+                               _("Failed to reserve port %d"), candidate);
                 goto cleanup;
             }
-            *port = i;
+            pa->hint = ((size_t)bit + 1) % capacity;
+            *port = candidate;
             ret = 0;
+            break;
         }
+
+        bit = virBitmapNextClearBit(pa->bitmap, bit);
     }
 
-    if (*port == 0) {
+    if (ret < 0 && *port == 0) {
         virReportError(VIR_ERR_INTERNAL_ERROR,
                        _("Unable to find an unused port in range '%s' (%d-%d)"),
                        pa->name, pa->start, pa->end);
@@ -241,6 +268,10 @@ int virPortAllocatorRelease(virPortAllocatorPtr pa,
         goto cleanup;
     }
 
+    /* Released ports are preferred by the next acquire */
+    if ((size_t)(port - pa->start) < pa->hint)
+        pa->hint = port - pa->start;
+
     ret = 0;
  cleanup:
     virObjectUnlock(pa);
@@ -276,6 +307,9 @@ int virPortAllocatorSetUsed(virPortAllocatorPtr pa,
                            port);
             goto cleanup;
         }
+
+        if ((size_t)(port - pa->start) < pa->hint)
+            pa->hint = port - pa->start;
     }
 
     ret = 0;
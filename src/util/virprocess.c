@@ -57,6 +57,7 @@
 #include "virlog.h"
 #include "virutil.h"
 #include "virstring.h"
+#include "virthread.h"
 #include "vircommand.h"
 
 #define VIR_FROM_THIS VIR_FROM_NONE
@@ -1058,6 +1059,117 @@ int virProcessGetStartTime(pid_t pid,
 #endif
 
 
+static int virProcessProcFd = -1;
+static virOnceControl virProcessProcOnce = VIR_ONCE_CONTROL_INITIALIZER;
+
+static void
+virProcessProcOpen(void)
+{
+    virProcessProcFd = open("/proc", O_RDONLY | O_DIRECTORY);
+}
+
+/**
+ * virProcessGetStatInfo:
+ * @cpuTime: where to store the total CPU time in nanoseconds, may be NULL
+ * @lastCpu: where to store the last CPU the task ran on, may be NULL
+ * @vm_rss: where to store the resident set size in kibibytes, may be NULL
+ * @pid: process to inspect
+ * @tid: thread within @pid to inspect, 0 for the process itself
+ *
+ * Reads the scheduling and memory data of a task from its stat file.
+ * The file is opened relative to a /proc directory FD that is cached
+ * for the process lifetime, so a stats poll covering many domains
+ * pays a single path walk in total rather than one per query. A task
+ * that cannot be read is not treated as an error, so callers may race
+ * with processes going away; the outputs are zero filled in that case.
+ *
+ * Returns 0 on success, -1 on memory allocation failure.
+ */
+int
+virProcessGetStatInfo(unsigned long long *cpuTime,
+                      int *lastCpu,
+                      long *vm_rss,
+                      pid_t pid,
+                      pid_t tid)
+{
+    char *proc;
+    int fd;
+    char buf[1024];
+    ssize_t got = 0;
+    unsigned long long usertime = 0, systime = 0;
+    long rss = 0;
+    int cpu = 0;
+    int ret;
+
+    if (virOnce(&virProcessProcOnce, virProcessProcOpen) < 0 ||
+        virProcessProcFd < 0) {
+        /* In general, we cannot assume pid_t fits in int; but /proc
+         * parsing is specific to Linux where int works fine.  */
+        if (tid)
+            ret = virAsprintf(&proc, "/proc/%d/task/%d/stat",
+                              (int) pid, (int) tid);
+        else
+            ret = virAsprintf(&proc, "/proc/%d/stat", (int) pid);
+        if (ret < 0)
+            return -1;
+
+        fd = open(proc, O_RDONLY);
+    } else {
+        if (tid)
+            ret = virAsprintf(&proc, "%d/task/%d/stat",
+                              (int) pid, (int) tid);
+        else
+            ret = virAsprintf(&proc, "%d/stat", (int) pid);
+        if (ret < 0)
+            return -1;
+
+        fd = openat(virProcessProcFd, proc, O_RDONLY);
+    }
+    VIR_FREE(proc);
+
+    if (fd >= 0) {
+        got = saferead(fd, buf, sizeof(buf) - 1);
+        VIR_FORCE_CLOSE(fd);
+    }
+    if (got <= 0)
+        got = 0;
+    buf[got] = '\0';
+
+    /* See 'man proc' for information about what all these fields are. We're
+     * only interested in a very few of them */
+    if (got == 0 ||
+        sscanf(buf,
+               /* pid -> stime */
+               "%*d (%*[^)]) %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu"
+               /* cutime -> endcode */
+               "%*d %*d %*d %*d %*d %*d %*u %*u %ld %*u %*u %*u"
+               /* startstack -> processor */
+               "%*u %*u %*u %*u %*u %*u %*u %*u %*u %*u %*d %d",
+               &usertime, &systime, &rss, &cpu) != 4) {
+        VIR_WARN("cannot parse process status data");
+    }
+
+    /* We got jiffies
+     * We want nanoseconds
+     * _SC_CLK_TCK is jiffies per second
+     * So calculate thus....
+     */
+    if (cpuTime)
+        *cpuTime = 1000ull * 1000ull * 1000ull * (usertime + systime)
+            / (unsigned long long) sysconf(_SC_CLK_TCK);
+    if (lastCpu)
+        *lastCpu = cpu;
+
+    if (vm_rss)
+        *vm_rss = rss * virGetSystemPageSizeKB();
+
+    VIR_DEBUG("Got status for %d/%d user=%llu sys=%llu cpu=%d rss=%ld",
+              (int) pid, (int) tid, usertime, systime, cpu, rss);
+
+    return 0;
+}
+
+
 static int virProcessNamespaceHelper(int errfd,
                                      pid_t pid,
                                      virProcessNamespaceCallback cb,
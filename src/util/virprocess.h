@@ -65,6 +65,12 @@ int virProcessGetPids(pid_t pid, size_t *npids, pid_t **pids);
 int virProcessGetStartTime(pid_t pid,
                            unsigned long long *timestamp);
 
+int virProcessGetStatInfo(unsigned long long *cpuTime,
+                          int *lastCpu,
+                          long *vm_rss,
+                          pid_t pid,
+                          pid_t tid);
+
 int virProcessGetNamespaces(pid_t pid,
                             size_t *nfdlist,
                             int **fdlist);
@@ -65,23 +65,28 @@ sexpr_free(struct sexpr *sexpr)
 {
     int serrno = errno;
 
-    if (sexpr == NULL)
-        return;
+    /* Lists are chained via cdr, so iterate along that axis and
+     * only recurse for car, keeping the recursion depth bound by
+     * the nesting depth rather than the list length */
+    while (sexpr) {
+        struct sexpr *cdr = NULL;
+
+        switch (sexpr->kind) {
+            case SEXPR_CONS:
+                sexpr_free(sexpr->u.s.car);
+                cdr = sexpr->u.s.cdr;
+                break;
+            case SEXPR_VALUE:
+                VIR_FREE(sexpr->u.value);
+                break;
+            case SEXPR_NIL:
+                break;
+        }
 
-    switch (sexpr->kind) {
-        case SEXPR_CONS:
-            sexpr_free(sexpr->u.s.car);
-            sexpr_free(sexpr->u.s.cdr);
-            break;
-        case SEXPR_VALUE:
-            VIR_FREE(sexpr->u.value);
-            break;
-        case SEXPR_NIL:
-            break;
+        VIR_FREE(sexpr);
+        sexpr = cdr;
     }
 
-    VIR_FREE(sexpr);
-
     errno = serrno;
 }
 
@@ -281,20 +286,32 @@ _string2sexpr(const char *buffer, size_t * end)
     ptr = trim(ptr);
 
     if (ptr[0] == '(') {
+        struct sexpr *tail = ret;
+
         ret->kind = SEXPR_NIL;
 
         ptr = trim(ptr + 1);
         while (*ptr && *ptr != ')') {
             struct sexpr *tmp;
+            struct sexpr *nil;
             size_t tmp_len = 0;
 
             tmp = _string2sexpr(ptr, &tmp_len);
             if (tmp == NULL)
                 goto error;
-            if (append(ret, tmp) < 0) {
+
+            /* Append at the known tail rather than walking the
+             * whole list again for every element, which made
+             * parsing long lists quadratic */
+            if (!(nil = sexpr_nil())) {
                 sexpr_free(tmp);
                 goto error;
             }
+            tail->kind = SEXPR_CONS;
+            tail->u.s.car = tmp;
+            tail->u.s.cdr = nil;
+            tail = nil;
+
             ptr = trim(ptr + tmp_len);
         }
 
@@ -31,7 +31,9 @@
 #include "viralloc.h"
 #include "virbuffer.h"
 #include "virerror.h"
+#include "virhash.h"
 #include "virlog.h"
+#include "virthread.h"
 
 #define VIR_FROM_THIS VIR_FROM_NONE
 
@@ -1110,3 +1112,62 @@ virStringEncodeBase64(const uint8_t *buf, size_t buflen)
 
     return ret;
 }
+
+
+static virMutex virStringInternMutex;
+static virHashTablePtr virStringInternPool;
+
+static int virStringInternOnceInit(void)
+{
+    if (virMutexInit(&virStringInternMutex) < 0)
+        return -1;
+
+    if (!(virStringInternPool = virHashCreate(10, NULL)))
+        return -1;
+
+    return 0;
+}
+VIR_ONCE_GLOBAL_INIT(virStringIntern)
+
+/**
+ * virStringIntern:
+ * @str: string to intern
+ *
+ * Return a copy of @str that lives for the rest of the process and is
+ * shared with every other caller interning an equal string.  The
+ * returned string must not be modified or freed.
+ *
+ * Interned strings are never released, so this is only suitable for
+ * values drawn from a small fixed vocabulary (controller mount points,
+ * format names and the like), not for values under the control of a
+ * remote party.
+ *
+ * Returns the interned copy of @str, or NULL on allocation failure.
+ */
+const char *
+virStringIntern(const char *str)
+{
+    char *ret = NULL;
+
+    if (!str)
+        return NULL;
+
+    if (virStringInternInitialize() < 0)
+        return NULL;
+
+    virMutexLock(&virStringInternMutex);
+
+    if (!(ret = virHashLookup(virStringInternPool, str))) {
+        if (VIR_STRDUP(ret, str) < 0)
+            goto cleanup;
+
+        if (virHashAddEntry(virStringInternPool, str, ret) < 0) {
+            VIR_FREE(ret);
+            goto cleanup;
+        }
+    }
+
+ cleanup:
+    virMutexUnlock(&virStringInternMutex);
+    return ret;
+}
@@ -280,4 +280,6 @@ bool virStringBufferIsPrintable(const uint8_t *buf, size_t buflen);
 
 char *virStringEncodeBase64(const uint8_t *buf, size_t buflen);
 
+const char *virStringIntern(const char *str);
+
 #endif /* __VIR_STRING_H__ */
@@ -36,6 +36,7 @@
 #include "vircommand.h"
 #include "virfile.h"
 #include "virstring.h"
+#include "virthread.h"
 
 #define VIR_FROM_THIS VIR_FROM_SYSINFO
 
@@ -1066,6 +1067,247 @@ virSysinfoRead(void)
 }
 #endif /* !WIN32 && x86 */
 
+static virSysinfoBIOSDefPtr
+virSysinfoBIOSDefCopy(virSysinfoBIOSDefPtr src)
+{
+    virSysinfoBIOSDefPtr dst;
+
+    if (VIR_ALLOC(dst) < 0)
+        return NULL;
+
+    if (VIR_STRDUP(dst->vendor, src->vendor) < 0 ||
+        VIR_STRDUP(dst->version, src->version) < 0 ||
+        VIR_STRDUP(dst->date, src->date) < 0 ||
+        VIR_STRDUP(dst->release, src->release) < 0)
+        goto error;
+
+    return dst;
+
+ error:
+    virSysinfoBIOSDefFree(dst);
+    return NULL;
+}
+
+static virSysinfoSystemDefPtr
+virSysinfoSystemDefCopy(virSysinfoSystemDefPtr src)
+{
+    virSysinfoSystemDefPtr dst;
+
+    if (VIR_ALLOC(dst) < 0)
+        return NULL;
+
+    if (VIR_STRDUP(dst->manufacturer, src->manufacturer) < 0 ||
+        VIR_STRDUP(dst->product, src->product) < 0 ||
+        VIR_STRDUP(dst->version, src->version) < 0 ||
+        VIR_STRDUP(dst->serial, src->serial) < 0 ||
+        VIR_STRDUP(dst->uuid, src->uuid) < 0 ||
+        VIR_STRDUP(dst->sku, src->sku) < 0 ||
+        VIR_STRDUP(dst->family, src->family) < 0)
+        goto error;
+
+    return dst;
+
+ error:
+    virSysinfoSystemDefFree(dst);
+    return NULL;
+}
+
+static virSysinfoDefPtr
+virSysinfoDefCopy(virSysinfoDefPtr src)
+{
+    virSysinfoDefPtr dst;
+    size_t i;
+
+    if (VIR_ALLOC(dst) < 0)
+        return NULL;
+
+    dst->type = src->type;
+
+    if (src->bios &&
+        !(dst->bios = virSysinfoBIOSDefCopy(src->bios)))
+        goto error;
+
+    if (src->system &&
+        !(dst->system = virSysinfoSystemDefCopy(src->system)))
+        goto error;
+
+    if (src->nbaseBoard &&
+        VIR_ALLOC_N(dst->baseBoard, src->nbaseBoard) < 0)
+        goto error;
+    dst->nbaseBoard = src->nbaseBoard;
+    for (i = 0; i < src->nbaseBoard; i++) {
+        if (VIR_STRDUP(dst->baseBoard[i].manufacturer,
+                       src->baseBoard[i].manufacturer) < 0 ||
+            VIR_STRDUP(dst->baseBoard[i].product,
+                       src->baseBoard[i].product) < 0 ||
+            VIR_STRDUP(dst->baseBoard[i].version,
+                       src->baseBoard[i].version) < 0 ||
+            VIR_STRDUP(dst->baseBoard[i].serial,
+                       src->baseBoard[i].serial) < 0 ||
+            VIR_STRDUP(dst->baseBoard[i].asset,
+                       src->baseBoard[i].asset) < 0 ||
+            VIR_STRDUP(dst->baseBoard[i].location,
+                       src->baseBoard[i].location) < 0)
+            goto error;
+    }
+
+    if (src->nprocessor &&
+        VIR_ALLOC_N(dst->processor, src->nprocessor) < 0)
+        goto error;
+    dst->nprocessor = src->nprocessor;
+    for (i = 0; i < src->nprocessor; i++) {
+        if (VIR_STRDUP(dst->processor[i].processor_socket_destination,
+                       src->processor[i].processor_socket_destination) < 0 ||
+            VIR_STRDUP(dst->processor[i].processor_type,
+                       src->processor[i].processor_type) < 0 ||
+            VIR_STRDUP(dst->processor[i].processor_family,
+                       src->processor[i].processor_family) < 0 ||
+            VIR_STRDUP(dst->processor[i].processor_manufacturer,
+                       src->processor[i].processor_manufacturer) < 0 ||
+            VIR_STRDUP(dst->processor[i].processor_signature,
+                       src->processor[i].processor_signature) < 0 ||
+            VIR_STRDUP(dst->processor[i].processor_version,
+                       src->processor[i].processor_version) < 0 ||
+            VIR_STRDUP(dst->processor[i].processor_external_clock,
+                       src->processor[i].processor_external_clock) < 0 ||
+            VIR_STRDUP(dst->processor[i].processor_max_speed,
+                       src->processor[i].processor_max_speed) < 0 ||
+            VIR_STRDUP(dst->processor[i].processor_status,
+                       src->processor[i].processor_status) < 0 ||
+            VIR_STRDUP(dst->processor[i].processor_serial_number,
+                       src->processor[i].processor_serial_number) < 0 ||
+            VIR_STRDUP(dst->processor[i].processor_part_number,
+                       src->processor[i].processor_part_number) < 0)
+            goto error;
+    }
+
+    if (src->nmemory &&
+        VIR_ALLOC_N(dst->memory, src->nmemory) < 0)
+        goto error;
+    dst->nmemory = src->nmemory;
+    for (i = 0; i < src->nmemory; i++) {
+        if (VIR_STRDUP(dst->memory[i].memory_size,
+                       src->memory[i].memory_size) < 0 ||
+            VIR_STRDUP(dst->memory[i].memory_form_factor,
+                       src->memory[i].memory_form_factor) < 0 ||
+            VIR_STRDUP(dst->memory[i].memory_locator,
+                       src->memory[i].memory_locator) < 0 ||
+            VIR_STRDUP(dst->memory[i].memory_bank_locator,
+                       src->memory[i].memory_bank_locator) < 0 ||
+            VIR_STRDUP(dst->memory[i].memory_type,
+                       src->memory[i].memory_type) < 0 ||
+            VIR_STRDUP(dst->memory[i].memory_type_detail,
+                       src->memory[i].memory_type_detail) < 0 ||
+            VIR_STRDUP(dst->memory[i].memory_speed,
+                       src->memory[i].memory_speed) < 0 ||
+            VIR_STRDUP(dst->memory[i].memory_manufacturer,
+                       src->memory[i].memory_manufacturer) < 0 ||
+            VIR_STRDUP(dst->memory[i].memory_serial_number,
+                       src->memory[i].memory_serial_number) < 0 ||
+            VIR_STRDUP(dst->memory[i].memory_part_number,
+                       src->memory[i].memory_part_number) < 0)
+            goto error;
+    }
+
+    return dst;
+
+ error:
+    virSysinfoDefFree(dst);
+    return NULL;
+}
+
+
+static virMutex sysinfoCacheLock = VIR_MUTEX_INITIALIZER;
+static virThread sysinfoCacheThread;
+static bool sysinfoCacheStarted;
+static bool sysinfoCacheJoined;
+static virSysinfoDefPtr sysinfoCacheDef;
+static virErrorPtr sysinfoCacheError;
+
+static void
+virSysinfoReadWorker(void *opaque ATTRIBUTE_UNUSED)
+{
+    /* Errors are thread local, so a failure has to be saved here and
+     * replayed in the threads asking for the data later on */
+    if (!(sysinfoCacheDef = virSysinfoRead()))
+        sysinfoCacheError = virSaveLastError();
+}
+
+/**
+ * virSysinfoStartBackgroundRead:
+ *
+ * Start collecting the host sysinfo data in a background thread. On
+ * some hosts execing and parsing the SMBIOS decoder takes hundreds of
+ * milliseconds, so collecting the data while the rest of the daemon
+ * initializes hides that latency from both daemon startup and the
+ * first virConnectGetSysinfo call. The parsed data is kept for the
+ * lifetime of the process and handed out by virSysinfoReadCached().
+ *
+ * Returns 0 on success, -1 if the thread could not be spawned (in
+ * which case virSysinfoReadCached() falls back to reading the data
+ * synchronously).
+ */
+int
+virSysinfoStartBackgroundRead(void)
+{
+    int ret = -1;
+
+    virMutexLock(&sysinfoCacheLock);
+    if (sysinfoCacheStarted) {
+        ret = 0;
+        goto cleanup;
+    }
+
+    if (virThreadCreate(&sysinfoCacheThread, true,
+                        virSysinfoReadWorker, NULL) < 0)
+        goto cleanup;
+
+    sysinfoCacheStarted = true;
+    ret = 0;
+ cleanup:
+    virMutexUnlock(&sysinfoCacheLock);
+    return ret;
+}
+
+/**
+ * virSysinfoReadCached:
+ *
+ * Like virSysinfoRead(), but backed by the snapshot collected by the
+ * thread virSysinfoStartBackgroundRead() spawned: the first caller
+ * waits for that thread to finish, later ones are served straight
+ * from the cache. The host SMBIOS tables never change at runtime, so
+ * the snapshot stays valid for the whole daemon lifetime. If no
+ * background read was started the data is read synchronously.
+ *
+ * Returns: a filled up sysinfo structure owned by the caller, or NULL
+ * in case of error
+ */
+virSysinfoDefPtr
+virSysinfoReadCached(void)
+{
+    virSysinfoDefPtr ret = NULL;
+
+    virMutexLock(&sysinfoCacheLock);
+    if (!sysinfoCacheStarted) {
+        virMutexUnlock(&sysinfoCacheLock);
+        return virSysinfoRead();
+    }
+
+    if (!sysinfoCacheJoined) {
+        virThreadJoin(&sysinfoCacheThread);
+        sysinfoCacheJoined = true;
+    }
+
+    if (sysinfoCacheDef)
+        ret = virSysinfoDefCopy(sysinfoCacheDef);
+    else if (sysinfoCacheError)
+        virSetError(sysinfoCacheError);
+    virMutexUnlock(&sysinfoCacheLock);
+
+    return ret;
+}
+
+
 static void
 virSysinfoBIOSFormat(virBufferPtr buf, virSysinfoBIOSDefPtr def)
 {
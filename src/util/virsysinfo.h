@@ -117,6 +117,8 @@ struct _virSysinfoDef {
 };
 
 virSysinfoDefPtr virSysinfoRead(void);
+virSysinfoDefPtr virSysinfoReadCached(void);
+int virSysinfoStartBackgroundRead(void);
 
 void virSysinfoBIOSDefFree(virSysinfoBIOSDefPtr def);
 void virSysinfoSystemDefFree(virSysinfoSystemDefPtr def);
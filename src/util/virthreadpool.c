@@ -28,11 +28,19 @@
 
 #include "virthreadpool.h"
 #include "viralloc.h"
+#include "viratomic.h"
 #include "virthread.h"
 #include "virerror.h"
+#include "virtime.h"
+#include "virutil.h"
 
 #define VIR_FROM_THIS VIR_FROM_NONE
 
+/* Upper bound on the number of job queues a pool shards its work
+ * over. More queues than this show no further reduction in lock
+ * contention, while making the empty-queue steal scan longer. */
+#define VIR_THREAD_POOL_MAX_QUEUES 8
+
 typedef struct _virThreadPoolJob virThreadPoolJob;
 typedef virThreadPoolJob *virThreadPoolJobPtr;
 
@@ -40,6 +48,7 @@ struct _virThreadPoolJob {
     virThreadPoolJobPtr prev;
     virThreadPoolJobPtr next;
     unsigned int priority;
+    unsigned long long queued; /* Time the job was enqueued in ms */
 
     void *data;
 };
@@ -53,6 +62,26 @@ struct _virThreadPoolJobList {
     virThreadPoolJobPtr firstPrio;
 };
 
+/* Jobs are sharded over several queues, each with its own lock, so
+ * that concurrent dispatch and completion mostly contend on
+ * different mutexes. Each worker has a home queue it sleeps on and
+ * steals from the other queues when its own scan comes up empty. */
+typedef struct _virThreadPoolQueue virThreadPoolQueue;
+typedef virThreadPoolQueue *virThreadPoolQueuePtr;
+
+struct _virThreadPoolQueue {
+    virMutex mutex;
+    virCond cond;
+    virThreadPoolJobList jobList;
+    size_t jobQueueDepth;
+    size_t jobQueueDepthMax; /* Highest depth this queue has reached */
+    size_t freeWorkers;
+    size_t wakeups; /* Pending wakeup tokens; a token left behind for a
+                     * worker which is still scanning the other queues
+                     * ensures the signal is not lost before it sleeps */
+    bool quit;
+};
+
 
 struct _virThreadPool {
     bool quit;
@@ -60,28 +89,38 @@ struct _virThreadPool {
     virThreadPoolJobFunc jobFunc;
     const char *jobFuncName;
     void *jobOpaque;
-    virThreadPoolJobList jobList;
-    size_t jobQueueDepth;
+
+    virThreadPoolQueuePtr queues;
+    size_t nQueues;
+    int nextQueue; /* Round robin cursor for queue selection */
 
     virMutex mutex;
-    virCond cond;
     virCond quit_cond;
 
     size_t maxWorkers;
     size_t minWorkers;
-    size_t freeWorkers;
     size_t nWorkers;
+    size_t workerSeq;
     virThreadPtr workers;
 
     size_t maxPrioWorkers;
     size_t nPrioWorkers;
     virThreadPtr prioWorkers;
     virCond prioCond;
+    size_t prioWakeups;
+    unsigned long long promoteDelay; /* Delay in ms after which priority
+                                      * workers may pick up a waiting
+                                      * non-priority job; 0 disables it */
+
+    /* Utilization counters, protected by 'mutex' */
+    unsigned long long jobsCompleted; /* Total number of finished jobs */
+    unsigned long long busyTime;      /* Total ms workers spent running jobs */
+    unsigned long long queueWaitTime; /* Total ms finished jobs waited queued */
 };
 
 struct virThreadPoolWorkerData {
     virThreadPoolPtr pool;
-    virCondPtr cond;
+    size_t id;
     bool priority;
 };
 
@@ -93,80 +132,214 @@ static inline bool virThreadPoolWorkerQuitHelper(size_t count, size_t limit)
     return count > limit;
 }
 
+
+/* Unlink the first job (or first priority job) from @queue.
+ * The queue mutex must be held by the caller. */
+static virThreadPoolJobPtr
+virThreadPoolQueuePopLocked(virThreadPoolQueuePtr queue,
+                            bool priority)
+{
+    virThreadPoolJobPtr job = priority ? queue->jobList.firstPrio
+                                       : queue->jobList.head;
+
+    if (!job)
+        return NULL;
+
+    if (job == queue->jobList.firstPrio) {
+        virThreadPoolJobPtr tmp = job->next;
+        while (tmp) {
+            if (tmp->priority)
+                break;
+            tmp = tmp->next;
+        }
+        queue->jobList.firstPrio = tmp;
+    }
+
+    if (job->prev)
+        job->prev->next = job->next;
+    else
+        queue->jobList.head = job->next;
+    if (job->next)
+        job->next->prev = job->prev;
+    else
+        queue->jobList.tail = job->prev;
+    job->prev = job->next = NULL;
+
+    queue->jobQueueDepth--;
+
+    return job;
+}
+
+
+/* Take a job from the queue at @home, falling back to stealing
+ * from the other queues when it is empty. Only one queue lock is
+ * held at any time. */
+static virThreadPoolJobPtr
+virThreadPoolStealJob(virThreadPoolPtr pool,
+                      size_t home,
+                      bool priority)
+{
+    size_t i;
+
+    for (i = 0; i < pool->nQueues; i++) {
+        virThreadPoolQueuePtr queue = &pool->queues[(home + i) % pool->nQueues];
+        virThreadPoolJobPtr job;
+
+        virMutexLock(&queue->mutex);
+        job = virThreadPoolQueuePopLocked(queue, priority);
+        virMutexUnlock(&queue->mutex);
+
+        if (job)
+            return job;
+    }
+
+    return NULL;
+}
+
+
+/* Take the oldest job regardless of its priority flag, provided it
+ * has been waiting longer than @delay milliseconds. Used by priority
+ * workers to stop cheap calls starving behind long running ones once
+ * a deadline has passed. */
+static virThreadPoolJobPtr
+virThreadPoolStealOverdueJob(virThreadPoolPtr pool,
+                             size_t home,
+                             unsigned long long delay)
+{
+    unsigned long long now;
+    size_t i;
+
+    if (virTimeMillisNow(&now) < 0)
+        return NULL;
+
+    for (i = 0; i < pool->nQueues; i++) {
+        virThreadPoolQueuePtr queue = &pool->queues[(home + i) % pool->nQueues];
+        virThreadPoolJobPtr job = NULL;
+
+        virMutexLock(&queue->mutex);
+        if (queue->jobList.head &&
+            queue->jobList.head->queued &&
+            now >= queue->jobList.head->queued + delay)
+            job = virThreadPoolQueuePopLocked(queue, false);
+        virMutexUnlock(&queue->mutex);
+
+        if (job)
+            return job;
+    }
+
+    return NULL;
+}
+
+
 static void virThreadPoolWorker(void *opaque)
 {
     struct virThreadPoolWorkerData *data = opaque;
     virThreadPoolPtr pool = data->pool;
-    virCondPtr cond = data->cond;
     bool priority = data->priority;
+    size_t home = data->id % pool->nQueues;
+    virThreadPoolQueuePtr queue = &pool->queues[home];
     size_t *curWorkers = priority ? &pool->nPrioWorkers : &pool->nWorkers;
     size_t *maxLimit = priority ? &pool->maxPrioWorkers : &pool->maxWorkers;
     virThreadPoolJobPtr job = NULL;
+    unsigned long long jobStart = 0;
+    unsigned long long jobEnd = 0;
 
     VIR_FREE(data);
 
-    virMutexLock(&pool->mutex);
-
     while (1) {
         /* In order to support async worker termination, we need ensure that
          * both busy and free workers know if they need to terminated. Thus,
-         * busy workers need to check for this fact before they start waiting for
-         * another job (and before taking another one from the queue); and
-         * free workers need to check for this right after waking up.
+         * busy workers need to check for this fact before they start looking
+         * for another job (and before sleeping); and free workers need to
+         * check for this right after waking up.
          */
+        virMutexLock(&pool->mutex);
         if (virThreadPoolWorkerQuitHelper(*curWorkers, *maxLimit))
             goto out;
-        while (!pool->quit &&
-               ((!priority && !pool->jobList.head) ||
-                (priority && !pool->jobList.firstPrio))) {
-            if (!priority)
-                pool->freeWorkers++;
-            if (virCondWait(cond, &pool->mutex) < 0) {
-                if (!priority)
-                    pool->freeWorkers--;
-                goto out;
-            }
-            if (!priority)
-                pool->freeWorkers--;
-
-            if (virThreadPoolWorkerQuitHelper(*curWorkers, *maxLimit))
-                goto out;
-        }
-
         if (pool->quit)
             break;
 
         if (priority) {
-            job = pool->jobList.firstPrio;
-        } else {
-            job = pool->jobList.head;
-        }
-
-        if (job == pool->jobList.firstPrio) {
-            virThreadPoolJobPtr tmp = job->next;
-            while (tmp) {
-                if (tmp->priority)
+            unsigned long long promoteDelay = pool->promoteDelay;
+
+            /* Priority workers sleep on a pool wide condition as any
+             * queue may hold a priority job. With a promotion delay
+             * configured they wake periodically to check whether an
+             * ordinary job has exceeded its deadline */
+            if (pool->prioWakeups == 0) {
+                int rc = 0;
+                unsigned long long now;
+
+                if (promoteDelay &&
+                    virTimeMillisNow(&now) == 0) {
+                    rc = virCondWaitUntil(&pool->prioCond, &pool->mutex,
+                                          now + promoteDelay);
+                    if (rc < 0 && errno != ETIMEDOUT)
+                        goto out;
+                } else {
+                    if (virCondWait(&pool->prioCond, &pool->mutex) < 0)
+                        goto out;
+                }
+                if (virThreadPoolWorkerQuitHelper(*curWorkers, *maxLimit))
+                    goto out;
+                if (pool->quit)
                     break;
-                tmp = tmp->next;
+                promoteDelay = pool->promoteDelay;
+            }
+            if (pool->prioWakeups > 0)
+                pool->prioWakeups--;
+            virMutexUnlock(&pool->mutex);
+
+            if (!(job = virThreadPoolStealJob(pool, home, true)) &&
+                promoteDelay)
+                job = virThreadPoolStealOverdueJob(pool, home, promoteDelay);
+        } else {
+            virMutexUnlock(&pool->mutex);
+
+            if (!(job = virThreadPoolStealJob(pool, home, false))) {
+                /* Advertise ourselves as idle before looking once
+                 * more; a job dispatched to another queue in the
+                 * meantime will then be routed to our home queue */
+                virMutexLock(&queue->mutex);
+                queue->freeWorkers++;
+                virMutexUnlock(&queue->mutex);
+
+                job = virThreadPoolStealJob(pool, home, false);
+
+                virMutexLock(&queue->mutex);
+                if (!job && queue->wakeups == 0 && !queue->quit) {
+                    if (virCondWait(&queue->cond, &queue->mutex) < 0) {
+                        queue->freeWorkers--;
+                        virMutexUnlock(&queue->mutex);
+                        virMutexLock(&pool->mutex);
+                        goto out;
+                    }
+                }
+                if (queue->wakeups > 0)
+                    queue->wakeups--;
+                queue->freeWorkers--;
+                virMutexUnlock(&queue->mutex);
             }
-            pool->jobList.firstPrio = tmp;
         }
 
-        if (job->prev)
-            job->prev->next = job->next;
-        else
-            pool->jobList.head = job->next;
-        if (job->next)
-            job->next->prev = job->prev;
-        else
-            pool->jobList.tail = job->prev;
+        if (!job)
+            continue;
 
-        pool->jobQueueDepth--;
+        if (virTimeMillisNow(&jobStart) < 0)
+            jobStart = 0;
 
-        virMutexUnlock(&pool->mutex);
         (pool->jobFunc)(job->data, pool->jobOpaque);
-        VIR_FREE(job);
+
         virMutexLock(&pool->mutex);
+        pool->jobsCompleted++;
+        if (jobStart && virTimeMillisNow(&jobEnd) == 0) {
+            pool->busyTime += jobEnd - jobStart;
+            if (job->queued && jobStart > job->queued)
+                pool->queueWaitTime += jobStart - job->queued;
+        }
+        virMutexUnlock(&pool->mutex);
+
+        VIR_FREE(job);
     }
 
  out:
@@ -195,7 +368,7 @@ virThreadPoolExpand(virThreadPoolPtr pool, size_t gain, bool priority)
             goto error;
 
         data->pool = pool;
-        data->cond = priority ? &pool->prioCond : &pool->cond;
+        data->id = pool->workerSeq++;
         data->priority = priority;
 
         if (virThreadCreateFull(&(*workers)[i],
@@ -226,6 +399,7 @@ virThreadPoolNewFull(size_t minWorkers,
                      void *opaque)
 {
     virThreadPoolPtr pool;
+    size_t i;
 
     if (minWorkers > maxWorkers)
         minWorkers = maxWorkers;
@@ -233,16 +407,22 @@ virThreadPoolNewFull(size_t minWorkers,
     if (VIR_ALLOC(pool) < 0)
         return NULL;
 
-    pool->jobList.tail = pool->jobList.head = NULL;
-
     pool->jobFunc = func;
     pool->jobFuncName = funcName;
     pool->jobOpaque = opaque;
 
+    pool->nQueues = maxWorkers ? MIN(maxWorkers, VIR_THREAD_POOL_MAX_QUEUES) : 1;
+    if (VIR_ALLOC_N(pool->queues, pool->nQueues) < 0)
+        goto error_queues;
+
+    for (i = 0; i < pool->nQueues; i++) {
+        if (virMutexInit(&pool->queues[i].mutex) < 0 ||
+            virCondInit(&pool->queues[i].cond) < 0)
+            goto error_queues;
+    }
+
     if (virMutexInit(&pool->mutex) < 0)
         goto error;
-    if (virCondInit(&pool->cond) < 0)
-        goto error;
     if (virCondInit(&pool->quit_cond) < 0)
         goto error;
 
@@ -267,38 +447,55 @@ virThreadPoolNewFull(size_t minWorkers,
     virThreadPoolFree(pool);
     return NULL;
 
+ error_queues:
+    VIR_FREE(pool->queues);
+    VIR_FREE(pool);
+    return NULL;
 }
 
 void virThreadPoolFree(virThreadPoolPtr pool)
 {
     virThreadPoolJobPtr job;
     bool priority = false;
+    size_t i;
 
     if (!pool)
         return;
 
     virMutexLock(&pool->mutex);
     pool->quit = true;
-    if (pool->nWorkers > 0)
-        virCondBroadcast(&pool->cond);
     if (pool->nPrioWorkers > 0) {
         priority = true;
+        pool->prioWakeups += pool->nPrioWorkers;
         virCondBroadcast(&pool->prioCond);
     }
+    virMutexUnlock(&pool->mutex);
+
+    for (i = 0; i < pool->nQueues; i++) {
+        virMutexLock(&pool->queues[i].mutex);
+        pool->queues[i].quit = true;
+        virCondBroadcast(&pool->queues[i].cond);
+        virMutexUnlock(&pool->queues[i].mutex);
+    }
 
+    virMutexLock(&pool->mutex);
     while (pool->nWorkers > 0 || pool->nPrioWorkers > 0)
         ignore_value(virCondWait(&pool->quit_cond, &pool->mutex));
 
-    while ((job = pool->jobList.head)) {
-        pool->jobList.head = pool->jobList.head->next;
-        VIR_FREE(job);
+    for (i = 0; i < pool->nQueues; i++) {
+        while ((job = pool->queues[i].jobList.head)) {
+            pool->queues[i].jobList.head = job->next;
+            VIR_FREE(job);
+        }
+        virMutexDestroy(&pool->queues[i].mutex);
+        virCondDestroy(&pool->queues[i].cond);
     }
+    VIR_FREE(pool->queues);
 
     VIR_FREE(pool->workers);
     virMutexUnlock(&pool->mutex);
     virMutexDestroy(&pool->mutex);
     virCondDestroy(&pool->quit_cond);
-    virCondDestroy(&pool->cond);
     if (priority) {
         VIR_FREE(pool->prioWorkers);
         virCondDestroy(&pool->prioCond);
@@ -353,21 +550,78 @@ size_t virThreadPoolGetCurrentWorkers(virThreadPoolPtr pool)
 
 size_t virThreadPoolGetFreeWorkers(virThreadPoolPtr pool)
 {
-    size_t ret;
+    size_t ret = 0;
+    size_t i;
+
+    for (i = 0; i < pool->nQueues; i++) {
+        virMutexLock(&pool->queues[i].mutex);
+        ret += pool->queues[i].freeWorkers;
+        virMutexUnlock(&pool->queues[i].mutex);
+    }
+
+    return ret;
+}
+
+size_t virThreadPoolGetJobQueueDepth(virThreadPoolPtr pool)
+{
+    size_t ret = 0;
+    size_t i;
+
+    for (i = 0; i < pool->nQueues; i++) {
+        virMutexLock(&pool->queues[i].mutex);
+        ret += pool->queues[i].jobQueueDepth;
+        virMutexUnlock(&pool->queues[i].mutex);
+    }
+
+    return ret;
+}
+
+/* Sum of each queue's high-water mark; an upper bound on the peak
+ * number of jobs that were waiting at any one time. */
+size_t virThreadPoolGetJobQueueDepthMax(virThreadPoolPtr pool)
+{
+    size_t ret = 0;
+    size_t i;
+
+    for (i = 0; i < pool->nQueues; i++) {
+        virMutexLock(&pool->queues[i].mutex);
+        ret += pool->queues[i].jobQueueDepthMax;
+        virMutexUnlock(&pool->queues[i].mutex);
+    }
+
+    return ret;
+}
+
+unsigned long long virThreadPoolGetJobsCompleted(virThreadPoolPtr pool)
+{
+    unsigned long long ret;
 
     virMutexLock(&pool->mutex);
-    ret = pool->freeWorkers;
+    ret = pool->jobsCompleted;
     virMutexUnlock(&pool->mutex);
 
     return ret;
 }
 
-size_t virThreadPoolGetJobQueueDepth(virThreadPoolPtr pool)
+/* Total time in ms workers have spent executing jobs */
+unsigned long long virThreadPoolGetBusyTime(virThreadPoolPtr pool)
 {
-    size_t ret;
+    unsigned long long ret;
 
     virMutexLock(&pool->mutex);
-    ret = pool->jobQueueDepth;
+    ret = pool->busyTime;
+    virMutexUnlock(&pool->mutex);
+
+    return ret;
+}
+
+/* Total time in ms completed jobs have spent waiting in the queues */
+unsigned long long virThreadPoolGetQueueWaitTime(virThreadPoolPtr pool)
+{
+    unsigned long long ret;
+
+    virMutexLock(&pool->mutex);
+    ret = pool->queueWaitTime;
     virMutexUnlock(&pool->mutex);
 
     return ret;
@@ -382,45 +636,90 @@ int virThreadPoolSendJob(virThreadPoolPtr pool,
                          void *jobData)
 {
     virThreadPoolJobPtr job;
+    virThreadPoolQueuePtr queue = NULL;
+    size_t first;
+    size_t i;
 
     virMutexLock(&pool->mutex);
-    if (pool->quit)
-        goto error;
+    if (pool->quit) {
+        virMutexUnlock(&pool->mutex);
+        return -1;
+    }
 
-    if (pool->freeWorkers - pool->jobQueueDepth <= 0 &&
+    if (virThreadPoolGetFreeWorkers(pool) <= virThreadPoolGetJobQueueDepth(pool) &&
         pool->nWorkers < pool->maxWorkers &&
-        virThreadPoolExpand(pool, 1, false) < 0)
-        goto error;
+        virThreadPoolExpand(pool, 1, false) < 0) {
+        virMutexUnlock(&pool->mutex);
+        return -1;
+    }
+    virMutexUnlock(&pool->mutex);
 
     if (VIR_ALLOC(job) < 0)
-        goto error;
+        return -1;
 
     job->data = jobData;
     job->priority = priority;
+    if (virTimeMillisNow(&job->queued) < 0)
+        job->queued = 0;
+
+    /* Prefer a queue with an idle worker which has not been woken
+     * already; otherwise fall back to plain round robin */
+    first = (unsigned int)virAtomicIntInc(&pool->nextQueue) % pool->nQueues;
+    for (i = 0; i < pool->nQueues; i++) {
+        queue = &pool->queues[(first + i) % pool->nQueues];
+        virMutexLock(&queue->mutex);
+        if (queue->freeWorkers > queue->wakeups)
+            break;
+        virMutexUnlock(&queue->mutex);
+        queue = NULL;
+    }
+    if (!queue) {
+        queue = &pool->queues[first];
+        virMutexLock(&queue->mutex);
+    }
 
-    job->prev = pool->jobList.tail;
-    if (pool->jobList.tail)
-        pool->jobList.tail->next = job;
-    pool->jobList.tail = job;
+    job->prev = queue->jobList.tail;
+    if (queue->jobList.tail)
+        queue->jobList.tail->next = job;
+    queue->jobList.tail = job;
 
-    if (!pool->jobList.head)
-        pool->jobList.head = job;
+    if (!queue->jobList.head)
+        queue->jobList.head = job;
 
-    if (priority && !pool->jobList.firstPrio)
-        pool->jobList.firstPrio = job;
+    if (priority && !queue->jobList.firstPrio)
+        queue->jobList.firstPrio = job;
 
-    pool->jobQueueDepth++;
+    queue->jobQueueDepth++;
+    if (queue->jobQueueDepth > queue->jobQueueDepthMax)
+        queue->jobQueueDepthMax = queue->jobQueueDepth;
 
-    virCondSignal(&pool->cond);
-    if (priority)
+    queue->wakeups++;
+    virCondSignal(&queue->cond);
+    virMutexUnlock(&queue->mutex);
+
+    if (priority) {
+        virMutexLock(&pool->mutex);
+        pool->prioWakeups++;
         virCondSignal(&pool->prioCond);
+        virMutexUnlock(&pool->mutex);
+    }
 
-    virMutexUnlock(&pool->mutex);
     return 0;
+}
 
- error:
+/*
+ * @delay - time in ms a non-priority job may wait before the priority
+ *          workers start servicing it too; 0 restores strict separation
+ */
+void
+virThreadPoolSetPromoteDelay(virThreadPoolPtr pool,
+                             unsigned long long delay)
+{
+    virMutexLock(&pool->mutex);
+    pool->promoteDelay = delay;
+    /* Re-arm sleeping priority workers with the new deadline */
+    virCondBroadcast(&pool->prioCond);
     virMutexUnlock(&pool->mutex);
-    return -1;
 }
 
 int
@@ -431,6 +730,7 @@ virThreadPoolSetParameters(virThreadPoolPtr pool,
 {
     size_t max;
     size_t min;
+    size_t i;
 
     virMutexLock(&pool->mutex);
 
@@ -452,11 +752,17 @@ virThreadPoolSetParameters(virThreadPoolPtr pool,
 
     if (maxWorkers >= 0) {
         pool->maxWorkers = maxWorkers;
-        virCondBroadcast(&pool->cond);
+        /* Wake all sleeping workers so any excess ones can quit */
+        for (i = 0; i < pool->nQueues; i++) {
+            virMutexLock(&pool->queues[i].mutex);
+            virCondBroadcast(&pool->queues[i].cond);
+            virMutexUnlock(&pool->queues[i].mutex);
+        }
     }
 
     if (prioWorkers >= 0) {
         if (prioWorkers < pool->nPrioWorkers) {
+            pool->prioWakeups += pool->nPrioWorkers;
             virCondBroadcast(&pool->prioCond);
         } else if ((size_t) prioWorkers > pool->nPrioWorkers &&
                    virThreadPoolExpand(pool, prioWorkers - pool->nPrioWorkers,
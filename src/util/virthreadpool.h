@@ -49,6 +49,10 @@ size_t virThreadPoolGetPriorityWorkers(virThreadPoolPtr pool);
 size_t virThreadPoolGetCurrentWorkers(virThreadPoolPtr pool);
 size_t virThreadPoolGetFreeWorkers(virThreadPoolPtr pool);
 size_t virThreadPoolGetJobQueueDepth(virThreadPoolPtr pool);
+size_t virThreadPoolGetJobQueueDepthMax(virThreadPoolPtr pool);
+unsigned long long virThreadPoolGetJobsCompleted(virThreadPoolPtr pool);
+unsigned long long virThreadPoolGetBusyTime(virThreadPoolPtr pool);
+unsigned long long virThreadPoolGetQueueWaitTime(virThreadPoolPtr pool);
 
 void virThreadPoolFree(virThreadPoolPtr pool);
 
@@ -62,4 +66,7 @@ int virThreadPoolSetParameters(virThreadPoolPtr pool,
                                long long int maxWorkers,
                                long long int prioWorkers);
 
+void virThreadPoolSetPromoteDelay(virThreadPoolPtr pool,
+                                  unsigned long long delay);
+
 #endif
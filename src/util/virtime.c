@@ -82,6 +82,34 @@ int virTimeMillisNowRaw(unsigned long long *now)
 }
 
 
+/**
+ * virTimeMillisNowCoarseRaw:
+ * @now: filled with current time in milliseconds
+ *
+ * Like virTimeMillisNowRaw, but allowed to use a cheaper clock
+ * source with tick granularity (a few milliseconds) where the
+ * platform provides one. Use this for timestamps and interval
+ * checks which do not need sub-tick precision, e.g. log lines.
+ *
+ * Returns 0 on success, -1 on error with errno set
+ */
+int virTimeMillisNowCoarseRaw(unsigned long long *now)
+{
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_REALTIME_COARSE)
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_REALTIME_COARSE, &ts) < 0)
+        return -1;
+
+    *now = (ts.tv_sec * 1000ull) + (ts.tv_nsec / (1000ull * 1000ull));
+
+    return 0;
+#else
+    return virTimeMillisNowRaw(now);
+#endif
+}
+
+
 /**
  * virTimeFieldsNowRaw:
  * @fields: filled with current time fields
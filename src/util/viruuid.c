@@ -179,13 +179,20 @@ virUUIDParse(const char *uuidstr, unsigned char *uuid)
 const char *
 virUUIDFormat(const unsigned char *uuid, char *uuidstr)
 {
-    snprintf(uuidstr, VIR_UUID_STRING_BUFLEN,
-             "%02x%02x%02x%02x-%02x%02x-%02x%02x-%02x%02x-%02x%02x%02x%02x%02x%02x",
-             uuid[0], uuid[1], uuid[2], uuid[3],
-             uuid[4], uuid[5], uuid[6], uuid[7],
-             uuid[8], uuid[9], uuid[10], uuid[11],
-             uuid[12], uuid[13], uuid[14], uuid[15]);
-    uuidstr[VIR_UUID_STRING_BUFLEN-1] = '\0';
+    static const char hex[16] = "0123456789abcdef";
+    char *p = uuidstr;
+    size_t i;
+
+    /* open coded rather than via snprintf; this runs on every RPC
+     * dispatch that carries a domain and printf format parsing is
+     * measurable there */
+    for (i = 0; i < VIR_UUID_BUFLEN; i++) {
+        *p++ = hex[uuid[i] >> 4];
+        *p++ = hex[uuid[i] & 0xf];
+        if (i == 3 || i == 5 || i == 7 || i == 9)
+            *p++ = '-';
+    }
+    *p = '\0';
     return uuidstr;
 }
 
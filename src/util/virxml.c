@@ -918,6 +918,32 @@ virXMLChildElementCount(xmlNodePtr node)
 }
 
 
+/**
+ * virXMLChildElement:
+ * @node: node to get child element of
+ * @name: name of the child element to look up
+ *
+ * Returns the first child element of @node named @name, or NULL if
+ * there is none or @node is NULL. A cheap alternative to evaluating
+ * an XPath expression when only a directly nested element is wanted.
+ */
+xmlNodePtr
+virXMLChildElement(xmlNodePtr node,
+                   const char *name)
+{
+    xmlNodePtr cur;
+
+    if (!node)
+        return NULL;
+    for (cur = node->children; cur; cur = cur->next) {
+        if (cur->type == XML_ELEMENT_NODE &&
+            xmlStrEqual(cur->name, BAD_CAST name))
+            return cur;
+    }
+    return NULL;
+}
+
+
 /**
  * virXMLNodeToString: convert an XML node ptr to an XML string
  *
@@ -57,6 +57,8 @@ VIR_LOG_INIT("vbox.vbox_common");
 /* global vbox API, used for all common codes. */
 static vboxUniformedAPI gVBoxAPI;
 
+static void vboxMachineCacheClearLocked(vboxGlobalData *data);
+
 static int openSessionForMachine(vboxGlobalData *data, const unsigned char *dom_uuid, vboxIIDUnion *iid,
                                  IMachine **machine, bool checkflag)
 {
@@ -384,6 +386,7 @@ static void vboxUninitialize(vboxGlobalData *data)
 
     gVBoxAPI.UPFN.Uninitialize(data);
 
+    vboxMachineCacheClearLocked(data);
     virObjectUnref(data->caps);
     virObjectUnref(data->xmlopt);
     if (gVBoxAPI.domainEventCallbacks)
@@ -540,6 +543,152 @@ static void vboxDriverUnlock(vboxGlobalData *data)
     virMutexUnlock(&data->lock);
 }
 
+static void vboxMachineCacheClearLocked(vboxGlobalData *data)
+{
+    size_t i;
+
+    for (i = 0; i < data->nmachineCache; i++)
+        VIR_FREE(data->machineCache[i].name);
+    VIR_FREE(data->machineCache);
+    data->nmachineCache = 0;
+    data->machineCacheTime = 0;
+}
+
+/*
+ * Drop the cached machine list so the next lookup enumerates the
+ * machines again. Called from the version specific event callbacks
+ * whenever VirtualBox reports a machine change. The caller must hold
+ * the driver lock (or have exclusive access during teardown).
+ */
+void vboxMachineCacheInvalidate(vboxGlobalData *data)
+{
+    vboxMachineCacheClearLocked(data);
+}
+
+static int vboxMachineCacheRefreshLocked(vboxGlobalData *data)
+{
+    vboxArray machines = VBOX_ARRAY_INITIALIZER;
+    vboxMachineCacheEntry *entries = NULL;
+    size_t nentries = 0;
+    unsigned long long now;
+    size_t i;
+    nsresult rc;
+
+    if (virTimeMillisNow(&now) < 0)
+        return -1;
+
+    rc = gVBoxAPI.UArray.vboxArrayGet(&machines, data->vboxObj, ARRAY_GET_MACHINES);
+    if (NS_FAILED(rc)) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("Could not get list of machines, rc=%08x"), (unsigned)rc);
+        return -1;
+    }
+
+    if (VIR_ALLOC_N(entries, machines.count) < 0)
+        goto error;
+
+    for (i = 0; i < machines.count; ++i) {
+        IMachine *machine = machines.items[i];
+        vboxMachineCacheEntry *entry = &entries[nentries];
+        PRBool isAccessible = PR_FALSE;
+        PRUnichar *nameUtf16 = NULL;
+        char *nameUtf8 = NULL;
+        vboxIIDUnion iid;
+        PRUint32 state;
+
+        if (!machine)
+            continue;
+
+        gVBoxAPI.UIMachine.GetAccessible(machine, &isAccessible);
+        if (!isAccessible)
+            continue;
+
+        VBOX_IID_INITIALIZE(&iid);
+        if (NS_FAILED(gVBoxAPI.UIMachine.GetId(machine, &iid)))
+            continue;
+        vboxIIDToUUID(&iid, entry->uuid);
+        vboxIIDUnalloc(&iid);
+
+        gVBoxAPI.UIMachine.GetName(machine, &nameUtf16);
+        VBOX_UTF16_TO_UTF8(nameUtf16, &nameUtf8);
+        if (VIR_STRDUP(entry->name, nameUtf8) < 0) {
+            VBOX_UTF8_FREE(nameUtf8);
+            VBOX_COM_UNALLOC_MEM(nameUtf16);
+            goto error;
+        }
+        VBOX_UTF8_FREE(nameUtf8);
+        VBOX_COM_UNALLOC_MEM(nameUtf16);
+
+        gVBoxAPI.UIMachine.GetState(machine, &state);
+        if (gVBoxAPI.machineStateChecker.Online(state))
+            entry->id = i + 1;
+        else
+            entry->id = -1;
+
+        nentries++;
+    }
+
+    vboxMachineCacheClearLocked(data);
+    data->machineCache = entries;
+    data->nmachineCache = nentries;
+    data->machineCacheTime = now;
+    gVBoxAPI.UArray.vboxArrayRelease(&machines);
+    return 0;
+
+ error:
+    for (i = 0; i < nentries; i++)
+        VIR_FREE(entries[i].name);
+    VIR_FREE(entries);
+    gVBoxAPI.UArray.vboxArrayRelease(&machines);
+    return -1;
+}
+
+/*
+ * Find a machine by @name or by @uuid (whichever is non-NULL) in the
+ * cached snapshot, enumerating the machines over the COM boundary
+ * only when the snapshot is missing, older than VBOX_MACHINE_CACHE_TTL
+ * or doesn't contain the machine - the latter so a machine registered
+ * since the last refresh is still found. The returned entry is owned
+ * by the cache and only valid while the driver lock is held.
+ */
+static vboxMachineCacheEntry *
+vboxMachineCacheLookupLocked(vboxGlobalData *data,
+                             const char *name,
+                             const unsigned char *uuid)
+{
+    unsigned long long now;
+    bool refreshed = false;
+    size_t i;
+
+    if (virTimeMillisNow(&now) < 0)
+        return NULL;
+
+    if (!data->machineCache ||
+        now - data->machineCacheTime >= VBOX_MACHINE_CACHE_TTL) {
+        if (vboxMachineCacheRefreshLocked(data) < 0)
+            return NULL;
+        refreshed = true;
+    }
+
+ retry:
+    for (i = 0; i < data->nmachineCache; i++) {
+        vboxMachineCacheEntry *entry = &data->machineCache[i];
+
+        if (name ? STREQ(name, entry->name)
+                 : memcmp(uuid, entry->uuid, VIR_UUID_BUFLEN) == 0)
+            return entry;
+    }
+
+    if (!refreshed) {
+        if (vboxMachineCacheRefreshLocked(data) < 0)
+            return NULL;
+        refreshed = true;
+        goto retry;
+    }
+
+    return NULL;
+}
+
 static int vboxConnectGetVersion(virConnectPtr conn, unsigned long *version)
 {
     vboxGlobalData *data = conn->privateData;
@@ -775,79 +924,39 @@ static virDomainPtr vboxDomainLookupByID(virConnectPtr conn, int id)
     return ret;
 }
 
-virDomainPtr vboxDomainLookupByUUID(virConnectPtr conn,
-                                    const unsigned char *uuid)
+virDomainPtr vboxDomainLookupByUUIDLocked(virConnectPtr conn,
+                                          const unsigned char *uuid)
 {
     vboxGlobalData *data = conn->privateData;
-    vboxArray machines = VBOX_ARRAY_INITIALIZER;
-    vboxIIDUnion iid;
-    char *machineNameUtf8 = NULL;
-    PRUnichar *machineNameUtf16 = NULL;
-    unsigned char iid_as_uuid[VIR_UUID_BUFLEN];
-    size_t i;
-    bool matched = false;
-    nsresult rc;
+    vboxMachineCacheEntry *entry;
     virDomainPtr ret = NULL;
 
     if (!data->vboxObj)
         return ret;
 
-    VBOX_IID_INITIALIZE(&iid);
-    rc = gVBoxAPI.UArray.vboxArrayGet(&machines, data->vboxObj, ARRAY_GET_MACHINES);
-    if (NS_FAILED(rc)) {
-        virReportError(VIR_ERR_INTERNAL_ERROR,
-                       _("Could not get list of machines, rc=%08x"), (unsigned)rc);
-        return NULL;
+    if ((entry = vboxMachineCacheLookupLocked(data, NULL, uuid))) {
+        /* get a new domain pointer from virGetDomain, if it fails
+         * then no need to assign the id, else assign the id, cause
+         * it is -1 by default. rest is taken care by virGetDomain
+         * itself, so need not worry.
+         */
+        ret = virGetDomain(conn, entry->name, entry->uuid);
+        if (ret && entry->id > 0)
+            ret->id = entry->id;
     }
 
-    for (i = 0; i < machines.count; ++i) {
-        IMachine *machine = machines.items[i];
-        PRBool isAccessible = PR_FALSE;
-
-        if (!machine)
-            continue;
-
-        gVBoxAPI.UIMachine.GetAccessible(machine, &isAccessible);
-        if (!isAccessible)
-            continue;
-
-        rc = gVBoxAPI.UIMachine.GetId(machine, &iid);
-        if (NS_FAILED(rc))
-            continue;
-        vboxIIDToUUID(&iid, iid_as_uuid);
-        vboxIIDUnalloc(&iid);
-
-        if (memcmp(uuid, iid_as_uuid, VIR_UUID_BUFLEN) == 0) {
-
-            PRUint32 state;
-
-            matched = true;
-
-            gVBoxAPI.UIMachine.GetName(machine, &machineNameUtf16);
-            VBOX_UTF16_TO_UTF8(machineNameUtf16, &machineNameUtf8);
-
-            gVBoxAPI.UIMachine.GetState(machine, &state);
-
-            /* get a new domain pointer from virGetDomain, if it fails
-             * then no need to assign the id, else assign the id, cause
-             * it is -1 by default. rest is taken care by virGetDomain
-             * itself, so need not worry.
-             */
-
-            ret = virGetDomain(conn, machineNameUtf8, iid_as_uuid);
-            if (ret &&
-                gVBoxAPI.machineStateChecker.Online(state))
-                ret->id = i + 1;
-         }
+    return ret;
+}
 
-         if (matched)
-             break;
-    }
+virDomainPtr vboxDomainLookupByUUID(virConnectPtr conn,
+                                    const unsigned char *uuid)
+{
+    vboxGlobalData *data = conn->privateData;
+    virDomainPtr ret;
 
-    /* Do the cleanup and take care you dont leak any memory */
-    VBOX_UTF8_FREE(machineNameUtf8);
-    VBOX_COM_UNALLOC_MEM(machineNameUtf16);
-    gVBoxAPI.UArray.vboxArrayRelease(&machines);
+    vboxDriverLock(data);
+    ret = vboxDomainLookupByUUIDLocked(conn, uuid);
+    vboxDriverUnlock(data);
 
     return ret;
 }
@@ -856,72 +965,24 @@ static virDomainPtr
 vboxDomainLookupByName(virConnectPtr conn, const char *name)
 {
     vboxGlobalData *data = conn->privateData;
-    vboxArray machines = VBOX_ARRAY_INITIALIZER;
-    vboxIIDUnion iid;
-    char *machineNameUtf8 = NULL;
-    PRUnichar *machineNameUtf16 = NULL;
-    unsigned char uuid[VIR_UUID_BUFLEN];
-    size_t i;
-    bool matched = false;
-    nsresult rc;
+    vboxMachineCacheEntry *entry;
     virDomainPtr ret = NULL;
 
     if (!data->vboxObj)
         return ret;
 
-    VBOX_IID_INITIALIZE(&iid);
-    rc = gVBoxAPI.UArray.vboxArrayGet(&machines, data->vboxObj, ARRAY_GET_MACHINES);
-    if (NS_FAILED(rc)) {
-        virReportError(VIR_ERR_INTERNAL_ERROR,
-                       _("Could not get list of machines, rc=%08x"), (unsigned)rc);
-        return NULL;
-    }
-
-    for (i = 0; i < machines.count; ++i) {
-        IMachine *machine = machines.items[i];
-        PRBool isAccessible = PR_FALSE;
-
-        if (!machine)
-            continue;
-
-        gVBoxAPI.UIMachine.GetAccessible(machine, &isAccessible);
-        if (!isAccessible)
-            continue;
-
-        gVBoxAPI.UIMachine.GetName(machine, &machineNameUtf16);
-        VBOX_UTF16_TO_UTF8(machineNameUtf16, &machineNameUtf8);
-
-        if (STREQ(name, machineNameUtf8)) {
-
-            PRUint32 state;
-
-            matched = true;
-
-            gVBoxAPI.UIMachine.GetId(machine, &iid);
-            vboxIIDToUUID(&iid, uuid);
-            vboxIIDUnalloc(&iid);
-
-            gVBoxAPI.UIMachine.GetState(machine, &state);
-
-            /* get a new domain pointer from virGetDomain, if it fails
-             * then no need to assign the id, else assign the id, cause
-             * it is -1 by default. rest is taken care by virGetDomain
-             * itself, so need not worry.
-             */
-
-            ret = virGetDomain(conn, machineNameUtf8, uuid);
-            if (ret &&
-                gVBoxAPI.machineStateChecker.Online(state))
-                ret->id = i + 1;
-        }
-
-        VBOX_UTF8_FREE(machineNameUtf8);
-        VBOX_COM_UNALLOC_MEM(machineNameUtf16);
-        if (matched)
-            break;
+    vboxDriverLock(data);
+    if ((entry = vboxMachineCacheLookupLocked(data, name, NULL))) {
+        /* get a new domain pointer from virGetDomain, if it fails
+         * then no need to assign the id, else assign the id, cause
+         * it is -1 by default. rest is taken care by virGetDomain
+         * itself, so need not worry.
+         */
+        ret = virGetDomain(conn, entry->name, entry->uuid);
+        if (ret && entry->id > 0)
+            ret->id = entry->id;
     }
-
-    gVBoxAPI.UArray.vboxArrayRelease(&machines);
+    vboxDriverUnlock(data);
 
     return ret;
 }
@@ -1434,7 +1434,10 @@ vboxCallbackOnMachineStateChange(IVirtualBoxCallback *pThis ATTRIBUTE_UNUSED,
         g_pVBoxGlobalData->pFuncs->pfnUtf16ToUtf8(machineId, &machineIdUtf8);
         ignore_value(virUUIDParse(machineIdUtf8, uuid));
 
-        dom = vboxDomainLookupByUUID(g_pVBoxGlobalData->conn, uuid);
+        /* the cached machine states are outdated now */
+        vboxMachineCacheInvalidate(g_pVBoxGlobalData);
+
+        dom = vboxDomainLookupByUUIDLocked(g_pVBoxGlobalData->conn, uuid);
         if (dom) {
             virObjectEventPtr ev;
 
@@ -1553,7 +1556,10 @@ vboxCallbackOnMachineRegistered(IVirtualBoxCallback *pThis ATTRIBUTE_UNUSED,
         g_pVBoxGlobalData->pFuncs->pfnUtf16ToUtf8(machineId, &machineIdUtf8);
         ignore_value(virUUIDParse(machineIdUtf8, uuid));
 
-        dom = vboxDomainLookupByUUID(g_pVBoxGlobalData->conn, uuid);
+        /* the cached machine list is outdated now */
+        vboxMachineCacheInvalidate(g_pVBoxGlobalData);
+
+        dom = vboxDomainLookupByUUIDLocked(g_pVBoxGlobalData->conn, uuid);
         if (dom) {
             virObjectEventPtr ev;
 
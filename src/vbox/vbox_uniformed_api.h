@@ -96,6 +96,17 @@ typedef union {
     PRInt32 resultCode;
 } resultCodeUnion;
 
+/* How long in milliseconds a machine cache snapshot is served before
+ * the machines are enumerated over the COM boundary again */
+# define VBOX_MACHINE_CACHE_TTL 1000
+
+/* One entry of the machine lookup cache in vboxGlobalData */
+typedef struct {
+    char *name;
+    unsigned char uuid[VIR_UUID_BUFLEN];
+    int id; /* runtime domain id (machine array index + 1) if online, else -1 */
+} vboxMachineCacheEntry;
+
 typedef struct {
     virMutex lock;
     unsigned long version;
@@ -134,6 +145,14 @@ typedef struct {
 
 # endif /* VBOX_API_VERSION <= 2002000 || VBOX_API_VERSION >= 4000000 || VBOX_API_VERSION undefined */
 
+    /* Cache of machine names, UUIDs and runtime ids, protected by
+     * 'lock'. Refilled from one IVirtualBox_GetMachines enumeration at
+     * most once per VBOX_MACHINE_CACHE_TTL milliseconds, so repeated
+     * domain lookups don't cross the COM boundary once per machine. */
+    vboxMachineCacheEntry *machineCache;
+    size_t nmachineCache;
+    unsigned long long machineCacheTime;
+
 } vboxGlobalData;
 
 /* vboxUniformedAPI gives vbox_common.c a uniformed layer to see
@@ -617,6 +636,14 @@ typedef struct {
 virDomainPtr vboxDomainLookupByUUID(virConnectPtr conn,
                                     const unsigned char *uuid);
 
+/* As vboxDomainLookupByUUID, for callers already holding the driver
+ * lock, e.g. the version specific event callbacks */
+virDomainPtr vboxDomainLookupByUUIDLocked(virConnectPtr conn,
+                                          const unsigned char *uuid);
+
+/* Caller must hold the driver lock */
+void vboxMachineCacheInvalidate(vboxGlobalData *data);
+
 /* Version specified functions for installing uniformed API */
 void vbox22InstallUniformedAPI(vboxUniformedAPI *pVBoxAPI);
 void vbox30InstallUniformedAPI(vboxUniformedAPI *pVBoxAPI);
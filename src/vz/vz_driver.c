@@ -354,7 +354,7 @@ vzDriverObjNew(void)
         return NULL;
     }
 
-    driver->hostsysinfo = virSysinfoRead();
+    driver->hostsysinfo = virSysinfoReadCached();
     ignore_value(prlsdkLoadDomains(driver));
 
     /* As far as waitDomainJob finally calls virReportErrorHelper
@@ -463,9 +463,20 @@ prlsdkGetDomainState(virDomainObjPtr dom, PRL_HANDLE sdkdom, VIRTUAL_MACHINE_STA
     PRL_HANDLE job = PRL_INVALID_HANDLE;
     PRL_HANDLE result = PRL_INVALID_HANDLE;
     PRL_HANDLE vmInfo = PRL_INVALID_HANDLE;
+    vzDomObjPtr privdom = dom ? dom->privateData : NULL;
+    unsigned long long now;
     PRL_RESULT pret;
     int ret = -1;
 
+    /* A state reported recently by a completed job or by a state event
+     * is still current, skipping one SDK round trip per poll */
+    if (privdom && privdom->cachedStateTime != 0 &&
+        virTimeMillisNow(&now) == 0 &&
+        now - privdom->cachedStateTime < VZ_STATE_CACHE_TTL) {
+        *vmState = privdom->cachedState;
+        return 0;
+    }
+
     job = PrlVm_GetState(sdkdom);
 
     if (PRL_FAILED(getDomainJobResult(job, dom, &result)))
@@ -477,6 +488,11 @@ prlsdkGetDomainState(virDomainObjPtr dom, PRL_HANDLE sdkdom, VIRTUAL_MACHINE_STA
     pret = PrlVmInfo_GetState(vmInfo, vmState);
     prlsdkCheckRetGoto(pret, cleanup);
 
+    if (privdom && virTimeMillisNow(&now) == 0) {
+        privdom->cachedState = *vmState;
+        privdom->cachedStateTime = now;
+    }
+
     ret = 0;
 
  cleanup:
@@ -2023,6 +2039,7 @@ prlsdkHandleVmStateEvent(vzDriverPtr driver,
     PRL_INT32 domainState;
     virDomainObjPtr dom = NULL;
     vzDomObjPtr pdom;
+    unsigned long long now;
     virDomainEventType lvEventType = 0;
     int lvEventTypeDetails = 0;
 
@@ -2038,6 +2055,12 @@ prlsdkHandleVmStateEvent(vzDriverPtr driver,
 
     pdom = dom->privateData;
 
+    /* The event carries the authoritative state, refresh the cache */
+    if (virTimeMillisNow(&now) == 0) {
+        pdom->cachedState = domainState;
+        pdom->cachedStateTime = now;
+    }
+
     prlsdkConvertDomainState(domainState, pdom->id, dom);
 
     prlsdkNewStateToEvent(domainState,
@@ -110,8 +110,21 @@ struct vzDomObj {
     PRL_HANDLE sdkdom;
     PRL_HANDLE stats;
     vzDomainJobObj job;
+
+    /* Domain state as last reported by the SDK, either by a completed
+     * PrlVm_GetState job or by a state event. Served instead of a new
+     * job while younger than VZ_STATE_CACHE_TTL milliseconds; a
+     * cachedStateTime of 0 marks the cache invalid. Protected by the
+     * domain object lock. */
+    VIRTUAL_MACHINE_STATE cachedState;
+    unsigned long long cachedStateTime;
 };
 
+/* How long in milliseconds a cached domain state is served before a
+ * new PrlVm_GetState round trip to the SDK is made. State events keep
+ * the cache current in between. */
+# define VZ_STATE_CACHE_TTL 1000
+
 typedef struct vzDomObj *vzDomObjPtr;
 
 void* vzDomObjAlloc(void);
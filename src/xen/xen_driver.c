@@ -252,7 +252,7 @@ xenUnifiedStateInitialize(bool privileged,
     /* Don't allow driver to work in non-root libvirtd */
     if (privileged) {
         is_privileged = true;
-        hostsysinfo = virSysinfoRead();
+        hostsysinfo = virSysinfoReadCached();
     }
 
     return 0;
@@ -52,8 +52,11 @@ static int testGetFilesystem(const void *opaque)
                     abs_srcdir, data->filename) < 0)
         goto cleanup;
 
+    virTestAllocBudgetStart();
     if (!(def = virDomainDefParseFile(filename, caps, xmlopt, NULL, 0)))
         goto cleanup;
+    if (virTestAllocBudgetCheck("virDomainDefParseFile", 4096) < 0)
+        goto cleanup;
 
     fsdef = virDomainGetFilesystemForTarget(def,
                                             data->path);
@@ -23,7 +23,10 @@ testJSONFromString(const void *data)
     virJSONValuePtr json;
     int ret = -1;
 
+    virTestAllocBudgetStart();
     json = virJSONValueFromString(info->doc);
+    if (virTestAllocBudgetCheck("virJSONValueFromString", 2048) < 0)
+        goto cleanup;
 
     if (info->pass) {
         if (!json) {
@@ -0,0 +1,234 @@
+/*
+ * qemumonitorbench.c: benchmark QMP event parsing and dispatch
+ *
+ * Copyright (C) 2016 Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Not a pass/fail test. Replays a synthesized QMP event trace
+ * through qemuMonitorJSONIOProcess against the scripted test monitor
+ * at maximum speed, bypassing the socket, and reports messages/sec
+ * plus allocations per message as one JSON object. This is the
+ * harness for validating JSON parser and event dispatch
+ * optimizations. Run via 'make bench', or directly as
+ *
+ *   qemumonitorbench [NEVENTS-PER-BUFFER] [ITERS]
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "testutils.h"
+#include "testutilsqemu.h"
+#include "qemumonitortestutils.h"
+#include "qemu/qemu_monitor.h"
+#include "qemu/qemu_monitor_json.h"
+#include "virerror.h"
+#include "viralloc.h"
+#include "virbuffer.h"
+#include "virstring.h"
+#include "virevent.h"
+#include "virobject.h"
+#include "virthread.h"
+
+#define VIR_FROM_THIS VIR_FROM_NONE
+
+
+/* Microsecond wall clock; only used for intervals */
+static unsigned long long benchNow(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return (tv.tv_sec * 1000ull * 1000ull) + tv.tv_usec;
+}
+
+
+/*
+ * Builds a trace of @nevents QMP event lines, cycling through shapes
+ * seen in real event storms: a handled event carrying device data, a
+ * handler-less informational event, and a high-rate coalesced event.
+ * Lines use the QMP CRLF framing that qemuMonitorJSONIOProcess
+ * splits on.
+ */
+static char *benchBuildTrace(size_t nevents)
+{
+    virBuffer buf = VIR_BUFFER_INITIALIZER;
+    size_t i;
+
+    for (i = 0; i < nevents; i++) {
+        switch (i % 3) {
+        case 0:
+            virBufferAsprintf(&buf,
+                              "{\"timestamp\": {\"seconds\": %llu, "
+                              "\"microseconds\": %zu}, "
+                              "\"event\": \"NIC_RX_FILTER_CHANGED\", "
+                              "\"data\": {\"name\": \"net%zu\", "
+                              "\"path\": \"/machine/peripheral/net%zu/"
+                              "virtio-backend\"}}\r\n",
+                              1480000000ull + i, i % 1000000,
+                              i % 8, i % 8);
+            break;
+        case 1:
+            virBufferAsprintf(&buf,
+                              "{\"timestamp\": {\"seconds\": %llu, "
+                              "\"microseconds\": %zu}, "
+                              "\"event\": \"SPICE_MIGRATE_COMPLETED\"}\r\n",
+                              1480000000ull + i, i % 1000000);
+            break;
+        case 2:
+            virBufferAsprintf(&buf,
+                              "{\"timestamp\": {\"seconds\": %llu, "
+                              "\"microseconds\": %zu}, "
+                              "\"event\": \"RTC_CHANGE\", "
+                              "\"data\": {\"offset\": %zu}}\r\n",
+                              1480000000ull + i, i % 1000000, i);
+            break;
+        }
+    }
+
+    if (virBufferCheckError(&buf) < 0)
+        return NULL;
+
+    return virBufferContentAndReset(&buf);
+}
+
+
+struct benchAllocTotals {
+    unsigned long long allocs;
+    unsigned long long bytes;
+};
+
+static void benchAllocIterator(int domcode ATTRIBUTE_UNUSED,
+                               unsigned long long allocs,
+                               unsigned long long bytes,
+                               void *opaque)
+{
+    struct benchAllocTotals *totals = opaque;
+
+    totals->allocs += allocs;
+    totals->bytes += bytes;
+}
+
+
+int main(int argc, char **argv)
+{
+    virQEMUDriver driver;
+    bool driverInitialized = false;
+    qemuMonitorTestPtr test = NULL;
+    qemuMonitorPtr mon = NULL;
+    char *trace = NULL;
+    char *scratch = NULL;
+    size_t tracelen;
+    struct benchAllocTotals allocs = { 0, 0 };
+    unsigned long long elapsed, start;
+    unsigned long long nmessages;
+    unsigned int nevents = 100;
+    unsigned int iters = 1000;
+    size_t i;
+    int ret = EXIT_FAILURE;
+
+    if (argc > 3) {
+        fprintf(stderr, "syntax: %s [NEVENTS-PER-BUFFER] [ITERS]\n",
+                argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (argc > 1 &&
+        (virStrToLong_ui(argv[1], NULL, 10, &nevents) < 0 ||
+         nevents == 0)) {
+        fprintf(stderr, "malformed event count '%s'\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+    if (argc > 2 &&
+        (virStrToLong_ui(argv[2], NULL, 10, &iters) < 0 ||
+         iters == 0)) {
+        fprintf(stderr, "malformed iteration count '%s'\n", argv[2]);
+        return EXIT_FAILURE;
+    }
+
+    if (virThreadInitialize() < 0 ||
+        qemuTestDriverInit(&driver) < 0) {
+        fprintf(stderr, "Unable to initialize test driver\n");
+        return EXIT_FAILURE;
+    }
+    driverInitialized = true;
+
+    virEventRegisterDefaultImpl();
+
+    if (!(test = qemuMonitorTestNewSimple(true, driver.xmlopt)))
+        goto error;
+    mon = qemuMonitorTestGetMonitor(test);
+
+    if (!(trace = benchBuildTrace(nevents)))
+        goto error;
+    tracelen = strlen(trace);
+    if (VIR_ALLOC_N(scratch, tracelen + 1) < 0)
+        goto error;
+
+    if (virAllocStatsEnable() < 0)
+        goto error;
+
+    /* the IO processor is called with the monitor locked, and
+     * modifies the buffer in place, hence the scratch copy */
+    virObjectLock(mon);
+    start = benchNow();
+    for (i = 0; i < iters; i++) {
+        memcpy(scratch, trace, tracelen + 1);
+        if (qemuMonitorJSONIOProcess(mon, scratch, tracelen, NULL) !=
+            (int)tracelen) {
+            virObjectUnlock(mon);
+            fprintf(stderr, "trace replay failed at iteration %zu\n", i);
+            goto error;
+        }
+    }
+    elapsed = benchNow() - start;
+    virObjectUnlock(mon);
+
+    virAllocStatsDisable();
+    virAllocStatsWalk(benchAllocIterator, &allocs);
+
+    if (elapsed == 0)
+        elapsed = 1;
+
+    nmessages = (unsigned long long)nevents * iters;
+    printf("{ \"events\": %u, \"iters\": %u, \"traceBytes\": %zu, "
+           "\"wallUs\": %llu, \"messagesPerSec\": %llu, "
+           "\"allocsPerMessage\": %llu, \"allocBytesPerMessage\": %llu }\n",
+           nevents, iters, tracelen,
+           elapsed,
+           (nmessages * 1000ull * 1000ull) / elapsed,
+           allocs.allocs / nmessages,
+           allocs.bytes / nmessages);
+
+    ret = EXIT_SUCCESS;
+
+ cleanup:
+    VIR_FREE(scratch);
+    VIR_FREE(trace);
+    qemuMonitorTestFree(test);
+    if (driverInitialized)
+        qemuTestDriverFree(&driver);
+    return ret;
+
+ error:
+    fprintf(stderr, "%s\n", virGetLastErrorMessage());
+    goto cleanup;
+}
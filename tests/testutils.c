@@ -66,6 +66,7 @@ static unsigned int testDebug = -1;
 static unsigned int testVerbose = -1;
 static unsigned int testExpensive = -1;
 static unsigned int testRegenerate = -1;
+static unsigned int testAllocBudget = -1;
 
 #ifdef TEST_OOM
 static unsigned int testOOM;
@@ -832,6 +833,72 @@ virTestGetRegenerate(void)
     return testRegenerate;
 }
 
+unsigned int
+virTestGetAllocBudget(void)
+{
+    if (testAllocBudget == -1)
+        testAllocBudget = virTestGetFlag("VIR_TEST_ALLOC_BUDGET");
+    return testAllocBudget;
+}
+
+static void
+virTestAllocBudgetIterator(int domcode ATTRIBUTE_UNUSED,
+                           unsigned long long allocs,
+                           unsigned long long bytes ATTRIBUTE_UNUSED,
+                           void *opaque)
+{
+    unsigned long long *total = opaque;
+
+    *total += allocs;
+}
+
+/*
+ * Begin counting heap allocations made through viralloc. A no-op
+ * unless VIR_TEST_ALLOC_BUDGET is set, so budget assertions cost
+ * nothing in a normal test run.
+ */
+void
+virTestAllocBudgetStart(void)
+{
+    if (!virTestGetAllocBudget())
+        return;
+
+    ignore_value(virAllocStatsEnable());
+}
+
+/*
+ * End counting and compare against @budget, the maximum number of
+ * allocations the operation named @op is allowed to make. Budgets
+ * are deliberately set above the currently observed count so only a
+ * real regression trips them; run with VIR_TEST_DEBUG to see the
+ * observed count when re-baselining.
+ *
+ * Returns 0 if within budget (or budget checking is disabled),
+ * -1 if the budget was exceeded.
+ */
+int
+virTestAllocBudgetCheck(const char *op, unsigned long long budget)
+{
+    unsigned long long allocs = 0;
+
+    if (!virTestGetAllocBudget())
+        return 0;
+
+    virAllocStatsDisable();
+    virAllocStatsWalk(virTestAllocBudgetIterator, &allocs);
+
+    VIR_TEST_DEBUG("Allocation budget for %s: used %llu of %llu\n",
+                   op, allocs, budget);
+
+    if (allocs > budget) {
+        fprintf(stderr, "Allocation budget exceeded for %s: "
+                "%llu allocations > budget %llu\n", op, allocs, budget);
+        return -1;
+    }
+
+    return 0;
+}
+
 static int
 virTestSetEnvPath(void)
 {
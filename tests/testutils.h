@@ -82,6 +82,10 @@ unsigned int virTestGetDebug(void);
 unsigned int virTestGetVerbose(void);
 unsigned int virTestGetExpensive(void);
 unsigned int virTestGetRegenerate(void);
+unsigned int virTestGetAllocBudget(void);
+
+void virTestAllocBudgetStart(void);
+int virTestAllocBudgetCheck(const char *op, unsigned long long budget);
 
 # define VIR_TEST_DEBUG(...)                    \
     do {                                        \
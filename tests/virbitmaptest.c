@@ -664,6 +664,75 @@ test12(const void *opaque ATTRIBUTE_UNUSED)
 
 #undef TEST_MAP
 
+/* test virBitmapIntersect */
+static int
+test13(const void *opaque)
+{
+    const struct testBinaryOpData *data = opaque;
+    virBitmapPtr amap = NULL;
+    virBitmapPtr bmap = NULL;
+    virBitmapPtr resmap = NULL;
+    int ret = -1;
+
+    if (virBitmapParse(data->a, &amap, 256) < 0 ||
+        virBitmapParse(data->b, &bmap, 256) < 0 ||
+        virBitmapParse(data->res, &resmap, 256) < 0)
+        goto cleanup;
+
+    virBitmapIntersect(amap, bmap);
+
+    if (!virBitmapEqual(amap, resmap)) {
+        fprintf(stderr,
+                "\n bitmap intersection failed: intersect('%s','%s')!='%s'\n",
+                data->a, data->b, data->res);
+        goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    virBitmapFree(amap);
+    virBitmapFree(bmap);
+    virBitmapFree(resmap);
+
+    return ret;
+}
+
+/* test virBitmapUnion */
+static int
+test14(const void *opaque)
+{
+    const struct testBinaryOpData *data = opaque;
+    virBitmapPtr amap = NULL;
+    virBitmapPtr bmap = NULL;
+    virBitmapPtr resmap = NULL;
+    int ret = -1;
+
+    if (virBitmapParse(data->a, &amap, 256) < 0 ||
+        virBitmapParse(data->b, &bmap, 256) < 0 ||
+        virBitmapParse(data->res, &resmap, 256) < 0)
+        goto cleanup;
+
+    if (virBitmapUnion(amap, bmap) < 0)
+        goto cleanup;
+
+    if (!virBitmapEqual(amap, resmap)) {
+        fprintf(stderr,
+                "\n bitmap union failed: union('%s','%s')!='%s'\n",
+                data->a, data->b, data->res);
+        goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    virBitmapFree(amap);
+    virBitmapFree(bmap);
+    virBitmapFree(resmap);
+
+    return ret;
+}
+
 
 #define TESTBINARYOP(A, B, RES, FUNC)                                         \
     testBinaryOpData.a = A;                                                   \
@@ -711,6 +780,24 @@ mymain(void)
     if (virTestRun("test12", test12, NULL) < 0)
         ret = -1;
 
+    /* virBitmapIntersect */
+    virTestCounterReset("test13-");
+    TESTBINARYOP("0", "0", "0", test13);
+    TESTBINARYOP("0-3", "0", "0", test13);
+    TESTBINARYOP("0-3", "0,3", "0,3", test13);
+    TESTBINARYOP("0,^0", "0", "0,^0", test13);
+    TESTBINARYOP("0-3", "0-3", "0-3", test13);
+    TESTBINARYOP("0-3", "0,^0", "0,^0", test13);
+    TESTBINARYOP("0,2", "1,3", "0,^0", test13);
+
+    /* virBitmapUnion */
+    virTestCounterReset("test14-");
+    TESTBINARYOP("0", "0", "0", test14);
+    TESTBINARYOP("0-3", "0", "0-3", test14);
+    TESTBINARYOP("0,^0", "0", "0", test14);
+    TESTBINARYOP("0,2", "1,3", "0-3", test14);
+    TESTBINARYOP("0,^0", "0,^0", "0,^0", test14);
+
     return ret;
 }
 
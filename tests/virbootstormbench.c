@@ -0,0 +1,194 @@
+/*
+ * virbootstormbench.c: boot-storm benchmark against the test driver
+ *
+ * Copyright (C) 2016 Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Not a pass/fail test. Drives a define/start/list/stats/destroy
+ * storm of N test-driver domains through the public API and reports
+ * per-phase wall time as one JSON object, giving daemon-wide scaling
+ * work an end-to-end number to move. With the default
+ * test:///default URI everything runs in-process; point it at
+ * test+unix:///default to route the same storm through libvirtd and
+ * the RPC stack. Run via 'make bench', or directly as
+ *
+ *   virbootstormbench [NDOMAINS] [URI]
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <sys/time.h>
+
+#include "internal.h"
+#include "virerror.h"
+#include "viralloc.h"
+#include "virstring.h"
+
+#define VIR_FROM_THIS VIR_FROM_NONE
+
+
+/* Microsecond wall clock; only used for intervals */
+static unsigned long long benchNow(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return (tv.tv_sec * 1000ull * 1000ull) + tv.tv_usec;
+}
+
+
+int main(int argc, char **argv)
+{
+    virConnectPtr conn = NULL;
+    virDomainPtr *doms = NULL;
+    virDomainPtr *listed = NULL;
+    const char *uri = "test:///default";
+    unsigned long long defineUs, startUs, listUs, statsUs, destroyUs;
+    unsigned long long phasestart;
+    unsigned int ndomains = 1000;
+    size_t ndefined = 0;
+    size_t i;
+    int nlisted;
+    int ret = EXIT_FAILURE;
+
+    if (argc > 3) {
+        fprintf(stderr, "syntax: %s [NDOMAINS] [URI]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (argc > 1 &&
+        (virStrToLong_ui(argv[1], NULL, 10, &ndomains) < 0 ||
+         ndomains == 0)) {
+        fprintf(stderr, "malformed domain count '%s'\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+    if (argc > 2)
+        uri = argv[2];
+
+    if (virInitialize() < 0) {
+        fprintf(stderr, "Unable to initialize libvirt\n");
+        return EXIT_FAILURE;
+    }
+
+    if (!(conn = virConnectOpen(uri)))
+        goto error;
+
+    if (VIR_ALLOC_N(doms, ndomains) < 0)
+        goto error;
+
+    /* define phase: domain XML parse + objlist insert per domain */
+    phasestart = benchNow();
+    for (i = 0; i < ndomains; i++) {
+        char *xml;
+
+        if (virAsprintf(&xml,
+                        "<domain type='test'>"
+                        "<name>storm%zu</name>"
+                        "<memory unit='KiB'>65536</memory>"
+                        "<vcpu>1</vcpu>"
+                        "<os><type>hvm</type></os>"
+                        "</domain>", i) < 0)
+            goto error;
+
+        doms[i] = virDomainDefineXML(conn, xml);
+        VIR_FREE(xml);
+        if (!doms[i])
+            goto error;
+        ndefined++;
+    }
+    defineUs = benchNow() - phasestart;
+
+    /* start phase */
+    phasestart = benchNow();
+    for (i = 0; i < ndomains; i++) {
+        if (virDomainCreate(doms[i]) < 0)
+            goto error;
+    }
+    startUs = benchNow() - phasestart;
+
+    /* list phase: full enumeration with object conversion */
+    phasestart = benchNow();
+    if ((nlisted = virConnectListAllDomains(conn, &listed, 0)) < 0)
+        goto error;
+    listUs = benchNow() - phasestart;
+
+    for (i = 0; i < (size_t)nlisted; i++)
+        virDomainFree(listed[i]);
+    VIR_FREE(listed);
+
+    if ((size_t)nlisted < ndomains) {
+        fprintf(stderr, "listed %d domains, expected at least %u\n",
+                nlisted, ndomains);
+        goto error;
+    }
+
+    /* stats phase: per-domain info, one lookup + query each */
+    phasestart = benchNow();
+    for (i = 0; i < ndomains; i++) {
+        virDomainInfo info;
+
+        if (virDomainGetInfo(doms[i], &info) < 0)
+            goto error;
+    }
+    statsUs = benchNow() - phasestart;
+
+    /* destroy phase: stop + undefine */
+    phasestart = benchNow();
+    for (i = 0; i < ndomains; i++) {
+        if (virDomainDestroy(doms[i]) < 0 ||
+            virDomainUndefine(doms[i]) < 0)
+            goto error;
+    }
+    destroyUs = benchNow() - phasestart;
+    ndefined = 0;
+
+    printf("{ \"domains\": %u, \"uri\": \"%s\", "
+           "\"defineUs\": %llu, \"startUs\": %llu, \"listUs\": %llu, "
+           "\"statsUs\": %llu, \"destroyUs\": %llu, "
+           "\"definesPerSec\": %llu, \"startsPerSec\": %llu }\n",
+           ndomains, uri,
+           defineUs, startUs, listUs, statsUs, destroyUs,
+           (ndomains * 1000ull * 1000ull) / (defineUs ? defineUs : 1),
+           (ndomains * 1000ull * 1000ull) / (startUs ? startUs : 1));
+
+    ret = EXIT_SUCCESS;
+
+ cleanup:
+    if (doms) {
+        /* on the error path tear down whatever was defined so a
+         * daemon pointed at via the URI argument is left clean */
+        for (i = 0; i < ndefined; i++) {
+            if (virDomainIsActive(doms[i]) == 1)
+                ignore_value(virDomainDestroy(doms[i]));
+            ignore_value(virDomainUndefine(doms[i]));
+        }
+        for (i = 0; i < ndomains; i++) {
+            if (doms[i])
+                virDomainFree(doms[i]);
+        }
+    }
+    VIR_FREE(doms);
+    if (conn)
+        virConnectClose(conn);
+    return ret;
+
+ error:
+    fprintf(stderr, "%s\n", virGetLastErrorMessage());
+    goto cleanup;
+}
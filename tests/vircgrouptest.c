@@ -178,6 +178,9 @@ testCgroupDetectMounts(const void *args)
         VIR_ALLOC(group) < 0)
         goto cleanup;
 
+    for (i = 0; i < VIR_CGROUP_CONTROLLER_LAST; i++)
+        group->controllers[i].dirfd = -1;
+
     if (virCgroupDetectMountsFromFile(group, mounts, false) < 0)
         goto cleanup;
 
@@ -0,0 +1,241 @@
+/*
+ * virdomainbench.c: benchmark domain XML parsing and formatting
+ *
+ * Copyright (C) 2016 Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Not a pass/fail test. Synthesizes a production-scale domain
+ * definition (hundreds of disks and interfaces), then measures wall
+ * time and allocation counts per virDomainDefParseString and
+ * virDomainDefFormat iteration, reporting one JSON object for trend
+ * tracking. Run via 'make bench', or directly as
+ *
+ *   virdomainbench [NDEVICES] [ITERS]
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <sys/time.h>
+
+#include "testutils.h"
+#include "virerror.h"
+#include "viralloc.h"
+#include "virbuffer.h"
+#include "virstring.h"
+#include "domain_conf.h"
+
+#define VIR_FROM_THIS VIR_FROM_NONE
+
+
+/* Microsecond wall clock; only used for intervals */
+static unsigned long long benchNow(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return (tv.tv_sec * 1000ull * 1000ull) + tv.tv_usec;
+}
+
+
+/* "vda" ... "vdz", "vdaa" ... suffices for 702 disks */
+static void benchDiskTarget(size_t idx, char *dst, size_t dstlen)
+{
+    if (idx < 26)
+        snprintf(dst, dstlen, "vd%c", (char)('a' + idx));
+    else
+        snprintf(dst, dstlen, "vd%c%c",
+                 (char)('a' + (idx / 26) - 1),
+                 (char)('a' + (idx % 26)));
+}
+
+
+static char *benchBuildXML(size_t ndevices)
+{
+    virBuffer buf = VIR_BUFFER_INITIALIZER;
+    size_t ndisks = ndevices / 2;
+    size_t nnets = ndevices - ndisks;
+    size_t i;
+
+    virBufferAddLit(&buf,
+                    "<domain type='test'>\n"
+                    "  <name>bench</name>\n"
+                    "  <uuid>8369f1ac-7e46-e869-4ca5-759d51478066</uuid>\n"
+                    "  <memory unit='KiB'>8388608</memory>\n"
+                    "  <currentMemory unit='KiB'>8388608</currentMemory>\n"
+                    "  <vcpu placement='static'>16</vcpu>\n"
+                    "  <os>\n"
+                    "    <type arch='x86_64'>hvm</type>\n"
+                    "  </os>\n"
+                    "  <clock offset='utc'/>\n"
+                    "  <devices>\n");
+
+    for (i = 0; i < ndisks; i++) {
+        char target[8];
+
+        benchDiskTarget(i, target, sizeof(target));
+        virBufferAsprintf(&buf,
+                          "    <disk type='file' device='disk'>\n"
+                          "      <source file='/var/lib/bench/disk%zu.img'/>\n"
+                          "      <target dev='%s' bus='virtio'/>\n"
+                          "      <serial>bench-disk-%zu</serial>\n"
+                          "    </disk>\n",
+                          i, target, i);
+    }
+
+    for (i = 0; i < nnets; i++) {
+        virBufferAsprintf(&buf,
+                          "    <interface type='ethernet'>\n"
+                          "      <mac address='52:54:00:%02x:%02x:%02x'/>\n"
+                          "    </interface>\n",
+                          (unsigned int)(i >> 16) & 0xff,
+                          (unsigned int)(i >> 8) & 0xff,
+                          (unsigned int)i & 0xff);
+    }
+
+    virBufferAddLit(&buf,
+                    "    <console type='pty'>\n"
+                    "      <target type='lxc' port='0'/>\n"
+                    "    </console>\n"
+                    "  </devices>\n"
+                    "</domain>\n");
+
+    if (virBufferCheckError(&buf) < 0)
+        return NULL;
+
+    return virBufferContentAndReset(&buf);
+}
+
+
+struct benchAllocTotals {
+    unsigned long long allocs;
+    unsigned long long bytes;
+};
+
+static void benchAllocIterator(int domcode ATTRIBUTE_UNUSED,
+                               unsigned long long allocs,
+                               unsigned long long bytes,
+                               void *opaque)
+{
+    struct benchAllocTotals *totals = opaque;
+
+    totals->allocs += allocs;
+    totals->bytes += bytes;
+}
+
+
+int main(int argc, char **argv)
+{
+    virCapsPtr caps = NULL;
+    virDomainXMLOptionPtr xmlopt = NULL;
+    virDomainDefPtr def = NULL;
+    char *xml = NULL;
+    char *formatted = NULL;
+    struct benchAllocTotals parseAllocs = { 0, 0 };
+    struct benchAllocTotals formatAllocs = { 0, 0 };
+    unsigned long long parseUs, formatUs, start;
+    unsigned int ndevices = 100;
+    unsigned int iters = 200;
+    size_t i;
+    int ret = EXIT_FAILURE;
+
+    if (argc > 3) {
+        fprintf(stderr, "syntax: %s [NDEVICES] [ITERS]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (argc > 1 &&
+        (virStrToLong_ui(argv[1], NULL, 10, &ndevices) < 0 ||
+         ndevices == 0 || ndevices > 1400)) {
+        fprintf(stderr, "malformed device count '%s'\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+    if (argc > 2 &&
+        (virStrToLong_ui(argv[2], NULL, 10, &iters) < 0 ||
+         iters == 0)) {
+        fprintf(stderr, "malformed iteration count '%s'\n", argv[2]);
+        return EXIT_FAILURE;
+    }
+
+    if (virInitialize() < 0) {
+        fprintf(stderr, "Unable to initialize libvirt\n");
+        return EXIT_FAILURE;
+    }
+
+    if (!(caps = virTestGenericCapsInit()) ||
+        !(xmlopt = virTestGenericDomainXMLConfInit()))
+        goto error;
+
+    if (!(xml = benchBuildXML(ndevices)))
+        goto error;
+
+    /* parse */
+    if (virAllocStatsEnable() < 0)
+        goto error;
+    start = benchNow();
+    for (i = 0; i < iters; i++) {
+        if (!(def = virDomainDefParseString(xml, caps, xmlopt, NULL,
+                                            VIR_DOMAIN_DEF_PARSE_INACTIVE)))
+            goto error;
+        virDomainDefFree(def);
+        def = NULL;
+    }
+    parseUs = benchNow() - start;
+    virAllocStatsDisable();
+    virAllocStatsWalk(benchAllocIterator, &parseAllocs);
+
+    /* format; freeing the result is counted as part of the iteration */
+    if (!(def = virDomainDefParseString(xml, caps, xmlopt, NULL,
+                                        VIR_DOMAIN_DEF_PARSE_INACTIVE)))
+        goto error;
+    if (virAllocStatsEnable() < 0)
+        goto error;
+    start = benchNow();
+    for (i = 0; i < iters; i++) {
+        if (!(formatted = virDomainDefFormat(def, caps, 0)))
+            goto error;
+        VIR_FREE(formatted);
+    }
+    formatUs = benchNow() - start;
+    virAllocStatsDisable();
+    virAllocStatsWalk(benchAllocIterator, &formatAllocs);
+
+    printf("{ \"devices\": %u, \"iters\": %u, \"xmlBytes\": %zu, "
+           "\"parseUsPerIter\": %llu, \"parseAllocsPerIter\": %llu, "
+           "\"parseAllocBytesPerIter\": %llu, "
+           "\"formatUsPerIter\": %llu, \"formatAllocsPerIter\": %llu, "
+           "\"formatAllocBytesPerIter\": %llu }\n",
+           ndevices, iters, strlen(xml),
+           parseUs / iters, parseAllocs.allocs / iters,
+           parseAllocs.bytes / iters,
+           formatUs / iters, formatAllocs.allocs / iters,
+           formatAllocs.bytes / iters);
+
+    ret = EXIT_SUCCESS;
+
+ cleanup:
+    virDomainDefFree(def);
+    virObjectUnref(caps);
+    virObjectUnref(xmlopt);
+    VIR_FREE(xml);
+    return ret;
+
+ error:
+    fprintf(stderr, "%s\n", virGetLastErrorMessage());
+    goto cleanup;
+}
@@ -0,0 +1,309 @@
+/*
+ * virdomainobjlistperf.c: stress benchmark for the domain object list
+ *
+ * Copyright (C) 2016 Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Not a pass/fail test. Populates a virDomainObjList and hammers it
+ * from multiple threads with the mix of operations the drivers
+ * perform on it (UUID lookup, name lookup, full enumeration,
+ * add/remove churn), then reports ops/sec plus per-operation latency
+ * percentiles as one JSON object. Tail latency under threads is the
+ * observable cost of lock contention on the list, so locking changes
+ * have a measurable gate. Run via 'make bench', or directly as
+ *
+ *   virdomainobjlistperf [NTHREADS] [NDOMAINS] [OPS-PER-THREAD]
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <sys/time.h>
+
+#include "testutils.h"
+#include "virerror.h"
+#include "viralloc.h"
+#include "virstring.h"
+#include "virthread.h"
+#include "viruuid.h"
+#include "virdomainobjlist.h"
+
+#define VIR_FROM_THIS VIR_FROM_NONE
+
+
+/* Microsecond wall clock; only used for intervals */
+static unsigned long long benchNow(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return (tv.tv_sec * 1000ull * 1000ull) + tv.tv_usec;
+}
+
+
+struct perfWorkerData {
+    virDomainObjListPtr doms;
+    virDomainXMLOptionPtr xmlopt;
+    unsigned char (*uuids)[VIR_UUID_BUFLEN]; /* stable domains */
+    char **names;
+    size_t ndomains;
+    size_t nops;
+    size_t workerIdx;
+    unsigned long long *latencies; /* one slot per op, microseconds */
+    bool failed;
+};
+
+
+/* deterministic per-thread sequence; no libc rand_r dependency */
+static unsigned int perfNextRandom(unsigned int *state)
+{
+    *state = *state * 1103515245 + 12345;
+    return (*state >> 16) & 0x7fff;
+}
+
+
+static void perfWorker(void *opaque)
+{
+    struct perfWorkerData *data = opaque;
+    unsigned char churnUUID[VIR_UUID_BUFLEN];
+    char *churnName = NULL;
+    unsigned int rnd = 0xc0de + data->workerIdx;
+    size_t i;
+
+    data->failed = true;
+
+    /* the churn domain is private to this worker, so add/remove
+     * cycles never collide with another thread's lookups */
+    if (virUUIDGenerate(churnUUID) < 0 ||
+        virAsprintf(&churnName, "churn%zu", data->workerIdx) < 0)
+        goto cleanup;
+
+    for (i = 0; i < data->nops; i++) {
+        unsigned int op = perfNextRandom(&rnd) % 10;
+        size_t target = perfNextRandom(&rnd) % data->ndomains;
+        unsigned long long opstart = benchNow();
+        virDomainObjPtr dom;
+
+        if (op < 6) {
+            /* UUID lookup: the hot path for every RPC dispatch */
+            if (!(dom = virDomainObjListFindByUUID(data->doms,
+                                                   data->uuids[target])))
+                goto cleanup;
+            virObjectUnlock(dom);
+        } else if (op < 8) {
+            if (!(dom = virDomainObjListFindByName(data->doms,
+                                                   data->names[target])))
+                goto cleanup;
+            virObjectUnlock(dom);
+        } else if (op < 9) {
+            /* full enumeration, as done by ListAllDomains */
+            virDomainObjPtr *vms = NULL;
+            size_t nvms = 0;
+
+            if (virDomainObjListCollect(data->doms, NULL, &vms, &nvms,
+                                        NULL, 0) < 0)
+                goto cleanup;
+            virObjectListFreeCount(vms, nvms);
+        } else {
+            /* transient domain churn: define + undefine */
+            virDomainDefPtr def;
+
+            if (!(def = virDomainDefNewFull(churnName, churnUUID, -1)))
+                goto cleanup;
+            if (!(dom = virDomainObjListAdd(data->doms, def,
+                                            data->xmlopt, 0, NULL))) {
+                virDomainDefFree(def);
+                goto cleanup;
+            }
+            virDomainObjListRemove(data->doms, dom);
+        }
+
+        data->latencies[i] = benchNow() - opstart;
+    }
+
+    data->failed = false;
+
+ cleanup:
+    VIR_FREE(churnName);
+}
+
+
+static int perfCompareLatency(const void *a, const void *b)
+{
+    unsigned long long la = *(const unsigned long long *)a;
+    unsigned long long lb = *(const unsigned long long *)b;
+
+    if (la < lb)
+        return -1;
+    return la > lb;
+}
+
+
+int main(int argc, char **argv)
+{
+    virDomainXMLOptionPtr xmlopt = NULL;
+    virDomainObjListPtr doms = NULL;
+    unsigned char (*uuids)[VIR_UUID_BUFLEN] = NULL;
+    char **names = NULL;
+    virThreadPtr workers = NULL;
+    struct perfWorkerData *workerData = NULL;
+    unsigned long long *latencies = NULL;
+    unsigned long long start, elapsed;
+    unsigned int nthreads = 4;
+    unsigned int ndomains = 500;
+    unsigned int nops = 20000;
+    size_t total, nok, p99;
+    size_t i;
+    int ret = EXIT_FAILURE;
+
+    if (argc > 4) {
+        fprintf(stderr, "syntax: %s [NTHREADS] [NDOMAINS] [OPS-PER-THREAD]\n",
+                argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (argc > 1 &&
+        (virStrToLong_ui(argv[1], NULL, 10, &nthreads) < 0 ||
+         nthreads == 0)) {
+        fprintf(stderr, "malformed thread count '%s'\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+    if (argc > 2 &&
+        (virStrToLong_ui(argv[2], NULL, 10, &ndomains) < 0 ||
+         ndomains == 0)) {
+        fprintf(stderr, "malformed domain count '%s'\n", argv[2]);
+        return EXIT_FAILURE;
+    }
+    if (argc > 3 &&
+        (virStrToLong_ui(argv[3], NULL, 10, &nops) < 0 ||
+         nops == 0)) {
+        fprintf(stderr, "malformed op count '%s'\n", argv[3]);
+        return EXIT_FAILURE;
+    }
+
+    if (virInitialize() < 0) {
+        fprintf(stderr, "Unable to initialize libvirt\n");
+        return EXIT_FAILURE;
+    }
+
+    if (!(xmlopt = virTestGenericDomainXMLConfInit()))
+        goto error;
+
+    if (!(doms = virDomainObjListNew()))
+        goto error;
+
+    if (VIR_ALLOC_N(uuids, ndomains) < 0 ||
+        VIR_ALLOC_N(names, ndomains) < 0)
+        goto error;
+
+    /* stable population the lookup operations run against */
+    for (i = 0; i < ndomains; i++) {
+        virDomainDefPtr def;
+        virDomainObjPtr dom;
+
+        if (virUUIDGenerate(uuids[i]) < 0 ||
+            virAsprintf(&names[i], "perf%zu", i) < 0)
+            goto error;
+
+        if (!(def = virDomainDefNewFull(names[i], uuids[i], -1)))
+            goto error;
+        if (!(dom = virDomainObjListAdd(doms, def, xmlopt, 0, NULL))) {
+            virDomainDefFree(def);
+            goto error;
+        }
+        virObjectUnlock(dom);
+    }
+
+    total = (size_t)nthreads * nops;
+    if (VIR_ALLOC_N(latencies, total) < 0 ||
+        VIR_ALLOC_N(workers, nthreads) < 0 ||
+        VIR_ALLOC_N(workerData, nthreads) < 0)
+        goto error;
+
+    start = benchNow();
+
+    for (i = 0; i < nthreads; i++) {
+        workerData[i].doms = doms;
+        workerData[i].xmlopt = xmlopt;
+        workerData[i].uuids = uuids;
+        workerData[i].names = names;
+        workerData[i].ndomains = ndomains;
+        workerData[i].nops = nops;
+        workerData[i].workerIdx = i;
+        workerData[i].latencies = latencies + (i * nops);
+        if (virThreadCreate(&workers[i], true,
+                            perfWorker, &workerData[i]) < 0) {
+            while (i--)
+                virThreadJoin(&workers[i]);
+            goto error;
+        }
+    }
+
+    nok = 0;
+    for (i = 0; i < nthreads; i++) {
+        virThreadJoin(&workers[i]);
+        if (!workerData[i].failed)
+            nok++;
+    }
+
+    elapsed = benchNow() - start;
+
+    if (nok != nthreads) {
+        fprintf(stderr, "%zu of %u worker threads failed\n",
+                nthreads - nok, nthreads);
+        goto error;
+    }
+
+    qsort(latencies, total, sizeof(*latencies), perfCompareLatency);
+
+    p99 = (total * 99) / 100;
+    if (p99 >= total)
+        p99 = total - 1;
+
+    if (elapsed == 0)
+        elapsed = 1;
+
+    printf("{ \"threads\": %u, \"domains\": %u, \"ops\": %zu, "
+           "\"wallUs\": %llu, \"opsPerSec\": %llu, "
+           "\"p50Us\": %llu, \"p99Us\": %llu, \"maxUs\": %llu }\n",
+           nthreads, ndomains, total, elapsed,
+           (total * 1000ull * 1000ull) / elapsed,
+           latencies[total / 2],
+           latencies[p99],
+           latencies[total - 1]);
+
+    ret = EXIT_SUCCESS;
+
+ cleanup:
+    virObjectUnref(doms);
+    virObjectUnref(xmlopt);
+    if (names) {
+        for (i = 0; i < ndomains; i++)
+            VIR_FREE(names[i]);
+    }
+    VIR_FREE(names);
+    VIR_FREE(uuids);
+    VIR_FREE(latencies);
+    VIR_FREE(workers);
+    VIR_FREE(workerData);
+    return ret;
+
+ error:
+    fprintf(stderr, "%s\n", virGetLastErrorMessage());
+    goto cleanup;
+}
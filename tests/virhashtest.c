@@ -597,6 +597,62 @@ testHashEqual(const void *data ATTRIBUTE_UNUSED)
 }
 
 
+static int
+testHashStats(const void *data ATTRIBUTE_UNUSED)
+{
+    virHashTablePtr hash;
+    virHashStats stats;
+    size_t grownBuckets;
+    size_t i;
+    int ret = -1;
+
+    if (!(hash = testHashInit(1)))
+        return -1;
+
+    if (virHashGetStats(hash, &stats) < 0) {
+        VIR_TEST_VERBOSE("\nfailed to get statistics");
+        goto cleanup;
+    }
+
+    if (stats.nbElems != ARRAY_CARDINALITY(uuids) ||
+        stats.nBuckets != virHashTableSize(hash) ||
+        stats.grows == 0 ||
+        stats.maxChain == 0) {
+        VIR_TEST_VERBOSE("\nunexpected statistics for populated hash");
+        goto cleanup;
+    }
+    grownBuckets = stats.nBuckets;
+
+    for (i = 0; i < ARRAY_CARDINALITY(uuids); i++) {
+        if (virHashRemoveEntry(hash, uuids[i]) < 0) {
+            VIR_TEST_VERBOSE("\nentry \"%s\" could not be removed\n",
+                             uuids[i]);
+            goto cleanup;
+        }
+    }
+
+    if (virHashGetStats(hash, &stats) < 0) {
+        VIR_TEST_VERBOSE("\nfailed to get statistics");
+        goto cleanup;
+    }
+
+    if (stats.nbElems != 0 ||
+        stats.shrinks == 0 ||
+        stats.nBuckets >= grownBuckets ||
+        stats.emptyBuckets != stats.nBuckets ||
+        stats.maxChain != 0) {
+        VIR_TEST_VERBOSE("\ndrained hash did not shrink");
+        goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    virHashFree(hash);
+    return ret;
+}
+
+
 static int
 mymain(void)
 {
@@ -635,6 +691,7 @@ mymain(void)
     DO_TEST("Search", Search);
     DO_TEST("GetItems", GetItems);
     DO_TEST("Equal", Equal);
+    DO_TEST("Stats", Stats);
 
     return (ret == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
 }
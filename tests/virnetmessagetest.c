@@ -253,8 +253,11 @@ static int testMessagePayloadEncode(const void *args ATTRIBUTE_UNUSED)
     if (virNetMessageEncodeHeader(msg) < 0)
         goto cleanup;
 
+    virTestAllocBudgetStart();
     if (virNetMessageEncodePayload(msg, (xdrproc_t)xdr_virNetMessageError, &err) < 0)
         goto cleanup;
+    if (virTestAllocBudgetCheck("virNetMessageEncodePayload", 16) < 0)
+        goto cleanup;
 
     if (ARRAY_CARDINALITY(expect) != msg->bufferLength) {
         VIR_DEBUG("Expect message length %zu got %zu",
@@ -522,6 +525,193 @@ static int testMessagePayloadStreamEncode(const void *args ATTRIBUTE_UNUSED)
 }
 
 
+static int testMessagePayloadShared(const void *args ATTRIBUTE_UNUSED)
+{
+    virNetMessagePayloadPtr payload = NULL;
+    virNetMessagePtr msg1 = virNetMessageNew(true);
+    virNetMessagePtr msg2 = virNetMessageNew(true);
+    int body = 0x11223344;
+    int ret = -1;
+
+    if (!msg1 || !msg2)
+        goto cleanup;
+
+    if (!(payload = virNetMessagePayloadNewEncoded((xdrproc_t)xdr_int,
+                                                   &body)))
+        goto cleanup;
+
+    if (virNetMessageEncodeHeader(msg1) < 0 ||
+        virNetMessageEncodeHeader(msg2) < 0)
+        goto cleanup;
+
+    if (virNetMessageEncodePayloadShared(msg1, payload) < 0 ||
+        virNetMessageEncodePayloadShared(msg2, payload) < 0)
+        goto cleanup;
+
+    /* Both messages must borrow the same encoded body */
+    if (msg1->external != msg2->external ||
+        msg1->externalLength != 4 ||
+        msg2->externalLength != 4) {
+        VIR_DEBUG("Expected messages to share one 4 byte body%s", "");
+        goto cleanup;
+    }
+
+    if (msg1->external[0] != 0x11 ||
+        msg1->external[3] != 0x44) {
+        VIR_DEBUG("Unexpected encoded payload content%s", "");
+        goto cleanup;
+    }
+
+    /* Length word must cover buffer plus shared body */
+    if ((unsigned char)msg1->buffer[3] != msg1->bufferLength + 4) {
+        VIR_DEBUG("Expect length %zu got %d",
+                  msg1->bufferLength + 4, msg1->buffer[3]);
+        goto cleanup;
+    }
+
+    ret = 0;
+ cleanup:
+    virNetMessageFree(msg1);
+    virNetMessageFree(msg2);
+    virNetMessagePayloadUnref(payload);
+    return ret;
+}
+
+
+static int testMessageBufferPool(const void *args ATTRIBUTE_UNUSED)
+{
+    size_t want = VIR_NET_MESSAGE_INITIAL + VIR_NET_MESSAGE_LEN_MAX;
+    virNetMessagePtr msg = virNetMessageNew(true);
+    int ret = -1;
+
+    if (!msg)
+        return -1;
+
+    /* Small requests are rounded up to the standard size so the
+     * buffer can be recycled once the message is released */
+    if (virNetMessageBufferEnsure(msg, 4) < 0)
+        goto cleanup;
+
+    if (msg->bufferCapacity != want) {
+        VIR_DEBUG("Expect buffer capacity %zu got %zu",
+                  want, msg->bufferCapacity);
+        goto cleanup;
+    }
+
+    /* Growing within capacity must not move the buffer */
+    if (virNetMessageBufferEnsure(msg, want) < 0)
+        goto cleanup;
+
+    if (msg->bufferCapacity != want) {
+        VIR_DEBUG("Expect buffer capacity %zu got %zu",
+                  want, msg->bufferCapacity);
+        goto cleanup;
+    }
+
+    /* Growing beyond the standard size must track the new capacity */
+    if (virNetMessageBufferEnsure(msg, want + 1) < 0)
+        goto cleanup;
+
+    if (msg->bufferCapacity != want + 1) {
+        VIR_DEBUG("Expect buffer capacity %zu got %zu",
+                  want + 1, msg->bufferCapacity);
+        goto cleanup;
+    }
+
+    ret = 0;
+ cleanup:
+    virNetMessageFree(msg);
+    return ret;
+}
+
+
+static int testMessagePayloadStreamEncodeSteal(const void *args ATTRIBUTE_UNUSED)
+{
+    const char stream[] = "The quick brown fox jumps over the lazy dog";
+    char *buf = NULL;
+    virNetMessagePtr msg = virNetMessageNew(true);
+    struct iovec iov[2];
+    static const char expect[] = {
+        0x00, 0x00, 0x00, 0x47,  /* Length */
+        0x11, 0x22, 0x33, 0x44,  /* Program */
+        0x00, 0x00, 0x00, 0x01,  /* Version */
+        0x00, 0x00, 0x06, 0x66,  /* Procedure */
+        0x00, 0x00, 0x00, 0x03,  /* Type */
+        0x00, 0x00, 0x00, 0x99,  /* Serial */
+        0x00, 0x00, 0x00, 0x02,  /* Status */
+    };
+    int ret = -1;
+
+    if (!msg)
+        return -1;
+
+    if (VIR_STRDUP(buf, stream) < 0)
+        goto cleanup;
+
+    msg->header.prog = 0x11223344;
+    msg->header.vers = 0x01;
+    msg->header.proc = 0x666;
+    msg->header.type = VIR_NET_STREAM;
+    msg->header.serial = 0x99;
+    msg->header.status = VIR_NET_CONTINUE;
+
+    if (virNetMessageEncodeHeader(msg) < 0)
+        goto cleanup;
+
+    if (virNetMessageEncodePayloadRawSteal(msg, &buf, strlen(stream)) < 0)
+        goto cleanup;
+
+    if (buf != NULL) {
+        VIR_DEBUG("Expected payload buffer to be stolen");
+        goto cleanup;
+    }
+
+    if (ARRAY_CARDINALITY(expect) != msg->bufferLength) {
+        VIR_DEBUG("Expect message length %zu got %zu",
+                  sizeof(expect), msg->bufferLength);
+        goto cleanup;
+    }
+
+    if (memcmp(expect, msg->buffer, sizeof(expect)) != 0) {
+        virTestDifferenceBin(stderr, expect, msg->buffer, sizeof(expect));
+        goto cleanup;
+    }
+
+    if (msg->externalLength != strlen(stream) ||
+        memcmp(msg->external, stream, strlen(stream)) != 0) {
+        VIR_DEBUG("Expect external payload of %zu bytes got %zu",
+                  strlen(stream), msg->externalLength);
+        goto cleanup;
+    }
+
+    /* Header plus external payload should need two iovecs,
+     * draining across the boundary must leave one, then none */
+    if (virNetMessageGetSendIOV(msg, iov) != 2) {
+        VIR_DEBUG("Expected 2 iovec entries%s", "");
+        goto cleanup;
+    }
+
+    virNetMessageMarkSent(msg, msg->bufferLength + 3);
+    if (virNetMessageGetSendIOV(msg, iov) != 1 ||
+        iov[0].iov_len != strlen(stream) - 3) {
+        VIR_DEBUG("Unexpected iovec state after partial send%s", "");
+        goto cleanup;
+    }
+
+    virNetMessageMarkSent(msg, strlen(stream) - 3);
+    if (virNetMessageSendPending(msg)) {
+        VIR_DEBUG("Expected no pending data after full send%s", "");
+        goto cleanup;
+    }
+
+    ret = 0;
+ cleanup:
+    VIR_FREE(buf);
+    virNetMessageFree(msg);
+    return ret;
+}
+
+
 static int
 mymain(void)
 {
@@ -544,6 +734,15 @@ mymain(void)
     if (virTestRun("Message Payload Stream Encode", testMessagePayloadStreamEncode, NULL) < 0)
         ret = -1;
 
+    if (virTestRun("Message Payload Stream Encode Steal", testMessagePayloadStreamEncodeSteal, NULL) < 0)
+        ret = -1;
+
+    if (virTestRun("Message Buffer Pool", testMessageBufferPool, NULL) < 0)
+        ret = -1;
+
+    if (virTestRun("Message Payload Shared", testMessagePayloadShared, NULL) < 0)
+        ret = -1;
+
     return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
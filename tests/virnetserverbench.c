@@ -0,0 +1,335 @@
+/*
+ * virnetserverbench.c: benchmark RPC dispatch throughput and latency
+ *
+ * Copyright (C) 2016 Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * This is not a pass/fail test; it drives a private echo program
+ * through the full virNetServer/virNetClient stack over a UNIX
+ * socket and reports dispatch throughput plus latency percentiles
+ * as a single JSON object, so regressions in the RPC layer can be
+ * tracked over time. Run it via 'make bench', optionally as
+ *
+ *   virnetserverbench [NCLIENTS] [NCALLS-PER-CLIENT]
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "virerror.h"
+#include "viralloc.h"
+#include "virlog.h"
+#include "virstring.h"
+#include "virthread.h"
+#include "virevent.h"
+#include "rpc/virnetdaemon.h"
+#include "rpc/virnetserver.h"
+#include "rpc/virnetclient.h"
+#include "rpc/virnetclientprogram.h"
+
+#define VIR_FROM_THIS VIR_FROM_RPC
+
+VIR_LOG_INIT("tests.netserverbench");
+
+#define BENCH_PROGRAM 0x42454e43
+#define BENCH_PROGRAM_VERSION 1
+
+#define BENCH_PROC_ECHO 1
+
+static int benchDispatchEcho(virNetServerPtr server ATTRIBUTE_UNUSED,
+                             virNetServerClientPtr client ATTRIBUTE_UNUSED,
+                             virNetMessagePtr msg ATTRIBUTE_UNUSED,
+                             virNetMessageErrorPtr rerr ATTRIBUTE_UNUSED,
+                             void *args,
+                             void *ret)
+{
+    *((int *)ret) = *((int *)args);
+    return 0;
+}
+
+static virNetServerProgramProc benchProcs[] = {
+    { NULL, 0, NULL, 0, NULL, false, 0 }, /* proc 0 is unused */
+    { benchDispatchEcho,
+      sizeof(int), (xdrproc_t)xdr_int,
+      sizeof(int), (xdrproc_t)xdr_int,
+      false, 0 },
+};
+
+
+/* Microsecond wall clock; only used for intervals */
+static unsigned long long benchNow(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return (tv.tv_sec * 1000ull * 1000ull) + tv.tv_usec;
+}
+
+
+static void benchServerRun(void *opaque)
+{
+    virNetDaemonPtr dmn = opaque;
+
+    virNetDaemonRun(dmn);
+}
+
+
+struct benchClientData {
+    const char *sockpath;
+    size_t ncalls;
+    unsigned long long *latencies; /* one slot per call, microseconds */
+    bool failed;
+};
+
+
+static void benchClientWorker(void *opaque)
+{
+    struct benchClientData *data = opaque;
+    virNetClientPtr client = NULL;
+    virNetClientProgramPtr prog = NULL;
+    unsigned serial = 0;
+    size_t i;
+
+    data->failed = true;
+
+    if (!(client = virNetClientNewUNIX(data->sockpath, false, NULL)))
+        goto cleanup;
+
+    if (!(prog = virNetClientProgramNew(BENCH_PROGRAM,
+                                        BENCH_PROGRAM_VERSION,
+                                        NULL, 0, NULL)))
+        goto cleanup;
+
+    if (virNetClientAddProgram(client, prog) < 0)
+        goto cleanup;
+
+    for (i = 0; i < data->ncalls; i++) {
+        int arg = i;
+        int echoed = -1;
+        unsigned long long start = benchNow();
+
+        if (virNetClientProgramCall(prog, client, serial++,
+                                    BENCH_PROC_ECHO,
+                                    0, NULL, NULL, NULL,
+                                    (xdrproc_t)xdr_int, &arg,
+                                    (xdrproc_t)xdr_int, &echoed) < 0)
+            goto cleanup;
+
+        data->latencies[i] = benchNow() - start;
+
+        if (echoed != arg) {
+            VIR_WARN("Echo reply mismatch: sent %d got %d", arg, echoed);
+            goto cleanup;
+        }
+    }
+
+    data->failed = false;
+
+ cleanup:
+    if (client)
+        virNetClientClose(client);
+    virObjectUnref(prog);
+    virObjectUnref(client);
+}
+
+
+static int benchCompareLatency(const void *a, const void *b)
+{
+    unsigned long long la = *(const unsigned long long *)a;
+    unsigned long long lb = *(const unsigned long long *)b;
+
+    if (la < lb)
+        return -1;
+    return la > lb;
+}
+
+
+int main(int argc, char **argv)
+{
+    virNetDaemonPtr dmn = NULL;
+    virNetServerPtr srv = NULL;
+    virNetServerServicePtr svc = NULL;
+    virNetServerProgramPtr prog = NULL;
+    virThread serverThread;
+    bool serverRunning = false;
+    virThreadPtr clients = NULL;
+    struct benchClientData *clientData = NULL;
+    unsigned long long *latencies = NULL;
+    char *sockdir = NULL;
+    char *sockpath = NULL;
+    char template[] = "/tmp/virnetserverbench-XXXXXX";
+    unsigned int nclients = 1;
+    unsigned int ncalls = 10000;
+    unsigned long long start, elapsed;
+    size_t total, nok, p99;
+    size_t i;
+    int ret = EXIT_FAILURE;
+
+    if (argc > 3) {
+        fprintf(stderr, "syntax: %s [NCLIENTS] [NCALLS-PER-CLIENT]\n",
+                argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (argc > 1 &&
+        (virStrToLong_ui(argv[1], NULL, 10, &nclients) < 0 ||
+         nclients == 0)) {
+        fprintf(stderr, "malformed client count '%s'\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+    if (argc > 2 &&
+        (virStrToLong_ui(argv[2], NULL, 10, &ncalls) < 0 ||
+         ncalls == 0)) {
+        fprintf(stderr, "malformed call count '%s'\n", argv[2]);
+        return EXIT_FAILURE;
+    }
+
+    if (virInitialize() < 0) {
+        fprintf(stderr, "Unable to initialize libvirt\n");
+        return EXIT_FAILURE;
+    }
+    virEventRegisterDefaultImpl();
+
+    if (!(sockdir = mkdtemp(template))) {
+        perror("mkdtemp");
+        return EXIT_FAILURE;
+    }
+    if (virAsprintf(&sockpath, "%s/bench.sock", sockdir) < 0)
+        goto cleanup;
+
+    if (!(dmn = virNetDaemonNew()))
+        goto error;
+
+    if (!(srv = virNetServerNew("bench", 1,
+                                nclients, nclients, 0,
+                                nclients + 1, 0,
+                                -1, 0,
+                                NULL,
+                                NULL, NULL, NULL, NULL)))
+        goto error;
+
+    if (virNetDaemonAddServer(dmn, srv) < 0)
+        goto error;
+
+    if (!(svc = virNetServerServiceNewUNIX(sockpath,
+                                           0700, getgid(),
+                                           VIR_NET_SERVER_SERVICE_AUTH_NONE,
+#if WITH_GNUTLS
+                                           NULL,
+#endif
+                                           false,
+                                           nclients + 1,
+                                           10)))
+        goto error;
+
+    if (virNetServerAddService(srv, svc, NULL) < 0)
+        goto error;
+
+    if (!(prog = virNetServerProgramNew(BENCH_PROGRAM,
+                                        BENCH_PROGRAM_VERSION,
+                                        benchProcs,
+                                        ARRAY_CARDINALITY(benchProcs))))
+        goto error;
+
+    if (virNetServerAddProgram(srv, prog) < 0)
+        goto error;
+
+    if (virThreadCreate(&serverThread, true, benchServerRun, dmn) < 0)
+        goto error;
+    serverRunning = true;
+
+    total = (size_t)nclients * ncalls;
+    if (VIR_ALLOC_N(latencies, total) < 0 ||
+        VIR_ALLOC_N(clients, nclients) < 0 ||
+        VIR_ALLOC_N(clientData, nclients) < 0)
+        goto error;
+
+    start = benchNow();
+
+    for (i = 0; i < nclients; i++) {
+        clientData[i].sockpath = sockpath;
+        clientData[i].ncalls = ncalls;
+        clientData[i].latencies = latencies + (i * ncalls);
+        if (virThreadCreate(&clients[i], true,
+                            benchClientWorker, &clientData[i]) < 0) {
+            while (i--)
+                virThreadJoin(&clients[i]);
+            goto error;
+        }
+    }
+
+    nok = 0;
+    for (i = 0; i < nclients; i++) {
+        virThreadJoin(&clients[i]);
+        if (!clientData[i].failed)
+            nok++;
+    }
+
+    elapsed = benchNow() - start;
+
+    if (nok != nclients) {
+        fprintf(stderr, "%zu of %u clients failed\n",
+                nclients - nok, nclients);
+        goto error;
+    }
+
+    qsort(latencies, total, sizeof(*latencies), benchCompareLatency);
+
+    p99 = (total * 99) / 100;
+    if (p99 >= total)
+        p99 = total - 1;
+
+    if (elapsed == 0)
+        elapsed = 1;
+
+    printf("{ \"proc\": \"echo\", \"clients\": %u, \"calls\": %zu, "
+           "\"wallUs\": %llu, \"callsPerSec\": %llu, "
+           "\"p50Us\": %llu, \"p99Us\": %llu, \"maxUs\": %llu }\n",
+           nclients, total, elapsed,
+           (total * 1000ull * 1000ull) / elapsed,
+           latencies[total / 2],
+           latencies[p99],
+           latencies[total - 1]);
+
+    ret = EXIT_SUCCESS;
+
+ cleanup:
+    if (serverRunning) {
+        virNetDaemonQuit(dmn);
+        virThreadJoin(&serverThread);
+    }
+    virObjectUnref(prog);
+    virObjectUnref(svc);
+    virObjectUnref(srv);
+    virObjectUnref(dmn);
+    VIR_FREE(latencies);
+    VIR_FREE(clients);
+    VIR_FREE(clientData);
+    if (sockpath)
+        unlink(sockpath);
+    rmdir(sockdir);
+    VIR_FREE(sockpath);
+    return ret;
+
+ error:
+    fprintf(stderr, "%s\n", virGetLastErrorMessage());
+    goto cleanup;
+}
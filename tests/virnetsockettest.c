@@ -373,6 +373,7 @@ struct testSSHData {
     const char *username;
     bool noTTY;
     bool noVerify;
+    bool compress;
     const char *netcat;
     const char *keyfile;
     const char *path;
@@ -395,6 +396,7 @@ static int testSocketSSH(const void *opaque)
                                   data->username,
                                   data->noTTY,
                                   data->noVerify,
+                                  data->compress,
                                   data->netcat,
                                   data->keyfile,
                                   data->path,
@@ -527,8 +529,9 @@ mymain(void)
         .netcat = "netcat",
         .noTTY = false,
         .noVerify = true,
+        .compress = true,
         .path = "/tmp/socket",
-        .expectOut = "-p 9000 -l fred -o StrictHostKeyChecking=no somehost sh -c '"
+        .expectOut = "-p 9000 -l fred -o StrictHostKeyChecking=no -C somehost sh -c '"
                      "if 'netcat' -q 2>&1 | grep \"requires an argument\" >/dev/null 2>&1; then "
                          "ARG=-q0;"
                      "else "
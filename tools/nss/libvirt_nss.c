@@ -128,6 +128,11 @@ findLease(const char *name,
     }
 
 
+    if ((currtime = time(NULL)) == (time_t) - 1) {
+        ERROR("Failed to get current system time");
+        goto cleanup;
+    }
+
     if (virDirOpenQuiet(&dir, leaseDir) < 0) {
         ERROR("Failed to open dir '%s'", leaseDir);
         goto cleanup;
@@ -141,6 +146,8 @@ findLease(const char *name,
     DEBUG("Dir: %s", leaseDir);
     while ((ret = virDirRead(dir, &entry, leaseDir)) > 0) {
         char *path;
+        virLeaseIndexRecordPtr recs = NULL;
+        size_t nrecs = 0;
 
         if (!virFileHasSuffix(entry->d_name, ".status"))
             continue;
@@ -150,6 +157,46 @@ findLease(const char *name,
 
         DEBUG("Processing %s", path);
 
+        /* Prefer the binary index maintained by leaseshelper; it is
+         * binary searched with no parsing at all */
+        if (virLeaseIndexLookup(path, name, &recs, &nrecs) == 0) {
+            size_t j;
+
+            DEBUG("Found %zu indexed records in %s", nrecs, path);
+            VIR_FREE(path);
+
+            for (j = 0; j < nrecs; j++) {
+                /* Do not report expired lease */
+                if (recs[j].expirytime < (long long) currtime) {
+                    DEBUG("Skipping expired lease for %s", name);
+                    continue;
+                }
+
+                *found = true;
+
+                if (af != AF_UNSPEC && af != recs[j].family) {
+                    DEBUG("Skipping address which family is %d, %d requested",
+                          recs[j].family, af);
+                    continue;
+                }
+
+                if (VIR_REALLOC_N_QUIET(tmpAddress, ntmpAddress + 1) < 0) {
+                    ERROR("Out of memory");
+                    VIR_FREE(recs);
+                    goto cleanup;
+                }
+
+                tmpAddress[ntmpAddress].af = recs[j].family;
+                memcpy(tmpAddress[ntmpAddress].addr, recs[j].addr,
+                       FAMILY_ADDRESS_SIZE(recs[j].family));
+                ntmpAddress++;
+            }
+
+            VIR_FREE(recs);
+            continue;
+        }
+
+        /* No usable index; fall back to parsing the JSON file */
         if (virLeaseReadCustomLeaseFile(leases_array, path, NULL, NULL) < 0) {
             ERROR("Unable to parse %s", path);
             VIR_FREE(path);
@@ -164,11 +211,6 @@ findLease(const char *name,
     nleases = virJSONValueArraySize(leases_array);
     DEBUG("Read %zd leases", nleases);
 
-    if ((currtime = time(NULL)) == (time_t) - 1) {
-        ERROR("Failed to get current system time");
-        goto cleanup;
-    }
-
     for (i = 0; i < nleases; i++) {
         virJSONValuePtr lease;
         const char *lease_name;
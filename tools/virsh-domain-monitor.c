@@ -26,6 +26,8 @@
 #include <config.h>
 #include "virsh-domain-monitor.h"
 
+#include <signal.h>
+
 #include <libxml/parser.h>
 #include <libxml/tree.h>
 #include <libxml/xpath.h>
@@ -35,6 +37,7 @@
 #include "conf/virdomainobjlist.h"
 #include "intprops.h"
 #include "viralloc.h"
+#include "virhash.h"
 #include "virmacaddr.h"
 #include "virsh-domain.h"
 #include "virxml.h"
@@ -1797,6 +1800,10 @@ static const vshCmdOptDef opts_list[] = {
      .type = VSH_OT_BOOL,
      .help = N_("show domain title")
     },
+    {.name = "limit",
+     .type = VSH_OT_INT,
+     .help = N_("list at most this many domains")
+    },
     {.name = NULL}
 };
 
@@ -1820,6 +1827,8 @@ cmdList(vshControl *ctl, const vshCmd *cmd)
     virDomainPtr dom;
     char id_buf[INT_BUFSIZE_BOUND(unsigned int)];
     unsigned int id;
+    unsigned int limit = 0;
+    unsigned int nprinted = 0;
     unsigned int flags = VIR_CONNECT_LIST_DOMAINS_ACTIVE;
 
     /* construct filter flags */
@@ -1854,6 +1863,9 @@ cmdList(vshControl *ctl, const vshCmd *cmd)
     if (!optUUID && !optName)
         optTable = true;
 
+    if (vshCommandOptUInt(ctl, cmd, "limit", &limit) < 0)
+        goto cleanup;
+
     if (!(list = virshDomainListCollect(ctl, flags)))
         goto cleanup;
 
@@ -1872,6 +1884,12 @@ cmdList(vshControl *ctl, const vshCmd *cmd)
     }
 
     for (i = 0; i < list->ndomains; i++) {
+        /* The per-row state and title lookups below are a round trip
+         * each for remote connections, so stop as soon as we have
+         * enough rows rather than after formatting everything */
+        if (limit && nprinted >= limit)
+            break;
+
         dom = list->domains[i];
         id = virDomainGetID(dom);
         if (id != (unsigned int) -1)
@@ -1922,6 +1940,8 @@ cmdList(vshControl *ctl, const vshCmd *cmd)
         } else if (optName) {
             vshPrint(ctl, "%s\n", virDomainGetName(dom));
         }
+
+        nprinted++;
     }
 
     ret = true;
@@ -2017,6 +2037,15 @@ static const vshCmdOptDef opts_domstats[] = {
      .type = VSH_OT_BOOL,
      .help = N_("add backing chain information to block stats"),
     },
+    {.name = "watch",
+     .type = VSH_OT_BOOL,
+     .help = N_("repeat the query and print only stats that changed"),
+    },
+    {.name = "interval",
+     .type = VSH_OT_INT,
+     .flags = VSH_OFLAG_REQ_OPT,
+     .help = N_("seconds between samples with --watch (default 1)"),
+    },
     {.name = "domain",
      .type = VSH_OT_ARGV,
      .flags = VSH_OFLAG_NONE,
@@ -2026,15 +2055,33 @@ static const vshCmdOptDef opts_domstats[] = {
 };
 
 
+/* Interrupt handling for the --watch loop of "domstats" */
+static volatile sig_atomic_t virshDomstatsInterrupted;
+
+static void
+virshDomstatsCatchInt(int sig ATTRIBUTE_UNUSED,
+                      siginfo_t *siginfo ATTRIBUTE_UNUSED,
+                      void *context ATTRIBUTE_UNUSED)
+{
+    virshDomstatsInterrupted = 1;
+}
+
 static bool
 virshDomainStatsPrintRecord(vshControl *ctl ATTRIBUTE_UNUSED,
                             virDomainStatsRecordPtr record,
+                            virHashTablePtr prev,
                             bool raw ATTRIBUTE_UNUSED)
 {
+    const char *name = virDomainGetName(record->dom);
+    bool printed = false;
     char *param;
+    char *key;
     size_t i;
 
-    vshPrint(ctl, "Domain: '%s'\n", virDomainGetName(record->dom));
+    if (!prev) {
+        vshPrint(ctl, "Domain: '%s'\n", name);
+        printed = true;
+    }
 
     /* XXX: Implement pretty-printing */
 
@@ -2042,12 +2089,46 @@ virshDomainStatsPrintRecord(vshControl *ctl ATTRIBUTE_UNUSED,
         if (!(param = vshGetTypedParamValue(ctl, record->params + i)))
             return false;
 
-        vshPrint(ctl, "  %s=%s\n", record->params[i].field, param);
+        if (prev) {
+            /* Print only the fields which differ from the previous
+             * sample and remember the new values; the table owns the
+             * stored strings */
+            const char *old;
 
-        VIR_FREE(param);
+            if (virAsprintf(&key, "%s.%s", name,
+                            record->params[i].field) < 0) {
+                VIR_FREE(param);
+                return false;
+            }
+
+            old = virHashLookup(prev, key);
+            if (old && STREQ(old, param)) {
+                VIR_FREE(key);
+                VIR_FREE(param);
+                continue;
+            }
+
+            if (virHashUpdateEntry(prev, key, param) < 0) {
+                VIR_FREE(key);
+                VIR_FREE(param);
+                return false;
+            }
+            VIR_FREE(key);
+
+            if (!printed) {
+                vshPrint(ctl, "Domain: '%s'\n", name);
+                printed = true;
+            }
+
+            vshPrint(ctl, "  %s=%s\n", record->params[i].field, param);
+        } else {
+            vshPrint(ctl, "  %s=%s\n", record->params[i].field, param);
+            VIR_FREE(param);
+        }
     }
 
-    vshPrint(ctl, "\n");
+    if (printed)
+        vshPrint(ctl, "\n");
     return true;
 }
 
@@ -2061,11 +2142,27 @@ cmdDomstats(vshControl *ctl, const vshCmd *cmd)
     virDomainStatsRecordPtr *records = NULL;
     virDomainStatsRecordPtr *next;
     bool raw = vshCommandOptBool(cmd, "raw");
+    bool watch = vshCommandOptBool(cmd, "watch");
+    unsigned int interval = 1;
+    virHashTablePtr prev = NULL;
+    struct sigaction sig_action;
+    struct sigaction old_sig_action;
+    bool sig_installed = false;
     int flags = 0;
     const vshCmdOpt *opt = NULL;
     bool ret = false;
     virshControlPtr priv = ctl->privData;
 
+    VSH_REQUIRE_OPTION("interval", "watch");
+
+    if (vshCommandOptUInt(ctl, cmd, "interval", &interval) < 0)
+        return false;
+
+    if (interval == 0) {
+        vshError(ctl, "%s", _("--interval must be non-zero"));
+        return false;
+    }
+
     if (vshCommandOptBool(cmd, "state"))
         stats |= VIR_DOMAIN_STATS_STATE;
 
@@ -2131,27 +2228,61 @@ cmdDomstats(vshControl *ctl, const vshCmd *cmd)
             if (VIR_INSERT_ELEMENT(domlist, ndoms - 1, ndoms, dom) < 0)
                 goto cleanup;
         }
+    }
 
-        if (virDomainListGetStats(domlist,
-                                  stats,
-                                  &records,
-                                  flags) < 0)
+    if (watch) {
+        if (!(prev = virHashCreate(256, virHashValueFree)))
             goto cleanup;
-    } else {
-       if ((virConnectGetAllDomainStats(priv->conn,
-                                        stats,
-                                        &records,
-                                        flags)) < 0)
-           goto cleanup;
+
+        virshDomstatsInterrupted = 0;
+        sig_action.sa_sigaction = virshDomstatsCatchInt;
+        sig_action.sa_flags = SA_SIGINFO;
+        sigemptyset(&sig_action.sa_mask);
+        sigaction(SIGINT, &sig_action, &old_sig_action);
+        sig_installed = true;
     }
 
-    for (next = records; *next; next++) {
-        if (!virshDomainStatsPrintRecord(ctl, *next, raw))
-            goto cleanup;
+    /* The domain list and the connection are reused across samples, so
+     * watching costs one batched stats call per interval rather than a
+     * full virsh invocation */
+    for (;;) {
+        if (domlist) {
+            if (virDomainListGetStats(domlist,
+                                      stats,
+                                      &records,
+                                      flags) < 0)
+                goto cleanup;
+        } else {
+           if ((virConnectGetAllDomainStats(priv->conn,
+                                            stats,
+                                            &records,
+                                            flags)) < 0)
+               goto cleanup;
+        }
+
+        for (next = records; *next; next++) {
+            if (!virshDomainStatsPrintRecord(ctl, *next, prev, raw))
+                goto cleanup;
+        }
+
+        virDomainStatsRecordListFree(records);
+        records = NULL;
+
+        if (!watch || virshDomstatsInterrupted)
+            break;
+
+        /* sleep() is cut short by SIGINT, so ^C stays responsive */
+        sleep(interval);
+
+        if (virshDomstatsInterrupted)
+            break;
     }
 
     ret = true;
  cleanup:
+    if (sig_installed)
+        sigaction(SIGINT, &old_sig_action, NULL);
+    virHashFree(prev);
     virDomainStatsRecordListFree(records);
     virObjectListFree(domlist);
 
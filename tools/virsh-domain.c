@@ -3976,7 +3976,6 @@ static const vshCmdInfo info_start[] = {
 };
 
 static const vshCmdOptDef opts_start[] = {
-    VIRSH_COMMON_OPT_DOMAIN(N_("name of the inactive domain")),
 #ifndef WIN32
     {.name = "console",
      .type = VSH_OT_BOOL,
@@ -4001,8 +4000,14 @@ static const vshCmdOptDef opts_start[] = {
     },
     {.name = "pass-fds",
      .type = VSH_OT_STRING,
+     .flags = VSH_OFLAG_REQ_OPT,
      .help = N_("pass file descriptors N,M,... to the guest")
     },
+    {.name = "domain",
+     .type = VSH_OT_ARGV,
+     .flags = VSH_OFLAG_REQ,
+     .help = N_("name of the inactive domain")
+    },
     {.name = NULL}
 };
 
@@ -4055,39 +4060,17 @@ cmdStartGetFDs(vshControl *ctl,
 }
 
 static bool
-cmdStart(vshControl *ctl, const vshCmd *cmd)
+cmdStartOne(vshControl *ctl, virDomainPtr dom, unsigned int flags,
+            size_t nfds, int *fds)
 {
-    virDomainPtr dom;
-    bool ret = false;
-#ifndef WIN32
-    bool console = vshCommandOptBool(cmd, "console");
-#endif
-    unsigned int flags = VIR_DOMAIN_NONE;
     int rc;
-    size_t nfds = 0;
-    int *fds = NULL;
-
-    if (!(dom = virshCommandOptDomainBy(ctl, cmd, NULL,
-                                        VIRSH_BYNAME | VIRSH_BYUUID)))
-        return false;
 
     if (virDomainGetID(dom) != (unsigned int)-1) {
-        vshError(ctl, "%s", _("Domain is already active"));
-        goto cleanup;
+        vshError(ctl, _("Domain %s is already active"),
+                 virDomainGetName(dom));
+        return false;
     }
 
-    if (cmdStartGetFDs(ctl, cmd, &nfds, &fds) < 0)
-        goto cleanup;
-
-    if (vshCommandOptBool(cmd, "paused"))
-        flags |= VIR_DOMAIN_START_PAUSED;
-    if (vshCommandOptBool(cmd, "autodestroy"))
-        flags |= VIR_DOMAIN_START_AUTODESTROY;
-    if (vshCommandOptBool(cmd, "bypass-cache"))
-        flags |= VIR_DOMAIN_START_BYPASS_CACHE;
-    if (vshCommandOptBool(cmd, "force-boot"))
-        flags |= VIR_DOMAIN_START_FORCE_BOOT;
-
     /* We can emulate force boot, even for older servers that reject it.  */
     if (flags & VIR_DOMAIN_START_FORCE_BOOT) {
         if ((nfds ?
@@ -4097,7 +4080,7 @@ cmdStart(vshControl *ctl, const vshCmd *cmd)
         if (last_error->code != VIR_ERR_NO_SUPPORT &&
             last_error->code != VIR_ERR_INVALID_ARG) {
             vshReportError(ctl);
-            goto cleanup;
+            return false;
         }
         vshResetLibvirtError();
         rc = virDomainHasManagedSaveImage(dom, 0);
@@ -4107,7 +4090,7 @@ cmdStart(vshControl *ctl, const vshCmd *cmd)
         } else if (rc > 0) {
             if (virDomainManagedSaveRemove(dom, 0) < 0) {
                 vshReportError(ctl);
-                goto cleanup;
+                return false;
             }
         }
         flags &= ~VIR_DOMAIN_START_FORCE_BOOT;
@@ -4118,21 +4101,70 @@ cmdStart(vshControl *ctl, const vshCmd *cmd)
          (flags ? virDomainCreateWithFlags(dom, flags)
           : virDomainCreate(dom))) < 0) {
         vshError(ctl, _("Failed to start domain %s"), virDomainGetName(dom));
-        goto cleanup;
+        return false;
     }
 
  started:
     vshPrintExtra(ctl, _("Domain %s started\n"),
                   virDomainGetName(dom));
+    return true;
+}
+
+static bool
+cmdStart(vshControl *ctl, const vshCmd *cmd)
+{
+    virDomainPtr dom;
+    bool ret = true;
 #ifndef WIN32
-    if (console && !cmdRunConsole(ctl, dom, NULL, 0))
-        goto cleanup;
+    bool console = vshCommandOptBool(cmd, "console");
 #endif
+    unsigned int flags = VIR_DOMAIN_NONE;
+    size_t nfds = 0;
+    int *fds = NULL;
+    const vshCmdOpt *opt = NULL;
 
-    ret = true;
+    if (cmdStartGetFDs(ctl, cmd, &nfds, &fds) < 0)
+        return false;
+
+    if (vshCommandOptBool(cmd, "paused"))
+        flags |= VIR_DOMAIN_START_PAUSED;
+    if (vshCommandOptBool(cmd, "autodestroy"))
+        flags |= VIR_DOMAIN_START_AUTODESTROY;
+    if (vshCommandOptBool(cmd, "bypass-cache"))
+        flags |= VIR_DOMAIN_START_BYPASS_CACHE;
+    if (vshCommandOptBool(cmd, "force-boot"))
+        flags |= VIR_DOMAIN_START_FORCE_BOOT;
+
+#ifndef WIN32
+    if (console &&
+        vshCommandOptArgv(ctl, cmd,
+                          vshCommandOptArgv(ctl, cmd, NULL))) {
+        vshError(ctl, "%s",
+                 _("--console cannot be used with multiple domains"));
+        VIR_FREE(fds);
+        return false;
+    }
+#endif
+
+    while ((opt = vshCommandOptArgv(ctl, cmd, opt))) {
+        if (!(dom = virshLookupDomainBy(ctl, opt->data,
+                                        VIRSH_BYNAME | VIRSH_BYUUID))) {
+            ret = false;
+            continue;
+        }
+
+        if (!cmdStartOne(ctl, dom, flags, nfds, fds)) {
+            ret = false;
+        }
+#ifndef WIN32
+        else if (console && !cmdRunConsole(ctl, dom, NULL, 0)) {
+            ret = false;
+        }
+#endif
+
+        virDomainFree(dom);
+    }
 
- cleanup:
-    virDomainFree(dom);
     VIR_FREE(fds);
     return ret;
 }
@@ -5502,11 +5534,16 @@ static const vshCmdInfo info_shutdown[] = {
 };
 
 static const vshCmdOptDef opts_shutdown[] = {
-    VIRSH_COMMON_OPT_DOMAIN_FULL,
     {.name = "mode",
      .type = VSH_OT_STRING,
+     .flags = VSH_OFLAG_REQ_OPT,
      .help = N_("shutdown mode: acpi|agent|initctl|signal|paravirt")
     },
+    {.name = "domain",
+     .type = VSH_OT_ARGV,
+     .flags = VSH_OFLAG_REQ,
+     .help = N_("domain name, id or uuid")
+    },
     {.name = NULL}
 };
 
@@ -5514,12 +5551,12 @@ static bool
 cmdShutdown(vshControl *ctl, const vshCmd *cmd)
 {
     virDomainPtr dom = NULL;
-    bool ret = false;
-    const char *name;
+    bool ret = true;
     const char *mode = NULL;
     int flags = 0;
     int rv;
     char **modes = NULL, **tmp;
+    const vshCmdOpt *opt = NULL;
 
     if (vshCommandOptStringReq(ctl, cmd, "mode", &mode) < 0)
         return false;
@@ -5546,29 +5583,37 @@ cmdShutdown(vshControl *ctl, const vshCmd *cmd)
             vshError(ctl, _("Unknown mode %s value, expecting "
                             "'acpi', 'agent', 'initctl', 'signal', "
                             "or 'paravirt'"), mode);
+            ret = false;
             goto cleanup;
         }
         tmp++;
     }
 
-    if (!(dom = virshCommandOptDomain(ctl, cmd, &name)))
-        goto cleanup;
+    /* All domains are handled over the one shared connection, so
+     * shutting down a whole group doesn't pay connection setup and
+     * authentication once per guest */
+    while ((opt = vshCommandOptArgv(ctl, cmd, opt))) {
+        if (!(dom = virshLookupDomainBy(ctl, opt->data,
+                                        VIRSH_BYID | VIRSH_BYUUID |
+                                        VIRSH_BYNAME))) {
+            ret = false;
+            continue;
+        }
 
-    if (flags)
-        rv = virDomainShutdownFlags(dom, flags);
-    else
-        rv = virDomainShutdown(dom);
-    if (rv == 0) {
-        vshPrintExtra(ctl, _("Domain %s is being shutdown\n"), name);
-    } else {
-        vshError(ctl, _("Failed to shutdown domain %s"), name);
-        goto cleanup;
+        if (flags)
+            rv = virDomainShutdownFlags(dom, flags);
+        else
+            rv = virDomainShutdown(dom);
+        if (rv == 0) {
+            vshPrintExtra(ctl, _("Domain %s is being shutdown\n"), opt->data);
+        } else {
+            vshError(ctl, _("Failed to shutdown domain %s"), opt->data);
+            ret = false;
+        }
+        virDomainFree(dom);
     }
 
-    ret = true;
  cleanup:
-    if (dom)
-        virDomainFree(dom);
     virStringFreeList(modes);
     return ret;
 }
@@ -7842,11 +7887,15 @@ static const vshCmdInfo info_destroy[] = {
 };
 
 static const vshCmdOptDef opts_destroy[] = {
-    VIRSH_COMMON_OPT_DOMAIN_FULL,
     {.name = "graceful",
      .type = VSH_OT_BOOL,
      .help = N_("terminate gracefully")
     },
+    {.name = "domain",
+     .type = VSH_OT_ARGV,
+     .flags = VSH_OFLAG_REQ,
+     .help = N_("domain name, id or uuid")
+    },
     {.name = NULL}
 };
 
@@ -7855,29 +7904,36 @@ cmdDestroy(vshControl *ctl, const vshCmd *cmd)
 {
     virDomainPtr dom;
     bool ret = true;
-    const char *name;
     unsigned int flags = 0;
     int result;
-
-    if (!(dom = virshCommandOptDomain(ctl, cmd, &name)))
-        return false;
+    const vshCmdOpt *opt = NULL;
 
     if (vshCommandOptBool(cmd, "graceful"))
        flags |= VIR_DOMAIN_DESTROY_GRACEFUL;
 
-    if (flags)
-       result = virDomainDestroyFlags(dom, VIR_DOMAIN_DESTROY_GRACEFUL);
-    else
-       result = virDomainDestroy(dom);
+    while ((opt = vshCommandOptArgv(ctl, cmd, opt))) {
+        if (!(dom = virshLookupDomainBy(ctl, opt->data,
+                                        VIRSH_BYID | VIRSH_BYUUID |
+                                        VIRSH_BYNAME))) {
+            ret = false;
+            continue;
+        }
 
-    if (result == 0) {
-        vshPrintExtra(ctl, _("Domain %s destroyed\n"), name);
-    } else {
-        vshError(ctl, _("Failed to destroy domain %s"), name);
-        ret = false;
+        if (flags)
+           result = virDomainDestroyFlags(dom, VIR_DOMAIN_DESTROY_GRACEFUL);
+        else
+           result = virDomainDestroy(dom);
+
+        if (result == 0) {
+            vshPrintExtra(ctl, _("Domain %s destroyed\n"), opt->data);
+        } else {
+            vshError(ctl, _("Failed to destroy domain %s"), opt->data);
+            ret = false;
+        }
+
+        virDomainFree(dom);
     }
 
-    virDomainFree(dom);
     return ret;
 }
 
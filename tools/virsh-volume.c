@@ -762,6 +762,10 @@ static const vshCmdOptDef opts_vol_download[] = {
      .type = VSH_OT_INT,
      .help = N_("amount of data to download")
     },
+    {.name = "sparse",
+     .type = VSH_OT_BOOL,
+     .help = N_("write runs of zeroes as holes in the output file")
+    },
     {.name = NULL}
 };
 
@@ -776,6 +780,8 @@ cmdVolDownload(vshControl *ctl, const vshCmd *cmd)
     const char *name = NULL;
     unsigned long long offset = 0, length = 0;
     bool created = false;
+    bool sparse = vshCommandOptBool(cmd, "sparse");
+    virshStreamSinkSparseData sparseData = { .fd = -1, .offset = 0 };
     virshControlPtr priv = ctl->privData;
 
     if (vshCommandOptULongLong(ctl, cmd, "offset", &offset) < 0)
@@ -810,9 +816,26 @@ cmdVolDownload(vshControl *ctl, const vshCmd *cmd)
         goto cleanup;
     }
 
-    if (virStreamRecvAll(st, virshStreamSink, &fd) < 0) {
-        vshError(ctl, _("cannot receive data from volume %s"), name);
-        goto cleanup;
+    if (sparse) {
+        sparseData.fd = fd;
+        if (virStreamRecvAll(st, virshStreamSinkSparse, &sparseData) < 0) {
+            vshError(ctl, _("cannot receive data from volume %s"), name);
+            goto cleanup;
+        }
+
+        /* The transfer may have ended with a run of zeroes that was
+         * seeked over rather than written; set the file size to
+         * cover it */
+        if (ftruncate(fd, sparseData.offset) < 0) {
+            vshError(ctl, _("cannot resize %s"), file);
+            virStreamAbort(st);
+            goto cleanup;
+        }
+    } else {
+        if (virStreamRecvAll(st, virshStreamSink, &fd) < 0) {
+            vshError(ctl, _("cannot receive data from volume %s"), name);
+            goto cleanup;
+        }
     }
 
     if (VIR_CLOSE(fd) < 0) {
@@ -265,6 +265,28 @@ int virshStreamSink(virStreamPtr st ATTRIBUTE_UNUSED,
     return safewrite(*fd, bytes, nbytes);
 }
 
+int virshStreamSinkSparse(virStreamPtr st ATTRIBUTE_UNUSED,
+                          const char *bytes, size_t nbytes, void *opaque)
+{
+    virshStreamSinkSparseDataPtr data = opaque;
+
+    /* Runs of zeroes are seeked over instead of written out, so they
+     * end up as holes in the output file. The caller is responsible
+     * for ftruncating the file to @offset afterwards in case the
+     * data ends in such a hole. */
+    if (nbytes && bytes[0] == '\0' &&
+        memcmp(bytes, bytes + 1, nbytes - 1) == 0) {
+        if (lseek(data->fd, nbytes, SEEK_CUR) == (off_t) -1)
+            return -1;
+    } else {
+        if (safewrite(data->fd, bytes, nbytes) < 0)
+            return -1;
+    }
+
+    data->offset += nbytes;
+    return nbytes;
+}
+
 /* ---------------
  * Command Connect
  * ---------------
@@ -150,4 +150,14 @@ int virshDomainState(vshControl *ctl, virDomainPtr dom, int *reason);
 int virshStreamSink(virStreamPtr st, const char *bytes, size_t nbytes,
                     void *opaque);
 
+typedef struct _virshStreamSinkSparseData virshStreamSinkSparseData;
+typedef virshStreamSinkSparseData *virshStreamSinkSparseDataPtr;
+struct _virshStreamSinkSparseData {
+    int fd;
+    unsigned long long offset;  /* how much data has been received */
+};
+
+int virshStreamSinkSparse(virStreamPtr st, const char *bytes, size_t nbytes,
+                          void *opaque);
+
 #endif /* VIRSH_H */
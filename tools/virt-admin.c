@@ -39,6 +39,7 @@
 #include "virthread.h"
 #include "virgettext.h"
 #include "virtime.h"
+#include "virtypedparam.h"
 
 /* Gnulib doesn't guarantee SA_SIGINFO support.  */
 #ifndef SA_SIGINFO
@@ -457,8 +458,14 @@ cmdSrvThreadpoolInfo(vshControl *ctl, const vshCmd *cmd)
         goto cleanup;
     }
 
-    for (i = 0; i < nparams; i++)
-        vshPrint(ctl, "%-15s: %u\n", params[i].field, params[i].value.ui);
+    for (i = 0; i < nparams; i++) {
+        char *str = virTypedParameterToString(&params[i]);
+
+        if (!str)
+            goto cleanup;
+        vshPrint(ctl, "%-17s: %s\n", params[i].field, str);
+        VIR_FREE(str);
+    }
 
     ret = true;
 
@@ -899,6 +906,11 @@ static const vshCmdOptDef opts_srv_clients_set[] = {
      .help = N_("Change the upper limit to number of clients waiting for "
                 "authentication to be connected to the server"),
     },
+    {.name = "requests-per-sec",
+     .type = VSH_OT_INT,
+     .help = N_("Change the maximum number of requests the server accepts "
+                "from any one client per second (0 for unlimited)"),
+    },
     {.name = NULL}
 };
 
@@ -930,12 +942,14 @@ cmdSrvClientsSet(vshControl *ctl, const vshCmd *cmd)
 
     PARSE_CMD_TYPED_PARAM("max-clients", VIR_SERVER_CLIENTS_MAX);
     PARSE_CMD_TYPED_PARAM("max-unauth-clients", VIR_SERVER_CLIENTS_UNAUTH_MAX);
+    PARSE_CMD_TYPED_PARAM("requests-per-sec", VIR_SERVER_CLIENT_REQUESTS_PER_SEC);
 
 #undef PARSE_CMD_TYPED_PARAM
 
     if (!nparams) {
         vshError(ctl, "%s", _("At least one of options --max-clients, "
-                              "--max-unauth-clients is mandatory"));
+                              "--max-unauth-clients, --requests-per-sec "
+                              "is mandatory"));
         goto cleanup;
     }
 
@@ -581,10 +581,24 @@ vshCmdDefSearchSet(const char *cmdname)
 const vshCmdDef *
 vshCmddefSearch(const char *cmdname)
 {
+    static const vshCmdDef *last;
+    const vshCmdDef *ret;
+
+    /* Batch input tends to run the same command over and over, so
+     * check the previous hit before scanning the whole table.
+     * Commands are only ever parsed from the main thread. */
+    if (last && STREQ(last->name, cmdname))
+        return last;
+
     if (cmdGroups)
-        return vshCmdDefSearchGrp(cmdname);
+        ret = vshCmdDefSearchGrp(cmdname);
     else
-        return vshCmdDefSearchSet(cmdname);
+        ret = vshCmdDefSearchSet(cmdname);
+
+    if (ret)
+        last = ret;
+
+    return ret;
 }
 
 const vshCmdGrp *
@@ -2546,6 +2560,32 @@ vshTreePrint(vshControl *ctl, vshTreeLookup lookup, void *opaque,
     return ret;
 }
 
+/* Read the next command line from stdin without involving readline.
+ * Used when stdin is not a terminal, i.e. when another process drives
+ * us through a pipe with a long-lived session sharing one connection.
+ * The output is flushed before reading so the driving process sees the
+ * previous command's results, with the prompt acting as an end-of-output
+ * marker, instead of deadlocking on data stuck in the stdio buffer. */
+static char *
+vshReadlineStream(vshControl *ctl, const char *prompt)
+{
+    char line[1024];
+    char *r;
+    int len;
+
+    fputs(prompt, stdout);
+    fflush(stdout);
+    r = fgets(line, sizeof(line), stdin);
+    if (r == NULL) return NULL; /* EOF */
+
+    /* Chomp trailing \n */
+    len = strlen(r);
+    if (len > 0 && r[len-1] == '\n')
+        r[len-1] = '\0';
+
+    return vshStrdup(ctl, r);
+}
+
 #if WITH_READLINE
 
 /* -----------------
@@ -2956,8 +2996,12 @@ vshReadlineDeinit(vshControl *ctl)
 }
 
 char *
-vshReadline(vshControl *ctl ATTRIBUTE_UNUSED, const char *prompt)
+vshReadline(vshControl *ctl, const char *prompt)
 {
+    /* Don't let readline take over a stdin that is not a terminal */
+    if (!isatty(STDIN_FILENO))
+        return vshReadlineStream(ctl, prompt);
+
     return readline(prompt);
 }
 
@@ -2979,20 +3023,7 @@ vshReadlineDeinit(vshControl *ctl ATTRIBUTE_UNUSED)
 char *
 vshReadline(vshControl *ctl, const char *prompt)
 {
-    char line[1024];
-    char *r;
-    int len;
-
-    fputs(prompt, stdout);
-    r = fgets(line, sizeof(line), stdin);
-    if (r == NULL) return NULL; /* EOF */
-
-    /* Chomp trailing \n */
-    len = strlen(r);
-    if (len > 0 && r[len-1] == '\n')
-        r[len-1] = '\0';
-
-    return vshStrdup(ctl, r);
+    return vshReadlineStream(ctl, prompt);
 }
 
 #endif /* !WITH_READLINE */